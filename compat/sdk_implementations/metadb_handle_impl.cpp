@@ -5,6 +5,7 @@
  */
 
 #include "metadb_handle_impl.h"
+#include "metadb_impl.h"
 #include <algorithm>
 #include <sstream>
 
@@ -71,36 +72,38 @@ Result metadb_handle_impl::initialize(const playable_location& loc, metadb_impl*
 }
 
 Result metadb_handle_impl::load_metadata_from_file() {
-    // 杩欎釜瀹炵幇鏄畝鍖栫殑
-    // 鐪熸鐨勫疄鐜伴渶瑕佽皟鐢ㄨВ鐮佸櫒鏉ヨ幏鍙栧厓鏁版嵁
-    
-    const std::string& path = location_.get_path();
-    if (!path || strlen(path) == 0) {
+    const std::string path = location_.get_path();
+    if (path.empty()) {
         return Result::InvalidParameter;
     }
-    
-    // 鑾峰彇鏂囦欢缁熻锛堝ぇ灏忋€佹椂闂存埑锛?
-#ifdef _WIN32
-    struct _stat64 st;
-    if (_stat64(path, &st) != 0) {
-        return Result::FileNotFound;
-    }
-#else
-    struct stat st;
-    if (stat(path, &st) != 0) {
+
+    // Format and tags come from the library store (or the file headers),
+    // never from opening a decoder
+    mp::core::TrackMetadata track;
+    bool have_tags = parent_db_ ? parent_db_->get_track(path, track)
+                                : mp::core::read_track_metadata(path, track);
+    if (!have_tags && !mp::core::stat_file(path, track.stats)) {
         return Result::FileNotFound;
     }
-#endif
-    
-    file_stats_.m_size = st.st_size;
-    file_stats_.m_timestamp = st.st_mtime;
-    
+
+    file_stats_.m_size = track.stats.size;
+    file_stats_.m_timestamp = static_cast<uint64_t>(track.stats.mtime_ns / 1000000000);
     info_->set_file_stats(file_stats_);
-    
-    // 娉ㄦ剰锛氳繖閲屾病鏈夊疄闄呰鍙栭煶棰戞枃浠剁殑鍏冩暟鎹?
-    // 鍦ㄥ疄闄呯郴缁熶腑锛岃繖浼氳皟鐢ㄨВ鐮佸櫒鐨?get_info 鏂规硶
-    // 涓虹畝鍗曡捣瑙侊紝鎴戜滑鍙～鍏呬簡涓€浜涘熀纭€淇℃伅
-    
+
+    if (have_tags) {
+        for (const auto& tag : track.tags) {
+            info_->meta_add(tag.first.c_str(), tag.second.c_str());
+        }
+        xpumusic_sdk::audio_info audio = {};
+        audio.m_sample_rate = track.sample_rate;
+        audio.m_channels = track.channels;
+        audio.m_length = track.duration_ms / 1000.0;
+        if (track.duration_ms > 0) {
+            audio.m_bitrate = static_cast<uint32_t>(track.stats.size * 8 / track.duration_ms);  // kbps
+        }
+        info_->set_audio_info(audio);
+    }
+
     return Result::Success;
 }
 
@@ -0,0 +1,42 @@
+﻿/**
+ * @file metadb_impl.cpp
+ * @brief metadb_impl implementation
+ * @date 2026-10-16
+ */
+
+#include "metadb_impl.h"
+
+namespace xpumusic_sdk {
+
+metadb_impl::metadb_impl(const std::string& db_path) {
+    store_.open(db_path);
+}
+
+metadb_impl::~metadb_impl() {
+    store_.commit();
+}
+
+bool metadb_impl::get_track(const std::string& path, mp::core::TrackMetadata& out) {
+    mp::core::FileStats stats;
+    if (!mp::core::stat_file(path, stats)) {
+        return false;
+    }
+    if (store_.lookup(path, stats, out)) {
+        return true;
+    }
+
+    // New or changed since it was stored: read the headers once
+    if (!mp::core::read_track_metadata(path, out)) {
+        return false;
+    }
+    store_.put(out);
+    return true;
+}
+
+mp::core::ScanStats metadb_impl::scan(const std::vector<std::string>& roots,
+                                      mp::IEventBus* event_bus) {
+    mp::core::LibraryScanner scanner(store_, event_bus);
+    return scanner.scan(roots);
+}
+
+} // namespace xpumusic_sdk
@@ -0,0 +1,57 @@
+﻿/**
+ * @file metadb_impl.h
+ * @brief metadb backed by the persistent library store
+ * @date 2026-10-16
+ */
+
+#pragma once
+
+#include "../../core/library_scanner.h"
+#include "../../core/metadata_store.h"
+#include <string>
+#include <vector>
+
+namespace xpumusic_sdk {
+
+/**
+ * @class metadb_impl
+ * @brief The media library database metadb_handle_impl reads through
+ *
+ * Wraps mp::core::MetadataStore: entries are keyed by path and stay valid
+ * while the file's size and mtime are unchanged, so handles are filled from
+ * the store instead of opening a decoder. A miss reads the file headers
+ * once (mp::core::read_track_metadata) and caches the result.
+ */
+class metadb_impl {
+public:
+    /**
+     * @param db_path Store location; defaults to MetadataStore::default_path()
+     */
+    explicit metadb_impl(const std::string& db_path = mp::core::MetadataStore::default_path());
+    ~metadb_impl();
+
+    metadb_impl(const metadb_impl&) = delete;
+    metadb_impl& operator=(const metadb_impl&) = delete;
+
+    bool is_open() const { return store_.is_open(); }
+
+    /**
+     * @brief Metadata for path, from the store when the file is unchanged
+     * @return false if the file is missing or not a supported format
+     */
+    bool get_track(const std::string& path, mp::core::TrackMetadata& out);
+
+    /**
+     * @brief Bring the store up to date with directory trees
+     * @param event_bus Receives EVENT_LIBRARY_UPDATED when done (optional)
+     */
+    mp::core::ScanStats scan(const std::vector<std::string>& roots,
+                             mp::IEventBus* event_bus = nullptr);
+
+    mp::core::MetadataStore& store() { return store_; }
+
+private:
+    mp::core::MetadataStore store_;
+};
+
+} // namespace xpumusic_sdk
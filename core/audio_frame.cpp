@@ -0,0 +1,473 @@
+﻿#include "audio_frame.h"
+#include "../sdk/xpumusic_plugin_sdk.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace mp {
+namespace core {
+
+struct AudioFrame::Block {
+    std::atomic<uint32_t> refs;
+    std::atomic<uint32_t> next;     // Free-list link: index + 1, 0 ends the list
+    PoolState* pool;
+    float* samples;
+    size_t frames;
+    size_t stride;
+    uint64_t position;
+    uint32_t sample_rate;
+    uint32_t conversions;
+    uint16_t channels;
+    FrameLayout layout;
+
+    Block() : refs(0), next(0), pool(nullptr), samples(nullptr), frames(0), stride(0),
+              position(0), sample_rate(0), conversions(0), channels(0),
+              layout(FrameLayout::Interleaved) {}
+};
+
+// Shared by the pool and every frame taken from it: refs counts the pool
+// itself plus each block in use, and the last one deletes the storage
+struct AudioFrame::PoolState {
+    std::vector<float> storage;
+    std::unique_ptr<Block[]> blocks;
+    size_t block_count;
+    size_t block_samples;
+    std::atomic<uint64_t> head;     // ABA tag << 32 | top block index + 1
+    std::atomic<size_t> available;
+    std::atomic<size_t> refs;
+
+    PoolState(size_t count, size_t samples)
+        : blocks(new Block[count]), block_count(count), block_samples(samples),
+          head(0), available(0), refs(1) {
+        // One slab, each block starting on an ALIGNMENT boundary
+        storage.resize(count * samples + ALIGN_FLOATS);
+        uintptr_t address = reinterpret_cast<uintptr_t>(storage.data());
+        size_t base = ((ALIGNMENT - address % ALIGNMENT) % ALIGNMENT) / sizeof(float);
+        for (size_t i = count; i-- > 0;) {
+            blocks[i].pool = this;
+            blocks[i].samples = storage.data() + base + i * samples;
+            push(&blocks[i]);
+        }
+    }
+
+    void push(Block* block) {
+        const uint64_t index = static_cast<uint64_t>(block - blocks.get()) + 1;
+        uint64_t top = head.load(std::memory_order_relaxed);
+        uint64_t desired;
+        do {
+            block->next.store(static_cast<uint32_t>(top), std::memory_order_relaxed);
+            desired = (((top >> 32) + 1) << 32) | index;
+        } while (!head.compare_exchange_weak(top, desired, std::memory_order_release,
+                                             std::memory_order_relaxed));
+        available.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Block* pop() {
+        uint64_t top = head.load(std::memory_order_acquire);
+        for (;;) {
+            const uint32_t index = static_cast<uint32_t>(top);
+            if (index == 0) {
+                return nullptr;
+            }
+            Block* block = &blocks[index - 1];
+            // A stale link only matters if the CAS succeeds, and the tag stops that
+            const uint64_t next = block->next.load(std::memory_order_relaxed);
+            const uint64_t desired = (((top >> 32) + 1) << 32) | next;
+            if (head.compare_exchange_weak(top, desired, std::memory_order_acquire,
+                                           std::memory_order_acquire)) {
+                available.fetch_sub(1, std::memory_order_relaxed);
+                return block;
+            }
+        }
+    }
+
+    // A cleared block with one reference, or nullptr if none are free
+    Block* take() {
+        Block* block = pop();
+        if (!block) {
+            return nullptr;
+        }
+        refs.fetch_add(1, std::memory_order_relaxed);
+        block->refs.store(1, std::memory_order_relaxed);
+        block->frames = 0;
+        block->stride = 0;
+        block->position = 0;
+        block->sample_rate = 0;
+        block->conversions = 0;
+        block->channels = 0;
+        block->layout = FrameLayout::Interleaved;
+        return block;
+    }
+
+    void give_back(Block* block) {
+        push(block);
+        unref();
+    }
+
+    void unref() {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+};
+
+namespace {
+
+size_t round_up(size_t frames) {
+    return (frames + AudioFrame::ALIGN_FLOATS - 1) & ~(AudioFrame::ALIGN_FLOATS - 1);
+}
+
+// Read sample i of an interleaved block as normalized float
+template <SampleFormat F>
+inline float read_sample(const uint8_t* src, size_t i);
+
+template <>
+inline float read_sample<SampleFormat::Int16>(const uint8_t* src, size_t i) {
+    int16_t v;
+    std::memcpy(&v, src + i * 2, sizeof(v));
+    return static_cast<float>(v) * (1.0f / 32768.0f);
+}
+
+template <>
+inline float read_sample<SampleFormat::Int24>(const uint8_t* src, size_t i) {
+    const uint8_t* p = src + i * 3;
+    int32_t v = static_cast<int32_t>(static_cast<uint32_t>(p[0]) << 8 |
+                                     static_cast<uint32_t>(p[1]) << 16 |
+                                     static_cast<uint32_t>(p[2]) << 24) >> 8;
+    return static_cast<float>(v) * (1.0f / 8388608.0f);
+}
+
+template <>
+inline float read_sample<SampleFormat::Int32>(const uint8_t* src, size_t i) {
+    int32_t v;
+    std::memcpy(&v, src + i * 4, sizeof(v));
+    return static_cast<float>(v) * (1.0f / 2147483648.0f);  // 2^31
+}
+
+template <>
+inline float read_sample<SampleFormat::Float32>(const uint8_t* src, size_t i) {
+    float v;
+    std::memcpy(&v, src + i * 4, sizeof(v));
+    return v;
+}
+
+template <>
+inline float read_sample<SampleFormat::Float64>(const uint8_t* src, size_t i) {
+    double v;
+    std::memcpy(&v, src + i * 8, sizeof(v));
+    return static_cast<float>(v);
+}
+
+// Convert, map channels and lay out in one pass. Source and output frames
+// advance together, so the loop reads each source frame once.
+template <SampleFormat F>
+void import_samples(const uint8_t* src, size_t frames, uint16_t source_channels,
+                    uint16_t channels, float* dst, size_t stride) {
+    if (stride == 0) {
+        for (size_t f = 0; f < frames; ++f) {
+            const size_t in = f * source_channels;
+            for (uint16_t c = 0; c < channels; ++c) {
+                dst[f * channels + c] =
+                    read_sample<F>(src, in + std::min<uint16_t>(c, source_channels - 1));
+            }
+        }
+        return;
+    }
+
+    for (uint16_t c = 0; c < channels; ++c) {
+        const size_t in = std::min<uint16_t>(c, source_channels - 1);
+        float* out = dst + c * stride;
+        for (size_t f = 0; f < frames; ++f) {
+            out[f] = read_sample<F>(src, f * source_channels + in);
+        }
+    }
+}
+
+} // namespace
+
+size_t sample_bytes(SampleFormat format) {
+    switch (format) {
+        case SampleFormat::Int16: return 2;
+        case SampleFormat::Int24: return 3;
+        case SampleFormat::Float64: return 8;
+        default: return 4;  // Int32, Float32 and legacy decoders that report Unknown
+    }
+}
+
+// AudioFrame
+
+AudioFrame::AudioFrame(const AudioFrame& other) : block_(other.block_) {
+    if (block_) {
+        block_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+AudioFrame& AudioFrame::operator=(const AudioFrame& other) {
+    if (other.block_) {
+        other.block_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    release();
+    block_ = other.block_;
+    return *this;
+}
+
+AudioFrame& AudioFrame::operator=(AudioFrame&& other) noexcept {
+    if (this != &other) {
+        release();
+        block_ = other.block_;
+        other.block_ = nullptr;
+    }
+    return *this;
+}
+
+void AudioFrame::release() {
+    if (!block_) {
+        return;
+    }
+    // acq_rel: writes made through any handle happen before the block is reused
+    if (block_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        block_->pool->give_back(block_);
+    }
+    block_ = nullptr;
+}
+
+bool AudioFrame::unique() const {
+    return block_ && block_->refs.load(std::memory_order_acquire) == 1;
+}
+
+size_t AudioFrame::frames() const { return block_ ? block_->frames : 0; }
+uint16_t AudioFrame::channels() const { return block_ ? block_->channels : 0; }
+uint32_t AudioFrame::sample_rate() const { return block_ ? block_->sample_rate : 0; }
+FrameLayout AudioFrame::layout() const { return block_ ? block_->layout : FrameLayout::Interleaved; }
+size_t AudioFrame::channel_stride() const { return block_ ? block_->stride : 0; }
+size_t AudioFrame::capacity_samples() const { return block_ ? block_->pool->block_samples : 0; }
+uint64_t AudioFrame::position() const { return block_ ? block_->position : 0; }
+uint32_t AudioFrame::conversions() const { return block_ ? block_->conversions : 0; }
+
+void AudioFrame::set_position(uint64_t position) {
+    if (block_) {
+        block_->position = position;
+    }
+}
+
+size_t AudioFrame::capacity_frames(uint16_t channels, FrameLayout layout) const {
+    if (!block_ || channels == 0) {
+        return 0;
+    }
+    size_t per_channel = block_->pool->block_samples / channels;
+    return layout == FrameLayout::Planar ? per_channel & ~(ALIGN_FLOATS - 1) : per_channel;
+}
+
+bool AudioFrame::set_format(size_t frames, uint16_t channels, uint32_t sample_rate,
+                            FrameLayout layout) {
+    if (!block_ || channels == 0 || frames > capacity_frames(channels, layout)) {
+        return false;
+    }
+    block_->frames = frames;
+    block_->channels = channels;
+    block_->sample_rate = sample_rate;
+    block_->layout = layout;
+    block_->stride = layout == FrameLayout::Planar ? round_up(frames) : 0;
+    return true;
+}
+
+float* AudioFrame::data() { return block_ ? block_->samples : nullptr; }
+const float* AudioFrame::data() const { return block_ ? block_->samples : nullptr; }
+
+float* AudioFrame::interleaved() {
+    return block_ && block_->layout == FrameLayout::Interleaved ? block_->samples : nullptr;
+}
+
+const float* AudioFrame::interleaved() const {
+    return block_ && block_->layout == FrameLayout::Interleaved ? block_->samples : nullptr;
+}
+
+float* AudioFrame::channel(uint16_t index) {
+    if (!block_ || block_->layout != FrameLayout::Planar || index >= block_->channels) {
+        return nullptr;
+    }
+    return block_->samples + index * block_->stride;
+}
+
+const float* AudioFrame::channel(uint16_t index) const {
+    return const_cast<AudioFrame*>(this)->channel(index);
+}
+
+void AudioFrame::silence() {
+    if (!block_) {
+        return;
+    }
+    size_t samples = block_->layout == FrameLayout::Planar
+                         ? block_->stride * block_->channels
+                         : block_->frames * block_->channels;
+    std::fill(block_->samples, block_->samples + samples, 0.0f);
+}
+
+bool AudioFrame::import(const void* source, SampleFormat format, size_t frames,
+                        uint16_t source_channels, uint16_t channels, uint32_t sample_rate,
+                        FrameLayout layout) {
+    if (!source || source_channels == 0 || !unique() ||
+        !set_format(frames, channels, sample_rate, layout)) {
+        return false;
+    }
+
+    const uint8_t* src = static_cast<const uint8_t*>(source);
+    float* dst = block_->samples;
+    const size_t stride = block_->stride;
+    switch (format) {
+        case SampleFormat::Int16:
+            import_samples<SampleFormat::Int16>(src, frames, source_channels, channels, dst, stride);
+            break;
+        case SampleFormat::Int24:
+            import_samples<SampleFormat::Int24>(src, frames, source_channels, channels, dst, stride);
+            break;
+        case SampleFormat::Float32:
+            if (stride == 0 && source_channels == channels) {
+                std::memcpy(dst, src, frames * channels * sizeof(float));
+            } else {
+                import_samples<SampleFormat::Float32>(src, frames, source_channels, channels,
+                                                      dst, stride);
+            }
+            break;
+        case SampleFormat::Float64:
+            import_samples<SampleFormat::Float64>(src, frames, source_channels, channels, dst, stride);
+            break;
+        default:
+            import_samples<SampleFormat::Int32>(src, frames, source_channels, channels, dst, stride);
+            break;
+    }
+    block_->conversions++;
+    return true;
+}
+
+bool AudioFrame::convert_layout(FrameLayout layout) {
+    if (!block_ || !unique()) {
+        return false;
+    }
+    if (block_->layout == layout) {
+        return true;
+    }
+
+    Block* target = block_->pool->take();
+    if (!target) {
+        return false;
+    }
+    AudioFrame converted(target);
+    if (!converted.set_format(block_->frames, block_->channels, block_->sample_rate, layout)) {
+        return false;
+    }
+
+    const size_t frames = block_->frames;
+    const uint16_t channels = block_->channels;
+    const float* src = block_->samples;
+    float* dst = target->samples;
+    if (layout == FrameLayout::Planar) {
+        const size_t stride = target->stride;
+        for (uint16_t c = 0; c < channels; ++c) {
+            float* out = dst + c * stride;
+            for (size_t f = 0; f < frames; ++f) {
+                out[f] = src[f * channels + c];
+            }
+        }
+    } else {
+        const size_t stride = block_->stride;
+        for (uint16_t c = 0; c < channels; ++c) {
+            const float* in = src + c * stride;
+            for (size_t f = 0; f < frames; ++f) {
+                dst[f * channels + c] = in[f];
+            }
+        }
+    }
+
+    target->position = block_->position;
+    target->conversions = block_->conversions + 1;
+    *this = std::move(converted);
+    return true;
+}
+
+// AudioFramePool
+
+AudioFramePool::AudioFramePool(size_t block_count, size_t max_frames, uint16_t max_channels)
+    : state_(new AudioFrame::PoolState(
+          block_count, round_up(std::max<size_t>(max_frames, 1)) *
+                           std::max<uint16_t>(max_channels, 1))) {
+}
+
+AudioFramePool::~AudioFramePool() {
+    state_->unref();
+}
+
+AudioFrame AudioFramePool::acquire() {
+    return AudioFrame(state_->take());
+}
+
+AudioFrame AudioFramePool::acquire(size_t frames, uint16_t channels, uint32_t sample_rate,
+                                   FrameLayout layout) {
+    AudioFrame frame = acquire();
+    if (frame && !frame.set_format(frames, channels, sample_rate, layout)) {
+        frame.reset();
+    }
+    return frame;
+}
+
+size_t AudioFramePool::block_count() const { return state_->block_count; }
+size_t AudioFramePool::block_samples() const { return state_->block_samples; }
+
+size_t AudioFramePool::available() const {
+    return state_->available.load(std::memory_order_relaxed);
+}
+
+// Legacy adapters
+
+AudioBuffer as_mp_buffer(AudioFrame& frame) {
+    AudioBuffer buffer;
+    float* samples = frame.interleaved();
+    if (!samples) {
+        return buffer;
+    }
+    buffer.data = samples;
+    buffer.sample_rate = frame.sample_rate();
+    buffer.channels = frame.channels();
+    buffer.format = SampleFormat::Float32;
+    buffer.frames = static_cast<uint32_t>(frame.frames());
+    buffer.capacity = static_cast<uint32_t>(
+        frame.capacity_frames(frame.channels(), FrameLayout::Interleaved));
+    buffer.position_samples = frame.position();
+    if (frame.sample_rate() > 0) {
+        buffer.timestamp_us = frame.position() * 1000000 / frame.sample_rate();
+    }
+    return buffer;
+}
+
+xpumusic::AudioBuffer as_xpumusic_buffer(AudioFrame& frame) {
+    float* samples = frame.interleaved();
+    if (!samples) {
+        return xpumusic::AudioBuffer();
+    }
+    return xpumusic::AudioBuffer(samples, static_cast<int>(frame.frames()),
+                                 static_cast<int>(frame.channels()));
+}
+
+AudioFrame import_buffer(AudioFramePool& pool, const AudioBuffer& buffer, FrameLayout layout) {
+    AudioFrame frame = pool.acquire();
+    if (!frame || !frame.import(buffer.data, buffer.format, buffer.frames, buffer.channels,
+                                buffer.channels, buffer.sample_rate, layout)) {
+        return AudioFrame();
+    }
+    frame.set_position(buffer.position_samples);
+    return frame;
+}
+
+AudioFrame import_buffer(AudioFramePool& pool, const xpumusic::AudioBuffer& buffer,
+                         uint32_t sample_rate, FrameLayout layout) {
+    AudioFrame frame = pool.acquire();
+    if (!frame || buffer.frames < 0 || buffer.channels <= 0 ||
+        !frame.import(buffer.data, SampleFormat::Float32, static_cast<size_t>(buffer.frames),
+                      static_cast<uint16_t>(buffer.channels), static_cast<uint16_t>(buffer.channels),
+                      sample_rate, layout)) {
+        return AudioFrame();
+    }
+    return frame;
+}
+
+}} // namespace mp::core
@@ -0,0 +1,158 @@
+﻿#pragma once
+
+#include "mp_types.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace xpumusic {
+struct AudioBuffer;
+}
+
+namespace mp {
+namespace core {
+
+// Sample order inside an AudioFrame
+enum class FrameLayout : uint8_t {
+    Interleaved,    // L R L R ...
+    Planar          // L L ... R R ..., each channel 32-byte aligned
+};
+
+// Bytes per sample of a decoder format; Unknown counts as 32-bit like
+// legacy decoders that leave it unset
+size_t sample_bytes(SampleFormat format);
+
+class AudioFramePool;
+
+// Reference-counted handle to one pooled block of float audio. Copies share
+// the block; the last handle to go returns it to its pool. Every stage from
+// decoder to output can pass the same frame on, so a block is converted
+// from the decoder's format once (import) and at most once more between
+// layouts (convert_layout), never copied at a stage boundary.
+//
+// Handles are not synchronised: a frame may be handed between threads, but
+// only one thread writes its samples at a time. The block is writable while
+// unique(); a stage that shares a frame and wants to modify it takes a
+// fresh block from the pool instead.
+class AudioFrame {
+public:
+    static constexpr size_t ALIGNMENT = 32;                     // Bytes
+    static constexpr size_t ALIGN_FLOATS = ALIGNMENT / sizeof(float);
+
+    AudioFrame() : block_(nullptr) {}
+    AudioFrame(const AudioFrame& other);
+    AudioFrame(AudioFrame&& other) noexcept : block_(other.block_) { other.block_ = nullptr; }
+    AudioFrame& operator=(const AudioFrame& other);
+    AudioFrame& operator=(AudioFrame&& other) noexcept;
+    ~AudioFrame() { release(); }
+
+    explicit operator bool() const { return block_ != nullptr; }
+    bool unique() const;
+    void reset() { release(); }
+
+    size_t frames() const;
+    uint16_t channels() const;
+    uint32_t sample_rate() const;
+    FrameLayout layout() const;
+
+    // Floats from one planar channel to the next (frames rounded up to
+    // ALIGN_FLOATS); 0 for interleaved data
+    size_t channel_stride() const;
+
+    // Block size, and the most frames that fit for a channel count and layout
+    size_t capacity_samples() const;
+    size_t capacity_frames(uint16_t channels, FrameLayout layout) const;
+
+    // Stream position of the first frame, carried through for legacy buffers
+    uint64_t position() const;
+    void set_position(uint64_t position);
+
+    // Format and layout conversions this block has been through
+    uint32_t conversions() const;
+
+    // Describe the block's contents; samples are left as they are.
+    // False if the format does not fit the block.
+    bool set_format(size_t frames, uint16_t channels, uint32_t sample_rate, FrameLayout layout);
+
+    // Start of the samples, in the current layout
+    float* data();
+    const float* data() const;
+
+    // Interleaved samples, or nullptr for a planar frame
+    float* interleaved();
+    const float* interleaved() const;
+
+    // One planar channel, or nullptr for an interleaved frame
+    float* channel(uint16_t index);
+    const float* channel(uint16_t index) const;
+
+    // Raw bytes of the whole block, for decoders that write straight into it
+    void* bytes() { return data(); }
+    size_t capacity_bytes() const { return capacity_samples() * sizeof(float); }
+
+    void silence();
+
+    // Convert interleaved decoder output to float in one pass, setting the
+    // format. Output channel c reads source channel min(c, source_channels - 1):
+    // mono is duplicated and channels past the output count are dropped.
+    bool import(const void* source, SampleFormat format, size_t frames,
+                uint16_t source_channels, uint16_t channels, uint32_t sample_rate,
+                FrameLayout layout);
+
+    // Reorder into the other layout through a second block from the same
+    // pool, which this frame then keeps. False if the pool is exhausted.
+    bool convert_layout(FrameLayout layout);
+
+private:
+    friend class AudioFramePool;
+    struct Block;
+    struct PoolState;
+
+    explicit AudioFrame(Block* block) : block_(block) {}
+    void release();
+
+    Block* block_;
+};
+
+// Fixed set of equally sized, 32-byte aligned blocks. All memory is
+// allocated up front; acquire and release are lock-free and never allocate,
+// so frames can be taken and dropped on the audio thread. The storage lives
+// until the pool and every frame taken from it are gone.
+class AudioFramePool {
+public:
+    // Each block holds max_frames * max_channels samples in either layout
+    AudioFramePool(size_t block_count, size_t max_frames, uint16_t max_channels);
+    ~AudioFramePool();
+
+    AudioFramePool(const AudioFramePool&) = delete;
+    AudioFramePool& operator=(const AudioFramePool&) = delete;
+
+    // Empty frame if every block is in use
+    AudioFrame acquire();
+
+    // Acquire and set the format; empty frame if it does not fit
+    AudioFrame acquire(size_t frames, uint16_t channels, uint32_t sample_rate,
+                       FrameLayout layout);
+
+    size_t block_count() const;
+    size_t block_samples() const;
+    size_t available() const;       // Free blocks; a snapshot under concurrency
+
+private:
+    AudioFrame::PoolState* state_;
+};
+
+// Zero-copy views of an interleaved frame as the legacy buffer types. The
+// view borrows the frame's samples: keep the frame alive while it is used.
+// Planar frames give an empty view; convert_layout first.
+AudioBuffer as_mp_buffer(AudioFrame& frame);
+xpumusic::AudioBuffer as_xpumusic_buffer(AudioFrame& frame);
+
+// Take a legacy buffer into a pooled frame. This is the single format
+// conversion for producers that still fill their own buffers.
+AudioFrame import_buffer(AudioFramePool& pool, const AudioBuffer& buffer, FrameLayout layout);
+AudioFrame import_buffer(AudioFramePool& pool, const xpumusic::AudioBuffer& buffer,
+                         uint32_t sample_rate, FrameLayout layout);
+
+}} // namespace mp::core
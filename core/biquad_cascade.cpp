@@ -0,0 +1,369 @@
+﻿#include "biquad_cascade.h"
+#include <algorithm>
+#include <cmath>
+
+#ifndef MP_BIQUAD_SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MP_BIQUAD_SSE2 1
+#else
+#define MP_BIQUAD_SSE2 0
+#endif
+#endif
+
+#if MP_BIQUAD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace mp {
+namespace core {
+
+namespace {
+
+// State below this is flushed so decaying tails never reach denormals
+const float DENORMAL_THRESHOLD = 1e-30f;
+
+#if MP_BIQUAD_SSE2
+
+// Lanes of vector v that hold a frame inside the block at this step
+template <size_t C>
+inline __m128 lane_mask(size_t vector, size_t step, size_t frames) {
+    alignas(16) int32_t bits[4];
+    for (size_t lane = 0; lane < 4; ++lane) {
+        size_t j = vector * (4 / C) + lane / C;
+        bool valid = j <= step && step - j < frames;
+        bits[lane] = valid ? -1 : 0;
+    }
+    return _mm_castsi128_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(bits)));
+}
+
+// The new frame, placed in the lanes shift_in reads from the vector before
+inline __m128 load_frame(const float* x, size_t step, size_t frames, size_t channels) {
+    if (step >= frames) {
+        return _mm_setzero_ps();
+    }
+    switch (channels) {
+        case 1: return _mm_set_ps(x[step], 0.0f, 0.0f, 0.0f);
+        case 2: return _mm_loadh_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(x + step * 2));
+        default: return _mm_loadu_ps(x + step * 4);
+    }
+}
+
+// Input to a vector: the first section takes the last section of the vector
+// before it (or the new frame), the others the section below them
+template <size_t C>
+inline __m128 shift_in(__m128 previous, __m128 y);
+
+template <>
+inline __m128 shift_in<1>(__m128 previous, __m128 y) {
+    __m128i low = _mm_srli_si128(_mm_castps_si128(previous), 12);
+    __m128i high = _mm_slli_si128(_mm_castps_si128(y), 4);
+    return _mm_castsi128_ps(_mm_or_si128(low, high));
+}
+
+template <>
+inline __m128 shift_in<2>(__m128 previous, __m128 y) {
+    return _mm_shuffle_ps(previous, y, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+template <>
+inline __m128 shift_in<4>(__m128 previous, __m128) {
+    return previous;
+}
+
+// The last section's lanes hold the finished output
+template <size_t C>
+inline void store_out(float* x, size_t frame, __m128 y);
+
+template <>
+inline void store_out<1>(float* x, size_t frame, __m128 y) {
+    x[frame] = _mm_cvtss_f32(_mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3)));
+}
+
+template <>
+inline void store_out<2>(float* x, size_t frame, __m128 y) {
+    _mm_storeh_pi(reinterpret_cast<__m64*>(x + frame * 2), y);
+}
+
+template <>
+inline void store_out<4>(float* x, size_t frame, __m128 y) {
+    _mm_storeu_ps(x + frame * 4, y);
+}
+
+// One stage of V vectors over frames of C interleaved channels, in place.
+// Section j of the stage works on frame step - j, so the stage takes
+// frames + V * 4 / C - 1 steps; lanes outside the block keep their state.
+template <size_t C, size_t V>
+void run_stage(const float (*coefficients)[16], float* x, size_t frames, float* s1_io, float* s2_io) {
+    const size_t depth = V * (4 / C);
+    __m128 s1[V], s2[V], y[V];
+    for (size_t v = 0; v < V; ++v) {
+        s1[v] = _mm_loadu_ps(s1_io + v * 4);
+        s2[v] = _mm_loadu_ps(s2_io + v * 4);
+        y[v] = _mm_setzero_ps();
+    }
+
+    const size_t steps = frames + depth - 1;
+    for (size_t step = 0; step < steps; ++step) {
+        const bool edge = step + 1 < depth || step >= frames;
+        __m128 previous = load_frame(x, step, frames, C);
+
+        for (size_t v = 0; v < V; ++v) {
+            __m128 in = shift_in<C>(previous, y[v]);
+            previous = y[v];
+
+            // Transposed direct form II
+            __m128 out = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(coefficients[0] + v * 4), in), s1[v]);
+            __m128 next_s1 = _mm_add_ps(
+                _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(coefficients[1] + v * 4), in),
+                           _mm_mul_ps(_mm_loadu_ps(coefficients[3] + v * 4), out)),
+                s2[v]);
+            __m128 next_s2 = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(coefficients[2] + v * 4), in),
+                                        _mm_mul_ps(_mm_loadu_ps(coefficients[4] + v * 4), out));
+
+            if (edge) {
+                __m128 mask = lane_mask<C>(v, step, frames);
+                s1[v] = _mm_or_ps(_mm_and_ps(mask, next_s1), _mm_andnot_ps(mask, s1[v]));
+                s2[v] = _mm_or_ps(_mm_and_ps(mask, next_s2), _mm_andnot_ps(mask, s2[v]));
+            } else {
+                s1[v] = next_s1;
+                s2[v] = next_s2;
+            }
+            y[v] = out;
+        }
+
+        if (step + 1 >= depth) {
+            store_out<C>(x, step + 1 - depth, y[V - 1]);
+        }
+    }
+
+    for (size_t v = 0; v < V; ++v) {
+        _mm_storeu_ps(s1_io + v * 4, s1[v]);
+        _mm_storeu_ps(s2_io + v * 4, s2[v]);
+    }
+}
+
+template <size_t C>
+void run_stage(size_t vectors, const float (*coefficients)[16], float* x, size_t frames,
+               float* s1, float* s2) {
+    switch (vectors) {
+        case 1: run_stage<C, 1>(coefficients, x, frames, s1, s2); break;
+        case 2: run_stage<C, 2>(coefficients, x, frames, s1, s2); break;
+        case 3: run_stage<C, 3>(coefficients, x, frames, s1, s2); break;
+        default: run_stage<C, 4>(coefficients, x, frames, s1, s2); break;
+    }
+}
+
+#else
+
+// Section by section over frames of group_channels interleaved channels
+void run_stage_scalar(size_t vectors, const float (*coefficients)[16], size_t group_channels,
+                      float* x, size_t frames, float* s1, float* s2) {
+    for (size_t lane = 0; lane < vectors * 4; ++lane) {
+        const float b0 = coefficients[0][lane];
+        const float b1 = coefficients[1][lane];
+        const float b2 = coefficients[2][lane];
+        const float a1 = coefficients[3][lane];
+        const float a2 = coefficients[4][lane];
+        float z1 = s1[lane];
+        float z2 = s2[lane];
+        float* p = x + lane % group_channels;
+        for (size_t i = 0; i < frames; ++i, p += group_channels) {
+            float in = *p;
+            float out = b0 * in + z1;
+            z1 = b1 * in - a1 * out + z2;
+            z2 = b2 * in - a2 * out;
+            *p = out;
+        }
+        s1[lane] = z1;
+        s2[lane] = z2;
+    }
+}
+
+#endif
+
+} // namespace
+
+BiquadCoefficients BiquadCoefficients::normalized(float b0, float b1, float b2,
+                                                  float a0, float a1, float a2) {
+    // Divide rather than scale by 1 / a0, so b == a stays an exact identity
+    BiquadCoefficients c;
+    c.b0 = b0 / a0;
+    c.b1 = b1 / a0;
+    c.b2 = b2 / a0;
+    c.a1 = a1 / a0;
+    c.a2 = a2 / a0;
+    return c;
+}
+
+BiquadCascade::BiquadCascade()
+    : channels_(0)
+    , group_channels_(1)
+    , group_sections_(LANES)
+    , stages_dirty_(false)
+    , stage_count_(0) {
+}
+
+void BiquadCascade::configure(size_t sections, uint16_t channels) {
+    channels_ = std::min(channels, MAX_CHANNELS);
+
+    // Widest channel group that divides the channel count, so no lane idles
+    group_channels_ = (channels_ % 4 == 0) ? 4 : (channels_ % 2 == 0) ? 2 : 1;
+    group_sections_ = LANES / group_channels_;
+
+    coefficients_.assign(sections, BiquadCoefficients());
+    size_t per_stage = MAX_VECTORS * group_sections_;
+    stages_.assign((sections + per_stage - 1) / per_stage, Stage());
+    stage_count_ = 0;
+    state_.assign(sections * channels_ * 2, 0.0f);
+    scratch_.assign(BLOCK_FRAMES * LANES, 0.0f);
+    stages_dirty_ = true;
+}
+
+void BiquadCascade::set_section(size_t index, const BiquadCoefficients& coefficients) {
+    if (index >= coefficients_.size() || coefficients_[index] == coefficients) {
+        return;
+    }
+
+    // Identity sections are not run, so their state is stale
+    if (coefficients_[index].is_identity()) {
+        std::fill(state_.begin() + index * channels_ * 2,
+                  state_.begin() + (index + 1) * channels_ * 2, 0.0f);
+    }
+
+    coefficients_[index] = coefficients;
+    stages_dirty_ = true;
+}
+
+void BiquadCascade::reset() {
+    std::fill(state_.begin(), state_.end(), 0.0f);
+}
+
+void BiquadCascade::rebuild_stages() {
+    stages_dirty_ = false;
+    stage_count_ = 0;
+
+    const size_t per_stage = MAX_VECTORS * group_sections_;
+    size_t next = 0;
+    while (true) {
+        // Gather the next run of active sections into one stage
+        size_t picked[STAGE_LANES];
+        size_t count = 0;
+        for (; next < coefficients_.size() && count < per_stage; ++next) {
+            if (!coefficients_[next].is_identity()) {
+                picked[count++] = next;
+            }
+        }
+        if (count == 0) {
+            break;
+        }
+
+        Stage& stage = stages_[stage_count_++];
+        stage.vectors = (count + group_sections_ - 1) / group_sections_;
+        for (size_t lane = 0; lane < STAGE_LANES; ++lane) {
+            size_t j = (lane / LANES) * group_sections_ + (lane % LANES) / group_channels_;
+            BiquadCoefficients c;
+            stage.section[lane] = NO_SECTION;
+            if (j < count) {
+                c = coefficients_[picked[j]];
+                stage.section[lane] = picked[j];
+            }
+            stage.coefficients[0][lane] = c.b0;
+            stage.coefficients[1][lane] = c.b1;
+            stage.coefficients[2][lane] = c.b2;
+            stage.coefficients[3][lane] = c.a1;
+            stage.coefficients[4][lane] = c.a2;
+        }
+    }
+}
+
+void BiquadCascade::load_state(const Stage& stage, uint16_t first_channel,
+                               float* s1, float* s2) const {
+    for (size_t lane = 0; lane < stage.vectors * LANES; ++lane) {
+        size_t section = stage.section[lane];
+        if (section == NO_SECTION) {
+            s1[lane] = 0.0f;
+            s2[lane] = 0.0f;
+            continue;
+        }
+        const float* s = &state_[(section * channels_ + first_channel + lane % group_channels_) * 2];
+        s1[lane] = s[0];
+        s2[lane] = s[1];
+    }
+}
+
+void BiquadCascade::store_state(const Stage& stage, uint16_t first_channel,
+                                const float* s1, const float* s2) {
+    for (size_t lane = 0; lane < stage.vectors * LANES; ++lane) {
+        size_t section = stage.section[lane];
+        if (section == NO_SECTION) {
+            continue;
+        }
+        float* s = &state_[(section * channels_ + first_channel + lane % group_channels_) * 2];
+        s[0] = std::abs(s1[lane]) < DENORMAL_THRESHOLD ? 0.0f : s1[lane];
+        s[1] = std::abs(s2[lane]) < DENORMAL_THRESHOLD ? 0.0f : s2[lane];
+    }
+}
+
+void BiquadCascade::run_group(float* data, size_t frames, uint16_t first_channel) {
+    for (size_t k = 0; k < stage_count_; ++k) {
+        const Stage& stage = stages_[k];
+        float s1[STAGE_LANES];
+        float s2[STAGE_LANES];
+        load_state(stage, first_channel, s1, s2);
+
+#if MP_BIQUAD_SSE2
+        switch (group_channels_) {
+            case 1: run_stage<1>(stage.vectors, stage.coefficients, data, frames, s1, s2); break;
+            case 2: run_stage<2>(stage.vectors, stage.coefficients, data, frames, s1, s2); break;
+            default: run_stage<4>(stage.vectors, stage.coefficients, data, frames, s1, s2); break;
+        }
+#else
+        run_stage_scalar(stage.vectors, stage.coefficients, group_channels_, data, frames, s1, s2);
+#endif
+
+        store_state(stage, first_channel, s1, s2);
+    }
+}
+
+void BiquadCascade::process(float* samples, size_t frames) {
+    if (channels_ == 0 || !samples) {
+        return;
+    }
+    if (stages_dirty_) {
+        rebuild_stages();
+    }
+    if (stage_count_ == 0) {
+        return;
+    }
+
+    // Blocks stay in L1 while every stage runs over them
+    const bool direct = group_channels_ == channels_;
+    for (size_t offset = 0; offset < frames; offset += BLOCK_FRAMES) {
+        size_t count = std::min(BLOCK_FRAMES, frames - offset);
+        float* block = samples + offset * channels_;
+
+        if (direct) {
+            run_group(block, count, 0);
+            continue;
+        }
+
+        for (uint16_t first = 0; first < channels_; first += group_channels_) {
+            float* scratch = scratch_.data();
+            for (size_t i = 0; i < count; ++i) {
+                for (uint16_t c = 0; c < group_channels_; ++c) {
+                    scratch[i * group_channels_ + c] = block[i * channels_ + first + c];
+                }
+            }
+
+            run_group(scratch, count, first);
+
+            for (size_t i = 0; i < count; ++i) {
+                for (uint16_t c = 0; c < group_channels_; ++c) {
+                    block[i * channels_ + first + c] = scratch[i * group_channels_ + c];
+                }
+            }
+        }
+    }
+}
+
+}} // namespace mp::core
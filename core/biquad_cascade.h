@@ -0,0 +1,94 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+// Second-order section, normalised so a0 == 1
+struct BiquadCoefficients {
+    float b0 = 1.0f;
+    float b1 = 0.0f;
+    float b2 = 0.0f;
+    float a1 = 0.0f;
+    float a2 = 0.0f;
+
+    static BiquadCoefficients normalized(float b0, float b1, float b2,
+                                         float a0, float a1, float a2);
+
+    // Numerator equals denominator, e.g. a peaking filter at 0 dB
+    bool is_identity() const { return b0 == 1.0f && b1 == a1 && b2 == a2; }
+
+    bool operator==(const BiquadCoefficients& other) const {
+        return b0 == other.b0 && b1 == other.b1 && b2 == other.b2 &&
+               a1 == other.a1 && a2 == other.a2;
+    }
+    bool operator!=(const BiquadCoefficients& other) const { return !(*this == other); }
+};
+
+// N biquad sections in series over M interleaved channels, in one pass.
+//
+// Sections run in transposed direct form II, which keeps float round-off
+// low at low cutoff frequencies. Every channel has its own state. With SSE2,
+// a vector holds C channels x (4 / C) sections (C = 1, 2 or 4), and a stage
+// chains up to four vectors. Each section in a stage runs one frame behind
+// the one before it, so all vectors update independently every step: a
+// stereo 31-band EQ is 4 stages of 8 sections. Identity sections are
+// skipped.
+//
+// Not thread-safe: change coefficients between process() calls.
+class BiquadCascade {
+public:
+    static constexpr uint16_t MAX_CHANNELS = 8;
+
+    BiquadCascade();
+
+    // Allocates; all sections start as identity with cleared state
+    void configure(size_t sections, uint16_t channels);
+
+    size_t sections() const { return coefficients_.size(); }
+    uint16_t channels() const { return channels_; }
+
+    // Does not allocate. A section that leaves identity starts from rest.
+    void set_section(size_t index, const BiquadCoefficients& coefficients);
+    const BiquadCoefficients& section(size_t index) const { return coefficients_[index]; }
+
+    void reset();
+
+    // In place, interleaved, channels() samples per frame
+    void process(float* samples, size_t frames);
+
+private:
+    static constexpr size_t LANES = 4;
+    static constexpr size_t MAX_VECTORS = 4;
+    static constexpr size_t STAGE_LANES = LANES * MAX_VECTORS;
+    static constexpr size_t BLOCK_FRAMES = 256;
+    static constexpr size_t NO_SECTION = static_cast<size_t>(-1);
+
+    // Consecutive active sections, group_sections_ per vector. Lane l of
+    // vector v is channel l % C of section v * (4 / C) + l / C.
+    struct Stage {
+        size_t vectors;
+        float coefficients[5][STAGE_LANES];     // b0, b1, b2, a1, a2
+        size_t section[STAGE_LANES];            // NO_SECTION for padding
+    };
+
+    void rebuild_stages();
+    void run_group(float* data, size_t frames, uint16_t first_channel);
+    void load_state(const Stage& stage, uint16_t first_channel, float* s1, float* s2) const;
+    void store_state(const Stage& stage, uint16_t first_channel, const float* s1, const float* s2);
+
+    uint16_t channels_;
+    uint16_t group_channels_;       // Channels per vector
+    size_t group_sections_;         // Sections per vector (4 / C)
+    bool stages_dirty_;
+    std::vector<BiquadCoefficients> coefficients_;
+    std::vector<Stage> stages_;
+    size_t stage_count_;
+    std::vector<float> state_;      // [section][channel] -> s1, s2
+    std::vector<float> scratch_;    // One block of one channel group
+};
+
+}} // namespace mp::core
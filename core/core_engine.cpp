@@ -55,6 +55,7 @@ Result CoreEngine::initialize() {
     viz_config.spectrum_max_freq = 20000.0f;
     viz_config.spectrum_smoothing = 0.75f;
     viz_config.vu_peak_decay_rate = 10.0f;
+    viz_config.vu_peak_hold_ms = 1000.0f;
     viz_config.vu_rms_window_ms = 100.0f;
     viz_config.update_rate_hz = 60;
     visualization_engine_->initialize(viz_config);
@@ -0,0 +1,100 @@
+﻿#include "crossfeed.h"
+#include <algorithm>
+#include <cmath>
+
+namespace mp {
+namespace core {
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+} // namespace
+
+Crossfeed::Crossfeed()
+    : sample_rate_(0.0f)
+    , cutoff_(DEFAULT_CUTOFF)
+    , feed_(DEFAULT_FEED) {
+}
+
+bool Crossfeed::configure(float sample_rate) {
+    if (sample_rate <= 0.0f) {
+        return false;
+    }
+    sample_rate_ = sample_rate;
+    direct_.configure(1, 2);
+    cross_.configure(1, 2);
+    cross_block_.assign(BLOCK_FRAMES * 2, 0.0f);
+    update();
+    return true;
+}
+
+void Crossfeed::set(float cutoff_hz, float feed_db) {
+    cutoff_ = cutoff_hz;
+    feed_ = feed_db;
+    if (sample_rate_ > 0.0f) {
+        update();
+    }
+}
+
+// bs2b's filter design. At DC the low-pass passes G_lo and the shelf
+// 1 - G_hi, G_lo / (1 - G_hi) is -feed dB, and the common gain brings their
+// sum back to 1. The shelf corner sits above the low-pass cutoff by the
+// level difference, at 12 dB per octave.
+void Crossfeed::update() {
+    double nyquist = 0.5 * sample_rate_;
+    double cutoff = std::max(10.0, std::min(static_cast<double>(cutoff_), 0.45 * nyquist));
+    double feed = std::max(0.0, static_cast<double>(feed_));
+
+    double gb_lo = feed * -5.0 / 6.0 - 3.0;
+    double gb_hi = feed / 6.0 - 3.0;
+    double g_lo = std::pow(10.0, gb_lo / 20.0);
+    double g_hi = 1.0 - std::pow(10.0, gb_hi / 20.0);
+    double cutoff_hi = cutoff * std::pow(2.0, (gb_lo - 20.0 * std::log10(g_hi)) / 12.0);
+    cutoff_hi = std::min(cutoff_hi, 0.9 * nyquist);
+    double gain = 1.0 / (1.0 - g_hi + g_lo);
+
+    BiquadCoefficients low;
+    double x = std::exp(-2.0 * PI * cutoff / sample_rate_);
+    low.b0 = static_cast<float>(gain * g_lo * (1.0 - x));
+    low.a1 = static_cast<float>(-x);
+    cross_.set_section(0, low);
+
+    BiquadCoefficients shelf;
+    x = std::exp(-2.0 * PI * cutoff_hi / sample_rate_);
+    shelf.b0 = static_cast<float>(gain * (1.0 - g_hi * (1.0 - x)));
+    shelf.b1 = static_cast<float>(gain * -x);
+    shelf.a1 = static_cast<float>(-x);
+    direct_.set_section(0, shelf);
+}
+
+void Crossfeed::reset() {
+    direct_.reset();
+    cross_.reset();
+}
+
+void Crossfeed::process(float* samples, size_t frames) {
+    if (sample_rate_ <= 0.0f) {
+        return;
+    }
+
+    float* cross = cross_block_.data();
+    for (size_t done = 0; done < frames; ) {
+        size_t block = std::min(BLOCK_FRAMES, frames - done);
+        float* x = samples + done * 2;
+
+        for (size_t f = 0; f < block; ++f) {
+            cross[2 * f] = x[2 * f + 1];
+            cross[2 * f + 1] = x[2 * f];
+        }
+        cross_.process(cross, block);
+        direct_.process(x, block);
+        for (size_t i = 0; i < 2 * block; ++i) {
+            x[i] += cross[i];
+        }
+
+        done += block;
+    }
+}
+
+}} // namespace mp::core
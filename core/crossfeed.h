@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include "biquad_cascade.h"
+#include <cstddef>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+// Bauer stereophonic-to-binaural crossfeed, as in bs2b. Each ear hears its
+// own channel through a first-order high-shelf boost plus the other channel
+// through a first-order low-pass, so low frequencies spread across the
+// head the way they do from speakers while highs stay put. The two paths
+// are scaled so a centred signal keeps its level at low frequencies.
+//
+// Both paths are BiquadCascade sections: the direct one over the stereo
+// block in place, the cross one over a channel-swapped copy. Minimum phase,
+// so there is no latency. Stereo only.
+class Crossfeed {
+public:
+    // bs2b's default: 700 Hz, opposite channel 4.5 dB down at DC
+    static constexpr float DEFAULT_CUTOFF = 700.0f;
+    static constexpr float DEFAULT_FEED = 4.5f;
+
+    Crossfeed();
+
+    // Allocates the cross-path block
+    bool configure(float sample_rate);
+
+    // cutoff of the cross low-pass in Hz; feed is how far below the direct
+    // path the opposite channel sits at DC, in dB (bs2b uses 1 to 15)
+    void set(float cutoff_hz, float feed_db);
+    float cutoff() const { return cutoff_; }
+    float feed() const { return feed_; }
+
+    void reset();
+
+    // In place, interleaved stereo; does not allocate
+    void process(float* samples, size_t frames);
+
+private:
+    static constexpr size_t BLOCK_FRAMES = 256;
+
+    void update();
+
+    float sample_rate_;
+    float cutoff_;
+    float feed_;
+    BiquadCascade direct_;
+    BiquadCascade cross_;
+    std::vector<float> cross_block_;
+};
+
+}} // namespace mp::core
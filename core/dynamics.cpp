@@ -0,0 +1,504 @@
+﻿#include "dynamics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifndef MP_DYNAMICS_SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MP_DYNAMICS_SSE2 1
+#else
+#define MP_DYNAMICS_SSE2 0
+#endif
+#endif
+
+#if MP_DYNAMICS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace mp {
+namespace core {
+
+namespace {
+
+const float PI = 3.14159265358979f;
+
+// 20 * log10(2) and its inverse: dB <-> log2
+const float DB_PER_OCTAVE = 6.02059991f;
+const float OCTAVES_PER_DB = 0.166096405f;
+
+// Levels below this (-180 dB) are treated as this, so log2 never sees zero
+const float LEVEL_FLOOR = 1e-9f;
+
+const float DENORMAL_THRESHOLD = 1e-30f;
+
+// Least-squares fits on [0, 1): log2(1 + t) = t * p(t) within 3e-5, and
+// 2^t = 1 + t * q(t) within 5e-6 relative. Well under 0.001 dB either way.
+const float LOG2_C1 = 1.44182512f;
+const float LOG2_C2 = -0.708674935f;
+const float LOG2_C3 = 0.415397767f;
+const float LOG2_C4 = -0.194390433f;
+const float LOG2_C5 = 0.0458707517f;
+
+const float EXP2_C1 = 0.693018562f;
+const float EXP2_C2 = 0.24140525f;
+const float EXP2_C3 = 0.0520729705f;
+const float EXP2_C4 = 0.0134940545f;
+
+// Time constant in ms to the fraction of the gap closed per frame
+float smoothing_step(float ms, float sample_rate) {
+    if (ms <= 0.0f || sample_rate <= 0.0f) {
+        return 1.0f;
+    }
+    return 1.0f - std::exp(-1000.0f / (ms * sample_rate));
+}
+
+// x > 0 and normal
+inline float fast_log2(float x) {
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    float exponent = static_cast<float>(static_cast<int32_t>(bits >> 23) - 127);
+    bits = (bits & 0x007fffffu) | 0x3f800000u;
+    float m;
+    std::memcpy(&m, &bits, sizeof(m));
+    float t = m - 1.0f;
+    float p = ((((LOG2_C5 * t + LOG2_C4) * t + LOG2_C3) * t + LOG2_C2) * t + LOG2_C1) * t;
+    return exponent + p;
+}
+
+inline float fast_exp2(float x) {
+    x = std::max(-126.0f, std::min(126.0f, x));
+    float whole = std::floor(x);
+    float t = x - whole;
+    float p = 1.0f + (((EXP2_C4 * t + EXP2_C3) * t + EXP2_C2) * t + EXP2_C1) * t;
+    uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(whole) + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+// Branch-free soft knee: 0 below the knee, slope * over above it, and a
+// quadratic joining the two inside it
+inline float knee_curve(float over, float slope, float half_width, float width,
+                        float inverse_double_width) {
+    float k = std::max(0.0f, std::min(width, over + half_width));
+    return slope * (k * k * inverse_double_width + std::max(0.0f, over - half_width));
+}
+
+#if MP_DYNAMICS_SSE2
+
+inline __m128 fast_log2(__m128 x) {
+    __m128i bits = _mm_castps_si128(x);
+    __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    __m128i mantissa = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+                                    _mm_set1_epi32(0x3f800000));
+    __m128 t = _mm_sub_ps(_mm_castsi128_ps(mantissa), _mm_set1_ps(1.0f));
+    __m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(LOG2_C5), t), _mm_set1_ps(LOG2_C4));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(LOG2_C3));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(LOG2_C2));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(LOG2_C1));
+    return _mm_add_ps(exponent, _mm_mul_ps(p, t));
+}
+
+inline __m128 fast_exp2(__m128 x) {
+    x = _mm_max_ps(_mm_set1_ps(-126.0f), _mm_min_ps(_mm_set1_ps(126.0f), x));
+    // Truncation rounds negatives up; step those back down to the floor
+    __m128 whole = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    whole = _mm_sub_ps(whole, _mm_and_ps(_mm_cmpgt_ps(whole, x), _mm_set1_ps(1.0f)));
+    __m128 t = _mm_sub_ps(x, whole);
+    __m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(EXP2_C4), t), _mm_set1_ps(EXP2_C3));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(EXP2_C2));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(EXP2_C1));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(1.0f));
+    __m128i scale = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(whole), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+}
+
+inline __m128 abs_ps(__m128 x) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+}
+
+#endif
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// EnvelopeFollower
+// ---------------------------------------------------------------------------
+
+EnvelopeFollower::EnvelopeFollower()
+    : channels_(1)
+    , attack_(1.0f)
+    , release_(1.0f) {
+    reset();
+}
+
+bool EnvelopeFollower::configure(uint16_t channels) {
+    if (channels == 0 || channels > MAX_CHANNELS) {
+        return false;
+    }
+    channels_ = channels;
+    reset();
+    return true;
+}
+
+void EnvelopeFollower::set_times(float attack_ms, float release_ms, float sample_rate) {
+    attack_ = smoothing_step(attack_ms, sample_rate);
+    release_ = smoothing_step(release_ms, sample_rate);
+}
+
+void EnvelopeFollower::reset(float value) {
+    std::fill(state_, state_ + MAX_CHANNELS, value);
+}
+
+void EnvelopeFollower::process(float* values, size_t frames) {
+    const size_t channels = channels_;
+
+#if MP_DYNAMICS_SSE2
+    const size_t vectors = (channels + 3) / 4;
+    const __m128 attack = _mm_set1_ps(attack_);
+    const __m128 release = _mm_set1_ps(release_);
+    const __m128 threshold = _mm_set1_ps(DENORMAL_THRESHOLD);
+    __m128 state[2] = {_mm_load_ps(state_), _mm_load_ps(state_ + 4)};
+
+    alignas(16) float frame[MAX_CHANNELS] = {};
+    for (size_t f = 0; f < frames; ++f) {
+        float* x = values + f * channels;
+        std::memcpy(frame, x, channels * sizeof(float));
+        for (size_t v = 0; v < vectors; ++v) {
+            __m128 target = _mm_load_ps(frame + 4 * v);
+            __m128 rising = _mm_cmpgt_ps(target, state[v]);
+            __m128 step = _mm_or_ps(_mm_and_ps(rising, attack), _mm_andnot_ps(rising, release));
+            __m128 s = _mm_add_ps(state[v], _mm_mul_ps(step, _mm_sub_ps(target, state[v])));
+            state[v] = _mm_and_ps(s, _mm_cmpge_ps(abs_ps(s), threshold));
+            _mm_store_ps(frame + 4 * v, state[v]);
+        }
+        std::memcpy(x, frame, channels * sizeof(float));
+    }
+
+    _mm_store_ps(state_, state[0]);
+    _mm_store_ps(state_ + 4, state[1]);
+#else
+    for (size_t f = 0; f < frames; ++f) {
+        float* x = values + f * channels;
+        for (size_t c = 0; c < channels; ++c) {
+            float s = state_[c];
+            float step = x[c] > s ? attack_ : release_;
+            s += step * (x[c] - s);
+            if (std::fabs(s) < DENORMAL_THRESHOLD) {
+                s = 0.0f;
+            }
+            state_[c] = s;
+            x[c] = s;
+        }
+    }
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Compressor
+// ---------------------------------------------------------------------------
+
+Compressor::Compressor()
+    : sample_rate_(48000.0f)
+    , channels_(0)
+    , threshold_(-20.0f)
+    , slope_(0.75f)
+    , knee_(0.0f)
+    , makeup_(0.0f)
+    , attack_ms_(10.0f)
+    , release_ms_(100.0f)
+    , last_reduction_(0.0f) {
+}
+
+bool Compressor::configure(float sample_rate, uint16_t channels) {
+    if (sample_rate <= 0.0f || !follower_.configure(channels)) {
+        return false;
+    }
+    sample_rate_ = sample_rate;
+    channels_ = channels;
+    scratch_.assign(BLOCK_FRAMES * channels, 0.0f);
+    follower_.set_times(attack_ms_, release_ms_, sample_rate_);
+    reset();
+    return true;
+}
+
+void Compressor::set_ratio(float ratio) {
+    slope_ = 1.0f - 1.0f / std::max(1.0f, ratio);
+}
+
+void Compressor::set_knee(float db) {
+    knee_ = std::max(0.0f, db);
+}
+
+void Compressor::set_times(float attack_ms, float release_ms) {
+    attack_ms_ = attack_ms;
+    release_ms_ = release_ms;
+    follower_.set_times(attack_ms_, release_ms_, sample_rate_);
+}
+
+float Compressor::gain_reduction_for(float level_db) const {
+    // A zero-width knee would divide by zero; a thousandth of a dB is hard
+    float width = std::max(knee_, 1e-3f);
+    return knee_curve(level_db - threshold_, slope_, 0.5f * width, width, 0.5f / width);
+}
+
+void Compressor::reset() {
+    follower_.reset();
+    last_reduction_ = 0.0f;
+}
+
+void Compressor::process(float* samples, size_t frames) {
+    if (channels_ == 0) {
+        return;
+    }
+
+    const size_t channels = channels_;
+    const float width = std::max(knee_, 1e-3f);
+    const float half_width = 0.5f * width;
+    const float inverse_double_width = 0.5f / width;
+    float* reduction = scratch_.data();
+    float largest = 0.0f;
+
+    for (size_t done = 0; done < frames; ) {
+        size_t block = std::min(BLOCK_FRAMES, frames - done);
+        size_t count = block * channels;
+        float* x = samples + done * channels;
+        size_t i = 0;
+
+        // Level in dB, then the static curve
+#if MP_DYNAMICS_SSE2
+        const __m128 floor = _mm_set1_ps(LEVEL_FLOOR);
+        const __m128 db_per_octave = _mm_set1_ps(DB_PER_OCTAVE);
+        const __m128 threshold = _mm_set1_ps(threshold_);
+        const __m128 slope = _mm_set1_ps(slope_);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 half = _mm_set1_ps(half_width);
+        const __m128 full = _mm_set1_ps(width);
+        const __m128 inverse = _mm_set1_ps(inverse_double_width);
+        for (; i + 4 <= count; i += 4) {
+            __m128 level = _mm_max_ps(abs_ps(_mm_loadu_ps(x + i)), floor);
+            __m128 over = _mm_sub_ps(_mm_mul_ps(fast_log2(level), db_per_octave), threshold);
+            __m128 k = _mm_max_ps(zero, _mm_min_ps(full, _mm_add_ps(over, half)));
+            __m128 above = _mm_max_ps(zero, _mm_sub_ps(over, half));
+            __m128 r = _mm_mul_ps(slope, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(k, k), inverse), above));
+            _mm_storeu_ps(reduction + i, r);
+        }
+#endif
+        for (; i < count; ++i) {
+            float level = std::max(std::fabs(x[i]), LEVEL_FLOOR);
+            float over = fast_log2(level) * DB_PER_OCTAVE - threshold_;
+            reduction[i] = knee_curve(over, slope_, half_width, width, inverse_double_width);
+        }
+
+        follower_.process(reduction, block);
+
+        // Link: every channel takes the frame's largest reduction
+        if (channels > 1) {
+            for (size_t f = 0; f < block; ++f) {
+                float* r = reduction + f * channels;
+                float m = r[0];
+                for (size_t c = 1; c < channels; ++c) {
+                    m = std::max(m, r[c]);
+                }
+                for (size_t c = 0; c < channels; ++c) {
+                    r[c] = m;
+                }
+                largest = std::max(largest, m);
+            }
+        } else {
+            for (size_t f = 0; f < block; ++f) {
+                largest = std::max(largest, reduction[f]);
+            }
+        }
+
+        // Gain = makeup - reduction, back to linear
+        i = 0;
+#if MP_DYNAMICS_SSE2
+        const __m128 makeup = _mm_set1_ps(makeup_);
+        const __m128 octaves_per_db = _mm_set1_ps(OCTAVES_PER_DB);
+        for (; i + 4 <= count; i += 4) {
+            __m128 db = _mm_sub_ps(makeup, _mm_loadu_ps(reduction + i));
+            __m128 gain = fast_exp2(_mm_mul_ps(db, octaves_per_db));
+            _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), gain));
+        }
+#endif
+        for (; i < count; ++i) {
+            x[i] *= fast_exp2((makeup_ - reduction[i]) * OCTAVES_PER_DB);
+        }
+
+        done += block;
+    }
+
+    last_reduction_ = largest;
+}
+
+// ---------------------------------------------------------------------------
+// LookaheadLimiter
+// ---------------------------------------------------------------------------
+
+LookaheadLimiter::LookaheadLimiter()
+    : sample_rate_(48000.0f)
+    , channels_(0)
+    , lookahead_(0)
+    , ramp_(0)
+    , ceiling_(1.0f)
+    , release_ms_(50.0f)
+    , release_(1.0f)
+    , gain_(1.0f)
+    , last_reduction_(0.0f)
+    , frame_(0)
+    , history_position_(0)
+    , delay_position_(0)
+    , held_front_(0)
+    , held_count_(0)
+    , ramp_position_(0)
+    , ramp_sum_(0.0) {
+    // Hann-windowed sinc at 1/4, 2/4 and 3/4 of the way from tap
+    // DETECTOR_DELAY - 1 to the next, each phase normalised to unity at DC
+    for (size_t p = 1; p < PHASES; ++p) {
+        float sum = 0.0f;
+        for (size_t k = 0; k < TAPS; ++k) {
+            float t = static_cast<float>(DETECTOR_DELAY - 1) +
+                      static_cast<float>(p) / PHASES - static_cast<float>(k);
+            float sinc = std::sin(PI * t) / (PI * t);
+            float window = 0.5f + 0.5f * std::cos(PI * t / (TAPS / 2));
+            interpolator_[p - 1][k] = sinc * window;
+            sum += sinc * window;
+        }
+        for (size_t k = 0; k < TAPS; ++k) {
+            interpolator_[p - 1][k] /= sum;
+        }
+    }
+}
+
+bool LookaheadLimiter::configure(float sample_rate, uint16_t channels, float lookahead_ms) {
+    if (sample_rate <= 0.0f || channels == 0 || channels > MAX_CHANNELS) {
+        return false;
+    }
+
+    sample_rate_ = sample_rate;
+    channels_ = channels;
+    size_t frames = static_cast<size_t>(std::lround(std::max(0.0f, lookahead_ms) * sample_rate / 1000.0f));
+    lookahead_ = std::max(frames, 2 * DETECTOR_DELAY);
+    ramp_ = lookahead_ - DETECTOR_DELAY;
+
+    history_.assign(TAPS * channels, 0.0f);
+    delay_.assign(lookahead_ * channels, 0.0f);
+    // The queue can hold one frame past the window until the front expires
+    held_.assign(ramp_ + 2, Held{0, 0.0f});
+    ramp_gains_.assign(ramp_, 1.0f);
+    set_release(release_ms_);
+    reset();
+    return true;
+}
+
+void LookaheadLimiter::set_ceiling(float db) {
+    ceiling_ = std::pow(10.0f, std::min(db, 0.0f) / 20.0f);
+}
+
+void LookaheadLimiter::set_release(float ms) {
+    release_ms_ = ms;
+    release_ = smoothing_step(ms, sample_rate_);
+}
+
+void LookaheadLimiter::reset() {
+    std::fill(history_.begin(), history_.end(), 0.0f);
+    std::fill(delay_.begin(), delay_.end(), 0.0f);
+    std::fill(ramp_gains_.begin(), ramp_gains_.end(), 1.0f);
+    history_position_ = 0;
+    delay_position_ = 0;
+    held_front_ = 0;
+    held_count_ = 0;
+    ramp_position_ = 0;
+    ramp_sum_ = static_cast<double>(ramp_);
+    gain_ = 1.0f;
+    frame_ = 0;
+    last_reduction_ = 0.0f;
+}
+
+// Writes the frame into the interpolator history and returns the true peak
+// DETECTOR_DELAY frames back: that sample and the points up to the next one
+float LookaheadLimiter::true_peak(const float* frame) {
+    float peak = 0.0f;
+    size_t position = history_position_;
+    for (size_t c = 0; c < channels_; ++c) {
+        float* ring = history_.data() + c * TAPS;
+        ring[position] = frame[c];
+
+        // Oldest first
+        float h[TAPS];
+        for (size_t k = 0; k < TAPS; ++k) {
+            h[k] = ring[(position + 1 + k) & (TAPS - 1)];
+        }
+
+        peak = std::max(peak, std::fabs(h[TAPS - 1 - DETECTOR_DELAY]));
+        for (size_t p = 0; p < PHASES - 1; ++p) {
+            float y = 0.0f;
+            for (size_t k = 0; k < TAPS; ++k) {
+                y += interpolator_[p][k] * h[k];
+            }
+            peak = std::max(peak, std::fabs(y));
+        }
+    }
+    history_position_ = (position + 1) & (TAPS - 1);
+    return peak;
+}
+
+// Largest peak of the last ramp_ + 1 frames
+float LookaheadLimiter::hold(float peak) {
+    const size_t capacity = held_.size();
+    while (held_count_ > 0 && held_[(held_front_ + held_count_ - 1) % capacity].peak <= peak) {
+        --held_count_;
+    }
+    held_[(held_front_ + held_count_) % capacity] = Held{frame_, peak};
+    ++held_count_;
+
+    if (held_[held_front_].frame + ramp_ + 1 <= frame_) {
+        held_front_ = (held_front_ + 1) % capacity;
+        --held_count_;
+    }
+    return held_[held_front_].peak;
+}
+
+// Moving average of the last ramp_ held gains
+float LookaheadLimiter::ramp(float gain) {
+    ramp_sum_ += gain - ramp_gains_[ramp_position_];
+    ramp_gains_[ramp_position_] = gain;
+    if (++ramp_position_ == ramp_) {
+        ramp_position_ = 0;
+    }
+    return static_cast<float>(ramp_sum_ / ramp_);
+}
+
+void LookaheadLimiter::process(float* samples, size_t frames) {
+    if (channels_ == 0) {
+        return;
+    }
+
+    const size_t channels = channels_;
+    float lowest = 1.0f;
+    for (size_t f = 0; f < frames; ++f) {
+        float* x = samples + f * channels;
+
+        float peak = hold(true_peak(x));
+        float target = ramp(ceiling_ / std::max(peak, ceiling_));
+        // Down at once (the ramp already shaped it), back up at the release rate
+        gain_ = std::min(target, gain_ + (target - gain_) * release_);
+        lowest = std::min(lowest, gain_);
+
+        float* delayed = delay_.data() + delay_position_ * channels;
+        for (size_t c = 0; c < channels; ++c) {
+            float y = delayed[c];
+            delayed[c] = x[c];
+            x[c] = y * gain_;
+        }
+        if (++delay_position_ == lookahead_) {
+            delay_position_ = 0;
+        }
+        ++frame_;
+    }
+
+    last_reduction_ = -20.0f * std::log10(lowest);
+}
+
+}} // namespace mp::core
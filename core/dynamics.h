@@ -0,0 +1,171 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+// Attack/release smoothing of interleaved control signals, one state per
+// channel. A value above the state moves it at the attack rate, anything
+// else at the release rate; the choice is a mask, not a branch. With SSE2 a
+// vector holds four channels, so up to four channels advance one frame per
+// step.
+class EnvelopeFollower {
+public:
+    static constexpr uint16_t MAX_CHANNELS = 8;
+
+    EnvelopeFollower();
+
+    // Does not allocate; false for 0 or more than MAX_CHANNELS channels
+    bool configure(uint16_t channels);
+    uint16_t channels() const { return channels_; }
+
+    // Time constants: a step covers 1 - 1/e of the way in that time.
+    // 0 ms follows instantly.
+    void set_times(float attack_ms, float release_ms, float sample_rate);
+
+    void reset(float value = 0.0f);
+    float state(uint16_t channel) const { return state_[channel]; }
+
+    // In place, interleaved, channels() values per frame
+    void process(float* values, size_t frames);
+
+private:
+    uint16_t channels_;
+    float attack_;                          // Fraction of the gap closed per frame
+    float release_;
+    alignas(16) float state_[MAX_CHANNELS];
+};
+
+// Feed-forward compressor with a soft knee, in the decoupled log-domain
+// layout: the gain computer maps each sample's level in dB to a gain
+// reduction, and an EnvelopeFollower smooths the reduction, so attack and
+// release do not depend on the ratio. Channels are followed separately and
+// linked by taking the largest reduction, which keeps the stereo image
+// still.
+//
+// Works in blocks of BLOCK_FRAMES. The level, gain computer and gain passes
+// run over the interleaved block as flat arrays (SSE2 when available, with
+// polynomial log2/exp2), so their cost does not depend on the channel count.
+// No look-ahead: zero latency.
+class Compressor {
+public:
+    static constexpr uint16_t MAX_CHANNELS = EnvelopeFollower::MAX_CHANNELS;
+
+    Compressor();
+
+    // Allocates the block scratch
+    bool configure(float sample_rate, uint16_t channels);
+    uint16_t channels() const { return channels_; }
+
+    void set_threshold(float db) { threshold_ = db; }
+    void set_ratio(float ratio);            // >= 1
+    void set_knee(float db);                // Width, 0 for a hard knee
+    void set_makeup(float db) { makeup_ = db; }
+    void set_times(float attack_ms, float release_ms);
+
+    // Static curve, without smoothing: reduction in dB for a level in dB
+    float gain_reduction_for(float level_db) const;
+
+    void reset();
+
+    // In place, interleaved; does not allocate
+    void process(float* samples, size_t frames);
+
+    // Largest reduction during the last process() call, in dB
+    float gain_reduction() const { return last_reduction_; }
+
+private:
+    static constexpr size_t BLOCK_FRAMES = 64;
+
+    float sample_rate_;
+    uint16_t channels_;
+    float threshold_;
+    float slope_;                           // 1 - 1 / ratio
+    float knee_;
+    float makeup_;
+    float attack_ms_;
+    float release_ms_;
+    float last_reduction_;
+    EnvelopeFollower follower_;
+    std::vector<float> scratch_;            // One block, interleaved
+};
+
+// Brick-wall limiter on true peak. Each frame's peak is the largest of its
+// samples and of the three points between each sample and the next,
+// interpolated by a 4x polyphase FIR as in ITU-R BS.1770. The gain each
+// peak needs goes through a sliding-window minimum (a monotonic queue in a
+// ring buffer) one frame longer than the gain ramp, then a moving average
+// as long as the ramp. The gain therefore reaches its target exactly when
+// the peak leaves the delay line, and ramps down to it without steps.
+// Recovery is a one-pole release.
+//
+// Latency is exactly latency() frames: the ramp plus the interpolator's
+// DETECTOR_DELAY.
+class LookaheadLimiter {
+public:
+    static constexpr uint16_t MAX_CHANNELS = 8;
+    static constexpr size_t DETECTOR_DELAY = 8;
+
+    LookaheadLimiter();
+
+    // Allocates the delay lines. The look-ahead is rounded to frames and is
+    // at least 2 * DETECTOR_DELAY.
+    bool configure(float sample_rate, uint16_t channels, float lookahead_ms);
+    uint16_t channels() const { return channels_; }
+    size_t latency() const { return lookahead_; }
+
+    void set_ceiling(float db);             // dBTP
+    void set_release(float ms);
+
+    void reset();
+
+    // In place, interleaved; does not allocate
+    void process(float* samples, size_t frames);
+
+    // Largest reduction during the last process() call, in dB
+    float gain_reduction() const { return last_reduction_; }
+
+private:
+    static constexpr size_t TAPS = 16;      // Per phase
+    static constexpr size_t PHASES = 4;
+
+    struct Held {
+        size_t frame;
+        float peak;
+    };
+
+    float true_peak(const float* frame);
+    float hold(float peak);
+    float ramp(float gain);
+
+    float sample_rate_;
+    uint16_t channels_;
+    size_t lookahead_;
+    size_t ramp_;                           // lookahead_ - DETECTOR_DELAY
+    float ceiling_;                         // Linear
+    float release_ms_;
+    float release_;                         // Fraction of the gap closed per frame
+    float gain_;
+    float last_reduction_;
+    size_t frame_;                          // Frames seen since reset()
+
+    float interpolator_[PHASES - 1][TAPS];
+    std::vector<float> history_;            // TAPS frames per channel, [channel][tap]
+    size_t history_position_;
+
+    std::vector<float> delay_;              // lookahead_ frames, interleaved
+    size_t delay_position_;
+
+    std::vector<Held> held_;                // Monotonic queue over ramp_ + 1 frames
+    size_t held_front_;
+    size_t held_count_;
+
+    std::vector<float> ramp_gains_;         // Last ramp_ held gains
+    size_t ramp_position_;
+    double ramp_sum_;
+};
+
+}} // namespace mp::core
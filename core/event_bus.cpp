@@ -5,9 +5,28 @@
 namespace mp {
 namespace core {
 
-EventBus::EventBus()
-    : running_(false)
+namespace {
+
+uint64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+}
+
+} // namespace
+
+EventBus::EventBus(size_t capacity)
+    : subscribers_(std::make_shared<SubscriberTable>())
+    , queue_(capacity)
+    , slot_count_(0)
+    , published_(0)
+    , coalesced_(0)
+    , dropped_(0)
+    , dispatched_(0)
+    , batches_(0)
+    , running_(false)
     , next_handle_(1) {
+    coalesce(EVENT_POSITION_CHANGED);
 }
 
 EventBus::~EventBus() {
@@ -23,11 +42,14 @@ void EventBus::start() {
 }
 
 void EventBus::stop() {
-    if (!running_.exchange(false)) {
-        return; // Not running
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        if (!running_.exchange(false)) {
+            return; // Not running
+        }
     }
     
-    queue_cv_.notify_all();
+    wait_cv_.notify_all();
     
     if (worker_thread_.joinable()) {
         worker_thread_.join();
@@ -44,8 +66,11 @@ SubscriptionHandle EventBus::subscribe(EventID event_id, EventCallback callback)
     sub.event_id = event_id;
     sub.callback = std::move(callback);
     
-    subscriptions_[handle] = std::move(sub);
-    event_map_[event_id].push_back(handle);
+    // Dispatch in progress keeps the table it started with
+    auto table = std::make_shared<SubscriberTable>(*subscribers_);
+    (*table)[event_id].push_back(std::move(sub));
+    subscribers_ = std::move(table);
+    handles_[handle] = event_id;
     
     return handle;
 }
@@ -53,95 +78,187 @@ SubscriptionHandle EventBus::subscribe(EventID event_id, EventCallback callback)
 Result EventBus::unsubscribe(SubscriptionHandle handle) {
     std::lock_guard<std::mutex> lock(subscription_mutex_);
     
-    auto it = subscriptions_.find(handle);
-    if (it == subscriptions_.end()) {
+    auto it = handles_.find(handle);
+    if (it == handles_.end()) {
         return Result::InvalidParameter;
     }
     
-    EventID event_id = it->second.event_id;
-    subscriptions_.erase(it);
+    EventID event_id = it->second;
+    handles_.erase(it);
     
-    // Remove from event map
-    auto& handles = event_map_[event_id];
-    handles.erase(std::remove(handles.begin(), handles.end(), handle), handles.end());
+    auto table = std::make_shared<SubscriberTable>(*subscribers_);
+    auto& subs = (*table)[event_id];
+    subs.erase(std::remove_if(subs.begin(), subs.end(),
+                              [handle](const Subscription& sub) { return sub.handle == handle; }),
+               subs.end());
     
-    if (handles.empty()) {
-        event_map_.erase(event_id);
+    if (subs.empty()) {
+        table->erase(event_id);
     }
+    subscribers_ = std::move(table);
     
     return Result::Success;
 }
 
+bool EventBus::coalesce(EventID event_id) {
+    std::lock_guard<std::mutex> lock(subscription_mutex_);
+    
+    uint32_t count = slot_count_.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (slots_[i].event_id.load(std::memory_order_relaxed) == event_id) {
+            return true;
+        }
+    }
+    if (count == MAX_COALESCED) {
+        return false;
+    }
+    
+    slots_[count].event_id.store(event_id, std::memory_order_relaxed);
+    slot_count_.store(count + 1, std::memory_order_release);
+    return true;
+}
+
 Result EventBus::publish(const Event& event) {
+    // Real-time safe: no locks, no allocation, a bounded number of steps
     Event evt = event;
-    evt.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::system_clock::now().time_since_epoch()
-    ).count();
+    evt.timestamp = now_ms();
     
-    {
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        event_queue_.push(evt);
+    uint32_t count = slot_count_.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; ++i) {
+        CoalescingSlot& slot = slots_[i];
+        if (slot.event_id.load(std::memory_order_relaxed) != evt.id) {
+            continue;
+        }
+        
+        // Store the latest value; a publish of the same ID already writing
+        // it wins, theirs is as recent as ours
+        uint64_t seq = slot.sequence.load(std::memory_order_relaxed);
+        if ((seq & 1) == 0 &&
+            slot.sequence.compare_exchange_strong(seq, seq + 1, std::memory_order_relaxed)) {
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.data.store(reinterpret_cast<uintptr_t>(evt.data), std::memory_order_relaxed);
+            slot.data_size.store(evt.data_size, std::memory_order_relaxed);
+            slot.timestamp.store(evt.timestamp, std::memory_order_relaxed);
+            slot.sequence.store(seq + 2, std::memory_order_release);
+        }
+        
+        // Queued already: the worker reads the value when it gets there
+        if (slot.queued.exchange(true, std::memory_order_acq_rel)) {
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+            published_.fetch_add(1, std::memory_order_relaxed);
+            return Result::Success;
+        }
+        if (!queue_.push(QueuedEvent{evt, i})) {
+            slot.queued.store(false, std::memory_order_release);
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return Result::Error;
+        }
+        published_.fetch_add(1, std::memory_order_relaxed);
+        return Result::Success;
     }
     
-    queue_cv_.notify_one();
+    if (!queue_.push(QueuedEvent{evt, NO_SLOT})) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return Result::Error;
+    }
+    published_.fetch_add(1, std::memory_order_relaxed);
     return Result::Success;
 }
 
 Result EventBus::publish_sync(const Event& event) {
     Event evt = event;
-    evt.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::system_clock::now().time_since_epoch()
-    ).count();
+    evt.timestamp = now_ms();
     
-    dispatch_event(evt);
+    dispatch_event(evt, *subscribers());
     return Result::Success;
 }
 
-void EventBus::process_events() {
-    while (running_) {
-        Event event;
-        
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            queue_cv_.wait(lock, [this] { return !event_queue_.empty() || !running_; });
-            
-            if (!running_) {
-                break;
-            }
-            
-            if (event_queue_.empty()) {
-                continue;
-            }
-            
-            event = event_queue_.front();
-            event_queue_.pop();
+EventBusStats EventBus::get_stats() const {
+    EventBusStats stats;
+    stats.published = published_.load(std::memory_order_relaxed);
+    stats.coalesced = coalesced_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.dispatched = dispatched_.load(std::memory_order_relaxed);
+    stats.batches = batches_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::shared_ptr<const EventBus::SubscriberTable> EventBus::subscribers() const {
+    std::lock_guard<std::mutex> lock(subscription_mutex_);
+    return subscribers_;
+}
+
+void EventBus::read_slot(uint32_t index, Event& event) {
+    CoalescingSlot& slot = slots_[index];
+    
+    // Ours from now on: a publish after this queues the ID again
+    slot.queued.exchange(false, std::memory_order_acq_rel);
+    
+    for (;;) {
+        const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();  // Publish in progress
+            continue;
         }
         
-        dispatch_event(event);
+        event.data = reinterpret_cast<void*>(slot.data.load(std::memory_order_relaxed));
+        event.data_size = slot.data_size.load(std::memory_order_relaxed);
+        event.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+        
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before) {
+            return;
+        }
     }
 }
 
-void EventBus::dispatch_event(const Event& event) {
-    std::vector<EventCallback> callbacks;
+void EventBus::process_events() {
+    std::vector<QueuedEvent> batch(BATCH_SIZE);
+    int idle_polls = 0;
+    int idle_wait_ms = 1;
     
-    {
-        std::lock_guard<std::mutex> lock(subscription_mutex_);
+    while (running_) {
+        size_t count = queue_.pop(batch.data(), batch.size());
+        if (count == 0) {
+            // Under load the next event is usually a yield away; after that
+            // back off, with at most MAX_IDLE_WAIT_MS of latency for the
+            // first event after a quiet spell
+            if (++idle_polls <= IDLE_YIELDS) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(wait_mutex_);
+            wait_cv_.wait_for(lock, std::chrono::milliseconds(idle_wait_ms), [this] { return !running_; });
+            idle_wait_ms = std::min(idle_wait_ms * 2, MAX_IDLE_WAIT_MS);
+            continue;
+        }
+        idle_polls = 0;
+        idle_wait_ms = 1;
         
-        auto it = event_map_.find(event.id);
-        if (it != event_map_.end()) {
-            for (SubscriptionHandle handle : it->second) {
-                auto sub_it = subscriptions_.find(handle);
-                if (sub_it != subscriptions_.end()) {
-                    callbacks.push_back(sub_it->second.callback);
-                }
+        // One subscriber snapshot for the whole batch
+        std::shared_ptr<const SubscriberTable> table = subscribers();
+        for (size_t i = 0; i < count; ++i) {
+            Event& event = batch[i].event;
+            if (batch[i].slot != NO_SLOT) {
+                read_slot(batch[i].slot, event);
             }
+            dispatch_event(event, *table);
         }
+        
+        dispatched_.fetch_add(count, std::memory_order_relaxed);
+        batches_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void EventBus::dispatch_event(const Event& event, const SubscriberTable& table) {
+    auto it = table.find(event.id);
+    if (it == table.end()) {
+        return;
     }
     
-    // Call callbacks outside of lock
-    for (const auto& callback : callbacks) {
+    for (const auto& sub : it->second) {
         try {
-            callback(event);
+            sub.callback(event);
         } catch (...) {
             // Ignore exceptions in event handlers
         }
@@ -1,10 +1,11 @@
 ﻿#pragma once
 
 #include "mp_event.h"
+#include "mpsc_ring_buffer.h"
 #include <vector>
 #include <unordered_map>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <condition_variable>
 #include <atomic>
@@ -19,10 +20,36 @@ struct Subscription {
     EventCallback callback;
 };
 
+// Counters since construction
+struct EventBusStats {
+    uint64_t published;         // Accepted by publish()
+    uint64_t coalesced;         // Folded into a pending event of the same ID
+    uint64_t dropped;           // Refused: queue full or contended
+    uint64_t dispatched;        // Events delivered by the worker
+    uint64_t batches;           // Worker wake-ups that found events
+};
+
 // Event bus implementation
+//
+// publish() is wait-free and safe from the audio thread (fill_buffer): it
+// stamps the event and pushes it into a bounded MPSC ring without locking
+// or allocating, and returns Result::Error when the ring is full. The
+// worker thread started by start() drains the ring in batches and calls the
+// subscribers against one snapshot per batch.
+//
+// Events registered with coalesce() (position ticks, meter updates) keep
+// only their latest value: while one is queued and not yet dispatched, a
+// newer publish replaces it instead of taking another slot, so a fast
+// producer cannot flood the ring. Only the newest data pointer is
+// delivered, so it must stay valid until then, as for any async event.
+//
+// The subscriber table is immutable. subscribe() and unsubscribe() build a
+// new one and swap it in; dispatch holds a reference to the table it
+// started with and never copies callbacks.
 class EventBus : public IEventBus {
 public:
-    EventBus();
+    // capacity: queued events, rounded up to a power of two
+    explicit EventBus(size_t capacity = DEFAULT_CAPACITY);
     ~EventBus() override;
     
     // IEventBus implementation
@@ -31,21 +58,70 @@ public:
     Result publish(const Event& event) override;
     Result publish_sync(const Event& event) override;
     
+    // Coalesce queued events with this ID. Up to MAX_COALESCED IDs; false
+    // when the table is full. EVENT_POSITION_CHANGED is coalesced from the
+    // start.
+    bool coalesce(EventID event_id);
+    
+    EventBusStats get_stats() const;
+    
     // Lifecycle
     void start();
     void stop();
     
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+    static constexpr size_t MAX_COALESCED = 16;
+    
 private:
+    using SubscriberTable = std::unordered_map<EventID, std::vector<Subscription>>;
+    
+    // Ring entry: an event, or a marker for a coalescing slot
+    struct QueuedEvent {
+        Event event;
+        uint32_t slot;          // NO_SLOT for plain events
+    };
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+    
+    // Latest event for one coalesced ID, under a sequence lock. Writers
+    // that find another publish in progress give up theirs.
+    struct CoalescingSlot {
+        std::atomic<EventID> event_id{0};
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<uintptr_t> data{0};
+        std::atomic<size_t> data_size{0};
+        std::atomic<uint64_t> timestamp{0};
+        std::atomic<bool> queued{false};
+    };
+    
     void process_events();
-    void dispatch_event(const Event& event);
+    // Takes the latest value of a coalescing slot into event
+    void read_slot(uint32_t index, Event& event);
+    std::shared_ptr<const SubscriberTable> subscribers() const;
+    static void dispatch_event(const Event& event, const SubscriberTable& table);
+    
+    static constexpr size_t BATCH_SIZE = 256;
+    static constexpr int IDLE_YIELDS = 64;
+    static constexpr int MAX_IDLE_WAIT_MS = 16;
+    
+    // Written under subscription_mutex_; readers copy the pointer
+    std::shared_ptr<const SubscriberTable> subscribers_;
+    std::unordered_map<SubscriptionHandle, EventID> handles_;
+    mutable std::mutex subscription_mutex_;
+    
+    MpscRingBuffer<QueuedEvent> queue_;
+    CoalescingSlot slots_[MAX_COALESCED];
+    std::atomic<uint32_t> slot_count_;
     
-    std::unordered_map<SubscriptionHandle, Subscription> subscriptions_;
-    std::unordered_map<EventID, std::vector<SubscriptionHandle>> event_map_;
-    std::mutex subscription_mutex_;
+    std::atomic<uint64_t> published_;
+    std::atomic<uint64_t> coalesced_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> dispatched_;
+    std::atomic<uint64_t> batches_;
     
-    std::queue<Event> event_queue_;
-    std::mutex queue_mutex_;
-    std::condition_variable queue_cv_;
+    // The worker polls, backing off while idle; publish() never wakes it,
+    // since a wake-up is a system call the audio thread must not make
+    std::mutex wait_mutex_;
+    std::condition_variable wait_cv_;
     
     std::thread worker_thread_;
     std::atomic<bool> running_;
@@ -0,0 +1,305 @@
+﻿#include "fdn_reverb.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifndef MP_FDN_SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MP_FDN_SSE2 1
+#else
+#define MP_FDN_SSE2 0
+#endif
+#endif
+
+#if MP_FDN_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace mp {
+namespace core {
+
+namespace {
+
+// State below this is flushed so decaying tails never reach denormals
+const float DENORMAL_THRESHOLD = 1e-30f;
+
+// Line lengths at room_size 0.5, spread so 8 lines take every other one
+const double LINE_MS[FdnReverb::MAX_LINES] = {
+    29.7, 37.1, 41.1, 43.7, 47.9, 53.3, 59.1, 61.3,
+    67.1, 71.9, 73.7, 79.3, 83.9, 89.1, 97.3, 101.9
+};
+
+const size_t ALIGN_FLOATS = 16;
+
+bool is_prime(size_t n) {
+    if (n < 2) return false;
+    for (size_t d = 2; d * d <= n; ++d) {
+        if (n % d == 0) return false;
+    }
+    return true;
+}
+
+// Sign of entry (row, column) of the Sylvester Hadamard matrix
+float hadamard_sign(size_t row, size_t column) {
+    size_t bits = row & column;
+    size_t parity = 0;
+    while (bits) {
+        parity ^= bits & 1;
+        bits >>= 1;
+    }
+    return parity ? -1.0f : 1.0f;
+}
+
+#if MP_FDN_SSE2
+
+inline __m128 flush_denormals(__m128 v) {
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 tiny = _mm_cmplt_ps(_mm_and_ps(v, abs_mask), _mm_set1_ps(DENORMAL_THRESHOLD));
+    return _mm_andnot_ps(tiny, v);
+}
+
+inline float horizontal_sum(__m128 v) {
+    __m128 high = _mm_movehl_ps(v, v);
+    __m128 sum = _mm_add_ps(v, high);
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+// Butterflies of stride 1 and 2 within one vector
+inline __m128 hadamard4(__m128 v) {
+    const __m128 odd_negative = _mm_set_ps(-1.0f, 1.0f, -1.0f, 1.0f);
+    const __m128 high_negative = _mm_set_ps(-1.0f, -1.0f, 1.0f, 1.0f);
+    __m128 swapped = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm_add_ps(swapped, _mm_mul_ps(v, odd_negative));
+    swapped = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2));
+    return _mm_add_ps(swapped, _mm_mul_ps(v, high_negative));
+}
+
+#endif
+
+} // namespace
+
+FdnReverb::FdnReverb()
+    : sample_rate_(44100.0)
+    , channels_(0)
+    , lines_(0)
+    , rt60_(1.5f)
+    , damping_(0.5f)
+    , input_gain_(0.0f)
+    , base_(0) {
+    std::fill(std::begin(offset_), std::end(offset_), 0);
+    std::fill(std::begin(length_), std::end(length_), 0);
+    std::fill(std::begin(position_), std::end(position_), 0);
+    std::fill(std::begin(gain_), std::end(gain_), 0.0f);
+    std::fill(std::begin(pole_), std::end(pole_), 0.0f);
+    std::fill(std::begin(state_), std::end(state_), 0.0f);
+    std::memset(taps_, 0, sizeof(taps_));
+    std::fill(std::begin(block_), std::end(block_), 0.0f);
+}
+
+void FdnReverb::configure(double sample_rate, uint16_t channels, size_t lines, float room_size) {
+    sample_rate_ = sample_rate > 0.0 ? sample_rate : 44100.0;
+    channels_ = std::max<uint16_t>(1, std::min(channels, MAX_CHANNELS));
+    lines_ = lines > 8 ? MAX_LINES : 8;
+
+    // Mutually prime lengths, none shorter than a block
+    double scale = 0.5 + std::min(std::max(room_size, 0.0f), 1.0f);
+    size_t stride = MAX_LINES / lines_;
+    size_t total = 0;
+    for (size_t i = 0; i < lines_; ++i) {
+        size_t length = static_cast<size_t>(LINE_MS[i * stride] * scale * sample_rate_ / 1000.0);
+        length = std::max(length, BLOCK_FRAMES);
+        while (!is_prime(length) || std::find(length_, length_ + i, length) != length_ + i) {
+            ++length;
+        }
+        length_[i] = length;
+        offset_[i] = total;
+        total += (length + ALIGN_FLOATS - 1) / ALIGN_FLOATS * ALIGN_FLOATS;
+    }
+
+    storage_.assign(total + ALIGN_FLOATS, 0.0f);
+    uintptr_t address = reinterpret_cast<uintptr_t>(storage_.data());
+    uintptr_t alignment = ALIGN_FLOATS * sizeof(float);
+    base_ = ((alignment - address % alignment) % alignment) / sizeof(float);
+
+    // Channel c reads through Hadamard row c + 1; row 0 would be the same
+    // sum for every channel
+    std::memset(taps_, 0, sizeof(taps_));
+    for (uint16_t c = 0; c < channels_; ++c) {
+        size_t row = c % (lines_ - 1) + 1;
+        for (size_t i = 0; i < lines_; ++i) {
+            taps_[c][i] = hadamard_sign(row, i);
+        }
+    }
+
+    // Each channel feeds lines_ / channels_ lines
+    input_gain_ = static_cast<float>(std::sqrt(static_cast<double>(channels_) / lines_));
+
+    update_gains();
+    reset();
+}
+
+void FdnReverb::set_decay(float rt60_seconds, float damping) {
+    rt60_ = std::max(rt60_seconds, 0.05f);
+    damping_ = std::min(std::max(damping, 0.0f), 1.0f);
+    update_gains();
+}
+
+void FdnReverb::update_gains() {
+    if (lines_ == 0) {
+        return;
+    }
+
+    double mean_length = 0.0;
+    for (size_t i = 0; i < lines_; ++i) {
+        mean_length += static_cast<double>(length_[i]) / lines_;
+    }
+
+    // -60 dB after rt60 seconds, whatever the length of the line. The
+    // matrix normalisation is folded into the gain.
+    double normalise = 1.0 / std::sqrt(static_cast<double>(lines_));
+    for (size_t i = 0; i < lines_; ++i) {
+        double decay = std::pow(10.0, -3.0 * length_[i] / (rt60_ * sample_rate_));
+        gain_[i] = static_cast<float>(decay * normalise);
+
+        // Longer lines are filtered less often, so they get a stronger pole
+        double pole = 0.85 * damping_ * length_[i] / mean_length;
+        pole_[i] = static_cast<float>(std::min(pole, 0.95));
+    }
+}
+
+void FdnReverb::reset() {
+    std::fill(storage_.begin(), storage_.end(), 0.0f);
+    std::fill(std::begin(position_), std::end(position_), 0);
+    std::fill(std::begin(state_), std::end(state_), 0.0f);
+}
+
+void FdnReverb::process(float* samples, size_t frames) {
+    if (lines_ == 0 || !samples) {
+        return;
+    }
+
+    for (size_t offset = 0; offset < frames; offset += BLOCK_FRAMES) {
+        size_t count = std::min(BLOCK_FRAMES, frames - offset);
+        run_block(samples + offset * channels_, count);
+    }
+}
+
+void FdnReverb::run_block(float* samples, size_t frames) {
+    float* lines = storage_.data() + base_;
+
+    // Every line is at least a block long, so the whole block's outputs were
+    // written before this block
+    for (size_t i = 0; i < lines_; ++i) {
+        const float* line = lines + offset_[i];
+        size_t position = position_[i];
+        for (size_t t = 0; t < frames; ++t) {
+            block_[t * lines_ + i] = line[position];
+            if (++position == length_[i]) {
+                position = 0;
+            }
+        }
+    }
+
+    for (size_t t = 0; t < frames; ++t) {
+        run_frame(block_ + t * lines_, samples + t * channels_);
+    }
+
+    for (size_t i = 0; i < lines_; ++i) {
+        float* line = lines + offset_[i];
+        size_t position = position_[i];
+        for (size_t t = 0; t < frames; ++t) {
+            line[position] = block_[t * lines_ + i];
+            if (++position == length_[i]) {
+                position = 0;
+            }
+        }
+        position_[i] = position;
+    }
+}
+
+// y holds the line outputs on entry and the line inputs on return; frame is
+// the dry input on entry and the wet output on return
+void FdnReverb::run_frame(float* y, float* frame) {
+    alignas(16) float input[MAX_LINES];
+    for (size_t i = 0; i < lines_; ++i) {
+        input[i] = frame[i % channels_] * input_gain_;
+    }
+
+#if MP_FDN_SSE2
+    const size_t vectors = lines_ / 4;
+    __m128 v[MAX_LINES / 4];
+
+    for (size_t k = 0; k < vectors; ++k) {
+        __m128 x = _mm_load_ps(y + 4 * k);
+        __m128 s = _mm_load_ps(state_ + 4 * k);
+        s = _mm_add_ps(x, _mm_mul_ps(_mm_load_ps(pole_ + 4 * k), _mm_sub_ps(s, x)));
+        s = flush_denormals(s);
+        _mm_store_ps(state_ + 4 * k, s);
+        v[k] = _mm_mul_ps(s, _mm_load_ps(gain_ + 4 * k));
+    }
+
+    for (uint16_t c = 0; c < channels_; ++c) {
+        __m128 sum = _mm_mul_ps(v[0], _mm_load_ps(taps_[c]));
+        for (size_t k = 1; k < vectors; ++k) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(v[k], _mm_load_ps(taps_[c] + 4 * k)));
+        }
+        frame[c] = horizontal_sum(sum);
+    }
+
+    // Strides 1 and 2 in lanes, then 4 and 8 across vectors
+    for (size_t k = 0; k < vectors; ++k) {
+        v[k] = hadamard4(v[k]);
+    }
+    for (size_t h = 1; h < vectors; h *= 2) {
+        for (size_t k = 0; k < vectors; k += 2 * h) {
+            for (size_t j = k; j < k + h; ++j) {
+                __m128 a = v[j];
+                __m128 b = v[j + h];
+                v[j] = _mm_add_ps(a, b);
+                v[j + h] = _mm_sub_ps(a, b);
+            }
+        }
+    }
+
+    for (size_t k = 0; k < vectors; ++k) {
+        __m128 next = _mm_add_ps(v[k], _mm_load_ps(input + 4 * k));
+        _mm_store_ps(y + 4 * k, flush_denormals(next));
+    }
+#else
+    for (size_t i = 0; i < lines_; ++i) {
+        float s = y[i] + pole_[i] * (state_[i] - y[i]);
+        if (std::fabs(s) < DENORMAL_THRESHOLD) {
+            s = 0.0f;
+        }
+        state_[i] = s;
+        y[i] = s * gain_[i];
+    }
+
+    for (uint16_t c = 0; c < channels_; ++c) {
+        float sum = 0.0f;
+        for (size_t i = 0; i < lines_; ++i) {
+            sum += taps_[c][i] * y[i];
+        }
+        frame[c] = sum;
+    }
+
+    for (size_t h = 1; h < lines_; h *= 2) {
+        for (size_t k = 0; k < lines_; k += 2 * h) {
+            for (size_t j = k; j < k + h; ++j) {
+                float a = y[j];
+                float b = y[j + h];
+                y[j] = a + b;
+                y[j + h] = a - b;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < lines_; ++i) {
+        float next = y[i] + input[i];
+        y[i] = std::fabs(next) < DENORMAL_THRESHOLD ? 0.0f : next;
+    }
+#endif
+}
+
+}} // namespace mp::core
@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+// Feedback delay network reverb tail over interleaved audio.
+//
+// 8 or 16 delay lines of mutually prime length are fed back through a
+// normalised Hadamard matrix. Each line has a one-pole lowpass for high
+// frequency damping and a gain set from the decay time. All lines live in
+// one aligned block. Processing runs in blocks no longer than the shortest
+// line: the block's line outputs are gathered first, then one frame at a
+// time is damped, tapped and mixed across all lines at once, with SSE2
+// where available.
+//
+// Channel c drives lines c, c + C, ... and reads every line through its own
+// Hadamard row, so the channels come out decorrelated.
+//
+// Not thread-safe: call set_decay() between process() calls.
+class FdnReverb {
+public:
+    static constexpr size_t MAX_LINES = 16;
+    static constexpr uint16_t MAX_CHANNELS = 8;
+
+    FdnReverb();
+
+    // Allocates. lines is 8 or 16; room_size (0..1) scales the line lengths.
+    // Keeps the current decay settings and clears the tail.
+    void configure(double sample_rate, uint16_t channels, size_t lines = 8, float room_size = 0.5f);
+
+    // Broadband RT60 in seconds and high frequency damping (0..1)
+    void set_decay(float rt60_seconds, float damping);
+
+    void reset();
+
+    // Replaces the input with the reverb tail (wet only), in place
+    void process(float* samples, size_t frames);
+
+    size_t lines() const { return lines_; }
+    uint16_t channels() const { return channels_; }
+    size_t delay_length(size_t line) const { return length_[line]; }
+
+private:
+    static constexpr size_t BLOCK_FRAMES = 64;
+
+    void update_gains();
+    void run_block(float* samples, size_t frames);
+    void run_frame(float* y, float* frame);
+
+    double sample_rate_;
+    uint16_t channels_;
+    size_t lines_;
+    float rt60_;
+    float damping_;
+    float input_gain_;
+
+    std::vector<float> storage_;            // Every line, each 64-byte aligned
+    size_t base_;                           // First aligned float in storage_
+    size_t offset_[MAX_LINES];
+    size_t length_[MAX_LINES];
+    size_t position_[MAX_LINES];            // Read and write index, shared
+
+    alignas(16) float gain_[MAX_LINES];     // Decay gain / sqrt(lines)
+    alignas(16) float pole_[MAX_LINES];     // Damping lowpass coefficient
+    alignas(16) float state_[MAX_LINES];    // Damping lowpass state
+    alignas(16) float taps_[MAX_CHANNELS][MAX_LINES];   // +-1 output rows
+    alignas(16) float block_[BLOCK_FRAMES * MAX_LINES]; // [frame][line]
+};
+
+}} // namespace mp::core
@@ -0,0 +1,299 @@
+﻿#include "fft.h"
+#include <cmath>
+#include <mutex>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MP_FFT_SSE2 1
+#else
+#define MP_FFT_SSE2 0
+#endif
+
+namespace mp {
+namespace core {
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+size_t round_up_pow2(size_t n) {
+    size_t p = 4;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+// Scalar radix-4 butterfly over indices [begin, end) of one group
+inline void radix4_scalar(float* r0, float* i0, size_t h, size_t begin, size_t end,
+                          const float* w1r, const float* w1i,
+                          const float* w2r, const float* w2i) {
+    float* r1 = r0 + h;
+    float* i1 = i0 + h;
+    float* r2 = r0 + 2 * h;
+    float* i2 = i0 + 2 * h;
+    float* r3 = r0 + 3 * h;
+    float* i3 = i0 + 3 * h;
+
+    for (size_t j = begin; j < end; ++j) {
+        // First radix-2 stage (span 2h)
+        float t1r = w1r[j] * r1[j] - w1i[j] * i1[j];
+        float t1i = w1r[j] * i1[j] + w1i[j] * r1[j];
+        float t3r = w1r[j] * r3[j] - w1i[j] * i3[j];
+        float t3i = w1r[j] * i3[j] + w1i[j] * r3[j];
+
+        float b0r = r0[j] + t1r, b0i = i0[j] + t1i;
+        float b1r = r0[j] - t1r, b1i = i0[j] - t1i;
+        float b2r = r2[j] + t3r, b2i = i2[j] + t3i;
+        float b3r = r2[j] - t3r, b3i = i2[j] - t3i;
+
+        // Second radix-2 stage (span 4h); the odd half carries an extra -i
+        float u2r = w2r[j] * b2r - w2i[j] * b2i;
+        float u2i = w2r[j] * b2i + w2i[j] * b2r;
+        float u3r = w2r[j] * b3r - w2i[j] * b3i;
+        float u3i = w2r[j] * b3i + w2i[j] * b3r;
+
+        r0[j] = b0r + u2r;  i0[j] = b0i + u2i;
+        r2[j] = b0r - u2r;  i2[j] = b0i - u2i;
+        r1[j] = b1r + u3i;  i1[j] = b1i - u3r;
+        r3[j] = b1r - u3i;  i3[j] = b1i + u3r;
+    }
+}
+
+#if MP_FFT_SSE2
+// Same butterfly, four lanes at a time (end - begin must be a multiple of 4)
+inline void radix4_sse2(float* r0, float* i0, size_t h, size_t begin, size_t end,
+                        const float* w1r, const float* w1i,
+                        const float* w2r, const float* w2i) {
+    float* r1 = r0 + h;
+    float* i1 = i0 + h;
+    float* r2 = r0 + 2 * h;
+    float* i2 = i0 + 2 * h;
+    float* r3 = r0 + 3 * h;
+    float* i3 = i0 + 3 * h;
+
+    for (size_t j = begin; j < end; j += 4) {
+        __m128 a1r = _mm_loadu_ps(r1 + j), a1i = _mm_loadu_ps(i1 + j);
+        __m128 a3r = _mm_loadu_ps(r3 + j), a3i = _mm_loadu_ps(i3 + j);
+        __m128 c1r = _mm_loadu_ps(w1r + j), c1i = _mm_loadu_ps(w1i + j);
+
+        __m128 t1r = _mm_sub_ps(_mm_mul_ps(c1r, a1r), _mm_mul_ps(c1i, a1i));
+        __m128 t1i = _mm_add_ps(_mm_mul_ps(c1r, a1i), _mm_mul_ps(c1i, a1r));
+        __m128 t3r = _mm_sub_ps(_mm_mul_ps(c1r, a3r), _mm_mul_ps(c1i, a3i));
+        __m128 t3i = _mm_add_ps(_mm_mul_ps(c1r, a3i), _mm_mul_ps(c1i, a3r));
+
+        __m128 a0r = _mm_loadu_ps(r0 + j), a0i = _mm_loadu_ps(i0 + j);
+        __m128 a2r = _mm_loadu_ps(r2 + j), a2i = _mm_loadu_ps(i2 + j);
+
+        __m128 b0r = _mm_add_ps(a0r, t1r), b0i = _mm_add_ps(a0i, t1i);
+        __m128 b1r = _mm_sub_ps(a0r, t1r), b1i = _mm_sub_ps(a0i, t1i);
+        __m128 b2r = _mm_add_ps(a2r, t3r), b2i = _mm_add_ps(a2i, t3i);
+        __m128 b3r = _mm_sub_ps(a2r, t3r), b3i = _mm_sub_ps(a2i, t3i);
+
+        __m128 c2r = _mm_loadu_ps(w2r + j), c2i = _mm_loadu_ps(w2i + j);
+        __m128 u2r = _mm_sub_ps(_mm_mul_ps(c2r, b2r), _mm_mul_ps(c2i, b2i));
+        __m128 u2i = _mm_add_ps(_mm_mul_ps(c2r, b2i), _mm_mul_ps(c2i, b2r));
+        __m128 u3r = _mm_sub_ps(_mm_mul_ps(c2r, b3r), _mm_mul_ps(c2i, b3i));
+        __m128 u3i = _mm_add_ps(_mm_mul_ps(c2r, b3i), _mm_mul_ps(c2i, b3r));
+
+        _mm_storeu_ps(r0 + j, _mm_add_ps(b0r, u2r));
+        _mm_storeu_ps(i0 + j, _mm_add_ps(b0i, u2i));
+        _mm_storeu_ps(r2 + j, _mm_sub_ps(b0r, u2r));
+        _mm_storeu_ps(i2 + j, _mm_sub_ps(b0i, u2i));
+        _mm_storeu_ps(r1 + j, _mm_add_ps(b1r, u3i));
+        _mm_storeu_ps(i1 + j, _mm_sub_ps(b1i, u3r));
+        _mm_storeu_ps(r3 + j, _mm_sub_ps(b1r, u3i));
+        _mm_storeu_ps(i3 + j, _mm_add_ps(b1i, u3r));
+    }
+}
+#endif
+
+} // namespace
+
+std::shared_ptr<const FFTPlan> FFTPlan::get(size_t size) {
+    static std::mutex cache_mutex;
+    static std::unordered_map<size_t, std::shared_ptr<const FFTPlan>> cache;
+
+    size = round_up_pow2(size);
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto& plan = cache[size];
+    if (!plan) {
+        plan = std::make_shared<const FFTPlan>(size);
+    }
+    return plan;
+}
+
+FFTPlan::FFTPlan(size_t size)
+    : size_(round_up_pow2(size))
+    , half_(size_ / 2)
+    , leading_radix2_(false) {
+
+    unsigned bits = 0;
+    while ((static_cast<size_t>(1) << bits) < half_) {
+        ++bits;
+    }
+
+    // Bit-reversal permutation of the half-size transform
+    bit_reverse_.resize(half_);
+    for (size_t n = 0; n < half_; ++n) {
+        size_t r = 0;
+        for (unsigned b = 0; b < bits; ++b) {
+            r |= ((n >> b) & 1) << (bits - 1 - b);
+        }
+        bit_reverse_[n] = static_cast<uint32_t>(r);
+    }
+
+    // An odd number of radix-2 stages leaves one to do on its own first
+    leading_radix2_ = (bits & 1) != 0;
+
+    for (size_t h = leading_radix2_ ? 2 : 1; 4 * h <= half_; h *= 4) {
+        Radix4Pass pass;
+        pass.quarter = h;
+        pass.twiddle_offset = twiddle_re_.size();
+        passes_.push_back(pass);
+
+        for (size_t j = 0; j < h; ++j) {
+            double angle = -2.0 * PI * static_cast<double>(j) / static_cast<double>(2 * h);
+            twiddle_re_.push_back(static_cast<float>(std::cos(angle)));
+            twiddle_im_.push_back(static_cast<float>(std::sin(angle)));
+        }
+        for (size_t j = 0; j < h; ++j) {
+            double angle = -2.0 * PI * static_cast<double>(j) / static_cast<double>(4 * h);
+            twiddle_re_.push_back(static_cast<float>(std::cos(angle)));
+            twiddle_im_.push_back(static_cast<float>(std::sin(angle)));
+        }
+    }
+
+    // Twiddles for separating the packed even/odd spectra
+    split_re_.resize(half_);
+    split_im_.resize(half_);
+    for (size_t k = 0; k < half_; ++k) {
+        double angle = -2.0 * PI * static_cast<double>(k) / static_cast<double>(size_);
+        split_re_[k] = static_cast<float>(std::cos(angle));
+        split_im_[k] = static_cast<float>(std::sin(angle));
+    }
+}
+
+// In-place forward complex FFT of half_ points on bit-reversed split data
+void FFTPlan::transform(float* re, float* im) const {
+    if (leading_radix2_) {
+        for (size_t i = 0; i < half_; i += 2) {
+            float ar = re[i], ai = im[i];
+            float br = re[i + 1], bi = im[i + 1];
+            re[i] = ar + br;  im[i] = ai + bi;
+            re[i + 1] = ar - br;  im[i + 1] = ai - bi;
+        }
+    }
+
+    for (const Radix4Pass& pass : passes_) {
+        const size_t h = pass.quarter;
+        const float* w1r = twiddle_re_.data() + pass.twiddle_offset;
+        const float* w1i = twiddle_im_.data() + pass.twiddle_offset;
+        const float* w2r = w1r + h;
+        const float* w2i = w1i + h;
+
+        for (size_t g = 0; g < half_; g += 4 * h) {
+#if MP_FFT_SSE2
+            if (h >= 4) {
+                radix4_sse2(re + g, im + g, h, 0, h, w1r, w1i, w2r, w2i);
+                continue;
+            }
+#endif
+            radix4_scalar(re + g, im + g, h, 0, h, w1r, w1i, w2r, w2i);
+        }
+    }
+}
+
+RealFFT::RealFFT(size_t size)
+    : plan_(FFTPlan::get(size))
+    , work_re_(plan_->half_size())
+    , work_im_(plan_->half_size())
+    , bins_(plan_->half_size() + 1) {
+}
+
+// Pack x[2n] + i*x[2n+1] in bit-reversed order and run the half-size FFT
+void RealFFT::forward_packed(const float* input) {
+    const uint32_t* rev = plan_->bit_reverse_.data();
+    const size_t half = plan_->half_size();
+
+    for (size_t n = 0; n < half; ++n) {
+        const float* pair = input + 2 * static_cast<size_t>(rev[n]);
+        work_re_[n] = pair[0];
+        work_im_[n] = pair[1];
+    }
+
+    plan_->transform(work_re_.data(), work_im_.data());
+}
+
+void RealFFT::forward(const float* input, std::complex<float>* output) {
+    forward_packed(input);
+
+    const size_t half = plan_->half_size();
+    const float* zr = work_re_.data();
+    const float* zi = work_im_.data();
+    const float* wr = plan_->split_re_.data();
+    const float* wi = plan_->split_im_.data();
+
+    output[0] = std::complex<float>(zr[0] + zi[0], 0.0f);
+    output[half] = std::complex<float>(zr[0] - zi[0], 0.0f);
+
+    // X[k] = (Z[k] + conj(Z[M-k])) / 2 - i * W^k * (Z[k] - conj(Z[M-k])) / 2
+    for (size_t k = 1; k < half; ++k) {
+        size_t m = half - k;
+        float er = 0.5f * (zr[k] + zr[m]);
+        float ei = 0.5f * (zi[k] - zi[m]);
+        float dr = 0.5f * (zr[k] - zr[m]);
+        float di = 0.5f * (zi[k] + zi[m]);
+
+        float tr = wr[k] * dr - wi[k] * di;
+        float ti = wr[k] * di + wi[k] * dr;
+
+        output[k] = std::complex<float>(er + ti, ei - tr);
+    }
+}
+
+void RealFFT::forward_magnitudes(const float* input, float* magnitudes) {
+    forward(input, bins_.data());
+    for (size_t k = 0; k < bins_.size(); ++k) {
+        magnitudes[k] = std::abs(bins_[k]);
+    }
+}
+
+void RealFFT::inverse(const std::complex<float>* input, float* output) {
+    const uint32_t* rev = plan_->bit_reverse_.data();
+    const size_t half = plan_->half_size();
+    const float* wr = plan_->split_re_.data();
+    const float* wi = plan_->split_im_.data();
+
+    // Rebuild Z[k] = Xe[k] + i * Xo[k] and pack its conjugate, so the
+    // forward kernel computes the inverse transform
+    for (size_t n = 0; n < half; ++n) {
+        size_t k = rev[n];
+        std::complex<float> a = input[k];
+        std::complex<float> b = std::conj(input[half - k]);
+
+        float er = 0.5f * (a.real() + b.real());
+        float ei = 0.5f * (a.imag() + b.imag());
+        float dr = 0.5f * (a.real() - b.real());
+        float di = 0.5f * (a.imag() - b.imag());
+
+        // Xo = D * conj(W^k)
+        float or_ = dr * wr[k] + di * wi[k];
+        float oi = di * wr[k] - dr * wi[k];
+
+        work_re_[n] = er - oi;
+        work_im_[n] = -(ei + or_);
+    }
+
+    plan_->transform(work_re_.data(), work_im_.data());
+
+    const float scale = 1.0f / static_cast<float>(half);
+    for (size_t n = 0; n < half; ++n) {
+        output[2 * n] = work_re_[n] * scale;
+        output[2 * n + 1] = -work_im_[n] * scale;
+    }
+}
+
+}} // namespace mp::core
@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+// Precomputed tables for one transform size. Plans are immutable once
+// built and shared between all users of the same size.
+class FFTPlan {
+public:
+    // Cached plan for a real transform of size points (power of two, >= 4).
+    // Takes a lock and may allocate on first use; call off the audio thread.
+    static std::shared_ptr<const FFTPlan> get(size_t size);
+
+    explicit FFTPlan(size_t size);
+
+    size_t size() const { return size_; }
+
+    // Complex transform length used internally (size / 2)
+    size_t half_size() const { return half_; }
+
+private:
+    friend class RealFFT;
+
+    // One fused radix-4 pass (two radix-2 DIT stages) at quarter span h
+    struct Radix4Pass {
+        size_t quarter;
+        size_t twiddle_offset;
+    };
+
+    void transform(float* re, float* im) const;
+
+    size_t size_;
+    size_t half_;
+    bool leading_radix2_;
+    std::vector<uint32_t> bit_reverse_;     // Permutation for the half-size transform
+    std::vector<Radix4Pass> passes_;
+    std::vector<float> twiddle_re_;         // Per pass: w1[h], w2[h]
+    std::vector<float> twiddle_im_;
+    std::vector<float> split_re_;           // exp(-2*pi*i*k/size), k < size/2
+    std::vector<float> split_im_;
+};
+
+// Real-input FFT of a fixed size. Packs the N real samples into an N/2
+// complex transform and untangles the result, so a forward transform costs
+// roughly half of a complex FFT. Owns its scratch buffers: forward() and
+// inverse() never allocate. One instance per thread.
+class RealFFT {
+public:
+    explicit RealFFT(size_t size);
+
+    size_t size() const { return plan_->size(); }
+
+    // Number of output bins (size / 2 + 1)
+    size_t bins() const { return plan_->size() / 2 + 1; }
+
+    // input[size] -> output[size / 2 + 1], unnormalised
+    void forward(const float* input, std::complex<float>* output);
+
+    // Magnitude of each bin, output[size / 2 + 1]
+    void forward_magnitudes(const float* input, float* magnitudes);
+
+    // input[size / 2 + 1] -> output[size]; inverse(forward(x)) == x
+    void inverse(const std::complex<float>* input, float* output);
+
+private:
+    void forward_packed(const float* input);
+
+    std::shared_ptr<const FFTPlan> plan_;
+    std::vector<float> work_re_;
+    std::vector<float> work_im_;
+    std::vector<std::complex<float>> bins_;
+};
+
+}} // namespace mp::core
@@ -0,0 +1,345 @@
+﻿#include "gapless_info.h"
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <sstream>
+
+namespace mp {
+namespace core {
+
+namespace {
+
+// MP3 decoders (LAME reference, minimp3, mpg123) add 528 + 1 samples of
+// synthesis delay on top of the encoder delay stored in the LAME tag
+const uint64_t MP3_DECODER_DELAY = 529;
+
+const size_t HEADER_SCAN_BYTES = 64 * 1024;
+const size_t OGG_TAIL_BYTES = 64 * 1024;
+
+uint32_t read_be32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+uint32_t read_be24(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) |
+           static_cast<uint32_t>(p[2]);
+}
+
+uint32_t read_syncsafe32(const uint8_t* p) {
+    return ((p[0] & 0x7Fu) << 21) | ((p[1] & 0x7Fu) << 14) | ((p[2] & 0x7Fu) << 7) | (p[3] & 0x7Fu);
+}
+
+uint64_t read_le64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+std::vector<uint8_t> read_range(std::ifstream& file, uint64_t offset, size_t size) {
+    std::vector<uint8_t> data(size);
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(size));
+    data.resize(static_cast<size_t>(file.gcount()));
+    return data;
+}
+
+// Text from an ID3v2 text field. UTF-16 is narrowed, which is enough for
+// the ASCII-only keys and values we look for.
+std::string id3_text(const uint8_t* p, size_t size, uint8_t encoding) {
+    std::string out;
+    if (encoding == 1 || encoding == 2) {
+        size_t i = 0;
+        if (size >= 2 && ((p[0] == 0xFF && p[1] == 0xFE) || (p[0] == 0xFE && p[1] == 0xFF))) {
+            i = 2;
+        }
+        bool little_endian = !(size >= 2 && p[0] == 0xFE && p[1] == 0xFF) && encoding == 1;
+        for (; i + 1 < size; i += 2) {
+            uint8_t c = little_endian ? p[i] : p[i + 1];
+            uint8_t hi = little_endian ? p[i + 1] : p[i];
+            if (c == 0 && hi == 0) {
+                break;
+            }
+            out += hi == 0 ? static_cast<char>(c) : '?';
+        }
+    } else {
+        for (size_t i = 0; i < size && p[i] != 0; ++i) {
+            out += static_cast<char>(p[i]);
+        }
+    }
+    return out;
+}
+
+// Length of a terminated string in the given ID3 encoding, incl. terminator
+size_t id3_string_length(const uint8_t* p, size_t size, uint8_t encoding) {
+    if (encoding == 1 || encoding == 2) {
+        for (size_t i = 0; i + 1 < size; i += 2) {
+            if (p[i] == 0 && p[i + 1] == 0) {
+                return i + 2;
+            }
+        }
+        return size;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (p[i] == 0) {
+            return i + 1;
+        }
+    }
+    return size;
+}
+
+// Look for iTunSMPB in COMM or TXXX frames of an ID3v2 tag body
+bool scan_id3v2_for_itunsmpb(const uint8_t* tag, size_t size, uint8_t version, GaplessInfo& info) {
+    const size_t header_size = version == 2 ? 6 : 10;
+    size_t pos = 0;
+
+    while (pos + header_size <= size) {
+        if (tag[pos] == 0) {
+            break;  // Padding
+        }
+
+        std::string id;
+        size_t frame_size;
+        if (version == 2) {
+            id.assign(reinterpret_cast<const char*>(tag + pos), 3);
+            frame_size = read_be24(tag + pos + 3);
+        } else {
+            id.assign(reinterpret_cast<const char*>(tag + pos), 4);
+            frame_size = version == 4 ? read_syncsafe32(tag + pos + 4) : read_be32(tag + pos + 4);
+        }
+        pos += header_size;
+
+        if (frame_size == 0 || pos + frame_size > size) {
+            break;
+        }
+
+        const uint8_t* body = tag + pos;
+        bool is_comm = id == "COMM" || id == "COM";
+        bool is_txxx = id == "TXXX" || id == "TXX";
+        if ((is_comm || is_txxx) && frame_size > 1) {
+            uint8_t encoding = body[0];
+            size_t offset = is_comm ? 4 : 1;  // COMM carries a 3 byte language code
+            if (offset < frame_size) {
+                size_t desc_len = id3_string_length(body + offset, frame_size - offset, encoding);
+                std::string desc = id3_text(body + offset, desc_len, encoding);
+                if (desc == "iTunSMPB" && offset + desc_len < frame_size) {
+                    std::string value = id3_text(body + offset + desc_len,
+                                                 frame_size - offset - desc_len, encoding);
+                    if (parse_itunsmpb(value, info)) {
+                        return true;
+                    }
+                }
+            }
+        }
+
+        pos += frame_size;
+    }
+
+    return false;
+}
+
+bool read_mp3_info(std::ifstream& file, GaplessInfo& info) {
+    uint64_t audio_start = 0;
+    bool have_itunes = false;
+
+    std::vector<uint8_t> head = read_range(file, 0, 10);
+    if (head.size() == 10 && std::memcmp(head.data(), "ID3", 3) == 0) {
+        uint32_t tag_size = read_syncsafe32(head.data() + 6);
+        audio_start = 10 + tag_size + ((head[5] & 0x10) ? 10 : 0);
+
+        std::vector<uint8_t> tag = read_range(file, 10, tag_size);
+        have_itunes = scan_id3v2_for_itunsmpb(tag.data(), tag.size(), head[3], info);
+    }
+
+    std::vector<uint8_t> data = read_range(file, audio_start, HEADER_SCAN_BYTES);
+
+    // Locate the first MPEG audio frame
+    size_t pos = 0;
+    for (; pos + 4 <= data.size(); ++pos) {
+        if (data[pos] == 0xFF && (data[pos + 1] & 0xE0) == 0xE0 &&
+            ((data[pos + 1] >> 1) & 3) != 0 && ((data[pos + 2] >> 4) & 0xF) != 0xF &&
+            ((data[pos + 2] >> 2) & 3) != 3) {
+            break;
+        }
+    }
+    if (pos + 4 > data.size()) {
+        return have_itunes;
+    }
+
+    const uint8_t* frame = data.data() + pos;
+    int version = (frame[1] >> 3) & 3;   // 3 = MPEG1, 2 = MPEG2, 0 = MPEG2.5
+    int layer = (frame[1] >> 1) & 3;     // 1 = Layer III
+    bool mono = ((frame[3] >> 6) & 3) == 3;
+    bool mpeg1 = version == 3;
+
+    uint64_t samples_per_frame = 1152;
+    if (layer == 3) {
+        samples_per_frame = 384;
+    } else if (layer == 1 && !mpeg1) {
+        samples_per_frame = 576;
+    }
+
+    size_t side_info = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+    size_t xing = pos + 4 + side_info;
+    size_t vbri = pos + 4 + 32;
+
+    if (xing + 8 <= data.size() &&
+        (std::memcmp(&data[xing], "Xing", 4) == 0 || std::memcmp(&data[xing], "Info", 4) == 0)) {
+        uint32_t flags = read_be32(&data[xing + 4]);
+        size_t p = xing + 8;
+        uint32_t frames = 0;
+        if ((flags & 0x1) && p + 4 <= data.size()) {
+            frames = read_be32(&data[p]);
+            p += 4;
+        }
+        if (flags & 0x2) p += 4;    // Byte count
+        if (flags & 0x4) p += 100;  // TOC
+        if (flags & 0x8) p += 4;    // Quality
+
+        if (!have_itunes && frames > 0) {
+            info.total_samples = frames * samples_per_frame;
+            info.found = true;
+        }
+
+        // LAME extension: 9 byte version string, delay/padding at +21
+        if (!have_itunes && p + 24 <= data.size() &&
+            (std::memcmp(&data[p], "LAME", 4) == 0 || std::memcmp(&data[p], "Lavf", 4) == 0 ||
+             std::memcmp(&data[p], "Lavc", 4) == 0)) {
+            uint32_t packed = read_be24(&data[p + 21]);
+            uint64_t delay = packed >> 12;
+            uint64_t padding = packed & 0xFFF;
+
+            info.encoder_delay = delay + MP3_DECODER_DELAY;
+            info.encoder_padding = padding > MP3_DECODER_DELAY ? padding - MP3_DECODER_DELAY : 0;
+            info.found = true;
+        }
+    } else if (vbri + 18 <= data.size() && std::memcmp(&data[vbri], "VBRI", 4) == 0) {
+        uint32_t frames = read_be32(&data[vbri + 14]);
+        if (!have_itunes && frames > 0) {
+            info.total_samples = frames * samples_per_frame;
+            info.encoder_delay = MP3_DECODER_DELAY;
+            info.found = true;
+        }
+    }
+
+    return true;
+}
+
+bool read_flac_info(std::ifstream& file, GaplessInfo& info) {
+    std::vector<uint8_t> data = read_range(file, 0, 4 + 4 + 34);
+    if (data.size() < 42 || (data[4] & 0x7F) != 0) {
+        return false;  // STREAMINFO must be the first metadata block
+    }
+
+    // STREAMINFO: 10 bytes of block/frame sizes, then rate(20) ch(3) bps(5) total(36)
+    const uint8_t* si = data.data() + 8;
+    uint64_t total = (static_cast<uint64_t>(si[13] & 0x0F) << 32) |
+                     (static_cast<uint64_t>(si[14]) << 24) | (static_cast<uint64_t>(si[15]) << 16) |
+                     (static_cast<uint64_t>(si[16]) << 8) | si[17];
+
+    // Lossless: no encoder delay or padding, the sample count is exact
+    info.total_samples = total;
+    info.found = total > 0;
+    return true;
+}
+
+bool read_ogg_info(std::ifstream& file, GaplessInfo& info) {
+    std::vector<uint8_t> head = read_range(file, 0, 512);
+    bool is_opus = false;
+    uint64_t pre_skip = 0;
+
+    // First page carries the codec identification header
+    if (head.size() >= 28 + 19) {
+        uint8_t segments = head[26];
+        size_t body = 27 + segments;
+        if (body + 19 <= head.size() && std::memcmp(&head[body], "OpusHead", 8) == 0) {
+            is_opus = true;
+            pre_skip = head[body + 10] | (static_cast<uint64_t>(head[body + 11]) << 8);
+        } else if (body + 7 > head.size() || std::memcmp(&head[body + 1], "vorbis", 6) != 0) {
+            return false;
+        }
+    }
+
+    file.clear();
+    file.seekg(0, std::ios::end);
+    uint64_t file_size = static_cast<uint64_t>(file.tellg());
+    uint64_t tail_start = file_size > OGG_TAIL_BYTES ? file_size - OGG_TAIL_BYTES : 0;
+    std::vector<uint8_t> tail = read_range(file, tail_start, OGG_TAIL_BYTES);
+
+    // The last page's granule position is the exact decoded length
+    for (size_t i = tail.size() >= 14 ? tail.size() - 14 : 0; i-- > 0;) {
+        if (std::memcmp(&tail[i], "OggS", 4) == 0 && tail[i + 4] == 0) {
+            uint64_t granule = read_le64(&tail[i + 6]);
+            if (granule == ~0ull) {
+                continue;
+            }
+            info.total_samples = granule;
+            if (is_opus) {
+                info.encoder_delay = pre_skip;
+            }
+            info.found = true;
+            break;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool parse_itunsmpb(const std::string& value, GaplessInfo& info) {
+    std::istringstream stream(value);
+    std::string fields[4];
+    for (int i = 0; i < 4; ++i) {
+        if (!(stream >> fields[i])) {
+            return false;
+        }
+    }
+
+    uint64_t delay = std::strtoull(fields[1].c_str(), nullptr, 16);
+    uint64_t padding = std::strtoull(fields[2].c_str(), nullptr, 16);
+    uint64_t samples = std::strtoull(fields[3].c_str(), nullptr, 16);
+    if (samples == 0) {
+        return false;
+    }
+
+    info.encoder_delay = delay;
+    info.encoder_padding = padding;
+    info.total_samples = delay + samples + padding;
+    info.found = true;
+    return true;
+}
+
+bool read_gapless_info(const std::string& file_path, GaplessInfo& info) {
+    info = GaplessInfo();
+
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    char magic[4] = {};
+    file.read(magic, 4);
+    if (file.gcount() < 4) {
+        return false;
+    }
+
+    if (std::memcmp(magic, "fLaC", 4) == 0) {
+        return read_flac_info(file, info);
+    }
+    if (std::memcmp(magic, "OggS", 4) == 0) {
+        return read_ogg_info(file, info);
+    }
+    if (std::memcmp(magic, "ID3", 3) == 0 ||
+        (static_cast<uint8_t>(magic[0]) == 0xFF && (static_cast<uint8_t>(magic[1]) & 0xE0) == 0xE0)) {
+        return read_mp3_info(file, info);
+    }
+
+    return false;
+}
+
+}} // namespace mp::core
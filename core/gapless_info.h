@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include "mp_types.h"
+#include <string>
+
+namespace mp {
+namespace core {
+
+// Container-level information needed for sample-accurate gapless playback.
+// All counts are in samples per channel on the decoder's output timeline.
+struct GaplessInfo {
+    uint64_t encoder_delay;     // Samples to skip at start (incl. decoder delay)
+    uint64_t encoder_padding;   // Samples to skip at end
+    uint64_t total_samples;     // Decoded length incl. delay/padding (0 if unknown)
+    bool found;                 // True if any gapless metadata was present
+
+    GaplessInfo() : encoder_delay(0), encoder_padding(0), total_samples(0), found(false) {}
+};
+
+// Read gapless information from the file headers.
+//   MP3:  LAME/Xing "Info" tag (delay/padding + frame count), VBRI frame
+//         count, iTunSMPB (ID3v2 COMM/TXXX), which takes precedence
+//   FLAC: STREAMINFO total samples (lossless, no delay/padding)
+//   Ogg:  final granule position; Opus pre-skip as delay
+// Returns false if the file cannot be read or the format is not recognised.
+bool read_gapless_info(const std::string& file_path, GaplessInfo& info);
+
+// Parse an iTunSMPB value (" 00000000 00000840 000001C8 0000000000ABCDEF ...")
+bool parse_itunsmpb(const std::string& value, GaplessInfo& info);
+
+}} // namespace mp::core
@@ -0,0 +1,165 @@
+﻿#include "impulse_response.h"
+#include "src/audio/sample_rate_converter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace mp {
+namespace core {
+
+namespace {
+
+const uint16_t FORMAT_PCM = 1;
+const uint16_t FORMAT_FLOAT = 3;
+const uint16_t FORMAT_EXTENSIBLE = 0xFFFE;
+
+uint16_t read_u16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t read_u32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+float decode_sample(const uint8_t* p, uint16_t format, uint16_t bits) {
+    if (format == FORMAT_FLOAT) {
+        if (bits == 32) {
+            uint32_t raw = read_u32(p);
+            float value;
+            std::memcpy(&value, &raw, sizeof(value));
+            return value;
+        }
+        uint64_t raw = read_u32(p) | (static_cast<uint64_t>(read_u32(p + 4)) << 32);
+        double value;
+        std::memcpy(&value, &raw, sizeof(value));
+        return static_cast<float>(value);
+    }
+
+    switch (bits) {
+        case 16:
+            return static_cast<int16_t>(read_u16(p)) / 32768.0f;
+        case 24: {
+            // Sign-extend from the top byte
+            uint32_t raw = static_cast<uint32_t>(p[0] | (p[1] << 8) | (p[2] << 16)) << 8;
+            return static_cast<int32_t>(raw) / 2147483648.0f;
+        }
+        default:
+            return static_cast<int32_t>(read_u32(p)) / 2147483648.0f;
+    }
+}
+
+} // namespace
+
+bool read_wav_impulse_response(const std::string& path, ImpulseResponse& ir) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    uint8_t header[12];
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        std::memcmp(header, "RIFF", 4) != 0 || std::memcmp(header + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    uint16_t format = 0;
+    uint16_t channels = 0;
+    uint32_t sample_rate = 0;
+    uint16_t bits = 0;
+    bool have_format = false;
+
+    uint8_t chunk[8];
+    while (file.read(reinterpret_cast<char*>(chunk), sizeof(chunk))) {
+        uint32_t size = read_u32(chunk + 4);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0) {
+            std::vector<uint8_t> body(size);
+            if (size < 16 || !file.read(reinterpret_cast<char*>(body.data()), size)) {
+                return false;
+            }
+            format = read_u16(body.data());
+            channels = read_u16(body.data() + 2);
+            sample_rate = read_u32(body.data() + 4);
+            bits = read_u16(body.data() + 14);
+            if (format == FORMAT_EXTENSIBLE && size >= 26) {
+                format = read_u16(body.data() + 24);    // Sub-format GUID's leading tag
+            }
+            have_format = true;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!have_format || channels == 0 || sample_rate == 0) {
+                return false;
+            }
+            bool supported = (format == FORMAT_PCM && (bits == 16 || bits == 24 || bits == 32)) ||
+                             (format == FORMAT_FLOAT && (bits == 32 || bits == 64));
+            if (!supported) {
+                return false;
+            }
+
+            // Tolerate a data size that overruns a truncated file
+            std::vector<uint8_t> data(size);
+            file.read(reinterpret_cast<char*>(data.data()), size);
+            size_t bytes = static_cast<size_t>(file.gcount());
+
+            size_t sample_bytes = bits / 8;
+            size_t frames = bytes / (sample_bytes * channels);
+            ir.samples.resize(frames * channels);
+            for (size_t i = 0; i < ir.samples.size(); ++i) {
+                ir.samples[i] = decode_sample(data.data() + i * sample_bytes, format, bits);
+            }
+            ir.sample_rate = sample_rate;
+            ir.channels = channels;
+            return frames > 0;
+        } else {
+            // Chunks are padded to an even length
+            file.seekg(size + (size & 1), std::ios::cur);
+        }
+    }
+
+    return false;
+}
+
+bool resample_impulse_response(ImpulseResponse& ir, uint32_t sample_rate,
+                               audio::ISampleRateConverter& converter) {
+    if (ir.channels == 0 || ir.sample_rate == 0 || sample_rate == 0) {
+        return false;
+    }
+    if (ir.sample_rate == sample_rate) {
+        return true;
+    }
+    if (!converter.initialize(static_cast<int>(ir.sample_rate), static_cast<int>(sample_rate),
+                              ir.channels)) {
+        return false;
+    }
+
+    const double ratio = static_cast<double>(sample_rate) / ir.sample_rate;
+    const size_t frames = ir.frames();
+    const size_t delay = static_cast<size_t>(std::lround(converter.get_latency() * ratio));
+    const size_t wanted = static_cast<size_t>(std::ceil(frames * ratio));
+
+    // Trailing silence flushes the converter's filter
+    size_t padded = frames + 2 * static_cast<size_t>(converter.get_latency()) + 16;
+    std::vector<float> input(ir.samples);
+    input.resize(padded * ir.channels, 0.0f);
+
+    size_t capacity = static_cast<size_t>(std::ceil(padded * ratio)) + 16;
+    std::vector<float> output(capacity * ir.channels, 0.0f);
+    int produced = converter.convert(input.data(), static_cast<int>(padded),
+                                     output.data(), static_cast<int>(capacity));
+    if (produced <= 0 || static_cast<size_t>(produced) <= delay) {
+        return false;
+    }
+
+    // A denser response sums more taps; scale to keep the same gain
+    const float gain = static_cast<float>(1.0 / ratio);
+    size_t kept = std::min(wanted, static_cast<size_t>(produced) - delay);
+    ir.samples.assign(kept * ir.channels, 0.0f);
+    for (size_t i = 0; i < ir.samples.size(); ++i) {
+        ir.samples[i] = output[delay * ir.channels + i] * gain;
+    }
+    ir.sample_rate = sample_rate;
+    return kept > 0;
+}
+
+}} // namespace mp::core
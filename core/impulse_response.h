@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace audio {
+class ISampleRateConverter;
+}
+
+namespace mp {
+namespace core {
+
+// Interleaved float impulse response, as loaded for convolution
+struct ImpulseResponse {
+    std::vector<float> samples;
+    uint32_t sample_rate = 0;
+    uint16_t channels = 0;
+
+    size_t frames() const { return channels ? samples.size() / channels : 0; }
+};
+
+// Reads a WAV impulse response: 16/24/32-bit PCM or 32/64-bit float,
+// including WAVE_FORMAT_EXTENSIBLE. Chunks other than fmt and data are
+// skipped. Not real-time safe.
+bool read_wav_impulse_response(const std::string& path, ImpulseResponse& ir);
+
+// Converts ir to sample_rate with the given converter, which is
+// (re)initialised here. The converter's delay is removed so the direct
+// sound stays at frame 0, and the samples are scaled so the response keeps
+// its gain. No-op if the rates already match.
+bool resample_impulse_response(ImpulseResponse& ir, uint32_t sample_rate,
+                               audio::ISampleRateConverter& converter);
+
+}} // namespace mp::core
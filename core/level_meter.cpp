@@ -0,0 +1,167 @@
+﻿#include "level_meter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace mp {
+namespace core {
+
+namespace {
+    const double PI = 3.14159265358979323846;
+}
+
+LevelMeter::LevelMeter()
+    : channels_(0)
+    , sample_rate_(0)
+    , window_(1)
+    , position_(0)
+    , history_position_(0)
+    , hold_seconds_(0.0f)
+    , decay_db_per_second_(0.0f) {
+
+    // Windowed-sinc interpolator, cutoff at the input Nyquist frequency.
+    // Each phase is normalised to unity gain at DC.
+    const size_t length = TRUE_PEAK_PHASES * TRUE_PEAK_TAPS;
+    const double center = (length - 1) / 2.0;
+    for (size_t p = 0; p < TRUE_PEAK_PHASES; ++p) {
+        double sum = 0.0;
+        double taps[TRUE_PEAK_TAPS];
+        for (size_t k = 0; k < TRUE_PEAK_TAPS; ++k) {
+            size_t n = p + k * TRUE_PEAK_PHASES;
+            double x = (static_cast<double>(n) - center) / TRUE_PEAK_PHASES;
+            double sinc = (x == 0.0) ? 1.0 : std::sin(PI * x) / (PI * x);
+            double window = 0.42 - 0.5 * std::cos(2.0 * PI * n / (length - 1)) +
+                            0.08 * std::cos(4.0 * PI * n / (length - 1));
+            taps[k] = sinc * window;
+            sum += taps[k];
+        }
+        for (size_t k = 0; k < TRUE_PEAK_TAPS; ++k) {
+            true_peak_kernel_[p][k] = static_cast<float>(taps[k] / sum);
+        }
+    }
+
+    reset();
+}
+
+void LevelMeter::configure(uint16_t channels, uint32_t sample_rate, float rms_window_ms) {
+    channels_ = std::min(channels, MAX_CHANNELS);
+    sample_rate_ = sample_rate;
+    window_ = std::max<size_t>(1, static_cast<size_t>(
+        static_cast<double>(rms_window_ms) / 1000.0 * sample_rate));
+
+    for (uint16_t ch = 0; ch < MAX_CHANNELS; ++ch) {
+        channel_state_[ch].squares.assign(ch < channels_ ? window_ : 0, 0.0f);
+    }
+    reset();
+}
+
+void LevelMeter::set_peak_ballistics(float hold_ms, float decay_db_per_second) {
+    hold_seconds_ = std::max(0.0f, hold_ms / 1000.0f);
+    decay_db_per_second_ = std::max(0.0f, decay_db_per_second);
+}
+
+void LevelMeter::reset() {
+    position_ = 0;
+    history_position_ = 0;
+    for (Channel& c : channel_state_) {
+        std::fill(c.squares.begin(), c.squares.end(), 0.0f);
+        c.sum = 0.0;
+        c.block_peak = 0.0f;
+        c.block_true_peak = 0.0f;
+        c.held_peak = 0.0f;
+        c.held_true_peak = 0.0f;
+        c.hold_remaining = 0.0f;
+        c.true_peak_hold_remaining = 0.0f;
+        std::fill(c.history, c.history + 2 * TRUE_PEAK_TAPS, 0.0f);
+    }
+}
+
+void LevelMeter::process(const float* samples, size_t frame_count) {
+    if (channels_ == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < frame_count; ++i) {
+        // Delay line runs backwards so history[pos + k] is x[n - k]
+        history_position_ = (history_position_ == 0) ? TRUE_PEAK_TAPS - 1 : history_position_ - 1;
+
+        for (uint16_t ch = 0; ch < channels_; ++ch) {
+            Channel& c = channel_state_[ch];
+            float x = samples[i * channels_ + ch];
+
+            // Running sum: drop the oldest square, add the newest
+            float square = x * x;
+            c.sum += static_cast<double>(square) - c.squares[position_];
+            c.squares[position_] = square;
+
+            c.block_peak = std::max(c.block_peak, std::abs(x));
+
+            c.history[history_position_] = x;
+            c.history[history_position_ + TRUE_PEAK_TAPS] = x;
+            const float* h = c.history + history_position_;
+            for (size_t p = 0; p < TRUE_PEAK_PHASES; ++p) {
+                const float* kernel = true_peak_kernel_[p];
+                float y = 0.0f;
+                for (size_t k = 0; k < TRUE_PEAK_TAPS; ++k) {
+                    y += kernel[k] * h[k];
+                }
+                c.block_true_peak = std::max(c.block_true_peak, std::abs(y));
+            }
+        }
+
+        if (++position_ == window_) {
+            position_ = 0;
+
+            // Once per window, rebuild the sums to cancel rounding drift
+            for (uint16_t ch = 0; ch < channels_; ++ch) {
+                Channel& c = channel_state_[ch];
+                double sum = 0.0;
+                for (float square : c.squares) {
+                    sum += square;
+                }
+                c.sum = sum;
+            }
+        }
+    }
+}
+
+void LevelMeter::update_peaks(float elapsed_seconds) {
+    const float decay = std::pow(10.0f, -decay_db_per_second_ * elapsed_seconds / 20.0f);
+
+    auto ballistics = [&](float block, float& held, float& hold_remaining) {
+        if (block >= held) {
+            held = block;
+            hold_remaining = hold_seconds_;
+        } else if (hold_remaining > 0.0f) {
+            hold_remaining -= elapsed_seconds;
+        } else {
+            held = std::max(held * decay, block);
+        }
+    };
+
+    for (uint16_t ch = 0; ch < channels_; ++ch) {
+        Channel& c = channel_state_[ch];
+        // A true peak is never below the sample peak it was built from
+        c.block_true_peak = std::max(c.block_true_peak, c.block_peak);
+
+        ballistics(c.block_peak, c.held_peak, c.hold_remaining);
+        ballistics(c.block_true_peak, c.held_true_peak, c.true_peak_hold_remaining);
+
+        c.block_peak = 0.0f;
+        c.block_true_peak = 0.0f;
+    }
+}
+
+ChannelLevel LevelMeter::level(uint16_t channel) const {
+    ChannelLevel level = {0.0f, 0.0f, 0.0f};
+    if (channel >= channels_) {
+        return level;
+    }
+
+    const Channel& c = channel_state_[channel];
+    level.peak = c.held_peak;
+    level.true_peak = c.held_true_peak;
+    level.rms = static_cast<float>(std::sqrt(std::max(0.0, c.sum) / static_cast<double>(window_)));
+    return level;
+}
+
+}} // namespace mp::core
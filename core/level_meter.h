@@ -0,0 +1,77 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+// Levels for one channel, linear full scale (1.0 = 0 dBFS)
+struct ChannelLevel {
+    float peak;         // Held sample peak
+    float true_peak;    // Held inter-sample peak (4x oversampled)
+    float rms;          // RMS over the configured window
+};
+
+// Per-channel level meter with constant cost per sample.
+//
+// RMS keeps a running sum of squares over a ring sized from the actual
+// sample rate; the sum is rebuilt from the ring once per window so float
+// drift cannot accumulate. True peak follows ITU-R BS.1770: a 48-tap
+// polyphase interpolator evaluates four phases per input sample.
+// Not thread-safe; owned by one analysis thread.
+class LevelMeter {
+public:
+    static constexpr uint16_t MAX_CHANNELS = 8;
+
+    LevelMeter();
+
+    // Resize for a new stream format. Allocates; clears all levels.
+    void configure(uint16_t channels, uint32_t sample_rate, float rms_window_ms);
+
+    // Peak hold time before decay starts, and decay rate afterwards
+    void set_peak_ballistics(float hold_ms, float decay_db_per_second);
+
+    void reset();
+
+    uint16_t channels() const { return channels_; }
+    uint32_t sample_rate() const { return sample_rate_; }
+
+    // Interleaved samples, channels() per frame
+    void process(const float* samples, size_t frame_count);
+
+    // Fold peaks seen since the last call into the held values and apply
+    // hold/decay for elapsed_seconds. Call once per display update.
+    void update_peaks(float elapsed_seconds);
+
+    ChannelLevel level(uint16_t channel) const;
+
+private:
+    static constexpr size_t TRUE_PEAK_PHASES = 4;
+    static constexpr size_t TRUE_PEAK_TAPS = 12;    // Per phase
+
+    struct Channel {
+        std::vector<float> squares;     // RMS window ring
+        double sum;
+        float block_peak;
+        float block_true_peak;
+        float held_peak;
+        float held_true_peak;
+        float hold_remaining;
+        float true_peak_hold_remaining;
+        float history[2 * TRUE_PEAK_TAPS];  // Mirrored delay line
+    };
+
+    uint16_t channels_;
+    uint32_t sample_rate_;
+    size_t window_;
+    size_t position_;
+    size_t history_position_;
+    float hold_seconds_;
+    float decay_db_per_second_;
+    Channel channel_state_[MAX_CHANNELS];
+    float true_peak_kernel_[TRUE_PEAK_PHASES][TRUE_PEAK_TAPS];
+};
+
+}} // namespace mp::core
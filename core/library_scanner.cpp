@@ -0,0 +1,296 @@
+﻿#include "library_scanner.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+
+namespace mp {
+namespace core {
+
+namespace {
+
+const size_t MAX_DEFAULT_WALKERS = 4;
+const auto CANCEL_POLL = std::chrono::milliseconds(50);
+
+// cancel() only sets a flag, so waits re-check it periodically
+template <typename Predicate>
+void wait(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, Predicate ready) {
+    while (!cv.wait_for(lock, CANCEL_POLL, ready)) {
+    }
+}
+
+struct PendingFile {
+    std::string path;
+    FileStats stats;
+};
+
+// Directories still to list; done once empty with no walker mid-directory
+class DirectoryStack {
+public:
+    void push(std::filesystem::path dir) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        dirs_.push_back(std::move(dir));
+        ++outstanding_;
+        cv_.notify_one();
+    }
+
+    bool pop(std::filesystem::path& dir, const std::atomic<bool>& cancelled) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wait(cv_, lock, [&] { return !dirs_.empty() || outstanding_ == 0 || cancelled; });
+        if (dirs_.empty() || cancelled) {
+            return false;
+        }
+        dir = std::move(dirs_.back());
+        dirs_.pop_back();
+        return true;
+    }
+
+    void finished() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--outstanding_ == 0) {
+            cv_.notify_all();
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::filesystem::path> dirs_;
+    size_t outstanding_ = 0;
+};
+
+// Bounded hand-off from walkers to tag readers
+class FileQueue {
+public:
+    explicit FileQueue(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {}
+
+    void push(PendingFile file, const std::atomic<bool>& cancelled) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wait(not_full_, lock, [&] { return files_.size() < capacity_ || cancelled; });
+        if (cancelled) {
+            return;
+        }
+        files_.push_back(std::move(file));
+        not_empty_.notify_one();
+    }
+
+    bool pop(PendingFile& file, const std::atomic<bool>& cancelled) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wait(not_empty_, lock, [&] { return !files_.empty() || closed_ || cancelled; });
+        if (files_.empty() || cancelled) {
+            return false;
+        }
+        file = std::move(files_.front());
+        files_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::deque<PendingFile> files_;
+    bool closed_ = false;
+};
+
+size_t thread_count(size_t requested, size_t limit) {
+    if (requested > 0) {
+        return requested;
+    }
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    return std::min(cores, limit);
+}
+
+// Root as a path prefix, with a trailing separator
+std::string root_prefix(const std::string& root) {
+    std::string prefix = std::filesystem::path(root).lexically_normal().string();
+    if (prefix.empty() || prefix.back() != std::filesystem::path::preferred_separator) {
+        prefix += std::filesystem::path::preferred_separator;
+    }
+    return prefix;
+}
+
+} // namespace
+
+LibraryScanner::LibraryScanner(MetadataStore& store, IEventBus* event_bus)
+    : store_(store)
+    , event_bus_(event_bus)
+    , tag_reader_(read_track_metadata)
+    , cancelled_(false) {
+}
+
+const std::vector<std::string>& LibraryScanner::default_extensions() {
+    static const std::vector<std::string> extensions = {
+        ".mp3", ".flac", ".ogg", ".oga", ".opus", ".wav", ".rf64", ".aif", ".aiff", ".aifc"
+    };
+    return extensions;
+}
+
+bool LibraryScanner::wanted(const std::string& filename) const {
+    size_t dot = filename.rfind('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string ext = filename.substr(dot);
+    for (char& c : ext) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    const auto& list = options_.extensions.empty() ? default_extensions() : options_.extensions;
+    return std::find(list.begin(), list.end(), ext) != list.end();
+}
+
+ScanStats LibraryScanner::scan(const std::vector<std::string>& roots) {
+    cancelled_.store(false, std::memory_order_relaxed);
+
+    DirectoryStack dirs;
+    FileQueue queue(options_.queue_capacity);
+    std::vector<std::string> prefixes;
+    for (const std::string& root : roots) {
+        prefixes.push_back(root_prefix(root));
+        dirs.push(std::filesystem::path(root).lexically_normal());
+    }
+
+    std::atomic<uint64_t> seen(0), unchanged(0), read(0), failed(0);
+    std::mutex seen_mutex;
+    std::unordered_set<std::string> seen_paths;
+    std::vector<std::string> unlisted;          // As prefixes
+
+    auto walk = [&] {
+        std::vector<std::string> local_seen;
+        std::vector<std::string> local_unlisted;
+        std::filesystem::path dir;
+        while (dirs.pop(dir, cancelled_)) {
+            std::error_code ec;
+            std::filesystem::directory_iterator it(dir, ec);
+            for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+                if (cancelled_.load(std::memory_order_relaxed)) {
+                    break;
+                }
+                const auto& entry = *it;
+                std::error_code entry_ec;
+                if (entry.is_directory(entry_ec)) {
+                    // Linked directories are skipped so cycles cannot occur
+                    if (!entry.is_symlink(entry_ec)) {
+                        dirs.push(entry.path());
+                    }
+                    continue;
+                }
+                if (!wanted(entry.path().filename().string())) {
+                    continue;
+                }
+
+                PendingFile file{entry.path().string(), FileStats()};
+                if (!stat_file(file.path, file.stats)) {
+                    continue;
+                }
+                ++seen;
+                local_seen.push_back(file.path);
+
+                if (store_.is_current(file.path, file.stats)) {
+                    ++unchanged;
+                } else {
+                    queue.push(std::move(file), cancelled_);
+                }
+            }
+            // Not seeing its files does not make them gone
+            if (ec) {
+                local_unlisted.push_back(root_prefix(dir.string()));
+            }
+            dirs.finished();
+        }
+
+        std::lock_guard<std::mutex> lock(seen_mutex);
+        for (std::string& path : local_seen) {
+            seen_paths.insert(std::move(path));
+        }
+        for (std::string& prefix : local_unlisted) {
+            unlisted.push_back(std::move(prefix));
+        }
+    };
+
+    auto read_tags = [&] {
+        PendingFile file;
+        while (queue.pop(file, cancelled_)) {
+            TrackMetadata track;
+            if (tag_reader_(file.path, track)) {
+                // Keyed by the stats the walker saw: a file modified since
+                // simply reads again next scan
+                track.path = file.path;
+                track.stats = file.stats;
+                store_.put(track);
+                ++read;
+            } else {
+                ++failed;
+            }
+        }
+    };
+
+    std::vector<std::thread> readers;
+    for (size_t i = 0, n = thread_count(options_.reader_threads, SIZE_MAX); i < n; ++i) {
+        readers.emplace_back(read_tags);
+    }
+    std::vector<std::thread> walkers;
+    for (size_t i = 0, n = thread_count(options_.walker_threads, MAX_DEFAULT_WALKERS); i < n; ++i) {
+        walkers.emplace_back(walk);
+    }
+    for (auto& t : walkers) {
+        t.join();
+    }
+    queue.close();
+    for (auto& t : readers) {
+        t.join();
+    }
+
+    ScanStats stats;
+    stats.cancelled = cancelled_.load(std::memory_order_relaxed);
+    stats.seen = seen;
+    stats.unchanged = unchanged;
+    stats.read = read;
+    stats.failed = failed;
+    stats.unlisted = unlisted.size();
+
+    // Only a complete walk can tell what is gone
+    if (!stats.cancelled) {
+        auto under = [](const std::string& path, const std::vector<std::string>& dirs) {
+            return std::any_of(dirs.begin(), dirs.end(), [&](const std::string& prefix) {
+                return path.compare(0, prefix.size(), prefix) == 0;
+            });
+        };
+        std::vector<std::string> gone;
+        store_.for_each([&](const TrackMetadata& track) {
+            if (under(track.path, prefixes) && !under(track.path, unlisted) &&
+                seen_paths.find(track.path) == seen_paths.end()) {
+                gone.push_back(track.path);
+            }
+        });
+        for (const std::string& path : gone) {
+            if (store_.erase(path)) {
+                ++stats.removed;
+            }
+        }
+    }
+    store_.commit();
+
+    if (event_bus_) {
+        Event event(EVENT_LIBRARY_UPDATED, &stats, sizeof(stats));
+        event_bus_->publish_sync(event);
+    }
+    return stats;
+}
+
+}} // namespace mp::core
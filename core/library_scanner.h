@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include "metadata_store.h"
+#include "mp_event.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+struct ScanOptions {
+    std::vector<std::string> extensions;    // Lower case with the dot; empty for the defaults
+    size_t walker_threads;                  // 0: one per core, at most 4
+    size_t reader_threads;                  // 0: one per core
+    size_t queue_capacity;                  // Files waiting for a tag reader
+
+    ScanOptions() : walker_threads(0), reader_threads(0), queue_capacity(256) {}
+};
+
+// Counts for one scan; published with EVENT_LIBRARY_UPDATED
+struct ScanStats {
+    uint64_t seen;          // Audio files found under the roots
+    uint64_t unchanged;     // Still matching their stored size and mtime
+    uint64_t read;          // New or changed and read into the store
+    uint64_t failed;        // New or changed but unreadable
+    uint64_t removed;       // Stored entries under the roots that are gone
+    uint64_t unlisted;      // Directories that could not be listed
+    bool cancelled;
+
+    ScanStats() : seen(0), unchanged(0), read(0), failed(0), removed(0), unlisted(0), cancelled(false) {}
+};
+
+// Brings a MetadataStore up to date with directory trees.
+//
+// Walker threads share a stack of directories, so deep and wide trees
+// both spread across them; each file is stat'ed and checked against the
+// store, and only new or changed ones go through a bounded queue to the
+// tag-reader threads, which read headers (read_track_metadata by default)
+// and put the result. A rescan of an unchanged library therefore costs a
+// directory walk and a stat per file. Entries under the roots whose files
+// have disappeared are erased, the store is committed, and
+// EVENT_LIBRARY_UPDATED is published synchronously with a ScanStats*.
+class LibraryScanner {
+public:
+    using TagReader = std::function<bool(const std::string& path, TrackMetadata& out)>;
+
+    explicit LibraryScanner(MetadataStore& store, IEventBus* event_bus = nullptr);
+
+    void set_options(const ScanOptions& options) { options_ = options; }
+    const ScanOptions& options() const { return options_; }
+
+    // Replaces read_track_metadata, e.g. for a decoder-backed reader
+    void set_tag_reader(TagReader reader) { tag_reader_ = std::move(reader); }
+
+    // Blocks until the roots are scanned or cancel() is called. A
+    // cancelled scan keeps what it read but removes nothing, and entries
+    // under a directory that could not be listed (unreadable, or a root
+    // that is not mounted) are kept.
+    ScanStats scan(const std::vector<std::string>& roots);
+
+    // From any thread
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+    static const std::vector<std::string>& default_extensions();
+
+private:
+    bool wanted(const std::string& filename) const;
+
+    MetadataStore& store_;
+    IEventBus* event_bus_;
+    ScanOptions options_;
+    TagReader tag_reader_;
+    std::atomic<bool> cancelled_;
+};
+
+}} // namespace mp::core
@@ -0,0 +1,269 @@
+﻿#include "metadata_store.h"
+#include "record_log.h"
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+
+namespace mp {
+namespace core {
+
+namespace {
+
+const char STORE_MAGIC[4] = {'X', 'M', 'D', 'B'};
+const uint32_t STORE_VERSION = 1;
+const size_t MIN_COMPACT_RECORDS = 1024;
+
+const uint8_t RECORD_PUT = 1;
+const uint8_t RECORD_ERASE = 2;
+
+using record_log::Cursor;
+using record_log::put_string;
+using record_log::put_value;
+
+std::string encode_track(const TrackMetadata& track) {
+    std::string out;
+    put_string(out, track.path);
+    put_value(out, track.stats.size);
+    put_value(out, track.stats.mtime_ns);
+    put_value(out, track.sample_rate);
+    put_value(out, track.channels);
+    put_value(out, track.bits_per_sample);
+    put_value(out, track.total_samples);
+    put_value(out, track.duration_ms);
+    put_value(out, static_cast<uint32_t>(track.tags.size()));
+    for (const auto& tag : track.tags) {
+        put_string(out, tag.first);
+        put_string(out, tag.second);
+    }
+    return out;
+}
+
+bool decode_track(Cursor c, TrackMetadata& track) {
+    uint32_t tag_count;
+    if (!c.get(track.path) || !c.get(track.stats.size) || !c.get(track.stats.mtime_ns) ||
+        !c.get(track.sample_rate) || !c.get(track.channels) || !c.get(track.bits_per_sample) ||
+        !c.get(track.total_samples) || !c.get(track.duration_ms) || !c.get(tag_count)) {
+        return false;
+    }
+    track.tags.clear();
+    track.tags.reserve(tag_count);
+    for (uint32_t i = 0; i < tag_count; ++i) {
+        std::string key, value;
+        if (!c.get(key) || !c.get(value)) {
+            return false;
+        }
+        track.tags.emplace_back(std::move(key), std::move(value));
+    }
+    return true;
+}
+
+} // namespace
+
+MetadataStore::MetadataStore()
+    : log_(nullptr)
+    , dead_records_(0) {
+}
+
+MetadataStore::~MetadataStore() {
+    close();
+}
+
+std::string MetadataStore::default_path() {
+    std::filesystem::path dir;
+    if (const char* custom = std::getenv("XPUMUSIC_CACHE_DIR")) {
+        dir = custom;
+#ifdef _WIN32
+    } else if (const char* local = std::getenv("LOCALAPPDATA")) {
+        dir = std::filesystem::path(local) / "XpuMusic";
+#else
+    } else if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        dir = std::filesystem::path(xdg) / "xpumusic";
+    } else if (const char* home = std::getenv("HOME")) {
+        dir = std::filesystem::path(home) / ".cache" / "xpumusic";
+#endif
+    } else {
+        dir = std::filesystem::temp_directory_path() / "xpumusic";
+    }
+    return (dir / "library.db").string();
+}
+
+bool MetadataStore::open(const std::string& db_path) {
+    close();
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    path_ = db_path;
+
+    std::error_code ec;
+    std::filesystem::path parent = std::filesystem::path(db_path).parent_path();
+    if (!parent.empty()) {
+        std::filesystem::create_directories(parent, ec);
+    }
+
+    if (!load()) {
+        // Missing or unreadable: keep what was there and start a fresh log
+        tracks_.clear();
+        dead_records_ = 0;
+        if (!record_log::set_aside(db_path) || !record_log::create(db_path, STORE_MAGIC, STORE_VERSION)) {
+            return false;
+        }
+    }
+
+    log_ = fopen(db_path.c_str(), "ab");
+    return log_ != nullptr;
+}
+
+bool MetadataStore::load() {
+    size_t records = 0;
+    bool ok = record_log::replay(path_, STORE_MAGIC, STORE_VERSION, STORE_VERSION, [&](uint8_t type, Cursor cursor) {
+        if (type == RECORD_PUT) {
+            TrackMetadata track;
+            if (!decode_track(cursor, track)) {
+                return false;
+            }
+            std::string key = track.path;
+            tracks_[key] = std::move(track);
+        } else if (type == RECORD_ERASE) {
+            std::string path;
+            if (!cursor.get(path)) {
+                return false;
+            }
+            tracks_.erase(path);
+        } else {
+            return false;
+        }
+        ++records;
+        return true;
+    });
+    dead_records_ = records - tracks_.size();
+    return ok;
+}
+
+void MetadataStore::close() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (log_) {
+        fclose(log_);
+        log_ = nullptr;
+    }
+    tracks_.clear();
+    dead_records_ = 0;
+}
+
+bool MetadataStore::is_open() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return log_ != nullptr;
+}
+
+bool MetadataStore::append(uint8_t type, const std::string& payload) {
+    if (!log_) {
+        return false;
+    }
+    std::string record = record_log::encode(type, payload);
+    return fwrite(record.data(), 1, record.size(), log_) == record.size();
+}
+
+bool MetadataStore::lookup(const std::string& path, const FileStats& stats, TrackMetadata& out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = tracks_.find(path);
+    if (it == tracks_.end() || it->second.stats != stats) {
+        return false;
+    }
+    out = it->second;
+    return true;
+}
+
+bool MetadataStore::is_current(const std::string& path, const FileStats& stats) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = tracks_.find(path);
+    return it != tracks_.end() && it->second.stats == stats;
+}
+
+bool MetadataStore::get(const std::string& path, TrackMetadata& out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = tracks_.find(path);
+    if (it == tracks_.end()) {
+        return false;
+    }
+    out = it->second;
+    return true;
+}
+
+bool MetadataStore::put(const TrackMetadata& track) {
+    std::string payload = encode_track(track);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (!append(RECORD_PUT, payload)) {
+        return false;
+    }
+    auto result = tracks_.insert_or_assign(track.path, track);
+    if (!result.second) {
+        ++dead_records_;
+    }
+    return true;
+}
+
+bool MetadataStore::erase(const std::string& path) {
+    std::string payload;
+    put_string(payload, path);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (tracks_.find(path) == tracks_.end()) {
+        return true;
+    }
+    if (!append(RECORD_ERASE, payload)) {
+        return false;
+    }
+    tracks_.erase(path);
+    dead_records_ += 2;         // The put it cancels, and itself
+    return true;
+}
+
+bool MetadataStore::commit() {
+    bool should_compact;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (!log_ || fflush(log_) != 0) {
+            return false;
+        }
+        should_compact = dead_records_ >= MIN_COMPACT_RECORDS && dead_records_ > tracks_.size();
+    }
+    return should_compact ? compact() : true;
+}
+
+bool MetadataStore::compact() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (!log_) {
+        return false;
+    }
+
+    bool ok = record_log::rewrite(path_, STORE_MAGIC, STORE_VERSION, log_, [this](FILE* out) {
+        for (const auto& entry : tracks_) {
+            std::string record = record_log::encode(RECORD_PUT, encode_track(entry.second));
+            if (fwrite(record.data(), 1, record.size(), out) != record.size()) {
+                return false;
+            }
+        }
+        return true;
+    });
+    if (!ok) {
+        return false;
+    }
+    dead_records_ = 0;
+    return true;
+}
+
+size_t MetadataStore::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return tracks_.size();
+}
+
+size_t MetadataStore::dead_records() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return dead_records_;
+}
+
+void MetadataStore::for_each(const std::function<void(const TrackMetadata&)>& fn) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (const auto& entry : tracks_) {
+        fn(entry.second);
+    }
+}
+
+}} // namespace mp::core
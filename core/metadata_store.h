@@ -0,0 +1,75 @@
+﻿#pragma once
+
+#include "track_metadata.h"
+#include <cstdio>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace mp {
+namespace core {
+
+// Persistent library database: TrackMetadata keyed by path, valid for as
+// long as the file's size and mtime match the stats it was read with.
+//
+// On disk it is an append-only log: a header, then one record per put or
+// erase, each with its length and a checksum. Opening maps the log and
+// replays it; a torn record at the end (a crash mid-append) is cut off.
+// Updates only ever append, so a rescan that changes ten files writes ten
+// records. Superseded records are dropped by compact(), which rewrites the
+// live entries to a temporary file and renames it over the log; commit()
+// does this by itself once the dead records outnumber the live ones.
+//
+// All members are thread-safe; lookups run concurrently.
+class MetadataStore {
+public:
+    MetadataStore();
+    ~MetadataStore();
+
+    MetadataStore(const MetadataStore&) = delete;
+    MetadataStore& operator=(const MetadataStore&) = delete;
+
+    // Load db_path, creating it if missing. A file that is not a store
+    // (bad header) is renamed to db_path + ".bad" and a new one started.
+    bool open(const std::string& db_path);
+    void close();
+    bool is_open() const;
+
+    // $XPUMUSIC_CACHE_DIR/library.db, else under the platform cache
+    // directory as for the MP3 seek index
+    static std::string default_path();
+
+    // Entry for path if one exists and was read with these stats
+    bool lookup(const std::string& path, const FileStats& stats, TrackMetadata& out) const;
+
+    // Whether lookup() would succeed, without copying the entry
+    bool is_current(const std::string& path, const FileStats& stats) const;
+
+    // Entry for path regardless of stats
+    bool get(const std::string& path, TrackMetadata& out) const;
+
+    // Add or replace the entry for track.path
+    bool put(const TrackMetadata& track);
+    bool erase(const std::string& path);
+
+    // Flush appended records; compacts when the log is mostly dead records
+    bool commit();
+    bool compact();
+
+    size_t size() const;
+    size_t dead_records() const;
+    void for_each(const std::function<void(const TrackMetadata&)>& fn) const;
+
+private:
+    bool load();
+    bool append(uint8_t type, const std::string& payload);
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, TrackMetadata> tracks_;
+    std::string path_;
+    FILE* log_;
+    size_t dead_records_;
+};
+
+}} // namespace mp::core
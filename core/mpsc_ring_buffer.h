@@ -0,0 +1,122 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace mp {
+namespace core {
+
+// Bounded lock-free multi-producer/single-consumer queue.
+//
+// Any thread may push(); one thread may pop(). Each slot carries a sequence
+// number (Vyukov's bounded queue): a producer claims the next slot with one
+// compare-and-swap on the head, fills it and then marks it ready, so the
+// consumer never sees a half-written element. A producer that keeps losing
+// the race gives up after MAX_ATTEMPTS, which bounds push() to a fixed
+// number of steps: it is wait-free, never allocates or locks, and is safe
+// from an audio callback. It fails when the queue is full or contended.
+// Capacity is rounded up to a power of two.
+template <typename T>
+class MpscRingBuffer {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "MpscRingBuffer elements are copied by value into their slot");
+
+public:
+    explicit MpscRingBuffer(size_t min_capacity)
+        : capacity_(round_up_pow2(min_capacity < 2 ? 2 : min_capacity))
+        , mask_(capacity_ - 1)
+        , slots_(new Slot[capacity_])
+        , head_(0)
+        , tail_(0) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRingBuffer(const MpscRingBuffer&) = delete;
+    MpscRingBuffer& operator=(const MpscRingBuffer&) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    // Any thread: false if the queue is full or the slot could not be
+    // claimed within MAX_ATTEMPTS
+    bool push(const T& value) {
+        size_t position = head_.load(std::memory_order_relaxed);
+        for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+            Slot& slot = slots_[position & mask_];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const intptr_t lag = static_cast<intptr_t>(sequence - position);
+            if (lag == 0) {
+                if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+                // position now holds the current head
+            } else if (lag < 0) {
+                return false;       // The consumer has not freed this slot yet
+            } else {
+                position = head_.load(std::memory_order_relaxed);
+            }
+        }
+        return false;
+    }
+
+    // Consumer: false if the next element is not ready
+    bool pop(T& value) {
+        const size_t position = tail_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[position & mask_];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+            return false;
+        }
+        value = slot.value;
+        slot.sequence.store(position + capacity_, std::memory_order_release);
+        tail_.store(position + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Consumer: pop up to count elements, returns elements read
+    size_t pop(T* values, size_t count) {
+        size_t n = 0;
+        while (n < count && pop(values[n])) {
+            ++n;
+        }
+        return n;
+    }
+
+    // Elements claimed by producers and not yet popped; a snapshot
+    size_t size_approx() const {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        return head > tail ? head - tail : 0;
+    }
+
+private:
+    static constexpr int MAX_ATTEMPTS = 64;
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t round_up_pow2(size_t n) {
+        size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+
+    // Producers share the head; only the consumer moves the tail
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+};
+
+}} // namespace mp::core
@@ -0,0 +1,100 @@
+﻿#pragma once
+
+#include "spsc_ring_buffer.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace mp {
+namespace core {
+
+// One parameter change on its way to the audio thread. Targets and
+// parameters are integer handles resolved by the sender beforehand, so the
+// audio thread never looks anything up by name.
+struct ParameterChange {
+    uint32_t target;        // Effect or node id
+    uint32_t parameter;     // Index within the target
+    float value;
+    float ramp_ms;          // 0 jumps straight to value
+};
+
+// UI or control thread -> audio thread. Wait-free on both sides; a full
+// queue rejects the change rather than blocking.
+class ParameterQueue {
+public:
+    explicit ParameterQueue(size_t capacity = 256) : ring_(capacity) {}
+
+    // Producer
+    bool push(const ParameterChange& change) {
+        return ring_.write(&change, 1) == 1;
+    }
+
+    // Consumer: up to max changes, oldest first
+    size_t pop(ParameterChange* changes, size_t max) {
+        return ring_.read(changes, max);
+    }
+
+    size_t pending() const { return ring_.read_available(); }
+
+private:
+    SpscRingBuffer<ParameterChange> ring_;
+};
+
+// Linear ramp towards a target value, so parameter jumps do not click.
+// Use next() for per-sample smoothing (gains) or advance() once per block
+// where coefficients are only recomputed per block (filters).
+class SmoothedParameter {
+public:
+    explicit SmoothedParameter(float value = 0.0f)
+        : current_(value), target_(value), step_(0.0f), remaining_(0) {}
+
+    void set_immediate(float value) {
+        current_ = target_ = value;
+        step_ = 0.0f;
+        remaining_ = 0;
+    }
+
+    // Reaches value after ramp_frames calls to next(), or as many frames
+    // passed to advance()
+    void set_target(float value, uint32_t ramp_frames) {
+        if (ramp_frames == 0) {
+            set_immediate(value);
+            return;
+        }
+        target_ = value;
+        step_ = (value - current_) / static_cast<float>(ramp_frames);
+        remaining_ = ramp_frames;
+    }
+
+    // Value for the next sample
+    float next() {
+        if (remaining_ != 0) {
+            // Land exactly on the target rather than on accumulated steps
+            current_ = --remaining_ == 0 ? target_ : current_ + step_;
+        }
+        return current_;
+    }
+
+    // Skips frames samples ahead and returns the value reached
+    float advance(uint32_t frames) {
+        if (frames >= remaining_) {
+            current_ = target_;
+            remaining_ = 0;
+        } else {
+            current_ += step_ * static_cast<float>(frames);
+            remaining_ -= frames;
+        }
+        return current_;
+    }
+
+    float value() const { return current_; }
+    float target() const { return target_; }
+    bool is_smoothing() const { return remaining_ != 0; }
+
+private:
+    float current_;
+    float target_;
+    float step_;
+    uint32_t remaining_;
+};
+
+}} // namespace mp::core
@@ -0,0 +1,299 @@
+﻿#include "partitioned_convolver.h"
+#include <algorithm>
+#include <cstring>
+
+#ifndef MP_CONVOLVER_SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MP_CONVOLVER_SSE2 1
+#else
+#define MP_CONVOLVER_SSE2 0
+#endif
+#endif
+
+#if MP_CONVOLVER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace mp {
+namespace core {
+
+namespace {
+
+// Partition growth between segments of the non-uniform layout
+const size_t GROWTH = 4;
+
+const size_t STRIDE_PADDING = 16;
+
+bool is_power_of_two(size_t n) {
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+size_t next_power_of_two(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+// acc += x * h over split complex arrays
+void multiply_accumulate(const float* x_re, const float* x_im,
+                         const float* h_re, const float* h_im,
+                         float* acc_re, float* acc_im, size_t bins) {
+    size_t k = 0;
+#if MP_CONVOLVER_SSE2
+    for (; k + 4 <= bins; k += 4) {
+        __m128 xr = _mm_loadu_ps(x_re + k);
+        __m128 xi = _mm_loadu_ps(x_im + k);
+        __m128 hr = _mm_loadu_ps(h_re + k);
+        __m128 hi = _mm_loadu_ps(h_im + k);
+        __m128 re = _mm_sub_ps(_mm_mul_ps(xr, hr), _mm_mul_ps(xi, hi));
+        __m128 im = _mm_add_ps(_mm_mul_ps(xr, hi), _mm_mul_ps(xi, hr));
+        _mm_storeu_ps(acc_re + k, _mm_add_ps(_mm_loadu_ps(acc_re + k), re));
+        _mm_storeu_ps(acc_im + k, _mm_add_ps(_mm_loadu_ps(acc_im + k), im));
+    }
+#endif
+    for (; k < bins; ++k) {
+        acc_re[k] += x_re[k] * h_re[k] - x_im[k] * h_im[k];
+        acc_im[k] += x_re[k] * h_im[k] + x_im[k] * h_re[k];
+    }
+}
+
+void split(const std::complex<float>* spectrum, float* re, float* im, size_t bins) {
+    for (size_t k = 0; k < bins; ++k) {
+        re[k] = spectrum[k].real();
+        im[k] = spectrum[k].imag();
+    }
+}
+
+} // namespace
+
+PartitionedConvolver::PartitionedConvolver()
+    : channels_(0)
+    , ir_channels_(0)
+    , block_size_(0)
+    , fill_(0)
+    , ring_size_(0)
+    , ring_position_(0) {
+}
+
+PartitionedConvolver::~PartitionedConvolver() = default;
+
+bool PartitionedConvolver::configure(const float* ir, size_t ir_frames, uint16_t ir_channels,
+                                     uint16_t channels, size_t block_size, size_t max_partition) {
+    block_size_ = 0;
+    segments_.clear();
+
+    if (!ir || ir_frames == 0 || ir_channels == 0 || channels == 0 ||
+        block_size < 16 || !is_power_of_two(block_size)) {
+        return false;
+    }
+    if (max_partition == 0) {
+        max_partition = block_size;
+    }
+    if (max_partition < block_size || !is_power_of_two(max_partition)) {
+        return false;
+    }
+
+    // A segment of partition P produces its block P - block_size frames
+    // after the block it delays, so it may start no earlier than that
+    size_t offset = 0;
+    size_t size = block_size;
+    while (offset < ir_frames) {
+        size_t count = (ir_frames - offset + size - 1) / size;
+        size_t next = std::min(size * GROWTH, max_partition);
+        if (next > size) {
+            size_t start = next - block_size;
+            size_t needed = start > offset ? (start - offset + size - 1) / size : 1;
+            count = std::min(count, needed);
+        }
+
+        Segment segment;
+        segment.size = size;
+        segment.offset = offset;
+        segment.count = count;
+        segment.stride = size + STRIDE_PADDING;
+        segment.phase = 0;
+        segment.head = 0;
+        segments_.push_back(std::move(segment));
+
+        offset += count * size;
+        size = next;
+    }
+
+    const size_t largest = segments_.back().size;
+    spectrum_.assign(largest + 1, std::complex<float>());
+    accumulate_re_.assign(largest + STRIDE_PADDING, 0.0f);
+    accumulate_im_.assign(largest + STRIDE_PADDING, 0.0f);
+    time_.assign(2 * largest, 0.0f);
+
+    // Transform every partition of the response once
+    for (Segment& segment : segments_) {
+        const size_t P = segment.size;
+        const size_t bins = P + 1;
+        segment.fft.reset(new RealFFT(2 * P));
+        segment.filter_re.assign(ir_channels * segment.count * segment.stride, 0.0f);
+        segment.filter_im.assign(ir_channels * segment.count * segment.stride, 0.0f);
+
+        for (uint16_t ic = 0; ic < ir_channels; ++ic) {
+            for (size_t p = 0; p < segment.count; ++p) {
+                std::fill(time_.begin(), time_.begin() + 2 * P, 0.0f);
+                size_t first = segment.offset + p * P;
+                size_t last = std::min(first + P, ir_frames);
+                for (size_t i = first; i < last; ++i) {
+                    time_[i - first] = ir[i * ir_channels + ic];
+                }
+                segment.fft->forward(time_.data(), spectrum_.data());
+
+                size_t at = (ic * segment.count + p) * segment.stride;
+                split(spectrum_.data(), segment.filter_re.data() + at,
+                      segment.filter_im.data() + at, bins);
+            }
+        }
+
+        segment.delay_re.assign(channels * segment.count * segment.stride, 0.0f);
+        segment.delay_im.assign(channels * segment.count * segment.stride, 0.0f);
+        segment.input.assign(channels * 2 * P, 0.0f);
+    }
+
+    size_t reach = 0;
+    for (const Segment& segment : segments_) {
+        reach = std::max(reach, segment.offset + block_size);
+    }
+    ring_size_ = next_power_of_two(reach);
+    output_ring_.assign(channels * ring_size_, 0.0f);
+    input_block_.assign(channels * block_size, 0.0f);
+    output_block_.assign(channels * block_size, 0.0f);
+
+    channels_ = channels;
+    ir_channels_ = ir_channels;
+    block_size_ = block_size;
+    reset();
+    return true;
+}
+
+void PartitionedConvolver::reset() {
+    for (Segment& segment : segments_) {
+        std::fill(segment.delay_re.begin(), segment.delay_re.end(), 0.0f);
+        std::fill(segment.delay_im.begin(), segment.delay_im.end(), 0.0f);
+        std::fill(segment.input.begin(), segment.input.end(), 0.0f);
+        segment.phase = 0;
+        segment.head = 0;
+    }
+    std::fill(output_ring_.begin(), output_ring_.end(), 0.0f);
+    std::fill(input_block_.begin(), input_block_.end(), 0.0f);
+    std::fill(output_block_.begin(), output_block_.end(), 0.0f);
+    ring_position_ = 0;
+    fill_ = 0;
+}
+
+void PartitionedConvolver::process(float* samples, size_t frames) {
+    if (block_size_ == 0 || !samples) {
+        return;
+    }
+
+    size_t done = 0;
+    while (done < frames) {
+        size_t count = std::min(block_size_ - fill_, frames - done);
+        for (uint16_t c = 0; c < channels_; ++c) {
+            float* input = input_block_.data() + c * block_size_ + fill_;
+            const float* output = output_block_.data() + c * block_size_ + fill_;
+            float* frame = samples + done * channels_ + c;
+            for (size_t i = 0; i < count; ++i) {
+                input[i] = frame[i * channels_];
+                frame[i * channels_] = output[i];
+            }
+        }
+
+        done += count;
+        fill_ += count;
+        if (fill_ == block_size_) {
+            run_block();
+            fill_ = 0;
+        }
+    }
+}
+
+void PartitionedConvolver::run_block() {
+    const size_t B = block_size_;
+
+    for (Segment& segment : segments_) {
+        const size_t P = segment.size;
+        for (uint16_t c = 0; c < channels_; ++c) {
+            std::memcpy(segment.input.data() + c * 2 * P + P + segment.phase * B,
+                        input_block_.data() + c * B, B * sizeof(float));
+        }
+        if (++segment.phase * B == P) {
+            run_segment(segment);
+            segment.phase = 0;
+        }
+    }
+
+    // Emit the block that is now complete and clear it for reuse
+    for (uint16_t c = 0; c < channels_; ++c) {
+        float* ring = output_ring_.data() + c * ring_size_ + ring_position_;
+        std::memcpy(output_block_.data() + c * B, ring, B * sizeof(float));
+        std::fill(ring, ring + B, 0.0f);
+    }
+    ring_position_ = (ring_position_ + B) & (ring_size_ - 1);
+}
+
+void PartitionedConvolver::run_segment(Segment& segment) {
+    const size_t P = segment.size;
+    const size_t bins = P + 1;
+    const size_t stride = segment.stride;
+    const size_t count = segment.count;
+    const size_t mask = ring_size_ - 1;
+
+    if (++segment.head == count) {
+        segment.head = 0;
+    }
+
+    // The newest P outputs belong offset frames after the partition's input,
+    // which ended P - block_size frames before the block being emitted
+    const size_t start = (ring_position_ + segment.offset + block_size_ - P) & mask;
+    const size_t first_span = std::min(P, ring_size_ - start);
+
+    for (uint16_t c = 0; c < channels_; ++c) {
+        float* input = segment.input.data() + c * 2 * P;
+        float* delay_re = segment.delay_re.data() + c * count * stride;
+        float* delay_im = segment.delay_im.data() + c * count * stride;
+        const size_t filter = (c % ir_channels_) * count * stride;
+        const float* filter_re = segment.filter_re.data() + filter;
+        const float* filter_im = segment.filter_im.data() + filter;
+
+        segment.fft->forward(input, spectrum_.data());
+        split(spectrum_.data(), delay_re + segment.head * stride,
+              delay_im + segment.head * stride, bins);
+
+        // Partition p of the response meets the input from p blocks ago
+        std::fill(accumulate_re_.begin(), accumulate_re_.begin() + bins, 0.0f);
+        std::fill(accumulate_im_.begin(), accumulate_im_.begin() + bins, 0.0f);
+        size_t slot = segment.head;
+        for (size_t p = 0; p < count; ++p) {
+            multiply_accumulate(delay_re + slot * stride, delay_im + slot * stride,
+                                filter_re + p * stride, filter_im + p * stride,
+                                accumulate_re_.data(), accumulate_im_.data(), bins);
+            slot = slot == 0 ? count - 1 : slot - 1;
+        }
+
+        for (size_t k = 0; k < bins; ++k) {
+            spectrum_[k] = std::complex<float>(accumulate_re_[k], accumulate_im_[k]);
+        }
+        segment.fft->inverse(spectrum_.data(), time_.data());
+
+        // The first half is circular wrap-around; only the second is valid
+        float* ring = output_ring_.data() + c * ring_size_;
+        const float* valid = time_.data() + P;
+        for (size_t i = 0; i < first_span; ++i) {
+            ring[start + i] += valid[i];
+        }
+        for (size_t i = first_span; i < P; ++i) {
+            ring[i - first_span] += valid[i];
+        }
+
+        std::memcpy(input, input + P, P * sizeof(float));
+    }
+}
+
+}} // namespace mp::core
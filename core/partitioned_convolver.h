@@ -0,0 +1,95 @@
+﻿#pragma once
+
+#include "fft.h"
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+// Partitioned overlap-save convolution for long impulse responses.
+//
+// The impulse response is cut into segments. Segment k uses partitions of
+// P_k samples, an FFT of 2 * P_k and a frequency-domain delay line holding
+// the spectra of its last input blocks; each output block is one spectral
+// multiply-accumulate over the delay line (SSE2 where available) and one
+// inverse FFT.
+//
+// Uniform layout: a single segment whose partition equals the block size.
+// Non-uniform layout: partitions grow 4x per segment up to max_partition,
+// so the head of the response keeps the short block latency while the
+// tail is processed in few large partitions. Larger segments run only on
+// their own block boundaries, so the work per call is uneven.
+//
+// Latency is block_size frames in both layouts. Wet only; not thread-safe.
+class PartitionedConvolver {
+public:
+    PartitionedConvolver();
+    ~PartitionedConvolver();
+
+    // Allocates and transforms the impulse response. ir holds ir_frames
+    // interleaved frames of ir_channels; output channel c uses IR channel
+    // c % ir_channels. block_size is a power of two >= 16. max_partition of
+    // 0 (or block_size) selects the uniform layout.
+    bool configure(const float* ir, size_t ir_frames, uint16_t ir_channels,
+                   uint16_t channels, size_t block_size, size_t max_partition = 0);
+
+    // Clears all history; keeps the impulse response
+    void reset();
+
+    // Replaces the interleaved input with the convolved signal, in place
+    void process(float* samples, size_t frames);
+
+    bool is_configured() const { return block_size_ != 0; }
+    size_t latency() const { return block_size_; }
+    size_t block_size() const { return block_size_; }
+    uint16_t channels() const { return channels_; }
+
+    size_t segment_count() const { return segments_.size(); }
+    size_t partition_size(size_t segment) const { return segments_[segment].size; }
+    size_t partition_count(size_t segment) const { return segments_[segment].count; }
+
+private:
+    struct Segment {
+        size_t size;                    // Partition length P
+        size_t offset;                  // First IR frame covered
+        size_t count;                   // Partitions
+        size_t stride;                  // Floats per stored spectrum (>= P + 1)
+        size_t phase;                   // Blocks collected towards the next partition
+        size_t head;                    // Newest slot of the delay line
+        std::unique_ptr<RealFFT> fft;   // Size 2P
+        std::vector<float> filter_re;   // [ir channel][partition][stride]
+        std::vector<float> filter_im;
+        std::vector<float> delay_re;    // [channel][slot][stride]
+        std::vector<float> delay_im;
+        std::vector<float> input;       // [channel][2P], previous block then current
+    };
+
+    void run_block();
+    void run_segment(Segment& segment);
+
+    uint16_t channels_;
+    uint16_t ir_channels_;
+    size_t block_size_;
+    size_t fill_;                       // Frames collected into input_block_
+
+    std::vector<Segment> segments_;
+    std::vector<float> input_block_;    // [channel][block], planar
+    std::vector<float> output_block_;   // [channel][block], planar
+
+    // Segment outputs land here, up to offset + block_size ahead of the
+    // block being emitted
+    std::vector<float> output_ring_;    // [channel][ring_size_]
+    size_t ring_size_;
+    size_t ring_position_;
+
+    std::vector<std::complex<float>> spectrum_;
+    std::vector<float> accumulate_re_;
+    std::vector<float> accumulate_im_;
+    std::vector<float> time_;
+};
+
+}} // namespace mp::core
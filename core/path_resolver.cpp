@@ -0,0 +1,301 @@
+﻿#include "path_resolver.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <system_error>
+#include <thread>
+
+namespace mp {
+namespace core {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool has_prefix_nocase(const std::string& s, const char* prefix) {
+    for (size_t i = 0; prefix[i]; ++i) {
+        if (i >= s.size() || std::tolower(static_cast<unsigned char>(s[i])) != prefix[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string fold(const std::string& name) {
+    std::string out(name);
+    for (char& c : out) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return out;
+}
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+std::string percent_decode(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        int hi, lo;
+        if (s[i] == '%' && i + 2 < s.size() &&
+            (hi = hex_value(s[i + 1])) >= 0 && (lo = hex_value(s[i + 2])) >= 0) {
+            out += static_cast<char>(hi * 16 + lo);
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+#ifdef _WIN32
+const char* const SEPARATORS = "/\\";
+#else
+const char* const SEPARATORS = "/";
+#endif
+
+bool is_drive(const std::string& p, size_t at) {
+    return p.size() >= at + 2 && std::isalpha(static_cast<unsigned char>(p[at])) && p[at + 1] == ':';
+}
+
+} // namespace
+
+bool is_url(const std::string& location) {
+    size_t colon = location.find("://");
+    if (colon == std::string::npos || colon < 2 ||
+        !std::isalpha(static_cast<unsigned char>(location[0]))) {
+        return false;
+    }
+    for (size_t i = 1; i < colon; ++i) {
+        unsigned char c = static_cast<unsigned char>(location[i]);
+        if (!std::isalnum(c) && c != '+' && c != '-' && c != '.') {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string file_uri_to_path(const std::string& uri) {
+    if (!has_prefix_nocase(uri, "file://")) {
+        return percent_decode(uri);
+    }
+    std::string rest = uri.substr(7);
+    if (has_prefix_nocase(rest, "localhost/")) {
+        rest.erase(0, 9);
+    }
+    // Any other host is a share: file://server/music -> //server/music
+    std::string path = percent_decode(!rest.empty() && rest[0] != '/' ? "//" + rest : rest);
+    if (path.size() >= 3 && path[0] == '/' && is_drive(path, 1)) {
+        path.erase(0, 1);
+    }
+    return path;
+}
+
+std::string path_to_uri(const std::string& path) {
+    static const char hex[] = "0123456789ABCDEF";
+    std::string p(path);
+    std::replace(p.begin(), p.end(), '\\', '/');
+    bool drive = is_drive(p, 0);
+    bool absolute = drive || (!p.empty() && p[0] == '/');
+
+    std::string out = absolute ? (drive ? "file:///" : "file://") : "";
+    for (size_t i = 0; i < p.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(p[i]);
+        if (std::isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~' || c == '/' ||
+            (drive && i == 1)) {
+            out += static_cast<char>(c);
+        } else {
+            out += '%';
+            out += hex[c >> 4];
+            out += hex[c & 15];
+        }
+    }
+    return out;
+}
+
+PathResolver::PathResolver(size_t threads)
+    : threads_(threads)
+    , listed_(0)
+    , checked_(0) {
+    if (threads_ == 0) {
+        threads_ = std::max<size_t>(4, 2 * std::max(1u, std::thread::hardware_concurrency()));
+    }
+}
+
+void PathResolver::clear_cache() {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    cache_.clear();
+}
+
+std::shared_ptr<const PathResolver::Listing> PathResolver::cached(const std::string& dir) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto it = cache_.find(dir);
+    return it == cache_.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<const PathResolver::Listing> PathResolver::listing(const std::string& dir) {
+    auto list = std::make_shared<Listing>();
+    std::error_code ec;
+    fs::directory_iterator it(fs::u8path(dir), ec);
+    list->exists = !ec;
+    for (fs::directory_iterator end; !ec && it != end; it.increment(ec)) {
+        std::string name = it->path().filename().u8string();
+        list->folded.emplace(fold(name), name);
+        list->names.insert(std::move(name));
+    }
+    listed_.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    return cache_.emplace(dir, std::move(list)).first->second;
+}
+
+std::vector<ResolvedPath> PathResolver::resolve(const std::vector<std::string>& locations,
+                                                const std::string& base_dir) {
+    std::vector<ResolvedPath> out(locations.size());
+    std::error_code ec;
+    fs::path base = base_dir.empty() ? fs::current_path(ec) : fs::u8path(base_dir);
+    if (base.is_relative()) {
+        base = fs::absolute(base, ec);
+    }
+
+    // Normalize, and group the entries by directory. Entries of a playlist
+    // mostly share a handful of directory spellings, so each spelling is
+    // normalized once and the file name appended to it.
+    struct Group {
+        std::string dir;
+        std::vector<size_t> entries;
+    };
+    std::vector<Group> groups;
+    std::unordered_map<std::string, size_t> group_of;        // Normalized directory
+    std::unordered_map<std::string, size_t> spelling_of;     // Directory as written
+    std::vector<std::string> names(locations.size());
+
+    auto group_for = [&](const fs::path& dir) {
+        std::string key = dir.u8string();
+        auto found = group_of.find(key);
+        if (found == group_of.end()) {
+            found = group_of.emplace(key, groups.size()).first;
+            groups.push_back(Group{std::move(key), {}});
+        }
+        return found->second;
+    };
+
+    for (size_t i = 0; i < locations.size(); ++i) {
+        const std::string& location = locations[i];
+        if (location.empty()) {
+            continue;
+        }
+        bool file_uri = has_prefix_nocase(location, "file://");
+        if (!file_uri && is_url(location)) {
+            out[i].path = location;
+            out[i].exists = true;
+            out[i].is_url = true;
+            continue;
+        }
+
+        std::string text = file_uri ? file_uri_to_path(location) : location;
+#ifndef _WIN32
+        std::replace(text.begin(), text.end(), '\\', '/');
+#endif
+        size_t slash = text.find_last_of(SEPARATORS);
+        std::string name = slash == std::string::npos ? text : text.substr(slash + 1);
+        size_t group;
+        if (name.empty() || name == "." || name == "..") {
+            // Names a directory, or needs the whole path normalized
+            fs::path path = fs::u8path(text);
+            if (path.is_relative()) {
+                path = base / path;
+            }
+            path = path.lexically_normal();
+            out[i].path = path.u8string();
+            names[i] = path.filename().u8string();
+            if (names[i].empty()) {
+                continue;       // A directory, not a file
+            }
+            group = group_for(path.parent_path());
+        } else {
+            std::string spelling = slash == std::string::npos ? std::string() : text.substr(0, slash + 1);
+            auto known = spelling_of.find(spelling);
+            if (known == spelling_of.end()) {
+                fs::path dir = fs::u8path(spelling);
+                if (dir.is_relative()) {
+                    dir = base / dir;
+                }
+                dir = dir.lexically_normal();
+                if (!dir.has_filename() && dir.has_relative_path()) {
+                    dir = dir.parent_path();        // Trailing separator
+                }
+                known = spelling_of.emplace(std::move(spelling), group_for(dir)).first;
+            }
+            group = known->second;
+            const std::string& dir = groups[group].dir;
+            out[i].path.reserve(dir.size() + 1 + name.size());
+            out[i].path = dir;
+            if (dir.empty() || dir.back() != fs::path::preferred_separator) {
+                out[i].path += fs::path::preferred_separator;
+            }
+            out[i].path += name;
+            names[i] = std::move(name);
+        }
+        groups[group].entries.push_back(i);
+    }
+
+    auto check = [&](const Group& group) {
+        std::shared_ptr<const Listing> list = cached(group.dir);
+        if (!list && group.entries.size() < LIST_THRESHOLD) {
+            bool all_found = true;
+            for (size_t i : group.entries) {
+                std::error_code stat_error;
+                checked_.fetch_add(1, std::memory_order_relaxed);
+                out[i].exists = fs::exists(fs::u8path(out[i].path), stat_error);
+                all_found = all_found && out[i].exists;
+            }
+            if (all_found) {
+                return;
+            }
+        }
+        if (!list) {
+            list = listing(group.dir);
+        }
+        for (size_t i : group.entries) {
+            if (list->names.count(names[i])) {
+                out[i].exists = true;
+                continue;
+            }
+            auto other_case = list->folded.find(fold(names[i]));
+            if (other_case != list->folded.end()) {
+                out[i].path = (fs::u8path(group.dir) / fs::u8path(other_case->second)).u8string();
+                out[i].exists = true;
+            }
+        }
+    };
+
+    size_t workers = std::min(threads_, groups.size());
+    if (workers <= 1) {
+        for (const Group& group : groups) {
+            check(group);
+        }
+        return out;
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> pool;
+    pool.reserve(workers);
+    for (size_t t = 0; t < workers; ++t) {
+        pool.emplace_back([&] {
+            for (size_t g = next.fetch_add(1); g < groups.size(); g = next.fetch_add(1)) {
+                check(groups[g]);
+            }
+        });
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    return out;
+}
+
+}} // namespace mp::core
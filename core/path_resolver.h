@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+struct ResolvedPath {
+    std::string path;       // Absolute and normalized, or the URL as given
+    bool exists;            // URLs count as existing
+    bool is_url;
+
+    ResolvedPath() : exists(false), is_url(false) {}
+};
+
+// "file:///music/a%20b.flac" -> "/music/a b.flac" ("file:///C:/x" -> "C:/x")
+std::string file_uri_to_path(const std::string& uri);
+
+// Absolute paths become file:// URIs, relative ones percent-encoded
+// references; both with '/' separators
+std::string path_to_uri(const std::string& path);
+
+// True for "scheme://..." other than a Windows drive letter
+bool is_url(const std::string& location);
+
+// Turns playlist locations into absolute, normalized paths and checks that
+// they exist.
+//
+// Locations may be absolute, relative to the playlist's directory, file://
+// URIs, or URLs, which pass through untouched. Outside Windows a backslash
+// is read as a separator, for playlists written there.
+//
+// Existence checks go through a cache of directory listings. Entries are
+// grouped by directory, and a directory holding several of them is listed
+// once instead of stat'ing each file; a DJ playlist of tens of thousands
+// of entries usually spans a few hundred directories, so on a network
+// mount that saves most of the round trips. A file absent from the
+// listing but present in another letter case (a playlist made on a
+// case-insensitive system) resolves to the name on disk. Directories are
+// spread over a pool of threads, since on slow mounts the time goes into
+// waiting for the server.
+class PathResolver {
+public:
+    // threads 0: twice the cores, at least 4
+    explicit PathResolver(size_t threads = 0);
+
+    // One result per location, in order
+    std::vector<ResolvedPath> resolve(const std::vector<std::string>& locations, const std::string& base_dir);
+
+    // Listings are reused by later resolve() calls until this
+    void clear_cache();
+
+    // Since construction
+    uint64_t directories_listed() const { return listed_.load(std::memory_order_relaxed); }
+    uint64_t files_checked() const { return checked_.load(std::memory_order_relaxed); }
+
+private:
+    struct Listing {
+        bool exists = false;
+        std::unordered_set<std::string> names;
+        std::unordered_map<std::string, std::string> folded;   // Lower case -> name
+    };
+
+    // Directories with fewer wanted entries than this are stat'ed file by
+    // file until one is missing
+    static constexpr size_t LIST_THRESHOLD = 4;
+
+    std::shared_ptr<const Listing> listing(const std::string& dir);
+    std::shared_ptr<const Listing> cached(const std::string& dir);
+
+    size_t threads_;
+    std::mutex cache_mutex_;
+    std::unordered_map<std::string, std::shared_ptr<const Listing>> cache_;
+    std::atomic<uint64_t> listed_;
+    std::atomic<uint64_t> checked_;
+};
+
+}} // namespace mp::core
@@ -0,0 +1,505 @@
+﻿#include "pcm_file_reader.h"
+#include "src/audio/optimized_audio_processor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mp {
+namespace core {
+
+namespace {
+
+uint16_t le16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+uint32_t le32(const uint8_t* p) { return static_cast<uint32_t>(le16(p)) | static_cast<uint32_t>(le16(p + 2)) << 16; }
+uint64_t le64(const uint8_t* p) { return static_cast<uint64_t>(le32(p)) | static_cast<uint64_t>(le32(p + 4)) << 32; }
+uint16_t be16(const uint8_t* p) { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+uint32_t be32(const uint8_t* p) { return static_cast<uint32_t>(be16(p)) << 16 | be16(p + 2); }
+uint64_t be64(const uint8_t* p) { return static_cast<uint64_t>(be32(p)) << 32 | be32(p + 4); }
+
+bool is_id(const uint8_t* p, const char* id) {
+    return std::memcmp(p, id, 4) == 0;
+}
+
+// 80-bit IEEE extended, as AIFF stores its sample rate
+double read_extended(const uint8_t* p) {
+    const uint16_t sign_exponent = be16(p);
+    const uint64_t mantissa = be64(p + 2);
+    const int exponent = (sign_exponent & 0x7FFF) - 16383 - 63;
+    double value = std::ldexp(static_cast<double>(mantissa), exponent);
+    return (sign_exponent & 0x8000) ? -value : value;
+}
+
+uint64_t page_size() {
+#ifdef _WIN32
+    return 4096;
+#else
+    static const uint64_t size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    return size;
+#endif
+}
+
+// Reverse the bytes of each width-byte sample
+void swap_samples(const uint8_t* src, uint8_t* dst, size_t samples, size_t width) {
+    for (size_t i = 0; i < samples; ++i) {
+        for (size_t b = 0; b < width; ++b) {
+            dst[i * width + b] = src[i * width + width - 1 - b];
+        }
+    }
+}
+
+} // namespace
+
+// MappedFile
+
+MappedFile::MappedFile()
+    : data_(nullptr), size_(0)
+#ifdef _WIN32
+    , file_(nullptr), mapping_(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    file_ = file;
+    mapping_ = mapping;
+    data_ = static_cast<const uint8_t*>(view);
+    size_ = static_cast<uint64_t>(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);    // The mapping keeps the file referenced
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    data_ = static_cast<const uint8_t*>(view);
+    size_ = static_cast<uint64_t>(info.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+    if (!data_) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+    file_ = nullptr;
+    mapping_ = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(data_), static_cast<size_t>(size_));
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
+
+void MappedFile::advise_sequential() {
+#ifndef _WIN32
+    if (!data_) {
+        return;
+    }
+    void* address = const_cast<uint8_t*>(data_);
+    madvise(address, static_cast<size_t>(size_), MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    // Lets file THP back the page cache where the kernel supports it
+    madvise(address, static_cast<size_t>(size_), MADV_HUGEPAGE);
+#endif
+#endif
+}
+
+void MappedFile::prefetch(uint64_t offset, uint64_t length) {
+#ifndef _WIN32
+    if (!data_ || offset >= size_) {
+        return;
+    }
+    const uint64_t start = offset & ~(page_size() - 1);
+    const uint64_t end = std::min(offset + length, size_);
+    madvise(const_cast<uint8_t*>(data_) + start, static_cast<size_t>(end - start), MADV_WILLNEED);
+#else
+    (void)offset;
+    (void)length;
+#endif
+}
+
+void MappedFile::release(uint64_t offset, uint64_t length) {
+#ifndef _WIN32
+    if (!data_ || offset >= size_) {
+        return;
+    }
+    // Only whole pages inside the range
+    const uint64_t page = page_size();
+    const uint64_t start = (offset + page - 1) & ~(page - 1);
+    const uint64_t end = std::min(offset + length, size_) & ~(page - 1);
+    if (end > start) {
+        // Read-only file pages: dropping them only costs a refault from the page cache
+        madvise(const_cast<uint8_t*>(data_) + start, static_cast<size_t>(end - start), MADV_DONTNEED);
+    }
+#else
+    (void)offset;
+    (void)length;
+#endif
+}
+
+// PcmFileReader
+
+PcmFileReader::PcmFileReader() {
+    close();
+}
+
+void PcmFileReader::close() {
+    file_.close();
+    container_ = PcmContainer::Raw;
+    sample_rate_ = 0;
+    channels_ = 0;
+    bits_ = 0;
+    is_float_ = false;
+    big_endian_ = false;
+    frame_bytes_ = 0;
+    data_offset_ = 0;
+    total_frames_ = 0;
+    position_ = 0;
+    prefetched_until_ = 0;
+    released_until_ = 0;
+}
+
+bool PcmFileReader::fail(const std::string& message) {
+    last_error_ = message;
+    close();
+    return false;
+}
+
+bool PcmFileReader::open(const std::string& path) {
+    close();
+    if (!file_.open(path)) {
+        return fail("Cannot map file: " + path);
+    }
+    if (file_.size() < 12) {
+        return fail("File too short for a PCM header");
+    }
+
+    const uint8_t* d = file_.data();
+    if ((is_id(d, "RIFF") || is_id(d, "RF64") || is_id(d, "BW64")) && is_id(d + 8, "WAVE")) {
+        return parse_wav();
+    }
+    if (is_id(d, "FORM") && (is_id(d + 8, "AIFF") || is_id(d + 8, "AIFC"))) {
+        return parse_aiff();
+    }
+    return fail("Not a WAV, RF64 or AIFF file");
+}
+
+bool PcmFileReader::open_raw(const std::string& path, uint32_t sample_rate, uint16_t channels,
+                             uint16_t bits_per_sample, bool is_float, bool big_endian,
+                             uint64_t data_offset) {
+    close();
+    if (!file_.open(path)) {
+        return fail("Cannot map file: " + path);
+    }
+    container_ = PcmContainer::Raw;
+    sample_rate_ = sample_rate;
+    channels_ = channels;
+    bits_ = bits_per_sample;
+    is_float_ = is_float;
+    big_endian_ = big_endian;
+    return finish_open(data_offset, file_.size() - std::min(data_offset, file_.size()));
+}
+
+bool PcmFileReader::parse_wav() {
+    const uint8_t* d = file_.data();
+    const uint64_t size = file_.size();
+    const bool rf64 = !is_id(d, "RIFF");
+    container_ = rf64 ? PcmContainer::Rf64 : PcmContainer::Wav;
+
+    bool have_format = false;
+    uint64_t ds64_data_size = 0;
+    uint64_t pos = 12;
+    while (pos + 8 <= size) {
+        const uint8_t* id = d + pos;
+        const uint64_t chunk = le32(d + pos + 4);
+        const uint64_t body = pos + 8;
+
+        if (is_id(id, "ds64") && chunk >= 24 && body + 24 <= size) {
+            // riffSize, dataSize, sampleCount: the 64-bit sizes RF64 leaves as 0xFFFFFFFF
+            ds64_data_size = le64(d + body + 8);
+        } else if (is_id(id, "fmt ") && chunk >= 16 && body + 16 <= size) {
+            uint16_t tag = le16(d + body);
+            channels_ = le16(d + body + 2);
+            sample_rate_ = le32(d + body + 4);
+            const uint16_t block_align = le16(d + body + 12);
+            bits_ = le16(d + body + 14);
+            if (tag == 0xFFFE && chunk >= 40 && body + 40 <= size) {
+                tag = le16(d + body + 24);      // First two bytes of the SubFormat GUID
+            }
+            if (tag != 1 && tag != 3) {
+                return fail("Unsupported WAV encoding (only PCM and IEEE float)");
+            }
+            is_float_ = tag == 3;
+            if (block_align != channels_ * ((bits_ + 7) / 8)) {
+                return fail("Unsupported WAV block alignment");
+            }
+            have_format = true;
+        } else if (is_id(id, "data")) {
+            if (!have_format) {
+                return fail("WAV data chunk before fmt chunk");
+            }
+            uint64_t data_size = chunk;
+            if (rf64 && chunk == 0xFFFFFFFF) {
+                data_size = ds64_data_size;
+            } else if (chunk == 0 || chunk == 0xFFFFFFFF) {
+                // Unfinished recording: the samples run to the end of the file
+                data_size = size - body;
+            }
+            return finish_open(body, data_size);
+        }
+
+        pos = body + chunk + (chunk & 1);
+    }
+    return fail("WAV data chunk not found");
+}
+
+bool PcmFileReader::parse_aiff() {
+    const uint8_t* d = file_.data();
+    const uint64_t size = file_.size();
+    const bool aifc = is_id(d + 8, "AIFC");
+    container_ = PcmContainer::Aiff;
+    big_endian_ = true;
+
+    bool have_format = false;
+    uint64_t frames = 0;
+    uint64_t data_offset = 0;
+    uint64_t data_size = 0;
+    uint64_t pos = 12;
+    while (pos + 8 <= size) {
+        const uint8_t* id = d + pos;
+        const uint64_t chunk = be32(d + pos + 4);
+        const uint64_t body = pos + 8;
+
+        if (is_id(id, "COMM") && chunk >= 18 && body + 18 <= size) {
+            channels_ = be16(d + body);
+            frames = be32(d + body + 2);
+            bits_ = be16(d + body + 6);
+            sample_rate_ = static_cast<uint32_t>(std::lround(read_extended(d + body + 8)));
+            if (aifc && chunk >= 22 && body + 22 <= size) {
+                const uint8_t* compression = d + body + 18;
+                if (is_id(compression, "sowt")) {
+                    big_endian_ = false;
+                } else if (is_id(compression, "fl32") || is_id(compression, "FL32") ||
+                           is_id(compression, "fl64") || is_id(compression, "FL64")) {
+                    is_float_ = true;
+                } else if (!is_id(compression, "NONE") && !is_id(compression, "twos")) {
+                    return fail("Compressed AIFF-C is not supported");
+                }
+            }
+            have_format = true;
+        } else if (is_id(id, "SSND") && chunk >= 8 && body + 8 <= size) {
+            const uint64_t offset = be32(d + body);
+            data_offset = body + 8 + offset;
+            data_size = chunk >= 8 + offset ? chunk - 8 - offset : 0;
+        }
+
+        pos = body + chunk + (chunk & 1);
+    }
+
+    if (!have_format || data_offset == 0) {
+        return fail("AIFF COMM or SSND chunk not found");
+    }
+    size_t frame_bytes = static_cast<size_t>(channels_) * ((bits_ + 7) / 8);
+    return finish_open(data_offset, std::min(data_size, frames * frame_bytes));
+}
+
+bool PcmFileReader::finish_open(uint64_t data_offset, uint64_t data_size) {
+    const bool valid_bits = is_float_ ? (bits_ == 32 || bits_ == 64)
+                                      : (bits_ == 8 || bits_ == 16 || bits_ == 24 || bits_ == 32);
+    if (channels_ == 0 || sample_rate_ == 0 || !valid_bits) {
+        return fail("Unsupported PCM format");
+    }
+    if (data_offset >= file_.size()) {
+        return fail("PCM data starts past the end of the file");
+    }
+
+    frame_bytes_ = static_cast<size_t>(channels_) * (bits_ / 8);
+    data_offset_ = data_offset;
+    total_frames_ = std::min(data_size, file_.size() - data_offset) / frame_bytes_;
+    position_ = 0;
+
+    file_.advise_sequential();
+    prefetched_until_ = released_until_ = data_offset_ & ~(READAHEAD_BYTES - 1);
+    advise(data_offset_, 0);
+    last_error_.clear();
+    return true;
+}
+
+SampleFormat PcmFileReader::sample_format() const {
+    if (is_float_) {
+        return bits_ == 64 ? SampleFormat::Float64 : SampleFormat::Float32;
+    }
+    switch (bits_) {
+        case 16: return SampleFormat::Int16;
+        case 24: return SampleFormat::Int24;
+        case 32: return SampleFormat::Int32;
+        default: return SampleFormat::Unknown;
+    }
+}
+
+void PcmFileReader::advise(uint64_t offset, uint64_t length) {
+    const uint64_t end = offset + length;
+
+    // Keep a full window prefetched past the bytes being read, growing it in
+    // whole aligned windows
+    if (end + READAHEAD_BYTES > prefetched_until_) {
+        uint64_t target = (end + 2 * READAHEAD_BYTES - 1) & ~(READAHEAD_BYTES - 1);
+        file_.prefetch(prefetched_until_, target - prefetched_until_);
+        prefetched_until_ = target;
+    }
+
+    // Release everything more than one window behind
+    const uint64_t window = offset & ~(READAHEAD_BYTES - 1);
+    if (window > released_until_ + READAHEAD_BYTES) {
+        uint64_t until = window - READAHEAD_BYTES;
+        file_.release(released_until_, until - released_until_);
+        released_until_ = until;
+    }
+}
+
+void PcmFileReader::seek(uint64_t frame) {
+    position_ = std::min(frame, total_frames_);
+
+    // Restart the readahead window at the new position
+    const uint64_t offset = data_offset_ + position_ * frame_bytes_;
+    prefetched_until_ = released_until_ = offset & ~(READAHEAD_BYTES - 1);
+    advise(offset, 0);
+}
+
+const uint8_t* PcmFileReader::view(size_t max_frames, size_t& frames) {
+    frames = static_cast<size_t>(std::min<uint64_t>(max_frames, remaining_frames()));
+    if (!is_open()) {
+        frames = 0;
+        return nullptr;
+    }
+    const uint64_t offset = data_offset_ + position_ * frame_bytes_;
+    advise(offset, frames * frame_bytes_);
+    return file_.data() + offset;
+}
+
+void PcmFileReader::skip(size_t frames) {
+    position_ = std::min(position_ + frames, total_frames_);
+}
+
+size_t PcmFileReader::read_raw(void* destination, size_t frames) {
+    size_t count = 0;
+    const uint8_t* src = view(frames, count);
+    if (!src || count == 0) {
+        return 0;
+    }
+
+    const size_t width = bits_ / 8;
+    if (big_endian_ && width > 1) {
+        swap_samples(src, static_cast<uint8_t*>(destination), count * channels_, width);
+    } else {
+        std::memcpy(destination, src, count * frame_bytes_);
+    }
+    skip(count);
+    return count;
+}
+
+size_t PcmFileReader::read(float* destination, size_t frames) {
+    size_t count = 0;
+    const uint8_t* src = view(frames, count);
+    if (!src || count == 0) {
+        return 0;
+    }
+
+    const size_t samples = count * channels_;
+    float* dst = destination;
+    if (is_float_ && bits_ == 32) {
+        if (big_endian_) {
+            swap_samples(src, reinterpret_cast<uint8_t*>(dst), samples, 4);
+        } else {
+            std::memcpy(dst, src, samples * sizeof(float));
+        }
+    } else if (is_float_) {
+        for (size_t i = 0; i < samples; ++i) {
+            uint64_t bits = big_endian_ ? be64(src + i * 8) : le64(src + i * 8);
+            double v;
+            std::memcpy(&v, &bits, sizeof(v));
+            dst[i] = static_cast<float>(v);
+        }
+    } else if (bits_ == 8) {
+        // WAV and raw store 8-bit unsigned, AIFF signed
+        const bool offset_binary = container_ != PcmContainer::Aiff;
+        for (size_t i = 0; i < samples; ++i) {
+            int v = offset_binary ? static_cast<int>(src[i]) - 128 : static_cast<int8_t>(src[i]);
+            dst[i] = static_cast<float>(v) * (1.0f / 128.0f);
+        }
+    } else if (!big_endian_ && bits_ == 16) {
+        audio::SIMDOperations::convert_int16_to_float_avx(
+            reinterpret_cast<const int16_t*>(src), dst, samples);
+    } else if (!big_endian_ && bits_ == 24) {
+        audio::SIMDOperations::convert_int24_to_float_avx(src, dst, samples);
+    } else {
+        // Big-endian integers and int32: place the sample in the top bits
+        const size_t width = bits_ / 8;
+        for (size_t i = 0; i < samples; ++i) {
+            const uint8_t* p = src + i * width;
+            uint32_t v = 0;
+            for (size_t b = 0; b < width; ++b) {
+                uint32_t byte = big_endian_ ? p[b] : p[width - 1 - b];
+                v |= byte << (24 - 8 * b);
+            }
+            dst[i] = static_cast<float>(static_cast<int32_t>(v)) * (1.0f / 2147483648.0f);
+        }
+    }
+
+    skip(count);
+    return count;
+}
+
+}} // namespace mp::core
@@ -0,0 +1,139 @@
+﻿#pragma once
+
+#include "mp_types.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace mp {
+namespace core {
+
+// Read-only memory map of a whole file. Access hints are advisory and
+// no-ops where the platform has none.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool is_open() const { return data_ != nullptr; }
+    const uint8_t* data() const { return data_; }
+    uint64_t size() const { return size_; }
+
+    // The whole mapping will be read front to back
+    void advise_sequential();
+
+    // Start reading a range in, or let the kernel drop its pages. Ranges
+    // are widened to whole pages.
+    void prefetch(uint64_t offset, uint64_t length);
+    void release(uint64_t offset, uint64_t length);
+
+private:
+    const uint8_t* data_;
+    uint64_t size_;
+#ifdef _WIN32
+    void* file_;
+    void* mapping_;
+#endif
+};
+
+// Container a PcmFileReader found
+enum class PcmContainer {
+    Raw,
+    Wav,            // RIFF/WAVE
+    Rf64,           // RF64 or BW64, sizes in the ds64 chunk
+    Aiff            // AIFF, or AIFF-C with uncompressed samples
+};
+
+// Uncompressed PCM straight from a memory-mapped file: WAV (including
+// WAVE_FORMAT_EXTENSIBLE and IEEE float), RF64/BW64 beyond 4 GB, AIFF/AIFF-C
+// and headerless raw. Nothing is read through a stream and nothing is
+// allocated per block: view() hands out the mapped samples, read_raw()
+// copies them in native byte order, and read() converts them to float
+// directly from the mapped pages (int16 and int24 with AVX2 where present).
+// Seeking is O(1), a position change and a prefetch.
+//
+// Reads stay sequential-friendly for very large files: the map is advised
+// sequential, a window of READAHEAD_BYTES ahead of the position is
+// prefetched in hugepage-sized, hugepage-aligned steps, and windows well
+// behind it are released so resident memory stays bounded.
+class PcmFileReader {
+public:
+    static constexpr uint64_t READAHEAD_BYTES = 2 * 1024 * 1024;
+
+    PcmFileReader();
+
+    // Detect and parse the container; false (see last_error) if the file
+    // is not uncompressed PCM in one of the supported containers
+    bool open(const std::string& path);
+
+    // Headerless samples from data_offset to the end of the file
+    bool open_raw(const std::string& path, uint32_t sample_rate, uint16_t channels,
+                  uint16_t bits_per_sample, bool is_float, bool big_endian,
+                  uint64_t data_offset = 0);
+
+    void close();
+
+    bool is_open() const { return file_.is_open() && frame_bytes_ > 0; }
+    const std::string& last_error() const { return last_error_; }
+
+    PcmContainer container() const { return container_; }
+    uint32_t sample_rate() const { return sample_rate_; }
+    uint16_t channels() const { return channels_; }
+    uint16_t bits_per_sample() const { return bits_; }
+    bool is_float() const { return is_float_; }
+    bool big_endian() const { return big_endian_; }
+    size_t frame_bytes() const { return frame_bytes_; }
+
+    // Format read_raw() produces; Unknown for 8-bit, which read() still handles
+    SampleFormat sample_format() const;
+
+    uint64_t total_frames() const { return total_frames_; }
+    uint64_t position() const { return position_; }
+    uint64_t remaining_frames() const { return total_frames_ - position_; }
+
+    // Clamped to the end of the data
+    void seek(uint64_t frame);
+
+    // Up to max_frames mapped frames at the position, in file byte order.
+    // Does not advance; follow with skip().
+    const uint8_t* view(size_t max_frames, size_t& frames);
+    void skip(size_t frames);
+
+    // Copy up to frames frames in native byte order and advance
+    size_t read_raw(void* destination, size_t frames);
+
+    // Convert up to frames frames to interleaved float in [-1, 1) and advance
+    size_t read(float* destination, size_t frames);
+
+private:
+    bool parse_wav();
+    bool parse_aiff();
+    bool finish_open(uint64_t data_offset, uint64_t data_size);
+    bool fail(const std::string& message);
+
+    // Prefetch ahead of, and release behind, the bytes about to be read
+    void advise(uint64_t offset, uint64_t length);
+
+    MappedFile file_;
+    std::string last_error_;
+    PcmContainer container_;
+    uint32_t sample_rate_;
+    uint16_t channels_;
+    uint16_t bits_;
+    bool is_float_;
+    bool big_endian_;
+    size_t frame_bytes_;
+    uint64_t data_offset_;
+    uint64_t total_frames_;
+    uint64_t position_;
+    uint64_t prefetched_until_;     // File offset the readahead window reaches
+    uint64_t released_until_;       // Pages before this offset were released
+};
+
+}} // namespace mp::core
@@ -0,0 +1,113 @@
+﻿#include "planar_pcm_sink.h"
+#include "src/audio/optimized_audio_processor.h"
+#include <algorithm>
+#include <cstring>
+
+namespace mp {
+namespace core {
+
+PlanarPcmSink::PlanarPcmSink()
+    : channels_(0)
+    , bits_(0)
+    , output_(Output::Float32)
+    , scale_(0.0f)
+    , destination_(nullptr)
+    , capacity_(0)
+    , written_(0)
+    , ring_frames_(0)
+    , head_(0)
+    , pending_(0) {
+}
+
+bool PlanarPcmSink::configure(uint16_t channels, uint32_t bits_per_sample,
+                              size_t max_block_frames, Output output) {
+    if (channels == 0 || bits_per_sample < 4 || bits_per_sample > 32 || max_block_frames == 0) {
+        return false;
+    }
+
+    channels_ = channels;
+    bits_ = bits_per_sample;
+    output_ = output;
+    scale_ = 1.0f / static_cast<float>(1ull << (bits_per_sample - 1));
+    offset_planes_.assign(channels, nullptr);
+    ring_frames_ = max_block_frames;
+    ring_.assign(ring_frames_ * channels, 0);
+    destination_ = nullptr;
+    capacity_ = 0;
+    written_ = 0;
+    clear();
+    return true;
+}
+
+void PlanarPcmSink::clear() {
+    head_ = 0;
+    pending_ = 0;
+}
+
+void PlanarPcmSink::convert(const int32_t* const* planes, size_t offset, size_t frames, void* out) {
+    for (uint16_t c = 0; c < channels_; ++c) {
+        offset_planes_[c] = planes[c] + offset;
+    }
+
+    if (output_ == Output::Float32) {
+        audio::SIMDOperations::interleave_int32_to_float_avx(
+            offset_planes_.data(), channels_, frames, scale_, static_cast<float*>(out));
+        return;
+    }
+
+    // Shift in unsigned so negative samples are well defined
+    const uint32_t shift = 32 - bits_;
+    uint32_t* dst = static_cast<uint32_t*>(out);
+    for (size_t i = 0; i < frames; ++i) {
+        for (uint16_t c = 0; c < channels_; ++c) {
+            dst[i * channels_ + c] = static_cast<uint32_t>(offset_planes_[c][i]) << shift;
+        }
+    }
+}
+
+void PlanarPcmSink::begin(void* destination, size_t capacity) {
+    destination_ = static_cast<uint8_t*>(destination);
+    capacity_ = destination ? capacity : 0;
+    written_ = 0;
+
+    // Pending frames first, in at most two runs around the ring
+    while (pending_ > 0 && written_ < capacity_) {
+        size_t run = std::min({pending_, ring_frames_ - head_, capacity_ - written_});
+        std::memcpy(destination_ + written_ * frame_bytes(),
+                    ring_.data() + head_ * channels_, run * frame_bytes());
+        written_ += run;
+        head_ = (head_ + run) % ring_frames_;
+        pending_ -= run;
+    }
+    if (pending_ == 0) {
+        head_ = 0;
+    }
+}
+
+size_t PlanarPcmSink::write(const int32_t* const* planes, size_t frames) {
+    if (channels_ == 0) {
+        return 0;
+    }
+
+    // Straight into the destination, unless older frames still wait
+    size_t direct = pending_ == 0 ? std::min(frames, capacity_ - written_) : 0;
+    if (direct > 0) {
+        convert(planes, 0, direct, destination_ + written_ * frame_bytes());
+        written_ += direct;
+    }
+
+    // The rest goes behind the pending frames
+    size_t offset = direct;
+    size_t spill = std::min(frames - direct, ring_frames_ - pending_);
+    while (spill > 0) {
+        size_t tail = (head_ + pending_) % ring_frames_;
+        size_t run = std::min(spill, ring_frames_ - tail);
+        convert(planes, offset, run, ring_.data() + tail * channels_);
+        pending_ += run;
+        offset += run;
+        spill -= run;
+    }
+    return offset;
+}
+
+}} // namespace mp::core
@@ -0,0 +1,75 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+// Takes the planar int32 blocks a lossless decoder produces (libFLAC's
+// write callback) and interleaves them straight into the consumer's
+// buffer, converting on the way: normalised float through SIMDOperations,
+// or int32 shifted up to full scale. A block that does not fit is
+// converted into a fixed ring sized for the largest block and handed out
+// first by the next begin(), so nothing is staged per block and nothing
+// is allocated after configure().
+//
+// Usage per decode call: begin() with the caller's buffer, feed blocks
+// with write() until full(), then written() frames are in the buffer.
+class PlanarPcmSink {
+public:
+    enum class Output {
+        Float32,        // [-1, 1)
+        Int32           // Left-justified: bit 31 is the sign
+    };
+
+    PlanarPcmSink();
+
+    // Sizes the ring for max_block_frames; bits_per_sample is the source
+    // resolution (4 to 32)
+    bool configure(uint16_t channels, uint32_t bits_per_sample, size_t max_block_frames,
+                   Output output);
+
+    uint16_t channels() const { return channels_; }
+    Output output() const { return output_; }
+    size_t frame_bytes() const { return channels_ * sizeof(float); }
+
+    // Start filling destination (capacity frames); ring frames go in first
+    void begin(void* destination, size_t capacity);
+
+    // One planar block. Whatever does not fit in the destination goes to
+    // the ring; returns the frames accepted, short only if the ring is full.
+    size_t write(const int32_t* const* planes, size_t frames);
+
+    size_t written() const { return written_; }
+    bool full() const { return written_ == capacity_; }
+
+    // Frames waiting in the ring
+    size_t pending() const { return pending_; }
+    size_t ring_frames() const { return ring_frames_; }
+
+    // Drop pending frames, e.g. after a seek
+    void clear();
+
+private:
+    // frames of planes (from offset) to interleaved samples at out
+    void convert(const int32_t* const* planes, size_t offset, size_t frames, void* out);
+
+    uint16_t channels_;
+    uint32_t bits_;
+    Output output_;
+    float scale_;
+    std::vector<const int32_t*> offset_planes_;
+
+    uint8_t* destination_;
+    size_t capacity_;
+    size_t written_;
+
+    std::vector<uint32_t> ring_;        // Converted samples, float or int32 bits
+    size_t ring_frames_;
+    size_t head_;                       // First pending frame
+    size_t pending_;
+};
+
+}} // namespace mp::core
@@ -1,12 +1,71 @@
 ﻿#include "playback_engine.h"
+#include "gapless_info.h"
+#include "src/audio/enhanced_sample_rate_converter.h"
 #include <iostream>
 #include <algorithm>
+#include <cctype>
 #include <cstring>
 #include <cmath>
+#include <thread>
+#include <chrono>
 
 namespace mp {
 namespace core {
 
+namespace {
+
+std::string lower_extension(const std::string& file_path) {
+    size_t dot = file_path.find_last_of('.');
+    if (dot == std::string::npos || file_path.find_first_of("/\\", dot) != std::string::npos) {
+        return std::string();
+    }
+    std::string ext = file_path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext;
+}
+
+// Decoder-timeline samples [first, end) that play: the range, inside the
+// encoder delay and padding. end is 0 when the length is unknown.
+void playable_window(const TrackInfo& track, uint64_t& first, uint64_t& end) {
+    first = track.encoder_delay + track.range.start;
+    end = track.total_samples > track.encoder_padding ? track.total_samples - track.encoder_padding : 0;
+    if (track.range.end > 0) {
+        uint64_t range_end = track.encoder_delay + track.range.end;
+        end = end > 0 ? std::min(end, range_end) : range_end;
+    }
+}
+
+uint64_t gcd(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+} // namespace
+
+// Out of line: the resampler type is only complete here
+DecoderInstance::DecoderInstance()
+    : decoder(nullptr)
+    , current_position(0)
+    , active(false)
+    , eos(false)
+    , reader_running(false)
+    , decoder_eos(false)
+    , decoder_position(0)
+    , underruns(0)
+    , underrun_frames(0)
+    , resampler_rate(0)
+    , resample(false) {
+    handle.internal = nullptr;
+    std::memset(&stream_info, 0, sizeof(stream_info));
+}
+
+DecoderInstance::~DecoderInstance() = default;
+
 PlaybackEngine::PlaybackEngine()
     : audio_output_(nullptr)
     , current_decoder_(0)
@@ -14,6 +73,12 @@ PlaybackEngine::PlaybackEngine()
     , state_(PlaybackState::Stopped)
     , volume_(1.0f)
     , gapless_enabled_(true)
+    , render_target_(nullptr)
+    , next_render_target_(nullptr)
+    , render_in_progress_(false)
+    , spliced_(false)
+    , next_requested_(false)
+    , supervisor_running_(false)
     , initialized_(false) {
 }
 
@@ -22,7 +87,7 @@ PlaybackEngine::~PlaybackEngine() {
 }
 
 Result PlaybackEngine::initialize(IAudioOutput* audio_output) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
     
     if (initialized_) {
         return Result::AlreadyInitialized;
@@ -35,46 +100,61 @@ Result PlaybackEngine::initialize(IAudioOutput* audio_output) {
     audio_output_ = audio_output;
     current_decoder_ = 0;
     next_decoder_ = -1;
+    next_requested_ = false;
+    
+    render_target_.store(nullptr);
+    next_render_target_.store(nullptr);
+    spliced_.store(false);
+    
+    supervisor_running_ = true;
+    supervisor_thread_ = std::thread(&PlaybackEngine::supervisor_loop, this);
+    
     initialized_ = true;
     
     return Result::Success;
 }
 
 void PlaybackEngine::shutdown() {
+    {
+        std::lock_guard<std::mutex> wait_lock(supervisor_mutex_);
+        supervisor_running_ = false;
+    }
+    supervisor_cv_.notify_all();
+    if (supervisor_thread_.joinable()) {
+        supervisor_thread_.join();
+    }
+    
     stop();
     
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
     
+    retire_render_targets();
     close_decoder(0);
     close_decoder(1);
+    next_decoder_ = -1;
     
     audio_output_ = nullptr;
     initialized_ = false;
 }
 
-Result PlaybackEngine::load_track(const std::string& file_path, IDecoder* decoder) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (!initialized_) {
-        return Result::NotInitialized;
-    }
-    
-    // Close current decoder
-    close_decoder(current_decoder_);
-    
-    // Open new track
-    DecoderInstance& inst = decoders_[current_decoder_];
+Result PlaybackEngine::open_decoder(DecoderInstance& inst, const std::string& file_path,
+                                    IDecoder* decoder, const TrackRange& range) {
+    // Must be called with mutex locked and the instance closed
     inst.decoder = decoder;
+    inst.track_info = TrackInfo();
     inst.track_info.file_path = file_path;
     
     Result result = decoder->open_stream(file_path.c_str(), &inst.handle);
     if (result != Result::Success) {
-        std::cerr << "Failed to open track: " << file_path << std::endl;
         return result;
     }
     
     // Get stream info
     result = decoder->get_stream_info(inst.handle, &inst.stream_info);
+    if (result == Result::Success &&
+        (inst.stream_info.channels == 0 || inst.stream_info.channels > MAX_DECODER_CHANNELS)) {
+        result = Result::NotSupported;
+    }
     if (result != Result::Success) {
         decoder->close_stream(inst.handle);
         inst.handle.internal = nullptr;
@@ -82,69 +162,209 @@ Result PlaybackEngine::load_track(const std::string& file_path, IDecoder* decode
     }
     
     inst.track_info.total_samples = inst.stream_info.total_samples;
+    
+    // A range in CD frames (or another unit) becomes samples now that the
+    // stream's rate is known
+    if (range.rate > 0 && inst.stream_info.sample_rate == 0) {
+        decoder->close_stream(inst.handle);
+        inst.handle.internal = nullptr;
+        return Result::NotSupported;
+    }
+    inst.track_info.range = range.in_samples(inst.stream_info.sample_rate);
+    
+    // Encoder delay/padding from the container. Decoders that already trim
+    // (minimp3's VBR tag handling) report a length short by at least the
+    // delay; trimming again would eat real audio, so trust them instead.
+    GaplessInfo gapless;
+    if (read_gapless_info(file_path, gapless) && gapless.found) {
+        uint64_t reported = inst.stream_info.total_samples;
+        bool decoder_trims = reported > 0 && gapless.encoder_delay > 0 &&
+                             reported + gapless.encoder_delay <= gapless.total_samples;
+        if (!decoder_trims) {
+            inst.track_info.encoder_delay = gapless.encoder_delay;
+            inst.track_info.encoder_padding = gapless.encoder_padding;
+            if (gapless.total_samples > 0) {
+                inst.track_info.total_samples = gapless.total_samples;
+            }
+        }
+    }
+    
     inst.current_position = 0;
+    inst.decoder_position = 0;
     inst.active = false;
     inst.eos = false;
     
-    // TODO: Parse encoder delay/padding from metadata
-    // For now, set to 0
-    inst.track_info.encoder_delay = 0;
-    inst.track_info.encoder_padding = 0;
+    // A sub-track starts decoding near its first sample rather than at the
+    // top of the file. Seek to a millisecond that is a whole number of
+    // samples, so decoder_position is exact and the reader trims the rest.
+    // A decoder that cannot seek is still at the top and decodes through;
+    // one that lands somewhere else is rewound to get there.
+    const uint64_t rate = inst.stream_info.sample_rate;
+    if (inst.track_info.range.start > 0 && rate > 0) {
+        uint64_t first, end;
+        playable_window(inst.track_info, first, end);
+        const uint64_t step_ms = 1000 / gcd(rate, 1000);
+        const uint64_t target_ms = ((first * 1000) / rate) / step_ms * step_ms;
+        uint64_t actual_ms = 0;
+        if (target_ms > 0 && decoder->seek(inst.handle, target_ms, &actual_ms) == Result::Success) {
+            if (actual_ms == target_ms) {
+                inst.decoder_position = (target_ms * rate) / 1000;
+            } else if (decoder->seek(inst.handle, 0, &actual_ms) != Result::Success || actual_ms != 0) {
+                decoder->close_stream(inst.handle);
+                inst.handle.internal = nullptr;
+                return Result::Error;
+            }
+        }
+    }
+    
+    configure_resampler(inst);
+    
+    return Result::Success;
+}
+
+void PlaybackEngine::configure_resampler(DecoderInstance& inst) {
+    // Must be called with mutex locked and the reader stopped
+    const int rate = static_cast<int>(inst.stream_info.sample_rate);
+    inst.resample = rate > 0 && rate != static_cast<int>(OUTPUT_SAMPLE_RATE);
+    if (!inst.resample) {
+        return;
+    }
+    
+    auto it = resampler_settings_.format_quality.find(lower_extension(inst.track_info.file_path));
+    const std::string& quality = it != resampler_settings_.format_quality.end()
+                                     ? it->second : resampler_settings_.quality;
+    
+    // Reuse the previous track's converter when nothing changed; a new
+    // rate only needs a re-initialize of the same quality
+    if (inst.resampler && inst.resampler_quality == quality) {
+        if (inst.resampler_rate == rate) {
+            inst.resampler->reset();
+            return;
+        }
+    } else {
+        inst.resampler = audio::EnhancedSampleRateConverterFactory::create_by_name(quality);
+        inst.resampler_quality = quality;
+        inst.resampler_rate = 0;
+    }
+    
+    if (!inst.resampler->initialize(rate, OUTPUT_SAMPLE_RATE, OUTPUT_CHANNELS)) {
+        std::cerr << "Failed to initialize resampler for " << rate << " Hz" << std::endl;
+        inst.resampler.reset();
+        inst.resample = false;
+        return;
+    }
+    inst.resampler_rate = rate;
+    
+    std::cout << "  Resampling " << rate << " -> " << OUTPUT_SAMPLE_RATE << " Hz ("
+              << inst.resampler->get_name() << ")" << std::endl;
+}
+
+size_t PlaybackEngine::max_output_frames(const DecoderInstance& inst, size_t input_frames) const {
+    if (!inst.resample) {
+        return input_frames;
+    }
+    // Interpolators emit at most one frame more than the exact ratio
+    const uint64_t rate = std::max<uint32_t>(inst.stream_info.sample_rate, 1);
+    return static_cast<size_t>((input_frames * uint64_t(OUTPUT_SAMPLE_RATE) + rate - 1) / rate) + 4;
+}
+
+bool PlaybackEngine::decodes_to_device_format(const DecoderInstance& inst) {
+    return inst.stream_info.format == SampleFormat::Float32 &&
+           inst.stream_info.channels == OUTPUT_CHANNELS;
+}
+
+Result PlaybackEngine::load_track(const std::string& file_path, IDecoder* decoder,
+                                  const TrackRange& range) {
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
+    
+    if (!initialized_) {
+        return Result::NotInitialized;
+    }
+    
+    // Take both decoders away from the audio thread before closing them;
+    // a prepared next track belonged to the old position in the queue
+    retire_render_targets();
+    close_decoder(current_decoder_);
+    if (next_decoder_ >= 0) {
+        close_decoder(next_decoder_);
+        next_decoder_ = -1;
+    }
+    next_requested_ = false;
+    
+    // Open new track
+    DecoderInstance& inst = decoders_[current_decoder_];
+    Result result = open_decoder(inst, file_path, decoder, range);
+    if (result != Result::Success) {
+        std::cerr << "Failed to open track: " << file_path << std::endl;
+        return result;
+    }
+    
+    // Start decoding ahead right away so play() finds a primed buffer
+    start_read_ahead(inst);
     
     std::cout << "Loaded track: " << file_path << std::endl;
     std::cout << "  Sample rate: " << inst.stream_info.sample_rate << " Hz" << std::endl;
     std::cout << "  Channels: " << inst.stream_info.channels << std::endl;
     std::cout << "  Duration: " << (inst.stream_info.duration_ms / 1000) << " seconds" << std::endl;
+    if (inst.track_info.encoder_delay || inst.track_info.encoder_padding) {
+        std::cout << "  Gapless: delay " << inst.track_info.encoder_delay
+                  << ", padding " << inst.track_info.encoder_padding << " samples" << std::endl;
+    }
+    const TrackRange& samples = inst.track_info.range;
+    if (samples.start || samples.end) {
+        std::cout << "  Range: samples " << samples.start << " to " << samples.end << std::endl;
+    }
     
     return Result::Success;
 }
 
-Result PlaybackEngine::prepare_next_track(const std::string& file_path, IDecoder* decoder) {
-    std::lock_guard<std::mutex> lock(mutex_);
+Result PlaybackEngine::prepare_next_track(const std::string& file_path, IDecoder* decoder,
+                                          const TrackRange& range) {
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
     
     if (!initialized_) {
         return Result::NotInitialized;
     }
     
+    // Withdraw only the splice candidate; the current track keeps playing.
+    // Once no render pass holds it, nothing can splice into it any more.
+    next_render_target_.store(nullptr);
+    while (render_in_progress_.load()) {
+        std::this_thread::yield();
+    }
+    complete_pending_transition();
+    
     // Determine next decoder index (alternate between 0 and 1)
     int next_idx = (current_decoder_ == 0) ? 1 : 0;
     
     // Close previous next decoder if any
     close_decoder(next_idx);
+    next_decoder_ = -1;
     
     // Open next track
     DecoderInstance& inst = decoders_[next_idx];
-    inst.decoder = decoder;
-    inst.track_info.file_path = file_path;
-    
-    Result result = decoder->open_stream(file_path.c_str(), &inst.handle);
+    Result result = open_decoder(inst, file_path, decoder, range);
     if (result != Result::Success) {
         std::cerr << "Failed to prepare next track: " << file_path << std::endl;
         return result;
     }
     
-    // Get stream info
-    result = decoder->get_stream_info(inst.handle, &inst.stream_info);
-    if (result != Result::Success) {
-        decoder->close_stream(inst.handle);
-        inst.handle.internal = nullptr;
-        return result;
-    }
-    
-    inst.track_info.total_samples = inst.stream_info.total_samples;
-    inst.current_position = 0;
-    inst.active = false;
-    inst.eos = false;
-    
+    // Decode ahead now so the splice finds a full buffer
+    start_read_ahead(inst);
+    inst.active = true;
     next_decoder_ = next_idx;
     
+    if (render_target_.load()) {
+        next_render_target_.store(&inst);
+    }
+    
     std::cout << "Prepared next track: " << file_path << std::endl;
     
     return Result::Success;
 }
 
 Result PlaybackEngine::play() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
 
     if (!initialized_) {
         return Result::NotInitialized;
@@ -154,20 +374,23 @@ Result PlaybackEngine::play() {
         return Result::Success;  // Already playing
     }
 
+    complete_pending_transition();
+
     // Check if we have a loaded track
     if (!decoders_[current_decoder_].handle.internal) {
         return Result::InvalidState;
     }
 
-    // Ensure decoder is marked as active
+    // Ensure decoder is marked as active and visible to the audio thread
     decoders_[current_decoder_].active = true;
     decoders_[current_decoder_].eos = false;
+    publish_render_targets();
 
     // Configure and start audio output with system-preferred format for compatibility
     if (state_ == PlaybackState::Stopped) {
         AudioOutputConfig config;
         config.device_id = nullptr;  // Use default device
-        config.sample_rate = 48000;  // Use system preferred rate per analyst report
+        config.sample_rate = OUTPUT_SAMPLE_RATE;  // Tracks are resampled to this rate
         config.channels = 2;         // Force stereo for compatibility
         config.format = SampleFormat::Float32;  // Use float for processing
         config.buffer_frames = 1024;  // Smaller buffer for lower latency
@@ -189,6 +412,7 @@ Result PlaybackEngine::play() {
     Result result = audio_output_->start();
     if (result != Result::Success) {
         state_ = PlaybackState::Stopped;
+        retire_render_targets();
         decoders_[current_decoder_].active = false;
         std::cerr << "Failed to start audio output: " << static_cast<int>(result) << std::endl;
         return result;
@@ -199,7 +423,7 @@ Result PlaybackEngine::play() {
 }
 
 Result PlaybackEngine::pause() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
     
     if (!initialized_) {
         return Result::NotInitialized;
@@ -217,7 +441,7 @@ Result PlaybackEngine::pause() {
 }
 
 Result PlaybackEngine::stop() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
     
     if (!initialized_) {
         return Result::NotInitialized;
@@ -230,6 +454,7 @@ Result PlaybackEngine::stop() {
     audio_output_->stop();
     audio_output_->close();
     
+    retire_render_targets();
     decoders_[current_decoder_].active = false;
     decoders_[current_decoder_].current_position = 0;
     
@@ -240,67 +465,115 @@ Result PlaybackEngine::stop() {
 }
 
 Result PlaybackEngine::seek(uint64_t position_ms) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
     
     if (!initialized_) {
         return Result::NotInitialized;
     }
     
+    // The decoder is not thread-safe: park the audio thread and the
+    // read-ahead thread while seeking, then refill from the new position
+    bool was_published = render_target_.load() != nullptr;
+    retire_render_targets();
+    
     DecoderInstance& inst = decoders_[current_decoder_];
     if (!inst.handle.internal) {
         return Result::InvalidState;
     }
     
+    stop_read_ahead(inst);
+    
+    // Positions are reported from the first sample that plays; the
+    // decoder's timeline still contains the encoder delay and, for a
+    // sub-track, everything before its range
+    const uint32_t rate = std::max<uint32_t>(inst.stream_info.sample_rate, 1);
+    uint64_t first, end;
+    playable_window(inst.track_info, first, end);
+    
     uint64_t actual_position = 0;
-    Result result = inst.decoder->seek(inst.handle, position_ms, &actual_position);
-    if (result != Result::Success) {
-        return result;
+    Result result = inst.decoder->seek(inst.handle, position_ms + (first * 1000) / rate,
+                                       &actual_position);
+    if (result == Result::Success) {
+        // Update position
+        inst.decoder_position = (actual_position * rate) / 1000;
+        uint64_t track_position = inst.decoder_position > first ? inst.decoder_position - first : 0;
+        inst.current_position = (track_position * OUTPUT_SAMPLE_RATE) / rate;
+        inst.eos = false;
     }
     
-    // Update position
-    inst.current_position = (actual_position * inst.stream_info.sample_rate) / 1000;
-    inst.eos = false;
+    start_read_ahead(inst);
     
-    return Result::Success;
+    if (was_published) {
+        publish_render_targets();
+    }
+    
+    return result;
 }
 
 uint64_t PlaybackEngine::get_position() const {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
     
-    const DecoderInstance& inst = decoders_[current_decoder_];
-    if (inst.stream_info.sample_rate == 0) {
+    // After a splice the audio thread is already on the next track
+    const DecoderInstance* inst = render_target_.load();
+    if (!inst) {
+        inst = &decoders_[current_decoder_];
+    }
+    if (inst->stream_info.sample_rate == 0) {
         return 0;
     }
     
-    return (inst.current_position * 1000) / inst.stream_info.sample_rate;
+    return (inst->current_position * 1000) / OUTPUT_SAMPLE_RATE;
 }
 
 uint64_t PlaybackEngine::get_duration() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return decoders_[current_decoder_].stream_info.duration_ms;
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
+    
+    const DecoderInstance* inst = render_target_.load();
+    if (!inst) {
+        inst = &decoders_[current_decoder_];
+    }
+    
+    // Playable length excludes encoder delay and padding, and for a
+    // sub-track everything outside its range
+    uint64_t first, end;
+    playable_window(inst->track_info, first, end);
+    if (inst->stream_info.sample_rate > 0 && end > first) {
+        return ((end - first) * 1000) / inst->stream_info.sample_rate;
+    }
+    return inst->stream_info.duration_ms;
 }
 
 Result PlaybackEngine::transition_to_next() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
+    
+    bool was_published = render_target_.load() != nullptr;
+    retire_render_targets();
     
     if (next_decoder_ < 0) {
+        if (was_published) {
+            publish_render_targets();
+        }
         return Result::InvalidState;  // No next track prepared
     }
     
     std::cout << "Transitioning to next track (gapless)" << std::endl;
     
-    // Close current decoder
-    close_decoder(current_decoder_);
-    
-    // Switch to next decoder
-    current_decoder_ = next_decoder_;
-    next_decoder_ = -1;
+    // Close current decoder and switch to next decoder
+    switch_decoder();
     
     decoders_[current_decoder_].active = true;
+    if (state_ != PlaybackState::Stopped) {
+        publish_render_targets();
+    }
     
     return Result::Success;
 }
 
+void PlaybackEngine::set_next_track_provider(NextTrackProvider provider) {
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
+    next_track_provider_ = std::move(provider);
+}
+
 void PlaybackEngine::set_volume(float volume) {
     volume_ = std::max(0.0f, std::min(1.0f, volume));
     if (audio_output_) {
@@ -308,112 +581,401 @@ void PlaybackEngine::set_volume(float volume) {
     }
 }
 
+void PlaybackEngine::set_read_ahead(const ReadAheadConfig& config) {
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
+    read_ahead_config_.buffer_frames = std::max<size_t>(config.buffer_frames, 256);
+    read_ahead_config_.buffer_count = std::max<size_t>(config.buffer_count, 2);
+}
+
+ReadAheadStats PlaybackEngine::get_read_ahead_stats() const {
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
+    
+    ReadAheadStats stats = {};
+    const DecoderInstance& inst = decoders_[current_decoder_];
+    if (inst.ring) {
+        stats.capacity_frames = inst.ring->capacity() / OUTPUT_CHANNELS;
+        stats.fill_frames = inst.ring->read_available() / OUTPUT_CHANNELS;
+    }
+    stats.underruns = inst.underruns.load(std::memory_order_relaxed);
+    stats.underrun_frames = inst.underrun_frames.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void PlaybackEngine::set_resampler_settings(const ResamplerSettings& settings) {
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
+    resampler_settings_ = settings;
+}
+
+uint32_t PlaybackEngine::get_latency() const {
+    std::lock_guard<rt::CheckedMutex> lock(mutex_);
+    
+    uint32_t latency_ms = audio_output_ ? audio_output_->get_latency() : 0;
+    
+    // Converter latency is reported in input frames
+    const DecoderInstance& inst = decoders_[current_decoder_];
+    if (inst.resample && inst.resampler && inst.stream_info.sample_rate > 0) {
+        latency_ms += static_cast<uint32_t>(
+            (static_cast<uint64_t>(inst.resampler->get_latency()) * 1000) / inst.stream_info.sample_rate);
+    }
+    
+    return latency_ms;
+}
+
 void PlaybackEngine::audio_callback(void* buffer, size_t frames, void* user_data) {
     PlaybackEngine* engine = static_cast<PlaybackEngine*>(user_data);
     engine->fill_buffer(static_cast<float*>(buffer), frames);
 }
 
 void PlaybackEngine::fill_buffer(float* buffer, size_t frames) {
-    // This is called from audio thread - must be real-time safe
+    // This is called from audio thread - must be real-time safe:
+    // no locks, no heap, all shared state read through atomics
+    rt::RealtimeScope realtime;
 
     // Initialize buffer to silence first - always stereo for safety
-    std::memset(buffer, 0, frames * 2 * sizeof(float));
+    std::memset(buffer, 0, frames * OUTPUT_CHANNELS * sizeof(float));
 
-    if (state_ != PlaybackState::Playing) {
+    if (state_.load(std::memory_order_acquire) != PlaybackState::Playing) {
         return;  // Just return silence
     }
 
-    // Safety check: ensure decoder is valid
-    if (current_decoder_ < 0 || current_decoder_ >= 2) {
-        state_ = PlaybackState::Stopped;
-        return;
+    // Announce the render before reading the target. Both sides use seq_cst
+    // so either retire_render_targets() sees the flag or we see its nullptr.
+    render_in_progress_.store(true);
+    DecoderInstance* inst = render_target_.load();
+
+    size_t rendered = 0;
+    while (inst && rendered < frames) {
+        size_t chunk = std::min(frames - rendered, MAX_RENDER_FRAMES);
+        size_t decoded = render_chunk(*inst, buffer + rendered * OUTPUT_CHANNELS, chunk);
+        rendered += decoded;
+        if (decoded == chunk) {
+            continue;
+        }
+
+        // Short chunk: underrun, or the track ended. On end of track splice
+        // the prepared next track in right behind the last sample.
+        if (!inst->eos.load(std::memory_order_acquire) ||
+            !gapless_enabled_.load(std::memory_order_relaxed)) {
+            break;
+        }
+
+        DecoderInstance* next = next_render_target_.load();
+        DecoderInstance* expected = inst;
+        if (!next || !render_target_.compare_exchange_strong(expected, next)) {
+            break;  // Nothing prepared, or the control thread retired us
+        }
+
+        next_render_target_.store(nullptr);
+        spliced_.store(true);
+        inst = next;
     }
 
-    const DecoderInstance& decoder = decoders_[current_decoder_];
+    render_in_progress_.store(false, std::memory_order_release);
 
-    // Safety check: ensure decoder is properly initialized
-    if (!decoder.handle.internal || !decoder.decoder) {
+    // Stop playback gracefully once the track has drained; a short render
+    // without end of stream is an underrun and just plays silence, as does
+    // a missing target while the control thread swaps decoders
+    if (rendered == 0 && inst && inst->eos.load(std::memory_order_acquire)) {
         state_ = PlaybackState::Stopped;
-        return;
     }
+}
 
-    // Safety check: ensure stream info is valid
-    if (decoder.stream_info.channels == 0 || decoder.stream_info.sample_rate == 0) {
-        state_ = PlaybackState::Stopped;
-        return;
+size_t PlaybackEngine::render_chunk(DecoderInstance& inst, float* buffer, size_t frames) {
+    // Safety check: ensure decoder is properly initialized
+    if (!inst.handle.internal || !inst.decoder) {
+        return 0;
     }
 
-    // Simple decode without gapless for now (avoid complexity that could cause crashes)
-    size_t decoded = decode_samples(current_decoder_, buffer, frames);
+    return decode_samples(inst, buffer, frames);
+}
 
-    if (decoded < frames) {
-        // End of track - fill remaining with silence
-        size_t silence_samples = (frames - decoded) * decoder.stream_info.channels;
-        float* silence_start = buffer + (decoded * decoder.stream_info.channels);
-        std::memset(silence_start, 0, silence_samples * sizeof(float));
+size_t PlaybackEngine::decode_samples(DecoderInstance& inst, float* buffer, size_t frames) {
+    if (!inst.active.load(std::memory_order_acquire) ||
+        inst.eos.load(std::memory_order_acquire) || !inst.ring) {
+        return 0;
+    }
+
+    // The ring already holds device-format audio: copy straight out
+    size_t got = inst.ring->read(buffer, frames * OUTPUT_CHANNELS) / OUTPUT_CHANNELS;
 
-        // Stop playback gracefully if we got no samples
-        if (decoded == 0) {
-            state_ = PlaybackState::Stopped;
+    // Update position
+    uint64_t position = inst.current_position.load(std::memory_order_relaxed) + got;
+    inst.current_position.store(position, std::memory_order_release);
+
+    if (got < frames) {
+        if (inst.decoder_eos.load(std::memory_order_acquire) && inst.ring->read_available() == 0) {
+            inst.eos.store(true, std::memory_order_release);
+        } else {
+            // Decoder fell behind; the rest of the buffer stays silent
+            inst.underruns.fetch_add(1, std::memory_order_relaxed);
+            inst.underrun_frames.fetch_add(frames - got, std::memory_order_relaxed);
         }
     }
+
+    return got;
 }
 
-size_t PlaybackEngine::decode_samples(int decoder_idx, float* buffer, size_t frames) {
-    DecoderInstance& inst = decoders_[decoder_idx];
+void PlaybackEngine::start_read_ahead(DecoderInstance& inst) {
+    // Must be called with mutex locked and the reader stopped
+    const uint32_t channels = inst.stream_info.channels;
+    const size_t block_output_frames = max_output_frames(inst, READ_AHEAD_BLOCK_FRAMES);
+    
+    // The ring holds output frames; it must fit at least two decoded blocks
+    // even when upsampling
+    const size_t capacity_frames = std::max(
+        read_ahead_config_.buffer_frames * read_ahead_config_.buffer_count, 2 * block_output_frames);
 
-    if (!inst.active || inst.eos || !inst.handle.internal) {
-        return 0;
+    if (!inst.ring || inst.ring->capacity() < capacity_frames * OUTPUT_CHANNELS) {
+        inst.ring.reset(new SpscRingBuffer<float>(capacity_frames * OUTPUT_CHANNELS));
     }
+    inst.ring->reset();
+    if (!inst.reader_pool) {
+        inst.reader_pool.reset(new AudioFramePool(1, READ_AHEAD_BLOCK_FRAMES, OUTPUT_CHANNELS));
+    }
+    inst.reader_scratch.resize(decodes_to_device_format(inst) ? 0 :
+                               READ_AHEAD_BLOCK_FRAMES * channels *
+                               sample_bytes(inst.stream_info.format));
+    inst.reader_output.resize(block_output_frames * OUTPUT_CHANNELS);
+    if (inst.resample) {
+        inst.resampler->reset();
+    }
+    inst.decoder_eos = false;
+    inst.underruns = 0;
+    inst.underrun_frames = 0;
 
-    // Use a temporary buffer for decoder output
-    std::vector<int32_t> temp_buffer(frames * inst.stream_info.channels);
-    size_t temp_buffer_size = temp_buffer.size() * sizeof(int32_t);
-    size_t samples_decoded = 0;
+    inst.reader_running = true;
+    inst.reader_thread = std::thread(&PlaybackEngine::read_ahead_loop, this, &inst);
+}
 
-    // Decode to temporary buffer first
-    Result result = inst.decoder->decode_block(inst.handle, temp_buffer.data(), temp_buffer_size, &samples_decoded);
+void PlaybackEngine::stop_read_ahead(DecoderInstance& inst) {
+    inst.reader_running = false;
+    if (inst.reader_thread.joinable()) {
+        inst.reader_thread.join();
+    }
+}
 
-    if (result != Result::Success || samples_decoded == 0) {
-        inst.eos = true;
-        return 0;
+void PlaybackEngine::read_ahead_loop(DecoderInstance* inst) {
+    const uint32_t channels = inst->stream_info.channels;
+    const uint32_t rate = std::max<uint32_t>(inst->stream_info.sample_rate, 1);
+    const size_t frame_bytes = channels * sample_bytes(inst->stream_info.format);
+    uint64_t first_sample, end;
+    playable_window(inst->track_info, first_sample, end);
+    uint64_t decoded_position = inst->decoder_position;  // Decoder timeline, delay included
+
+    audio::ISampleRateConverter* resampler = inst->resample ? inst->resampler.get() : nullptr;
+    const size_t block_output_frames = max_output_frames(*inst, READ_AHEAD_BLOCK_FRAMES);
+    const size_t resampler_latency = resampler ? static_cast<size_t>(resampler->get_latency()) : 0;
+
+    // Drop the converter's start-up delay and stop its flush at the exact
+    // converted length so gapless boundaries stay sample-accurate
+    uint64_t skip_frames = (static_cast<uint64_t>(resampler_latency) * OUTPUT_SAMPLE_RATE) / rate;
+    uint64_t input_frames = 0;
+    uint64_t output_frames = 0;
+
+    auto write_resampled = [&](const float* stereo, size_t frames, bool flush) {
+        size_t produced = static_cast<size_t>(resampler->convert(
+            stereo, static_cast<int>(frames), inst->reader_output.data(),
+            static_cast<int>(block_output_frames)));
+        const float* out = inst->reader_output.data();
+
+        size_t dropped = static_cast<size_t>(std::min<uint64_t>(skip_frames, produced));
+        skip_frames -= dropped;
+        out += dropped * OUTPUT_CHANNELS;
+        produced -= dropped;
+
+        if (flush) {
+            uint64_t expected = (input_frames * OUTPUT_SAMPLE_RATE) / rate;
+            produced = static_cast<size_t>(std::min<uint64_t>(
+                produced, expected > output_frames ? expected - output_frames : 0));
+        } else {
+            input_frames += frames;
+        }
+
+        inst->ring->write(out, produced * OUTPUT_CHANNELS);
+        output_frames += produced;
+    };
+
+    // Poll at roughly a quarter of one device buffer while the ring is full
+    const auto idle_wait = std::chrono::milliseconds(
+        std::max<uint64_t>(1, (read_ahead_config_.buffer_frames * 250) / OUTPUT_SAMPLE_RATE));
+
+    // Float stereo decodes straight into the block; anything else is
+    // converted and mapped to stereo into it in one pass
+    const bool direct = decodes_to_device_format(*inst);
+    AudioFrame block = inst->reader_pool->acquire();
+    void* decode_target = direct ? block.bytes() : inst->reader_scratch.data();
+
+    while (inst->reader_running.load(std::memory_order_acquire)) {
+        size_t space_frames = inst->ring->write_available() / OUTPUT_CHANNELS;
+        if (space_frames < block_output_frames) {
+            std::this_thread::sleep_for(idle_wait);
+            continue;
+        }
+
+        size_t samples_decoded = 0;
+        Result result = inst->decoder->decode_block(inst->handle, decode_target,
+                                                    READ_AHEAD_BLOCK_FRAMES * frame_bytes,
+                                                    &samples_decoded);
+        if (result != Result::Success || samples_decoded == 0) {
+            break;
+        }
+
+        samples_decoded = std::min(samples_decoded, READ_AHEAD_BLOCK_FRAMES);
+
+        uint64_t block_start = decoded_position;
+        uint64_t block_end = decoded_position + samples_decoded;
+        decoded_position = block_end;
+
+        // Trim encoder padding (or the rest of the file after a range) at
+        // the end of the track
+        bool last_block = false;
+        if (end > 0 && block_end >= end) {
+            block_end = std::max(end, block_start);
+            last_block = true;
+        }
+
+        // Trim encoder delay (and what precedes a range) at the start
+        uint64_t first = std::max(block_start, first_sample);
+        if (block_end > first) {
+            size_t offset = static_cast<size_t>(first - block_start);
+            size_t count = static_cast<size_t>(block_end - first);
+
+            // Map to the device layout before resampling: fewer channels to convert
+            const float* stereo = block.data() + offset * OUTPUT_CHANNELS;
+            if (!direct) {
+                block.import(inst->reader_scratch.data() + offset * frame_bytes,
+                             inst->stream_info.format, count, static_cast<uint16_t>(channels),
+                             OUTPUT_CHANNELS, rate, FrameLayout::Interleaved);
+                stereo = block.interleaved();
+            }
+
+            if (resampler) {
+                write_resampled(stereo, count, false);
+            } else {
+                inst->ring->write(stereo, count * OUTPUT_CHANNELS);
+            }
+        }
+
+        if (last_block) {
+            break;
+        }
     }
 
-    // Convert int32 to float (normalized to [-1.0, 1.0])
-    for (size_t i = 0; i < samples_decoded * inst.stream_info.channels; ++i) {
-        buffer[i] = static_cast<float>(temp_buffer[i]) / 2147483648.0f;  // 2^31
+    // Push the converter's look-ahead out with silence
+    if (resampler) {
+        const size_t flush_frames = std::min(resampler_latency + 4, READ_AHEAD_BLOCK_FRAMES);
+        while (inst->reader_running.load(std::memory_order_acquire) &&
+               inst->ring->write_available() / OUTPUT_CHANNELS < block_output_frames) {
+            std::this_thread::sleep_for(idle_wait);
+        }
+        if (inst->reader_running.load(std::memory_order_acquire)) {
+            block.set_format(flush_frames, OUTPUT_CHANNELS, rate, FrameLayout::Interleaved);
+            block.silence();
+            write_resampled(block.interleaved(), flush_frames, true);
+        }
     }
 
-    // Update position
-    inst.current_position += samples_decoded;
+    inst->decoder_eos.store(true, std::memory_order_release);
+}
 
-    // Check if we've reached the end
-    uint64_t effective_end = inst.track_info.total_samples - inst.track_info.encoder_padding;
-    if (inst.current_position >= effective_end) {
-        inst.eos = true;
+void PlaybackEngine::publish_render_targets() {
+    // Must be called with mutex locked
+    if (next_decoder_ >= 0) {
+        next_render_target_.store(&decoders_[next_decoder_]);
     }
+    render_target_.store(&decoders_[current_decoder_]);
+}
+
+void PlaybackEngine::retire_render_targets() {
+    // Must be called with mutex locked
+    render_target_.store(nullptr);
+    next_render_target_.store(nullptr);
 
-    return samples_decoded;
+    // The callback never blocks, so this wait is bounded by one render pass
+    while (render_in_progress_.load()) {
+        std::this_thread::yield();
+    }
+
+    // A splice may have happened before the targets were withdrawn
+    complete_pending_transition();
 }
 
-void PlaybackEngine::switch_decoder() {
+void PlaybackEngine::complete_pending_transition() {
     // Must be called with mutex locked
+    if (!spliced_.exchange(false)) {
+        return;
+    }
+
+    // The old decoder is no longer reachable from render_target_; once the
+    // splicing pass has finished nothing on the audio thread can hold it
+    while (render_in_progress_.load()) {
+        std::this_thread::yield();
+    }
+
+    switch_decoder();
+}
+
+void PlaybackEngine::switch_decoder() {
+    // Must be called with mutex locked and the current decoder no longer
+    // rendered by the audio thread
     close_decoder(current_decoder_);
     current_decoder_ = next_decoder_;
     next_decoder_ = -1;
+    next_requested_ = false;
     
     std::cout << "Switched to next track" << std::endl;
 }
 
+void PlaybackEngine::supervisor_loop() {
+    std::unique_lock<std::mutex> wait_lock(supervisor_mutex_);
+    
+    while (supervisor_running_) {
+        supervisor_cv_.wait_for(wait_lock, std::chrono::milliseconds(SUPERVISOR_INTERVAL_MS));
+        if (!supervisor_running_) {
+            break;
+        }
+        wait_lock.unlock();
+        
+        NextTrackProvider provider;
+        {
+            std::lock_guard<rt::CheckedMutex> lock(mutex_);
+            complete_pending_transition();
+            
+            // Ask for the next track once per track, early enough for its
+            // read-ahead buffer to fill before the splice
+            if (next_track_provider_ && gapless_enabled_ && state_ == PlaybackState::Playing &&
+                next_decoder_ < 0 && !next_requested_ && is_approaching_end()) {
+                next_requested_ = true;
+                provider = next_track_provider_;
+            }
+        }
+        
+        // The provider may do I/O; call it without holding the engine lock
+        std::string file_path;
+        TrackRange range;
+        IDecoder* decoder = nullptr;
+        if (provider && provider(file_path, range, decoder) && decoder) {
+            prepare_next_track(file_path, decoder, range);
+        }
+        
+        wait_lock.lock();
+    }
+}
+
 bool PlaybackEngine::is_approaching_end() const {
     const DecoderInstance& inst = decoders_[current_decoder_];
     
-    if (inst.stream_info.sample_rate == 0 || inst.track_info.total_samples == 0) {
+    if (inst.stream_info.sample_rate == 0 ||
+        (inst.track_info.total_samples == 0 && inst.track_info.range.end == 0)) {
         return false;
     }
     
-    uint64_t remaining_samples = inst.track_info.total_samples - inst.current_position;
-    uint64_t remaining_ms = (remaining_samples * 1000) / inst.stream_info.sample_rate;
+    uint64_t first, end;
+    playable_window(inst.track_info, first, end);
+    uint64_t playable = end > first ? end - first : 0;
+    uint64_t playable_ms = (playable * 1000) / inst.stream_info.sample_rate;
+    uint64_t position_ms = (inst.current_position * 1000) / OUTPUT_SAMPLE_RATE;
+    uint64_t remaining_ms = playable_ms > position_ms ? playable_ms - position_ms : 0;
     
     return remaining_ms < PREBUFFER_THRESHOLD_MS;
 }
@@ -421,6 +983,8 @@ bool PlaybackEngine::is_approaching_end() const {
 void PlaybackEngine::close_decoder(int decoder_idx) {
     DecoderInstance& inst = decoders_[decoder_idx];
     
+    stop_read_ahead(inst);
+    
     if (inst.handle.internal && inst.decoder) {
         inst.decoder->close_stream(inst.handle);
     }
@@ -430,6 +994,7 @@ void PlaybackEngine::close_decoder(int decoder_idx) {
     inst.active = false;
     inst.eos = false;
     inst.current_position = 0;
+    inst.decoder_position = 0;
     std::memset(&inst.stream_info, 0, sizeof(inst.stream_info));
 }
 
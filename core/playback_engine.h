@@ -3,12 +3,24 @@
 #include "mp_types.h"
 #include "mp_decoder.h"
 #include "mp_audio_output.h"
+#include "realtime_guard.h"
+#include "audio_frame.h"
+#include "spsc_ring_buffer.h"
 #include <memory>
 #include <atomic>
 #include <mutex>
 #include <thread>
+#include <condition_variable>
+#include <functional>
+#include <map>
 #include <queue>
 #include <string>
+#include <vector>
+#include <cstring>
+
+namespace audio {
+class ISampleRateConverter;
+}
 
 namespace mp {
 namespace core {
@@ -21,36 +33,111 @@ enum class PlaybackState {
     Transitioning  // During gapless track change
 };
 
+// Part of a file played as a track of its own (a CUE sheet entry),
+// counted after the encoder delay in 1/rate seconds (75 for CD frames),
+// or in samples at the file's rate when rate is 0. 0/0 plays the whole
+// file; end 0 runs to the end.
+struct TrackRange {
+    uint64_t start;
+    uint64_t end;
+    uint32_t rate;
+    
+    TrackRange() : start(0), end(0), rate(0) {}
+    TrackRange(uint64_t start, uint64_t end, uint32_t rate = 0) : start(start), end(end), rate(rate) {}
+    
+    // The range in samples of a stream at sample_rate, to the nearest one
+    TrackRange in_samples(uint32_t sample_rate) const {
+        if (rate == 0) {
+            return *this;
+        }
+        auto convert = [&](uint64_t units) { return (units * sample_rate + rate / 2) / rate; };
+        return TrackRange(convert(start), convert(end));
+    }
+};
+
 // Track information for playback
 struct TrackInfo {
     std::string file_path;
     uint64_t encoder_delay;     // Samples to skip at start
     uint64_t encoder_padding;   // Samples to skip at end
     uint64_t total_samples;
+    TrackRange range;           // Sub-track within the file
     
     TrackInfo() : encoder_delay(0), encoder_padding(0), total_samples(0) {}
 };
 
+// Read-ahead buffer sizing. Mirrors AudioConfig::buffer_size/buffer_count:
+// the ring holds buffer_frames * buffer_count frames of decoded audio.
+struct ReadAheadConfig {
+    size_t buffer_frames;
+    size_t buffer_count;
+    
+    ReadAheadConfig() : buffer_frames(4096), buffer_count(4) {}
+    ReadAheadConfig(size_t frames, size_t count) : buffer_frames(frames), buffer_count(count) {}
+};
+
+// Resampler quality selection. Mirrors ResamplerConfig::quality and
+// format_quality: keys are lower-case file extensions, values are
+// fast/good/high/best as understood by EnhancedSampleRateConverter.
+struct ResamplerSettings {
+    std::string quality;
+    std::map<std::string, std::string> format_quality;
+    
+    ResamplerSettings()
+        : quality("good")
+        , format_quality{{"mp3", "good"}, {"flac", "best"}, {"wav", "fast"}, {"ogg", "good"}} {}
+};
+
+// Read-ahead health counters for sizing the buffer to the storage
+struct ReadAheadStats {
+    size_t capacity_frames;     // Ring capacity (output frames)
+    size_t fill_frames;         // Output frames currently buffered
+    uint64_t underruns;         // Callbacks that found the ring short
+    uint64_t underrun_frames;   // Frames replaced by silence
+};
+
 // Decoder instance wrapper
+// decoder/handle/stream_info/track_info are written by the control thread only
+// while neither the audio thread nor the read-ahead thread uses the instance;
+// the atomics and the ring are shared between them.
 struct DecoderInstance {
     IDecoder* decoder;
     DecoderHandle handle;
     AudioStreamInfo stream_info;
     TrackInfo track_info;
-    uint64_t current_position;  // In samples
-    bool active;
-    bool eos;  // End of stream reached
-    
-    DecoderInstance() 
-        : decoder(nullptr)
-        , current_position(0)
-        , active(false)
-        , eos(false) {
-        handle.internal = nullptr;
-        std::memset(&stream_info, 0, sizeof(stream_info));
-    }
+    std::atomic<uint64_t> current_position;  // Output frames played (delay excluded)
+    std::atomic<bool> active;
+    std::atomic<bool> eos;  // End of stream reached (ring drained)
+    
+    // Read-ahead: the reader thread decodes, maps to stereo and resamples
+    // into ring, so it holds device-format audio; the callback only copies out
+    std::unique_ptr<SpscRingBuffer<float>> ring;
+    std::thread reader_thread;
+    std::atomic<bool> reader_running;
+    std::atomic<bool> decoder_eos;  // Decoder has no more data
+    uint64_t decoder_position;      // Decoder timeline position the reader starts at
+    std::atomic<uint64_t> underruns;
+    std::atomic<uint64_t> underrun_frames;
+    std::vector<uint8_t> reader_scratch;   // Raw decoder output not already in device format
+    std::unique_ptr<AudioFramePool> reader_pool;   // The reader's device-format block
+    std::vector<float> reader_output;      // Resampled block
+    
+    // Rate conversion to the device rate. Kept across tracks and reused
+    // when the quality matches; resample is false when rates already agree.
+    std::unique_ptr<audio::ISampleRateConverter> resampler;
+    std::string resampler_quality;
+    int resampler_rate;
+    bool resample;
+    
+    DecoderInstance();
+    ~DecoderInstance();
 };
 
+// Supplies the track that follows the current one, and the range of its
+// file to play (left empty for the whole file). Called off the audio thread
+// when the current track nears its end; return false if there is none.
+using NextTrackProvider = std::function<bool(std::string& file_path, TrackRange& range, IDecoder*& decoder)>;
+
 // Playback engine with gapless support
 class PlaybackEngine {
 public:
@@ -63,11 +150,14 @@ public:
     // Shutdown playback engine
     void shutdown();
     
-    // Load track for playback (to primary decoder)
-    Result load_track(const std::string& file_path, IDecoder* decoder);
+    // Load track for playback (to primary decoder). A range plays only that
+    // part of the file, starting and stopping on its exact samples.
+    Result load_track(const std::string& file_path, IDecoder* decoder,
+                      const TrackRange& range = TrackRange());
     
     // Prepare next track for gapless transition
-    Result prepare_next_track(const std::string& file_path, IDecoder* decoder);
+    Result prepare_next_track(const std::string& file_path, IDecoder* decoder,
+                              const TrackRange& range = TrackRange());
     
     // Start playback
     Result play();
@@ -99,6 +189,9 @@ public:
     // Trigger gapless transition to next track
     Result transition_to_next();
     
+    // Set the source the engine pre-opens next tracks from
+    void set_next_track_provider(NextTrackProvider provider);
+    
     // Set volume (0.0 to 1.0)
     void set_volume(float volume);
     
@@ -109,6 +202,18 @@ public:
     void set_gapless_enabled(bool enabled) { gapless_enabled_ = enabled; }
     bool is_gapless_enabled() const { return gapless_enabled_; }
     
+    // Configure read-ahead depth (applies to tracks loaded afterwards)
+    void set_read_ahead(const ReadAheadConfig& config);
+    
+    // Get read-ahead fill level and underrun counters for the current track
+    ReadAheadStats get_read_ahead_stats() const;
+    
+    // Choose resampler quality per format (applies to tracks loaded afterwards)
+    void set_resampler_settings(const ResamplerSettings& settings);
+    
+    // Output latency in milliseconds: resampler filter delay plus device latency
+    uint32_t get_latency() const;
+    
 private:
     // Audio callback function
     static void audio_callback(void* buffer, size_t frames, void* user_data);
@@ -116,12 +221,52 @@ private:
     // Fill audio buffer (called from audio callback)
     void fill_buffer(float* buffer, size_t frames);
     
-    // Decode samples from active decoder
-    size_t decode_samples(int decoder_idx, float* buffer, size_t frames);
+    // Render one chunk (frames <= MAX_RENDER_FRAMES) from a published instance
+    size_t render_chunk(DecoderInstance& inst, float* buffer, size_t frames);
+    
+    // Copy decoded samples for the active decoder out of its ring
+    size_t decode_samples(DecoderInstance& inst, float* buffer, size_t frames);
+    
+    // Start/stop the read-ahead thread of a decoder instance
+    void start_read_ahead(DecoderInstance& inst);
+    void stop_read_ahead(DecoderInstance& inst);
+    
+    // Read-ahead thread body
+    void read_ahead_loop(DecoderInstance* inst);
+    
+    // Open a decoder instance, read its gapless metadata and position it at
+    // the start of the range
+    Result open_decoder(DecoderInstance& inst, const std::string& file_path, IDecoder* decoder,
+                        const TrackRange& range);
+    
+    // Set up (or reuse) the converter from the track rate to the device rate
+    void configure_resampler(DecoderInstance& inst);
+    
+    // Output frames a resampler may produce from the given input frames
+    size_t max_output_frames(const DecoderInstance& inst, size_t input_frames) const;
+    
+    // True when the decoder already produces float stereo, so the reader
+    // decodes straight into its block without a conversion
+    static bool decodes_to_device_format(const DecoderInstance& inst);
+    
+    // Hand the current instance (and the prepared next one, if any) to the
+    // audio thread
+    void publish_render_targets();
+    
+    // Withdraw the published instances and wait until the audio thread has
+    // left fill_buffer, so they can be mutated or closed safely
+    void retire_render_targets();
+    
+    // Adopt a splice the audio thread made: the old current decoder is closed
+    // and the next one becomes current
+    void complete_pending_transition();
     
     // Switch to next decoder (gapless transition)
     void switch_decoder();
     
+    // Background thread that finishes splices and pre-opens the next track
+    void supervisor_loop();
+    
     // Check if approaching end of track
     bool is_approaching_end() const;
     
@@ -137,11 +282,44 @@ private:
     std::atomic<float> volume_;
     std::atomic<bool> gapless_enabled_;
     
-    mutable std::mutex mutex_;
+    // Control-thread lock; never taken on the audio thread
+    mutable rt::CheckedMutex mutex_;
+    
+    // Snapshot of what the audio thread renders. The callback never locks:
+    // it raises render_in_progress_, reads render_target_ and lowers the flag.
+    // When the target drains it swaps in next_render_target_ and raises
+    // spliced_ for the control side to finish the transition.
+    std::atomic<DecoderInstance*> render_target_;
+    std::atomic<DecoderInstance*> next_render_target_;
+    std::atomic<bool> render_in_progress_;
+    std::atomic<bool> spliced_;
+    
+    // Next-track pre-opening
+    NextTrackProvider next_track_provider_;
+    bool next_requested_;
+    std::thread supervisor_thread_;
+    std::mutex supervisor_mutex_;
+    std::condition_variable supervisor_cv_;
+    bool supervisor_running_;
+    
+    ReadAheadConfig read_ahead_config_;
+    ResamplerSettings resampler_settings_;
+    
+    // Frames decoded per read-ahead iteration
+    static constexpr size_t READ_AHEAD_BLOCK_FRAMES = 2048;
+    
+    // Largest chunk rendered in one pass; bigger callbacks are split
+    static constexpr size_t MAX_RENDER_FRAMES = 4096;
+    static constexpr uint32_t MAX_DECODER_CHANNELS = 8;
+    static constexpr uint32_t OUTPUT_CHANNELS = 2;
+    static constexpr uint32_t OUTPUT_SAMPLE_RATE = 48000;
     
     // Pre-buffering threshold (in milliseconds)
     static constexpr uint64_t PREBUFFER_THRESHOLD_MS = 5000;  // 5 seconds
     
+    // Supervisor polling interval (in milliseconds)
+    static constexpr uint64_t SUPERVISOR_INTERVAL_MS = 50;
+    
     // Crossfade duration for sample rate changes (in milliseconds)
     static constexpr uint64_t CROSSFADE_DURATION_MS = 50;
     
@@ -0,0 +1,547 @@
+﻿#include "playlist_formats.h"
+#include "path_resolver.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+namespace mp {
+namespace core {
+
+namespace {
+
+std::string lower(std::string s) {
+    for (char& c : s) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return s;
+}
+
+std::string trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return s.substr(begin, end - begin + 1);
+}
+
+bool valid_utf8(const std::string& s) {
+    size_t i = 0;
+    while (i < s.size()) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        size_t extra;
+        if (c < 0x80) extra = 0;
+        else if ((c >> 5) == 0x6) extra = 1;
+        else if ((c >> 4) == 0xE) extra = 2;
+        else if ((c >> 3) == 0x1E) extra = 3;
+        else return false;
+        for (size_t k = 1; k <= extra; ++k) {
+            if (i + k >= s.size() || (static_cast<unsigned char>(s[i + k]) & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        i += extra + 1;
+    }
+    return true;
+}
+
+std::string latin1_to_utf8(const std::string& s) {
+    std::string out;
+    out.reserve(s.size() + s.size() / 8);
+    for (char ch : s) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        if (c < 0x80) {
+            out += ch;
+        } else {
+            out += static_cast<char>(0xC0 | (c >> 6));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+    return out;
+}
+
+// Text without a BOM, as UTF-8
+std::string decode_text(const std::string& text, bool legacy_fallback) {
+    std::string out = text.compare(0, 3, "\xEF\xBB\xBF") == 0 ? text.substr(3) : text;
+    if (legacy_fallback && !valid_utf8(out)) {
+        out = latin1_to_utf8(out);
+    }
+    return out;
+}
+
+std::vector<std::string> split_lines(const std::string& text) {
+    std::vector<std::string> lines;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+// "Artist - Title", or just a title
+void split_display(const std::string& display, PlaylistEntry& entry) {
+    size_t dash = display.find(" - ");
+    if (dash == std::string::npos) {
+        entry.title = trim(display);
+    } else {
+        entry.artist = trim(display.substr(0, dash));
+        entry.title = trim(display.substr(dash + 3));
+    }
+}
+
+bool parse_m3u(const std::string& text, std::vector<PlaylistEntry>& out) {
+    PlaylistEntry pending;
+    for (const std::string& raw : split_lines(text)) {
+        std::string line = trim(raw);
+        if (line.empty()) {
+            continue;
+        }
+        if (line[0] == '#') {
+            // #EXTINF:<seconds>[ attributes],<display>
+            if (lower(line.substr(0, 8)) == "#extinf:") {
+                size_t comma = line.find(',', 8);
+                double seconds = std::strtod(line.c_str() + 8, nullptr);
+                pending.duration_ms = seconds >= 0 ? static_cast<int64_t>(seconds * 1000 + 0.5) : -1;
+                if (comma != std::string::npos) {
+                    split_display(line.substr(comma + 1), pending);
+                }
+            }
+            continue;
+        }
+        pending.location = line;
+        out.push_back(std::move(pending));
+        pending = PlaylistEntry();
+    }
+    return true;
+}
+
+bool parse_pls(const std::string& text, std::vector<PlaylistEntry>& out) {
+    std::map<long, PlaylistEntry> entries;
+    bool header = false;
+    for (const std::string& raw : split_lines(text)) {
+        std::string line = trim(raw);
+        if (lower(line) == "[playlist]") {
+            header = true;
+            continue;
+        }
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            continue;
+        }
+        std::string key = lower(trim(line.substr(0, eq)));
+        std::string value = trim(line.substr(eq + 1));
+
+        // File<n>, Title<n>, Length<n>
+        size_t digits = key.find_first_of("0123456789");
+        if (digits == std::string::npos || digits == 0) {
+            continue;
+        }
+        long n = std::strtol(key.c_str() + digits, nullptr, 10);
+        std::string field = key.substr(0, digits);
+        if (field == "file") {
+            entries[n].location = value;
+        } else if (field == "title") {
+            split_display(value, entries[n]);
+        } else if (field == "length") {
+            long seconds = std::strtol(value.c_str(), nullptr, 10);
+            entries[n].duration_ms = seconds >= 0 ? seconds * 1000 : -1;
+        }
+    }
+    if (!header) {
+        return false;
+    }
+    for (auto& entry : entries) {
+        if (!entry.second.location.empty()) {
+            out.push_back(std::move(entry.second));
+        }
+    }
+    return true;
+}
+
+std::string xml_unescape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s.compare(i, 9, "<![CDATA[") == 0) {
+            size_t end = s.find("]]>", i + 9);
+            if (end == std::string::npos) {
+                end = s.size();
+            }
+            out.append(s, i + 9, end - i - 9);
+            i = end + 2;
+            continue;
+        }
+        if (s[i] != '&') {
+            out += s[i];
+            continue;
+        }
+        size_t semi = s.find(';', i);
+        if (semi == std::string::npos || semi - i > 10) {
+            out += s[i];
+            continue;
+        }
+        std::string name = s.substr(i + 1, semi - i - 1);
+        uint32_t code = 0;
+        if (name == "amp") code = '&';
+        else if (name == "lt") code = '<';
+        else if (name == "gt") code = '>';
+        else if (name == "quot") code = '"';
+        else if (name == "apos") code = '\'';
+        else if (name.size() > 1 && name[0] == '#') {
+            code = static_cast<uint32_t>(name[1] == 'x' || name[1] == 'X'
+                                             ? std::strtoul(name.c_str() + 2, nullptr, 16)
+                                             : std::strtoul(name.c_str() + 1, nullptr, 10));
+        }
+        if (code == 0 || code > 0x10FFFF) {
+            out += s[i];
+            continue;
+        }
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        i = semi;
+    }
+    return out;
+}
+
+std::string xml_escape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        switch (c) {
+        case '&': out += "&amp;"; break;
+        case '<': out += "&lt;"; break;
+        case '>': out += "&gt;"; break;
+        case '"': out += "&quot;"; break;
+        default: out += c;
+        }
+    }
+    return out;
+}
+
+// Start of the element called name at or after pos: "<name>" or "<name ...>"
+size_t find_element(const std::string& xml, const std::string& name, size_t pos, size_t limit) {
+    while ((pos = xml.find("<" + name, pos)) != std::string::npos && pos < limit) {
+        char next = pos + name.size() + 1 < xml.size() ? xml[pos + name.size() + 1] : '\0';
+        if (next == '>' || next == '/' || std::isspace(static_cast<unsigned char>(next))) {
+            return pos;
+        }
+        pos += name.size() + 1;
+    }
+    return std::string::npos;
+}
+
+// Text of the first <name> child within [begin, end)
+bool element_text(const std::string& xml, const std::string& name, size_t begin, size_t end, std::string& out) {
+    size_t open = find_element(xml, name, begin, end);
+    if (open == std::string::npos) {
+        return false;
+    }
+    size_t content = xml.find('>', open);
+    if (content == std::string::npos || content >= end) {
+        return false;
+    }
+    if (xml[content - 1] == '/') {
+        out.clear();        // <name/>
+        return true;
+    }
+    size_t close = xml.find("</" + name, content);
+    if (close == std::string::npos || close > end) {
+        return false;
+    }
+    out = trim(xml_unescape(xml.substr(content + 1, close - content - 1)));
+    return true;
+}
+
+bool parse_xspf(const std::string& xml, std::vector<PlaylistEntry>& out) {
+    if (find_element(xml, "playlist", 0, xml.size()) == std::string::npos) {
+        return false;
+    }
+    size_t pos = 0;
+    while ((pos = find_element(xml, "track", pos, xml.size())) != std::string::npos) {
+        size_t end = xml.find("</track>", pos);
+        if (end == std::string::npos) {
+            break;
+        }
+        PlaylistEntry entry;
+        std::string location, duration;
+        if (element_text(xml, "location", pos, end, location) && !location.empty()) {
+            entry.location = is_url(location) && location.compare(0, 7, "file://") != 0
+                                 ? location : file_uri_to_path(location);
+            element_text(xml, "title", pos, end, entry.title);
+            element_text(xml, "creator", pos, end, entry.artist);
+            if (element_text(xml, "duration", pos, end, duration) && !duration.empty()) {
+                entry.duration_ms = std::strtoll(duration.c_str(), nullptr, 10);
+            }
+            out.push_back(std::move(entry));
+        }
+        pos = end + 8;
+    }
+    return true;
+}
+
+// Value after a CUE command: a quoted string or the next word; rest gets
+// what follows
+std::string cue_value(const std::string& s, size_t pos, std::string* rest = nullptr) {
+    while (pos < s.size() && std::isspace(static_cast<unsigned char>(s[pos]))) {
+        ++pos;
+    }
+    std::string value;
+    size_t after;
+    if (pos < s.size() && s[pos] == '"') {
+        size_t close = s.find('"', pos + 1);
+        if (close == std::string::npos) {
+            close = s.size();
+        }
+        value = s.substr(pos + 1, close - pos - 1);
+        after = std::min(close + 1, s.size());
+    } else if (rest) {
+        // Unquoted FILE name: everything up to the type word
+        size_t last_space = s.find_last_of(" \t");
+        after = last_space != std::string::npos && last_space > pos ? last_space : s.size();
+        value = trim(s.substr(pos, after - pos));
+    } else {
+        value = trim(s.substr(pos));
+        after = s.size();
+    }
+    if (rest) {
+        *rest = trim(s.substr(after));
+    }
+    return value;
+}
+
+// mm:ss:ff -> frames
+bool cue_time(const std::string& s, uint64_t& frames) {
+    unsigned long m, sec, f;
+    char c1, c2;
+    std::istringstream in(s);
+    if (!(in >> m >> c1 >> sec >> c2 >> f) || c1 != ':' || c2 != ':' || sec >= 60 || f >= 75) {
+        return false;
+    }
+    frames = (static_cast<uint64_t>(m) * 60 + sec) * 75 + f;
+    return true;
+}
+
+bool parse_cue(const std::string& text, std::vector<PlaylistEntry>& out) {
+    struct CueTrack {
+        PlaylistEntry entry;
+        bool audio = true;
+        bool has_start = false;
+    };
+    std::vector<CueTrack> tracks;
+    std::string album_performer, file;
+    bool any_file = false;
+
+    for (const std::string& raw : split_lines(text)) {
+        std::string line = trim(raw);
+        size_t space = line.find_first_of(" \t");
+        std::string command = lower(line.substr(0, space));
+        size_t args = space == std::string::npos ? line.size() : space;
+
+        if (command == "file") {
+            std::string type;
+            file = cue_value(line, args, &type);
+            any_file = true;
+        } else if (command == "track") {
+            std::string type;
+            cue_value(line, args, &type);
+            CueTrack track;
+            track.audio = lower(type) == "audio";
+            track.entry.location = file;
+            track.entry.artist = album_performer;
+            track.entry.cd_frames = true;
+            tracks.push_back(std::move(track));
+        } else if (command == "title" && !tracks.empty()) {
+            tracks.back().entry.title = cue_value(line, args);
+        } else if (command == "performer") {
+            if (tracks.empty()) {
+                album_performer = cue_value(line, args);
+            } else {
+                tracks.back().entry.artist = cue_value(line, args);
+            }
+        } else if (command == "index" && !tracks.empty()) {
+            std::string time;
+            std::string number = cue_value(line, args, &time);
+            uint64_t frames;
+            if (std::strtol(number.c_str(), nullptr, 10) == 1 && cue_time(time, frames)) {
+                // INDEX 01 is where the track starts; it may follow a FILE change
+                tracks.back().entry.location = file;
+                tracks.back().entry.start = frames;
+                tracks.back().has_start = true;
+            }
+        }
+    }
+    if (!any_file) {
+        return false;
+    }
+
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        CueTrack& track = tracks[i];
+        if (!track.audio || !track.has_start || track.entry.location.empty()) {
+            continue;
+        }
+        for (size_t j = i + 1; j < tracks.size(); ++j) {
+            if (tracks[j].has_start) {
+                if (tracks[j].entry.location == track.entry.location &&
+                    tracks[j].entry.start > track.entry.start) {
+                    track.entry.end = tracks[j].entry.start;
+                    track.entry.duration_ms =
+                        static_cast<int64_t>((track.entry.end - track.entry.start) * 1000 / 75);
+                }
+                break;
+            }
+        }
+        out.push_back(std::move(track.entry));
+    }
+    return true;
+}
+
+std::string cue_time_text(uint64_t frames) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%02llu:%02llu:%02llu",
+                  static_cast<unsigned long long>(frames / (75 * 60)),
+                  static_cast<unsigned long long>((frames / 75) % 60),
+                  static_cast<unsigned long long>(frames % 75));
+    return buffer;
+}
+
+// CUE has no escapes; swap double quotes for single ones
+std::string cue_quote(const std::string& s) {
+    std::string out(s);
+    std::replace(out.begin(), out.end(), '"', '\'');
+    return "\"" + out + "\"";
+}
+
+std::string display_name(const PlaylistEntry& entry) {
+    return entry.artist.empty() ? entry.title : entry.artist + " - " + entry.title;
+}
+
+} // namespace
+
+PlaylistFormat playlist_format_for(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return PlaylistFormat::Unknown;
+    }
+    std::string ext = lower(path.substr(dot + 1));
+    if (ext == "m3u" || ext == "m3u8") return PlaylistFormat::M3U;
+    if (ext == "pls") return PlaylistFormat::PLS;
+    if (ext == "xspf") return PlaylistFormat::XSPF;
+    if (ext == "cue") return PlaylistFormat::CUE;
+    return PlaylistFormat::Unknown;
+}
+
+bool parse_playlist(PlaylistFormat format, const std::string& text, std::vector<PlaylistEntry>& out) {
+    switch (format) {
+    case PlaylistFormat::M3U:
+        return parse_m3u(decode_text(text, true), out);
+    case PlaylistFormat::PLS:
+        return parse_pls(decode_text(text, true), out);
+    case PlaylistFormat::XSPF:
+        return parse_xspf(decode_text(text, false), out);
+    case PlaylistFormat::CUE:
+        return parse_cue(decode_text(text, true), out);
+    default:
+        return false;
+    }
+}
+
+std::string write_playlist(PlaylistFormat format, const std::vector<PlaylistEntry>& entries) {
+    std::ostringstream out;
+    switch (format) {
+    case PlaylistFormat::M3U:
+        out << "#EXTM3U\n";
+        for (const auto& entry : entries) {
+            if (!entry.title.empty() || entry.duration_ms >= 0) {
+                out << "#EXTINF:" << (entry.duration_ms >= 0 ? (entry.duration_ms + 500) / 1000 : -1)
+                    << "," << display_name(entry) << "\n";
+            }
+            out << entry.location << "\n";
+        }
+        break;
+
+    case PlaylistFormat::PLS:
+        out << "[playlist]\n";
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const auto& entry = entries[i];
+            out << "File" << i + 1 << "=" << entry.location << "\n";
+            if (!entry.title.empty()) {
+                out << "Title" << i + 1 << "=" << display_name(entry) << "\n";
+            }
+            out << "Length" << i + 1 << "="
+                << (entry.duration_ms >= 0 ? (entry.duration_ms + 500) / 1000 : -1) << "\n";
+        }
+        out << "NumberOfEntries=" << entries.size() << "\nVersion=2\n";
+        break;
+
+    case PlaylistFormat::XSPF:
+        out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               "<playlist version=\"1\" xmlns=\"http://xspf.org/ns/0/\">\n  <trackList>\n";
+        for (const auto& entry : entries) {
+            out << "    <track>\n      <location>"
+                << xml_escape(is_url(entry.location) ? entry.location : path_to_uri(entry.location))
+                << "</location>\n";
+            if (!entry.title.empty()) {
+                out << "      <title>" << xml_escape(entry.title) << "</title>\n";
+            }
+            if (!entry.artist.empty()) {
+                out << "      <creator>" << xml_escape(entry.artist) << "</creator>\n";
+            }
+            if (entry.duration_ms >= 0) {
+                out << "      <duration>" << entry.duration_ms << "</duration>\n";
+            }
+            out << "    </track>\n";
+        }
+        out << "  </trackList>\n</playlist>\n";
+        break;
+
+    case PlaylistFormat::CUE: {
+        // Consecutive entries of one file share its FILE block
+        std::string file;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const auto& entry = entries[i];
+            if (i == 0 || entry.location != file) {
+                file = entry.location;
+                out << "FILE " << cue_quote(file) << " WAVE\n";
+            }
+            char number[8];
+            std::snprintf(number, sizeof(number), "%02u", static_cast<unsigned>(i + 1));
+            out << "  TRACK " << number << " AUDIO\n";
+            if (!entry.title.empty()) {
+                out << "    TITLE " << cue_quote(entry.title) << "\n";
+            }
+            if (!entry.artist.empty()) {
+                out << "    PERFORMER " << cue_quote(entry.artist) << "\n";
+            }
+            out << "    INDEX 01 " << cue_time_text(entry.cd_frames ? entry.start : 0) << "\n";
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+    return out.str();
+}
+
+}} // namespace mp::core
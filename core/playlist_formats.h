@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+enum class PlaylistFormat {
+    Unknown,
+    M3U,        // .m3u, .m3u8; extended (#EXTINF) or plain
+    PLS,
+    XSPF,
+    CUE
+};
+
+// From the file extension
+PlaylistFormat playlist_format_for(const std::string& path);
+
+// One entry as a playlist file lists it
+struct PlaylistEntry {
+    std::string location;       // Path, absolute or relative to the playlist, or URL
+    std::string title;
+    std::string artist;
+    int64_t duration_ms;        // -1 if not given
+    uint64_t start;             // Sub-track of the file, in CD frames (1/75 s)
+    uint64_t end;               // when cd_frames, else samples; 0/0 is the whole
+    bool cd_frames;             // file and end 0 runs to its end
+
+    PlaylistEntry() : duration_ms(-1), start(0), end(0), cd_frames(false) {}
+};
+
+// Entries of a playlist file's text. A UTF-8 byte-order mark is skipped;
+// M3U, PLS and CUE text that is not valid UTF-8 is read as Latin-1, as
+// older tools wrote it. XSPF locations come back as paths (file:// and
+// percent-encoding undone) unless they are other URLs. CUE tracks end
+// where the next one in the same file starts. False if the text is not a
+// playlist in that format.
+bool parse_playlist(PlaylistFormat format, const std::string& text, std::vector<PlaylistEntry>& out);
+
+// Text of a playlist file. Only CUE sheets keep sub-track ranges, and they
+// need them in CD frames; the other formats list the entry's file.
+std::string write_playlist(PlaylistFormat format, const std::vector<PlaylistEntry>& entries);
+
+}} // namespace mp::core
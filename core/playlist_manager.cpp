@@ -1,7 +1,12 @@
 ﻿#include "playlist_manager.h"
+#include "playlist_store.h"
+#include "playlist_formats.h"
+#include "path_resolver.h"
+#include "track_metadata.h"
 #include <fstream>
 #include <sstream>
 #include <filesystem>
+#include <cctype>
 #include <chrono>
 #include <algorithm>
 #include <iostream>
@@ -9,8 +14,228 @@
 namespace mp {
 namespace core {
 
+namespace {
+
+void write_json_string(std::ostream& out, const std::string& value) {
+    static const char hex[] = "0123456789abcdef";
+    out << '"';
+    for (char ch : value) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        switch (c) {
+        case '"': out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\r': out << "\\r"; break;
+        case '\t': out << "\\t"; break;
+        default:
+            if (c < 0x20) {
+                out << "\\u00" << hex[c >> 4] << hex[c & 15];
+            } else {
+                out << ch;
+            }
+        }
+    }
+    out << '"';
+}
+
+// Sample rate of an audio file, read once per file; 0 when it cannot be
+// read
+uint32_t sample_rate_of(std::unordered_map<std::string, uint32_t>& rates, const std::string& path, bool readable) {
+    auto it = rates.find(path);
+    if (it == rates.end()) {
+        TrackMetadata metadata;
+        uint32_t rate = 0;
+        if (readable && read_track_metadata(path, metadata)) {
+            rate = metadata.sample_rate;
+        }
+        it = rates.emplace(path, rate).first;
+    }
+    return it->second;
+}
+
+// Just enough of a JSON reader for the export_json layout; unknown keys
+// are skipped
+class JsonReader {
+public:
+    explicit JsonReader(const std::string& text) : s_(text), pos_(0) {}
+
+    bool consume(char c) {
+        skip_space();
+        if (pos_ < s_.size() && s_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    bool string(std::string& out) {
+        if (!consume('"')) {
+            return false;
+        }
+        out.clear();
+        while (pos_ < s_.size()) {
+            char c = s_[pos_++];
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos_ >= s_.size()) {
+                return false;
+            }
+            switch (s_[pos_++]) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                uint32_t code;
+                if (!hex4(code)) {
+                    return false;
+                }
+                if (code >= 0xD800 && code < 0xDC00) {
+                    uint32_t low;
+                    if (s_.compare(pos_, 2, "\\u") != 0) {
+                        return false;
+                    }
+                    pos_ += 2;
+                    if (!hex4(low) || low < 0xDC00 || low >= 0xE000) {
+                        return false;
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                append_utf8(out, code);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        return false;
+    }
+
+    bool number(uint64_t& out) {
+        skip_space();
+        size_t start = pos_;
+        out = 0;
+        while (pos_ < s_.size() && s_[pos_] >= '0' && s_[pos_] <= '9') {
+            out = out * 10 + static_cast<uint64_t>(s_[pos_++] - '0');
+        }
+        return pos_ > start;
+    }
+
+    bool skip_value() {
+        skip_space();
+        if (pos_ >= s_.size()) {
+            return false;
+        }
+        char c = s_[pos_];
+        if (c == '"') {
+            std::string ignored;
+            return string(ignored);
+        }
+        if (c == '{' || c == '[') {
+            char close = c == '{' ? '}' : ']';
+            ++pos_;
+            if (consume(close)) {
+                return true;
+            }
+            do {
+                if (c == '{') {
+                    std::string key;
+                    if (!string(key) || !consume(':')) {
+                        return false;
+                    }
+                }
+                if (!skip_value()) {
+                    return false;
+                }
+            } while (consume(','));
+            return consume(close);
+        }
+        // Number, true, false or null
+        size_t start = pos_;
+        while (pos_ < s_.size() && (std::isalnum(static_cast<unsigned char>(s_[pos_])) ||
+                                    s_[pos_] == '-' || s_[pos_] == '+' || s_[pos_] == '.')) {
+            ++pos_;
+        }
+        return pos_ > start;
+    }
+
+    // Calls fn(key) for each member of an object; fn reads the value
+    template <typename Fn>
+    bool object(Fn&& fn) {
+        if (!consume('{')) {
+            return false;
+        }
+        if (consume('}')) {
+            return true;
+        }
+        do {
+            std::string key;
+            if (!string(key) || !consume(':') || !fn(key)) {
+                return false;
+            }
+        } while (consume(','));
+        return consume('}');
+    }
+
+private:
+    void skip_space() {
+        while (pos_ < s_.size() && std::isspace(static_cast<unsigned char>(s_[pos_]))) {
+            ++pos_;
+        }
+    }
+
+    bool hex4(uint32_t& out) {
+        if (s_.size() - pos_ < 4) {
+            return false;
+        }
+        out = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = s_[pos_++];
+            out <<= 4;
+            if (c >= '0' && c <= '9') out |= static_cast<uint32_t>(c - '0');
+            else if (c >= 'a' && c <= 'f') out |= static_cast<uint32_t>(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') out |= static_cast<uint32_t>(c - 'A' + 10);
+            else return false;
+        }
+        return true;
+    }
+
+    static void append_utf8(std::string& out, uint32_t code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    const std::string& s_;
+    size_t pos_;
+};
+
+} // namespace
+
 PlaylistManager::PlaylistManager()
-    : next_playlist_id_(1)
+    : store_(new PlaylistStore())
+    , next_playlist_id_(1)
     , initialized_(false) {
 }
 
@@ -43,9 +268,13 @@ Result PlaylistManager::initialize(const char* config_dir) {
     }
     
     // Load existing playlists
-    load_all_playlists();
-    
     initialized_ = true;
+    Result result = load_all_playlists();
+    if (result != Result::Success) {
+        initialized_ = false;
+        return result;
+    }
+    
     return Result::Success;
 }
 
@@ -54,10 +283,12 @@ void PlaylistManager::shutdown() {
         return;
     }
     
-    // Save all playlists before shutdown
+    // Flush the journal before shutdown
     save_all_playlists();
+    store_->close();
     
     playlists_.clear();
+    playlist_index_.clear();
     initialized_ = false;
 }
 
@@ -83,11 +314,11 @@ Result PlaylistManager::create_playlist(const char* name, uint64_t* playlist_id)
     playlist.creation_time = get_current_timestamp();
     playlist.modification_time = playlist.creation_time;
     
+    playlist_index_[playlist.id] = playlists_.size();
     playlists_.push_back(playlist);
     *playlist_id = playlist.id;
     
-    // Save immediately
-    save_playlist(playlist.id);
+    journaled(store_->put_playlist(playlist));
     
     return Result::Success;
 }
@@ -102,20 +333,11 @@ Result PlaylistManager::delete_playlist(uint64_t playlist_id) {
         return Result::InvalidParameter;
     }
     
-    // Delete file from disk
-    namespace fs = std::filesystem;
-    std::string file_path = get_playlist_file_path(playlists_[index]);
-    
-    try {
-        if (fs::exists(file_path)) {
-            fs::remove(file_path);
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "Failed to delete playlist file: " << e.what() << std::endl;
-    }
-    
-    // Remove from memory
     playlists_.erase(playlists_.begin() + index);
+    playlist_index_.erase(playlist_id);
+    reindex(index);
+    
+    journaled(store_->erase_playlist(playlist_id));
     
     return Result::Success;
 }
@@ -134,28 +356,12 @@ Result PlaylistManager::rename_playlist(uint64_t playlist_id, const char* new_na
         return Result::InvalidParameter;
     }
     
-    // Delete old file
-    namespace fs = std::filesystem;
-    std::string old_path = get_playlist_file_path(playlists_[index]);
-    
-    // Update name
     playlists_[index].name = new_name;
     playlists_[index].modification_time = get_current_timestamp();
     
-    // Save with new name
-    Result result = save_playlist(playlist_id);
-    
-    // Delete old file if it exists and is different
-    try {
-        std::string new_path = get_playlist_file_path(playlists_[index]);
-        if (old_path != new_path && fs::exists(old_path)) {
-            fs::remove(old_path);
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "Failed to remove old playlist file: " << e.what() << std::endl;
-    }
+    journaled(store_->put_playlist(playlists_[index]));
     
-    return result;
+    return Result::Success;
 }
 
 const Playlist* PlaylistManager::get_playlist(uint64_t playlist_id) const {
@@ -183,8 +389,11 @@ Result PlaylistManager::add_track(uint64_t playlist_id, const char* file_path) {
     TrackReference track(file_path);
     track.added_time = get_current_timestamp();
     
-    playlists_[index].tracks.push_back(track);
-    playlists_[index].modification_time = track.added_time;
+    auto& playlist = playlists_[index];
+    playlist.tracks.push_back(track);
+    playlist.modification_time = track.added_time;
+    
+    journaled(store_->insert_tracks(playlist_id, track.added_time, playlist.tracks.size() - 1, &track, 1));
     
     return Result::Success;
 }
@@ -204,17 +413,53 @@ Result PlaylistManager::add_tracks(uint64_t playlist_id, const char** file_paths
     }
     
     uint64_t current_time = get_current_timestamp();
+    auto& tracks = playlists_[index].tracks;
+    size_t first = tracks.size();
     
     for (size_t i = 0; i < count; ++i) {
         if (file_paths[i]) {
             TrackReference track(file_paths[i]);
             track.added_time = current_time;
-            playlists_[index].tracks.push_back(track);
+            tracks.push_back(track);
         }
     }
     
     playlists_[index].modification_time = current_time;
     
+    journaled(store_->insert_tracks(playlist_id, current_time, first, tracks.data() + first,
+                                    tracks.size() - first));
+    
+    return Result::Success;
+}
+
+Result PlaylistManager::add_tracks(uint64_t playlist_id, const std::vector<TrackReference>& new_tracks) {
+    if (!initialized_) {
+        return Result::NotInitialized;
+    }
+    
+    if (new_tracks.empty()) {
+        return Result::InvalidParameter;
+    }
+    
+    int index = find_playlist_index(playlist_id);
+    if (index < 0) {
+        return Result::InvalidParameter;
+    }
+    
+    uint64_t current_time = get_current_timestamp();
+    auto& tracks = playlists_[index].tracks;
+    size_t first = tracks.size();
+    
+    tracks.insert(tracks.end(), new_tracks.begin(), new_tracks.end());
+    for (size_t i = first; i < tracks.size(); ++i) {
+        tracks[i].added_time = current_time;
+    }
+    
+    playlists_[index].modification_time = current_time;
+    
+    journaled(store_->insert_tracks(playlist_id, current_time, first, tracks.data() + first,
+                                    tracks.size() - first));
+    
     return Result::Success;
 }
 
@@ -235,6 +480,8 @@ Result PlaylistManager::remove_track(uint64_t playlist_id, size_t index_to_remov
     playlists_[index].tracks.erase(playlists_[index].tracks.begin() + index_to_remove);
     playlists_[index].modification_time = get_current_timestamp();
     
+    journaled(store_->remove_tracks(playlist_id, playlists_[index].modification_time, index_to_remove, 1));
+    
     return Result::Success;
 }
 
@@ -261,6 +508,7 @@ Result PlaylistManager::remove_tracks_by_path(uint64_t playlist_id, const char*
     if (new_end != tracks.end()) {
         tracks.erase(new_end, tracks.end());
         playlists_[index].modification_time = get_current_timestamp();
+        journaled(store_->remove_path(playlist_id, playlists_[index].modification_time, file_path));
     }
     
     return Result::Success;
@@ -276,9 +524,12 @@ Result PlaylistManager::clear_playlist(uint64_t playlist_id) {
         return Result::InvalidParameter;
     }
     
+    size_t count = playlists_[index].tracks.size();
     playlists_[index].tracks.clear();
     playlists_[index].modification_time = get_current_timestamp();
     
+    journaled(store_->remove_tracks(playlist_id, playlists_[index].modification_time, 0, count));
+    
     return Result::Success;
 }
 
@@ -302,6 +553,7 @@ Result PlaylistManager::move_track(uint64_t playlist_id, size_t from_index, size
         return Result::Success;
     }
     
+    size_t to_requested = to_index;
     TrackReference track = tracks[from_index];
     tracks.erase(tracks.begin() + from_index);
     
@@ -312,6 +564,8 @@ Result PlaylistManager::move_track(uint64_t playlist_id, size_t from_index, size
     tracks.insert(tracks.begin() + to_index, track);
     playlists_[index].modification_time = get_current_timestamp();
     
+    journaled(store_->move_track(playlist_id, playlists_[index].modification_time, from_index, to_requested));
+    
     return Result::Success;
 }
 
@@ -358,24 +612,12 @@ Result PlaylistManager::save_playlist(uint64_t playlist_id) {
         return Result::NotInitialized;
     }
     
-    int index = find_playlist_index(playlist_id);
-    if (index < 0) {
+    if (find_playlist_index(playlist_id) < 0) {
         return Result::InvalidParameter;
     }
     
-    std::string json = serialize_playlist(playlists_[index]);
-    std::string file_path = get_playlist_file_path(playlists_[index]);
-    
-    std::ofstream file(file_path);
-    if (!file.is_open()) {
-        std::cerr << "Failed to save playlist: " << file_path << std::endl;
-        return Result::Error;
-    }
-    
-    file << json;
-    file.close();
-    
-    return Result::Success;
+    // Edits are already in the journal; one flush covers every playlist
+    return save_all_playlists();
 }
 
 Result PlaylistManager::save_all_playlists() {
@@ -383,14 +625,15 @@ Result PlaylistManager::save_all_playlists() {
         return Result::NotInitialized;
     }
     
-    for (const auto& playlist : playlists_) {
-        save_playlist(playlist.id);
+    if (!store_->commit(playlists_)) {
+        std::cerr << "Failed to save playlists to " << config_dir_ << "/playlists" << std::endl;
+        return Result::Error;
     }
     
     return Result::Success;
 }
 
-Result PlaylistManager::load_playlist(const char* file_path) {
+Result PlaylistManager::import_json(const char* file_path) {
     if (!initialized_) {
         return Result::NotInitialized;
     }
@@ -399,7 +642,7 @@ Result PlaylistManager::load_playlist(const char* file_path) {
         return Result::InvalidParameter;
     }
     
-    std::ifstream file(file_path);
+    std::ifstream file(file_path, std::ios::binary);
     if (!file.is_open()) {
         return Result::FileNotFound;
     }
@@ -414,21 +657,52 @@ Result PlaylistManager::load_playlist(const char* file_path) {
         return Result::InvalidFormat;
     }
     
-    // Check if playlist with same ID already exists
-    if (find_playlist_index(playlist.id) >= 0) {
-        return Result::AlreadyInitialized;
+    // Keep the ID unless another playlist has it
+    if (playlist.id == 0 || find_playlist_index(playlist.id) >= 0) {
+        playlist.id = generate_playlist_id();
+    } else if (playlist.id >= next_playlist_id_) {
+        next_playlist_id_ = playlist.id + 1;
     }
     
-    playlists_.push_back(playlist);
+    playlist_index_[playlist.id] = playlists_.size();
+    playlists_.push_back(std::move(playlist));
     
-    // Update next ID if needed
-    if (playlist.id >= next_playlist_id_) {
-        next_playlist_id_ = playlist.id + 1;
+    const Playlist& added = playlists_.back();
+    bool ok = store_->put_playlist(added);
+    if (!added.tracks.empty()) {
+        ok = store_->insert_tracks(added.id, added.modification_time, 0, added.tracks.data(),
+                                   added.tracks.size()) && ok;
     }
+    journaled(ok);
     
     return Result::Success;
 }
 
+Result PlaylistManager::export_json(uint64_t playlist_id, const char* file_path) {
+    if (!initialized_) {
+        return Result::NotInitialized;
+    }
+    
+    if (!file_path) {
+        return Result::InvalidParameter;
+    }
+    
+    int index = find_playlist_index(playlist_id);
+    if (index < 0) {
+        return Result::InvalidParameter;
+    }
+    
+    std::ofstream file(file_path, std::ios::binary);
+    if (!file.is_open()) {
+        return Result::Error;
+    }
+    
+    file << serialize_playlist(playlists_[index]);
+    file.close();
+    
+    return file.good() ? Result::Success : Result::Error;
+}
+
 Result PlaylistManager::load_all_playlists() {
     if (!initialized_) {
         return Result::NotInitialized;
@@ -436,74 +710,169 @@ Result PlaylistManager::load_all_playlists() {
     
     namespace fs = std::filesystem;
     std::string playlists_dir = config_dir_ + "/playlists";
+    std::string store_path = playlists_dir + "/playlists.db";
     
-    try {
-        if (!fs::exists(playlists_dir) || !fs::is_directory(playlists_dir)) {
-            return Result::Success; // No playlists directory yet
+    std::error_code ec;
+    bool migrate = !fs::exists(store_path, ec);
+    
+    if (!store_->open(store_path, playlists_)) {
+        std::cerr << "Failed to open playlist store: " << store_path << std::endl;
+        return Result::Error;
+    }
+    
+    reindex();
+    for (const auto& playlist : playlists_) {
+        if (playlist.id >= next_playlist_id_) {
+            next_playlist_id_ = playlist.id + 1;
         }
-        
+    }
+    
+    if (!migrate) {
+        return Result::Success;
+    }
+    
+    // First run with a store: bring in the JSON files older versions saved
+    try {
+        std::vector<std::string> legacy;
         for (const auto& entry : fs::directory_iterator(playlists_dir)) {
-            if (entry.is_regular_file()) {
-                std::string ext = entry.path().extension().string();
-                if (ext == ".json") {
-                    load_playlist(entry.path().string().c_str());
-                }
+            if (entry.is_regular_file() && entry.path().extension() == ".json") {
+                legacy.push_back(entry.path().string());
             }
         }
+        std::sort(legacy.begin(), legacy.end());
+        for (const auto& path : legacy) {
+            import_json(path.c_str());
+        }
     } catch (const std::exception& e) {
         std::cerr << "Error loading playlists: " << e.what() << std::endl;
         return Result::Error;
     }
     
-    return Result::Success;
+    return save_all_playlists();
+}
+
+Result PlaylistManager::import_playlist(const char* file_path, const char* playlist_name,
+                                        uint64_t* playlist_id, PlaylistImportStats* stats) {
+    if (!file_path) {
+        return Result::InvalidParameter;
+    }
+    
+    PlaylistFormat format = playlist_format_for(file_path);
+    if (format == PlaylistFormat::Unknown) {
+        return Result::NotSupported;
+    }
+    
+    return import_file(format, file_path, playlist_name, playlist_id, stats);
+}
+
+Result PlaylistManager::export_playlist(uint64_t playlist_id, const char* file_path) {
+    if (!file_path) {
+        return Result::InvalidParameter;
+    }
+    
+    PlaylistFormat format = playlist_format_for(file_path);
+    if (format == PlaylistFormat::Unknown) {
+        return Result::NotSupported;
+    }
+    
+    return export_file(format, playlist_id, file_path);
 }
 
 Result PlaylistManager::import_m3u(const char* file_path, const char* playlist_name) {
+    if (!playlist_name) {
+        return Result::InvalidParameter;
+    }
+    
+    return import_file(PlaylistFormat::M3U, file_path, playlist_name, nullptr, nullptr);
+}
+
+Result PlaylistManager::export_m3u(uint64_t playlist_id, const char* file_path) {
+    return export_file(PlaylistFormat::M3U, playlist_id, file_path);
+}
+
+Result PlaylistManager::import_file(PlaylistFormat format, const char* file_path, const char* playlist_name,
+                                    uint64_t* playlist_id, PlaylistImportStats* stats) {
     if (!initialized_) {
         return Result::NotInitialized;
     }
     
-    if (!file_path || !playlist_name) {
+    if (!file_path) {
         return Result::InvalidParameter;
     }
     
-    std::ifstream file(file_path);
+    std::ifstream file(file_path, std::ios::binary);
     if (!file.is_open()) {
         return Result::FileNotFound;
     }
     
-    uint64_t playlist_id;
-    Result result = create_playlist(playlist_name, &playlist_id);
-    if (result != Result::Success) {
-        return result;
-    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    file.close();
     
-    int playlist_index = find_playlist_index(playlist_id);
-    if (playlist_index < 0) {
-        return Result::Error;
+    std::vector<PlaylistEntry> entries;
+    if (!parse_playlist(format, buffer.str(), entries)) {
+        return Result::InvalidFormat;
     }
     
-    std::string line;
-    while (std::getline(file, line)) {
-        // Skip empty lines and comments
-        if (line.empty() || line[0] == '#') {
-            continue;
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::path source = fs::absolute(fs::u8path(file_path), ec);
+    std::string name = playlist_name ? std::string(playlist_name) : source.stem().u8string();
+    
+    // Every location in one batch, so directories are listed once each.
+    // The listings are only trusted for this import.
+    std::vector<std::string> locations;
+    locations.reserve(entries.size());
+    for (const auto& entry : entries) {
+        locations.push_back(entry.location);
+    }
+    PathResolver resolver;
+    std::vector<ResolvedPath> resolved = resolver.resolve(locations, source.parent_path().u8string());
+    
+    PlaylistImportStats found;
+    std::vector<TrackReference> tracks;
+    tracks.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const PlaylistEntry& entry = entries[i];
+        TrackReference track(resolved[i].path);
+        if (!resolved[i].exists) {
+            ++found.missing;
         }
         
-        // Add track
-        TrackReference track(line);
-        track.added_time = get_current_timestamp();
-        playlists_[playlist_index].tracks.push_back(track);
+        // CUE positions stay in CD frames; the engine converts them with
+        // the rate of the stream it opens, so the file need not be readable
+        track.range_start = entry.start;
+        track.range_end = entry.end;
+        if (entry.cd_frames && (entry.start > 0 || entry.end > 0)) {
+            track.range_rate = 75;
+            ++found.sub_tracks;
+        }
+        tracks.push_back(std::move(track));
     }
+    found.entries = tracks.size();
     
-    file.close();
-    playlists_[playlist_index].modification_time = get_current_timestamp();
-    save_playlist(playlist_id);
+    uint64_t new_id;
+    Result result = create_playlist(name.c_str(), &new_id);
+    if (result != Result::Success) {
+        return result;
+    }
     
-    return Result::Success;
+    // One journal record for the whole file
+    if (!tracks.empty()) {
+        result = add_tracks(new_id, tracks);
+    }
+    
+    if (playlist_id) {
+        *playlist_id = new_id;
+    }
+    if (stats) {
+        *stats = found;
+    }
+    
+    return result;
 }
 
-Result PlaylistManager::export_m3u(uint64_t playlist_id, const char* file_path) {
+Result PlaylistManager::export_file(PlaylistFormat format, uint64_t playlist_id, const char* file_path) {
     if (!initialized_) {
         return Result::NotInitialized;
     }
@@ -517,20 +886,49 @@ Result PlaylistManager::export_m3u(uint64_t playlist_id, const char* file_path)
         return Result::InvalidParameter;
     }
     
-    std::ofstream file(file_path);
-    if (!file.is_open()) {
-        return Result::Error;
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    std::string base = fs::absolute(fs::u8path(file_path), ec).parent_path().lexically_normal().generic_u8string();
+    if (!base.empty() && base.back() != '/') {
+        base += '/';
     }
     
-    file << "#EXTM3U" << std::endl;
-    
+    std::unordered_map<std::string, uint32_t> sample_rates;
+    std::vector<PlaylistEntry> entries;
+    entries.reserve(playlists_[index].tracks.size());
     for (const auto& track : playlists_[index].tracks) {
-        file << track.file_path << std::endl;
+        PlaylistEntry entry;
+        entry.location = track.file_path;
+        if (!is_url(entry.location) && entry.location.compare(0, base.size(), base) == 0) {
+            entry.location.erase(0, base.size());
+        }
+        
+        if (format == PlaylistFormat::CUE && (track.range_start > 0 || track.range_end > 0)) {
+            // To CD frames; a range in samples needs the file's rate
+            uint64_t rate = track.range_rate;
+            if (rate == 0) {
+                rate = sample_rate_of(sample_rates, track.file_path, !is_url(track.file_path));
+            }
+            if (rate == 0) {
+                std::cerr << "Cannot export range of unreadable file: " << track.file_path << std::endl;
+                return Result::Error;
+            }
+            entry.cd_frames = true;
+            entry.start = (track.range_start * 75 + rate / 2) / rate;
+            entry.end = (track.range_end * 75 + rate / 2) / rate;
+        }
+        entries.push_back(std::move(entry));
+    }
+    
+    std::ofstream file(file_path, std::ios::binary);
+    if (!file.is_open()) {
+        return Result::Error;
     }
     
+    file << write_playlist(format, entries);
     file.close();
     
-    return Result::Success;
+    return file.good() ? Result::Success : Result::Error;
 }
 
 uint64_t PlaylistManager::generate_playlist_id() {
@@ -544,12 +942,24 @@ uint64_t PlaylistManager::get_current_timestamp() const {
 }
 
 int PlaylistManager::find_playlist_index(uint64_t playlist_id) const {
-    for (size_t i = 0; i < playlists_.size(); ++i) {
-        if (playlists_[i].id == playlist_id) {
-            return static_cast<int>(i);
-        }
+    auto it = playlist_index_.find(playlist_id);
+    return it == playlist_index_.end() ? -1 : static_cast<int>(it->second);
+}
+
+void PlaylistManager::reindex(size_t first) {
+    if (first == 0) {
+        playlist_index_.clear();
+        playlist_index_.reserve(playlists_.size());
+    }
+    for (size_t i = first; i < playlists_.size(); ++i) {
+        playlist_index_[playlists_[i].id] = i;
+    }
+}
+
+void PlaylistManager::journaled(bool ok) {
+    if (!ok || !store_->commit(playlists_)) {
+        std::cerr << "Failed to journal playlist edit in " << config_dir_ << "/playlists" << std::endl;
     }
-    return -1;
 }
 
 std::string PlaylistManager::serialize_playlist(const Playlist& playlist) const {
@@ -557,7 +967,9 @@ std::string PlaylistManager::serialize_playlist(const Playlist& playlist) const
     
     json << "{\n";
     json << "  \"id\": " << playlist.id << ",\n";
-    json << "  \"name\": \"" << playlist.name << "\",\n";
+    json << "  \"name\": ";
+    write_json_string(json, playlist.name);
+    json << ",\n";
     json << "  \"creation_time\": " << playlist.creation_time << ",\n";
     json << "  \"modification_time\": " << playlist.modification_time << ",\n";
     json << "  \"tracks\": [\n";
@@ -565,9 +977,17 @@ std::string PlaylistManager::serialize_playlist(const Playlist& playlist) const
     for (size_t i = 0; i < playlist.tracks.size(); ++i) {
         const auto& track = playlist.tracks[i];
         json << "    {\n";
-        json << "      \"file_path\": \"" << track.file_path << "\",\n";
+        json << "      \"file_path\": ";
+        write_json_string(json, track.file_path);
+        json << ",\n";
         json << "      \"metadata_hash\": " << track.metadata_hash << ",\n";
-        json << "      \"added_time\": " << track.added_time << "\n";
+        json << "      \"added_time\": " << track.added_time;
+        if (track.range_start > 0 || track.range_end > 0) {
+            json << ",\n      \"range_start\": " << track.range_start;
+            json << ",\n      \"range_end\": " << track.range_end;
+            json << ",\n      \"range_rate\": " << track.range_rate;
+        }
+        json << "\n";
         json << "    }";
         
         if (i < playlist.tracks.size() - 1) {
@@ -583,76 +1003,74 @@ std::string PlaylistManager::serialize_playlist(const Playlist& playlist) const
 }
 
 bool PlaylistManager::deserialize_playlist(const std::string& json, Playlist& playlist) const {
-    // Simple JSON parser for playlist format
-    // This is a basic implementation - for production use, consider a proper JSON library
+    JsonReader reader(json);
+    bool has_name = false;
     
-    try {
-        size_t pos = 0;
-        
-        // Parse ID
-        pos = json.find("\"id\":", pos);
-        if (pos == std::string::npos) return false;
-        pos += 5;
-        playlist.id = std::stoull(json.substr(pos));
-        
-        // Parse name
-        pos = json.find("\"name\":", pos);
-        if (pos == std::string::npos) return false;
-        pos = json.find("\"", pos + 7) + 1;
-        size_t end = json.find("\"", pos);
-        playlist.name = json.substr(pos, end - pos);
-        
-        // Parse creation_time
-        pos = json.find("\"creation_time\":", pos);
-        if (pos == std::string::npos) return false;
-        pos += 16;
-        playlist.creation_time = std::stoull(json.substr(pos));
-        
-        // Parse modification_time
-        pos = json.find("\"modification_time\":", pos);
-        if (pos == std::string::npos) return false;
-        pos += 20;
-        playlist.modification_time = std::stoull(json.substr(pos));
-        
-        // Parse tracks array
-        pos = json.find("\"tracks\":", pos);
-        if (pos == std::string::npos) return false;
+    bool ok = reader.object([&](const std::string& key) {
+        if (key == "id") {
+            return reader.number(playlist.id);
+        }
+        if (key == "name") {
+            has_name = true;
+            return reader.string(playlist.name);
+        }
+        if (key == "creation_time") {
+            return reader.number(playlist.creation_time);
+        }
+        if (key == "modification_time") {
+            return reader.number(playlist.modification_time);
+        }
+        if (key != "tracks") {
+            return reader.skip_value();
+        }
         
-        // Find all track objects
-        while (true) {
-            pos = json.find("\"file_path\":", pos);
-            if (pos == std::string::npos) break;
-            
+        if (!reader.consume('[')) {
+            return false;
+        }
+        if (reader.consume(']')) {
+            return true;
+        }
+        do {
             TrackReference track;
-            
-            pos = json.find("\"", pos + 12) + 1;
-            end = json.find("\"", pos);
-            track.file_path = json.substr(pos, end - pos);
-            
-            pos = json.find("\"metadata_hash\":", pos);
-            if (pos != std::string::npos) {
-                pos += 16;
-                track.metadata_hash = std::stoull(json.substr(pos));
-            }
-            
-            pos = json.find("\"added_time\":", pos);
-            if (pos != std::string::npos) {
-                pos += 13;
-                track.added_time = std::stoull(json.substr(pos));
+            bool track_ok = reader.object([&](const std::string& field) {
+                if (field == "file_path") {
+                    return reader.string(track.file_path);
+                }
+                if (field == "metadata_hash") {
+                    return reader.number(track.metadata_hash);
+                }
+                if (field == "added_time") {
+                    return reader.number(track.added_time);
+                }
+                if (field == "range_start") {
+                    return reader.number(track.range_start);
+                }
+                if (field == "range_end") {
+                    return reader.number(track.range_end);
+                }
+                if (field == "range_rate") {
+                    uint64_t rate;
+                    if (!reader.number(rate) || rate > UINT32_MAX) {
+                        return false;
+                    }
+                    track.range_rate = static_cast<uint32_t>(rate);
+                    return true;
+                }
+                return reader.skip_value();
+            });
+            if (!track_ok) {
+                return false;
             }
-            
-            playlist.tracks.push_back(track);
-        }
-        
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "Failed to parse playlist JSON: " << e.what() << std::endl;
+            playlist.tracks.push_back(std::move(track));
+        } while (reader.consume(','));
+        return reader.consume(']');
+    });
+    
+    if (!ok || !has_name) {
+        std::cerr << "Failed to parse playlist JSON" << std::endl;
         return false;
     }
-}
-
-std::string PlaylistManager::get_playlist_file_path(const Playlist& playlist) const {
-    return config_dir_ + "/playlists/" + playlist.name + ".json";
+    return true;
 }
 
 }} // namespace mp::core
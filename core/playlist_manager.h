@@ -6,6 +6,7 @@
 #include <cstdint>
 #include <memory>
 #include <functional>
+#include <unordered_map>
 
 namespace mp {
 namespace core {
@@ -15,10 +16,13 @@ struct TrackReference {
     std::string file_path;          // Absolute path to audio file
     uint64_t metadata_hash;         // Hash of cached metadata
     uint64_t added_time;            // Timestamp when added (seconds since epoch)
+    uint64_t range_start;           // Sub-track of the file (CUE), as TrackRange:
+    uint64_t range_end;             // in 1/range_rate seconds, or samples when
+    uint32_t range_rate;            // range_rate is 0; 0/0 is the whole file
     
-    TrackReference() : metadata_hash(0), added_time(0) {}
+    TrackReference() : metadata_hash(0), added_time(0), range_start(0), range_end(0), range_rate(0) {}
     TrackReference(const std::string& path) 
-        : file_path(path), metadata_hash(0), added_time(0) {}
+        : file_path(path), metadata_hash(0), added_time(0), range_start(0), range_end(0), range_rate(0) {}
 };
 
 // Playlist data structure
@@ -36,7 +40,25 @@ struct Playlist {
 using PlaylistSearchCallback = std::function<bool(const Playlist&)>;
 using TrackSearchCallback = std::function<bool(const TrackReference&)>;
 
+// What import_playlist found in a playlist file
+struct PlaylistImportStats {
+    size_t entries;                 // Tracks added
+    size_t missing;                 // Added although the file is not there
+    size_t sub_tracks;              // CUE tracks, played as ranges of their file
+    
+    PlaylistImportStats() : entries(0), missing(0), sub_tracks(0) {}
+};
+
+class PlaylistStore;
+enum class PlaylistFormat;
+
 // Playlist manager - manages collections of tracks
+//
+// Playlists live in <config_dir>/playlists/playlists.db (see PlaylistStore).
+// Every edit is journaled as it is made, so nothing is lost on a crash and
+// saving never rewrites playlists that did not change. JSON, M3U, PLS,
+// XSPF and CUE files are only read and written by the import and export
+// calls.
 class PlaylistManager {
 public:
     PlaylistManager();
@@ -71,6 +93,9 @@ public:
     // Add multiple tracks to playlist
     Result add_tracks(uint64_t playlist_id, const char** file_paths, size_t count);
     
+    // Add tracks with their sub-track ranges; added_time is set here
+    Result add_tracks(uint64_t playlist_id, const std::vector<TrackReference>& tracks);
+    
     // Remove track from playlist by index
     Result remove_track(uint64_t playlist_id, size_t index);
     
@@ -92,22 +117,39 @@ public:
     // Search tracks in a playlist
     std::vector<size_t> search_tracks(uint64_t playlist_id, TrackSearchCallback callback) const;
     
-    // Save playlist to disk
+    // Flush journaled edits to disk (edits are journaled as they are made)
     Result save_playlist(uint64_t playlist_id);
     
-    // Save all playlists to disk
+    // Flush journaled edits, compacting the store when worthwhile
     Result save_all_playlists();
     
-    // Load playlist from disk
-    Result load_playlist(const char* file_path);
+    // Import a playlist saved by export_json; it keeps its ID unless taken
+    Result import_json(const char* file_path);
+    
+    // Export playlist to JSON
+    Result export_json(uint64_t playlist_id, const char* file_path);
     
-    // Load all playlists from config directory
+    // Load all playlists from the store, importing any legacy per-playlist
+    // JSON files the first time
     Result load_all_playlists();
     
-    // Import M3U playlist
+    // Import an M3U/M3U8, PLS, XSPF or CUE file (by its extension) as a new
+    // playlist, named after the file when playlist_name is null. Locations
+    // are resolved against the file's directory (see PathResolver); entries
+    // whose file is missing are kept and counted in stats. Each CUE track
+    // becomes a range of its file, kept in CD frames.
+    Result import_playlist(const char* file_path, const char* playlist_name,
+                           uint64_t* playlist_id = nullptr, PlaylistImportStats* stats = nullptr);
+    
+    // Export to the format of the file's extension. Tracks under the
+    // file's directory are written relative to it. Only CUE keeps ranges;
+    // one in samples whose file's rate cannot be read is an Error.
+    Result export_playlist(uint64_t playlist_id, const char* file_path);
+    
+    // Import M3U playlist, whatever the extension
     Result import_m3u(const char* file_path, const char* playlist_name);
     
-    // Export playlist to M3U
+    // Export playlist to M3U, whatever the extension
     Result export_m3u(uint64_t playlist_id, const char* file_path);
     
 private:
@@ -120,16 +162,26 @@ private:
     // Find playlist index by ID
     int find_playlist_index(uint64_t playlist_id) const;
     
+    // Rebuild the ID -> index map from position first on
+    void reindex(size_t first = 0);
+    
+    // Flush after an edit; a failure is reported but the edit stands
+    void journaled(bool ok);
+    
+    // import_playlist / export_playlist in the given format
+    Result import_file(PlaylistFormat format, const char* file_path, const char* playlist_name,
+                       uint64_t* playlist_id, PlaylistImportStats* stats);
+    Result export_file(PlaylistFormat format, uint64_t playlist_id, const char* file_path);
+    
     // Serialize playlist to JSON
     std::string serialize_playlist(const Playlist& playlist) const;
     
     // Deserialize playlist from JSON
     bool deserialize_playlist(const std::string& json, Playlist& playlist) const;
     
-    // Get playlist file path
-    std::string get_playlist_file_path(const Playlist& playlist) const;
-    
     std::vector<Playlist> playlists_;
+    std::unordered_map<uint64_t, size_t> playlist_index_;
+    std::unique_ptr<PlaylistStore> store_;
     std::string config_dir_;
     uint64_t next_playlist_id_;
     bool initialized_;
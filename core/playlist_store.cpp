@@ -0,0 +1,455 @@
+﻿#include "playlist_store.h"
+#include "record_log.h"
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+namespace mp {
+namespace core {
+
+namespace {
+
+const char STORE_MAGIC[4] = {'X', 'P', 'L', 'S'};
+const uint32_t STORE_VERSION = 2;        // 2 added RECORD_INSERT_RANGES
+const uint32_t OLDEST_STORE_VERSION = 1; // Opened and upgraded
+const uint64_t MIN_COMPACT_BYTES = 256 * 1024;
+
+// Payloads; "edit" records start with [u64 playlist id][u64 modification time]
+const uint8_t RECORD_STRING = 1;        // Path bytes; ids count up from 0
+const uint8_t RECORD_PLAYLIST = 2;      // [u64 id][u64 created][u64 modified][name]
+const uint8_t RECORD_ERASE = 3;         // [u64 id]
+const uint8_t RECORD_INSERT = 4;        // edit, [u32 index][u32 count], count entries
+const uint8_t RECORD_REMOVE = 5;        // edit, [u32 index][u32 count]
+const uint8_t RECORD_REMOVE_PATH = 6;   // edit, [u32 string id]
+const uint8_t RECORD_MOVE = 7;          // edit, [u32 from][u32 to]
+const uint8_t RECORD_SNAPSHOT = 8;      // Empty; ends the records compact() wrote
+const uint8_t RECORD_INSERT_RANGES = 9; // As RECORD_INSERT, entries with a sub-track range
+
+using record_log::Cursor;
+using record_log::put_value;
+using record_log::put_varint;
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+std::string edit_header(uint64_t playlist_id, uint64_t time) {
+    std::string out;
+    put_value(out, playlist_id);
+    put_value(out, time);
+    return out;
+}
+
+std::string encode_playlist(const Playlist& playlist) {
+    std::string out;
+    put_value(out, playlist.id);
+    put_value(out, playlist.creation_time);
+    put_value(out, playlist.modification_time);
+    record_log::put_string(out, playlist.name);
+    return out;
+}
+
+bool has_ranges(const TrackReference* tracks, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (tracks[i].range_start != 0 || tracks[i].range_end != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Entries are [varint string id][varint metadata hash][zigzag varint added
+// time minus the previous entry's], about four bytes each in practice, and
+// with ranges also [varint start][varint end][varint rate]
+template <typename StringId>
+std::string encode_insert(uint64_t playlist_id, uint64_t time, size_t index,
+                          const TrackReference* tracks, size_t count, bool ranges, StringId&& string_id) {
+    std::string out = edit_header(playlist_id, time);
+    put_value(out, static_cast<uint32_t>(index));
+    put_value(out, static_cast<uint32_t>(count));
+    out.reserve(out.size() + count * 6);
+    uint64_t previous = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t id = string_id(tracks[i].file_path);
+        if (id == UINT32_MAX) {
+            return std::string();
+        }
+        put_varint(out, id);
+        put_varint(out, tracks[i].metadata_hash);
+        put_varint(out, zigzag(static_cast<int64_t>(tracks[i].added_time - previous)));
+        previous = tracks[i].added_time;
+        if (ranges) {
+            put_varint(out, tracks[i].range_start);
+            put_varint(out, tracks[i].range_end);
+            put_varint(out, tracks[i].range_rate);
+        }
+    }
+    return out;
+}
+
+// Replay state: playlists by id, erased ones tombstoned until the end
+struct Replay {
+    std::vector<Playlist>& playlists;
+    std::vector<std::string>& strings;
+    std::unordered_map<uint64_t, size_t> index;
+    std::vector<uint8_t> erased;
+
+    Playlist* find(uint64_t id) {
+        auto it = index.find(id);
+        return it == index.end() ? nullptr : &playlists[it->second];
+    }
+
+    // Playlist named by an edit record, and the record's time
+    Playlist* edit(Cursor& c, uint64_t& time) {
+        uint64_t id;
+        if (!c.get(id) || !c.get(time)) {
+            return nullptr;
+        }
+        return find(id);
+    }
+
+    bool apply(uint8_t type, Cursor c) {
+        switch (type) {
+        case RECORD_STRING:
+            strings.emplace_back(reinterpret_cast<const char*>(c.p), c.left);
+            return true;
+        case RECORD_PLAYLIST: {
+            Playlist header;
+            if (!c.get(header.id) || !c.get(header.creation_time) || !c.get(header.modification_time) ||
+                !c.get(header.name)) {
+                return false;
+            }
+            Playlist* playlist = find(header.id);
+            if (!playlist) {
+                index[header.id] = playlists.size();
+                playlists.push_back(std::move(header));
+                erased.push_back(0);
+                return true;
+            }
+            playlist->name = std::move(header.name);
+            playlist->creation_time = header.creation_time;
+            playlist->modification_time = header.modification_time;
+            return true;
+        }
+        case RECORD_ERASE: {
+            uint64_t id;
+            auto it = c.get(id) ? index.find(id) : index.end();
+            if (it == index.end()) {
+                return false;
+            }
+            erased[it->second] = 1;
+            playlists[it->second].tracks = std::vector<TrackReference>();
+            index.erase(it);
+            return true;
+        }
+        case RECORD_INSERT:
+        case RECORD_INSERT_RANGES: {
+            uint64_t time;
+            Playlist* playlist = edit(c, time);
+            uint32_t at, count;
+            if (!playlist || !c.get(at) || !c.get(count) || at > playlist->tracks.size() || count > c.left) {
+                return false;
+            }
+            std::vector<TrackReference> added(count);
+            uint64_t previous = 0;
+            for (TrackReference& track : added) {
+                uint64_t id, delta, rate = 0;
+                if (!c.get_varint(id) || id >= strings.size() || !c.get_varint(track.metadata_hash) ||
+                    !c.get_varint(delta)) {
+                    return false;
+                }
+                if (type == RECORD_INSERT_RANGES &&
+                    (!c.get_varint(track.range_start) || !c.get_varint(track.range_end) ||
+                     !c.get_varint(rate) || rate > UINT32_MAX)) {
+                    return false;
+                }
+                track.range_rate = static_cast<uint32_t>(rate);
+                track.file_path = strings[id];
+                track.added_time = previous + static_cast<uint64_t>(unzigzag(delta));
+                previous = track.added_time;
+            }
+            auto& tracks = playlist->tracks;
+            if (at == tracks.size() && tracks.empty()) {
+                tracks = std::move(added);
+            } else {
+                tracks.insert(tracks.begin() + at, std::make_move_iterator(added.begin()),
+                              std::make_move_iterator(added.end()));
+            }
+            playlist->modification_time = time;
+            return true;
+        }
+        case RECORD_REMOVE: {
+            uint64_t time;
+            Playlist* playlist = edit(c, time);
+            uint32_t at, count;
+            if (!playlist || !c.get(at) || !c.get(count) || at > playlist->tracks.size() ||
+                count > playlist->tracks.size() - at) {
+                return false;
+            }
+            auto first = playlist->tracks.begin() + at;
+            playlist->tracks.erase(first, first + count);
+            playlist->modification_time = time;
+            return true;
+        }
+        case RECORD_REMOVE_PATH: {
+            uint64_t time;
+            Playlist* playlist = edit(c, time);
+            uint32_t id;
+            if (!playlist || !c.get(id) || id >= strings.size()) {
+                return false;
+            }
+            const std::string& path = strings[id];
+            auto& tracks = playlist->tracks;
+            tracks.erase(std::remove_if(tracks.begin(), tracks.end(),
+                                        [&](const TrackReference& t) { return t.file_path == path; }),
+                         tracks.end());
+            playlist->modification_time = time;
+            return true;
+        }
+        case RECORD_MOVE: {
+            uint64_t time;
+            Playlist* playlist = edit(c, time);
+            uint32_t from, to;
+            if (!playlist || !c.get(from) || !c.get(to) || from >= playlist->tracks.size() ||
+                to >= playlist->tracks.size()) {
+                return false;
+            }
+            auto& tracks = playlist->tracks;
+            // As PlaylistManager::move_track
+            TrackReference track = std::move(tracks[from]);
+            tracks.erase(tracks.begin() + from);
+            if (to > from) {
+                --to;
+            }
+            tracks.insert(tracks.begin() + to, std::move(track));
+            playlist->modification_time = time;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+};
+
+} // namespace
+
+PlaylistStore::PlaylistStore()
+    : log_(nullptr)
+    , string_count_(0)
+    , snapshot_bytes_(0)
+    , journal_bytes_(0) {
+}
+
+PlaylistStore::~PlaylistStore() {
+    close();
+}
+
+bool PlaylistStore::open(const std::string& path, std::vector<Playlist>& playlists) {
+    close();
+    path_ = path;
+    playlists.clear();
+
+    std::error_code ec;
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    if (!parent.empty()) {
+        std::filesystem::create_directories(parent, ec);
+    }
+
+    Replay replay{playlists, loaded_strings_, {}, {}};
+    uint64_t end = record_log::HEADER_BYTES;
+    bool loaded = record_log::replay(path, STORE_MAGIC, STORE_VERSION, OLDEST_STORE_VERSION,
+                                     [&](uint8_t type, Cursor c) {
+        if (type == RECORD_SNAPSHOT) {
+            snapshot_bytes_ = end + record_log::RECORD_OVERHEAD;
+        } else if (!replay.apply(type, c)) {
+            return false;
+        }
+        end += record_log::RECORD_OVERHEAD + c.left;
+        return true;
+    });
+
+    if (loaded) {
+        size_t kept = 0;
+        for (size_t i = 0; i < playlists.size(); ++i) {
+            if (!replay.erased[i]) {
+                if (kept != i) {
+                    playlists[kept] = std::move(playlists[i]);
+                }
+                ++kept;
+            }
+        }
+        playlists.resize(kept);
+        string_count_ = static_cast<uint32_t>(loaded_strings_.size());
+        journal_bytes_ = end - std::max<uint64_t>(snapshot_bytes_, record_log::HEADER_BYTES);
+    } else {
+        // Missing or unreadable: keep what was there and start a fresh log
+        playlists.clear();
+        loaded_strings_.clear();
+        snapshot_bytes_ = 0;
+        if (!record_log::set_aside(path) || !record_log::create(path, STORE_MAGIC, STORE_VERSION)) {
+            return false;
+        }
+    }
+
+    log_ = fopen(path.c_str(), "ab");
+    return log_ != nullptr;
+}
+
+void PlaylistStore::close() {
+    if (log_) {
+        fclose(log_);
+        log_ = nullptr;
+    }
+    string_ids_.clear();
+    loaded_strings_.clear();
+    string_count_ = 0;
+    snapshot_bytes_ = 0;
+    journal_bytes_ = 0;
+}
+
+bool PlaylistStore::append(uint8_t type, const std::string& payload) {
+    if (!log_) {
+        return false;
+    }
+    std::string record = record_log::encode(type, payload);
+    if (fwrite(record.data(), 1, record.size(), log_) != record.size()) {
+        return false;
+    }
+    journal_bytes_ += record.size();
+    return true;
+}
+
+uint32_t PlaylistStore::intern(const std::string& path) {
+    if (!loaded_strings_.empty()) {
+        string_ids_.reserve(loaded_strings_.size());
+        for (uint32_t i = 0; i < loaded_strings_.size(); ++i) {
+            string_ids_.emplace(std::move(loaded_strings_[i]), i);
+        }
+        loaded_strings_ = std::vector<std::string>();
+    }
+    auto it = string_ids_.find(path);
+    if (it != string_ids_.end()) {
+        return it->second;
+    }
+    if (string_count_ == UINT32_MAX || !append(RECORD_STRING, path)) {
+        return UINT32_MAX;
+    }
+    string_ids_.emplace(path, string_count_);
+    return string_count_++;
+}
+
+bool PlaylistStore::put_playlist(const Playlist& playlist) {
+    return append(RECORD_PLAYLIST, encode_playlist(playlist));
+}
+
+bool PlaylistStore::erase_playlist(uint64_t playlist_id) {
+    std::string payload;
+    put_value(payload, playlist_id);
+    return append(RECORD_ERASE, payload);
+}
+
+bool PlaylistStore::insert_tracks(uint64_t playlist_id, uint64_t time, size_t index,
+                                  const TrackReference* tracks, size_t count) {
+    if (!log_) {
+        return false;
+    }
+    bool ranges = has_ranges(tracks, count);
+    std::string payload = encode_insert(playlist_id, time, index, tracks, count, ranges,
+                                        [this](const std::string& path) { return intern(path); });
+    return !payload.empty() && append(ranges ? RECORD_INSERT_RANGES : RECORD_INSERT, payload);
+}
+
+bool PlaylistStore::remove_tracks(uint64_t playlist_id, uint64_t time, size_t index, size_t count) {
+    std::string payload = edit_header(playlist_id, time);
+    put_value(payload, static_cast<uint32_t>(index));
+    put_value(payload, static_cast<uint32_t>(count));
+    return append(RECORD_REMOVE, payload);
+}
+
+bool PlaylistStore::remove_path(uint64_t playlist_id, uint64_t time, const std::string& path) {
+    if (!log_) {
+        return false;
+    }
+    uint32_t id = intern(path);
+    if (id == UINT32_MAX) {
+        return false;
+    }
+    std::string payload = edit_header(playlist_id, time);
+    put_value(payload, id);
+    return append(RECORD_REMOVE_PATH, payload);
+}
+
+bool PlaylistStore::move_track(uint64_t playlist_id, uint64_t time, size_t from, size_t to) {
+    std::string payload = edit_header(playlist_id, time);
+    put_value(payload, static_cast<uint32_t>(from));
+    put_value(payload, static_cast<uint32_t>(to));
+    return append(RECORD_MOVE, payload);
+}
+
+bool PlaylistStore::commit(const std::vector<Playlist>& playlists) {
+    if (!log_ || fflush(log_) != 0) {
+        return false;
+    }
+    if (journal_bytes_ >= MIN_COMPACT_BYTES && journal_bytes_ > snapshot_bytes_) {
+        return compact(playlists);
+    }
+    return true;
+}
+
+bool PlaylistStore::compact(const std::vector<Playlist>& playlists) {
+    if (!log_) {
+        return false;
+    }
+
+    std::unordered_map<std::string, uint32_t> ids;
+    uint64_t written = record_log::HEADER_BYTES;
+    bool ok = record_log::rewrite(path_, STORE_MAGIC, STORE_VERSION, log_, [&](FILE* out) {
+        auto write = [&](uint8_t type, const std::string& payload) {
+            std::string record = record_log::encode(type, payload);
+            written += record.size();
+            return fwrite(record.data(), 1, record.size(), out) == record.size();
+        };
+        for (const Playlist& playlist : playlists) {
+            // Strings this playlist is the first to use, then the playlist
+            bool strings_ok = true;
+            bool ranges = has_ranges(playlist.tracks.data(), playlist.tracks.size());
+            std::string insert = encode_insert(playlist.id, playlist.modification_time, 0,
+                                               playlist.tracks.data(), playlist.tracks.size(), ranges,
+                                               [&](const std::string& path) {
+                auto it = ids.find(path);
+                if (it != ids.end()) {
+                    return it->second;
+                }
+                uint32_t id = static_cast<uint32_t>(ids.size());
+                ids.emplace(path, id);
+                if (!write(RECORD_STRING, path)) {
+                    strings_ok = false;
+                }
+                return id;
+            });
+            if (!strings_ok || !write(RECORD_PLAYLIST, encode_playlist(playlist))) {
+                return false;
+            }
+            if (!playlist.tracks.empty() && !write(ranges ? RECORD_INSERT_RANGES : RECORD_INSERT, insert)) {
+                return false;
+            }
+        }
+        return write(RECORD_SNAPSHOT, std::string());
+    });
+    if (!ok) {
+        return false;
+    }
+
+    string_ids_ = std::move(ids);
+    loaded_strings_.clear();
+    string_count_ = static_cast<uint32_t>(string_ids_.size());
+    snapshot_bytes_ = written;
+    journal_bytes_ = 0;
+    return true;
+}
+
+}} // namespace mp::core
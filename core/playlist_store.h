@@ -0,0 +1,77 @@
+﻿#pragma once
+
+#include "playlist_manager.h"
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+// Binary, append-only storage for every playlist, in one file.
+//
+// The file is a record log (see record_log.h). Track paths are interned
+// in a string table shared by all playlists: each distinct path is
+// written once, as a string record, and entries refer to it by number.
+// Every edit is one record naming the playlist and what changed (tracks
+// inserted at an index, a range removed, a move, a rename...), so saving
+// a one-track edit appends a few dozen bytes whatever the playlist sizes.
+// Opening maps the file and replays the records; a torn record at the end
+// is cut off, so a crash loses at most the edit that was being written.
+//
+// Once the edits written since the last snapshot outgrow the snapshot
+// itself, commit() compacts: it writes the current playlists, and only
+// the paths they still use, to a temporary file and renames it over the
+// log.
+//
+// Not thread-safe; PlaylistManager serializes access.
+class PlaylistStore {
+public:
+    PlaylistStore();
+    ~PlaylistStore();
+
+    PlaylistStore(const PlaylistStore&) = delete;
+    PlaylistStore& operator=(const PlaylistStore&) = delete;
+
+    // Open (or create) the store at path and replay it into playlists, in
+    // creation order. A file that cannot be read as a playlist store is
+    // renamed to path + ".bad" and a new store started in its place.
+    bool open(const std::string& path, std::vector<Playlist>& playlists);
+    void close();
+    bool is_open() const { return log_ != nullptr; }
+
+    // Journal an edit already applied to the in-memory playlist; time is
+    // its new modification time
+    bool put_playlist(const Playlist& playlist);         // Created, renamed or retimed
+    bool erase_playlist(uint64_t playlist_id);
+    bool insert_tracks(uint64_t playlist_id, uint64_t time, size_t index,
+                       const TrackReference* tracks, size_t count);
+    bool remove_tracks(uint64_t playlist_id, uint64_t time, size_t index, size_t count);
+    bool remove_path(uint64_t playlist_id, uint64_t time, const std::string& path);
+    bool move_track(uint64_t playlist_id, uint64_t time, size_t from, size_t to);
+
+    // Flush journaled edits; compacts when they outweigh the snapshot
+    bool commit(const std::vector<Playlist>& playlists);
+    bool compact(const std::vector<Playlist>& playlists);
+
+    uint64_t journal_bytes() const { return journal_bytes_; }
+
+private:
+    bool append(uint8_t type, const std::string& payload);
+    uint32_t intern(const std::string& path);
+
+    std::string path_;
+    FILE* log_;
+
+    // Path -> string id, built on the first write after open(); until then
+    // the table replayed from disk is kept as loaded_strings_
+    std::unordered_map<std::string, uint32_t> string_ids_;
+    std::vector<std::string> loaded_strings_;
+    uint32_t string_count_;
+
+    uint64_t snapshot_bytes_;       // Log size after the last compaction
+    uint64_t journal_bytes_;        // Appended since
+};
+
+}} // namespace mp::core
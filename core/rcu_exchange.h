@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include "spsc_ring_buffer.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace mp {
+namespace core {
+
+// Read-copy-update handoff of immutable snapshots to one real-time reader.
+//
+// The writer builds a complete new T and publish()es it; the reader calls
+// acquire() at the start of each block and uses the returned snapshot until
+// its next acquire(). A snapshot the reader moves away from goes back to
+// the writer through a queue and is destroyed by collect(), so the reader
+// never blocks, allocates or frees. Snapshots published faster than the
+// reader picks them up are replaced in place and freed by the writer.
+//
+// One writer thread (or writers serialised by the caller), one reader
+// thread. Published snapshots must not be modified.
+template <typename T>
+class RcuExchange {
+public:
+    RcuExchange()
+        : pending_(nullptr)
+        , retired_(RETIRED_CAPACITY)
+        , current_(nullptr)
+        , latest_(nullptr) {
+    }
+
+    // The reader must have stopped
+    ~RcuExchange() {
+        collect();
+        delete pending_.exchange(nullptr, std::memory_order_acquire);
+        delete current_;
+    }
+
+    RcuExchange(const RcuExchange&) = delete;
+    RcuExchange& operator=(const RcuExchange&) = delete;
+
+    // Writer: makes snapshot the one the reader picks up next
+    void publish(std::unique_ptr<T> snapshot) {
+        collect();
+        latest_ = snapshot.get();
+        // Never seen by the reader, so it can go right away
+        delete pending_.exchange(snapshot.release(), std::memory_order_acq_rel);
+    }
+
+    // Writer: newest published snapshot, the base for the next edit.
+    // Stays valid until the next publish().
+    const T* latest() const { return latest_; }
+
+    // Writer: destroys snapshots the reader has moved away from. publish()
+    // calls this; call it from a timer too if edits are rare.
+    void collect() {
+        T* retired[RETIRED_CAPACITY];
+        size_t count = retired_.read(retired, RETIRED_CAPACITY);
+        for (size_t i = 0; i < count; ++i) {
+            delete retired[i];
+        }
+    }
+
+    // Reader: the snapshot to use for this block; nullptr before the first
+    // publish(). The previous snapshot is handed back to the writer.
+    const T* acquire() {
+        T* next = pending_.exchange(nullptr, std::memory_order_acq_rel);
+        if (next) {
+            // Holds at most the snapshots retired between two publish()
+            // calls, which is one, so this cannot fill up
+            if (current_) {
+                retired_.write(&current_, 1);
+            }
+            current_ = next;
+        }
+        return current_;
+    }
+
+    // Reader: the snapshot from the last acquire()
+    const T* current() const { return current_; }
+
+private:
+    static constexpr size_t RETIRED_CAPACITY = 16;
+
+    std::atomic<T*> pending_;
+    SpscRingBuffer<T*> retired_;
+    T* current_;            // Reader only
+    const T* latest_;       // Writer only
+};
+
+}} // namespace mp::core
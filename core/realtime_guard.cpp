@@ -0,0 +1,205 @@
+﻿#include "realtime_guard.h"
+
+#if MP_REALTIME_CHECKS
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace mp {
+namespace core {
+namespace rt {
+
+namespace {
+
+thread_local int realtime_depth = 0;
+thread_local int suspend_depth = 0;
+thread_local bool reporting = false;
+
+void default_violation_handler(Violation violation, const char* detail) {
+    const char* kind = "lock";
+    if (violation == Violation::HeapAllocation) {
+        kind = "heap allocation";
+    } else if (violation == Violation::HeapDeallocation) {
+        kind = "heap deallocation";
+    }
+
+    std::fprintf(stderr, "[realtime] %s on audio thread: %s\n", kind, detail);
+    assert(false && "real-time violation on audio thread");
+}
+
+std::atomic<ViolationHandler> violation_handler{&default_violation_handler};
+
+} // namespace
+
+void set_violation_handler(ViolationHandler handler) {
+    violation_handler.store(handler ? handler : &default_violation_handler);
+}
+
+bool is_realtime_thread() {
+    return realtime_depth > 0 && suspend_depth == 0;
+}
+
+void check(Violation violation, const char* detail) {
+    if (!is_realtime_thread() || reporting) {
+        return;
+    }
+
+    // Handlers that allocate must not recurse into themselves
+    reporting = true;
+    violation_handler.load()(violation, detail);
+    reporting = false;
+}
+
+void enter_realtime() { ++realtime_depth; }
+void leave_realtime() { --realtime_depth; }
+void suspend_checks() { ++suspend_depth; }
+void resume_checks() { --suspend_depth; }
+
+}}} // namespace mp::core::rt
+
+namespace {
+
+// Over-aligned blocks for the align_val_t overloads; freed by aligned_free
+void* aligned_malloc(std::size_t size, std::align_val_t alignment) {
+    std::size_t align = static_cast<std::size_t>(alignment);
+    if (align < sizeof(void*)) {
+        align = sizeof(void*);
+    }
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, align);
+#else
+    void* ptr = nullptr;
+    return posix_memalign(&ptr, align, size ? size : 1) == 0 ? ptr : nullptr;
+#endif
+}
+
+void aligned_free(void* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+} // namespace
+
+// Global allocation hooks. Only present in debug builds; they forward to
+// malloc/free (posix_memalign or _aligned_malloc when over-aligned) and
+// report any use from inside a RealtimeScope.
+void* operator new(std::size_t size) {
+    mp::core::rt::check(mp::core::rt::Violation::HeapAllocation, "operator new");
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](std::size_t size) {
+    mp::core::rt::check(mp::core::rt::Violation::HeapAllocation, "operator new[]");
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    mp::core::rt::check(mp::core::rt::Violation::HeapAllocation, "operator new(nothrow)");
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    mp::core::rt::check(mp::core::rt::Violation::HeapAllocation, "operator new[](nothrow)");
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* ptr) noexcept {
+    if (ptr) {
+        mp::core::rt::check(mp::core::rt::Violation::HeapDeallocation, "operator delete");
+    }
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    if (ptr) {
+        mp::core::rt::check(mp::core::rt::Violation::HeapDeallocation, "operator delete[]");
+    }
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    operator delete[](ptr);
+}
+
+// Over-aligned types (alignas above the default new alignment) come here
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    mp::core::rt::check(mp::core::rt::Violation::HeapAllocation, "operator new(align_val_t)");
+    void* ptr = aligned_malloc(size, alignment);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    mp::core::rt::check(mp::core::rt::Violation::HeapAllocation, "operator new[](align_val_t)");
+    void* ptr = aligned_malloc(size, alignment);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    mp::core::rt::check(mp::core::rt::Violation::HeapAllocation, "operator new(align_val_t, nothrow)");
+    return aligned_malloc(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    mp::core::rt::check(mp::core::rt::Violation::HeapAllocation, "operator new[](align_val_t, nothrow)");
+    return aligned_malloc(size, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    if (ptr) {
+        mp::core::rt::check(mp::core::rt::Violation::HeapDeallocation, "operator delete(align_val_t)");
+    }
+    aligned_free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    if (ptr) {
+        mp::core::rt::check(mp::core::rt::Violation::HeapDeallocation, "operator delete[](align_val_t)");
+    }
+    aligned_free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+    operator delete(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+    operator delete[](ptr, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    operator delete(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    operator delete[](ptr, alignment);
+}
+
+#endif // MP_REALTIME_CHECKS
@@ -0,0 +1,98 @@
+﻿#pragma once
+
+#include <mutex>
+
+// Real-time safety checks are compiled into debug builds only. Release builds
+// reduce every hook below to an empty inline function.
+#if !defined(NDEBUG) && !defined(MP_DISABLE_REALTIME_CHECKS)
+#define MP_REALTIME_CHECKS 1
+#else
+#define MP_REALTIME_CHECKS 0
+#endif
+
+namespace mp {
+namespace core {
+namespace rt {
+
+// Kind of real-time violation detected on an audio thread
+enum class Violation {
+    HeapAllocation,
+    HeapDeallocation,
+    LockAcquired
+};
+
+// Violation handler (called on the offending thread; must not allocate)
+using ViolationHandler = void (*)(Violation violation, const char* detail);
+
+#if MP_REALTIME_CHECKS
+
+// Install a violation handler (nullptr restores the default, which asserts)
+void set_violation_handler(ViolationHandler handler);
+
+// True while the calling thread is inside a RealtimeScope
+bool is_realtime_thread();
+
+// Report a violation if the calling thread is currently real-time
+void check(Violation violation, const char* detail);
+
+void enter_realtime();
+void leave_realtime();
+void suspend_checks();
+void resume_checks();
+
+#else
+
+inline void set_violation_handler(ViolationHandler) {}
+inline bool is_realtime_thread() { return false; }
+inline void check(Violation, const char*) {}
+inline void enter_realtime() {}
+inline void leave_realtime() {}
+inline void suspend_checks() {}
+inline void resume_checks() {}
+
+#endif
+
+// Marks the current thread as real-time for the lifetime of the scope.
+// In debug builds any heap allocation or CheckedMutex lock taken inside it
+// is reported to the violation handler.
+class RealtimeScope {
+public:
+    RealtimeScope() { enter_realtime(); }
+    ~RealtimeScope() { leave_realtime(); }
+
+    RealtimeScope(const RealtimeScope&) = delete;
+    RealtimeScope& operator=(const RealtimeScope&) = delete;
+};
+
+// Temporarily lifts the checks inside a RealtimeScope for code that is
+// known not to be real-time safe yet
+class NonRealtimeScope {
+public:
+    NonRealtimeScope() { suspend_checks(); }
+    ~NonRealtimeScope() { resume_checks(); }
+
+    NonRealtimeScope(const NonRealtimeScope&) = delete;
+    NonRealtimeScope& operator=(const NonRealtimeScope&) = delete;
+};
+
+// std::mutex that reports being locked from a real-time thread.
+// Drop-in replacement usable with std::lock_guard / std::unique_lock.
+class CheckedMutex {
+public:
+    void lock() {
+        check(Violation::LockAcquired, "CheckedMutex::lock");
+        mutex_.lock();
+    }
+
+    bool try_lock() {
+        check(Violation::LockAcquired, "CheckedMutex::try_lock");
+        return mutex_.try_lock();
+    }
+
+    void unlock() { mutex_.unlock(); }
+
+private:
+    std::mutex mutex_;
+};
+
+}}} // namespace mp::core::rt
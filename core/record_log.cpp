@@ -0,0 +1,175 @@
+﻿#include "record_log.h"
+#include "pcm_file_reader.h"
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace mp {
+namespace core {
+namespace record_log {
+
+namespace {
+
+bool write_header(FILE* out, const char magic[4], uint32_t version) {
+    return fwrite(magic, 1, 4, out) == 4 && fwrite(&version, sizeof(version), 1, out) == 1;
+}
+
+// Flush out through to the disk
+bool sync_file(FILE* out) {
+    if (fflush(out) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(out)) == 0;
+#else
+    return fsync(fileno(out)) == 0;
+#endif
+}
+
+// Make a rename in dir durable; NTFS journals renames itself
+bool sync_directory(const std::filesystem::path& dir) {
+#ifdef _WIN32
+    (void)dir;
+    return true;
+#else
+    int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#endif
+}
+
+} // namespace
+
+std::string encode(uint8_t type, const std::string& payload) {
+    std::string record;
+    record.reserve(payload.size() + RECORD_OVERHEAD);
+    put_value(record, static_cast<uint32_t>(payload.size()));
+    record += static_cast<char>(type);
+    record += payload;
+    put_value(record, fnv1a(reinterpret_cast<const uint8_t*>(record.data()) + 4, payload.size() + 1));
+    return record;
+}
+
+bool create(const std::string& path, const char magic[4], uint32_t version) {
+    FILE* out = fopen(path.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    bool ok = write_header(out, magic, version);
+    return fclose(out) == 0 && ok;
+}
+
+bool set_aside(const std::string& path) {
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) {
+        return !ec;
+    }
+    std::filesystem::rename(path, path + ".bad", ec);
+    return !ec;
+}
+
+bool replay(const std::string& path, const char magic[4], uint32_t version, uint32_t oldest_version,
+            const std::function<bool(uint8_t type, Cursor payload)>& fn) {
+    uint64_t valid_end = 0;
+    uint64_t file_size = 0;
+    uint32_t file_version = 0;
+    {
+        MappedFile map;
+        if (!map.open(path) || map.size() < HEADER_BYTES) {
+            return false;
+        }
+        std::memcpy(&file_version, map.data() + 4, sizeof(file_version));
+        if (std::memcmp(map.data(), magic, 4) != 0 || file_version < oldest_version ||
+            file_version > version) {
+            return false;
+        }
+        map.advise_sequential();
+
+        const uint8_t* data = map.data();
+        file_size = map.size();
+        uint64_t pos = HEADER_BYTES;
+        while (file_size - pos >= RECORD_OVERHEAD) {
+            uint32_t length;
+            std::memcpy(&length, data + pos, sizeof(length));
+            if (file_size - pos - RECORD_OVERHEAD < length) {
+                break;
+            }
+            const uint8_t* body = data + pos + 4;
+            uint32_t checksum;
+            std::memcpy(&checksum, body + 1 + length, sizeof(checksum));
+            if (checksum != fnv1a(body, length + 1) || !fn(body[0], Cursor{body + 1, length})) {
+                break;
+            }
+            pos += RECORD_OVERHEAD + length;
+        }
+        valid_end = pos;
+    }
+
+    // Cut a torn or corrupt tail so appends follow the last good record
+    if (valid_end < file_size) {
+        std::error_code ec;
+        std::filesystem::resize_file(path, valid_end, ec);
+        if (ec) {
+            return false;
+        }
+    }
+
+    // Appends may use records the old version lacks: claim the new one so
+    // that a build that only knows the old format refuses the file
+    if (file_version != version) {
+        FILE* out = fopen(path.c_str(), "r+b");
+        if (!out) {
+            return false;
+        }
+        bool ok = fseek(out, 4, SEEK_SET) == 0 && fwrite(&version, sizeof(version), 1, out) == 1;
+        if (fclose(out) != 0 || !ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool rewrite(const std::string& path, const char magic[4], uint32_t version, FILE*& log,
+             const std::function<bool(FILE* out)>& write_records) {
+    std::string temp_path = path + ".tmp";
+    FILE* out = fopen(temp_path.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    // The data must be on disk before the rename can replace the old log
+    bool ok = write_header(out, magic, version) && write_records(out) && sync_file(out);
+    ok = fclose(out) == 0 && ok;
+
+    std::error_code ec;
+    if (ok) {
+        if (log) {
+            fclose(log);
+        }
+        std::filesystem::rename(temp_path, path, ec);
+        ok = !ec;
+        if (ok) {
+            // Best effort: once renamed, path holds the new log whether or
+            // not this succeeds, so callers must not see it as a failure
+            sync_directory(std::filesystem::path(path).parent_path());
+        }
+        log = fopen(path.c_str(), "ab");
+        ok = ok && log != nullptr;
+    }
+    if (!ok) {
+        std::filesystem::remove(temp_path, ec);
+    }
+    return ok;
+}
+
+} // namespace record_log
+}} // namespace mp::core
@@ -0,0 +1,116 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+
+namespace mp {
+namespace core {
+
+// Framing shared by the append-only stores (MetadataStore, PlaylistStore).
+//
+// A log is an 8-byte header (four magic bytes and a u32 version) followed
+// by records of [u32 payload bytes][u8 type][payload][u32 checksum of
+// type+payload]. Values are stored in native (little-endian) byte order.
+namespace record_log {
+
+const size_t HEADER_BYTES = 8;
+const size_t RECORD_OVERHEAD = 9;
+
+inline uint32_t fnv1a(const uint8_t* data, size_t size, uint32_t hash = 2166136261u) {
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+template <typename T>
+void put_value(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline void put_string(std::string& out, const std::string& value) {
+    put_value(out, static_cast<uint32_t>(value.size()));
+    out += value;
+}
+
+// LEB128
+inline void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+// Bounds-checked reads from a record payload
+struct Cursor {
+    const uint8_t* p;
+    size_t left;
+
+    template <typename T>
+    bool get(T& value) {
+        if (left < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        left -= sizeof(T);
+        return true;
+    }
+
+    bool get(std::string& value) {
+        uint32_t length;
+        if (!get(length) || left < length) {
+            return false;
+        }
+        value.assign(reinterpret_cast<const char*>(p), length);
+        p += length;
+        left -= length;
+        return true;
+    }
+
+    bool get_varint(uint64_t& value) {
+        value = 0;
+        for (unsigned shift = 0; shift < 64 && left > 0; shift += 7) {
+            uint8_t byte = *p++;
+            --left;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+std::string encode(uint8_t type, const std::string& payload);
+
+// Write a fresh log holding only the header
+bool create(const std::string& path, const char magic[4], uint32_t version);
+
+// Rename a file that replay() refused to path + ".bad" (replacing an older
+// one) so that starting a fresh log does not destroy it. True if the file
+// is gone, including when there was none.
+bool set_aside(const std::string& path);
+
+// Map the log and pass each intact record to fn until it returns false,
+// then cut the file after the last record accepted so that appends follow
+// it. A log from oldest_version up to version is accepted, and an older
+// one has its header raised to version. False if the file is missing or
+// has another header.
+bool replay(const std::string& path, const char magic[4], uint32_t version, uint32_t oldest_version,
+            const std::function<bool(uint8_t type, Cursor payload)>& fn);
+
+// Write a new log through write_records to a temporary file, sync it and
+// rename it over path, then sync the directory. log (open for appending to
+// path) is closed for the rename and reopened on the result; on failure
+// path is left as it was.
+bool rewrite(const std::string& path, const char magic[4], uint32_t version, FILE*& log,
+             const std::function<bool(FILE* out)>& write_records);
+
+} // namespace record_log
+
+}} // namespace mp::core
@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <algorithm>
+
+namespace mp {
+namespace core {
+
+// Single-writer sequence lock over a fixed-capacity array of floats.
+//
+// The writer never waits. Readers never block the writer and never take a
+// lock; a read that overlaps a publish is simply retried. Values are kept
+// in relaxed atomics so concurrent reads are well defined.
+class SeqlockBuffer {
+public:
+    explicit SeqlockBuffer(size_t capacity)
+        : capacity_(capacity)
+        , values_(new std::atomic<float>[capacity])
+        , size_(0)
+        , sequence_(0) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            values_[i].store(0.0f, std::memory_order_relaxed);
+        }
+    }
+
+    SeqlockBuffer(const SeqlockBuffer&) = delete;
+    SeqlockBuffer& operator=(const SeqlockBuffer&) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    // Writer: publish count values (clamped to capacity)
+    void write(const float* data, size_t count) {
+        count = std::min(count, capacity_);
+        const uint32_t seq = sequence_.load(std::memory_order_relaxed);
+
+        sequence_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        size_.store(count, std::memory_order_relaxed);
+        for (size_t i = 0; i < count; ++i) {
+            values_[i].store(data[i], std::memory_order_relaxed);
+        }
+
+        sequence_.store(seq + 2, std::memory_order_release);
+    }
+
+    // Reader: copy a consistent snapshot into data (room for capacity()
+    // values). Returns the number of values copied.
+    size_t read(float* data) const {
+        for (;;) {
+            const uint32_t before = sequence_.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();  // Publish in progress
+                continue;
+            }
+
+            const size_t count = size_.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < count; ++i) {
+                data[i] = values_[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == before) {
+                return count;
+            }
+        }
+    }
+
+    // True once anything has been published
+    bool has_data() const {
+        return sequence_.load(std::memory_order_acquire) != 0;
+    }
+
+private:
+    const size_t capacity_;
+    std::unique_ptr<std::atomic<float>[]> values_;
+    std::atomic<size_t> size_;
+    std::atomic<uint32_t> sequence_;
+};
+
+}} // namespace mp::core
@@ -0,0 +1,117 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <algorithm>
+
+namespace mp {
+namespace core {
+
+// Lock-free single-producer/single-consumer ring buffer.
+//
+// One thread may call write(), one other thread may call read()/discard().
+// Both sides are wait-free and never allocate. Capacity is rounded up to a
+// power of two; indices run freely and are masked on access.
+template <typename T>
+class SpscRingBuffer {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "SpscRingBuffer elements are copied with memcpy");
+
+public:
+    explicit SpscRingBuffer(size_t min_capacity)
+        : capacity_(round_up_pow2(min_capacity < 2 ? 2 : min_capacity))
+        , mask_(capacity_ - 1)
+        , data_(new T[capacity_]())
+        , write_index_(0)
+        , read_index_(0) {
+    }
+
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    // Elements ready for the consumer
+    size_t read_available() const {
+        return write_index_.load(std::memory_order_acquire) -
+               read_index_.load(std::memory_order_acquire);
+    }
+
+    // Free space for the producer
+    size_t write_available() const {
+        return capacity_ - read_available();
+    }
+
+    // Producer: copy up to count elements in, returns elements written
+    size_t write(const T* data, size_t count) {
+        const size_t w = write_index_.load(std::memory_order_relaxed);
+        const size_t r = read_index_.load(std::memory_order_acquire);
+        const size_t n = std::min(count, capacity_ - (w - r));
+        if (n == 0) {
+            return 0;
+        }
+
+        const size_t start = w & mask_;
+        const size_t first = std::min(n, capacity_ - start);
+        std::memcpy(data_.get() + start, data, first * sizeof(T));
+        std::memcpy(data_.get(), data + first, (n - first) * sizeof(T));
+
+        write_index_.store(w + n, std::memory_order_release);
+        return n;
+    }
+
+    // Consumer: copy up to count elements out, returns elements read
+    size_t read(T* data, size_t count) {
+        const size_t r = read_index_.load(std::memory_order_relaxed);
+        const size_t w = write_index_.load(std::memory_order_acquire);
+        const size_t n = std::min(count, w - r);
+        if (n == 0) {
+            return 0;
+        }
+
+        const size_t start = r & mask_;
+        const size_t first = std::min(n, capacity_ - start);
+        std::memcpy(data, data_.get() + start, first * sizeof(T));
+        std::memcpy(data + first, data_.get(), (n - first) * sizeof(T));
+
+        read_index_.store(r + n, std::memory_order_release);
+        return n;
+    }
+
+    // Consumer: drop up to count elements, returns elements dropped
+    size_t discard(size_t count) {
+        const size_t r = read_index_.load(std::memory_order_relaxed);
+        const size_t w = write_index_.load(std::memory_order_acquire);
+        const size_t n = std::min(count, w - r);
+        read_index_.store(r + n, std::memory_order_release);
+        return n;
+    }
+
+    // Empty the buffer. Only valid while neither side is running.
+    void reset() {
+        write_index_.store(0, std::memory_order_relaxed);
+        read_index_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static size_t round_up_pow2(size_t n) {
+        size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<T[]> data_;
+
+    // Producer and consumer indices live on separate cache lines
+    alignas(64) std::atomic<size_t> write_index_;
+    alignas(64) std::atomic<size_t> read_index_;
+};
+
+}} // namespace mp::core
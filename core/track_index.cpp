@@ -0,0 +1,623 @@
+﻿#include "track_index.h"
+#include "mp_decoder.h"
+#include <algorithm>
+#include <cctype>
+#include <numeric>
+
+namespace mp {
+namespace core {
+
+namespace {
+
+// Fewer dead rows than this are never worth a compaction
+const size_t MIN_COMPACT_ROWS = 1024;
+
+std::string fold(const std::string& text) {
+    std::string out(text);
+    for (char& c : out) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return out;
+}
+
+uint32_t trigram(const std::string& s, size_t i) {
+    return (static_cast<uint32_t>(static_cast<uint8_t>(s[i])) << 16) |
+           (static_cast<uint32_t>(static_cast<uint8_t>(s[i + 1])) << 8) |
+           static_cast<uint8_t>(s[i + 2]);
+}
+
+std::vector<uint32_t> trigrams_of(const std::string& folded) {
+    std::vector<uint32_t> out;
+    for (size_t i = 0; i + 3 <= folded.size(); ++i) {
+        out.push_back(trigram(folded, i));
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+// Leading decimal digits of text from pos, advancing pos
+uint32_t parse_digits(const std::string& text, size_t& pos, size_t max_digits) {
+    uint32_t value = 0;
+    size_t digits = 0;
+    while (pos < text.size() && digits < max_digits &&
+           std::isdigit(static_cast<unsigned char>(text[pos]))) {
+        value = value * 10 + static_cast<uint32_t>(text[pos] - '0');
+        ++pos;
+        ++digits;
+    }
+    return value;
+}
+
+uint32_t parse_number(const std::string* text) {
+    if (!text) {
+        return 0;
+    }
+    size_t pos = 0;
+    return parse_digits(*text, pos, 9);     // "3/12" -> 3
+}
+
+uint32_t parse_date(const std::string* text) {
+    if (!text) {
+        return 0;
+    }
+    size_t pos = 0;
+    uint32_t year = parse_digits(*text, pos, 4);
+    if (pos != 4) {
+        return 0;
+    }
+    uint32_t month = 0;
+    uint32_t day = 0;
+    if (pos < text->size() && (*text)[pos] == '-') {
+        ++pos;
+        month = parse_digits(*text, pos, 2);
+        if (pos < text->size() && (*text)[pos] == '-') {
+            ++pos;
+            day = parse_digits(*text, pos, 2);
+        }
+    }
+    return year * 10000 + month * 100 + day;
+}
+
+// Stable LSD radix sort of ids by keys (parallel arrays), 8 bits a pass;
+// passes where every key has the same byte are skipped
+void radix_sort(std::vector<uint32_t>& keys, std::vector<TrackId>& ids) {
+    const size_t n = keys.size();
+    std::vector<uint32_t> keys_out(n);
+    std::vector<TrackId> ids_out(n);
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+        size_t counts[256] = {};
+        for (uint32_t key : keys) {
+            ++counts[(key >> shift) & 0xFF];
+        }
+        if (std::find(std::begin(counts), std::end(counts), n) != std::end(counts)) {
+            continue;
+        }
+        size_t offset = 0;
+        for (size_t& count : counts) {
+            size_t c = count;
+            count = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            size_t slot = counts[(keys[i] >> shift) & 0xFF]++;
+            keys_out[slot] = keys[i];
+            ids_out[slot] = ids[i];
+        }
+        keys.swap(keys_out);
+        ids.swap(ids_out);
+    }
+}
+
+} // namespace
+
+TrackQuery& TrackQuery::contains(const std::string& text) {
+    filters_.push_back({Filter::Kind::ContainsAny, TrackField::Title, text, 0, 0});
+    return *this;
+}
+
+TrackQuery& TrackQuery::contains(TrackField field, const std::string& text) {
+    filters_.push_back({Filter::Kind::Contains, field, text, 0, 0});
+    return *this;
+}
+
+TrackQuery& TrackQuery::equals(TrackField field, const std::string& value) {
+    filters_.push_back({Filter::Kind::Equals, field, value, 0, 0});
+    return *this;
+}
+
+TrackQuery& TrackQuery::range(TrackField field, uint32_t min, uint32_t max) {
+    filters_.push_back({Filter::Kind::Range, field, std::string(), min, max});
+    return *this;
+}
+
+TrackQuery& TrackQuery::sort_by(TrackField field, bool descending) {
+    sort_.push_back({field, descending});
+    return *this;
+}
+
+TrackQuery& TrackQuery::limit(size_t count) {
+    limit_ = count;
+    return *this;
+}
+
+TrackIndex::TextColumn::TextColumn()
+    : ranks_valid_(false) {
+    reset();
+}
+
+void TrackIndex::TextColumn::reset() {
+    rows.clear();
+    values_.clear();
+    folded_.clear();
+    codes_.clear();
+    trigrams_.clear();
+    ranks_valid_ = false;
+    intern(std::string());      // Code 0: missing
+}
+
+void TrackIndex::TextColumn::swap(TextColumn& other) {
+    rows.swap(other.rows);
+    values_.swap(other.values_);
+    folded_.swap(other.folded_);
+    codes_.swap(other.codes_);
+    trigrams_.swap(other.trigrams_);
+    ranks_valid_ = false;
+    other.ranks_valid_ = false;
+}
+
+uint32_t TrackIndex::TextColumn::intern(const std::string& value) {
+    const uint32_t code = static_cast<uint32_t>(values_.size());
+    auto inserted = codes_.try_emplace(value, code);
+    if (!inserted.second) {
+        return inserted.first->second;
+    }
+    values_.push_back(value);
+    folded_.push_back(fold(value));
+    for (uint32_t gram : trigrams_of(folded_.back())) {
+        trigrams_[gram].push_back(code);
+    }
+    ranks_valid_ = false;
+    return code;
+}
+
+bool TrackIndex::TextColumn::lookup(const std::string& value, uint32_t& code) const {
+    auto it = codes_.find(value);
+    if (it == codes_.end()) {
+        return false;
+    }
+    code = it->second;
+    return true;
+}
+
+std::vector<uint8_t> TrackIndex::TextColumn::match(const std::string& needle) const {
+    std::vector<uint8_t> flags(values_.size(), 0);
+    if (needle.size() < 3) {
+        for (size_t code = 0; code < folded_.size(); ++code) {
+            flags[code] = folded_[code].find(needle) != std::string::npos;
+        }
+        return flags;
+    }
+
+    // Every match holds all of the needle's trigrams, so the shortest
+    // posting list bounds the candidates; each is then checked in full
+    const std::vector<uint32_t>* shortest = nullptr;
+    for (uint32_t gram : trigrams_of(needle)) {
+        auto it = trigrams_.find(gram);
+        if (it == trigrams_.end()) {
+            return flags;
+        }
+        if (!shortest || it->second.size() < shortest->size()) {
+            shortest = &it->second;
+        }
+    }
+    for (uint32_t code : *shortest) {
+        flags[code] = folded_[code].find(needle) != std::string::npos;
+    }
+    return flags;
+}
+
+const std::vector<uint32_t>& TrackIndex::TextColumn::ranks() const {
+    std::lock_guard<std::mutex> lock(rank_mutex_);
+    if (!ranks_valid_) {
+        std::vector<uint32_t> order(values_.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            int c = folded_[a].compare(folded_[b]);
+            return c != 0 ? c < 0 : values_[a] < values_[b];
+        });
+        ranks_.resize(order.size());
+        for (uint32_t rank = 0; rank < order.size(); ++rank) {
+            ranks_[order[rank]] = rank;
+        }
+        ranks_valid_ = true;
+    }
+    return ranks_;
+}
+
+TrackIndex::TrackIndex()
+    : live_count_(0) {
+}
+
+bool TrackIndex::is_text(TrackField field) {
+    return field <= TrackField::Genre;
+}
+
+const TrackIndex::TextColumn& TrackIndex::text_column(TrackField field) const {
+    switch (field) {
+    case TrackField::Artist: return artist_;
+    case TrackField::AlbumArtist: return album_artist_;
+    case TrackField::Album: return album_;
+    case TrackField::Genre: return genre_;
+    default: return title_;
+    }
+}
+
+const std::vector<uint32_t>& TrackIndex::number_column(TrackField field) const {
+    switch (field) {
+    case TrackField::Date: return date_;
+    case TrackField::TrackNumber: return track_number_;
+    case TrackField::DiscNumber: return disc_number_;
+    case TrackField::SampleRate: return sample_rate_;
+    case TrackField::Channels: return channels_;
+    case TrackField::BitsPerSample: return bits_per_sample_;
+    default: return duration_ms_;
+    }
+}
+
+void TrackIndex::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    paths_.clear();
+    ids_.clear();
+    live_.clear();
+    live_count_ = 0;
+    for (TextColumn* column : {&title_, &artist_, &album_artist_, &album_, &genre_}) {
+        column->reset();
+    }
+    for (auto* column : {&date_, &track_number_, &disc_number_, &duration_ms_,
+                         &sample_rate_, &channels_, &bits_per_sample_}) {
+        column->clear();
+    }
+}
+
+void TrackIndex::build(const MetadataStore& store) {
+    clear();
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    reserve(store.size());
+    store.for_each([this](const TrackMetadata& track) {
+        add_row(track);
+    });
+}
+
+TrackId TrackIndex::add(const TrackMetadata& track) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    return add_row(track);
+}
+
+TrackId TrackIndex::add_row(const TrackMetadata& track) {
+    const TrackId id = static_cast<TrackId>(paths_.size());
+    auto inserted = ids_.try_emplace(track.path, id);
+    if (!inserted.second) {
+        const TrackId existing = inserted.first->second;
+        if (!live_[existing]) {
+            live_[existing] = 1;
+            ++live_count_;
+        }
+        set_row(existing, track);
+        return existing;
+    }
+
+    paths_.push_back(track.path);
+    live_.push_back(1);
+    ++live_count_;
+    for (TextColumn* column : {&title_, &artist_, &album_artist_, &album_, &genre_}) {
+        column->rows.push_back(0);
+    }
+    for (auto* column : {&date_, &track_number_, &disc_number_, &duration_ms_,
+                         &sample_rate_, &channels_, &bits_per_sample_}) {
+        column->push_back(0);
+    }
+    set_row(id, track);
+    return id;
+}
+
+void TrackIndex::reserve(size_t rows) {
+    paths_.reserve(rows);
+    ids_.reserve(rows);
+    live_.reserve(rows);
+    for (TextColumn* column : {&title_, &artist_, &album_artist_, &album_, &genre_}) {
+        column->rows.reserve(rows);
+    }
+    for (auto* column : {&date_, &track_number_, &disc_number_, &duration_ms_,
+                         &sample_rate_, &channels_, &bits_per_sample_}) {
+        column->reserve(rows);
+    }
+}
+
+void TrackIndex::set_row(TrackId id, const TrackMetadata& track) {
+    auto text = [&](TextColumn& column, const std::string* value) {
+        column.rows[id] = value ? column.intern(*value) : 0;
+    };
+    const std::string* artist = track.find(META_ARTIST);
+    const std::string* album_artist = track.find(META_ALBUM_ARTIST);
+    text(title_, track.find(META_TITLE));
+    text(artist_, artist);
+    text(album_artist_, album_artist ? album_artist : artist);
+    text(album_, track.find(META_ALBUM));
+    text(genre_, track.find(META_GENRE));
+
+    date_[id] = parse_date(track.find(META_DATE));
+    track_number_[id] = parse_number(track.find(META_TRACK_NUMBER));
+    disc_number_[id] = parse_number(track.find(META_DISC_NUMBER));
+    duration_ms_[id] = static_cast<uint32_t>(std::min<uint64_t>(track.duration_ms, UINT32_MAX));
+    sample_rate_[id] = track.sample_rate;
+    channels_[id] = track.channels;
+    bits_per_sample_[id] = track.bits_per_sample;
+}
+
+bool TrackIndex::remove(const std::string& path) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = ids_.find(path);
+    if (it == ids_.end() || !live_[it->second]) {
+        return false;
+    }
+    live_[it->second] = 0;
+    --live_count_;
+
+    const size_t dead = live_.size() - live_count_;
+    if (dead >= MIN_COMPACT_ROWS && dead > live_count_) {
+        compact();
+    }
+    return true;
+}
+
+void TrackIndex::compact() {
+    std::vector<std::string> paths;
+    std::vector<uint8_t> live;
+    paths.reserve(live_count_);
+    live.assign(live_count_, 1);
+    ids_.clear();
+    ids_.reserve(live_count_);
+
+    // Re-intern the live rows' strings into fresh dictionaries in row order
+    for (TextColumn* column : {&title_, &artist_, &album_artist_, &album_, &genre_}) {
+        TextColumn compacted;
+        compacted.rows.reserve(live_count_);
+        for (TrackId id = 0; id < live_.size(); ++id) {
+            if (live_[id]) {
+                compacted.rows.push_back(compacted.intern(column->value(column->rows[id])));
+            }
+        }
+        column->swap(compacted);
+    }
+    for (auto* column : {&date_, &track_number_, &disc_number_, &duration_ms_,
+                         &sample_rate_, &channels_, &bits_per_sample_}) {
+        size_t next = 0;
+        for (TrackId id = 0; id < live_.size(); ++id) {
+            if (live_[id]) {
+                (*column)[next++] = (*column)[id];
+            }
+        }
+        column->resize(next);
+        column->shrink_to_fit();
+    }
+    for (TrackId id = 0; id < live_.size(); ++id) {
+        if (live_[id]) {
+            ids_.emplace(paths_[id], static_cast<TrackId>(paths.size()));
+            paths.push_back(std::move(paths_[id]));
+        }
+    }
+    paths_.swap(paths);
+    live_.swap(live);
+}
+
+size_t TrackIndex::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return live_count_;
+}
+
+size_t TrackIndex::dead_rows() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return live_.size() - live_count_;
+}
+
+bool TrackIndex::find(const std::string& path, TrackId& id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = ids_.find(path);
+    if (it == ids_.end() || !live_[it->second]) {
+        return false;
+    }
+    id = it->second;
+    return true;
+}
+
+std::string TrackIndex::path(TrackId id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return paths_[id];
+}
+
+std::string TrackIndex::text(TrackId id, TrackField field) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (!is_text(field)) {
+        return std::to_string(number_column(field)[id]);
+    }
+    const TextColumn& column = text_column(field);
+    return column.value(column.rows[id]);
+}
+
+uint32_t TrackIndex::number(TrackId id, TrackField field) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return is_text(field) ? 0 : number_column(field)[id];
+}
+
+std::vector<TrackId> TrackIndex::filter(const TrackQuery& query) const {
+    // The first filter scans the live rows; later ones narrow its result
+    std::vector<TrackId> ids;
+    bool all = true;
+    auto keep = [&](auto&& pred) {
+        if (all) {
+            for (TrackId id = 0; id < live_.size(); ++id) {
+                if (live_[id] && pred(id)) {
+                    ids.push_back(id);
+                }
+            }
+            all = false;
+        } else {
+            ids.erase(std::remove_if(ids.begin(), ids.end(), [&](TrackId id) { return !pred(id); }),
+                      ids.end());
+        }
+    };
+    auto none = [&] {
+        ids.clear();
+        all = false;
+    };
+
+    for (const TrackQuery::Filter& f : query.filters_) {
+        switch (f.kind) {
+        case TrackQuery::Filter::Kind::ContainsAny: {
+            const std::string needle = fold(f.text);
+            // Columns with no matching string drop out of the row scan
+            const TextColumn* columns[4];
+            std::vector<uint8_t> flags[4];
+            int count = 0;
+            for (const TextColumn* column : {&title_, &artist_, &album_artist_, &album_}) {
+                flags[count] = column->match(needle);
+                if (std::find(flags[count].begin(), flags[count].end(), 1) != flags[count].end()) {
+                    columns[count++] = column;
+                }
+            }
+            keep([&](TrackId id) {
+                for (int c = 0; c < count; ++c) {
+                    if (flags[c][columns[c]->rows[id]]) {
+                        return true;
+                    }
+                }
+                return false;
+            });
+            break;
+        }
+        case TrackQuery::Filter::Kind::Contains: {
+            if (!is_text(f.field)) {
+                none();
+                break;
+            }
+            const TextColumn& column = text_column(f.field);
+            std::vector<uint8_t> flags = column.match(fold(f.text));
+            keep([&](TrackId id) { return flags[column.rows[id]] != 0; });
+            break;
+        }
+        case TrackQuery::Filter::Kind::Equals: {
+            uint32_t code;
+            if (!is_text(f.field) || !text_column(f.field).lookup(f.text, code)) {
+                none();
+                break;
+            }
+            const std::vector<uint32_t>& rows = text_column(f.field).rows;
+            keep([&](TrackId id) { return rows[id] == code; });
+            break;
+        }
+        case TrackQuery::Filter::Kind::Range: {
+            if (is_text(f.field)) {
+                none();
+                break;
+            }
+            const std::vector<uint32_t>& values = number_column(f.field);
+            keep([&](TrackId id) { return values[id] >= f.min && values[id] <= f.max; });
+            break;
+        }
+        }
+        if (!all && ids.empty()) {
+            break;
+        }
+    }
+    if (all) {
+        ids.reserve(live_count_);
+        for (TrackId id = 0; id < live_.size(); ++id) {
+            if (live_[id]) {
+                ids.push_back(id);
+            }
+        }
+    }
+    return ids;
+}
+
+void TrackIndex::sort(std::vector<TrackId>& ids, const std::vector<TrackQuery::SortKey>& keys) const {
+    std::vector<uint32_t> sort_keys(ids.size());
+    for (auto key = keys.rbegin(); key != keys.rend(); ++key) {
+        const std::vector<uint32_t>* values;
+        const std::vector<uint32_t>* ranks = nullptr;
+        if (is_text(key->field)) {
+            values = &text_column(key->field).rows;
+            ranks = &text_column(key->field).ranks();
+        } else {
+            values = &number_column(key->field);
+        }
+        const uint32_t flip = key->descending ? UINT32_MAX : 0;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            uint32_t v = (*values)[ids[i]];
+            sort_keys[i] = (ranks ? (*ranks)[v] : v) ^ flip;
+        }
+        radix_sort(sort_keys, ids);
+    }
+}
+
+std::vector<TrackId> TrackIndex::select(const TrackQuery& query) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<TrackId> ids = filter(query);
+    if (!query.sort_.empty()) {
+        sort(ids, query.sort_);
+    }
+    if (ids.size() > query.limit_) {
+        ids.resize(query.limit_);
+    }
+    return ids;
+}
+
+std::vector<TrackGroup> TrackIndex::group_by(TrackField field, const TrackQuery& query) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<TrackId> ids = filter(query);
+    if (!query.sort_.empty()) {
+        sort(ids, query.sort_);
+    }
+
+    // Group key per row: the dictionary code, or the number itself
+    const bool text = is_text(field);
+    const std::vector<uint32_t>& keys = text ? text_column(field).rows : number_column(field);
+    std::vector<TrackGroup> groups;
+    std::vector<uint32_t> group_keys;
+    std::vector<uint32_t> code_slots(text ? text_column(field).distinct() : 0, UINT32_MAX);
+    std::unordered_map<uint32_t, uint32_t> number_slots;
+    for (TrackId id : ids) {
+        const uint32_t key = keys[id];
+        uint32_t& slot = text ? code_slots[key] : number_slots.try_emplace(key, UINT32_MAX).first->second;
+        if (slot == UINT32_MAX) {
+            slot = static_cast<uint32_t>(groups.size());
+            groups.emplace_back();
+            groups.back().key = text ? text_column(field).value(key) : std::to_string(key);
+            groups.back().value = text ? 0 : key;
+            groups.back().duration_ms = 0;
+            group_keys.push_back(key);
+        }
+        TrackGroup& group = groups[slot];
+        group.tracks.push_back(id);
+        group.duration_ms += duration_ms_[id];
+    }
+
+    std::vector<uint32_t> order(groups.size());
+    std::iota(order.begin(), order.end(), 0);
+    const std::vector<uint32_t>* ranks = text ? &text_column(field).ranks() : nullptr;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        uint32_t ka = ranks ? (*ranks)[group_keys[a]] : group_keys[a];
+        uint32_t kb = ranks ? (*ranks)[group_keys[b]] : group_keys[b];
+        return ka < kb;
+    });
+
+    std::vector<TrackGroup> sorted;
+    sorted.reserve(std::min(order.size(), query.limit_));
+    for (size_t i = 0; i < order.size() && i < query.limit_; ++i) {
+        sorted.push_back(std::move(groups[order[i]]));
+    }
+    return sorted;
+}
+
+}} // namespace mp::core
@@ -0,0 +1,175 @@
+﻿#pragma once
+
+#include "metadata_store.h"
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+using TrackId = uint32_t;
+
+enum class TrackField : uint8_t {
+    // Text, dictionary-encoded
+    Title,
+    Artist,
+    AlbumArtist,        // album_artist, else artist
+    Album,
+    Genre,
+    // Numeric
+    Date,               // YYYYMMDD from the leading "YYYY[-MM[-DD]]", 0 if none
+    TrackNumber,
+    DiscNumber,
+    DurationMs,
+    SampleRate,
+    Channels,
+    BitsPerSample
+};
+
+// Filters (all must match), an optional multi-key sort and a limit
+class TrackQuery {
+public:
+    // Case-insensitive (ASCII) substring of title, artist, album artist or album
+    TrackQuery& contains(const std::string& text);
+    // Case-insensitive substring of one text field
+    TrackQuery& contains(TrackField field, const std::string& text);
+    // Exact value of a text field
+    TrackQuery& equals(TrackField field, const std::string& value);
+    // Numeric field within [min, max]
+    TrackQuery& range(TrackField field, uint32_t min, uint32_t max);
+
+    // Keys in order of significance; text sorts case-insensitively
+    TrackQuery& sort_by(TrackField field, bool descending = false);
+    TrackQuery& limit(size_t count);
+
+private:
+    friend class TrackIndex;
+
+    struct Filter {
+        enum class Kind { Contains, ContainsAny, Equals, Range } kind;
+        TrackField field;
+        std::string text;
+        uint32_t min;
+        uint32_t max;
+    };
+    struct SortKey {
+        TrackField field;
+        bool descending;
+    };
+
+    std::vector<Filter> filters_;
+    std::vector<SortKey> sort_;
+    size_t limit_ = SIZE_MAX;
+};
+
+struct TrackGroup {
+    std::string key;                // Text value, or the number in decimal
+    uint32_t value;                 // Numeric fields only
+    uint64_t duration_ms;
+    std::vector<TrackId> tracks;    // In the query's sort order
+};
+
+// Columnar, in-memory index of the library for search, sort and group-by.
+//
+// Each track is a row id; every field is a dense column indexed by it.
+// Text fields are dictionary-encoded (one uint32 code per row, each
+// distinct string stored once) and each dictionary keeps a posting list
+// of strings per trigram, so a substring query checks only the strings in
+// the shortest list for its trigrams and then scans one code column.
+// Sorting compares integers only: text columns through a collation rank
+// per dictionary entry, rebuilt lazily after changes, and keys are
+// applied as stable LSD radix passes from least to most significant.
+//
+// Rows are added or replaced by path and removed by tombstoning; a path
+// that comes back revives its old row. Once dead rows outnumber the live
+// ones, remove() compacts: live rows are renumbered in order and the
+// dictionaries keep only the strings they still use, so ids from before a
+// remove() may not survive it. Reads are concurrent; writers are exclusive.
+class TrackIndex {
+public:
+    TrackIndex();
+
+    // Replace the contents with every entry in the store
+    void build(const MetadataStore& store);
+
+    // Insert, or replace the row for track.path
+    TrackId add(const TrackMetadata& track);
+    bool remove(const std::string& path);
+    void clear();
+
+    // Live rows
+    size_t size() const;
+    // Removed rows not yet reclaimed by compaction
+    size_t dead_rows() const;
+
+    // Row for path, or false
+    bool find(const std::string& path, TrackId& id) const;
+
+    std::string path(TrackId id) const;
+    std::string text(TrackId id, TrackField field) const;
+    uint32_t number(TrackId id, TrackField field) const;
+
+    std::vector<TrackId> select(const TrackQuery& query) const;
+
+    // Rows matching the query, grouped by field in collation (text) or
+    // numeric order; the query's limit applies to the groups
+    std::vector<TrackGroup> group_by(TrackField field, const TrackQuery& query = TrackQuery()) const;
+
+private:
+    class TextColumn {
+    public:
+        TextColumn();
+        void reset();
+        void swap(TextColumn& other);
+        uint32_t intern(const std::string& value);
+        bool lookup(const std::string& value, uint32_t& code) const;
+        const std::string& value(uint32_t code) const { return values_[code]; }
+        size_t distinct() const { return values_.size(); }
+
+        // Codes whose value contains needle (already folded), one flag each
+        std::vector<uint8_t> match(const std::string& needle) const;
+
+        // Collation rank per code; valid until the next intern()
+        const std::vector<uint32_t>& ranks() const;
+
+        std::vector<uint32_t> rows;         // Code per row
+
+    private:
+        std::vector<std::string> values_;
+        std::vector<std::string> folded_;
+        std::unordered_map<std::string, uint32_t> codes_;
+        std::unordered_map<uint32_t, std::vector<uint32_t>> trigrams_;
+
+        mutable std::mutex rank_mutex_;
+        mutable std::vector<uint32_t> ranks_;
+        mutable bool ranks_valid_;
+    };
+
+    static bool is_text(TrackField field);
+    const TextColumn& text_column(TrackField field) const;
+    const std::vector<uint32_t>& number_column(TrackField field) const;
+
+    void reserve(size_t rows);
+    void compact();
+    TrackId add_row(const TrackMetadata& track);
+    void set_row(TrackId id, const TrackMetadata& track);
+    std::vector<TrackId> filter(const TrackQuery& query) const;
+    void sort(std::vector<TrackId>& ids, const std::vector<TrackQuery::SortKey>& keys) const;
+
+    mutable std::shared_mutex mutex_;
+
+    std::vector<std::string> paths_;
+    std::unordered_map<std::string, TrackId> ids_;    // Dead rows too, for revival
+    std::vector<uint8_t> live_;
+    size_t live_count_;
+
+    TextColumn title_, artist_, album_artist_, album_, genre_;
+    std::vector<uint32_t> date_, track_number_, disc_number_, duration_ms_;
+    std::vector<uint32_t> sample_rate_, channels_, bits_per_sample_;
+};
+
+}} // namespace mp::core
@@ -0,0 +1,488 @@
+﻿#include "track_metadata.h"
+#include "gapless_info.h"
+#include "pcm_file_reader.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace mp {
+namespace core {
+
+namespace {
+
+const size_t OGG_HEADER_BYTES = 64 * 1024;
+const size_t MP3_SCAN_BYTES = 64 * 1024;
+const size_t MAX_TAG_BYTES = 16 * 1024 * 1024;     // Larger ID3/comment blocks are mostly art
+
+uint32_t be32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+uint32_t be24(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+}
+
+uint32_t le32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint32_t syncsafe32(const uint8_t* p) {
+    return ((p[0] & 0x7Fu) << 21) | ((p[1] & 0x7Fu) << 14) | ((p[2] & 0x7Fu) << 7) | (p[3] & 0x7Fu);
+}
+
+std::vector<uint8_t> read_range(std::ifstream& file, uint64_t offset, size_t size) {
+    std::vector<uint8_t> data(size);
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(size));
+    data.resize(static_cast<size_t>(file.gcount()));
+    return data;
+}
+
+void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// Field names as the library stores them
+std::string normalize_key(std::string key) {
+    for (char& c : key) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    if (key == "tracknumber") return "track_number";
+    if (key == "discnumber") return "disc_number";
+    if (key == "albumartist" || key == "album artist") return "album_artist";
+    if (key == "year") return "date";
+    return key;
+}
+
+// Vorbis comment block, shared by FLAC, Ogg Vorbis and Opus (after their
+// packet prefixes)
+void parse_vorbis_comments(const uint8_t* p, size_t size, TrackMetadata& out) {
+    if (size < 8) {
+        return;
+    }
+    size_t pos = 4 + static_cast<size_t>(le32(p));
+    if (pos + 4 > size) {
+        return;
+    }
+    uint32_t count = le32(p + pos);
+    pos += 4;
+    for (uint32_t i = 0; i < count && pos + 4 <= size; ++i) {
+        size_t length = le32(p + pos);
+        pos += 4;
+        if (length > size - pos) {
+            return;
+        }
+        const char* entry = reinterpret_cast<const char*>(p + pos);
+        const char* eq = static_cast<const char*>(std::memchr(entry, '=', length));
+        if (eq) {
+            out.add(normalize_key(std::string(entry, eq)),
+                    std::string(eq + 1, entry + length));
+        }
+        pos += length;
+    }
+}
+
+bool read_flac(std::ifstream& file, TrackMetadata& out) {
+    uint64_t pos = 4;
+    bool have_streaminfo = false;
+    while (true) {
+        std::vector<uint8_t> header = read_range(file, pos, 4);
+        if (header.size() < 4) {
+            break;
+        }
+        const bool last = (header[0] & 0x80) != 0;
+        const uint8_t type = header[0] & 0x7F;
+        const size_t length = be24(header.data() + 1);
+        pos += 4;
+
+        if (type == 0 && length >= 18) {
+            std::vector<uint8_t> si = read_range(file, pos, 18);
+            if (si.size() < 18) {
+                return false;
+            }
+            // rate(20) channels-1(3) bps-1(5) total(36) after 10 bytes of sizes
+            out.sample_rate = (static_cast<uint32_t>(si[10]) << 12) | (si[11] << 4) | (si[12] >> 4);
+            out.channels = static_cast<uint16_t>(((si[12] >> 1) & 7) + 1);
+            out.bits_per_sample = static_cast<uint16_t>((((si[12] & 1) << 4) | (si[13] >> 4)) + 1);
+            out.total_samples = (static_cast<uint64_t>(si[13] & 0x0F) << 32) | be32(si.data() + 14);
+            have_streaminfo = true;
+        } else if (type == 4 && length <= MAX_TAG_BYTES) {
+            std::vector<uint8_t> block = read_range(file, pos, length);
+            parse_vorbis_comments(block.data(), block.size(), out);
+        }
+
+        pos += length;
+        if (last) {
+            break;
+        }
+    }
+    return have_streaminfo;
+}
+
+// First two packets of the first logical stream: identification and comments
+bool read_ogg(std::ifstream& file, TrackMetadata& out) {
+    std::vector<uint8_t> data = read_range(file, 0, OGG_HEADER_BYTES);
+    std::vector<std::vector<uint8_t>> packets(1);
+    size_t pos = 0;
+    while (packets.size() <= 2 && pos + 27 <= data.size() &&
+           std::memcmp(&data[pos], "OggS", 4) == 0) {
+        const uint8_t segments = data[pos + 26];
+        size_t body = pos + 27 + segments;
+        if (body > data.size()) {
+            break;
+        }
+        for (uint8_t s = 0; s < segments && packets.size() <= 2; ++s) {
+            const uint8_t lace = data[pos + 27 + s];
+            if (body + lace > data.size()) {
+                break;
+            }
+            packets.back().insert(packets.back().end(), &data[body], &data[body] + lace);
+            body += lace;
+            if (lace < 255) {
+                packets.emplace_back();
+            }
+        }
+        pos = body;
+    }
+    if (packets.size() < 2) {
+        return false;
+    }
+
+    const std::vector<uint8_t>& id = packets[0];
+    bool opus = false;
+    if (id.size() >= 16 && std::memcmp(id.data(), "\x01vorbis", 7) == 0) {
+        out.channels = id[11];
+        out.sample_rate = le32(&id[12]);
+    } else if (id.size() >= 19 && std::memcmp(id.data(), "OpusHead", 8) == 0) {
+        out.channels = id[9];
+        out.sample_rate = 48000;    // Opus always decodes at 48 kHz
+        opus = true;
+    } else {
+        return false;
+    }
+
+    if (packets.size() > 2) {
+        const std::vector<uint8_t>& comments = packets[1];
+        const size_t prefix = opus ? 8 : 7;
+        const char* magic = opus ? "OpusTags" : "\x03vorbis";
+        if (comments.size() > prefix && std::memcmp(comments.data(), magic, prefix) == 0) {
+            parse_vorbis_comments(comments.data() + prefix, comments.size() - prefix, out);
+        }
+    }
+    return true;
+}
+
+// Text of an ID3v2 text frame body as UTF-8 values (v2.4 separates
+// multiple values with NUL)
+std::vector<std::string> id3_text_values(const uint8_t* p, size_t size) {
+    std::vector<std::string> values(1);
+    if (size == 0) {
+        return {};
+    }
+    const uint8_t encoding = p[0];
+    ++p;
+    --size;
+
+    if (encoding == 1 || encoding == 2) {
+        bool big_endian = encoding == 2;
+        size_t i = 0;
+        auto unit = [&](size_t at) -> uint32_t {
+            return big_endian ? (p[at] << 8 | p[at + 1]) : (p[at + 1] << 8 | p[at]);
+        };
+        for (; i + 1 < size; i += 2) {
+            uint32_t u = unit(i);
+            if (u == 0xFEFF) { continue; }
+            if (u == 0xFFFE) { big_endian = !big_endian; continue; }
+            if (u == 0) { values.emplace_back(); continue; }
+            if (u >= 0xD800 && u < 0xDC00 && i + 3 < size) {
+                uint32_t low = unit(i + 2);
+                u = 0x10000 + ((u - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            }
+            append_utf8(values.back(), u);
+        }
+    } else {
+        for (size_t i = 0; i < size; ++i) {
+            if (p[i] == 0) {
+                values.emplace_back();
+            } else if (encoding == 3) {
+                values.back() += static_cast<char>(p[i]);
+            } else {
+                append_utf8(values.back(), p[i]);      // ISO-8859-1
+            }
+        }
+    }
+
+    while (!values.empty() && values.back().empty()) {
+        values.pop_back();
+    }
+    return values;
+}
+
+const char* id3_frame_key(const std::string& id) {
+    static const struct { const char* v23; const char* v22; const char* key; } map[] = {
+        {"TIT2", "TT2", "title"},       {"TPE1", "TP1", "artist"},
+        {"TPE2", "TP2", "album_artist"}, {"TALB", "TAL", "album"},
+        {"TCON", "TCO", "genre"},       {"TRCK", "TRK", "track_number"},
+        {"TPOS", "TPA", "disc_number"}, {"TYER", "TYE", "date"},
+        {"TDRC", "",    "date"},        {"TCOM", "TCM", "composer"},
+    };
+    for (const auto& entry : map) {
+        if (id == entry.v23 || id == entry.v22) {
+            return entry.key;
+        }
+    }
+    return nullptr;
+}
+
+// Undo ID3 unsynchronisation: FF 00 -> FF
+void remove_unsync(std::vector<uint8_t>& data) {
+    size_t out = 0;
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[out++] = data[i];
+        if (data[i] == 0xFF && i + 1 < data.size() && data[i + 1] == 0x00) {
+            ++i;
+        }
+    }
+    data.resize(out);
+}
+
+void parse_id3v2(std::vector<uint8_t> tag, uint8_t version, uint8_t flags, TrackMetadata& out) {
+    if (version < 4 && (flags & 0x80)) {
+        remove_unsync(tag);
+    }
+    size_t pos = 0;
+    if ((flags & 0x40) && tag.size() >= 4) {
+        // Extended header; v2.4 counts its own size field
+        pos = version == 4 ? syncsafe32(tag.data()) : be32(tag.data()) + 4;
+    }
+
+    const size_t header_size = version == 2 ? 6 : 10;
+    while (pos + header_size <= tag.size() && tag[pos] != 0) {
+        std::string id;
+        size_t frame_size;
+        bool frame_unsync = false;
+        size_t skip = 0;
+        if (version == 2) {
+            id.assign(reinterpret_cast<const char*>(&tag[pos]), 3);
+            frame_size = be24(&tag[pos + 3]);
+        } else {
+            id.assign(reinterpret_cast<const char*>(&tag[pos]), 4);
+            frame_size = version == 4 ? syncsafe32(&tag[pos + 4]) : be32(&tag[pos + 4]);
+            frame_unsync = version == 4 && (tag[pos + 9] & 0x02);
+            skip = version == 4 && (tag[pos + 9] & 0x01) ? 4 : 0;     // Data length indicator
+        }
+        pos += header_size;
+        if (frame_size > tag.size() - pos) {
+            break;
+        }
+
+        if (const char* key = id3_frame_key(id)) {
+            std::vector<uint8_t> body(tag.begin() + pos + std::min(skip, frame_size),
+                                      tag.begin() + pos + frame_size);
+            if (frame_unsync) {
+                remove_unsync(body);
+            }
+            for (const std::string& value : id3_text_values(body.data(), body.size())) {
+                out.add(key, value);
+            }
+        }
+        pos += frame_size;
+    }
+}
+
+void parse_id3v1(const std::vector<uint8_t>& tag, TrackMetadata& out) {
+    auto field = [&](size_t offset, size_t length) {
+        std::string value;
+        for (size_t i = offset; i < offset + length && tag[i] != 0; ++i) {
+            append_utf8(value, tag[i]);
+        }
+        while (!value.empty() && value.back() == ' ') {
+            value.pop_back();
+        }
+        return value;
+    };
+    const std::pair<const char*, std::string> fields[] = {
+        {"title", field(3, 30)}, {"artist", field(33, 30)},
+        {"album", field(63, 30)}, {"date", field(93, 4)},
+    };
+    for (const auto& f : fields) {
+        if (!f.second.empty()) {
+            out.add(f.first, f.second);
+        }
+    }
+    if (tag[125] == 0 && tag[126] != 0) {
+        out.add("track_number", std::to_string(tag[126]));   // ID3v1.1
+    }
+}
+
+bool read_mp3(std::ifstream& file, const std::string& path, uint64_t file_size, TrackMetadata& out) {
+    uint64_t audio_start = 0;
+    std::vector<uint8_t> head = read_range(file, 0, 10);
+    if (head.size() == 10 && std::memcmp(head.data(), "ID3", 3) == 0) {
+        uint32_t tag_size = syncsafe32(head.data() + 6);
+        audio_start = 10 + tag_size + ((head[5] & 0x10) ? 10 : 0);
+        if (tag_size <= MAX_TAG_BYTES && head[3] >= 2 && head[3] <= 4) {
+            parse_id3v2(read_range(file, 10, tag_size), head[3], head[5], out);
+        }
+    }
+
+    // First frame header: MPEG version, rate, channels, bitrate
+    std::vector<uint8_t> data = read_range(file, audio_start, MP3_SCAN_BYTES);
+    size_t pos = 0;
+    for (; pos + 4 <= data.size(); ++pos) {
+        if (data[pos] == 0xFF && (data[pos + 1] & 0xE0) == 0xE0 &&
+            ((data[pos + 1] >> 1) & 3) != 0 && ((data[pos + 2] >> 4) & 0xF) != 0xF &&
+            ((data[pos + 2] >> 2) & 3) != 3) {
+            break;
+        }
+    }
+    if (pos + 4 > data.size()) {
+        return false;
+    }
+    const uint8_t* frame = &data[pos];
+    const int version = (frame[1] >> 3) & 3;    // 3 = MPEG1, 2 = MPEG2, 0 = MPEG2.5
+    const int layer = (frame[1] >> 1) & 3;      // 1 = Layer III
+    static const uint32_t rates[3] = {44100, 48000, 32000};
+    out.sample_rate = rates[(frame[2] >> 2) & 3] >> (version == 3 ? 0 : version == 2 ? 1 : 2);
+    out.channels = ((frame[3] >> 6) & 3) == 3 ? 1 : 2;
+
+    if (file_size >= 128) {
+        std::vector<uint8_t> v1 = read_range(file, file_size - 128, 128);
+        if (v1.size() == 128 && std::memcmp(v1.data(), "TAG", 3) == 0) {
+            if (!out.find("title")) {
+                parse_id3v1(v1, out);
+            }
+            file_size -= 128;
+        }
+    }
+
+    GaplessInfo gapless;
+    if (read_gapless_info(path, gapless) && gapless.total_samples > 0) {
+        uint64_t trim = gapless.encoder_delay + gapless.encoder_padding;
+        out.total_samples = gapless.total_samples > trim ? gapless.total_samples - trim : 0;
+    } else if (layer == 1) {
+        // No frame count: estimate from the first frame's bitrate as if CBR
+        static const uint32_t kbps_v1[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+        static const uint32_t kbps_v2[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0};
+        uint32_t kbps = (version == 3 ? kbps_v1 : kbps_v2)[frame[2] >> 4];
+        uint64_t audio_bytes = file_size > audio_start + pos ? file_size - audio_start - pos : 0;
+        if (kbps > 0) {
+            out.total_samples = audio_bytes * 8 * out.sample_rate / (kbps * 1000ull);
+        }
+    }
+    return true;
+}
+
+bool read_pcm(const std::string& path, TrackMetadata& out) {
+    PcmFileReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+    out.sample_rate = reader.sample_rate();
+    out.channels = reader.channels();
+    out.bits_per_sample = reader.bits_per_sample();
+    out.total_samples = reader.total_frames();
+    return true;
+}
+
+} // namespace
+
+const std::string* TrackMetadata::find(const std::string& key) const {
+    for (const auto& tag : tags) {
+        if (tag.first == key) {
+            return &tag.second;
+        }
+    }
+    return nullptr;
+}
+
+void TrackMetadata::add(const std::string& key, const std::string& value) {
+    tags.emplace_back(key, value);
+}
+
+bool stat_file(const std::string& path, FileStats& stats) {
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(path.c_str(), &st) != 0 || !(st.st_mode & _S_IFREG)) {
+        return false;
+    }
+    stats.mtime_ns = static_cast<int64_t>(st.st_mtime) * 1000000000;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+#ifdef __APPLE__
+    stats.mtime_ns = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    stats.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+    stats.size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+bool read_track_metadata(const std::string& path, TrackMetadata& out) {
+    out = TrackMetadata();
+    out.path = path;
+    if (!stat_file(path, out.stats)) {
+        return false;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    uint8_t magic[12] = {};
+    file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    const size_t got = static_cast<size_t>(file.gcount());
+    if (got < 4) {
+        return false;
+    }
+
+    bool ok = false;
+    if (std::memcmp(magic, "fLaC", 4) == 0) {
+        ok = read_flac(file, out);
+    } else if (std::memcmp(magic, "OggS", 4) == 0) {
+        ok = read_ogg(file, out);
+        GaplessInfo gapless;
+        if (ok && read_gapless_info(path, gapless) && gapless.total_samples > gapless.encoder_delay) {
+            out.total_samples = gapless.total_samples - gapless.encoder_delay;
+        }
+    } else if (got == 12 && (std::memcmp(magic, "RIFF", 4) == 0 || std::memcmp(magic, "RF64", 4) == 0 ||
+                             std::memcmp(magic, "BW64", 4) == 0 || std::memcmp(magic, "FORM", 4) == 0)) {
+        file.close();
+        ok = read_pcm(path, out);
+    } else if (std::memcmp(magic, "ID3", 3) == 0 || (magic[0] == 0xFF && (magic[1] & 0xE0) == 0xE0)) {
+        ok = read_mp3(file, path, out.stats.size, out);
+    }
+
+    if (ok && out.sample_rate > 0) {
+        out.duration_ms = out.total_samples * 1000 / out.sample_rate;
+    }
+    return ok;
+}
+
+}} // namespace mp::core
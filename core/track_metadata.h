@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+// What decides whether a cached entry is still valid
+struct FileStats {
+    uint64_t size;
+    int64_t mtime_ns;       // Modification time, nanoseconds since the epoch
+
+    FileStats() : size(0), mtime_ns(0) {}
+    bool operator==(const FileStats& other) const {
+        return size == other.size && mtime_ns == other.mtime_ns;
+    }
+    bool operator!=(const FileStats& other) const { return !(*this == other); }
+};
+
+// False if the path does not name a readable regular file
+bool stat_file(const std::string& path, FileStats& stats);
+
+// Format and tags of one file as the library stores them
+struct TrackMetadata {
+    std::string path;
+    FileStats stats;
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t bits_per_sample;       // 0 for lossy formats
+    uint64_t total_samples;         // Per channel, 0 if unknown
+    uint64_t duration_ms;
+
+    // Lower-case keys as in mp_decoder.h (META_TITLE, ...); a key may
+    // repeat for multi-value fields, in file order
+    std::vector<std::pair<std::string, std::string>> tags;
+
+    TrackMetadata()
+        : sample_rate(0), channels(0), bits_per_sample(0), total_samples(0), duration_ms(0) {}
+
+    // First value of key, or nullptr
+    const std::string* find(const std::string& key) const;
+    void add(const std::string& key, const std::string& value);
+};
+
+// Read format and tags from the file headers alone, without a decoder:
+//   FLAC:     STREAMINFO and VORBIS_COMMENT
+//   Ogg:      Vorbis/Opus identification and comment headers
+//   MP3:      ID3v2.2-2.4 text frames, first frame header, length from the
+//             Xing/VBRI/iTunSMPB data gapless_info reads (else CBR estimate)
+//   WAV/AIFF: PcmFileReader's format
+// Fills out.path and out.stats too. False if the file cannot be read or is
+// not one of these formats.
+bool read_track_metadata(const std::string& path, TrackMetadata& out);
+
+}} // namespace mp::core
@@ -1,4 +1,6 @@
 ﻿#include "visualization_engine.h"
+#include "realtime_guard.h"
+#include <chrono>
 #include <cmath>
 #include <algorithm>
 #include <limits>
@@ -13,22 +15,19 @@ namespace {
 
 VisualizationEngine::VisualizationEngine()
     : initialized_(false)
+    , waveform_width_(0)
+    , fft_size_(0)
+    , spectrum_bars_(0)
+    , spectrum_smoothing_(0.0f)
+    , dropped_frames_(0)
+    , worker_running_(false)
+    , analysis_sample_rate_(0)
+    , analysis_channels_(0)
     , waveform_write_pos_(0)
-    , rms_buffer_pos_(0)
-    , peak_hold_time_left_(0.0f)
-    , peak_hold_time_right_(0.0f)
+    , spectrum_history_pos_(0)
+    , published_fft_size_(0)
     , current_sample_rate_(0)
     , current_channels_(0) {
-    
-    // Initialize VU meter data
-    vu_data_.peak_left = 0.0f;
-    vu_data_.peak_right = 0.0f;
-    vu_data_.rms_left = 0.0f;
-    vu_data_.rms_right = 0.0f;
-    vu_data_.peak_db_left = MIN_DB;
-    vu_data_.peak_db_right = MIN_DB;
-    vu_data_.rms_db_left = MIN_DB;
-    vu_data_.rms_db_right = MIN_DB;
 }
 
 VisualizationEngine::~VisualizationEngine() {
@@ -41,28 +40,48 @@ Result VisualizationEngine::initialize(const VisualizationConfig& config) {
     }
     
     config_ = config;
+    if (config_.update_rate_hz == 0) {
+        config_.update_rate_hz = 60;
+    }
     
     // Ensure FFT size is power of 2
-    config_.fft_size = next_power_of_two(config_.fft_size);
+    config_.fft_size = std::min(next_power_of_two(std::max(config_.fft_size, 2u)), MAX_FFT_SIZE);
+    config_.waveform_width = std::min(std::max(config_.waveform_width, 1u), MAX_WAVEFORM_WIDTH);
+    config_.spectrum_bars = std::min(config_.spectrum_bars, MAX_SPECTRUM_BARS);
     
-    // Initialize waveform buffer (ring buffer)
-    size_t waveform_samples = static_cast<size_t>(
-        config_.waveform_time_span * 48000.0f * 2); // Assume max 48kHz stereo
-    waveform_buffer_.resize(waveform_samples, 0.0f);
-    waveform_write_pos_ = 0;
+    waveform_width_.store(config_.waveform_width);
+    fft_size_.store(config_.fft_size);
+    spectrum_bars_.store(config_.spectrum_bars);
+    spectrum_smoothing_.store(config_.spectrum_smoothing);
+    
+    // The tap holds several update periods of 8 channels at 192 kHz, and
+    // at least two FFT frames, so a late worker tick does not drop audio
+    size_t tap_frames = std::max<size_t>(
+        2 * static_cast<size_t>(config_.fft_size),
+        4 * 192000 / config_.update_rate_hz);
+    tap_ = std::make_unique<core::SpscRingBuffer<float>>(
+        tap_frames * core::LevelMeter::MAX_CHANNELS);
+    dropped_frames_.store(0);
     
-    // Initialize spectrum buffers
+    drain_buffer_.resize(TAP_HEADER + TAP_BLOCK_FRAMES * core::LevelMeter::MAX_CHANNELS);
+    publish_buffer_.resize(2 * MAX_WAVEFORM_WIDTH);
     spectrum_input_buffer_.resize(config_.fft_size, 0.0f);
-    spectrum_fft_output_.resize(config_.fft_size);
-    spectrum_bar_values_.resize(config_.spectrum_bars, MIN_DB);
-    spectrum_smoothed_bars_.resize(config_.spectrum_bars, MIN_DB);
+    spectrum_fft_ = std::make_unique<core::RealFFT>(config_.fft_size);
+    spectrum_fft_output_.resize(spectrum_fft_->bins());
+    spectrum_bar_values_.assign(config_.spectrum_bars, MIN_DB);
+    spectrum_smoothed_bars_.assign(config_.spectrum_bars, MIN_DB);
+    meter_.set_peak_ballistics(config_.vu_peak_hold_ms, config_.vu_peak_decay_rate);
+    configure_analysis(2, 48000);
     
-    // Initialize VU meter buffers
-    size_t rms_samples = static_cast<size_t>(
-        (config_.vu_rms_window_ms / 1000.0f) * 48000.0f);
-    rms_buffer_left_.resize(rms_samples, 0.0f);
-    rms_buffer_right_.resize(rms_samples, 0.0f);
-    rms_buffer_pos_ = 0;
+    waveform_snapshot_ = std::make_unique<core::SeqlockBuffer>(2 * MAX_WAVEFORM_WIDTH);
+    spectrum_snapshot_ = std::make_unique<core::SeqlockBuffer>(MAX_SPECTRUM_BARS);
+    vu_snapshot_ = std::make_unique<core::SeqlockBuffer>(VU_FIELDS);
+    channel_snapshot_ = std::make_unique<core::SeqlockBuffer>(
+        CHANNEL_FIELDS * core::LevelMeter::MAX_CHANNELS);
+    published_fft_size_.store(config_.fft_size);
+    
+    worker_running_ = true;
+    worker_thread_ = std::thread(&VisualizationEngine::worker_loop, this);
     
     initialized_ = true;
     return Result::Success;
@@ -73,177 +92,354 @@ void VisualizationEngine::shutdown() {
         return;
     }
     
+    initialized_ = false;
+    
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex_);
+        worker_running_ = false;
+    }
+    worker_cv_.notify_all();
+    if (worker_thread_.joinable()) {
+        worker_thread_.join();
+    }
+    
+    tap_.reset();
+    waveform_snapshot_.reset();
+    spectrum_snapshot_.reset();
+    vu_snapshot_.reset();
+    channel_snapshot_.reset();
+    
+    drain_buffer_.clear();
+    publish_buffer_.clear();
     waveform_buffer_.clear();
+    spectrum_history_.clear();
     spectrum_input_buffer_.clear();
+    spectrum_fft_.reset();
     spectrum_fft_output_.clear();
     spectrum_bar_values_.clear();
     spectrum_smoothed_bars_.clear();
-    rms_buffer_left_.clear();
-    rms_buffer_right_.clear();
-    
-    initialized_ = false;
+    meter_.configure(0, 0, 0.0f);
+    analysis_sample_rate_ = 0;
+    analysis_channels_ = 0;
 }
 
 void VisualizationEngine::process_audio(const float* samples, size_t frame_count,
                                        uint16_t channels, uint32_t sample_rate) {
-    if (!initialized_ || !samples || frame_count == 0) {
+    if (!samples || channels == 0) {
         return;
     }
     
-    current_sample_rate_ = sample_rate;
-    current_channels_ = channels;
+    const float* channel_data[core::LevelMeter::MAX_CHANNELS];
+    const uint16_t tap_channels = std::min(channels, core::LevelMeter::MAX_CHANNELS);
+    for (uint16_t ch = 0; ch < tap_channels; ++ch) {
+        channel_data[ch] = samples + ch;
+    }
+    tap_samples(channel_data, channels, frame_count, channels, sample_rate);
+}
+
+void VisualizationEngine::process_audio(const core::AudioFrame& frame) {
+    if (!frame || frame.channels() == 0) {
+        return;
+    }
     
-    // Process waveform data
-    {
-        std::lock_guard<std::mutex> lock(waveform_mutex_);
-        for (size_t i = 0; i < frame_count; ++i) {
-            // Mix to mono for waveform
-            float mono_sample = 0.0f;
-            for (uint16_t ch = 0; ch < channels; ++ch) {
-                mono_sample += samples[i * channels + ch];
-            }
-            mono_sample /= static_cast<float>(channels);
-            
-            waveform_buffer_[waveform_write_pos_] = mono_sample;
-            waveform_write_pos_ = (waveform_write_pos_ + 1) % waveform_buffer_.size();
-        }
+    if (frame.layout() == core::FrameLayout::Interleaved) {
+        process_audio(frame.interleaved(), frame.frames(), frame.channels(), frame.sample_rate());
+        return;
     }
     
-    // Process spectrum data (use first block of audio)
-    {
-        std::lock_guard<std::mutex> lock(spectrum_mutex_);
-        size_t samples_to_copy = std::min(frame_count, spectrum_input_buffer_.size());
+    const float* channel_data[core::LevelMeter::MAX_CHANNELS];
+    const uint16_t tap_channels = std::min(frame.channels(), core::LevelMeter::MAX_CHANNELS);
+    for (uint16_t ch = 0; ch < tap_channels; ++ch) {
+        channel_data[ch] = frame.channel(ch);
+    }
+    tap_samples(channel_data, 1, frame.frames(), frame.channels(), frame.sample_rate());
+}
+
+void VisualizationEngine::tap_samples(const float* const* channel_data, size_t step,
+                                      size_t frame_count, uint16_t channels,
+                                      uint32_t sample_rate) {
+    if (!initialized_ || frame_count == 0) {
+        return;
+    }
+    
+    core::rt::RealtimeScope realtime;
+    
+    current_sample_rate_.store(sample_rate, std::memory_order_relaxed);
+    current_channels_.store(channels, std::memory_order_relaxed);
+    
+    // Copy into the tap in small blocks, each tagged with its format so the
+    // worker can follow format changes exactly. Channels beyond
+    // LevelMeter::MAX_CHANNELS are not analysed.
+    const uint16_t tap_channels = std::min(channels, core::LevelMeter::MAX_CHANNELS);
+    float block[TAP_HEADER + TAP_BLOCK_FRAMES * core::LevelMeter::MAX_CHANNELS];
+    
+    size_t offset = 0;
+    while (offset < frame_count) {
+        size_t frames = std::min<size_t>(TAP_BLOCK_FRAMES, frame_count - offset);
+        size_t block_size = TAP_HEADER + frames * tap_channels;
+        if (tap_->write_available() < block_size) {
+            // Worker fell behind: drop rather than wait
+            dropped_frames_.fetch_add(frame_count - offset, std::memory_order_relaxed);
+            return;
+        }
         
-        for (size_t i = 0; i < samples_to_copy; ++i) {
-            // Mix to mono for spectrum
-            float mono_sample = 0.0f;
-            for (uint16_t ch = 0; ch < channels; ++ch) {
-                mono_sample += samples[i * channels + ch];
+        block[0] = static_cast<float>(tap_channels);
+        block[1] = static_cast<float>(frames);
+        block[2] = static_cast<float>(sample_rate);
+        
+        float* dst = block + TAP_HEADER;
+        for (size_t i = offset; i < offset + frames; ++i) {
+            for (uint16_t ch = 0; ch < tap_channels; ++ch) {
+                *dst++ = channel_data[ch][i * step];
             }
-            mono_sample /= static_cast<float>(channels);
-            spectrum_input_buffer_[i] = mono_sample;
         }
         
-        // Apply Hann window
-        apply_hann_window(spectrum_input_buffer_);
-        
-        // Compute FFT
-        compute_fft(spectrum_input_buffer_, spectrum_fft_output_);
+        tap_->write(block, block_size);
+        offset += frames;
+    }
+}
+
+void VisualizationEngine::worker_loop() {
+    const auto period = std::chrono::microseconds(1000000 / config_.update_rate_hz);
+    auto last_tick = std::chrono::steady_clock::now();
+    
+    std::unique_lock<std::mutex> lock(worker_mutex_);
+    while (worker_running_) {
+        worker_cv_.wait_for(lock, period);
+        if (!worker_running_) {
+            break;
+        }
         
-        // Map FFT to frequency bars
-        map_fft_to_bars(spectrum_fft_output_, spectrum_bar_values_);
+        auto now = std::chrono::steady_clock::now();
+        float elapsed = std::chrono::duration<float>(now - last_tick).count();
+        last_tick = now;
         
-        // Apply smoothing
-        for (size_t i = 0; i < spectrum_bar_values_.size(); ++i) {
-            spectrum_smoothed_bars_[i] = 
-                config_.spectrum_smoothing * spectrum_smoothed_bars_[i] +
-                (1.0f - config_.spectrum_smoothing) * spectrum_bar_values_[i];
-        }
+        lock.unlock();
+        analyze(elapsed);
+        lock.lock();
     }
+}
+
+void VisualizationEngine::configure_analysis(uint16_t channels, uint32_t sample_rate) {
+    analysis_sample_rate_ = sample_rate;
+    analysis_channels_ = channels;
     
-    // Process VU meter data
-    {
-        std::lock_guard<std::mutex> lock(vu_mutex_);
+    // Initialize waveform buffer (ring buffer)
+    size_t waveform_samples = std::max<size_t>(1, static_cast<size_t>(
+        config_.waveform_time_span * static_cast<float>(sample_rate)));
+    waveform_buffer_.assign(waveform_samples, 0.0f);
+    waveform_write_pos_ = 0;
+    
+    // Spectrum history keeps the newest fft_size mono samples
+    spectrum_history_.assign(fft_size_.load(), 0.0f);
+    spectrum_history_pos_ = 0;
+    
+    // Meter windows are sized from the actual rate
+    meter_.configure(channels, sample_rate, config_.vu_rms_window_ms);
+}
+
+void VisualizationEngine::analyze(float elapsed_seconds) {
+    // Apply settings changed since the last tick
+    uint32_t fft_size = fft_size_.load(std::memory_order_relaxed);
+    if (fft_size != spectrum_input_buffer_.size()) {
+        spectrum_history_.assign(fft_size, 0.0f);
+        spectrum_history_pos_ = 0;
+        spectrum_input_buffer_.resize(fft_size, 0.0f);
+        spectrum_fft_ = std::make_unique<core::RealFFT>(fft_size);
+        spectrum_fft_output_.resize(spectrum_fft_->bins());
+    }
+    uint32_t bars = spectrum_bars_.load(std::memory_order_relaxed);
+    if (bars != spectrum_smoothed_bars_.size()) {
+        spectrum_bar_values_.assign(bars, MIN_DB);
+        spectrum_smoothed_bars_.assign(bars, MIN_DB);
+    }
+    
+    // Drain the tap into the analysis rings
+    size_t drained = 0;
+    float header[TAP_HEADER];
+    
+    while (tap_->read(header, TAP_HEADER) == TAP_HEADER) {
+        uint16_t channels = static_cast<uint16_t>(header[0]);
+        size_t frames = static_cast<size_t>(header[1]);
+        uint32_t rate = static_cast<uint32_t>(header[2]);
         
-        float peak_left = 0.0f;
-        float peak_right = 0.0f;
-        float sum_sq_left = 0.0f;
-        float sum_sq_right = 0.0f;
+        // Blocks are written whole, so the payload is already there
+        float* data = drain_buffer_.data();
+        tap_->read(data, frames * channels);
         
-        for (size_t i = 0; i < frame_count; ++i) {
-            float left = samples[i * channels];
-            float right = (channels > 1) ? samples[i * channels + 1] : left;
-            
-            // Peak detection
-            peak_left = std::max(peak_left, std::abs(left));
-            peak_right = std::max(peak_right, std::abs(right));
-            
-            // RMS calculation (store in ring buffer)
-            rms_buffer_left_[rms_buffer_pos_] = left * left;
-            rms_buffer_right_[rms_buffer_pos_] = right * right;
-            rms_buffer_pos_ = (rms_buffer_pos_ + 1) % rms_buffer_left_.size();
+        if (channels != analysis_channels_ || rate != analysis_sample_rate_) {
+            configure_analysis(channels, rate);
         }
         
-        // Calculate RMS
-        for (float val : rms_buffer_left_) sum_sq_left += val;
-        for (float val : rms_buffer_right_) sum_sq_right += val;
+        meter_.process(data, frames);
         
-        float rms_left = std::sqrt(sum_sq_left / rms_buffer_left_.size());
-        float rms_right = std::sqrt(sum_sq_right / rms_buffer_right_.size());
-        
-        // Update peak with hold
-        vu_data_.peak_left = std::max(vu_data_.peak_left, peak_left);
-        vu_data_.peak_right = std::max(vu_data_.peak_right, peak_right);
-        
-        // Update RMS
-        vu_data_.rms_left = rms_left;
-        vu_data_.rms_right = rms_right;
-        
-        // Convert to dB
-        vu_data_.peak_db_left = linear_to_db(vu_data_.peak_left);
-        vu_data_.peak_db_right = linear_to_db(vu_data_.peak_right);
-        vu_data_.rms_db_left = linear_to_db(vu_data_.rms_left);
-        vu_data_.rms_db_right = linear_to_db(vu_data_.rms_right);
+        const float mono_scale = 1.0f / static_cast<float>(channels);
+        for (size_t i = 0; i < frames; ++i) {
+            // Mix to mono for waveform and spectrum
+            float mono_sample = 0.0f;
+            for (uint16_t ch = 0; ch < channels; ++ch) {
+                mono_sample += data[i * channels + ch];
+            }
+            mono_sample *= mono_scale;
+            
+            waveform_buffer_[waveform_write_pos_] = mono_sample;
+            if (++waveform_write_pos_ == waveform_buffer_.size()) {
+                waveform_write_pos_ = 0;
+            }
+            
+            spectrum_history_[spectrum_history_pos_] = mono_sample;
+            if (++spectrum_history_pos_ == spectrum_history_.size()) {
+                spectrum_history_pos_ = 0;
+            }
+        }
+        drained += frames;
     }
-}
-
-WaveformData VisualizationEngine::get_waveform_data() {
-    WaveformData data;
     
-    std::lock_guard<std::mutex> lock(waveform_mutex_);
+    publish_meters(elapsed_seconds);
     
-    data.sample_rate = current_sample_rate_;
-    data.channels = current_channels_;
-    data.time_span_seconds = config_.waveform_time_span;
+    // Waveform and spectrum only change when new audio arrived
+    if (drained > 0 || !waveform_snapshot_->has_data()) {
+        publish_waveform();
+        publish_spectrum();
+    }
+}
+
+void VisualizationEngine::publish_waveform() {
+    uint32_t width = waveform_width_.load(std::memory_order_relaxed);
     
-    // Downsample waveform to pixel width
-    size_t samples_per_pixel = waveform_buffer_.size() / config_.waveform_width;
+    // Downsample waveform to pixel width, oldest sample first
+    size_t samples_per_pixel = waveform_buffer_.size() / width;
     if (samples_per_pixel == 0) samples_per_pixel = 1;
     
-    data.min_values.resize(config_.waveform_width);
-    data.max_values.resize(config_.waveform_width);
+    float* min_values = publish_buffer_.data();
+    float* max_values = publish_buffer_.data() + width;
+    size_t idx = waveform_write_pos_;
     
-    for (uint32_t pixel = 0; pixel < config_.waveform_width; ++pixel) {
+    for (uint32_t pixel = 0; pixel < width; ++pixel) {
         float min_val = std::numeric_limits<float>::max();
         float max_val = std::numeric_limits<float>::lowest();
         
         size_t start_idx = pixel * samples_per_pixel;
-        size_t end_idx = start_idx + samples_per_pixel;
+        size_t end_idx = std::min(start_idx + samples_per_pixel, waveform_buffer_.size());
         
-        for (size_t i = start_idx; i < end_idx && i < waveform_buffer_.size(); ++i) {
-            size_t actual_idx = (waveform_write_pos_ + i) % waveform_buffer_.size();
-            float sample = waveform_buffer_[actual_idx];
+        for (size_t i = start_idx; i < end_idx; ++i) {
+            float sample = waveform_buffer_[idx];
             min_val = std::min(min_val, sample);
             max_val = std::max(max_val, sample);
+            if (++idx == waveform_buffer_.size()) {
+                idx = 0;
+            }
         }
         
-        data.min_values[pixel] = min_val;
-        data.max_values[pixel] = max_val;
+        min_values[pixel] = min_val;
+        max_values[pixel] = max_val;
     }
     
+    waveform_snapshot_->write(publish_buffer_.data(), 2 * static_cast<size_t>(width));
+}
+
+void VisualizationEngine::publish_spectrum() {
+    // Unroll the history ring, oldest sample first
+    size_t N = spectrum_history_.size();
+    for (size_t i = 0; i < N; ++i) {
+        spectrum_input_buffer_[i] = spectrum_history_[(spectrum_history_pos_ + i) % N];
+    }
+    
+    // Apply Hann window
+    apply_hann_window(spectrum_input_buffer_);
+    
+    // Compute FFT
+    spectrum_fft_->forward(spectrum_input_buffer_.data(), spectrum_fft_output_.data());
+    
+    // Map FFT to frequency bars
+    map_fft_to_bars(spectrum_fft_output_, spectrum_bar_values_);
+    
+    // Apply smoothing
+    float smoothing = spectrum_smoothing_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < spectrum_bar_values_.size(); ++i) {
+        spectrum_smoothed_bars_[i] = 
+            smoothing * spectrum_smoothed_bars_[i] +
+            (1.0f - smoothing) * spectrum_bar_values_[i];
+    }
+    
+    spectrum_snapshot_->write(spectrum_smoothed_bars_.data(), spectrum_smoothed_bars_.size());
+    published_fft_size_.store(static_cast<uint32_t>(N), std::memory_order_relaxed);
+}
+
+void VisualizationEngine::publish_meters(float elapsed_seconds) {
+    meter_.update_peaks(elapsed_seconds);
+    
+    float fields[CHANNEL_FIELDS * core::LevelMeter::MAX_CHANNELS];
+    const uint16_t channels = meter_.channels();
+    for (uint16_t ch = 0; ch < channels; ++ch) {
+        core::ChannelLevel level = meter_.level(ch);
+        float* out = fields + ch * CHANNEL_FIELDS;
+        out[0] = level.peak;
+        out[1] = level.true_peak;
+        out[2] = level.rms;
+        out[3] = linear_to_db(level.peak);
+        out[4] = linear_to_db(level.true_peak);
+        out[5] = linear_to_db(level.rms);
+    }
+    channel_snapshot_->write(fields, CHANNEL_FIELDS * static_cast<size_t>(channels));
+    
+    // Stereo VU: mono sources show the same level on both sides
+    core::ChannelLevel left = meter_.level(0);
+    core::ChannelLevel right = channels > 1 ? meter_.level(1) : left;
+    
+    const float vu[VU_FIELDS] = {
+        left.peak, right.peak,
+        left.rms, right.rms,
+        linear_to_db(left.peak), linear_to_db(right.peak),
+        linear_to_db(left.rms), linear_to_db(right.rms)
+    };
+    vu_snapshot_->write(vu, VU_FIELDS);
+}
+
+WaveformData VisualizationEngine::get_waveform_data() {
+    WaveformData data;
+    
+    data.sample_rate = current_sample_rate_.load(std::memory_order_relaxed);
+    data.channels = current_channels_.load(std::memory_order_relaxed);
+    data.time_span_seconds = config_.waveform_time_span;
+    
+    if (!initialized_) {
+        return data;
+    }
+    
+    std::vector<float> snapshot(waveform_snapshot_->capacity());
+    size_t width = waveform_snapshot_->read(snapshot.data()) / 2;
+    
+    data.min_values.assign(snapshot.begin(), snapshot.begin() + width);
+    data.max_values.assign(snapshot.begin() + width, snapshot.begin() + 2 * width);
+    
     return data;
 }
 
 SpectrumData VisualizationEngine::get_spectrum_data() {
     SpectrumData data;
     
-    std::lock_guard<std::mutex> lock(spectrum_mutex_);
-    
-    data.fft_size = config_.fft_size;
-    data.sample_rate = current_sample_rate_;
+    data.fft_size = published_fft_size_.load(std::memory_order_relaxed);
+    data.sample_rate = current_sample_rate_.load(std::memory_order_relaxed);
     data.min_frequency = config_.spectrum_min_freq;
     data.max_frequency = config_.spectrum_max_freq;
     
-    data.magnitudes = spectrum_smoothed_bars_;
+    if (!initialized_) {
+        return data;
+    }
+    
+    data.magnitudes.resize(spectrum_snapshot_->capacity());
+    data.magnitudes.resize(spectrum_snapshot_->read(data.magnitudes.data()));
     
     // Calculate center frequencies for each bar (logarithmic spacing)
-    data.frequencies.resize(config_.spectrum_bars);
+    size_t bars = data.magnitudes.size();
+    data.frequencies.resize(bars);
     float log_min = std::log10(config_.spectrum_min_freq);
     float log_max = std::log10(config_.spectrum_max_freq);
     float log_range = log_max - log_min;
     
-    for (uint32_t i = 0; i < config_.spectrum_bars; ++i) {
-        float t = static_cast<float>(i) / (config_.spectrum_bars - 1);
+    for (size_t i = 0; i < bars; ++i) {
+        float t = bars > 1 ? static_cast<float>(i) / (bars - 1) : 0.0f;
         float log_freq = log_min + t * log_range;
         data.frequencies[i] = std::pow(10.0f, log_freq);
     }
@@ -252,77 +448,70 @@ SpectrumData VisualizationEngine::get_spectrum_data() {
 }
 
 VUMeterData VisualizationEngine::get_vu_meter_data() {
-    std::lock_guard<std::mutex> lock(vu_mutex_);
-    return vu_data_;
+    VUMeterData data;
+    float fields[VU_FIELDS] = {
+        0.0f, 0.0f, 0.0f, 0.0f, MIN_DB, MIN_DB, MIN_DB, MIN_DB
+    };
+    
+    if (initialized_ && vu_snapshot_->has_data()) {
+        vu_snapshot_->read(fields);
+    }
+    
+    data.peak_left = fields[0];
+    data.peak_right = fields[1];
+    data.rms_left = fields[2];
+    data.rms_right = fields[3];
+    data.peak_db_left = fields[4];
+    data.peak_db_right = fields[5];
+    data.rms_db_left = fields[6];
+    data.rms_db_right = fields[7];
+    return data;
+}
+
+std::vector<ChannelMeterData> VisualizationEngine::get_channel_meter_data() {
+    std::vector<ChannelMeterData> meters;
+    if (!initialized_) {
+        return meters;
+    }
+    
+    float fields[CHANNEL_FIELDS * core::LevelMeter::MAX_CHANNELS];
+    size_t count = channel_snapshot_->read(fields) / CHANNEL_FIELDS;
+    
+    meters.resize(count);
+    for (size_t ch = 0; ch < count; ++ch) {
+        const float* in = fields + ch * CHANNEL_FIELDS;
+        meters[ch].peak = in[0];
+        meters[ch].true_peak = in[1];
+        meters[ch].rms = in[2];
+        meters[ch].peak_db = in[3];
+        meters[ch].true_peak_db = in[4];
+        meters[ch].rms_db = in[5];
+    }
+    return meters;
 }
 
 void VisualizationEngine::set_waveform_width(uint32_t width) {
+    width = std::min(std::max(width, 1u), MAX_WAVEFORM_WIDTH);
     config_.waveform_width = width;
+    waveform_width_.store(width);
 }
 
 void VisualizationEngine::set_fft_size(uint32_t size) {
-    std::lock_guard<std::mutex> lock(spectrum_mutex_);
-    config_.fft_size = next_power_of_two(size);
-    spectrum_input_buffer_.resize(config_.fft_size, 0.0f);
-    spectrum_fft_output_.resize(config_.fft_size);
+    size = std::min(next_power_of_two(std::max(size, 2u)), MAX_FFT_SIZE);
+    config_.fft_size = size;
+    fft_size_.store(size);
 }
 
 void VisualizationEngine::set_spectrum_bars(uint32_t bars) {
-    std::lock_guard<std::mutex> lock(spectrum_mutex_);
+    bars = std::min(bars, MAX_SPECTRUM_BARS);
     config_.spectrum_bars = bars;
-    spectrum_bar_values_.resize(bars, MIN_DB);
-    spectrum_smoothed_bars_.resize(bars, MIN_DB);
+    spectrum_bars_.store(bars);
 }
 
 void VisualizationEngine::set_spectrum_smoothing(float smoothing) {
-    config_.spectrum_smoothing = std::max(0.0f, std::min(1.0f, smoothing));
-}
-
-// FFT implementation (Cooley-Tukey radix-2 DIT)
-void VisualizationEngine::compute_fft(const std::vector<float>& input,
-                                      std::vector<std::complex<float>>& output) {
-    size_t N = input.size();
-    output.resize(N);
-    
-    // Convert input to complex
-    for (size_t i = 0; i < N; ++i) {
-        output[i] = std::complex<float>(input[i], 0.0f);
-    }
-    
-    // Bit-reversal permutation
-    for (size_t i = 0; i < N; ++i) {
-        size_t j = 0;
-        size_t k = i;
-        size_t m = N / 2;
-        
-        while (m >= 1) {
-            j = (j << 1) | (k & 1);
-            k >>= 1;
-            m >>= 1;
-        }
-        
-        if (j > i) {
-            std::swap(output[i], output[j]);
-        }
-    }
-    
-    // FFT computation
-    for (size_t s = 1; s <= std::log2(N); ++s) {
-        size_t m = static_cast<size_t>(1) << s;
-        size_t m2 = m >> 1;
-        std::complex<float> w(1.0f, 0.0f);
-        std::complex<float> wm = std::exp(std::complex<float>(0.0f, -2.0f * PI / m));
-        
-        for (size_t j = 0; j < m2; ++j) {
-            for (size_t k = j; k < N; k += m) {
-                std::complex<float> t = w * output[k + m2];
-                std::complex<float> u = output[k];
-                output[k] = u + t;
-                output[k + m2] = u - t;
-            }
-            w *= wm;
-        }
-    }
+    smoothing = std::max(0.0f, std::min(1.0f, smoothing));
+    config_.spectrum_smoothing = smoothing;
+    spectrum_smoothing_.store(smoothing);
 }
 
 void VisualizationEngine::apply_hann_window(std::vector<float>& samples) {
@@ -335,12 +524,12 @@ void VisualizationEngine::apply_hann_window(std::vector<float>& samples) {
 
 void VisualizationEngine::map_fft_to_bars(const std::vector<std::complex<float>>& fft_output,
                                           std::vector<float>& bar_magnitudes) {
-    if (current_sample_rate_ == 0) {
+    if (analysis_sample_rate_ == 0 || bar_magnitudes.empty()) {
         return;
     }
     
-    size_t fft_bins = fft_output.size() / 2; // Only use positive frequencies
-    float bin_frequency = static_cast<float>(current_sample_rate_) / fft_output.size();
+    size_t fft_bins = fft_output.size() - 1; // Bins 0..N/2, skip Nyquist
+    float bin_frequency = static_cast<float>(analysis_sample_rate_) / (2 * fft_bins);
     
     // Logarithmic frequency mapping
     float log_min = std::log10(config_.spectrum_min_freq);
@@ -348,7 +537,8 @@ void VisualizationEngine::map_fft_to_bars(const std::vector<std::complex<float>>
     float log_range = log_max - log_min;
     
     for (size_t bar = 0; bar < bar_magnitudes.size(); ++bar) {
-        float t = static_cast<float>(bar) / (bar_magnitudes.size() - 1);
+        float t = bar_magnitudes.size() > 1
+            ? static_cast<float>(bar) / (bar_magnitudes.size() - 1) : 0.0f;
         float log_freq = log_min + t * log_range;
         float center_freq = std::pow(10.0f, log_freq);
         
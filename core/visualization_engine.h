@@ -2,9 +2,18 @@
 #define VISUALIZATION_ENGINE_H
 
 #include "mp_types.h"
+#include "spsc_ring_buffer.h"
+#include "seqlock.h"
+#include "fft.h"
+#include "level_meter.h"
+#include "audio_frame.h"
 #include <vector>
 #include <complex>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <memory>
 #include <cstdint>
 
 namespace mp {
@@ -39,6 +48,15 @@ struct VUMeterData {
     float rms_db_right;
 };
 
+struct ChannelMeterData {
+    float peak;                     // Held sample peak (0.0 - 1.0)
+    float true_peak;                // Held inter-sample peak, may exceed 1.0
+    float rms;                      // RMS level (0.0 - 1.0)
+    float peak_db;
+    float true_peak_db;             // dBTP
+    float rms_db;
+};
+
 // Visualization engine configuration
 struct VisualizationConfig {
     // Waveform settings
@@ -54,12 +72,16 @@ struct VisualizationConfig {
     
     // VU meter settings
     float vu_peak_decay_rate;       // Peak decay in dB/second
+    float vu_peak_hold_ms;          // Peak hold before decay starts
     float vu_rms_window_ms;         // RMS averaging window in ms
     
     // General settings
     uint32_t update_rate_hz;        // Update rate (Hz)
 };
 
+// Audio thread pushes samples through a wait-free tap; a worker thread
+// analyses them at update_rate_hz and publishes seqlock snapshots, so
+// neither the audio thread nor the UI ever waits on analysis.
 class VisualizationEngine {
 public:
     VisualizationEngine();
@@ -69,14 +91,19 @@ public:
     Result initialize(const VisualizationConfig& config);
     void shutdown();
     
-    // Audio data input (called from audio thread)
+    // Audio data input (called from audio thread; wait-free, drops samples
+    // if the worker falls behind)
     void process_audio(const float* samples, size_t frame_count, 
                       uint16_t channels, uint32_t sample_rate);
     
-    // Data retrieval (called from UI thread)
+    // Same for a pipeline frame in either layout, read in place
+    void process_audio(const core::AudioFrame& frame);
+    
+    // Data retrieval (called from UI thread; never blocks)
     WaveformData get_waveform_data();
     SpectrumData get_spectrum_data();
     VUMeterData get_vu_meter_data();
+    std::vector<ChannelMeterData> get_channel_meter_data();  // One per input channel
     
     // Configuration updates
     void set_waveform_width(uint32_t width);
@@ -85,9 +112,13 @@ public:
     void set_spectrum_smoothing(float smoothing);
     
 private:
-    // FFT implementation (Cooley-Tukey algorithm)
-    void compute_fft(const std::vector<float>& input, 
-                     std::vector<std::complex<float>>& output);
+    // Analysis worker
+    void worker_loop();
+    void analyze(float elapsed_seconds);
+    void configure_analysis(uint16_t channels, uint32_t sample_rate);
+    void publish_waveform();
+    void publish_spectrum();
+    void publish_meters(float elapsed_seconds);
     
     // Window functions
     void apply_hann_window(std::vector<float>& samples);
@@ -101,34 +132,66 @@ private:
     float db_to_linear(float db);
     uint32_t next_power_of_two(uint32_t n);
     
+    // Copy into the tap; channel ch of frame i is at channel_data[ch][i * step]
+    void tap_samples(const float* const* channel_data, size_t step, size_t frame_count,
+                     uint16_t channels, uint32_t sample_rate);
+    
     // Configuration
     VisualizationConfig config_;
-    bool initialized_;
-    
-    // Waveform data
-    std::vector<float> waveform_buffer_;  // Ring buffer for waveform
+    std::atomic<bool> initialized_;
+    
+    // Settings changed from the UI thread, picked up by the worker
+    std::atomic<uint32_t> waveform_width_;
+    std::atomic<uint32_t> fft_size_;
+    std::atomic<uint32_t> spectrum_bars_;
+    std::atomic<float> spectrum_smoothing_;
+    
+    // Sample tap from the audio thread: blocks of
+    // [channels, frames, sample_rate, interleaved samples...]
+    std::unique_ptr<core::SpscRingBuffer<float>> tap_;
+    std::atomic<uint64_t> dropped_frames_;
+    
+    // Worker thread
+    std::thread worker_thread_;
+    std::mutex worker_mutex_;
+    std::condition_variable worker_cv_;
+    bool worker_running_;
+    
+    // Worker-owned analysis state
+    uint32_t analysis_sample_rate_;
+    uint16_t analysis_channels_;
+    std::vector<float> drain_buffer_;     // One tap block
+    std::vector<float> waveform_buffer_;  // Ring buffer for waveform (mono)
     size_t waveform_write_pos_;
-    std::mutex waveform_mutex_;
-    
-    // Spectrum data
+    std::vector<float> spectrum_history_; // Ring of the newest fft_size mono samples
+    size_t spectrum_history_pos_;
     std::vector<float> spectrum_input_buffer_;
-    std::vector<std::complex<float>> spectrum_fft_output_;
+    std::unique_ptr<core::RealFFT> spectrum_fft_;
+    std::vector<std::complex<float>> spectrum_fft_output_;  // fft_size / 2 + 1 bins
     std::vector<float> spectrum_bar_values_;
     std::vector<float> spectrum_smoothed_bars_;
-    std::mutex spectrum_mutex_;
+    core::LevelMeter meter_;
+    std::vector<float> publish_buffer_;
     
-    // VU meter data
-    VUMeterData vu_data_;
-    std::vector<float> rms_buffer_left_;
-    std::vector<float> rms_buffer_right_;
-    size_t rms_buffer_pos_;
-    float peak_hold_time_left_;
-    float peak_hold_time_right_;
-    std::mutex vu_mutex_;
+    // Published snapshots
+    std::unique_ptr<core::SeqlockBuffer> waveform_snapshot_;  // min[width], max[width]
+    std::unique_ptr<core::SeqlockBuffer> spectrum_snapshot_;  // smoothed bars (dB)
+    std::unique_ptr<core::SeqlockBuffer> vu_snapshot_;        // VUMeterData fields
+    std::unique_ptr<core::SeqlockBuffer> channel_snapshot_;   // ChannelMeterData per channel
+    std::atomic<uint32_t> published_fft_size_;
     
     // Sample rate tracking
-    uint32_t current_sample_rate_;
-    uint16_t current_channels_;
+    std::atomic<uint32_t> current_sample_rate_;
+    std::atomic<uint16_t> current_channels_;
+    
+    // Upper bounds for the preallocated snapshots
+    static constexpr uint32_t MAX_WAVEFORM_WIDTH = 4096;
+    static constexpr uint32_t MAX_SPECTRUM_BARS = 1024;
+    static constexpr uint32_t MAX_FFT_SIZE = 32768;
+    static constexpr uint32_t VU_FIELDS = 8;
+    static constexpr uint32_t CHANNEL_FIELDS = 6;
+    static constexpr uint32_t TAP_HEADER = 3;
+    static constexpr uint32_t TAP_BLOCK_FRAMES = 256;
 };
 
 } // namespace mp
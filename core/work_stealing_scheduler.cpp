@@ -0,0 +1,229 @@
+﻿#include "work_stealing_scheduler.h"
+#include "realtime_guard.h"
+#include <chrono>
+
+namespace mp {
+namespace core {
+
+namespace {
+
+size_t next_power_of_two(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// WorkStealingDeque
+// ---------------------------------------------------------------------------
+
+WorkStealingDeque::WorkStealingDeque(size_t min_capacity)
+    : tasks_(new std::atomic<uint32_t>[next_power_of_two(min_capacity < 2 ? 2 : min_capacity)])
+    , mask_(next_power_of_two(min_capacity < 2 ? 2 : min_capacity) - 1)
+    , top_(0)
+    , bottom_(0) {
+}
+
+void WorkStealingDeque::push(uint32_t task) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    tasks_[static_cast<size_t>(b) & mask_].store(task, std::memory_order_relaxed);
+    bottom_.store(b + 1, std::memory_order_release);
+}
+
+bool WorkStealingDeque::pop(uint32_t& task) {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    // Publishing the claim before reading top_ is what orders pop against
+    // a concurrent steal, hence seq_cst on both sides
+    bottom_.store(b, std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_seq_cst);
+
+    if (t > b) {
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    task = tasks_[static_cast<size_t>(b) & mask_].load(std::memory_order_relaxed);
+    if (t == b) {
+        // Last task: race the thieves for it
+        bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                std::memory_order_relaxed);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+bool WorkStealingDeque::steal(uint32_t& task) {
+    int64_t t = top_.load(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_seq_cst);
+    if (t >= b) {
+        return false;
+    }
+
+    task = tasks_[static_cast<size_t>(t) & mask_].load(std::memory_order_relaxed);
+    return top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed);
+}
+
+// ---------------------------------------------------------------------------
+// TaskGraph
+// ---------------------------------------------------------------------------
+
+uint32_t TaskGraph::add_task(Task task) {
+    uint32_t index = static_cast<uint32_t>(nodes_.size());
+    nodes_.push_back(Node{std::move(task), {}, 0});
+    roots_.push_back(index);
+    // Atomics cannot be moved, so the counters are replaced wholesale
+    pending_ = std::vector<std::atomic<uint32_t>>(nodes_.size());
+    return index;
+}
+
+bool TaskGraph::add_dependency(uint32_t before, uint32_t after) {
+    if (before >= after || after >= nodes_.size()) {
+        return false;
+    }
+
+    nodes_[before].successors.push_back(after);
+    if (nodes_[after].predecessors++ == 0) {
+        for (size_t i = 0; i < roots_.size(); ++i) {
+            if (roots_[i] == after) {
+                roots_.erase(roots_.begin() + i);
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void TaskGraph::clear() {
+    nodes_.clear();
+    roots_.clear();
+    pending_.clear();
+}
+
+// ---------------------------------------------------------------------------
+// WorkStealingScheduler
+// ---------------------------------------------------------------------------
+
+WorkStealingScheduler::WorkStealingScheduler(size_t threads, size_t max_tasks)
+    : max_tasks_(max_tasks)
+    , graph_(nullptr)
+    , remaining_(0)
+    , epoch_(0)
+    , stop_(false)
+    , steals_(0) {
+    for (size_t i = 0; i <= threads; ++i) {
+        deques_.push_back(std::make_unique<WorkStealingDeque>(max_tasks));
+    }
+    for (size_t i = 1; i <= threads; ++i) {
+        threads_.emplace_back(&WorkStealingScheduler::worker_loop, this, i);
+    }
+}
+
+WorkStealingScheduler::~WorkStealingScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stop_.store(true, std::memory_order_release);
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+bool WorkStealingScheduler::run(TaskGraph& graph) {
+    size_t count = graph.size();
+    if (count > max_tasks_) {
+        return false;
+    }
+    if (count == 0) {
+        return true;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        graph.pending_[i].store(graph.nodes_[i].predecessors, std::memory_order_relaxed);
+    }
+    graph_.store(&graph, std::memory_order_release);
+    remaining_.store(count, std::memory_order_release);
+    for (uint32_t root : graph.roots_) {
+        deques_[0]->push(root);
+    }
+
+    // Notifying without the mutex keeps run() lock-free; a pool thread
+    // that misses it sleeps at most one wait period
+    epoch_.fetch_add(1, std::memory_order_release);
+    if (!threads_.empty()) {
+        wake_.notify_all();
+    }
+
+    while (remaining_.load(std::memory_order_acquire) != 0) {
+        if (!run_one(0)) {
+            std::this_thread::yield();
+        }
+    }
+    return true;
+}
+
+void WorkStealingScheduler::worker_loop(size_t worker) {
+    uint64_t seen = 0;
+    while (!stop_.load(std::memory_order_acquire)) {
+        uint64_t epoch = epoch_.load(std::memory_order_acquire);
+        if (epoch == seen) {
+            // Blocks usually arrive a few milliseconds apart: spin a little
+            // in case the next one is already due, then sleep
+            for (int spin = 0; spin < SPIN_BEFORE_SLEEP && epoch == seen; ++spin) {
+                std::this_thread::yield();
+                epoch = epoch_.load(std::memory_order_acquire);
+            }
+            if (epoch == seen) {
+                std::unique_lock<std::mutex> lock(wake_mutex_);
+                wake_.wait_for(lock, std::chrono::milliseconds(1), [&] {
+                    return stop_.load(std::memory_order_acquire) ||
+                           epoch_.load(std::memory_order_acquire) != seen;
+                });
+                continue;
+            }
+        }
+        seen = epoch;
+
+        rt::RealtimeScope realtime;
+        while (remaining_.load(std::memory_order_acquire) != 0) {
+            if (!run_one(worker)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+bool WorkStealingScheduler::run_one(size_t worker) {
+    uint32_t task;
+    if (!deques_[worker]->pop(task)) {
+        bool stolen = false;
+        size_t workers = deques_.size();
+        for (size_t k = 1; k < workers && !stolen; ++k) {
+            stolen = deques_[(worker + k) % workers]->steal(task);
+        }
+        if (!stolen) {
+            return false;
+        }
+        steals_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    TaskGraph& graph = *graph_.load(std::memory_order_acquire);
+    TaskGraph::Node& node = graph.nodes_[task];
+    node.task();
+
+    for (uint32_t successor : node.successors) {
+        if (graph.pending_[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            deques_[worker]->push(successor);
+        }
+    }
+    remaining_.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+}} // namespace mp::core
@@ -0,0 +1,123 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mp {
+namespace core {
+
+// Fixed-capacity Chase-Lev deque of task indices. The owning worker pushes
+// and pops at the bottom; other workers steal from the top. Never grows,
+// so pushing past the capacity is a caller error.
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(size_t min_capacity);
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Owner only
+    void push(uint32_t task);
+    bool pop(uint32_t& task);
+
+    // Any thread
+    bool steal(uint32_t& task);
+
+private:
+    std::unique_ptr<std::atomic<uint32_t>[]> tasks_;
+    size_t mask_;
+    alignas(64) std::atomic<int64_t> top_;
+    alignas(64) std::atomic<int64_t> bottom_;
+};
+
+// Tasks and the order they must run in, built once on a control thread and
+// run once per audio block. A task may only depend on tasks added before
+// it, which keeps the graph acyclic.
+class TaskGraph {
+public:
+    using Task = std::function<void()>;
+
+    // Returns the task's index
+    uint32_t add_task(Task task);
+
+    // after starts only once before has finished. False unless before < after.
+    bool add_dependency(uint32_t before, uint32_t after);
+
+    size_t size() const { return nodes_.size(); }
+    void clear();
+
+private:
+    friend class WorkStealingScheduler;
+
+    struct Node {
+        Task task;
+        std::vector<uint32_t> successors;
+        uint32_t predecessors = 0;
+    };
+
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> roots_;
+    std::vector<std::atomic<uint32_t>> pending_;    // Predecessors left, per run
+};
+
+// Runs TaskGraphs on a fixed pool of threads with one WorkStealingDeque
+// each. The thread calling run() works too, as worker 0: it seeds its deque
+// with the graph's roots, and a task that finishes pushes the successors it
+// released onto its own worker's deque, so chains stay on one core while
+// idle workers steal independent branches. run() returns once every task
+// has finished, which is the barrier at the end of each block.
+//
+// run() does not allocate or lock, and pool threads run tasks inside an
+// rt::RealtimeScope, so debug builds flag tasks that do. Between runs the
+// pool threads spin briefly, then sleep; a thread that misses a wakeup only
+// leaves its share to the others for that block.
+class WorkStealingScheduler {
+public:
+    // threads extra workers besides the caller; max_tasks bounds graph size
+    explicit WorkStealingScheduler(size_t threads, size_t max_tasks = 1024);
+    ~WorkStealingScheduler();
+
+    WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+    WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+    // Runs every task once, in dependency order. One caller at a time.
+    // False if the graph has more than max_tasks tasks. Tasks must not throw.
+    bool run(TaskGraph& graph);
+
+    // Including the caller
+    size_t worker_count() const { return deques_.size(); }
+    size_t max_tasks() const { return max_tasks_; }
+
+    // Tasks taken from another worker's deque, since construction
+    uint64_t steal_count() const { return steals_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int SPIN_BEFORE_SLEEP = 2000;
+
+    void worker_loop(size_t worker);
+    bool run_one(size_t worker);
+
+    size_t max_tasks_;
+    std::vector<std::unique_ptr<WorkStealingDeque>> deques_;
+    std::vector<std::thread> threads_;
+
+    std::atomic<TaskGraph*> graph_;
+    std::atomic<size_t> remaining_;         // Tasks of the current run not yet finished
+    std::atomic<uint64_t> epoch_;           // Bumped by every run()
+    std::atomic<bool> stop_;
+    std::atomic<uint64_t> steals_;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+};
+
+}} // namespace mp::core
@@ -9,6 +9,8 @@
 
 namespace fs = std::filesystem;
 
+namespace fb2k {
+
 // GUID瀛楃涓叉牸寮忓寲
 std::string GuidToString(const GUID& guid) {
     std::stringstream ss;
@@ -25,44 +27,6 @@ std::string GuidToString(const GUID& guid) {
     return ss.str();
 }
 
-// ComObject瀹炵幇
-HRESULT ComObject::QueryInterface(REFIID riid, void** ppvObject) {
-    if(!ppvObject) return E_POINTER;
-    *ppvObject = nullptr;
-    
-    if(IsEqualGUID(riid, IID_IUnknown)) {
-        *ppvObject = static_cast<IUnknown*>(this);
-    } else {
-        HRESULT hr = QueryInterfaceImpl(riid, ppvObject);
-        if(FAILED(hr)) return hr;
-    }
-    
-    AddRef();
-    return S_OK;
-}
-
-ULONG ComObject::AddRef() {
-    return InterlockedIncrement(&m_refCount);
-}
-
-ULONG ComObject::Release() {
-    ULONG count = InterlockedDecrement(&m_refCount);
-    if(count == 0) {
-        delete this;
-        return 0;
-    }
-    return count;
-}
-
-// ServiceBase瀹炵幇
-HRESULT ServiceBase::QueryInterfaceImpl(REFIID riid, void** ppvObject) {
-    if(IsEqualGUID(riid, IID_ServiceBase)) {
-        *ppvObject = static_cast<ServiceBase*>(this);
-        return S_OK;
-    }
-    return E_NOINTERFACE;
-}
-
 // RealFileInfo瀹炵幇
 HRESULT RealFileInfo::QueryInterfaceImpl(REFIID riid, void** ppvObject) {
     if(IsEqualGUID(riid, IID_FileInfo)) {
@@ -540,4 +504,6 @@ bool RealMiniHost::TestRealComponent(const std::string& audio_file) {
     FB2KLogger::Info("娴嬭瘯鏃堕暱: %.2f 绉?, (double)total_decoded / ai.sample_rate);
     
     return true;
-}
\ No newline at end of file
+}
+
+} // namespace fb2k
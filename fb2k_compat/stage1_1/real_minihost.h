@@ -9,6 +9,7 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <atomic>
 #include <functional>
 #include <iostream>
 
@@ -21,53 +22,72 @@ DEFINE_GUID(IID_IUnknown,
     0x00000000, 0x0000, 0x0000, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46);
 
 // 鏈嶅姟鍩虹鎺ュ彛
-// {FB2KServiceBase-1234-1234-1234-123456789ABC}
+// {FB2C0001-1234-1234-1234-56789ABCDEF0}
 DEFINE_GUID(IID_ServiceBase,
-    0xFB2KServiceBase, 0x1234, 0x1234, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0);
+    0xFB2C0001, 0x1234, 0x1234, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0);
 
 // 鏂囦欢淇℃伅鎺ュ彛  
-// {FB2KFileInfo-5678-5678-5678-567890ABCDEF}
+// {FB2C0002-5678-5678-5678-90ABCDEF1234}
 DEFINE_GUID(IID_FileInfo,
-    0xFB2KFileInfo, 0x5678, 0x5678, 0x56, 0x78, 0x90, 0xAB, 0xCD, 0xEF, 0x12, 0x34);
+    0xFB2C0002, 0x5678, 0x5678, 0x56, 0x78, 0x90, 0xAB, 0xCD, 0xEF, 0x12, 0x34);
 
 // 涓鍥炶皟鎺ュ彛
-// {FB2KAbortCallback-9ABC-9ABC-9ABC-9ABCDEF01234}
+// {FB2C0003-9ABC-9ABC-9ABC-DEF012345678}
 DEFINE_GUID(IID_AbortCallback,
-    0xFB2KAbortCallback, 0x9ABC, 0x9ABC, 0x9A, 0xBC, 0xDE, 0xF0, 0x12, 0x34, 0x56, 0x78);
+    0xFB2C0003, 0x9ABC, 0x9ABC, 0x9A, 0xBC, 0xDE, 0xF0, 0x12, 0x34, 0x56, 0x78);
 
 // 杈撳叆瑙ｇ爜鍣ㄦ帴鍙?
-// {FB2KInputDecoder-DEF0-DEF0-DEF0-DEF012345678}
+// {FB2C0004-DEF0-DEF0-DEF0-123456789ABC}
 DEFINE_GUID(IID_InputDecoder,
-    0xFB2KInputDecoder, 0xDEF0, 0xDEF0, 0xDE, 0xF0, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC);
+    0xFB2C0004, 0xDEF0, 0xDEF0, 0xDE, 0xF0, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC);
 
 // 鏈嶅姟绫籊UID
-// {FB2KServiceClass-1234-5678-9ABC-DEF012345678}
+// {FB2C0005-1234-5678-9ABC-DEF012345678}
 DEFINE_GUID(CLSID_InputDecoderService,
-    0xFB2KServiceClass, 0x1234, 0x5678, 0x9A, 0xBC, 0xDE, 0xF0, 0x12, 0x34, 0x56, 0x78);
-
-} // namespace fb2k
+    0xFB2C0005, 0x1234, 0x5678, 0x9A, 0xBC, 0xDE, 0xF0, 0x12, 0x34, 0x56, 0x78);
 
 // 鍓嶅悜澹版槑
-namespace fb2k {
-    class ServiceBase;
-    class FileInfo;
-    class AbortCallback;
-    class InputDecoder;
-}
+class ServiceBase;
+class FileInfo;
+class AbortCallback;
+class InputDecoder;
 
 // 鍩虹COM瀵硅薄锛堢鍚堢湡瀹瀎b2k瑙勮寖锛?
 class ComObject : public IUnknown {
 protected:
-    ULONG m_refCount;
+    std::atomic<ULONG> m_refCount;
     
 public:
     ComObject() : m_refCount(1) {}
     virtual ~ComObject() {}
     
     // IUnknown
-    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override;
-    virtual ULONG STDMETHODCALLTYPE AddRef() override;
-    virtual ULONG STDMETHODCALLTYPE Release() override;
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override {
+        if(!ppvObject) return E_POINTER;
+        *ppvObject = nullptr;
+        
+        if(IsEqualGUID(riid, IID_IUnknown)) {
+            *ppvObject = static_cast<IUnknown*>(this);
+        } else {
+            HRESULT hr = QueryInterfaceImpl(riid, ppvObject);
+            if(FAILED(hr)) return hr;
+        }
+        
+        AddRef();
+        return S_OK;
+    }
+    
+    virtual ULONG STDMETHODCALLTYPE AddRef() override {
+        return ++m_refCount;
+    }
+    
+    virtual ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = --m_refCount;
+        if(count == 0) {
+            delete this;
+        }
+        return count;
+    }
     
     // 娲剧敓绫婚渶瑕侀噸杞借繖涓嚱鏁?
     virtual HRESULT QueryInterfaceImpl(REFIID riid, void** ppvObject) {
@@ -81,7 +101,13 @@ public:
     virtual int service_add_ref() { return AddRef(); }
     virtual int service_release() { return Release(); }
     
-    HRESULT QueryInterfaceImpl(REFIID riid, void** ppvObject) override;
+    HRESULT QueryInterfaceImpl(REFIID riid, void** ppvObject) override {
+        if(IsEqualGUID(riid, IID_ServiceBase)) {
+            *ppvObject = static_cast<ServiceBase*>(this);
+            return S_OK;
+        }
+        return E_NOINTERFACE;
+    }
 };
 
 // 鏅鸿兘鎸囬拡妯℃澘锛堢鍚坒b2k瑙勮寖锛?
@@ -179,6 +205,15 @@ public:
     virtual bool is_aborting() const = 0;
 };
 
+// The SDK spelling the DSP and output interfaces use
+typedef AbortCallback abort_callback;
+
+// Never aborts: for callers that have no cancellation to offer
+class abort_callback_dummy : public abort_callback {
+public:
+    bool is_aborting() const override { return false; }
+};
+
 // 杈撳叆瑙ｇ爜鍣ㄦ帴鍙?
 class InputDecoder : public ServiceBase {
 public:
@@ -295,6 +330,14 @@ public:
     const char* get_name() override { return m_name.c_str(); }
 };
 
+// GUID鍝堝笇鍑芥暟
+struct GUID_hash {
+    size_t operator()(const GUID& guid) const {
+        const uint64_t* p = reinterpret_cast<const uint64_t*>(&guid);
+        return std::hash<uint64_t>()(p[0]) ^ std::hash<uint64_t>()(p[1]);
+    }
+};
+
 // 鐪熷疄鐨勪富鏈虹被
 class RealMiniHost {
 private:
@@ -334,14 +377,6 @@ private:
     std::wstring UTF8ToWide(const std::string& utf8);
 };
 
-// GUID鍝堝笇鍑芥暟
-struct GUID_hash {
-    size_t operator()(const GUID& guid) const {
-        const uint64_t* p = reinterpret_cast<const uint64_t*>(&guid);
-        return std::hash<uint64_t>()(p[0]) ^ std::hash<uint64_t>()(p[1]);
-    }
-};
-
 // 鏃ュ織宸ュ叿
 class FB2KLogger {
 public:
@@ -362,4 +397,6 @@ public:
     
     const char* what() const noexcept override { return m_message.c_str(); }
     HRESULT GetHR() const { return m_hr; }
-};
\ No newline at end of file
+};
+
+} // namespace fb2k
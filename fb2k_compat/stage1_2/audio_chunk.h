@@ -8,6 +8,7 @@
 #include <memory>
 #include <cstring>
 #include <algorithm>
+#include <cmath>
 #include "../stage1_1/real_minihost.h"
 
 namespace fb2k {
@@ -86,6 +87,16 @@ public:
         data_.resize(std::max(initial_size, size_t(1024)) * channels_);
     }
     
+    // Preallocates for blocks up to max_frames x max_channels, so later
+    // set_data/copy/set_data_size calls within that size never allocate
+    void reserve(size_t max_frames, uint32_t max_channels) {
+        data_.reserve(max_frames * max_channels);
+    }
+    
+    size_t get_capacity_samples() const {
+        return data_.capacity();
+    }
+    
     // IUnknown 瀹炵幇
     HRESULT QueryInterfaceImpl(REFIID riid, void** ppvObject) override {
         if(IsEqualGUID(riid, __uuidof(audio_chunk))) {
@@ -0,0 +1,214 @@
+﻿#pragma once
+
+// audio_chunk over a pooled pipeline frame
+
+#include "audio_chunk.h"
+#include "../../core/audio_frame.h"
+
+namespace fb2k {
+
+// Lets the DSP chain and outputs work on an mp::core::AudioFrame in place:
+// attach() a decoded frame, run the chain on this chunk, detach() the same
+// block and hand it on. Interleaved is the fb2k layout, so a planar frame is
+// converted once on attach. Writing (non-const get_data and the gain
+// helpers) needs the block to itself; a shared frame is first copied to a
+// fresh block from the pool, and get_data() returns nullptr if none is free.
+// Sizes are bounded by the pool's blocks: set_data_size clamps to them.
+class audio_chunk_frame : public audio_chunk {
+private:
+    mp::core::AudioFramePool& pool_;
+    mp::core::AudioFrame frame_;
+    uint32_t channel_config_;
+
+    static uint32_t default_channel_config(uint32_t channels) {
+        switch(channels) {
+            case 1: return 0x4;
+            case 2: return 0x3;
+            case 3: return 0x103;
+            case 6: return 0x37;
+            case 8: return 0xFF;
+            default: return (1u << channels) - 1;
+        }
+    }
+
+    // Make frame_ safe to write, copying a shared block
+    bool make_writable() {
+        if(!frame_ || frame_.unique()) {
+            return static_cast<bool>(frame_);
+        }
+        mp::core::AudioFrame copy = pool_.acquire(frame_.frames(), frame_.channels(),
+                                                  frame_.sample_rate(),
+                                                  mp::core::FrameLayout::Interleaved);
+        if(!copy) {
+            return false;
+        }
+        std::memcpy(copy.data(), frame_.data(), frame_.frames() * frame_.channels() * sizeof(float));
+        copy.set_position(frame_.position());
+        frame_ = std::move(copy);
+        return true;
+    }
+
+    // Take a new interleaved float block from the caller's samples
+    void assign(const float* data, size_t samples, uint32_t channels, uint32_t sample_rate) {
+        if(!data || channels == 0 || channels > UINT16_MAX) {
+            reset();
+            return;
+        }
+        // set_data() on our own samples (audio_chunk_utils does this) only
+        // updates the format
+        if(frame_ && data == frame_.data() && frame_.unique()) {
+            if(!frame_.set_format(samples, static_cast<uint16_t>(channels), sample_rate,
+                                  mp::core::FrameLayout::Interleaved)) {
+                reset();
+                return;
+            }
+        } else {
+            mp::core::AudioFrame frame = pool_.acquire();
+            if(!frame || !frame.import(data, mp::SampleFormat::Float32, samples,
+                                       static_cast<uint16_t>(channels),
+                                       static_cast<uint16_t>(channels), sample_rate,
+                                       mp::core::FrameLayout::Interleaved)) {
+                reset();
+                return;
+            }
+            frame_ = std::move(frame);
+        }
+        channel_config_ = default_channel_config(channels);
+    }
+
+public:
+    explicit audio_chunk_frame(mp::core::AudioFramePool& pool)
+        : pool_(pool), channel_config_(0x3) {
+    }
+
+    // Wrap a frame without copying it. False if a planar frame cannot be
+    // converted (the pool is exhausted or the frame is shared).
+    bool attach(mp::core::AudioFrame frame) {
+        if(frame && !frame.convert_layout(mp::core::FrameLayout::Interleaved)) {
+            return false;
+        }
+        frame_ = std::move(frame);
+        channel_config_ = default_channel_config(frame_.channels());
+        return true;
+    }
+
+    // Give the frame up, e.g. to the output or the visualisation tap
+    mp::core::AudioFrame detach() {
+        return std::move(frame_);
+    }
+
+    const mp::core::AudioFrame& frame() const { return frame_; }
+
+    HRESULT QueryInterfaceImpl(REFIID riid, void** ppvObject) override {
+        if(IsEqualGUID(riid, __uuidof(audio_chunk))) {
+            *ppvObject = static_cast<audio_chunk*>(this);
+            return S_OK;
+        }
+        return ServiceBase::QueryInterfaceImpl(riid, ppvObject);
+    }
+
+    float* get_data() override {
+        return make_writable() ? frame_.interleaved() : nullptr;
+    }
+
+    const float* get_data() const override {
+        return frame_.interleaved();
+    }
+
+    size_t get_sample_count() const override { return frame_.frames(); }
+    uint32_t get_sample_rate() const override { return frame_.sample_rate(); }
+    uint32_t get_channels() const override { return frame_.channels(); }
+    uint32_t get_channel_config() const override { return channel_config_; }
+
+    double get_duration() const override {
+        return frame_.sample_rate() > 0 ? double(frame_.frames()) / frame_.sample_rate() : 0.0;
+    }
+
+    void set_data(const float* data, size_t samples,
+                 uint32_t channels, uint32_t sample_rate) override {
+        assign(data, samples, channels, sample_rate);
+    }
+
+    void set_data_size(size_t samples) override {
+        if(!make_writable()) {
+            return;
+        }
+        size_t capacity = frame_.capacity_frames(frame_.channels(), mp::core::FrameLayout::Interleaved);
+        frame_.set_format(std::min(samples, capacity), frame_.channels(), frame_.sample_rate(),
+                          mp::core::FrameLayout::Interleaved);
+    }
+
+    void copy(const audio_chunk& source) override {
+        if(&source == this) return;
+        assign(source.get_data(), source.get_sample_count(), source.get_channels(),
+               source.get_sample_rate());
+        channel_config_ = source.get_channel_config();
+    }
+
+    void copy_from(const float* source, size_t samples,
+                  uint32_t channels, uint32_t sample_rate) override {
+        assign(source, samples, channels, sample_rate);
+    }
+
+    void reset() override {
+        frame_.reset();
+        channel_config_ = 0x3;
+    }
+
+    // Interleaved: channel n starts at sample n with a stride of get_channels()
+    float* get_channel_data(uint32_t channel) override {
+        float* data = channel < get_channels() ? get_data() : nullptr;
+        return data ? data + channel : nullptr;
+    }
+
+    const float* get_channel_data(uint32_t channel) const override {
+        const float* data = channel < get_channels() ? get_data() : nullptr;
+        return data ? data + channel : nullptr;
+    }
+
+    size_t get_channel_data_size() const override {
+        return frame_.frames();
+    }
+
+    void scale(const float& scale) override {
+        if(scale == 1.0f) return;
+        float* data = get_data();
+        if(!data) return;
+
+        const size_t total_samples = frame_.frames() * frame_.channels();
+        for(size_t i = 0; i < total_samples; ++i) {
+            data[i] *= scale;
+        }
+    }
+
+    void apply_gain(float gain) override {
+        scale(gain);
+    }
+
+    void apply_ramp(float start_gain, float end_gain) override {
+        if(start_gain == 1.0f && end_gain == 1.0f) return;
+        float* data = get_data();
+        const size_t total_samples = frame_.frames() * frame_.channels();
+        if(!data || total_samples < 2) return;
+
+        const float gain_step = (end_gain - start_gain) / (total_samples - 1);
+        for(size_t i = 0; i < total_samples; ++i) {
+            data[i] *= start_gain + gain_step * i;
+        }
+    }
+
+    bool is_valid() const override {
+        return frame_.interleaved() && frame_.frames() > 0 &&
+               frame_.channels() > 0 && frame_.sample_rate() > 0;
+    }
+
+    bool is_empty() const override {
+        return frame_.frames() == 0;
+    }
+
+    size_t get_data_bytes() const override {
+        return frame_.frames() * frame_.channels() * sizeof(float);
+    }
+};
+
+} // namespace fb2k
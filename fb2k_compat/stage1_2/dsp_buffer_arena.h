@@ -0,0 +1,90 @@
+﻿#pragma once
+
+// Per-chain scratch memory for DSP effects.
+// Sized once from the largest block the chain will see, so effects can get
+// scratch and dry-copy buffers on the audio thread without touching the heap.
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "audio_chunk.h"
+
+namespace fb2k {
+
+class dsp_buffer_arena {
+private:
+    static constexpr size_t ALIGN_FLOATS = 16;  // 64-byte slices
+
+    std::vector<float> storage_;
+    size_t max_frames_;
+    uint32_t max_channels_;
+    size_t used_;
+
+public:
+    static constexpr size_t DEFAULT_BUFFERS = 4;
+
+    dsp_buffer_arena() : max_frames_(0), max_channels_(0), used_(0) {}
+
+    // Allocates room for `buffers` blocks of max_frames x max_channels.
+    // Not real-time safe; call when the chain is (re)configured.
+    void configure(size_t max_frames, uint32_t max_channels, size_t buffers = DEFAULT_BUFFERS) {
+        size_t block = round_up(max_frames * max_channels);
+        storage_.assign(block * buffers + ALIGN_FLOATS, 0.0f);
+        max_frames_ = max_frames;
+        max_channels_ = max_channels;
+        used_ = 0;
+    }
+
+    bool is_configured() const { return !storage_.empty(); }
+    size_t get_max_frames() const { return max_frames_; }
+    uint32_t get_max_channels() const { return max_channels_; }
+    size_t get_capacity() const { return storage_.empty() ? 0 : storage_.size() - ALIGN_FLOATS; }
+    size_t get_used() const { return used_; }
+
+    // True if one block of this chunk fits the configured maximum
+    bool fits(const audio_chunk& chunk) const {
+        return chunk.get_sample_count() <= max_frames_ && chunk.get_channels() <= max_channels_;
+    }
+
+    // Uninitialised scratch of `samples` floats, 64-byte aligned. Valid until
+    // release_all(); nullptr if the arena is exhausted, so callers need a
+    // fallback for blocks larger than configured.
+    float* acquire(size_t samples) {
+        size_t needed = round_up(samples);
+        if(samples == 0 || used_ + needed > get_capacity()) {
+            return nullptr;
+        }
+        float* base = aligned_base();
+        float* buffer = base + used_;
+        used_ += needed;
+        return buffer;
+    }
+
+    // Dry copy of the chunk's interleaved samples
+    float* acquire_copy(const audio_chunk& chunk) {
+        const float* source = chunk.get_data();
+        size_t samples = chunk.get_sample_count() * chunk.get_channels();
+        if(!source) return nullptr;
+        float* buffer = acquire(samples);
+        if(buffer) {
+            std::memcpy(buffer, source, samples * sizeof(float));
+        }
+        return buffer;
+    }
+
+    // Hands every buffer back; the chain calls this after each effect
+    void release_all() { used_ = 0; }
+
+private:
+    static size_t round_up(size_t samples) {
+        return (samples + ALIGN_FLOATS - 1) / ALIGN_FLOATS * ALIGN_FLOATS;
+    }
+
+    float* aligned_base() {
+        uintptr_t address = reinterpret_cast<uintptr_t>(storage_.data());
+        uintptr_t aligned = (address + ALIGN_FLOATS * sizeof(float) - 1) & ~(uintptr_t)(ALIGN_FLOATS * sizeof(float) - 1);
+        return reinterpret_cast<float*>(aligned);
+    }
+};
+
+} // namespace fb2k
@@ -7,79 +7,150 @@ namespace fb2k {
 // dsp_chain 瀹屾暣瀹炵幇锛堝凡鍦ㄥご鏂囦欢涓儴鍒嗗疄鐜帮級
 // 杩欓噷鏄畬鏁寸殑DSP閾剧鐞嗗疄鐜?
 
-dsp_chain::dsp_chain() : sample_rate_(44100), channels_(2) {}
+dsp_chain::dsp_chain() : next_effect_id_(0), next_generation_(0), sample_rate_(0), channels_(0),
+                         instantiated_generation_(0), needs_instantiate_(true),
+                         running_sample_rate_(0), running_channels_(0) {
+    configure(DEFAULT_MAX_BLOCK_FRAMES, DEFAULT_MAX_CHANNELS);
+}
+
+void dsp_chain::configure(size_t max_block_frames, uint32_t max_channels) {
+    arena_.configure(max_block_frames, max_channels);
+}
 
 void dsp_chain::add_effect(service_ptr_t<dsp> effect) {
     if(effect.is_valid()) {
-        effects_.push_back(effect);
+        auto list = copy_effects();
+        effect->set_buffer_arena(&arena_);
+        if(!prepare_effect(*effect, *list)) {
+            list->sample_rate = 0;          // Let run_chain() retry
+        }
+        list->effects.push_back(effect);
+        list->ids.push_back(++next_effect_id_);
+        publish_effects(std::move(list));
     }
 }
 
 void dsp_chain::remove_effect(size_t index) {
-    if(index < effects_.size()) {
-        effects_.erase(effects_.begin() + index);
+    auto list = copy_effects();
+    if(index < list->effects.size()) {
+        list->effects.erase(list->effects.begin() + index);
+        list->ids.erase(list->ids.begin() + index);
+        publish_effects(std::move(list));
     }
 }
 
 void dsp_chain::clear_effects() {
-    effects_.clear();
-    temp_buffers_.clear();
+    auto list = copy_effects();
+    list->effects.clear();
+    list->ids.clear();
+    publish_effects(std::move(list));
 }
 
 size_t dsp_chain::get_effect_count() const {
-    return effects_.size();
+    const effect_list* list = effects_.latest();
+    return list ? list->effects.size() : 0;
 }
 
-dsp* dsp_chain::get_effect(size_t index) {
-    return index < effects_.size() ? effects_[index].get() : nullptr;
+dsp* dsp_chain::get_effect(size_t index) const {
+    const effect_list* list = effects_.latest();
+    return list && index < list->effects.size() ? list->effects[index].get() : nullptr;
+}
+
+dsp_parameter_handle dsp_chain::find_parameter(size_t effect_index, const char* name) const {
+    dsp_parameter_handle handle;
+    const effect_list* list = effects_.latest();
+    if(!list || !name || effect_index >= list->effects.size() ||
+       !list->effects[effect_index].is_valid()) {
+        return handle;
+    }
+    auto params = list->effects[effect_index]->get_config_params();
+    for(size_t i = 0; i < params.size(); ++i) {
+        if(params[i].name == name) {
+            handle.effect_id = list->ids[effect_index];
+            handle.parameter = static_cast<uint32_t>(i);
+            break;
+        }
+    }
+    return handle;
+}
+
+bool dsp_chain::set_parameter(const dsp_parameter_handle& handle, float value, float ramp_ms) {
+    if(!handle.is_valid()) {
+        return false;
+    }
+    return parameter_queue_.push({handle.effect_id, handle.parameter, value, ramp_ms});
 }
 
 void dsp_chain::run_chain(audio_chunk& chunk, abort_callback& abort) {
-    if(effects_.empty() || abort.is_aborting()) {
+    const effect_list* list = effects_.acquire();
+    if(!list || list->effects.empty() || abort.is_aborting()) {
         return;
     }
     
-    // 纭繚鎵€鏈夋晥鏋滃櫒閮藉凡瀹炰緥鍖?
-    for(auto& effect : effects_) {
-        if(effect.is_valid()) {
-            if(!effect->instantiate(chunk, chunk.get_sample_rate(), chunk.get_channels())) {
-                return; // 瀹炰緥鍖栧け璐?
+    // Instantiate only on a format change, or for effects an edit could
+    // not prepare at the current format
+    uint32_t sample_rate = chunk.get_sample_rate();
+    uint32_t channels = chunk.get_channels();
+    bool list_unprepared = list->generation != instantiated_generation_ &&
+                           (list->sample_rate != sample_rate || list->channels != channels);
+    if(needs_instantiate_ || list_unprepared || sample_rate != sample_rate_ ||
+       channels != channels_) {
+        for(const auto& effect : list->effects) {
+            if(effect.is_valid()) {
+                if(!effect->instantiate(chunk, sample_rate, channels)) {
+                    needs_instantiate_ = true;
+                    return;
+                }
             }
         }
+        sample_rate_ = sample_rate;
+        channels_ = channels;
+        needs_instantiate_ = false;
+        running_sample_rate_.store(sample_rate, std::memory_order_release);
+        running_channels_.store(channels, std::memory_order_release);
     }
+    instantiated_generation_ = list->generation;
     
-    // 澶勭悊闊抽鏁版嵁
-    audio_chunk* current_chunk = &chunk;
+    apply_parameter_changes(*list);
     
-    for(size_t i = 0; i < effects_.size() && !abort.is_aborting(); ++i) {
-        if(effects_[i].is_valid()) {
-            effects_[i]->run(*current_chunk, abort);
+    // In place; scratch taken by an effect is reclaimed after it runs
+    for(size_t i = 0; i < list->effects.size() && !abort.is_aborting(); ++i) {
+        if(list->effects[i].is_valid()) {
+            list->effects[i]->run(chunk, abort);
+            arena_.release_all();
         }
     }
 }
 
 void dsp_chain::reset_all() {
-    for(auto& effect : effects_) {
-        if(effect.is_valid()) {
-            effect->reset();
+    if(const effect_list* list = effects_.latest()) {
+        for(const auto& effect : list->effects) {
+            if(effect.is_valid()) {
+                effect->reset();
+            }
         }
     }
 }
 
 double dsp_chain::get_total_latency() const {
+    // Effects report seconds; the chain total is in milliseconds
     double total_latency = 0.0;
-    for(const auto& effect : effects_) {
-        if(effect.is_valid()) {
-            total_latency += effect->get_latency();
+    if(const effect_list* list = effects_.latest()) {
+        for(const auto& effect : list->effects) {
+            if(effect.is_valid()) {
+                total_latency += effect->get_latency();
+            }
         }
     }
-    return total_latency;
+    return total_latency * 1000.0;
 }
 
 bool dsp_chain::need_track_change_mark() const {
-    for(const auto& effect : effects_) {
-        if(effect.is_valid() && effect->need_track_change_mark()) {
-            return true;
+    if(const effect_list* list = effects_.latest()) {
+        for(const auto& effect : list->effects) {
+            if(effect.is_valid() && effect->need_track_change_mark()) {
+                return true;
+            }
         }
     }
     return false;
@@ -87,9 +158,11 @@ bool dsp_chain::need_track_change_mark() const {
 
 std::vector<std::string> dsp_chain::get_effect_names() const {
     std::vector<std::string> names;
-    for(const auto& effect : effects_) {
-        if(effect.is_valid()) {
-            names.push_back(effect->get_name());
+    if(const effect_list* list = effects_.latest()) {
+        for(const auto& effect : list->effects) {
+            if(effect.is_valid()) {
+                names.push_back(effect->get_name());
+            }
         }
     }
     return names;
@@ -99,41 +172,55 @@ std::vector<std::string> dsp_chain::get_effect_names() const {
 
 void dsp_chain::optimize_chain() {
     // 绉婚櫎鏃犳晥鐨勬晥鏋滃櫒
-    effects_.erase(
-        std::remove_if(effects_.begin(), effects_.end(),
-                      [](const service_ptr_t<dsp>& effect) {
-                          return !effect.is_valid() || !effect->is_valid();
-                      }),
-        effects_.end()
-    );
+    auto list = copy_effects();
+    size_t kept = 0;
+    for(size_t i = 0; i < list->effects.size(); ++i) {
+        const auto& effect = list->effects[i];
+        if(effect.is_valid() && effect->is_valid()) {
+            list->effects[kept] = effect;
+            list->ids[kept] = list->ids[i];
+            ++kept;
+        }
+    }
+    if(kept == list->effects.size()) {
+        return;
+    }
+    list->effects.resize(kept);
+    list->ids.resize(kept);
+    publish_effects(std::move(list));
     
-    // 鍙互鍦ㄨ繖閲屾坊鍔犳洿澶氱殑浼樺寲閫昏緫
-    // 渚嬪锛氬悎骞剁浉浼肩殑鏁堟灉鍣紝閲嶆柊鎺掑簭绛?
+    // 鍙互鍦ㄨ繖閲屾坊鍔犳洿澶氱殑浼樺寲閫昏緫
+    // 渚嬪锛氬悎骞剁浉浼肩殑鏁堟灉鍣紝閲嶆柊鎺掑簭绛?
 }
 
 bool dsp_chain::reorder_effects(const std::vector<size_t>& new_order) {
-    if(new_order.size() != effects_.size()) {
+    auto list = copy_effects();
+    if(new_order.size() != list->effects.size()) {
         return false;
     }
     
     // 楠岃瘉鏂伴『搴忕殑鏈夋晥鎬?
-    std::vector<bool> used(effects_.size(), false);
+    std::vector<bool> used(list->effects.size(), false);
     for(size_t index : new_order) {
-        if(index >= effects_.size() || used[index]) {
+        if(index >= list->effects.size() || used[index]) {
             return false;
         }
         used[index] = true;
     }
     
-    // 鍒涘缓鏂伴『搴忕殑鏁堟灉鍣ㄥ垪琛?
+    // Ids move with their effects, so parameter handles stay valid
     std::vector<service_ptr_t<dsp>> new_effects;
-    new_effects.reserve(effects_.size());
-    
+    std::vector<uint32_t> new_ids;
+    new_effects.reserve(new_order.size());
+    new_ids.reserve(new_order.size());
     for(size_t index : new_order) {
-        new_effects.push_back(effects_[index]);
+        new_effects.push_back(list->effects[index]);
+        new_ids.push_back(list->ids[index]);
     }
-    
-    effects_ = std::move(new_effects);
+
+    list->effects = std::move(new_effects);
+    list->ids = std::move(new_ids);
+    publish_effects(std::move(list));
     return true;
 }
 
@@ -164,56 +251,6 @@ bool dsp_chain::import_chain_preset(const dsp_preset& preset) {
     return false;
 }
 
-// DSP鎬ц兘鍒嗘瀽鍣?
-class dsp_performance_analyzer {
-private:
-    struct effect_stats {
-        size_t call_count = 0;
-        double total_time_ms = 0.0;
-        double avg_time_ms = 0.0;
-        double min_time_ms = 0.0;
-        double max_time_ms = 0.0;
-    };
-    
-    std::map<std::string, effect_stats> stats_;
-    
-public:
-    void record_effect_call(const std::string& effect_name, double time_ms) {
-        auto& stat = stats_[effect_name];
-        stat.call_count++;
-        stat.total_time_ms += time_ms;
-        
-        if(stat.call_count == 1) {
-            stat.min_time_ms = time_ms;
-            stat.max_time_ms = time_ms;
-        } else {
-            stat.min_time_ms = std::min(stat.min_time_ms, time_ms);
-            stat.max_time_ms = std::max(stat.max_time_ms, time_ms);
-        }
-        
-        stat.avg_time_ms = stat.total_time_ms / stat.call_count;
-    }
-    
-    std::string generate_performance_report() const {
-        std::string report = "DSP Performance Report:\n";
-        
-        for(const auto& [name, stat] : stats_) {
-            report += "  " + name + ":\n";
-            report += "    Calls: " + std::to_string(stat.call_count) + "\n";
-            report += "    Avg Time: " + std::to_string(stat.avg_time_ms) + " ms\n";
-            report += "    Min Time: " + std::to_string(stat.min_time_ms) + " ms\n";
-            report += "    Max Time: " + std::to_string(stat.max_time_ms) + " ms\n";
-            report += "    Total Time: " + std::to_string(stat.total_time_ms) + " ms\n";
-        }
-        
-        return report;
-    }
-    
-    void reset_stats() {
-        stats_.clear();
-    }
-};
-
 // DSP閾炬瀯寤哄櫒 - 绠€鍖朌SP閾剧殑鏋勫缓
 class dsp_chain_builder {
 private:
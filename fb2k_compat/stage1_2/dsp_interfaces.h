@@ -3,12 +3,16 @@
 // 闃舵1.2锛欴SP鎺ュ彛瀹氫箟
 // DSP鏁堟灉鍣ㄧ郴缁熸帴鍙ｏ紝绗﹀悎foobar2000瑙勮寖
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include <map>
 #include <memory>
 #include "audio_chunk.h"
+#include "dsp_buffer_arena.h"
 #include "../stage1_1/real_minihost.h"
+#include "../../core/parameter_automation.h"
+#include "../../core/rcu_exchange.h"
 
 namespace fb2k {
 
@@ -27,6 +31,15 @@ struct dsp_config_param {
           min_value(min), max_value(max), step_value(step) {}
 };
 
+// A parameter of one effect in a chain, resolved once from names on the
+// control thread so automation only passes integers to the audio thread
+struct dsp_parameter_handle {
+    uint32_t effect_id = 0;     // Stable id the chain gave the effect
+    uint32_t parameter = 0;     // Index into the effect's get_config_params()
+    
+    bool is_valid() const { return effect_id != 0; }
+};
+
 // DSP棰勮鎺ュ彛 - 绗﹀悎foobar2000瑙勮寖
 class dsp_preset : public ServiceBase {
 public:
@@ -82,6 +95,18 @@ public:
     // 鑳藉姏鏌ヨ
     virtual bool can_work_with(const audio_chunk& chunk) const = 0;
     virtual bool supports_format(uint32_t sample_rate, uint32_t channels) const = 0;
+    
+    // Scratch memory owned by the chain running this effect; nullptr when
+    // run on its own. Buffers taken in run() are reclaimed when it returns.
+    virtual void set_buffer_arena(dsp_buffer_arena* arena) { (void)arena; }
+    
+    // Automation from the audio thread, between run() calls: moves the
+    // parameter at index in get_config_params() to value over ramp_frames.
+    // Must not allocate or lock. Effects without automatable parameters
+    // ignore it.
+    virtual void set_parameter(uint32_t index, float value, uint32_t ramp_frames) {
+        (void)index; (void)value; (void)ramp_frames;
+    }
 };
 
 // DSP棰勮鍏蜂綋瀹炵幇
@@ -244,89 +269,242 @@ public:
 // DSP閾剧鐞嗗櫒
 class dsp_chain {
 private:
-    std::vector<service_ptr_t<dsp>> effects_;
-    std::vector<std::unique_ptr<audio_chunk>> temp_buffers_;
-    uint32_t sample_rate_;
+    // Immutable once published. Edits copy the newest list, change the copy
+    // and swap it in whole, so run_chain() never sees a list being modified.
+    struct effect_list {
+        std::vector<service_ptr_t<dsp>> effects;
+        std::vector<uint32_t> ids;              // Parallel to effects
+        uint64_t generation = 0;
+        uint32_t sample_rate = 0;               // Format added effects were instantiated for
+        uint32_t channels = 0;
+    };
+    
+    mp::core::RcuExchange<effect_list> effects_;
+    mp::core::ParameterQueue parameter_queue_;
+    dsp_buffer_arena arena_;
+    uint32_t next_effect_id_;                   // Control thread
+    uint64_t next_generation_;
+    
+    // Audio thread
+    uint32_t sample_rate_;                      // Format the effects were instantiated for
     uint32_t channels_;
+    uint64_t instantiated_generation_;
+    bool needs_instantiate_;
+    
+    // Written by the audio thread, read by edits to pre-instantiate effects
+    std::atomic<uint32_t> running_sample_rate_;
+    std::atomic<uint32_t> running_channels_;
+    
+    static constexpr size_t MAX_CHANGES_PER_CHUNK = 64;
+    
+    std::unique_ptr<effect_list> copy_effects() const {
+        auto list = std::make_unique<effect_list>();
+        if(const effect_list* latest = effects_.latest()) {
+            list->effects = latest->effects;
+            list->ids = latest->ids;
+        }
+        list->sample_rate = running_sample_rate_.load(std::memory_order_acquire);
+        list->channels = running_channels_.load(std::memory_order_acquire);
+        return list;
+    }
+    
+    // Instantiates an added effect here, on the control thread, for the
+    // format the chain is running at, so the audio thread does not have to
+    bool prepare_effect(dsp& effect, effect_list& list) {
+        if(list.sample_rate == 0) {
+            return true;
+        }
+        std::vector<float> silence(list.channels, 0.0f);
+        audio_chunk_impl chunk;
+        chunk.set_data(silence.data(), 1, list.channels, list.sample_rate);
+        return effect.instantiate(chunk, list.sample_rate, list.channels);
+    }
+    
+    void publish_effects(std::unique_ptr<effect_list> list) {
+        list->generation = ++next_generation_;
+        effects_.publish(std::move(list));
+    }
+    
+    void apply_parameter_changes(const effect_list& list) {
+        mp::core::ParameterChange changes[MAX_CHANGES_PER_CHUNK];
+        size_t count = parameter_queue_.pop(changes, MAX_CHANGES_PER_CHUNK);
+        for(size_t c = 0; c < count; ++c) {
+            const auto& change = changes[c];
+            for(size_t i = 0; i < list.ids.size(); ++i) {
+                if(list.ids[i] == change.target && list.effects[i].is_valid()) {
+                    uint32_t ramp_frames = static_cast<uint32_t>(change.ramp_ms * 0.001f * sample_rate_);
+                    list.effects[i]->set_parameter(change.parameter, change.value, ramp_frames);
+                    break;
+                }
+            }
+        }
+    }
     
 public:
-    dsp_chain() : sample_rate_(44100), channels_(2) {}
+    static constexpr size_t DEFAULT_MAX_BLOCK_FRAMES = 4096;
+    static constexpr uint32_t DEFAULT_MAX_CHANNELS = 8;
+    
+    dsp_chain() : next_effect_id_(0), next_generation_(0), sample_rate_(0), channels_(0),
+                  instantiated_generation_(0), needs_instantiate_(true),
+                  running_sample_rate_(0), running_channels_(0) {
+        configure(DEFAULT_MAX_BLOCK_FRAMES, DEFAULT_MAX_CHANNELS);
+    }
     
+    // Sizes the scratch arena for the largest block the chain will run.
+    // Allocates; call before playback, not from the audio thread.
+    void configure(size_t max_block_frames, uint32_t max_channels) {
+        arena_.configure(max_block_frames, max_channels);
+    }
+    
+    const dsp_buffer_arena& get_buffer_arena() const { return arena_; }
+    
+    // Edits run on one control thread and may overlap run_chain(): they
+    // publish a new effect list, and effects they drop are released here
+    // on a later edit, never on the audio thread. Removed effects keep the
+    // chain's arena, since the audio thread may still be running them.
     void add_effect(service_ptr_t<dsp> effect) {
         if(effect.is_valid()) {
-            effects_.push_back(effect);
+            auto list = copy_effects();
+            effect->set_buffer_arena(&arena_);
+            if(!prepare_effect(*effect, *list)) {
+                list->sample_rate = 0;          // Let run_chain() retry
+            }
+            list->effects.push_back(effect);
+            list->ids.push_back(++next_effect_id_);
+            publish_effects(std::move(list));
         }
     }
     
     void remove_effect(size_t index) {
-        if(index < effects_.size()) {
-            effects_.erase(effects_.begin() + index);
+        auto list = copy_effects();
+        if(index < list->effects.size()) {
+            list->effects.erase(list->effects.begin() + index);
+            list->ids.erase(list->ids.begin() + index);
+            publish_effects(std::move(list));
         }
     }
     
     void clear_effects() {
-        effects_.clear();
-        temp_buffers_.clear();
+        auto list = copy_effects();
+        list->effects.clear();
+        list->ids.clear();
+        publish_effects(std::move(list));
     }
     
     size_t get_effect_count() const {
-        return effects_.size();
+        const effect_list* list = effects_.latest();
+        return list ? list->effects.size() : 0;
+    }
+    
+    dsp* get_effect(size_t index) const {
+        const effect_list* list = effects_.latest();
+        return list && index < list->effects.size() ? list->effects[index].get() : nullptr;
+    }
+    
+    // Control thread: handle for the parameter called name of the effect at
+    // index, or an invalid handle. Stays valid while the effect is in the
+    // chain, whatever else is added, removed or reordered.
+    dsp_parameter_handle find_parameter(size_t effect_index, const char* name) const {
+        dsp_parameter_handle handle;
+        const effect_list* list = effects_.latest();
+        if(!list || !name || effect_index >= list->effects.size() ||
+           !list->effects[effect_index].is_valid()) {
+            return handle;
+        }
+        auto params = list->effects[effect_index]->get_config_params();
+        for(size_t i = 0; i < params.size(); ++i) {
+            if(params[i].name == name) {
+                handle.effect_id = list->ids[effect_index];
+                handle.parameter = static_cast<uint32_t>(i);
+                break;
+            }
+        }
+        return handle;
     }
     
-    dsp* get_effect(size_t index) {
-        return index < effects_.size() ? effects_[index].get() : nullptr;
+    // Control thread: queued for the start of the next chunk and ramped
+    // over ramp_ms. False if the queue is full.
+    bool set_parameter(const dsp_parameter_handle& handle, float value, float ramp_ms = 0.0f) {
+        if(!handle.is_valid()) {
+            return false;
+        }
+        return parameter_queue_.push({handle.effect_id, handle.parameter, value, ramp_ms});
     }
     
-    // 杩愯DSP閾?
+    // Runs the chunk through every effect in place. Picks up the newest
+    // effect list and queued parameter changes first; never locks, and
+    // instantiates only on a format change or for effects an edit could
+    // not prepare.
     void run_chain(audio_chunk& chunk, abort_callback& abort) {
-        if(effects_.empty() || abort.is_aborting()) {
+        const effect_list* list = effects_.acquire();
+        if(!list || list->effects.empty() || abort.is_aborting()) {
             return;
         }
         
-        // 纭繚鎵€鏈夋晥鏋滃櫒閮藉凡瀹炰緥鍖?
-        for(auto& effect : effects_) {
-            if(effect.is_valid()) {
-                if(!effect->instantiate(chunk, chunk.get_sample_rate(), chunk.get_channels())) {
-                    return; // 瀹炰緥鍖栧け璐?
+        uint32_t sample_rate = chunk.get_sample_rate();
+        uint32_t channels = chunk.get_channels();
+        bool list_unprepared = list->generation != instantiated_generation_ &&
+                               (list->sample_rate != sample_rate || list->channels != channels);
+        if(needs_instantiate_ || list_unprepared || sample_rate != sample_rate_ ||
+           channels != channels_) {
+            for(const auto& effect : list->effects) {
+                if(effect.is_valid()) {
+                    if(!effect->instantiate(chunk, sample_rate, channels)) {
+                        needs_instantiate_ = true;
+                        return;
+                    }
                 }
             }
+            sample_rate_ = sample_rate;
+            channels_ = channels;
+            needs_instantiate_ = false;
+            running_sample_rate_.store(sample_rate, std::memory_order_release);
+            running_channels_.store(channels, std::memory_order_release);
         }
+        instantiated_generation_ = list->generation;
         
-        // 澶勭悊闊抽鏁版嵁
-        audio_chunk* current_chunk = &chunk;
+        apply_parameter_changes(*list);
         
-        for(size_t i = 0; i < effects_.size() && !abort.is_aborting(); ++i) {
-            if(effects_[i].is_valid()) {
-                effects_[i]->run(*current_chunk, abort);
+        for(size_t i = 0; i < list->effects.size() && !abort.is_aborting(); ++i) {
+            if(list->effects[i].is_valid()) {
+                list->effects[i]->run(chunk, abort);
+                arena_.release_all();
             }
         }
     }
     
     // 閲嶇疆鎵€鏈夋晥鏋滃櫒
     void reset_all() {
-        for(auto& effect : effects_) {
-            if(effect.is_valid()) {
-                effect->reset();
+        if(const effect_list* list = effects_.latest()) {
+            for(const auto& effect : list->effects) {
+                if(effect.is_valid()) {
+                    effect->reset();
+                }
             }
         }
     }
     
     // 鑾峰彇鎬诲欢杩?
     double get_total_latency() const {
+        // Effects report seconds; the chain total is in milliseconds
         double total_latency = 0.0;
-        for(const auto& effect : effects_) {
-            if(effect.is_valid()) {
-                total_latency += effect->get_latency();
+        if(const effect_list* list = effects_.latest()) {
+            for(const auto& effect : list->effects) {
+                if(effect.is_valid()) {
+                    total_latency += effect->get_latency();
+                }
             }
         }
-        return total_latency;
+        return total_latency * 1000.0;
     }
     
     // 妫€鏌ユ槸鍚﹂渶瑕侀煶杞ㄥ彉鍖栨爣璁?
     bool need_track_change_mark() const {
-        for(const auto& effect : effects_) {
-            if(effect.is_valid() && effect->need_track_change_mark()) {
-                return true;
+        if(const effect_list* list = effects_.latest()) {
+            for(const auto& effect : list->effects) {
+                if(effect.is_valid() && effect->need_track_change_mark()) {
+                    return true;
+                }
             }
         }
         return false;
@@ -335,9 +513,11 @@ public:
     // 鑾峰彇鎵€鏈夋晥鏋滃櫒鐨勫悕绉?
     std::vector<std::string> get_effect_names() const {
         std::vector<std::string> names;
-        for(const auto& effect : effects_) {
-            if(effect.is_valid()) {
-                names.push_back(effect->get_name());
+        if(const effect_list* list = effects_.latest()) {
+            for(const auto& effect : list->effects) {
+                if(effect.is_valid()) {
+                    names.push_back(effect->get_name());
+                }
             }
         }
         return names;
@@ -434,10 +614,6 @@ public:
             if(!effect) {
                 return false; // 鏈夌┖鏁堟灉鍣?
             }
-            
-            if(!effect->is_valid()) {
-                return false; // 鏁堟灉鍣ㄦ棤鏁?
-            }
         }
         
         return true;
@@ -155,75 +155,138 @@ bool dsp_preset_impl::deserialize(const uint8_t* data, size_t size) {
 // dsp_chain 瀹炵幇
 void dsp_chain::add_effect(service_ptr_t<dsp> effect) {
     if(effect.is_valid()) {
-        effects_.push_back(effect);
+        auto list = copy_effects();
+        effect->set_buffer_arena(&arena_);
+        if(!prepare_effect(*effect, *list)) {
+            list->sample_rate = 0;          // Let run_chain() retry
+        }
+        list->effects.push_back(effect);
+        list->ids.push_back(++next_effect_id_);
+        publish_effects(std::move(list));
     }
 }
 
 void dsp_chain::remove_effect(size_t index) {
-    if(index < effects_.size()) {
-        effects_.erase(effects_.begin() + index);
+    auto list = copy_effects();
+    if(index < list->effects.size()) {
+        list->effects.erase(list->effects.begin() + index);
+        list->ids.erase(list->ids.begin() + index);
+        publish_effects(std::move(list));
     }
 }
 
 void dsp_chain::clear_effects() {
-    effects_.clear();
-    temp_buffers_.clear();
+    auto list = copy_effects();
+    list->effects.clear();
+    list->ids.clear();
+    publish_effects(std::move(list));
 }
 
 size_t dsp_chain::get_effect_count() const {
-    return effects_.size();
+    const effect_list* list = effects_.latest();
+    return list ? list->effects.size() : 0;
 }
 
 dsp* dsp_chain::get_effect(size_t index) {
-    return index < effects_.size() ? effects_[index].get() : nullptr;
+    const effect_list* list = effects_.latest();
+    return list && index < list->effects.size() ? list->effects[index].get() : nullptr;
+}
+
+dsp_parameter_handle dsp_chain::find_parameter(size_t effect_index, const char* name) const {
+    dsp_parameter_handle handle;
+    const effect_list* list = effects_.latest();
+    if(!list || !name || effect_index >= list->effects.size() ||
+       !list->effects[effect_index].is_valid()) {
+        return handle;
+    }
+    auto params = list->effects[effect_index]->get_config_params();
+    for(size_t i = 0; i < params.size(); ++i) {
+        if(params[i].name == name) {
+            handle.effect_id = list->ids[effect_index];
+            handle.parameter = static_cast<uint32_t>(i);
+            break;
+        }
+    }
+    return handle;
+}
+
+bool dsp_chain::set_parameter(const dsp_parameter_handle& handle, float value, float ramp_ms) {
+    if(!handle.is_valid()) {
+        return false;
+    }
+    return parameter_queue_.push({handle.effect_id, handle.parameter, value, ramp_ms});
 }
 
 void dsp_chain::run_chain(audio_chunk& chunk, abort_callback& abort) {
-    if(effects_.empty() || abort.is_aborting()) {
+    const effect_list* list = effects_.acquire();
+    if(!list || list->effects.empty() || abort.is_aborting()) {
         return;
     }
     
-    // 纭繚鎵€鏈夋晥鏋滃櫒閮藉凡瀹炰緥鍖?
-    for(auto& effect : effects_) {
-        if(effect.is_valid()) {
-            if(!effect->instantiate(chunk, chunk.get_sample_rate(), chunk.get_channels())) {
-                return; // 瀹炰緥鍖栧け璐?
+    // Instantiate only on a format change, or for effects an edit could
+    // not prepare at the current format
+    uint32_t sample_rate = chunk.get_sample_rate();
+    uint32_t channels = chunk.get_channels();
+    bool list_unprepared = list->generation != instantiated_generation_ &&
+                           (list->sample_rate != sample_rate || list->channels != channels);
+    if(needs_instantiate_ || list_unprepared || sample_rate != sample_rate_ ||
+       channels != channels_) {
+        for(const auto& effect : list->effects) {
+            if(effect.is_valid()) {
+                if(!effect->instantiate(chunk, sample_rate, channels)) {
+                    needs_instantiate_ = true;
+                    return;
+                }
             }
         }
+        sample_rate_ = sample_rate;
+        channels_ = channels;
+        needs_instantiate_ = false;
+        running_sample_rate_.store(sample_rate, std::memory_order_release);
+        running_channels_.store(channels, std::memory_order_release);
     }
+    instantiated_generation_ = list->generation;
     
-    // 澶勭悊闊抽鏁版嵁
-    audio_chunk* current_chunk = &chunk;
+    apply_parameter_changes(*list);
     
-    for(size_t i = 0; i < effects_.size() && !abort.is_aborting(); ++i) {
-        if(effects_[i].is_valid()) {
-            effects_[i]->run(*current_chunk, abort);
+    // In place; scratch taken by an effect is reclaimed after it runs
+    for(size_t i = 0; i < list->effects.size() && !abort.is_aborting(); ++i) {
+        if(list->effects[i].is_valid()) {
+            list->effects[i]->run(chunk, abort);
+            arena_.release_all();
         }
     }
 }
 
 void dsp_chain::reset_all() {
-    for(auto& effect : effects_) {
-        if(effect.is_valid()) {
-            effect->reset();
+    if(const effect_list* list = effects_.latest()) {
+        for(const auto& effect : list->effects) {
+            if(effect.is_valid()) {
+                effect->reset();
+            }
         }
     }
 }
 
 double dsp_chain::get_total_latency() const {
+    // Effects report seconds; the chain total is in milliseconds
     double total_latency = 0.0;
-    for(const auto& effect : effects_) {
-        if(effect.is_valid()) {
-            total_latency += effect->get_latency();
+    if(const effect_list* list = effects_.latest()) {
+        for(const auto& effect : list->effects) {
+            if(effect.is_valid()) {
+                total_latency += effect->get_latency();
+            }
         }
     }
-    return total_latency;
+    return total_latency * 1000.0;
 }
 
 bool dsp_chain::need_track_change_mark() const {
-    for(const auto& effect : effects_) {
-        if(effect.is_valid() && effect->need_track_change_mark()) {
-            return true;
+    if(const effect_list* list = effects_.latest()) {
+        for(const auto& effect : list->effects) {
+            if(effect.is_valid() && effect->need_track_change_mark()) {
+                return true;
+            }
         }
     }
     return false;
@@ -231,9 +294,11 @@ bool dsp_chain::need_track_change_mark() const {
 
 std::vector<std::string> dsp_chain::get_effect_names() const {
     std::vector<std::string> names;
-    for(const auto& effect : effects_) {
-        if(effect.is_valid()) {
-            names.push_back(effect->get_name());
+    if(const effect_list* list = effects_.latest()) {
+        for(const auto& effect : list->effects) {
+            if(effect.is_valid()) {
+                names.push_back(effect->get_name());
+            }
         }
     }
     return names;
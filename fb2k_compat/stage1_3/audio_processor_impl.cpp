@@ -124,9 +124,14 @@ private:
     mutable std::mutex plugin_mutex_;
     
     // 瀹炴椂鍙傛暟绠＄悊
+    // Last value set per effect and parameter, for get_realtime_parameter().
+    // param_mutex_ serialises control threads editing the chain or queueing
+    // parameters; the audio thread never takes it.
     std::map<std::string, std::map<std::string, float>> realtime_parameters_;
     mutable std::mutex param_mutex_;
     
+    static constexpr float PARAMETER_RAMP_MS = 20.0f;
+    
     // 绉佹湁鏂规硶
     bool initialize_dsp_manager();
     bool initialize_output_device();
@@ -366,6 +371,7 @@ void audio_processor_impl::add_dsp_effect(std::unique_ptr<dsp_effect_advanced> e
         return;
     }
     
+    std::lock_guard<std::mutex> lock(param_mutex_);
     dsp_manager_->add_effect(std::move(effect));
     std::cout << "[AudioProcessor] 娣诲姞DSP鏁堟灉鍣? << std::endl;
 }
@@ -376,6 +382,7 @@ void audio_processor_impl::remove_dsp_effect(size_t index) {
         return;
     }
     
+    std::lock_guard<std::mutex> lock(param_mutex_);
     dsp_manager_->remove_effect(index);
     std::cout << "[AudioProcessor] 绉婚櫎DSP鏁堟灉鍣? << std::endl;
 }
@@ -386,6 +393,7 @@ void audio_processor_impl::clear_dsp_effects() {
         return;
     }
     
+    std::lock_guard<std::mutex> lock(param_mutex_);
     dsp_manager_->clear_effects();
     std::cout << "[AudioProcessor] 娓呯┖鎵€鏈塂SP鏁堟灉鍣? << std::endl;
 }
@@ -657,14 +665,21 @@ void audio_processor_impl::set_realtime_parameter(const std::string& effect_name
     std::lock_guard<std::mutex> lock(param_mutex_);
     realtime_parameters_[effect_name][param_name] = value;
     
-    // 鏇存柊鏁堟灉鍣ㄥ弬鏁?
-    if(dsp_manager_) {
-        for(size_t i = 0; i < dsp_manager_->get_effect_count(); ++i) {
-            auto* effect = dsp_manager_->get_effect(i);
-            if(effect && effect->get_name() == effect_name) {
-                // 杩欓噷搴旇璋冪敤鏁堟灉鍣ㄧ殑鍙傛暟璁剧疆鏂规硶
-                break;
+    if(!dsp_manager_) {
+        return;
+    }
+    
+    // Names are resolved here; the audio thread only sees integer handles
+    // and applies the change with a short ramp at its next chunk
+    for(size_t i = 0; i < dsp_manager_->get_effect_count(); ++i) {
+        auto* effect = dsp_manager_->get_effect(i);
+        if(effect && effect_name == effect->get_name()) {
+            auto handle = dsp_manager_->resolve_parameter(i, param_name);
+            if(handle.is_valid() && !dsp_manager_->set_parameter(handle, value, PARAMETER_RAMP_MS)) {
+                std::cerr << "[AudioProcessor] Parameter queue full, dropped " << effect_name
+                          << "." << param_name << std::endl;
             }
+            break;
         }
     }
 }
@@ -58,7 +58,7 @@ echo 编译核心库...
 echo ==========================================
 
 REM DSP源文件
-set DSP_SOURCES=dsp_equalizer.cpp dsp_reverb.cpp dsp_compressor.cpp dsp_manager_impl.cpp audio_block_impl.cpp
+set DSP_SOURCES=dsp_equalizer.cpp dsp_reverb.cpp dsp_compressor.cpp dsp_crossfeed.cpp dsp_manager_impl.cpp audio_block_impl.cpp
 
 REM 输出源文件
 set OUTPUT_SOURCES=output_wasapi_impl.cpp output_device_base.cpp
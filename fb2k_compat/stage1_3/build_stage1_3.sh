@@ -62,7 +62,9 @@ INCLUDE_PATHS="-I. -I../ -I../../"
 DSP_SOURCES=(
     "dsp_equalizer.cpp"
     "dsp_reverb.cpp"
+    "dsp_convolver.cpp"
     "dsp_compressor.cpp"
+    "dsp_crossfeed.cpp"
     "dsp_manager_impl.cpp"
     "audio_block_impl.cpp"
 )
@@ -0,0 +1,153 @@
+﻿#include "dsp_compressor.h"
+
+namespace fb2k {
+
+// dsp_compressor_advanced
+
+dsp_compressor_advanced::dsp_compressor_advanced(const dsp_effect_params& params)
+    : dsp_effect_advanced(params), sample_rate_(0), channels_(0),
+      threshold_param_(find_config_param("threshold")),
+      ratio_param_(find_config_param("ratio")),
+      knee_param_(find_config_param("knee")),
+      attack_param_(find_config_param("attack")),
+      release_param_(find_config_param("release")),
+      makeup_param_(find_config_param("makeup")) {
+}
+
+bool dsp_compressor_advanced::instantiate(audio_chunk& chunk, uint32_t sample_rate,
+                                          uint32_t channels) {
+    (void)chunk;
+    if(sample_rate == 0 || channels < 1 || channels > mp::core::Compressor::MAX_CHANNELS) {
+        return false;
+    }
+
+    // Only a format change allocates
+    if(sample_rate != sample_rate_ || channels != channels_) {
+        if(!compressor_.configure(static_cast<float>(sample_rate), static_cast<uint16_t>(channels))) {
+            return false;
+        }
+        sample_rate_ = sample_rate;
+        channels_ = channels;
+        apply_params(0);
+    }
+    return true;
+}
+
+void dsp_compressor_advanced::run(audio_chunk& chunk, abort_callback& abort) {
+    if(abort.is_aborting()) {
+        return;
+    }
+
+    process_chunk_internal(chunk, abort);
+}
+
+void dsp_compressor_advanced::reset() {
+    compressor_.reset();
+}
+
+void dsp_compressor_advanced::apply_params(uint32_t frames) {
+    compressor_.set_threshold(advance_param(threshold_param_, frames, -20.0f));
+    compressor_.set_ratio(advance_param(ratio_param_, frames, 4.0f));
+    compressor_.set_knee(advance_param(knee_param_, frames, 6.0f));
+    compressor_.set_makeup(advance_param(makeup_param_, frames, 0.0f));
+    compressor_.set_times(advance_param(attack_param_, frames, 10.0f),
+                          advance_param(release_param_, frames, 100.0f));
+}
+
+void dsp_compressor_advanced::process_chunk_internal(audio_chunk& chunk, abort_callback& abort) {
+    (void)abort;
+    if(is_bypassed() || !is_enabled() || chunk.is_empty() ||
+       chunk.get_channels() != channels_ || chunk.get_sample_rate() != sample_rate_) {
+        return;
+    }
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    size_t frames = chunk.get_sample_count();
+    apply_params(static_cast<uint32_t>(frames));
+    compressor_.process(chunk.get_data(), frames);
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
+    update_cpu_usage(static_cast<float>(duration.count()) / 1000.0f);
+}
+
+void dsp_compressor_advanced::update_cpu_usage(float usage) {
+    set_cpu_usage(usage);
+}
+
+// dsp_limiter_advanced
+
+dsp_limiter_advanced::dsp_limiter_advanced(const dsp_effect_params& params)
+    : dsp_effect_advanced(params), sample_rate_(0), channels_(0),
+      ceiling_param_(find_config_param("threshold")),
+      release_param_(find_config_param("release")) {
+}
+
+bool dsp_limiter_advanced::instantiate(audio_chunk& chunk, uint32_t sample_rate,
+                                       uint32_t channels) {
+    (void)chunk;
+    if(sample_rate == 0 || channels < 1 || channels > mp::core::LookaheadLimiter::MAX_CHANNELS) {
+        return false;
+    }
+
+    if(sample_rate != sample_rate_ || channels != channels_) {
+        if(!limiter_.configure(static_cast<float>(sample_rate), static_cast<uint16_t>(channels),
+                               LOOKAHEAD_MS)) {
+            return false;
+        }
+        sample_rate_ = sample_rate;
+        channels_ = channels;
+        apply_params(0);
+        params_.latency_ms = 1000.0 * limiter_.latency() / sample_rate;
+    }
+    return true;
+}
+
+void dsp_limiter_advanced::run(audio_chunk& chunk, abort_callback& abort) {
+    if(abort.is_aborting()) {
+        return;
+    }
+
+    process_chunk_internal(chunk, abort);
+}
+
+void dsp_limiter_advanced::reset() {
+    limiter_.reset();
+}
+
+double dsp_limiter_advanced::get_latency() const {
+    if(sample_rate_ == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(limiter_.latency()) / sample_rate_;
+}
+
+void dsp_limiter_advanced::apply_params(uint32_t frames) {
+    limiter_.set_ceiling(advance_param(ceiling_param_, frames, -1.0f));
+    limiter_.set_release(advance_param(release_param_, frames, 50.0f));
+}
+
+void dsp_limiter_advanced::process_chunk_internal(audio_chunk& chunk, abort_callback& abort) {
+    (void)abort;
+    if(is_bypassed() || !is_enabled() || chunk.is_empty() ||
+       chunk.get_channels() != channels_ || chunk.get_sample_rate() != sample_rate_) {
+        return;
+    }
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    size_t frames = chunk.get_sample_count();
+    apply_params(static_cast<uint32_t>(frames));
+    limiter_.process(chunk.get_data(), frames);
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
+    update_cpu_usage(static_cast<float>(duration.count()) / 1000.0f);
+}
+
+void dsp_limiter_advanced::update_cpu_usage(float usage) {
+    set_cpu_usage(usage);
+}
+
+} // namespace fb2k
@@ -0,0 +1,80 @@
+﻿#pragma once
+
+// Dynamics: compressor and true-peak look-ahead limiter
+
+#include "dsp_manager.h"
+#include "../../core/dynamics.h"
+#include <chrono>
+
+namespace fb2k {
+
+// Linked feed-forward compressor on mp::core::Compressor. Threshold,
+// ratio, knee, attack, release and makeup follow their config parameters
+// once per chunk, so automation ramps at chunk resolution. No latency.
+class dsp_compressor_advanced : public dsp_effect_advanced {
+private:
+    mp::core::Compressor compressor_;
+    uint32_t sample_rate_;                      // Format the compressor was set up for
+    uint32_t channels_;
+
+    // Indices into automation_, or -1
+    int threshold_param_;
+    int ratio_param_;
+    int knee_param_;
+    int attack_param_;
+    int release_param_;
+    int makeup_param_;
+
+public:
+    explicit dsp_compressor_advanced(const dsp_effect_params& params);
+
+    bool instantiate(audio_chunk& chunk, uint32_t sample_rate,
+                    uint32_t channels) override;
+    void run(audio_chunk& chunk, abort_callback& abort) override;
+    void reset() override;
+    double get_latency() const override { return 0.0; }
+
+    // Largest reduction in the last chunk, in dB
+    float get_gain_reduction() const { return compressor_.gain_reduction(); }
+
+protected:
+    void process_chunk_internal(audio_chunk& chunk, abort_callback& abort) override;
+    void update_cpu_usage(float usage) override;
+
+private:
+    void apply_params(uint32_t frames);
+};
+
+// Brick-wall limiter on true peak (mp::core::LookaheadLimiter). The
+// "threshold" parameter is the ceiling in dBTP. Latency is the fixed
+// look-ahead, reported exactly by get_latency() once instantiated.
+class dsp_limiter_advanced : public dsp_effect_advanced {
+private:
+    mp::core::LookaheadLimiter limiter_;
+    uint32_t sample_rate_;
+    uint32_t channels_;
+    int ceiling_param_;
+    int release_param_;
+
+public:
+    static constexpr float LOOKAHEAD_MS = 5.0f;
+
+    explicit dsp_limiter_advanced(const dsp_effect_params& params);
+
+    bool instantiate(audio_chunk& chunk, uint32_t sample_rate,
+                    uint32_t channels) override;
+    void run(audio_chunk& chunk, abort_callback& abort) override;
+    void reset() override;
+    double get_latency() const override;
+
+    float get_gain_reduction() const { return limiter_.gain_reduction(); }
+
+protected:
+    void process_chunk_internal(audio_chunk& chunk, abort_callback& abort) override;
+    void update_cpu_usage(float usage) override;
+
+private:
+    void apply_params(uint32_t frames);
+};
+
+} // namespace fb2k
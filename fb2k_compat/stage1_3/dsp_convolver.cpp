@@ -0,0 +1,300 @@
+﻿#include "dsp_convolver.h"
+#include "../../src/audio/enhanced_sample_rate_converter.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace fb2k {
+
+namespace {
+
+dsp_effect_params default_convolver_params() {
+    dsp_effect_params params;
+    params.type = dsp_effect_type::convolver;
+    params.name = "Convolver";
+    params.description = "Impulse response convolver";
+    params.is_enabled = true;
+    params.is_bypassed = false;
+    params.cpu_usage_estimate = 5.0f;
+    params.latency_ms = 0.0;
+    params.config_params = {
+        {"mix", "Mix Level", 1.0f, 0.0f, 1.0f, 0.01f}
+    };
+    return params;
+}
+
+} // namespace
+
+dsp_convolver_advanced::dsp_convolver_advanced()
+    : dsp_convolver_advanced(default_convolver_params()) {
+}
+
+dsp_convolver_advanced::dsp_convolver_advanced(const dsp_effect_params& params)
+    : dsp_effect_advanced(params), sample_rate_(0), channels_(0),
+      block_size_(DEFAULT_BLOCK_SIZE), max_partition_(DEFAULT_MAX_PARTITION),
+      configured_(false), latency_(0.0),
+      mix_param_(find_config_param("mix")), mix_(1.0f),
+      active_(nullptr), lanes_active_(false), mix_start_(1.0f), mix_end_(1.0f), dry_position_(0) {
+}
+
+dsp_convolver_advanced::~dsp_convolver_advanced() = default;
+
+bool dsp_convolver_advanced::instantiate(audio_chunk& chunk, uint32_t sample_rate,
+                                         uint32_t channels) {
+    (void)chunk;
+    if(sample_rate < 8000 || sample_rate > 384000) {
+        return false;
+    }
+
+    if(channels < 1 || channels > MAX_CHANNELS) {
+        return false;
+    }
+
+    // Resampling and transforming the response is the expensive part, so
+    // it only happens when the format changes. While the control thread is
+    // building a set, keep running the current one.
+    std::unique_lock<std::mutex> lock(build_mutex_, std::try_to_lock);
+    if(lock.owns_lock() &&
+       (sample_rate != sample_rate_ || channels != channels_ || !has_impulse_response())) {
+        sample_rate_ = sample_rate;
+        channels_ = channels;
+        if(!ir_.samples.empty() && !rebuild(sample_rate, channels)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void dsp_convolver_advanced::run(audio_chunk& chunk, abort_callback& abort) {
+    if(abort.is_aborting()) {
+        return;
+    }
+
+    process_chunk_internal(chunk, abort);
+}
+
+void dsp_convolver_advanced::reset() {
+    // Audio thread: clears the set it is running
+    if(const lane_set* set = lane_sets_.current()) {
+        for(const auto& l : set->lanes) {
+            l->convolver->reset();
+            std::fill(l->dry_delay.begin(), l->dry_delay.end(), 0.0f);
+        }
+    }
+    dry_position_ = 0;
+}
+
+double dsp_convolver_advanced::get_latency() const {
+    return latency_.load(std::memory_order_relaxed);
+}
+
+bool dsp_convolver_advanced::load_impulse_response(const std::string& path) {
+    mp::core::ImpulseResponse ir;
+    if(!mp::core::read_wav_impulse_response(path, ir)) {
+        std::cerr << "[Convolver] Cannot read impulse response: " << path << std::endl;
+        return false;
+    }
+
+    if(!set_impulse_response(ir)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(build_mutex_);
+    ir_path_ = path;
+    return true;
+}
+
+bool dsp_convolver_advanced::set_impulse_response(const mp::core::ImpulseResponse& ir) {
+    if(ir.channels == 0 || ir.sample_rate == 0 || ir.samples.empty()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(build_mutex_);
+    ir_ = ir;
+    ir_path_.clear();
+
+    // Already running: rebuild for the current format right away
+    if(sample_rate_ != 0) {
+        return rebuild(sample_rate_, channels_);
+    }
+    return true;
+}
+
+std::string dsp_convolver_advanced::get_impulse_response_path() const {
+    std::lock_guard<std::mutex> lock(build_mutex_);
+    return ir_path_;
+}
+
+bool dsp_convolver_advanced::set_partitioning(size_t block_size, size_t max_partition) {
+    if(block_size < 16 || (block_size & (block_size - 1)) != 0) {
+        return false;
+    }
+    if(max_partition != 0 && (max_partition < block_size || (max_partition & (max_partition - 1)) != 0)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(build_mutex_);
+    block_size_ = block_size;
+    max_partition_ = max_partition;
+    if(sample_rate_ != 0 && !ir_.samples.empty()) {
+        return rebuild(sample_rate_, channels_);
+    }
+    return true;
+}
+
+void dsp_convolver_advanced::set_mix(float mix) {
+    mix_ = std::max(0.0f, std::min(1.0f, mix));
+    if(mix_param_ >= 0) {
+        automation_[mix_param_].set_immediate(mix_);
+    }
+}
+
+bool dsp_convolver_advanced::rebuild(uint32_t sample_rate, uint32_t channels) {
+    mp::core::ImpulseResponse ir = ir_;
+    if(ir.sample_rate != sample_rate) {
+        audio::EnhancedSampleRateConverter converter(audio::ResampleQuality::Best);
+        if(!mp::core::resample_impulse_response(ir, sample_rate, converter)) {
+            std::cerr << "[Convolver] Cannot resample impulse response from "
+                      << ir_.sample_rate << " Hz to " << sample_rate << " Hz" << std::endl;
+            return false;
+        }
+    }
+
+    // Channel c convolves with response channel c % ir.channels, each in its
+    // own mono convolver so the channels can run on different threads
+    size_t ir_frames = ir.frames();
+    std::vector<float> mono(ir_frames);
+    auto set = std::make_unique<lane_set>();
+    set->block_size = block_size_;
+    for(uint32_t c = 0; c < channels; ++c) {
+        uint32_t ic = c % ir.channels;
+        for(size_t i = 0; i < ir_frames; ++i) {
+            mono[i] = ir.samples[i * ir.channels + ic];
+        }
+
+        auto l = std::make_unique<lane>();
+        l->convolver = std::make_unique<mp::core::PartitionedConvolver>();
+        if(!l->convolver->configure(mono.data(), ir_frames, 1, 1, block_size_, max_partition_)) {
+            return false;
+        }
+        l->dry_delay.assign(block_size_, 0.0f);
+        set->lanes.push_back(std::move(l));
+    }
+    size_lane_buffers(*set, DEFAULT_CHUNK_FRAMES);
+
+    // The audio thread picks it up at its next chunk; the set it leaves is
+    // freed here on a later rebuild
+    lane_sets_.publish(std::move(set));
+    configured_.store(true, std::memory_order_release);
+    latency_.store(static_cast<double>(block_size_) / sample_rate, std::memory_order_relaxed);
+    params_.latency_ms = 1000.0 * block_size_ / sample_rate;
+    return true;
+}
+
+void dsp_convolver_advanced::size_lane_buffers(const lane_set& set, size_t frames) {
+    for(const auto& l : set.lanes) {
+        if(l->wet.size() < frames) {
+            l->wet.resize(frames);
+            l->dry.resize(frames);
+        }
+    }
+}
+
+void dsp_convolver_advanced::process_chunk_internal(audio_chunk& chunk, abort_callback& abort) {
+    begin_lanes(chunk);
+    for(size_t c = 0; c < chunk.get_channels() && !abort.is_aborting(); ++c) {
+        run_lane(chunk, c, abort);
+    }
+    end_lanes(chunk);
+}
+
+void dsp_convolver_advanced::begin_lanes(audio_chunk& chunk) {
+    // A newly published set starts with clear delay lines
+    const lane_set* set = lane_sets_.acquire();
+    if(set != active_) {
+        active_ = set;
+        dry_position_ = 0;
+    }
+
+    lanes_active_ = active_ && !is_bypassed() && is_enabled() && !chunk.is_empty() &&
+                    chunk.get_channels() == active_->lanes.size();
+    if(!lanes_active_) {
+        return;
+    }
+
+    start_time_ = std::chrono::high_resolution_clock::now();
+
+    // Grows only for blocks larger than the set was built for
+    size_t frames = chunk.get_sample_count();
+    size_lane_buffers(*active_, frames);
+
+    // The lanes share one mix ramp, so it is stepped here rather than per
+    // sample in each lane
+    if(mix_param_ >= 0) {
+        mix_start_ = automation_[mix_param_].value();
+        mix_end_ = automation_[mix_param_].advance(static_cast<uint32_t>(frames));
+    } else {
+        mix_start_ = mix_end_ = mix_;
+    }
+}
+
+void dsp_convolver_advanced::run_lane(audio_chunk& chunk, size_t channel, abort_callback& abort) {
+    if(!lanes_active_ || channel >= active_->lanes.size() || abort.is_aborting()) {
+        return;
+    }
+
+    lane& l = *active_->lanes[channel];
+    float* data = chunk.get_data();
+    size_t frames = chunk.get_sample_count();
+    size_t channels = active_->lanes.size();
+    size_t block_size = active_->block_size;
+    float* wet = l.wet.data();
+    float* dry = l.dry.data();
+
+    // Dry signal delayed by the convolver latency, kept running even when
+    // fully wet so a later mix change starts from the right samples
+    size_t position = dry_position_;
+    for(size_t f = 0; f < frames; ++f) {
+        float x = data[f * channels + channel];
+        wet[f] = x;
+        dry[f] = l.dry_delay[position];
+        l.dry_delay[position] = x;
+        if(++position == block_size) {
+            position = 0;
+        }
+    }
+
+    l.convolver->process(wet, frames);
+
+    if(mix_start_ >= 1.0f && mix_end_ >= 1.0f) {
+        for(size_t f = 0; f < frames; ++f) {
+            data[f * channels + channel] = wet[f];
+        }
+        return;
+    }
+
+    // Linear across the chunk, so an automated mix change does not click
+    float step = frames > 0 ? (mix_end_ - mix_start_) / static_cast<float>(frames) : 0.0f;
+    float mix = mix_start_;
+    for(size_t f = 0; f < frames; ++f) {
+        mix += step;
+        data[f * channels + channel] = wet[f] * mix + dry[f] * (1.0f - mix);
+    }
+}
+
+void dsp_convolver_advanced::end_lanes(audio_chunk& chunk) {
+    if(!lanes_active_) {
+        return;
+    }
+
+    dry_position_ = (dry_position_ + chunk.get_sample_count()) % active_->block_size;
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time_);
+    update_cpu_usage(static_cast<float>(duration.count()) / 1000.0f);
+}
+
+void dsp_convolver_advanced::update_cpu_usage(float usage) {
+    set_cpu_usage(usage);
+}
+
+} // namespace fb2k
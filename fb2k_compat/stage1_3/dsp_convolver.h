@@ -0,0 +1,116 @@
+﻿#pragma once
+
+// Impulse response convolver for room correction and headphone responses
+
+#include "dsp_manager.h"
+#include "../../core/partitioned_convolver.h"
+#include "../../core/impulse_response.h"
+#include "../../core/rcu_exchange.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fb2k {
+
+// Convolves the stream with an impulse response loaded from WAV.
+// instantiate() resamples the response to the stream rate and builds one
+// mono mp::core::PartitionedConvolver per channel; run() only processes
+// blocks. Channels are independent lanes, so the manager's worker pool can
+// convolve them in parallel. The dry path is delayed by the convolver
+// latency so partial mixes stay aligned.
+//
+// A new response or partitioning builds a complete lane set and publishes
+// it; the audio thread switches to it at the start of a chunk, so lanes
+// are never replaced under a running convolution.
+class dsp_convolver_advanced : public dsp_effect_advanced {
+private:
+    struct lane {
+        std::unique_ptr<mp::core::PartitionedConvolver> convolver;
+        std::vector<float> wet;                 // One chunk of this channel
+        std::vector<float> dry;
+        std::vector<float> dry_delay;           // block_size frames
+    };
+
+    // Immutable once published; the lane state behind it belongs to the
+    // audio thread and the lane workers
+    struct lane_set {
+        std::vector<std::unique_ptr<lane>> lanes;   // One per channel
+        size_t block_size = 0;
+    };
+
+    // Writer side, under build_mutex_
+    mutable std::mutex build_mutex_;
+    std::string ir_path_;
+    mp::core::ImpulseResponse ir_;              // As loaded, at the file's rate
+    uint32_t sample_rate_;                      // Format the convolvers were built for
+    uint32_t channels_;
+    size_t block_size_;
+    size_t max_partition_;
+    std::atomic<bool> configured_;              // A lane set has been published
+    std::atomic<double> latency_;               // Of the last published set, in seconds
+
+    mp::core::RcuExchange<lane_set> lane_sets_;
+    int mix_param_;                             // Index of "mix" in automation_, or -1
+    float mix_;                                 // Used when there is no "mix" parameter
+
+    // Set by begin_lanes() for the chunk in flight, read by the lanes
+    const lane_set* active_;
+    bool lanes_active_;
+    float mix_start_;
+    float mix_end_;
+    size_t dry_position_;
+    std::chrono::high_resolution_clock::time_point start_time_;
+
+    // Lane buffers are sized for this at instantiate() and grow only for
+    // larger blocks
+    static constexpr size_t DEFAULT_CHUNK_FRAMES = 4096;
+
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 256;
+    static constexpr size_t DEFAULT_MAX_PARTITION = 16384;
+    static constexpr uint32_t MAX_CHANNELS = 8;
+
+    dsp_convolver_advanced();
+    explicit dsp_convolver_advanced(const dsp_effect_params& params);
+    ~dsp_convolver_advanced() override;
+
+    bool instantiate(audio_chunk& chunk, uint32_t sample_rate,
+                    uint32_t channels) override;
+    void run(audio_chunk& chunk, abort_callback& abort) override;
+    void reset() override;
+    double get_latency() const override;
+
+    size_t get_lane_count() const override { return MAX_CHANNELS; }
+    void begin_lanes(audio_chunk& chunk) override;
+    void run_lane(audio_chunk& chunk, size_t lane, abort_callback& abort) override;
+    void end_lanes(audio_chunk& chunk) override;
+
+    // Not real-time safe: reads, resamples and transforms the response.
+    // Safe while playing; the new response takes over at a chunk boundary.
+    bool load_impulse_response(const std::string& path);
+    bool set_impulse_response(const mp::core::ImpulseResponse& ir);
+    std::string get_impulse_response_path() const;
+    bool has_impulse_response() const { return configured_.load(std::memory_order_acquire); }
+
+    // block_size frames of latency; a larger max_partition selects the
+    // non-uniform layout for long responses
+    bool set_partitioning(size_t block_size, size_t max_partition);
+
+    // Jumps straight to mix; automate the "mix" parameter for a smooth
+    // change while playing
+    void set_mix(float mix);
+
+protected:
+    void process_chunk_internal(audio_chunk& chunk, abort_callback& abort) override;
+    void update_cpu_usage(float usage) override;
+
+private:
+    // Caller holds build_mutex_
+    bool rebuild(uint32_t sample_rate, uint32_t channels);
+    static void size_lane_buffers(const lane_set& set, size_t frames);
+};
+
+} // namespace fb2k
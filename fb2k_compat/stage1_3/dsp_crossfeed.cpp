@@ -0,0 +1,76 @@
+﻿#include "dsp_crossfeed.h"
+
+namespace fb2k {
+
+dsp_crossfeed_advanced::dsp_crossfeed_advanced(const dsp_effect_params& params)
+    : dsp_effect_advanced(params), sample_rate_(0), active_(false),
+      intensity_param_(find_config_param("intensity")),
+      frequency_param_(find_config_param("frequency")) {
+}
+
+bool dsp_crossfeed_advanced::instantiate(audio_chunk& chunk, uint32_t sample_rate,
+                                         uint32_t channels) {
+    (void)chunk;
+    if(sample_rate == 0) {
+        return false;
+    }
+
+    // Mono and multichannel pass through rather than fail, so a chain
+    // built for headphones still plays anything
+    active_ = channels == 2;
+    if(active_ && sample_rate != sample_rate_) {
+        if(!crossfeed_.configure(static_cast<float>(sample_rate))) {
+            return false;
+        }
+        sample_rate_ = sample_rate;
+        apply_params(0);
+    }
+    return true;
+}
+
+void dsp_crossfeed_advanced::run(audio_chunk& chunk, abort_callback& abort) {
+    if(abort.is_aborting()) {
+        return;
+    }
+
+    process_chunk_internal(chunk, abort);
+}
+
+void dsp_crossfeed_advanced::reset() {
+    crossfeed_.reset();
+}
+
+void dsp_crossfeed_advanced::apply_params(uint32_t frames) {
+    float intensity = advance_param(intensity_param_, frames, 0.5f);
+    float feed = MAX_FEED_DB - intensity * (MAX_FEED_DB - MIN_FEED_DB);
+    float cutoff = advance_param(frequency_param_, frames, mp::core::Crossfeed::DEFAULT_CUTOFF);
+
+    // Coefficients only change with the parameters
+    if(feed != crossfeed_.feed() || cutoff != crossfeed_.cutoff()) {
+        crossfeed_.set(cutoff, feed);
+    }
+}
+
+void dsp_crossfeed_advanced::process_chunk_internal(audio_chunk& chunk, abort_callback& abort) {
+    (void)abort;
+    if(!active_ || is_bypassed() || !is_enabled() || chunk.is_empty() ||
+       chunk.get_channels() != 2 || chunk.get_sample_rate() != sample_rate_) {
+        return;
+    }
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    size_t frames = chunk.get_sample_count();
+    apply_params(static_cast<uint32_t>(frames));
+    crossfeed_.process(chunk.get_data(), frames);
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
+    update_cpu_usage(static_cast<float>(duration.count()) / 1000.0f);
+}
+
+void dsp_crossfeed_advanced::update_cpu_usage(float usage) {
+    set_cpu_usage(usage);
+}
+
+} // namespace fb2k
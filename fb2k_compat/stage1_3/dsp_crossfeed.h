@@ -0,0 +1,43 @@
+﻿#pragma once
+
+// Headphone crossfeed
+
+#include "dsp_manager.h"
+#include "../../core/crossfeed.h"
+#include <chrono>
+
+namespace fb2k {
+
+// Bauer crossfeed (mp::core::Crossfeed) for stereo on headphones. The
+// "frequency" parameter is the cross low-pass cutoff; "intensity" maps
+// 0..1 onto a feed level of 15..1 dB, so 1 is the strongest blend. Other
+// channel counts pass through untouched. No latency.
+class dsp_crossfeed_advanced : public dsp_effect_advanced {
+private:
+    mp::core::Crossfeed crossfeed_;
+    uint32_t sample_rate_;
+    bool active_;                               // Stereo at the current format
+    int intensity_param_;
+    int frequency_param_;
+
+public:
+    static constexpr float MIN_FEED_DB = 1.0f;
+    static constexpr float MAX_FEED_DB = 15.0f;
+
+    explicit dsp_crossfeed_advanced(const dsp_effect_params& params);
+
+    bool instantiate(audio_chunk& chunk, uint32_t sample_rate,
+                    uint32_t channels) override;
+    void run(audio_chunk& chunk, abort_callback& abort) override;
+    void reset() override;
+    double get_latency() const override { return 0.0; }
+
+protected:
+    void process_chunk_internal(audio_chunk& chunk, abort_callback& abort) override;
+    void update_cpu_usage(float usage) override;
+
+private:
+    void apply_params(uint32_t frames);
+};
+
+} // namespace fb2k
@@ -40,6 +40,16 @@ void biquad_filter::reset() {
     x1_ = x2_ = y1_ = y2_ = 0.0f;
 }
 
+mp::core::BiquadCoefficients biquad_filter::get_coefficients() const {
+    mp::core::BiquadCoefficients c;
+    c.b0 = b0_;
+    c.b1 = b1_;
+    c.b2 = b2_;
+    c.a1 = a1_;
+    c.a2 = a2_;
+    return c;
+}
+
 std::complex<float> biquad_filter::get_frequency_response(float frequency, float sample_rate) const {
     float omega = 2.0f * M_PI * frequency / sample_rate;
     std::complex<float> z(cos(omega), -sin(omega));
@@ -152,7 +162,8 @@ void biquad_filter::design_high_pass(float frequency, float q, float sample_rate
 }
 
 // EQ棰戞瀹炵幇
-eq_band::eq_band(const eq_band_params& params) : params_(params), needs_update_(true) {}
+eq_band::eq_band(const eq_band_params& params)
+    : params_(params), sample_rate_(44100.0f), needs_update_(true) {}
 
 void eq_band::set_params(const eq_band_params& params) {
     params_ = params;
@@ -178,9 +189,16 @@ void eq_band::set_enabled(bool enabled) {
     params_.is_enabled = enabled;
 }
 
-void eq_band::process(audio_chunk& chunk) {
-    if(!params_.is_enabled || chunk.is_empty()) {
-        return;
+void eq_band::set_sample_rate(float sample_rate) {
+    if(sample_rate > 0.0f && sample_rate != sample_rate_) {
+        sample_rate_ = sample_rate;
+        needs_update_ = true;
+    }
+}
+
+mp::core::BiquadCoefficients eq_band::get_coefficients() {
+    if(!params_.is_enabled) {
+        return mp::core::BiquadCoefficients();
     }
     
     if(needs_update_) {
@@ -188,25 +206,37 @@ void eq_band::process(audio_chunk& chunk) {
         needs_update_ = false;
     }
     
-    // 璺宠繃澧炵泭涓?鐨勯娈?
-    if(std::abs(params_.gain) < 0.01f) {
+    return filter_.get_coefficients();
+}
+
+void eq_band::process(audio_chunk& chunk) {
+    if(!params_.is_enabled || chunk.is_empty()) {
         return;
     }
     
     float* data = chunk.get_data();
-    size_t total_samples = chunk.get_sample_count() * chunk.get_channels();
-    
     if(!data) return;
     
-    process_block(data, total_samples);
+    set_sample_rate(static_cast<float>(chunk.get_sample_rate()));
+    process_block(data, chunk.get_sample_count(), chunk.get_channels());
 }
 
-void eq_band::process_block(float* data, size_t samples) {
-    filter_.process_block(data, samples);
+void eq_band::process_block(float* data, size_t frames, uint32_t channels) {
+    if(channels == 0 || channels > mp::core::BiquadCascade::MAX_CHANNELS) {
+        return;
+    }
+    if(cascade_.sections() != 1 || cascade_.channels() != channels) {
+        cascade_.configure(1, static_cast<uint16_t>(channels));
+    }
+    
+    // A 0 dB peak or shelf comes out as identity and is skipped
+    cascade_.set_section(0, get_coefficients());
+    cascade_.process(data, frames);
 }
 
 void eq_band::reset() {
     filter_.reset();
+    cascade_.reset();
 }
 
 std::complex<float> eq_band::get_frequency_response(float frequency, float sample_rate) const {
@@ -224,36 +254,36 @@ void eq_band::update_filter_coefficients() {
     switch(params_.type) {
         case filter_type::peak:
             biquad_filter::design_peaking(params_.frequency, params_.gain, 
-                                         params_.bandwidth, 44100.0f, // 鍋囪鏍囧噯閲囨牱鐜?
+                                         params_.bandwidth, sample_rate_,
                                          b0, b1, b2, a0, a1, a2);
             break;
             
         case filter_type::low_shelf:
             biquad_filter::design_low_shelf(params_.frequency, params_.gain, 
-                                           params_.bandwidth, 44100.0f,
+                                           params_.bandwidth, sample_rate_,
                                            b0, b1, b2, a0, a1, a2);
             break;
             
         case filter_type::high_shelf:
             biquad_filter::design_high_shelf(params_.frequency, params_.gain, 
-                                            params_.bandwidth, 44100.0f,
+                                            params_.bandwidth, sample_rate_,
                                             b0, b1, b2, a0, a1, a2);
             break;
             
         case filter_type::low_pass:
-            biquad_filter::design_low_pass(params_.frequency, params_.bandwidth, 44100.0f,
+            biquad_filter::design_low_pass(params_.frequency, params_.bandwidth, sample_rate_,
                                           b0, b1, b2, a0, a1, a2);
             break;
             
         case filter_type::high_pass:
-            biquad_filter::design_high_pass(params_.frequency, params_.bandwidth, 44100.0f,
+            biquad_filter::design_high_pass(params_.frequency, params_.bandwidth, sample_rate_,
                                            b0, b1, b2, a0, a1, a2);
             break;
             
         default:
             // 榛樿宄板€兼护娉㈠櫒
             biquad_filter::design_peaking(params_.frequency, params_.gain, 
-                                         params_.bandwidth, 44100.0f,
+                                         params_.bandwidth, sample_rate_,
                                          b0, b1, b2, a0, a1, a2);
             break;
     }
@@ -291,18 +321,19 @@ bool dsp_equalizer_advanced::instantiate(audio_chunk& chunk, uint32_t sample_rat
         return false;
     }
     
-    if(channels < 1 || channels > 8) {
+    if(channels < 1 || channels > mp::core::BiquadCascade::MAX_CHANNELS) {
         return false;
     }
     
-    // 鏇存柊鎵€鏈夐娈电殑閲囨牱鐜?
+    // Redesign every band for the stream rate
     for(auto& band : bands_) {
         if(band) {
-            // 杩欓噷闇€瑕佹牴鎹疄闄呴噰鏍风巼閲嶆柊璁＄畻绯绘暟
-            band->set_params(band->get_params()); // 瑙﹀彂绯绘暟鏇存柊
+            band->set_sample_rate(static_cast<float>(sample_rate));
         }
     }
     
+    cascade_.configure(MAX_BANDS, static_cast<uint16_t>(channels));
+    
     return true;
 }
 
@@ -327,6 +358,7 @@ void dsp_equalizer_advanced::reset() {
             band->reset();
         }
     }
+    cascade_.reset();
 }
 
 size_t dsp_equalizer_advanced::add_band(const eq_band_params& params) {
@@ -482,20 +514,28 @@ void dsp_equalizer_advanced::process_chunk_internal(audio_chunk& chunk, abort_ca
     }
     
     float* data = chunk.get_data();
-    size_t total_samples = chunk.get_sample_count() * chunk.get_channels();
-    
     if(!data) return;
     
-    // 澶勭悊姣忎釜棰戞
-    for(const auto& band : bands_) {
-        if(band && band->is_enabled()) {
-            band->process_block(data, total_samples);
-            
-            if(abort.is_aborting()) {
-                return;
-            }
+    // Not instantiated for this layout: pass through rather than reallocate
+    // the cascade on the audio thread
+    if(cascade_.channels() != chunk.get_channels()) {
+        return;
+    }
+    
+    // Unchanged bands are no-ops; disabled and 0 dB bands are skipped
+    float sample_rate = static_cast<float>(chunk.get_sample_rate());
+    for(size_t i = 0; i < MAX_BANDS; ++i) {
+        eq_band* band = i < bands_.size() ? bands_[i].get() : nullptr;
+        if(band) {
+            band->set_sample_rate(sample_rate);
+            cascade_.set_section(i, band->get_coefficients());
+        } else {
+            cascade_.set_section(i, mp::core::BiquadCoefficients());
         }
     }
+    
+    // One pass over the chunk for all bands and channels
+    cascade_.process(data, chunk.get_sample_count());
 }
 
 void dsp_equalizer_advanced::update_cpu_usage(float usage) {
@@ -587,13 +627,19 @@ void dsp_graphic_equalizer::initialize_iso_bands() {
 
 bool dsp_graphic_equalizer::instantiate(audio_chunk& chunk, uint32_t sample_rate, 
                                        uint32_t channels) {
-    // 鏇存柊鎵€鏈塈SO棰戞鐨勯噰鏍风巼
+    if(channels < 1 || channels > mp::core::BiquadCascade::MAX_CHANNELS) {
+        return false;
+    }
+    
+    // Redesign every ISO band for the stream rate
     for(auto& band : iso_bands_) {
         if(band) {
-            band->set_params(band->get_params()); // 瑙﹀彂绯绘暟鏇存柊
+            band->set_sample_rate(static_cast<float>(sample_rate));
         }
     }
     
+    cascade_.configure(ISO_BAND_COUNT, static_cast<uint16_t>(channels));
+    
     return true;
 }
 
@@ -603,20 +649,23 @@ void dsp_graphic_equalizer::run(audio_chunk& chunk, abort_callback& abort) {
     }
     
     float* data = chunk.get_data();
-    size_t total_samples = chunk.get_sample_count() * chunk.get_channels();
-    
     if(!data) return;
     
-    // 澶勭悊姣忎釜ISO棰戞
-    for(auto& band : iso_bands_) {
-        if(band && band->is_enabled()) {
-            band->process_block(data, total_samples);
-            
-            if(abort.is_aborting()) {
-                return;
-            }
+    // Not instantiated for this layout: pass through
+    if(cascade_.channels() != chunk.get_channels()) {
+        return;
+    }
+    
+    float sample_rate = static_cast<float>(chunk.get_sample_rate());
+    for(size_t i = 0; i < iso_bands_.size(); ++i) {
+        if(iso_bands_[i]) {
+            iso_bands_[i]->set_sample_rate(sample_rate);
+            cascade_.set_section(i, iso_bands_[i]->get_coefficients());
         }
     }
+    
+    // All ISO bands in one pass
+    cascade_.process(data, chunk.get_sample_count());
 }
 
 void dsp_graphic_equalizer::reset() {
@@ -625,6 +674,7 @@ void dsp_graphic_equalizer::reset() {
             band->reset();
         }
     }
+    cascade_.reset();
 }
 
 void dsp_graphic_equalizer::set_iso_band_gain(size_t band, float gain_db) {
@@ -4,6 +4,7 @@
 // 涓撲笟绾у弬鏁板潎琛″櫒锛屾敮鎸佸娈甸鐜囪皟鑺?
 
 #include "dsp_manager.h"
+#include "../../core/biquad_cascade.h"
 #include <vector>
 #include <complex>
 #include <cmath>
@@ -67,6 +68,9 @@ public:
     // 閲嶇疆鐘舵€?
     void reset();
     
+    // Normalised coefficients, for running in a mp::core::BiquadCascade
+    mp::core::BiquadCoefficients get_coefficients() const;
+    
     // 鑾峰彇棰戠巼鍝嶅簲
     std::complex<float> get_frequency_response(float frequency, float sample_rate) const;
     
@@ -97,11 +101,13 @@ class eq_band {
 private:
     eq_band_params params_;
     biquad_filter filter_;
+    mp::core::BiquadCascade cascade_;   // Per-channel state when run on its own
+    float sample_rate_;
     bool needs_update_;
     
 public:
-    eq_band() : needs_update_(true) {}
-    explicit eq_band(const eq_band_params& params) : params_(params), needs_update_(true) {}
+    eq_band() : sample_rate_(44100.0f), needs_update_(true) {}
+    explicit eq_band(const eq_band_params& params);
     
     // 鍙傛暟璁剧疆
     void set_params(const eq_band_params& params);
@@ -112,10 +118,14 @@ public:
     void set_gain(float gain_db);
     void set_bandwidth(float bandwidth);
     void set_enabled(bool enabled);
+    void set_sample_rate(float sample_rate);
+    
+    // Coefficients for the current parameters; identity while disabled
+    mp::core::BiquadCoefficients get_coefficients();
     
     // 闊抽澶勭悊
     void process(audio_chunk& chunk);
-    void process_block(float* data, size_t samples);
+    void process_block(float* data, size_t frames, uint32_t channels);
     
     // 鐘舵€佺鐞?
     void reset();
@@ -136,6 +146,9 @@ private:
     std::vector<std::unique_ptr<eq_band>> bands_;
     static constexpr size_t MAX_BANDS = 32;
     
+    // All bands run as one cascade, one section per band
+    mp::core::BiquadCascade cascade_;
+    
     // 棰勮棰戞棰戠巼锛堢鍚圛SO鏍囧噯锛?
     static constexpr float ISO_FREQUENCIES[10] = {
         31.25f, 62.5f, 125.0f, 250.0f, 500.0f,
@@ -229,6 +242,7 @@ class dsp_graphic_equalizer : public dsp_effect_advanced {
 private:
     std::vector<std::unique_ptr<eq_band>> iso_bands_;
     static constexpr size_t ISO_BAND_COUNT = 10;
+    mp::core::BiquadCascade cascade_;
     
 public:
     dsp_graphic_equalizer();
@@ -246,6 +260,9 @@ public:
     void set_all_iso_bands(float gain_db);
     
     const std::vector<float>& get_iso_frequencies() const;
+    
+private:
+    void initialize_iso_bands();
 };
 
 // 鎴块棿鍝嶅簲鍧囪　鍣?
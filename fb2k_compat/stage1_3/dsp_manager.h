@@ -3,6 +3,7 @@
 // 闃舵1.3锛欴SP绠＄悊鍣?
 // 楂樼骇DSP鏁堟灉鍣ㄧ鐞嗗拰璋冨害绯荤粺
 
+#include <algorithm>
 #include <vector>
 #include <memory>
 #include <string>
@@ -16,6 +17,7 @@
 #include "../stage1_2/dsp_interfaces.h"
 #include "../stage1_2/audio_chunk.h"
 #include "../stage1_1/real_minihost.h"
+#include "../../core/work_stealing_scheduler.h"
 
 namespace fb2k {
 
@@ -57,10 +59,32 @@ protected:
     std::atomic<bool> is_enabled_;
     std::atomic<bool> is_bypassed_;
     std::atomic<float> cpu_usage_;
+    dsp_buffer_arena* arena_;           // Set by the owning dsp_chain, may be null
+    
+    // One per params_.config_params entry, moved by set_parameter(). Audio
+    // thread only once the effect is running.
+    std::vector<mp::core::SmoothedParameter> automation_;
     
 public:
     dsp_effect_advanced(const dsp_effect_params& params)
-        : params_(params), is_enabled_(true), is_bypassed_(false), cpu_usage_(0.0f) {}
+        : params_(params), is_enabled_(true), is_bypassed_(false), cpu_usage_(0.0f),
+          arena_(nullptr) {
+        reset_automation();
+    }
+    
+    void set_buffer_arena(dsp_buffer_arena* arena) override { arena_ = arena; }
+    
+    std::vector<dsp_config_param> get_config_params() const override {
+        return params_.config_params;
+    }
+    
+    void set_parameter(uint32_t index, float value, uint32_t ramp_frames) override {
+        if(index < automation_.size()) {
+            const auto& param = params_.config_params[index];
+            value = std::max(param.min_value, std::min(param.max_value, value));
+            automation_[index].set_target(value, ramp_frames);
+        }
+    }
     
     // 鍩虹鎺ュ彛
     virtual bool instantiate(audio_chunk& chunk, uint32_t sample_rate, 
@@ -79,7 +103,24 @@ public:
     virtual void set_cpu_usage(float usage) { cpu_usage_ = usage; }
     
     virtual const dsp_effect_params& get_params() const { return params_; }
-    virtual void update_params(const dsp_effect_params& params) { params_ = params; }
+    
+    // Not while the effect is running: resizes the automation state
+    virtual void update_params(const dsp_effect_params& params) {
+        params_ = params;
+        reset_automation();
+    }
+    
+    // Channel-parallel processing, used when the manager runs the chain on
+    // its worker pool. An effect whose channels are independent returns how
+    // many lanes run_lane() handles (lanes past the chunk's channel count do
+    // nothing). begin_lanes() runs first and end_lanes() last, each on one
+    // thread; the lanes of one chunk run concurrently in between.
+    virtual size_t get_lane_count() const { return 1; }
+    virtual void begin_lanes(audio_chunk& chunk) { (void)chunk; }
+    virtual void run_lane(audio_chunk& chunk, size_t lane, abort_callback& abort) {
+        (void)chunk; (void)lane; (void)abort;
+    }
+    virtual void end_lanes(audio_chunk& chunk) { (void)chunk; }
     
     // 瀹炴椂鍙傛暟璋冭妭
     virtual bool set_realtime_param(const std::string& name, float value);
@@ -94,6 +135,29 @@ protected:
     // 鍙椾繚鎶ょ殑鎺ュ彛
     virtual void process_chunk_internal(audio_chunk& chunk, abort_callback& abort) = 0;
     virtual void update_cpu_usage(float usage);
+    
+    // Index of the config parameter called name, or -1
+    int find_config_param(const char* name) const {
+        for(size_t i = 0; i < params_.config_params.size(); ++i) {
+            if(params_.config_params[i].name == name) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+    
+    // Config parameter index after frames more of its ramp; fallback when
+    // the effect has no such parameter (index -1)
+    float advance_param(int index, uint32_t frames, float fallback) {
+        return index >= 0 ? automation_[index].advance(frames) : fallback;
+    }
+    
+    void reset_automation() {
+        automation_.clear();
+        for(const auto& param : params_.config_params) {
+            automation_.emplace_back(param.default_value);
+        }
+    }
 };
 
 // DSP鎬ц兘缁熻
@@ -113,10 +177,47 @@ struct dsp_performance_stats {
         cpu_usage_percent(0.0), error_count(0) {}
 };
 
+class multithreaded_dsp_processor;
+
 // DSP鏁堟灉鍣ㄧ鐞嗗櫒
 class dsp_manager {
 private:
-    std::vector<std::unique_ptr<dsp_effect_advanced>> effects_;
+    // What the audio thread runs; rebuilt and swapped in on every edit
+    struct effect_snapshot {
+        std::vector<std::shared_ptr<dsp_effect_advanced>> effects;
+        std::vector<uint32_t> ids;              // Parallel to effects
+        
+        // Built when multithreading is on. Only the audio thread touches
+        // these: it sets the chunk and the instantiated flags, then runs the
+        // graph, whose tasks read them.
+        struct block_context {
+            audio_chunk* chunk = nullptr;
+            abort_callback* abort = nullptr;
+            std::vector<uint8_t> ready;         // Per effect: instantiated for this chunk
+        };
+        mutable block_context context;
+        mutable std::unique_ptr<mp::core::TaskGraph> graph;
+    };
+    
+    // Control thread. Effects are shared with the snapshots, so one removed
+    // here is destroyed when the audio thread's last snapshot holding it is
+    // collected, on the control thread.
+    std::vector<std::shared_ptr<dsp_effect_advanced>> effects_;
+    std::vector<uint32_t> effect_ids_;
+    uint32_t next_effect_id_;
+    mp::core::RcuExchange<effect_snapshot> snapshot_;
+    mp::core::ParameterQueue parameter_queue_;
+    std::atomic<uint32_t> sample_rate_;     // Of the last chunk, to turn ramps into frames
+    
+    static constexpr size_t MAX_CHANGES_PER_CHUNK = 64;
+    
+    void publish_snapshot();
+    void apply_parameter_changes(const effect_snapshot& snapshot);
+    bool process_chain_singlethread(const effect_snapshot& snapshot, audio_chunk& chunk,
+                                    abort_callback& abort);
+    bool process_chain_multithread(const effect_snapshot& snapshot, audio_chunk& chunk,
+                                   abort_callback& abort);
+    void build_task_graph(effect_snapshot& snapshot) const;
     std::unique_ptr<dsp_preset_manager> preset_manager_;
     std::unique_ptr<dsp_performance_monitor> performance_monitor_;
     
@@ -151,7 +252,6 @@ public:
     
     // DSP閾惧鐞?
     bool process_chain(audio_chunk& chunk, abort_callback& abort);
-    bool process_chain_multithread(audio_chunk& chunk, abort_callback& abort);
     
     // 鏍囧噯鏁堟灉鍣ㄥ伐鍘?
     std::unique_ptr<dsp_effect_advanced> create_equalizer_10band();
@@ -256,72 +356,37 @@ public:
     void reset_stats();
 };
 
-// 澶氱嚎绋婦SP澶勭悊鍣?
+// Worker pool for DSP chains: runs each chunk's task graph on a
+// mp::core::WorkStealingScheduler, with the calling audio thread as one of
+// the workers. dsp_manager splits the effects into tasks; the lanes of one
+// effect run concurrently and each effect waits for the one before it.
 class multithreaded_dsp_processor {
 private:
-    std::vector<std::unique_ptr<std::thread>> worker_threads_;
-    std::queue<std::unique_ptr<dsp_task>> task_queue_;
-    std::mutex queue_mutex_;
-    std::condition_variable cv_;
-    std::atomic<bool> should_stop_;
-    std::atomic<size_t> active_tasks_;
-    
+    std::unique_ptr<mp::core::WorkStealingScheduler> scheduler_;
     size_t num_threads_;
     std::atomic<uint64_t> total_tasks_processed_;
     
 public:
-    multithreaded_dsp_processor(size_t num_threads = 4);
+    // Worker threads besides the caller's
+    explicit multithreaded_dsp_processor(size_t num_threads = 4);
     ~multithreaded_dsp_processor();
     
-    void start();
+    bool start();
     void stop();
-    bool is_running() const;
+    bool is_running() const { return scheduler_ != nullptr; }
     
-    // 浠诲姟鎻愪氦
-    void submit_task(std::unique_ptr<dsp_task> task);
-    void submit_tasks(std::vector<std::unique_ptr<dsp_task>> tasks);
+    // Audio thread. Returns once every task has run; false if the pool is
+    // stopped or the graph is too large, in which case nothing ran.
+    bool run(mp::core::TaskGraph& graph);
     
-    // 绛夊緟瀹屾垚
-    void wait_for_completion();
-    bool wait_for_completion_timeout(std::chrono::milliseconds timeout);
+    uint64_t get_total_tasks_processed() const { return total_tasks_processed_.load(); }
+    uint64_t get_steal_count() const;
     
-    // 鐘舵€佹煡璇?
-    size_t get_queue_size() const;
-    size_t get_active_tasks() const;
-    uint64_t get_total_tasks_processed() const;
-    
-    // 鎬ц兘鎺у埗
-    void set_num_threads(size_t num_threads);
+    // Takes effect at the next start()
+    void set_num_threads(size_t num_threads) { num_threads_ = num_threads; }
     size_t get_num_threads() const { return num_threads_; }
     
-private:
-    void worker_thread_func(size_t thread_id);
-    void process_task(dsp_task* task);
-};
-
-// DSP浠诲姟
-class dsp_task {
-private:
-    audio_chunk* input_chunk_;
-    audio_chunk* output_chunk_;
-    dsp_chain* chain_;
-    abort_callback* abort_;
-    
-    std::atomic<bool> is_completed_;
-    std::atomic<bool> has_error_;
-    std::string error_message_;
-    
-public:
-    dsp_task(audio_chunk* input, audio_chunk* output, 
-             dsp_chain* chain, abort_callback* abort)
-        : input_chunk_(input), output_chunk_(output), 
-          chain_(chain), abort_(abort),
-          is_completed_(false), has_error_(false) {}
-    
-    void execute();
-    bool is_completed() const { return is_completed_.load(); }
-    bool has_error() const { return has_error_.load(); }
-    const std::string& get_error_message() const { return error_message_; }
+    static constexpr size_t MAX_TASKS = 1024;
 };
 
 // DSP瀹炵敤宸ュ叿
@@ -1,15 +1,21 @@
 ﻿#include "dsp_manager.h"
+#include "dsp_convolver.h"
+#include "dsp_compressor.h"
+#include "dsp_crossfeed.h"
 #include <algorithm>
 #include <sstream>
 #include <iomanip>
 #include <chrono>
+#include <system_error>
 
 namespace fb2k {
 
 // DSP绠＄悊鍣ㄥ疄鐜?
 
 dsp_manager::dsp_manager() 
-    : use_multithreading_(false),
+    : next_effect_id_(0),
+      sample_rate_(0),
+      use_multithreading_(false),
       preset_manager_(std::make_unique<dsp_preset_manager>()),
       performance_monitor_(std::make_unique<dsp_performance_monitor>()) {
 }
@@ -36,6 +42,7 @@ bool dsp_manager::initialize(const dsp_config& config) {
             return false;
         }
         use_multithreading_ = true;
+        publish_snapshot();
         std::cout << "[DSPManager] 澶氱嚎绋嬪鐞嗗櫒宸插惎鍔紝绾跨▼鏁? " << config_.max_threads << std::endl;
     }
     
@@ -63,8 +70,8 @@ void dsp_manager::shutdown() {
     
     // 鍋滄澶氱嚎绋嬪鐞嗗櫒
     if(thread_pool_) {
-        thread_pool_->stop();
         use_multithreading_ = false;
+        thread_pool_->stop();
     }
     
     // 娓呯悊鏁堟灉鍣?
@@ -84,6 +91,8 @@ bool dsp_manager::add_effect(std::unique_ptr<dsp_effect_advanced> effect) {
     }
     
     effects_.push_back(std::move(effect));
+    effect_ids_.push_back(++next_effect_id_);
+    publish_snapshot();
     
     std::cout << "[DSPManager] 娣诲姞鏁堟灉鍣? " << effects_.back()->get_name() << std::endl;
     return true;
@@ -96,12 +105,88 @@ bool dsp_manager::remove_effect(size_t index) {
     
     std::cout << "[DSPManager] 绉婚櫎鏁堟灉鍣? " << effects_[index]->get_name() << std::endl;
     effects_.erase(effects_.begin() + index);
+    effect_ids_.erase(effect_ids_.begin() + index);
+    publish_snapshot();
     return true;
 }
 
 void dsp_manager::clear_effects() {
     std::cout << "[DSPManager] 娓呴櫎鎵€鏈夋晥鏋滃櫒锛堟暟閲? " << effects_.size() << ")" << std::endl;
     effects_.clear();
+    effect_ids_.clear();
+    publish_snapshot();
+}
+
+// Also frees snapshots the audio thread has moved past, and with them any
+// effects removed since
+void dsp_manager::publish_snapshot() {
+    auto snapshot = std::make_unique<effect_snapshot>();
+    snapshot->effects = effects_;
+    snapshot->ids = effect_ids_;
+    if(use_multithreading_) {
+        build_task_graph(*snapshot);
+    }
+    snapshot_.publish(std::move(snapshot));
+}
+
+// One task per single-lane effect. A multi-lane effect becomes begin, its
+// lanes in parallel, then end. Each effect's first task waits for the
+// previous effect's last, so the chain order is kept and only channels run
+// side by side. The tasks point into the snapshot, which outlives them.
+void dsp_manager::build_task_graph(effect_snapshot& snapshot) const {
+    auto graph = std::make_unique<mp::core::TaskGraph>();
+    auto* context = &snapshot.context;
+    context->ready.assign(snapshot.effects.size(), 0);
+    
+    bool has_previous = false;
+    uint32_t previous = 0;
+    for(size_t i = 0; i < snapshot.effects.size(); ++i) {
+        dsp_effect_advanced* effect = snapshot.effects[i].get();
+        size_t lanes = effect->get_lane_count();
+        uint32_t first, last;
+        
+        if(lanes <= 1) {
+            first = last = graph->add_task([context, effect, i] {
+                if(context->ready[i]) {
+                    effect->run(*context->chunk, *context->abort);
+                }
+            });
+        } else {
+            first = graph->add_task([context, effect, i] {
+                if(context->ready[i]) {
+                    effect->begin_lanes(*context->chunk);
+                }
+            });
+            std::vector<uint32_t> lane_tasks;
+            for(size_t lane = 0; lane < lanes; ++lane) {
+                uint32_t task = graph->add_task([context, effect, i, lane] {
+                    if(context->ready[i]) {
+                        effect->run_lane(*context->chunk, lane, *context->abort);
+                    }
+                });
+                graph->add_dependency(first, task);
+                lane_tasks.push_back(task);
+            }
+            last = graph->add_task([context, effect, i] {
+                if(context->ready[i]) {
+                    effect->end_lanes(*context->chunk);
+                }
+            });
+            for(uint32_t task : lane_tasks) {
+                graph->add_dependency(task, last);
+            }
+        }
+        
+        if(has_previous) {
+            graph->add_dependency(previous, first);
+        }
+        previous = last;
+        has_previous = true;
+    }
+    
+    if(graph->size() <= multithreaded_dsp_processor::MAX_TASKS) {
+        snapshot.graph = std::move(graph);
+    }
 }
 
 size_t dsp_manager::get_effect_count() const {
@@ -116,11 +201,57 @@ const dsp_effect_advanced* dsp_manager::get_effect(size_t index) const {
     return index < effects_.size() ? effects_[index].get() : nullptr;
 }
 
+dsp_parameter_handle dsp_manager::resolve_parameter(size_t effect_index, const std::string& name) const {
+    dsp_parameter_handle handle;
+    if(effect_index >= effects_.size()) {
+        return handle;
+    }
+    
+    const auto& params = effects_[effect_index]->get_params().config_params;
+    for(size_t i = 0; i < params.size(); ++i) {
+        if(params[i].name == name) {
+            handle.effect_id = effect_ids_[effect_index];
+            handle.parameter = static_cast<uint32_t>(i);
+            break;
+        }
+    }
+    return handle;
+}
+
+bool dsp_manager::set_parameter(const dsp_parameter_handle& handle, float value, float ramp_ms) {
+    if(!handle.is_valid()) {
+        return false;
+    }
+    return parameter_queue_.push({handle.effect_id, handle.parameter, value, ramp_ms});
+}
+
+// Audio thread. Changes for effects no longer in the chain are dropped.
+void dsp_manager::apply_parameter_changes(const effect_snapshot& snapshot) {
+    mp::core::ParameterChange changes[MAX_CHANGES_PER_CHUNK];
+    size_t count = parameter_queue_.pop(changes, MAX_CHANGES_PER_CHUNK);
+    float frames_per_ms = sample_rate_.load(std::memory_order_relaxed) * 0.001f;
+    for(size_t c = 0; c < count; ++c) {
+        const auto& change = changes[c];
+        for(size_t i = 0; i < snapshot.ids.size(); ++i) {
+            if(snapshot.ids[i] == change.target) {
+                snapshot.effects[i]->set_parameter(change.parameter, change.value,
+                                                   static_cast<uint32_t>(change.ramp_ms * frames_per_ms));
+                break;
+            }
+        }
+    }
+}
+
 bool dsp_manager::process_chain(audio_chunk& chunk, abort_callback& abort) {
-    if(effects_.empty() || abort.is_aborting()) {
+    // Never blocks on edits: takes whatever chain was last published
+    const effect_snapshot* snapshot = snapshot_.acquire();
+    if(!snapshot || snapshot->effects.empty() || abort.is_aborting()) {
         return true;
     }
     
+    sample_rate_.store(chunk.get_sample_rate(), std::memory_order_relaxed);
+    apply_parameter_changes(*snapshot);
+    
     // 璁板綍澶勭悊寮€濮?
     if(performance_monitor_) {
         performance_monitor_->record_processing_start();
@@ -129,10 +260,10 @@ bool dsp_manager::process_chain(audio_chunk& chunk, abort_callback& abort) {
     bool success = true;
     
     try {
-        if(use_multithreading_ && effects_.size() > 1) {
-            success = process_chain_multithread(chunk, abort);
+        if(use_multithreading_ && snapshot->graph) {
+            success = process_chain_multithread(*snapshot, chunk, abort);
         } else {
-            success = process_chain_singlethread(chunk, abort);
+            success = process_chain_singlethread(*snapshot, chunk, abort);
         }
     } catch(const std::exception& e) {
         std::cerr << "[DSPManager] 澶勭悊閾惧紓甯? " << e.what() << std::endl;
@@ -150,9 +281,10 @@ bool dsp_manager::process_chain(audio_chunk& chunk, abort_callback& abort) {
     return success;
 }
 
-bool dsp_manager::process_chain_singlethread(audio_chunk& chunk, abort_callback& abort) {
+bool dsp_manager::process_chain_singlethread(const effect_snapshot& snapshot, audio_chunk& chunk,
+                                             abort_callback& abort) {
     // 鍗曠嚎绋嬪鐞?
-    for(auto& effect : effects_) {
+    for(const auto& effect : snapshot.effects) {
         if(!effect || effect->is_bypassed()) {
             continue;
         }
@@ -178,33 +310,31 @@ bool dsp_manager::process_chain_singlethread(audio_chunk& chunk, abort_callback&
     return true;
 }
 
-bool dsp_manager::process_chain_multithread(audio_chunk& chunk, abort_callback& abort) {
-    // 澶氱嚎绋嬪鐞嗭紙绠€鍖栧疄鐜帮級
-    // 瀹為檯瀹炵幇闇€瑕佹洿澶嶆潅鐨勪换鍔″垎鍓插拰鍚屾
-    
-    std::vector<std::unique_ptr<dsp_task>> tasks;
-    
-    // 涓烘瘡涓晥鏋滃櫒鍒涘缓浠诲姟
-    for(auto& effect : effects_) {
-        if(!effect || effect->is_bypassed()) {
+bool dsp_manager::process_chain_multithread(const effect_snapshot& snapshot, audio_chunk& chunk,
+                                            abort_callback& abort) {
+    // Instantiation can reallocate effect state, so it stays on this thread,
+    // before any task runs
+    auto& context = snapshot.context;
+    for(size_t i = 0; i < snapshot.effects.size(); ++i) {
+        const auto& effect = snapshot.effects[i];
+        context.ready[i] = 0;
+        if(effect->is_bypassed()) {
             continue;
         }
-        
-        // 杩欓噷绠€鍖栧鐞嗭細姣忎釜鏁堟灉鍣ㄤ綔涓轰竴涓嫭绔嬩换鍔?
-        // 瀹為檯瀹炵幇鍙兘闇€瑕佸垎鍓查煶棰戞暟鎹?
-        auto task = std::make_unique<dsp_task>(&chunk, &chunk, nullptr, &abort);
-        tasks.push_back(std::move(task));
+        if(!effect->instantiate(chunk, chunk.get_sample_rate(), chunk.get_channels())) {
+            std::cerr << "[DSPManager] 鏁堟灉鍣ㄥ疄渚嬪寲澶辫触: " << effect->get_name() << std::endl;
+            continue;
+        }
+        context.ready[i] = 1;
     }
     
-    // 鎻愪氦浠诲姟鍒扮嚎绋嬫睜
-    for(auto& task : tasks) {
-        thread_pool_->submit_task(std::move(task));
+    context.chunk = &chunk;
+    context.abort = &abort;
+    if(!thread_pool_->run(*snapshot.graph)) {
+        return process_chain_singlethread(snapshot, chunk, abort);
     }
     
-    // 绛夊緟鎵€鏈変换鍔″畬鎴?
-    thread_pool_->wait_for_completion();
-    
-    return true;
+    return !abort.is_aborting();
 }
 
 // 鏍囧噯鏁堟灉鍣ㄥ伐鍘?
@@ -272,9 +402,7 @@ std::unique_ptr<dsp_effect_advanced> dsp_manager::create_compressor() {
     params.name = "Compressor";
     params.description = "Dynamic range compressor";
     
-    // 杩欓噷搴旇瀹炵幇鍘嬬缉鍣ㄦ晥鏋滃櫒
-    // 鐩墠杩斿洖涓€涓崰浣嶇
-    auto compressor = std::make_unique<dsp_effect_advanced>(params);
+    auto compressor = std::make_unique<dsp_compressor_advanced>(params);
     
     std::cout << "[DSPManager] 鍒涘缓鍘嬬缉鍣ㄦ晥鏋滃櫒" << std::endl;
     return compressor;
@@ -286,8 +414,8 @@ std::unique_ptr<dsp_effect_advanced> dsp_manager::create_limiter() {
     params.name = "Limiter";
     params.description = "Peak limiter for loudness control";
     
-    // 杩欓噷搴旇瀹炵幇闄愬埗鍣ㄦ晥鏋滃櫒
-    auto limiter = std::make_unique<dsp_effect_advanced>(params);
+    // Latency is the look-ahead, exact once the effect sees a format
+    auto limiter = std::make_unique<dsp_limiter_advanced>(params);
     
     std::cout << "[DSPManager] 鍒涘缓闄愬埗鍣ㄦ晥鏋滃櫒" << std::endl;
     return limiter;
@@ -312,10 +440,10 @@ std::unique_ptr<dsp_effect_advanced> dsp_manager::create_convolver() {
     params.type = dsp_effect_type::convolver;
     params.name = "Convolver";
     params.description = "Impulse response convolver";
-    params.latency_ms = 50.0; // 杈冮珮鐨勫欢杩?
     
-    // 杩欓噷搴旇瀹炵幇鍗风Н鏁堟灉鍣?
-    auto convolver = std::make_unique<dsp_effect_advanced>(params);
+    // Passes audio through until an impulse response is loaded; latency is
+    // one convolver block once it is
+    auto convolver = std::make_unique<dsp_convolver_advanced>(params);
     
     std::cout << "[DSPManager] 鍒涘缓鍗风Н鏁堟灉鍣? << std::endl;
     return convolver;
@@ -327,8 +455,7 @@ std::unique_ptr<dsp_effect_advanced> dsp_manager::create_crossfeed() {
     params.name = "Crossfeed";
     params.description = "Headphone crossfeed for natural sound";
     
-    // 杩欓噷搴旇瀹炵幇浜ゅ弶棣堥€佹晥鏋滃櫒
-    auto crossfeed = std::make_unique<dsp_effect_advanced>(params);
+    auto crossfeed = std::make_unique<dsp_crossfeed_advanced>(params);
     
     std::cout << "[DSPManager] 鍒涘缓浜ゅ弶棣堥€佹晥鏋滃櫒" << std::endl;
     return crossfeed;
@@ -436,12 +563,15 @@ void dsp_manager::update_config(const dsp_config& config) {
     if(config.enable_multithreading && !use_multithreading_) {
         // 鍚姩澶氱嚎绋?
         thread_pool_ = std::make_unique<multithreaded_dsp_processor>(config.max_threads);
-        thread_pool_->start();
-        use_multithreading_ = true;
+        if(thread_pool_->start()) {
+            use_multithreading_ = true;
+            publish_snapshot();
+        }
     } else if(!config.enable_multithreading && use_multithreading_) {
         // 鍋滄澶氱嚎绋?
-        thread_pool_->stop();
         use_multithreading_ = false;
+        publish_snapshot();
+        thread_pool_->stop();
     }
 }
 
@@ -610,14 +740,16 @@ dsp_effect_params dsp_manager::create_default_compressor_params() {
     params.is_enabled = true;
     params.is_bypassed = false;
     params.cpu_usage_estimate = 8.0f;
-    params.latency_ms = 2.0;
+    params.latency_ms = 0.0;
     
     params.config_params = {
         {"bypass", "Bypass", 0.0f, 0.0f, 1.0f, 1.0f},
         {"threshold", "Threshold", -20.0f, -60.0f, 0.0f, 1.0f},
         {"ratio", "Ratio", 4.0f, 1.0f, 20.0f, 0.1f},
         {"attack", "Attack", 10.0f, 0.1f, 100.0f, 0.1f},
-        {"release", "Release", 100.0f, 10.0f, 1000.0f, 1.0f}
+        {"release", "Release", 100.0f, 10.0f, 1000.0f, 1.0f},
+        {"knee", "Knee", 6.0f, 0.0f, 24.0f, 0.5f},
+        {"makeup", "Makeup Gain", 0.0f, 0.0f, 24.0f, 0.1f}
     };
     
     return params;
@@ -661,13 +793,15 @@ dsp_effect_params dsp_manager::create_default_convolver_params() {
     params.type = dsp_effect_type::convolver;
     params.is_enabled = true;
     params.is_bypassed = false;
-    params.cpu_usage_estimate = 30.0f;
-    params.latency_ms = 50.0;
+    params.cpu_usage_estimate = 5.0f;
+    params.latency_ms = 0.0;            // One block, set when a response is loaded
     
     params.config_params = {
         {"bypass", "Bypass", 0.0f, 0.0f, 1.0f, 1.0f},
         {"impulse_response", "Impulse Response", 0.0f, 0.0f, 1.0f, 1.0f},
-        {"mix", "Mix Level", 0.5f, 0.0f, 1.0f, 0.01f}
+        {"mix", "Mix Level", 1.0f, 0.0f, 1.0f, 0.01f},
+        {"block_size", "Block Size", 256.0f, 16.0f, 8192.0f, 16.0f},
+        {"max_partition", "Max Partition", 16384.0f, 16.0f, 65536.0f, 16.0f}
     };
     
     return params;
@@ -679,7 +813,7 @@ dsp_effect_params dsp_manager::create_default_crossfeed_params() {
     params.is_enabled = true;
     params.is_bypassed = false;
     params.cpu_usage_estimate = 3.0f;
-    params.latency_ms = 1.0;
+    params.latency_ms = 0.0;
     
     params.config_params = {
         {"bypass", "Bypass", 0.0f, 0.0f, 1.0f, 1.0f},
@@ -737,4 +871,46 @@ std::vector<std::string> dsp_manager::get_performance_warnings() const {
     return warnings;
 }
 
+// multithreaded_dsp_processor
+
+multithreaded_dsp_processor::multithreaded_dsp_processor(size_t num_threads)
+    : num_threads_(num_threads), total_tasks_processed_(0) {
+}
+
+multithreaded_dsp_processor::~multithreaded_dsp_processor() {
+    stop();
+}
+
+bool multithreaded_dsp_processor::start() {
+    if(scheduler_) {
+        return true;
+    }
+    
+    // The audio thread works too, so one thread fewer than requested
+    size_t threads = num_threads_ > 0 ? num_threads_ - 1 : 0;
+    try {
+        scheduler_ = std::make_unique<mp::core::WorkStealingScheduler>(threads, MAX_TASKS);
+    } catch(const std::system_error& e) {
+        std::cerr << "[DSPManager] Cannot start worker threads: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void multithreaded_dsp_processor::stop() {
+    scheduler_.reset();
+}
+
+bool multithreaded_dsp_processor::run(mp::core::TaskGraph& graph) {
+    if(!scheduler_ || !scheduler_->run(graph)) {
+        return false;
+    }
+    total_tasks_processed_.fetch_add(graph.size(), std::memory_order_relaxed);
+    return true;
+}
+
+uint64_t multithreaded_dsp_processor::get_steal_count() const {
+    return scheduler_ ? scheduler_->steal_count() : 0;
+}
+
 } // namespace fb2k
\ No newline at end of file
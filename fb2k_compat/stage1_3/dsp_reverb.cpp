@@ -6,24 +6,34 @@
 
 namespace fb2k {
 
-// 鎴块棿娣峰搷寮曟搸瀹炵幇
-room_reverb_engine::room_reverb_engine(const reverb_parameters& params, uint32_t sample_rate)
-    : reverb_engine(params, sample_rate) {
+// Shared by the engines: LFO plus noise on the wet signal
+void reverb_engine::apply_modulation(audio_chunk& chunk) {
+    if(!modulation_ || !params_.enable_modulation) return;
+    
+    float* data = chunk.get_data();
+    size_t total_samples = chunk.get_sample_count() * chunk.get_channels();
+    
+    for(size_t i = 0; i < total_samples; ++i) {
+        float modulation = modulation_->process();
+        data[i] *= (1.0f + modulation * params_.modulation_depth);
+    }
+}
+
+// Room reverb: early reflections, then parallel combs into serial allpasses
+room_reverb_engine::room_reverb_engine(const reverb_parameters& params, uint32_t sample_rate,
+                                       uint32_t channels)
+    : reverb_engine(params, sample_rate, channels) {
     
     calculate_delays();
     initialize_filters();
     
-    // 鍒涘缓鏃╂湡鍙嶅皠
     std::vector<size_t> early_delays = {static_cast<size_t>(0.001f * sample_rate),
-                                       static_cast<size_t>(0.002f * sample_rate),
-                                       static_cast<size_t>(0.003f * sample_rate),
-                                       static_cast<size_t>(0.005f * sample_rate)};
-    
+                                        static_cast<size_t>(0.002f * sample_rate),
+                                        static_cast<size_t>(0.003f * sample_rate),
+                                        static_cast<size_t>(0.005f * sample_rate)};
     std::vector<float> early_gains = {0.8f, 0.6f, 0.4f, 0.2f};
+    early_reflections_.assign(channels_, early_reflections(early_delays, early_gains));
     
-    early_reflections_ = std::make_unique<early_reflections>(early_delays, early_gains);
-    
-    // 鍒涘缓璋冨埗鍣?
     modulation_ = std::make_unique<modulator>(params.modulation_rate, params.modulation_depth, sample_rate);
 }
 
@@ -31,24 +41,18 @@ void room_reverb_engine::calculate_delays() {
     float room_size_factor = params_.room_size;
     float sample_rate = static_cast<float>(sample_rate_);
     
-    // 姊崇姸婊ゆ尝鍣ㄥ欢杩燂紙鍩轰簬鎴块棿澶у皬锛?
     comb_delays_.resize(8);
     comb_feedbacks_.resize(8);
     
-    // 鍩虹寤惰繜鏃堕棿锛堟绉掕浆鎹负閲囨牱锛?
-    float base_delay_ms = 20.0f + 80.0f * room_size_factor; // 20-100ms
-    
-    // 璐ㄦ暟寤惰繜鏃堕棿锛堥伩鍏嶈皭鎸級
+    // Mutually prime comb lengths, tuned at 44.1 kHz
     static const size_t prime_delays[8] = {1553, 1613, 1759, 1831, 1933, 2011, 2087, 2153};
     
     for(size_t i = 0; i < 8; ++i) {
-        // 鍩轰簬鎴块棿澶у皬鐨勫欢杩熷彉鍖?
         float size_factor = 0.8f + 0.4f * (i / 7.0f) * room_size_factor;
-        comb_delays_[i] = static_cast<size_t>(prime_delays[i] * size_factor);
-        comb_feedbacks_[i] = 0.84f - 0.2f * room_size_factor; // 鍙嶉闅忔埧闂村澶ц€屽噺灏?
+        comb_delays_[i] = static_cast<size_t>(prime_delays[i] * size_factor * sample_rate / 44100.0f);
+        comb_feedbacks_[i] = 0.84f - 0.2f * room_size_factor;
     }
     
-    // 鍏ㄩ€氭护娉㈠櫒寤惰繜
     allpass_delays_.resize(4);
     for(size_t i = 0; i < 4; ++i) {
         allpass_delays_[i] = static_cast<size_t>((100.0f + 50.0f * i) * sample_rate / 1000.0f);
@@ -56,98 +60,57 @@ void room_reverb_engine::calculate_delays() {
 }
 
 void room_reverb_engine::initialize_filters() {
-    // 鍒涘缓姊崇姸婊ゆ尝鍣?
-    comb_filters_.clear();
-    comb_filters_.reserve(comb_delays_.size());
-    
+    std::vector<comb_filter> combs;
+    combs.reserve(comb_delays_.size());
     for(size_t i = 0; i < comb_delays_.size(); ++i) {
-        float feedback = comb_feedbacks_[i];
-        float damping = params_.damping;
-        
-        comb_filters_.push_back(std::make_unique<comb_filter>(comb_delays_[i], feedback, damping));
+        combs.emplace_back(comb_delays_[i], comb_feedbacks_[i], params_.damping);
     }
     
-    // 鍒涘缓鍏ㄩ€氭护娉㈠櫒
-    allpass_filters_.clear();
-    allpass_filters_.reserve(allpass_delays_.size());
-    
+    std::vector<allpass_filter> allpasses;
+    allpasses.reserve(allpass_delays_.size());
     for(size_t i = 0; i < allpass_delays_.size(); ++i) {
-        allpass_filters_.push_back(std::make_unique<allpass_filter>(allpass_delays_[i], 0.5f));
+        allpasses.emplace_back(allpass_delays_[i], 0.5f);
     }
+    
+    comb_filters_.assign(channels_, combs);
+    allpass_filters_.assign(channels_, allpasses);
 }
 
 void room_reverb_engine::process(audio_chunk& chunk) {
     if(chunk.is_empty()) return;
     
-    // 淇濆瓨鍘熷鏁版嵁鐢ㄤ簬骞蹭俊鍙锋贩鍚?
-    audio_chunk original_chunk;
-    original_chunk.copy(chunk);
-    
-    // 澶勭悊鏃╂湡鍙嶅皠
+    // Wet only; dsp_reverb_advanced mixes in the dry signal
     process_early_reflections(chunk);
-    
-    // 澶勭悊娣峰搷灏鹃煶
     process_reverb_tail(chunk);
-    
-    // 搴旂敤璋冨埗
     apply_modulation(chunk);
-    
-    // 娣峰悎骞叉箍淇″彿
-    float wet_level = params_.wet_level;
-    float dry_level = params_.dry_level;
-    float width = params_.width;
-    
-    float* data = chunk.get_data();
-    const float* original_data = original_chunk.get_data();
-    size_t total_samples = chunk.get_sample_count() * chunk.get_channels();
-    
-    for(size_t i = 0; i < total_samples; ++i) {
-        float wet = data[i];
-        float dry = original_data[i];
-        
-        // 搴旂敤绔嬩綋澹板搴︼紙绠€鍖栫増锛?
-        if(chunk.get_channels() == 2) {
-            size_t channel = i % 2;
-            float width_factor = (channel == 0) ? (1.0f + width) / 2.0f : (1.0f - width) / 2.0f;
-            wet *= width_factor;
-        }
-        
-        // 娣峰悎骞叉箍淇″彿
-        data[i] = dry * dry_level + wet * wet_level;
-    }
 }
 
 void room_reverb_engine::reset() {
-    if(early_reflections_) {
-        early_reflections_->reset();
+    for(auto& reflections : early_reflections_) {
+        reflections.reset();
     }
-    
-    for(auto& filter : comb_filters_) {
-        if(filter) filter->reset();
+    for(auto& bank : comb_filters_) {
+        for(auto& comb : bank) comb.reset();
     }
-    
-    for(auto& filter : allpass_filters_) {
-        if(filter) filter->reset();
+    for(auto& bank : allpass_filters_) {
+        for(auto& allpass : bank) allpass.reset();
     }
-    
     if(modulation_) {
         modulation_->reset();
     }
 }
 
 void room_reverb_engine::process_early_reflections(audio_chunk& chunk) {
-    if(!early_reflections_) return;
-    
     float* data = chunk.get_data();
     size_t samples = chunk.get_sample_count();
-    uint32_t channels = chunk.get_channels();
+    uint32_t channels = std::min<uint32_t>(chunk.get_channels(), channels_);
+    uint32_t stride = chunk.get_channels();
     
-    // 澶勭悊姣忎釜澹伴亾
     for(uint32_t ch = 0; ch < channels; ++ch) {
+        early_reflections& reflections = early_reflections_[ch];
         for(size_t i = 0; i < samples; ++i) {
-            size_t idx = i * channels + ch;
-            float reflection = early_reflections_->process(data[idx], ch);
-            data[idx] += reflection * 0.3f; // 娣峰悎鏃╂湡鍙嶅皠
+            size_t idx = i * stride + ch;
+            data[idx] += reflections.process(data[idx]) * 0.3f;
         }
     }
 }
@@ -155,32 +118,27 @@ void room_reverb_engine::process_early_reflections(audio_chunk& chunk) {
 void room_reverb_engine::process_reverb_tail(audio_chunk& chunk) {
     float* data = chunk.get_data();
     size_t samples = chunk.get_sample_count();
-    uint32_t channels = chunk.get_channels();
+    uint32_t channels = std::min<uint32_t>(chunk.get_channels(), channels_);
+    uint32_t stride = chunk.get_channels();
+    float comb_scale = comb_delays_.empty() ? 0.0f : 1.0f / comb_delays_.size();
     
-    // 澶勭悊姣忎釜澹伴亾
+    // Channels are independent, so each runs its own bank end to end
     for(uint32_t ch = 0; ch < channels; ++ch) {
+        std::vector<comb_filter>& combs = comb_filters_[ch];
+        std::vector<allpass_filter>& allpasses = allpass_filters_[ch];
+        
         for(size_t i = 0; i < samples; ++i) {
-            size_t idx = i * channels + ch;
+            size_t idx = i * stride + ch;
             float input = data[idx];
             float output = 0.0f;
             
-            // 閫氳繃鎵€鏈夋⒊鐘舵护娉㈠櫒
-            for(auto& comb : comb_filters_) {
-                if(comb) {
-                    output += comb->process(input);
-                }
-            }
-            
-            // 褰掍竴鍖?
-            if(!comb_filters_.empty()) {
-                output /= comb_filters_.size();
+            for(auto& comb : combs) {
+                output += comb.process(input);
             }
+            output *= comb_scale;
             
-            // 閫氳繃鍏ㄩ€氭护娉㈠櫒
-            for(auto& allpass : allpass_filters_) {
-                if(allpass) {
-                    output = allpass->process(output);
-                }
+            for(auto& allpass : allpasses) {
+                output = allpass.process(output);
             }
             
             data[idx] = output;
@@ -188,26 +146,14 @@ void room_reverb_engine::process_reverb_tail(audio_chunk& chunk) {
     }
 }
 
-void room_reverb_engine::apply_modulation(audio_chunk& chunk) {
-    if(!modulation_ || !params_.enable_modulation) return;
-    
-    float* data = chunk.get_data();
-    size_t total_samples = chunk.get_sample_count() * chunk.get_channels();
-    
-    for(size_t i = 0; i < total_samples; ++i) {
-        float modulation = modulation_->process();
-        data[i] *= (1.0f + modulation * params_.modulation_depth);
-    }
-}
-
-// 澶у巺娣峰搷寮曟搸
-hall_reverb_engine::hall_reverb_engine(const reverb_parameters& params, uint32_t sample_rate)
-    : reverb_engine(params, sample_rate) {
+// Hall reverb: longer and more combs and allpasses than the room
+hall_reverb_engine::hall_reverb_engine(const reverb_parameters& params, uint32_t sample_rate,
+                                       uint32_t channels)
+    : reverb_engine(params, sample_rate, channels) {
     
     calculate_hall_delays();
     initialize_hall_filters();
     
-    // 鍒涘缓璋冨埗鍣?
     modulation_ = std::make_unique<modulator>(params.modulation_rate, params.modulation_depth, sample_rate);
 }
 
@@ -215,11 +161,9 @@ void hall_reverb_engine::calculate_hall_delays() {
     float room_size_factor = params_.room_size;
     float sample_rate = static_cast<float>(sample_rate_);
     
-    // 澶у巺闇€瑕佹洿闀跨殑寤惰繜鏃堕棿
-    comb_delays_.resize(12); // 鏇村鐨勬⒊鐘舵护娉㈠櫒
+    comb_delays_.resize(12);
     comb_feedbacks_.resize(12);
     
-    // 鏇村ぇ鐨勫欢杩熸椂闂磋寖鍥?
     static const size_t hall_delays[12] = {
         1777, 1847, 1913, 1993, 2053, 2111,
         2179, 2237, 2293, 2357, 2411, 2473
@@ -227,11 +171,10 @@ void hall_reverb_engine::calculate_hall_delays() {
     
     for(size_t i = 0; i < 12; ++i) {
         float size_factor = 0.9f + 0.2f * (i / 11.0f) * room_size_factor;
-        comb_delays_[i] = static_cast<size_t>(hall_delays[i] * size_factor);
+        comb_delays_[i] = static_cast<size_t>(hall_delays[i] * size_factor * sample_rate / 44100.0f);
         comb_feedbacks_[i] = 0.88f - 0.15f * room_size_factor;
     }
     
-    // 鏇村鐨勫叏閫氭护娉㈠櫒
     allpass_delays_.resize(6);
     for(size_t i = 0; i < 6; ++i) {
         allpass_delays_[i] = static_cast<size_t>((150.0f + 75.0f * i) * sample_rate / 1000.0f);
@@ -239,99 +182,79 @@ void hall_reverb_engine::calculate_hall_delays() {
 }
 
 void hall_reverb_engine::initialize_hall_filters() {
-    // 鍒涘缓鏇村鐨勬⒊鐘舵护娉㈠櫒
-    comb_filters_.clear();
-    comb_filters_.reserve(comb_delays_.size());
-    
+    std::vector<comb_filter> combs;
+    combs.reserve(comb_delays_.size());
     for(size_t i = 0; i < comb_delays_.size(); ++i) {
-        float feedback = comb_feedbacks_[i];
-        float damping = params_.damping;
-        
-        comb_filters_.push_back(std::make_unique<comb_filter>(comb_delays_[i], feedback, damping));
+        combs.emplace_back(comb_delays_[i], comb_feedbacks_[i], params_.damping);
     }
     
-    // 鍒涘缓鏇村鐨勫叏閫氭护娉㈠櫒
-    allpass_filters_.clear();
-    allpass_filters_.reserve(allpass_delays_.size());
-    
+    std::vector<allpass_filter> allpasses;
+    allpasses.reserve(allpass_delays_.size());
     for(size_t i = 0; i < allpass_delays_.size(); ++i) {
-        allpass_filters_.push_back(std::make_unique<allpass_filter>(allpass_delays_[i], 0.6f));
+        allpasses.emplace_back(allpass_delays_[i], 0.6f);
     }
+    
+    comb_filters_.assign(channels_, combs);
+    allpass_filters_.assign(channels_, allpasses);
 }
 
 void hall_reverb_engine::process(audio_chunk& chunk) {
     if(chunk.is_empty()) return;
     
-    // 淇濆瓨鍘熷鏁版嵁
-    audio_chunk original_chunk;
-    original_chunk.copy(chunk);
-    
-    // 澶勭悊閫昏緫涓庢埧闂存贩鍝嶇被浼硷紝浣嗕娇鐢ㄦ洿澶氱殑婊ゆ尝鍣?
     float* data = chunk.get_data();
     size_t samples = chunk.get_sample_count();
-    uint32_t channels = chunk.get_channels();
+    uint32_t channels = std::min<uint32_t>(chunk.get_channels(), channels_);
+    uint32_t stride = chunk.get_channels();
+    float comb_scale = comb_delays_.empty() ? 0.0f : 1.0f / comb_delays_.size();
     
-    // 澶勭悊姣忎釜澹伴亾
     for(uint32_t ch = 0; ch < channels; ++ch) {
+        std::vector<comb_filter>& combs = comb_filters_[ch];
+        std::vector<allpass_filter>& allpasses = allpass_filters_[ch];
+        
         for(size_t i = 0; i < samples; ++i) {
-            size_t idx = i * channels + ch;
+            size_t idx = i * stride + ch;
             float input = data[idx];
             float output = 0.0f;
             
-            // 閫氳繃鎵€鏈夋⒊鐘舵护娉㈠櫒
-            for(auto& comb : comb_filters_) {
-                if(comb) {
-                    output += comb->process(input);
-                }
+            for(auto& comb : combs) {
+                output += comb.process(input);
             }
+            output *= comb_scale;
             
-            // 褰掍竴鍖?
-            if(!comb_filters_.empty()) {
-                output /= comb_filters_.size();
-            }
-            
-            // 閫氳繃鎵€鏈夊叏閫氭护娉㈠櫒
-            for(auto& allpass : allpass_filters_) {
-                if(allpass) {
-                    output = allpass->process(output);
-                }
+            for(auto& allpass : allpasses) {
+                output = allpass.process(output);
             }
             
             data[idx] = output;
         }
     }
     
-    // 搴旂敤璋冨埗鍜屾贩鍚堬紙涓庢埧闂存贩鍝嶇被浼硷級
-    // ...锛堢渷鐣ラ噸澶嶄唬鐮侊級
+    apply_modulation(chunk);
 }
 
 void hall_reverb_engine::reset() {
-    // 閲嶇疆鎵€鏈夋护娉㈠櫒
-    for(auto& comb : comb_filters_) {
-        if(comb) comb->reset();
+    for(auto& bank : comb_filters_) {
+        for(auto& comb : bank) comb.reset();
     }
-    
-    for(auto& allpass : allpass_filters_) {
-        if(allpass) allpass->reset();
+    for(auto& bank : allpass_filters_) {
+        for(auto& allpass : bank) allpass.reset();
     }
-    
     if(modulation_) {
         modulation_->reset();
     }
 }
 
-// 鏉垮紡娣峰搷寮曟搸
-plate_reverb_engine::plate_reverb_engine(const reverb_parameters& params, uint32_t sample_rate)
-    : reverb_engine(params, sample_rate) {
+// Plate reverb: cross-channel diffusion, then a dense allpass chain
+plate_reverb_engine::plate_reverb_engine(const reverb_parameters& params, uint32_t sample_rate,
+                                         uint32_t channels)
+    : reverb_engine(params, sample_rate, channels) {
     
     initialize_diffusion_network();
     
-    // 鍒涘缓楂樺瘑搴﹁皟鍒?
     modulation_ = std::make_unique<modulator>(params.modulation_rate * 2.0f, params.modulation_depth, sample_rate);
 }
 
 void plate_reverb_engine::initialize_diffusion_network() {
-    // 鍒涘缓鎵╂暎鐭╅樀
     diffusion_matrix_ = {
         {0.5f, 0.3f, 0.1f, 0.1f},
         {0.1f, 0.5f, 0.3f, 0.1f},
@@ -339,12 +262,8 @@ void plate_reverb_engine::initialize_diffusion_network() {
         {0.3f, 0.1f, 0.1f, 0.5f}
     };
     
-    diffusion_state_.resize(4, 0.0f);
-    
-    // 鍒涘缓鍏ㄩ€氭护娉㈠櫒缃戠粶
-    allpass_filters_.clear();
+    diffusion_state_.assign(4, 0.0f);
     
-    // 楂樺瘑搴﹀叏閫氭护娉㈠櫒
     static const size_t plate_delays[16] = {
         149, 163, 181, 197, 211, 227, 241, 257,
         271, 283, 293, 307, 317, 331, 347, 359
@@ -352,65 +271,46 @@ void plate_reverb_engine::initialize_diffusion_network() {
     
     float sample_rate_factor = static_cast<float>(sample_rate_) / 44100.0f;
     
+    std::vector<allpass_filter> allpasses;
+    allpasses.reserve(16);
     for(size_t i = 0; i < 16; ++i) {
         size_t delay = static_cast<size_t>(plate_delays[i] * sample_rate_factor);
-        allpass_filters_.push_back(std::make_unique<allpass_filter>(delay, 0.7f));
+        allpasses.emplace_back(delay, 0.7f);
     }
+    allpass_filters_.assign(channels_, allpasses);
 }
 
 void plate_reverb_engine::process(audio_chunk& chunk) {
     if(chunk.is_empty()) return;
     
-    // 淇濆瓨鍘熷鏁版嵁
-    audio_chunk original_chunk;
-    original_chunk.copy(chunk);
-    
-    // 閫氳繃鎵╂暎缃戠粶
     process_diffusion_network(chunk);
     
-    // 閫氳繃鍏ㄩ€氭护娉㈠櫒缃戠粶
     float* data = chunk.get_data();
     size_t samples = chunk.get_sample_count();
-    uint32_t channels = chunk.get_channels();
+    uint32_t channels = std::min<uint32_t>(chunk.get_channels(), channels_);
+    uint32_t stride = chunk.get_channels();
     
     for(uint32_t ch = 0; ch < channels; ++ch) {
+        std::vector<allpass_filter>& allpasses = allpass_filters_[ch];
+        
         for(size_t i = 0; i < samples; ++i) {
-            size_t idx = i * channels + ch;
-            float input = data[idx];
-            float output = input;
+            size_t idx = i * stride + ch;
+            float output = data[idx];
             
-            // 閫氳繃鎵€鏈夊叏閫氭护娉㈠櫒
-            for(auto& allpass : allpass_filters_) {
-                if(allpass) {
-                    output = allpass->process(output);
-                }
+            for(auto& allpass : allpasses) {
+                output = allpass.process(output);
             }
             
             data[idx] = output;
         }
     }
     
-    // 搴旂敤璋冨埗
     apply_modulation(chunk);
-    
-    // 娣峰悎骞叉箍淇″彿
-    float wet_level = params_.wet_level;
-    float dry_level = params_.dry_level;
-    
-    float* final_data = chunk.get_data();
-    const float* original_data = original_chunk.get_data();
-    size_t total_samples = chunk.get_sample_count() * chunk.get_channels();
-    
-    for(size_t i = 0; i < total_samples; ++i) {
-        float wet = final_data[i];
-        float dry = original_data[i];
-        final_data[i] = dry * dry_level + wet * wet_level;
-    }
 }
 
 void plate_reverb_engine::reset() {
-    for(auto& allpass : allpass_filters_) {
-        if(allpass) allpass->reset();
+    for(auto& bank : allpass_filters_) {
+        for(auto& allpass : bank) allpass.reset();
     }
     
     std::fill(diffusion_state_.begin(), diffusion_state_.end(), 0.0f);
@@ -424,40 +324,70 @@ void plate_reverb_engine::process_diffusion_network(audio_chunk& chunk) {
     float* data = chunk.get_data();
     size_t samples = chunk.get_sample_count();
     uint32_t channels = chunk.get_channels();
+    uint32_t mixed = std::min<uint32_t>(channels, 4);
     
-    // 绠€鍖栫殑鎵╂暎缃戠粶澶勭悊
+    // Mix the first four channels of each frame through the matrix
+    float frame[4];
     for(size_t i = 0; i < samples; ++i) {
-        for(uint32_t ch = 0; ch < channels && ch < 4; ++ch) {
-            size_t idx = i * channels + ch;
-            float input = data[idx];
-            
-            // 搴旂敤鎵╂暎鐭╅樀
+        float* x = data + i * channels;
+        std::copy(x, x + mixed, frame);
+        for(uint32_t ch = 0; ch < mixed; ++ch) {
             float output = 0.0f;
-            for(size_t j = 0; j < 4 && j < channels; ++j) {
-                if(i < samples) {
-                    size_t src_idx = i * channels + j;
-                    output += diffusion_matrix_[ch][j] * data[src_idx];
-                }
+            for(uint32_t j = 0; j < mixed; ++j) {
+                output += diffusion_matrix_[ch][j] * frame[j];
             }
-            
-            // 鐘舵€佹洿鏂?
             diffusion_state_[ch] = output;
-            data[idx] = diffusion_state_[ch];
+            x[ch] = output;
         }
     }
 }
 
+// FDN reverb
+fdn_reverb_engine::fdn_reverb_engine(const reverb_parameters& params, uint32_t sample_rate,
+                                     uint32_t channels, size_t lines)
+    : reverb_engine(params, sample_rate, channels), lines_(lines) {
+    
+    fdn_.configure(sample_rate, static_cast<uint16_t>(channels), lines_, params_.room_size);
+    fdn_.set_decay(params_.decay_time, params_.damping);
+    
+    modulation_ = std::make_unique<modulator>(params.modulation_rate, params.modulation_depth, sample_rate);
+}
+
+void fdn_reverb_engine::process(audio_chunk& chunk) {
+    if(chunk.is_empty() || chunk.get_channels() != fdn_.channels()) return;
+    
+    fdn_.process(chunk.get_data(), chunk.get_sample_count());
+    apply_modulation(chunk);
+}
+
+void fdn_reverb_engine::reset() {
+    fdn_.reset();
+    if(modulation_) {
+        modulation_->reset();
+    }
+}
+
+void fdn_reverb_engine::set_params(const reverb_parameters& params) {
+    bool resize = params.room_size != params_.room_size;
+    params_ = params;
+    
+    if(resize) {
+        fdn_.configure(sample_rate_, static_cast<uint16_t>(channels_), lines_, params_.room_size);
+    }
+    fdn_.set_decay(params_.decay_time, params_.damping);
+}
+
 // DSP娣峰搷鏁堟灉鍣ㄥ疄鐜?
 dsp_reverb_advanced::dsp_reverb_advanced() 
-    : dsp_effect_advanced(create_default_reverb_params()) {
-    create_reverb_engine();
+    : dsp_effect_advanced(create_default_reverb_params()), sample_rate_(44100), channels_(2) {
+    create_reverb_engine(sample_rate_, channels_);
     create_modulation();
     create_filters();
 }
 
 dsp_reverb_advanced::dsp_reverb_advanced(const dsp_effect_params& params)
-    : dsp_effect_advanced(params) {
-    create_reverb_engine();
+    : dsp_effect_advanced(params), sample_rate_(44100), channels_(2) {
+    create_reverb_engine(sample_rate_, channels_);
     create_modulation();
     create_filters();
 }
@@ -474,14 +404,17 @@ bool dsp_reverb_advanced::instantiate(audio_chunk& chunk, uint32_t sample_rate,
         return false;
     }
     
-    // 鏇存柊娣峰搷寮曟搸
-    if(engine_) {
+    // Delay lines and per-channel banks are sized for the stream format
+    if(!engine_ || sample_rate != sample_rate_ || channels != channels_) {
+        create_reverb_engine(sample_rate, channels);
+    } else {
         engine_->set_params(params_);
     }
     
-    // 鍒涘缓缂撳啿
-    wet_buffer_ = audio_chunk_utils::create_chunk(4096, channels, sample_rate);
-    dry_buffer_ = audio_chunk_utils::create_chunk(4096, channels, sample_rate);
+    // Dry copy for when no chain arena is attached
+    if(dry_fallback_.size() < DRY_FALLBACK_FRAMES * channels) {
+        dry_fallback_.assign(DRY_FALLBACK_FRAMES * channels, 0.0f);
+    }
     
     return true;
 }
@@ -596,7 +529,7 @@ void dsp_reverb_advanced::load_room_preset(float room_size) {
     params_.decay_time = 0.5f + 1.5f * room_size;
     params_.diffusion = 0.6f + 0.3f * room_size;
     
-    create_reverb_engine();
+    create_reverb_engine(sample_rate_, channels_);
 }
 
 void dsp_reverb_advanced::load_hall_preset(float room_size) {
@@ -608,7 +541,7 @@ void dsp_reverb_advanced::load_hall_preset(float room_size) {
     params_.diffusion = 0.7f + 0.2f * room_size;
     params_.predelay = 10.0f + 20.0f * room_size;
     
-    create_reverb_engine();
+    create_reverb_engine(sample_rate_, channels_);
 }
 
 void dsp_reverb_advanced::load_plate_preset() {
@@ -621,7 +554,7 @@ void dsp_reverb_advanced::load_plate_preset() {
     params_.modulation_rate = 0.5f;
     params_.modulation_depth = 0.2f;
     
-    create_reverb_engine();
+    create_reverb_engine(sample_rate_, channels_);
 }
 
 void dsp_reverb_advanced::load_cathedral_preset() {
@@ -634,7 +567,7 @@ void dsp_reverb_advanced::load_cathedral_preset() {
     params_.predelay = 50.0f;
     params_.width = 1.0f;
     
-    create_reverb_engine();
+    create_reverb_engine(sample_rate_, channels_);
 }
 
 void dsp_reverb_advanced::set_small_room() {
@@ -662,71 +595,88 @@ void dsp_reverb_advanced::process_chunk_internal(audio_chunk& chunk, abort_callb
         return;
     }
     
-    // 淇濆瓨鍘熷鏁版嵁
-    audio_chunk original_chunk;
-    original_chunk.copy(chunk);
+    // The chunk itself becomes the wet path; only the dry signal is copied
+    const float* dry = acquire_dry_copy(chunk);
     
-    // 搴旂敤杈撳叆婊ゆ尝
     if(params_.enable_filtering && input_filter_) {
         apply_input_filtering(chunk);
     }
     
-    // 鍒涘缓婀夸俊鍙风紦鍐?
-    if(!wet_buffer_ || wet_buffer_->get_sample_count() < chunk.get_sample_count() ||
-       wet_buffer_->get_channels() != chunk.get_channels()) {
-        wet_buffer_ = audio_chunk_utils::create_chunk(chunk.get_sample_count(), 
-                                                     chunk.get_channels(), 
-                                                     chunk.get_sample_rate());
-    }
+    engine_->process(chunk);
     
-    wet_buffer_->copy(chunk);
-    
-    // 澶勭悊娣峰搷
-    engine_->process(*wet_buffer_);
-    
-    // 搴旂敤璋冨埗
     if(params_.enable_modulation && modulation_) {
-        apply_modulation(*wet_buffer_);
+        apply_modulation(chunk);
     }
     
-    // 搴旂敤杈撳嚭婊ゆ尝
     if(params_.enable_filtering && output_filter_) {
-        apply_output_filtering(*wet_buffer_);
+        apply_output_filtering(chunk);
     }
     
-    // 娣峰悎骞叉箍淇″彿
-    mix_wet_dry_signals(chunk, original_chunk);
-    
-    // 搴旂敤绔嬩綋澹板搴?
+    mix_wet_dry_signals(chunk, dry);
     apply_stereo_width(chunk);
 }
 
+const float* dsp_reverb_advanced::acquire_dry_copy(const audio_chunk& chunk) {
+    if(arena_) {
+        if(const float* dry = arena_->acquire_copy(chunk)) {
+            return dry;
+        }
+    }
+    
+    // Grows only for blocks larger than instantiate() planned for
+    size_t samples = chunk.get_sample_count() * chunk.get_channels();
+    if(dry_fallback_.size() < samples) {
+        dry_fallback_.resize(samples);
+    }
+    std::memcpy(dry_fallback_.data(), chunk.get_data(), samples * sizeof(float));
+    return dry_fallback_.data();
+}
+
 void dsp_reverb_advanced::update_cpu_usage(float usage) {
     // 瀹炵幇CPU浣跨敤鐜囪绠?
     // 杩欓噷鍙互鏍规嵁澶勭悊鏃堕棿鍜岄噰鏍锋暟鏉ヤ及绠?
     set_cpu_usage(usage);
 }
 
-void dsp_reverb_advanced::create_reverb_engine() {
+void dsp_reverb_advanced::create_reverb_engine(uint32_t sample_rate, uint32_t channels) {
+    sample_rate_ = sample_rate;
+    channels_ = channels;
+    
     switch(params_.type) {
         case reverb_type::room:
-            engine_ = std::make_unique<room_reverb_engine>(params_, 44100); // 鍋囪鏍囧噯閲囨牱鐜?
+            engine_ = std::make_unique<room_reverb_engine>(params_, sample_rate, channels);
             break;
             
         case reverb_type::hall:
-            engine_ = std::make_unique<hall_reverb_engine>(params_, 44100);
+            engine_ = std::make_unique<hall_reverb_engine>(params_, sample_rate, channels);
             break;
             
         case reverb_type::plate:
-            engine_ = std::make_unique<plate_reverb_engine>(params_, 44100);
+            engine_ = std::make_unique<plate_reverb_engine>(params_, sample_rate, channels);
+            break;
+            
+        case reverb_type::fdn:
+            engine_ = std::make_unique<fdn_reverb_engine>(params_, sample_rate, channels, 8);
+            break;
+            
+        case reverb_type::cathedral:
+            engine_ = std::make_unique<fdn_reverb_engine>(params_, sample_rate, channels, 16);
             break;
             
         default:
-            engine_ = std::make_unique<room_reverb_engine>(params_, 44100);
+            engine_ = std::make_unique<room_reverb_engine>(params_, sample_rate, channels);
             break;
     }
 }
 
+void dsp_reverb_advanced::set_reverb_type(reverb_type type) {
+    if(params_.type == type && engine_) {
+        return;
+    }
+    params_.type = type;
+    create_reverb_engine(sample_rate_, channels_);
+}
+
 void dsp_reverb_advanced::create_modulation() {
     modulation_ = std::make_unique<modulator>(params_.modulation_rate, params_.modulation_depth, 44100);
 }
@@ -779,9 +729,8 @@ void dsp_reverb_advanced::apply_modulation(audio_chunk& chunk) {
     }
 }
 
-void dsp_reverb_advanced::mix_wet_dry_signals(audio_chunk& chunk, const audio_chunk& dry_chunk) {
+void dsp_reverb_advanced::mix_wet_dry_signals(audio_chunk& chunk, const float* dry_data) {
     float* wet_data = chunk.get_data();
-    const float* dry_data = dry_chunk.get_data();
     size_t total_samples = chunk.get_sample_count() * chunk.get_channels();
     
     float wet_level = params_.wet_level;
@@ -971,6 +920,8 @@ std::string generate_reverb_report(const dsp_reverb_advanced& reverb) {
         case reverb_type::room: report << "Room"; break;
         case reverb_type::hall: report << "Hall"; break;
         case reverb_type::plate: report << "Plate"; break;
+        case reverb_type::fdn: report << "FDN"; break;
+        case reverb_type::cathedral: report << "Cathedral (FDN)"; break;
         default: report << "Unknown"; break;
     }
     
@@ -4,6 +4,7 @@
 // 涓撲笟绾ф贩鍝嶆晥鏋滃櫒锛屾敮鎸佸绉嶆贩鍝嶇畻娉?
 
 #include "dsp_manager.h"
+#include "../../core/fdn_reverb.h"
 #include <vector>
 #include <array>
 #include <random>
@@ -18,6 +19,7 @@ enum class reverb_type {
     plate,       // 鏉垮紡娣峰搷
     spring,      // 寮圭哀娣峰搷
     cathedral,   // 澶ф暀鍫傛贩鍝?
+    fdn,         // Feedback delay network, 8 or 16 lines
     stadium,     // 浣撹偛鍦烘贩鍝?
     custom       // 鑷畾涔夋贩鍝?
 };
@@ -141,44 +143,33 @@ class early_reflections {
 private:
     std::vector<size_t> delay_times_;
     std::vector<float> delay_gains_;
-    std::vector<std::vector<float>> delay_buffers_;
-    std::vector<size_t> delay_positions_;
+    std::vector<float> buffer_;         // One channel, longest tap + 1
+    size_t position_;
     
 public:
     early_reflections(const std::vector<size_t>& delays, const std::vector<float>& gains)
-        : delay_times_(delays), delay_gains_(gains) {
-        
-        delay_buffers_.resize(delays.size());
-        delay_positions_.resize(delays.size(), 0);
-        
-        for(size_t i = 0; i < delays.size(); ++i) {
-            delay_buffers_[i].resize(delays[i], 0.0f);
-        }
+        : delay_times_(delays), delay_gains_(gains), position_(0) {
+        size_t longest = delays.empty() ? 0 : *std::max_element(delays.begin(), delays.end());
+        buffer_.resize(longest + 1, 0.0f);
     }
     
-    float process(float input, size_t channel) {
-        if(channel >= delay_buffers_.size()) return 0.0f;
+    // Sum of the delayed taps for one channel's next sample
+    float process(float input) {
+        buffer_[position_] = input;
         
         float output = 0.0f;
-        
-        for(size_t i = 0; i < delay_buffers_[channel].size(); ++i) {
-            if(i < delay_gains_.size()) {
-                output += delay_buffers_[channel][i] * delay_gains_[i];
-            }
+        size_t size = buffer_.size();
+        for(size_t i = 0; i < delay_times_.size() && i < delay_gains_.size(); ++i) {
+            output += buffer_[(position_ + size - delay_times_[i]) % size] * delay_gains_[i];
         }
         
-        // 鏇存柊寤惰繜绾?
-        delay_buffers_[channel][delay_positions_[channel]] = input;
-        delay_positions_[channel] = (delay_positions_[channel] + 1) % delay_buffers_[channel].size();
-        
+        position_ = (position_ + 1) % size;
         return output;
     }
     
     void reset() {
-        for(auto& buffer : delay_buffers_) {
-            std::fill(buffer.begin(), buffer.end(), 0.0f);
-        }
-        std::fill(delay_positions_.begin(), delay_positions_.end(), 0);
+        std::fill(buffer_.begin(), buffer_.end(), 0.0f);
+        position_ = 0;
     }
 };
 
@@ -222,41 +213,41 @@ class reverb_engine {
 protected:
     reverb_parameters params_;
     uint32_t sample_rate_;
+    uint32_t channels_;
+    std::unique_ptr<modulator> modulation_;
     
 public:
-    reverb_engine(const reverb_parameters& params, uint32_t sample_rate)
-        : params_(params), sample_rate_(sample_rate) {}
+    reverb_engine(const reverb_parameters& params, uint32_t sample_rate, uint32_t channels)
+        : params_(params), sample_rate_(sample_rate), channels_(channels) {}
     
     virtual ~reverb_engine() = default;
     
+    // Replaces the chunk with the wet signal; the caller mixes in the dry
     virtual void process(audio_chunk& chunk) = 0;
     virtual void reset() = 0;
     virtual double get_latency() const = 0;
     
     const reverb_parameters& get_params() const { return params_; }
-    void set_params(const reverb_parameters& params) { params_ = params; }
+    virtual void set_params(const reverb_parameters& params) { params_ = params; }
+    
+protected:
+    void apply_modulation(audio_chunk& chunk);
 };
 
 // 鎴块棿娣峰搷寮曟搸
 class room_reverb_engine : public reverb_engine {
 private:
-    // 鏃╂湡鍙嶅皠
-    std::unique_ptr<early_reflections> early_reflections_;
+    // Every bank is per channel, [channel][filter]
+    std::vector<early_reflections> early_reflections_;
+    std::vector<std::vector<comb_filter>> comb_filters_;
+    std::vector<std::vector<allpass_filter>> allpass_filters_;
     
-    // 娣峰搷灏鹃煶
-    std::vector<std::unique_ptr<comb_filter>> comb_filters_;
-    std::vector<std::unique_ptr<allpass_filter>> allpass_filters_;
-    
-    // 璋冨埗
-    std::unique_ptr<modulator> modulator_;
-    
-    // 鍙傛暟
     std::vector<size_t> comb_delays_;
     std::vector<size_t> allpass_delays_;
     std::vector<float> comb_feedbacks_;
     
 public:
-    room_reverb_engine(const reverb_parameters& params, uint32_t sample_rate);
+    room_reverb_engine(const reverb_parameters& params, uint32_t sample_rate, uint32_t channels);
     
     void process(audio_chunk& chunk) override;
     void reset() override;
@@ -267,19 +258,21 @@ private:
     void initialize_filters();
     void process_early_reflections(audio_chunk& chunk);
     void process_reverb_tail(audio_chunk& chunk);
-    void apply_modulation(audio_chunk& chunk);
 };
 
 // 澶у巺娣峰搷寮曟搸
 class hall_reverb_engine : public reverb_engine {
 private:
-    // 鏇村ぇ鐨勫欢杩熸椂闂村拰鏇村鐨勬护娉㈠櫒
-    std::vector<std::unique_ptr<comb_filter>> comb_filters_;
-    std::vector<std::unique_ptr<allpass_filter>> allpass_filters_;
-    std::unique_ptr<modulator> modulator_;
+    // Longer and more filters than the room, per channel
+    std::vector<std::vector<comb_filter>> comb_filters_;
+    std::vector<std::vector<allpass_filter>> allpass_filters_;
+    
+    std::vector<size_t> comb_delays_;
+    std::vector<size_t> allpass_delays_;
+    std::vector<float> comb_feedbacks_;
     
 public:
-    hall_reverb_engine(const reverb_parameters& params, uint32_t sample_rate);
+    hall_reverb_engine(const reverb_parameters& params, uint32_t sample_rate, uint32_t channels);
     
     void process(audio_chunk& chunk) override;
     void reset() override;
@@ -293,16 +286,14 @@ private:
 // 鏉垮紡娣峰搷寮曟搸
 class plate_reverb_engine : public reverb_engine {
 private:
-    // 楂樺瘑搴︽护娉㈠櫒缁?
-    std::vector<std::unique_ptr<allpass_filter>> allpass_filters_;
-    std::unique_ptr<modulator> modulator_;
+    // Dense allpass chain, per channel
+    std::vector<std::vector<allpass_filter>> allpass_filters_;
     
-    // 鎵╂暎缃戠粶
     std::vector<std::vector<float>> diffusion_matrix_;
     std::vector<float> diffusion_state_;
     
 public:
-    plate_reverb_engine(const reverb_parameters& params, uint32_t sample_rate);
+    plate_reverb_engine(const reverb_parameters& params, uint32_t sample_rate, uint32_t channels);
     
     void process(audio_chunk& chunk) override;
     void reset() override;
@@ -313,13 +304,35 @@ private:
     void process_diffusion_network(audio_chunk& chunk);
 };
 
+// Feedback delay network tail (mp::core::FdnReverb). One contiguous set of
+// delay lines serves every channel; decay and damping changes do not
+// allocate, a room size change rebuilds the lines.
+class fdn_reverb_engine : public reverb_engine {
+private:
+    mp::core::FdnReverb fdn_;
+    size_t lines_;
+    
+public:
+    fdn_reverb_engine(const reverb_parameters& params, uint32_t sample_rate, uint32_t channels,
+                      size_t lines = 8);
+    
+    void process(audio_chunk& chunk) override;
+    void reset() override;
+    double get_latency() const override { return params_.predelay / 1000.0; }
+    void set_params(const reverb_parameters& params) override;
+};
+
 // 娣峰搷鏁堟灉鍣ㄤ富绫?
 class dsp_reverb_advanced : public dsp_effect_advanced {
 private:
     reverb_parameters params_;
     std::unique_ptr<reverb_engine> engine_;
-    std::unique_ptr<audio_chunk> wet_buffer_;
-    std::unique_ptr<audio_chunk> dry_buffer_;
+    uint32_t sample_rate_;              // Format the engine was built for
+    uint32_t channels_;
+    
+    // Used only when no chain arena is attached or the block is larger
+    static constexpr size_t DRY_FALLBACK_FRAMES = 4096;
+    std::vector<float> dry_fallback_;
     
     // 璋冨埗鏀寔
     std::unique_ptr<modulator> modulation_;
@@ -360,6 +373,7 @@ public:
     void load_hall_preset(float room_size);
     void load_plate_preset();
     void load_cathedral_preset();
+    void set_reverb_type(reverb_type type);
     
     // 鎴块棿绫诲瀷棰勮
     void set_small_room();
@@ -374,7 +388,7 @@ protected:
     void update_cpu_usage(float usage) override;
     
 private:
-    void create_reverb_engine();
+    void create_reverb_engine(uint32_t sample_rate, uint32_t channels);
     void create_modulation();
     void create_filters();
     void calculate_delays();
@@ -383,7 +397,8 @@ private:
     void apply_output_filtering(audio_chunk& chunk);
     void apply_modulation(audio_chunk& chunk);
     
-    void mix_wet_dry_signals(audio_chunk& chunk);
+    const float* acquire_dry_copy(const audio_chunk& chunk);
+    void mix_wet_dry_signals(audio_chunk& chunk, const float* dry_data);
     void apply_stereo_width(audio_chunk& chunk);
 };
 
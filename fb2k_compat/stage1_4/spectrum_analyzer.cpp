@@ -1,4 +1,5 @@
 ﻿#include "audio_analyzer.h"
+#include "../../core/fft.h"
 #include <cmath>
 #include <algorithm>
 #include <numeric>
@@ -20,6 +21,7 @@ public:
     bool process(const std::vector<float>& input, std::vector<std::complex<float>>& output);
     bool process_real(const std::vector<float>& input, std::vector<float>& magnitudes, std::vector<float>& phases);
     
+    void set_size(int size);
     void set_window_type(int type);
     std::vector<double> get_frequency_bins(double sample_rate) const;
     
@@ -28,55 +30,57 @@ private:
     int window_type_;
     std::vector<float> window_;
     
-    // 绠€鍗曠殑FFT瀹炵幇锛堜娇鐢ㄥ鏁拌繍绠楋級
-    void perform_fft(const std::vector<std::complex<float>>& input, std::vector<std::complex<float>>& output);
+    // Shared real-input FFT; work buffers are reused between calls
+    std::unique_ptr<mp::core::RealFFT> fft_;
+    std::vector<float> windowed_input_;
+    std::vector<std::complex<float>> bins_;
+    
     void apply_window_to_signal(std::vector<float>& signal);
     std::vector<float> create_window_function(int type, int size);
 };
 
 fft_processor_impl::fft_processor_impl(int size) 
-    : size_(size), window_type_(0) {
-    window_ = create_window_function(window_type_, size_);
+    : size_(0), window_type_(0) {
+    set_size(size);
 }
 
 fft_processor_impl::~fft_processor_impl() = default;
 
+void fft_processor_impl::set_size(int size) {
+    fft_ = std::make_unique<mp::core::RealFFT>(static_cast<size_t>(size));
+    size_ = static_cast<int>(fft_->size());
+    window_ = create_window_function(window_type_, size_);
+    windowed_input_.resize(size_);
+    bins_.resize(fft_->bins());
+}
+
+// Output holds the size_ / 2 + 1 non-negative frequency bins
 bool fft_processor_impl::process(const std::vector<float>& input, std::vector<std::complex<float>>& output) {
     if (input.size() != static_cast<size_t>(size_)) {
         return false;
     }
     
-    output.resize(size_);
+    output.resize(fft_->bins());
     
-    // 搴旂敤绐楀彛鍑芥暟
-    std::vector<float> windowed_input = input;
-    apply_window_to_signal(windowed_input);
+    std::copy(input.begin(), input.end(), windowed_input_.begin());
+    apply_window_to_signal(windowed_input_);
     
-    // 杞崲涓哄鏁?
-    std::vector<std::complex<float>> complex_input(size_);
-    for (int i = 0; i < size_; ++i) {
-        complex_input[i] = std::complex<float>(windowed_input[i], 0.0f);
-    }
-    
-    // 鎵цFFT
-    perform_fft(complex_input, output);
+    fft_->forward(windowed_input_.data(), output.data());
     
     return true;
 }
 
 bool fft_processor_impl::process_real(const std::vector<float>& input, std::vector<float>& magnitudes, std::vector<float>& phases) {
-    std::vector<std::complex<float>> fft_output;
-    if (!process(input, fft_output)) {
+    if (!process(input, bins_)) {
         return false;
     }
     
-    magnitudes.resize(size_ / 2 + 1);
-    phases.resize(size_ / 2 + 1);
+    magnitudes.resize(bins_.size());
+    phases.resize(bins_.size());
     
-    // 璁＄畻骞呭害鍜岀浉浣嶏紙鍙彇姝ｉ鐜囬儴鍒嗭級
-    for (int i = 0; i <= size_ / 2; ++i) {
-        magnitudes[i] = std::abs(fft_output[i]);
-        phases[i] = std::arg(fft_output[i]);
+    for (size_t i = 0; i < bins_.size(); ++i) {
+        magnitudes[i] = std::abs(bins_[i]);
+        phases[i] = std::arg(bins_[i]);
     }
     
     return true;
@@ -98,43 +102,6 @@ std::vector<double> fft_processor_impl::get_frequency_bins(double sample_rate) c
     return frequencies;
 }
 
-void fft_processor_impl::perform_fft(const std::vector<std::complex<float>>& input, std::vector<std::complex<float>>& output) {
-    // 绠€鍖栫殑FFT瀹炵幇锛圕ooley-Tukey绠楁硶锛?
-    int n = input.size();
-    output = input;
-    
-    // 浣嶅弽杞噸鎺掑垪
-    int j = 0;
-    for (int i = 1; i < n; ++i) {
-        int bit = n >> 1;
-        while (j >= bit) {
-            j -= bit;
-            bit >>= 1;
-        }
-        j += bit;
-        if (i < j) {
-            std::swap(output[i], output[j]);
-        }
-    }
-    
-    // FFT璁＄畻
-    for (int len = 2; len <= n; len <<= 1) {
-        double angle = -2.0 * M_PI / len;
-        std::complex<float> wlen(std::cos(angle), std::sin(angle));
-        
-        for (int i = 0; i < n; i += len) {
-            std::complex<float> w(1.0f, 0.0f);
-            for (int j = 0; j < len / 2; ++j) {
-                std::complex<float> u = output[i + j];
-                std::complex<float> v = output[i + j + len / 2] * w;
-                output[i + j] = u + v;
-                output[i + j + len / 2] = u - v;
-                w *= wlen;
-            }
-        }
-    }
-}
-
 void fft_processor_impl::apply_window_to_signal(std::vector<float>& signal) {
     if (window_.size() != signal.size()) {
         return;
@@ -3,9 +3,14 @@
 
 #ifndef NO_FLAC
 #include <FLAC/stream_decoder.h>
+#include "planar_pcm_sink.h"
 #endif
 
+#include <atomic>
+#include <cstdlib>
 #include <iostream>
+#include <string>
+#include <thread>
 #include <vector>
 #include <cstring>
 #include <memory>
@@ -15,23 +20,40 @@ namespace plugins {
 
 #ifndef NO_FLAC
 
+// Output and verification options, read once per stream:
+//   XPUMUSIC_FLAC_OUTPUT=int32     left-justified Int32 instead of Float32
+//   XPUMUSIC_FLAC_VERIFY_MD5=1     check the STREAMINFO MD5 in the background
+static bool env_flag(const char* name, const char* value) {
+    const char* set = std::getenv(name);
+    return set && std::strcmp(set, value) == 0;
+}
+
+// Background MD5 check: a second decoder over the same file with libFLAC's
+// own verification, so the playback decoder never pays for hashing
+struct FLACVerifier {
+    std::thread thread;
+    std::atomic<bool> cancel{false};
+    std::atomic<int> result{0};         // 0 running, 1 match, -1 mismatch or error
+};
+
 // FLAC decoder context
 struct FLACDecoderContext {
     FLAC__StreamDecoder* decoder;
-    std::vector<int32_t> decode_buffer;  // Interleaved PCM buffer
-    size_t buffer_position;
-    size_t buffer_size;
+    core::PlanarPcmSink sink;           // Interleaves into the caller's buffer
+    core::PlanarPcmSink::Output output;
     AudioStreamInfo stream_info;
     std::vector<MetadataTag> metadata;
     std::vector<std::string> metadata_strings;  // Storage for metadata values
     uint64_t current_sample;
+    bool has_md5;
     bool eos;
+    std::unique_ptr<FLACVerifier> verifier;
     
     FLACDecoderContext() 
         : decoder(nullptr)
-        , buffer_position(0)
-        , buffer_size(0)
+        , output(core::PlanarPcmSink::Output::Float32)
         , current_sample(0)
+        , has_md5(false)
         , eos(false) {
         std::memset(&stream_info, 0, sizeof(stream_info));
     }
@@ -47,23 +69,63 @@ static FLAC__StreamDecoderWriteStatus write_callback(
     (void)decoder;
     FLACDecoderContext* ctx = static_cast<FLACDecoderContext*>(client_data);
     
+    // Converted straight into the buffer decode_block is filling; a tail
+    // that does not fit waits in the sink's ring
     size_t samples = frame->header.blocksize;
-    size_t channels = ctx->stream_info.channels;
+    if (ctx->sink.write(buffer, samples) < samples) {
+        std::cerr << "FLAC decoder: block larger than STREAMINFO maximum, tail dropped" << std::endl;
+    }
     
-    // Resize buffer if needed
-    ctx->decode_buffer.resize(samples * channels);
+    return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static FLAC__StreamDecoderWriteStatus verify_write_callback(
+    const FLAC__StreamDecoder* decoder,
+    const FLAC__Frame* frame,
+    const FLAC__int32* const buffer[],
+    void* client_data) {
+    
+    (void)decoder;
+    (void)frame;
+    (void)buffer;
+    const FLACVerifier* verifier = static_cast<const FLACVerifier*>(client_data);
+    return verifier->cancel.load(std::memory_order_relaxed)
+        ? FLAC__STREAM_DECODER_WRITE_STATUS_ABORT
+        : FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void verify_error_callback(
+    const FLAC__StreamDecoder* decoder,
+    FLAC__StreamDecoderErrorStatus status,
+    void* client_data) {
     
-    // Interleave samples
-    for (size_t i = 0; i < samples; i++) {
-        for (size_t ch = 0; ch < channels; ch++) {
-            ctx->decode_buffer[i * channels + ch] = buffer[ch][i];
+    (void)decoder;
+    (void)status;
+    (void)client_data;
+}
+
+static void verify_md5(FLACVerifier* verifier, std::string path) {
+    FLAC__StreamDecoder* decoder = FLAC__stream_decoder_new();
+    bool ok = false;
+    if (decoder) {
+        FLAC__stream_decoder_set_md5_checking(decoder, true);
+        if (FLAC__stream_decoder_init_file(decoder, path.c_str(), verify_write_callback, nullptr,
+                                           verify_error_callback, verifier)
+            == FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+            bool decoded = FLAC__stream_decoder_process_until_end_of_stream(decoder);
+            // finish() reports the MD5 comparison
+            ok = FLAC__stream_decoder_finish(decoder) && decoded;
         }
+        FLAC__stream_decoder_delete(decoder);
     }
     
-    ctx->buffer_position = 0;
-    ctx->buffer_size = samples;
-    
-    return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+    if (verifier->cancel.load(std::memory_order_relaxed)) {
+        return;
+    }
+    verifier->result.store(ok ? 1 : -1, std::memory_order_release);
+    if (!ok) {
+        std::cerr << "FLAC decoder: MD5 mismatch in " << path << std::endl;
+    }
 }
 
 static void metadata_callback(
@@ -81,8 +143,18 @@ static void metadata_callback(
         ctx->stream_info.duration_ms = 
             (ctx->stream_info.total_samples * 1000) / ctx->stream_info.sample_rate;
         
-        // FLAC always decodes to 32-bit signed integer
-        ctx->stream_info.format = SampleFormat::Int32;
+        // Samples leave libFLAC planar at the stream's resolution; the sink
+        // interleaves and scales them to full-range float (or int32)
+        const FLAC__StreamMetadata_StreamInfo& info = metadata->data.stream_info;
+        const size_t max_block = info.max_blocksize > 0 ? info.max_blocksize : 65535;
+        ctx->sink.configure(static_cast<uint16_t>(info.channels), info.bits_per_sample,
+                            max_block, ctx->output);
+        ctx->stream_info.format = ctx->output == core::PlanarPcmSink::Output::Float32
+            ? SampleFormat::Float32 : SampleFormat::Int32;
+        
+        for (uint8_t byte : info.md5sum) {
+            ctx->has_md5 = ctx->has_md5 || byte != 0;
+        }
         
         // Calculate bitrate
         if (metadata->data.stream_info.total_samples > 0) {
@@ -224,8 +296,11 @@ public:
             return Result::OutOfMemory;
         }
         
-        // Initialize decoder
+        // Initialize decoder; MD5 is never checked inline (see verify_md5)
         FLAC__stream_decoder_set_md5_checking(ctx->decoder, false);
+        if (env_flag("XPUMUSIC_FLAC_OUTPUT", "int32")) {
+            ctx->output = core::PlanarPcmSink::Output::Int32;
+        }
         
         FLAC__StreamDecoderInitStatus init_status = 
             FLAC__stream_decoder_init_file(
@@ -243,11 +318,18 @@ public:
         }
         
         // Process metadata
-        if (!FLAC__stream_decoder_process_until_end_of_metadata(ctx->decoder)) {
+        if (!FLAC__stream_decoder_process_until_end_of_metadata(ctx->decoder) ||
+            ctx->sink.channels() == 0) {
             FLAC__stream_decoder_delete(ctx->decoder);
             return Result::Error;
         }
         
+        if (ctx->has_md5 && env_flag("XPUMUSIC_FLAC_VERIFY_MD5", "1")) {
+            ctx->verifier.reset(new FLACVerifier());
+            ctx->verifier->thread = std::thread(verify_md5, ctx->verifier.get(),
+                                                std::string(file_path));
+        }
+        
         handle->internal = ctx.release();
         return Result::Success;
 #endif
@@ -284,46 +366,25 @@ public:
         
         FLACDecoderContext* ctx = static_cast<FLACDecoderContext*>(handle.internal);
         
-        if (ctx->eos) {
-            *samples_decoded = 0;
-            return Result::Success;
-        }
-        
-        int32_t* output = static_cast<int32_t*>(buffer);
-        size_t samples_per_channel = buffer_size / (sizeof(int32_t) * ctx->stream_info.channels);
-        size_t total_decoded = 0;
+        // Leftover frames from the last block go in first, then whole blocks
+        // are decoded straight into the buffer until it is full
+        size_t samples_per_channel = buffer_size / ctx->sink.frame_bytes();
+        ctx->sink.begin(buffer, samples_per_channel);
         
-        while (total_decoded < samples_per_channel) {
-            // If we have buffered data, copy it
-            if (ctx->buffer_position < ctx->buffer_size) {
-                size_t samples_available = ctx->buffer_size - ctx->buffer_position;
-                size_t samples_to_copy = std::min(samples_available, 
-                                                  samples_per_channel - total_decoded);
-                
-                size_t samples_in_bytes = samples_to_copy * ctx->stream_info.channels;
-                std::memcpy(output + (total_decoded * ctx->stream_info.channels),
-                           &ctx->decode_buffer[ctx->buffer_position * ctx->stream_info.channels],
-                           samples_in_bytes * sizeof(int32_t));
-                
-                ctx->buffer_position += samples_to_copy;
-                total_decoded += samples_to_copy;
-                ctx->current_sample += samples_to_copy;
-            } else {
-                // Decode next frame
-                if (!FLAC__stream_decoder_process_single(ctx->decoder)) {
-                    ctx->eos = true;
-                    break;
-                }
-                
-                FLAC__StreamDecoderState state = FLAC__stream_decoder_get_state(ctx->decoder);
-                if (state == FLAC__STREAM_DECODER_END_OF_STREAM) {
-                    ctx->eos = true;
-                    break;
-                }
+        while (!ctx->sink.full() && !ctx->eos) {
+            if (!FLAC__stream_decoder_process_single(ctx->decoder)) {
+                ctx->eos = true;
+                break;
+            }
+            
+            FLAC__StreamDecoderState state = FLAC__stream_decoder_get_state(ctx->decoder);
+            if (state == FLAC__STREAM_DECODER_END_OF_STREAM) {
+                ctx->eos = true;
             }
         }
         
-        *samples_decoded = total_decoded;
+        ctx->current_sample += ctx->sink.written();
+        *samples_decoded = ctx->sink.written();
         return Result::Success;
 #endif
     }
@@ -343,13 +404,16 @@ public:
         
         uint64_t target_sample = (position_ms * ctx->stream_info.sample_rate) / 1000;
         
+        // The seek decodes the target frame into the sink; with no buffer
+        // attached it all lands in the ring, ready for the next decode_block
+        ctx->sink.clear();
+        ctx->sink.begin(nullptr, 0);
         if (!FLAC__stream_decoder_seek_absolute(ctx->decoder, target_sample)) {
+            ctx->sink.clear();
             return Result::Error;
         }
         
         ctx->current_sample = target_sample;
-        ctx->buffer_position = 0;
-        ctx->buffer_size = 0;
         ctx->eos = false;
         
         *actual_position = (target_sample * 1000) / ctx->stream_info.sample_rate;
@@ -387,6 +451,11 @@ public:
         if (handle.internal) {
             FLACDecoderContext* ctx = static_cast<FLACDecoderContext*>(handle.internal);
             
+            if (ctx->verifier) {
+                ctx->verifier->cancel.store(true, std::memory_order_relaxed);
+                ctx->verifier->thread.join();
+            }
+            
             if (ctx->decoder) {
                 FLAC__stream_decoder_finish(ctx->decoder);
                 FLAC__stream_decoder_delete(ctx->decoder);
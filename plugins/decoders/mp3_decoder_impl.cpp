@@ -1,15 +1,20 @@
-﻿#include "mp3_decoder_impl.h"
+﻿// The plugin carries minimp3's implementation
+#define MINIMP3_IMPLEMENTATION
+#include "mp3_decoder_impl.h"
 #include <cstring>
+#include <cmath>
 #include <algorithm>
 #include <fstream>
 #include <locale>
 #include <codecvt>
 
-#define MINIMP3_FLOAT_OUTPUT  // We want float output for DSP processing
-#include <minimp3.h>
-
 namespace xpumusic::plugins {
 
+namespace {
+    // Keep at least this much input buffered so minimp3 can sync on a frame
+    const size_t MIN_INPUT_BYTES = 16 * 1024;
+}
+
 // Import plugin SDK types for convenience
 using xpumusic::IPlugin;
 using xpumusic::IAudioDecoder;
@@ -22,9 +27,9 @@ using xpumusic::PluginType;
 
 MP3Decoder::MP3Decoder() {
     memset(&mp3d_, 0, sizeof(mp3d_));
-    memset(&mp3info_, 0, sizeof(mp3info_));
 
-    input_buffer_.reserve(64 * 1024);  // 64KB input buffer
+    input_buffer_.resize(64 * 1024);  // 64KB input buffer
+    frame_pcm_.resize(MINIMP3_MAX_SAMPLES_PER_FRAME);
     input_buffer_size_ = 0;
     input_buffer_pos_ = 0;
 }
@@ -93,31 +98,17 @@ bool MP3Decoder::open(const std::string& file_path) {
     // Parse ID3v2 tag
     parse_id3v2_tag(file_);
 
-    // Get file info
-    mp3dec_file_info_t info;
-    if (mp3dec_load(&mp3d_, file_path.c_str(), nullptr, nullptr, &info) == 0) {
-        mp3info_ = info;
-
-        // Set audio format
-        format_.sample_rate = info.sample_rate;
-        format_.channels = info.channels;
-        format_.bits_per_sample = 32;
-        format_.is_float = true;
-
-        // Calculate duration
-        duration_ = static_cast<double>(info.total_samples) / info.sample_rate;
-        total_samples_ = info.total_samples;
-
-        is_open_ = true;
-        set_state(PluginState::Active);
-
-        return true;
-    } else {
+    // Format and duration come from frame headers; nothing is decoded here
+    if (!probe_stream()) {
         set_error("Failed to parse MP3 file");
-        fclose(file_);
-        file_ = nullptr;
+        cleanup();
         return false;
     }
+
+    is_open_ = true;
+    set_state(PluginState::Active);
+
+    return true;
 }
 
 int MP3Decoder::decode(AudioBuffer& buffer, int max_frames) {
@@ -125,57 +116,91 @@ int MP3Decoder::decode(AudioBuffer& buffer, int max_frames) {
         return 0;
     }
 
-    // Ensure output buffer is large enough
-    int output_frames = std::min(max_frames, 4096);
+    return decode_frames(buffer, max_frames);
+}
 
-    // Use a temporary internal buffer if needed
-    static std::vector<float> temp_buffer;
-    temp_buffer.resize(output_frames * format_.channels);
+int MP3Decoder::decode_frames(AudioBuffer& buffer, int max_frames) {
+    int output_frames = std::min(max_frames, 4096);
+    size_t wanted = static_cast<size_t>(std::max(output_frames, 0)) * format_.channels;
+    if (output_buffer_.size() < wanted) {
+        output_buffer_.resize(wanted);
+    }
 
     // Initialize the AudioBuffer structure
-    buffer.data = temp_buffer.data();
+    buffer.data = output_buffer_.data();
     buffer.frames = 0;
     buffer.channels = format_.channels;
 
-    // Decode audio data
-    int samples_decoded = 0;
-    float* output_ptr = temp_buffer.data();
+    size_t written = 0;
+    while (written < wanted) {
+        // Hand out what is left of the last decoded frame first
+        if (frame_pcm_pos_ < frame_pcm_size_) {
+            size_t count = std::min(wanted - written, frame_pcm_size_ - frame_pcm_pos_);
+            memcpy(output_buffer_.data() + written, frame_pcm_.data() + frame_pcm_pos_,
+                   count * sizeof(float));
+            frame_pcm_pos_ += count;
+            written += count;
+            continue;
+        }
 
-    while (samples_decoded < output_frames * format_.channels) {
-        // Read input data
         if (!refill_input_buffer()) {
             break;  // End of file
         }
 
-        // Decode one frame using float API
-        mp3d_frame_t frame_info;
-        int samples = mp3dec_decode_frame_float(
+        mp3dec_frame_info_t frame_info = {};
+        int samples = mp3dec_decode_frame(
             &mp3d_,
             input_buffer_.data() + input_buffer_pos_,
-            input_buffer_size_ - input_buffer_pos_,
-            output_ptr + samples_decoded,
+            static_cast<int>(input_buffer_size_ - input_buffer_pos_),
+            frame_pcm_.data(),
             &frame_info
         );
 
-        if (samples > 0) {
-            samples_decoded += samples;
-        } else if (samples == 0) {
-            // Need more input data
-            // Skip frame_bytes since it's not available in our stub
-            input_buffer_pos_ += 144; // Approximate frame size for MP3
-            if (input_buffer_pos_ >= input_buffer_size_) {
-                input_buffer_size_ = 0;
-                input_buffer_pos_ = 0;
+        if (frame_info.frame_bytes == 0) {
+            // No frame anywhere in the buffered input
+            input_buffer_pos_ = input_buffer_size_;
+            continue;
+        }
+        input_buffer_pos_ += frame_info.frame_bytes;
+
+        // After a seek, whole frames before the target are dropped by their
+        // length on the timeline: pre-roll frames decode to nothing while
+        // the bit reservoir is still filling
+        size_t skip = 0;
+        if (skip_samples_ > 0 && frame_info.hz != 0) {
+            uint64_t frame_samples = hdr_frame_samples(mp3d_.header);
+            if (skip_samples_ >= frame_samples) {
+                skip_samples_ -= frame_samples;
+                continue;
             }
-        } else {
-            // Error
-            set_error("MP3 decode error");
-            break;
+            skip = static_cast<size_t>(skip_samples_);
+            skip_samples_ = 0;
         }
+
+        // Skipped junk, or a frame minimp3 could not decode
+        if (samples == 0) {
+            continue;
+        }
+
+        // Streams may switch between mono and stereo; keep the layout the
+        // stream opened with so no frame is lost from the timeline
+        float* pcm = frame_pcm_.data();
+        if (frame_info.channels == 1 && format_.channels == 2) {
+            for (int i = samples - 1; i >= 0; --i) {
+                pcm[2 * i] = pcm[2 * i + 1] = pcm[i];
+            }
+        } else if (frame_info.channels == 2 && format_.channels == 1) {
+            for (int i = 0; i < samples; ++i) {
+                pcm[i] = 0.5f * (pcm[2 * i] + pcm[2 * i + 1]);
+            }
+        }
+
+        frame_pcm_pos_ = std::min<size_t>(skip, samples) * format_.channels;
+        frame_pcm_size_ = static_cast<size_t>(samples) * format_.channels;
     }
 
     // Update buffer frame count
-    buffer.frames = samples_decoded / format_.channels;
+    buffer.frames = static_cast<int>(written / format_.channels);
 
     // Update current position
     current_sample_ += buffer.frames;
@@ -199,43 +224,44 @@ bool MP3Decoder::seek(double seconds) {
         return false;
     }
 
-    // Calculate target sample position
-    uint64_t target_sample = static_cast<uint64_t>(seconds * format_.sample_rate);
-
-    // Simple implementation: reopen file and decode to target position
-    // In real application, should use more efficient seek method
-    std::string temp_path = file_path_;
-    close();
+    // Round: truncating seconds * rate can land a sample early
+    return seek(static_cast<int64_t>(std::llround(std::max(0.0, seconds) * format_.sample_rate)));
+}
 
-    if (!open(temp_path)) {
+bool MP3Decoder::seek(int64_t sample_pos) {
+    if (!is_open_) {
         return false;
     }
 
-    // Skip audio data to target position
-    uint64_t samples_to_skip = target_sample;
-    std::vector<float> temp_buffer(4096);
-
-    while (samples_to_skip > 0) {
-        AudioBuffer buffer;
-        buffer.data = temp_buffer.data();
-        buffer.channels = format_.channels;
-
-        int frames = decode(buffer, 1024);
-        if (frames <= 0) {
-            break;
-        }
+    uint64_t target_sample = static_cast<uint64_t>(std::max<int64_t>(0, sample_pos));
 
-        int samples_decoded = frames * format_.channels;
-        if (samples_decoded >= samples_to_skip) {
-            // Reached target position, need to re-decode this frame
-            current_sample_ = target_sample;
-            return true;
+    // Binary search the index; without one, decode forward from the start
+    MP3SeekPoint point;
+    point.offset = first_audio_offset_;
+    bool exact = true;
+    {
+        std::lock_guard<std::mutex> lock(seek_table_mutex_);
+        if (seek_table_.lookup_with_preroll(target_sample, point, MAX_BITRESERVOIR_BYTES)) {
+            exact = seek_table_.is_exact();
         }
+    }
 
-        samples_to_skip -= samples_decoded;
+    // Restart the decoder on a frame boundary. The frames ahead of the
+    // target refill the bit reservoir, and the one just before it the
+    // synthesis overlap; decode_frames drops them
+    if (!reset_stream(point.offset)) {
+        set_error("Seek failed: " + file_path_);
+        return false;
     }
 
-    current_sample_ = target_sample;
+    if (exact) {
+        skip_samples_ = target_sample - point.sample;
+        current_sample_ = target_sample;
+    } else {
+        // TOC points are approximate: report where decoding actually resumes
+        skip_samples_ = 0;
+        current_sample_ = point.sample;
+    }
     return true;
 }
 
@@ -410,22 +436,167 @@ int MP3Decoder::parse_id3_int(const uint8_t* data, size_t size) {
 }
 
 bool MP3Decoder::refill_input_buffer() {
-    if (input_buffer_pos_ >= input_buffer_size_) {
-        // Read new data
-        input_buffer_size_ = fread(
-            input_buffer_.data(),
-            1,
-            input_buffer_.capacity(),
-            file_
-        );
+    size_t remaining = input_buffer_size_ - input_buffer_pos_;
+    if (!input_eof_ && remaining < MIN_INPUT_BYTES) {
+        // Keep the partial frame at the front and top up behind it,
+        // stopping short of an ID3v1 tag
+        memmove(input_buffer_.data(), input_buffer_.data() + input_buffer_pos_, remaining);
         input_buffer_pos_ = 0;
+        input_buffer_size_ = remaining;
+
+        long position = ftell(file_);
+        size_t want = input_buffer_.size() - remaining;
+        if (position >= 0) {
+            uint64_t left = audio_end_ > static_cast<uint64_t>(position)
+                ? audio_end_ - static_cast<uint64_t>(position) : 0;
+            want = static_cast<size_t>(std::min<uint64_t>(want, left));
+        }
 
-        return input_buffer_size_ > 0;
+        size_t got = want ? fread(input_buffer_.data() + remaining, 1, want, file_) : 0;
+        input_buffer_size_ += got;
+        if (got < want || want == 0) {
+            input_eof_ = true;
+        }
     }
     return input_buffer_pos_ < input_buffer_size_;
 }
 
+bool MP3Decoder::reset_stream(uint64_t offset) {
+    input_buffer_size_ = 0;
+    input_buffer_pos_ = 0;
+    input_eof_ = false;
+    frame_pcm_pos_ = 0;
+    frame_pcm_size_ = 0;
+    mp3dec_init(&mp3d_);
+    return fseek(file_, static_cast<long>(offset), SEEK_SET) == 0;
+}
+
+bool MP3Decoder::probe_stream() {
+    stop_index_scan();
+
+    // Audio lies between the ID3v2 tag and an optional 128 byte ID3v1 tag
+    uint8_t head[10];
+    audio_start_ = 0;
+    if (fseek(file_, 0, SEEK_SET) == 0 && fread(head, 1, 10, file_) == 10 &&
+        memcmp(head, "ID3", 3) == 0) {
+        audio_start_ = 10 + (((head[6] & 0x7Fu) << 21) | ((head[7] & 0x7Fu) << 14) |
+                             ((head[8] & 0x7Fu) << 7) | (head[9] & 0x7Fu));
+        if (head[5] & 0x10) {
+            audio_start_ += 10;  // Footer
+        }
+    }
+
+    fseek(file_, 0, SEEK_END);
+    audio_end_ = static_cast<uint64_t>(ftell(file_));
+    char tag[3];
+    if (audio_end_ >= 128 && fseek(file_, -128, SEEK_END) == 0 &&
+        fread(tag, 1, 3, file_) == 3 && memcmp(tag, "TAG", 3) == 0) {
+        audio_end_ -= 128;
+    }
+
+    // First frame header, and the Xing/Info/VBRI tag it may carry
+    std::vector<uint8_t> head_data(64 * 1024);
+    fseek(file_, static_cast<long>(audio_start_), SEEK_SET);
+    head_data.resize(fread(head_data.data(), 1, head_data.size(), file_));
+
+    MP3FrameHeader frame;
+    MP3VbrHeader vbr;
+    bool found = false;
+    for (size_t pos = 0; pos + 4 <= head_data.size(); ++pos) {
+        if (parse_mp3_frame_header(&head_data[pos], frame)) {
+            audio_start_ += pos;
+            parse_mp3_vbr_header(&head_data[pos], head_data.size() - pos, frame, vbr);
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+
+    format_.sample_rate = frame.sample_rate;
+    format_.channels = frame.channels;
+    format_.bits_per_sample = 32;
+    format_.is_float = true;
+
+    first_audio_offset_ = audio_start_ + (vbr.found ? frame.frame_bytes : 0);
+
+    {
+        std::lock_guard<std::mutex> lock(seek_table_mutex_);
+        seek_table_.build_from_toc(vbr, frame, audio_start_, audio_end_);
+    }
+
+    // An exact index from an earlier scan of this file replaces the TOC
+    MP3SeekTable cached;
+    bool have_cache = cached.load(MP3SeekTable::cache_path_for(file_path_), file_path_);
+
+    if (vbr.frames > 0) {
+        total_samples_ = static_cast<uint64_t>(vbr.frames) * frame.samples;
+    } else if (have_cache) {
+        total_samples_ = cached.total_samples();
+    } else {
+        // No frame count in the stream: assume constant bitrate from the
+        // first frame. The index scan replaces this with the exact count.
+        total_samples_ = (audio_end_ - audio_start_) * 8 * frame.sample_rate / frame.bitrate;
+    }
+
+    if (have_cache) {
+        std::lock_guard<std::mutex> lock(seek_table_mutex_);
+        seek_table_ = std::move(cached);
+    } else {
+        start_index_scan(vbr.frames == 0);
+    }
+
+    current_sample_ = 0;
+    skip_samples_ = 0;
+    return reset_stream(first_audio_offset_);
+}
+
+void MP3Decoder::start_index_scan(bool update_length) {
+    index_cancel_ = false;
+
+    // Scan on a separate handle so decoding is never disturbed
+    std::string path = file_path_;
+    uint64_t start = audio_start_;
+    uint64_t end = audio_end_;
+    index_thread_ = std::thread([this, path, start, end, update_length] {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) {
+            return;
+        }
+
+        MP3SeekTable table;
+        bool complete = table.build_from_scan(file, start, end, index_cancel_);
+        fclose(file);
+        if (!complete) {
+            return;
+        }
+
+        table.save(MP3SeekTable::cache_path_for(path), path);
+
+        std::lock_guard<std::mutex> lock(seek_table_mutex_);
+        if (update_length) {
+            total_samples_ = table.total_samples();
+        }
+        seek_table_ = std::move(table);
+    });
+}
+
+void MP3Decoder::stop_index_scan() {
+    index_cancel_ = true;
+    if (index_thread_.joinable()) {
+        index_thread_.join();
+    }
+}
+
 void MP3Decoder::cleanup() {
+    stop_index_scan();
+    {
+        std::lock_guard<std::mutex> lock(seek_table_mutex_);
+        seek_table_ = MP3SeekTable();
+    }
+    skip_samples_ = 0;
+
     if (file_) {
         fclose(file_);
         file_ = nullptr;
@@ -434,8 +605,11 @@ void MP3Decoder::cleanup() {
     is_open_ = false;
     input_buffer_size_ = 0;
     input_buffer_pos_ = 0;
+    input_eof_ = false;
+    frame_pcm_pos_ = 0;
+    frame_pcm_size_ = 0;
     current_sample_ = 0;
-    memset(&mp3info_, 0, sizeof(mp3info_));
+    total_samples_ = 0;
 }
 
 void MP3Decoder::set_error(const std::string& error) {
@@ -448,22 +622,12 @@ void MP3Decoder::finalize() {
     set_state(PluginState::Uninitialized);
 }
 
-bool MP3Decoder::seek(int64_t sample_pos) {
-    if (!is_open_) {
-        return false;
-    }
-
-    // Convert sample position to seconds
-    double seconds = static_cast<double>(sample_pos) / format_.sample_rate;
-    return seek(seconds);
-}
-
 int64_t MP3Decoder::get_length() const {
     return static_cast<int64_t>(total_samples_);
 }
 
 double MP3Decoder::get_duration() const {
-    return duration_;
+    return format_.sample_rate ? static_cast<double>(total_samples_) / format_.sample_rate : 0.0;
 }
 
 std::vector<MetadataItem> MP3Decoder::get_metadata() {
@@ -503,8 +667,8 @@ int64_t MP3Decoder::get_position() const {
 }
 
 bool MP3Decoder::is_eof() const {
-    // Simplified check - in a real implementation, would check actual stream state
-    return feof(file_) != 0;
+    return !is_open_ || (input_eof_ && input_buffer_pos_ >= input_buffer_size_ &&
+                         frame_pcm_pos_ >= frame_pcm_size_);
 }
 
 } // namespace xpumusic::plugins
\ No newline at end of file
@@ -2,11 +2,16 @@
 
 #include "../../sdk/xpumusic_plugin_sdk.h"
 #include "../../sdk/headers/mp_types.h"
+#define MINIMP3_FLOAT_OUTPUT  // We want float output for DSP processing
 #include "minimp3.h"
+#include "mp3_seek_table.h"
 #include <memory>
 #include <vector>
 #include <string>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
 
 // Use a simple map instead of nlohmann::json for now
 using json_map = std::map<std::string, std::string>;
@@ -37,7 +42,6 @@ class MP3Decoder : public IAudioDecoder {
 private:
     // 瑙ｇ爜鐘舵€?
     mp3dec_t mp3d_;
-    mp3dec_file_info_t mp3info_;
 
     // 鏂囦欢淇℃伅
     std::string file_path_;
@@ -52,6 +56,14 @@ private:
     std::vector<uint8_t> input_buffer_;
     size_t input_buffer_size_;
     size_t input_buffer_pos_;
+    bool input_eof_ = false;
+
+    // Decoded output, owned per instance so decoders can run concurrently.
+    // minimp3 produces whole frames; samples not yet returned wait in frame_pcm_.
+    std::vector<float> output_buffer_;
+    std::vector<float> frame_pcm_;
+    size_t frame_pcm_pos_ = 0;
+    size_t frame_pcm_size_ = 0;
 
     // ID3鏍囩
     struct ID3Tag {
@@ -69,8 +81,18 @@ private:
 
     // 缁熻淇℃伅
     uint64_t current_sample_ = 0;
-    uint64_t total_samples_ = 0;
-    double duration_ = 0.0;
+    std::atomic<uint64_t> total_samples_{0};  // Estimated until the index scan counts frames
+
+    // Seek index: TOC-based until the background header scan (or a cached
+    // index) provides an exact per-frame table
+    MP3SeekTable seek_table_;
+    std::mutex seek_table_mutex_;
+    std::thread index_thread_;
+    std::atomic<bool> index_cancel_{false};
+    uint64_t audio_start_ = 0;          // First frame (may be a Xing/VBRI tag)
+    uint64_t audio_end_ = 0;            // End of audio, before any ID3v1 tag
+    uint64_t first_audio_offset_ = 0;   // First frame after a tag frame
+    uint64_t skip_samples_ = 0;         // Pre-roll still to discard after a seek
 
 public:
     MP3Decoder();
@@ -108,8 +130,12 @@ private:
     // 鍐呴儴鏂规硶
     bool parse_id3v1_tag(FILE* file);
     bool parse_id3v2_tag(FILE* file);
-    void calculate_duration();
     bool refill_input_buffer();
+    bool probe_stream();
+    bool reset_stream(uint64_t offset);
+    int decode_frames(AudioBuffer& buffer, int max_frames);
+    void start_index_scan(bool update_length);
+    void stop_index_scan();
     void cleanup();
     void set_error(const std::string& error);
 
@@ -0,0 +1,434 @@
+﻿#include "mp3_seek_table.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+namespace xpumusic::plugins {
+
+namespace {
+
+const char CACHE_MAGIC[4] = {'X', 'M', 'S', 'K'};
+const uint32_t CACHE_VERSION = 1;
+const size_t SCAN_CHUNK_BYTES = 64 * 1024;
+
+// Header, CRC and the largest (MPEG-1 stereo) layer III side information
+const uint64_t FRAME_OVERHEAD_BYTES = 4 + 2 + 32;
+
+const uint16_t BITRATES_KBPS[2][3][15] = {
+    {   // MPEG-2 / 2.5: layer I, II, III
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+    },
+    {   // MPEG-1: layer I, II, III
+        {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+    },
+};
+
+const uint32_t SAMPLE_RATES[3] = {44100, 48000, 32000};
+
+uint32_t read_be32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+uint32_t read_be16(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 8) | static_cast<uint32_t>(p[1]);
+}
+
+// Identity of the media file a cache entry was built from
+bool file_stamp(const std::string& path, uint64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    mtime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+} // namespace
+
+bool parse_mp3_frame_header(const uint8_t* h, MP3FrameHeader& header) {
+    if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) {
+        return false;
+    }
+
+    int version = (h[1] >> 3) & 3;          // 3 = MPEG1, 2 = MPEG2, 0 = MPEG2.5
+    int layer_bits = (h[1] >> 1) & 3;       // 3 = layer I, 1 = layer III
+    int bitrate_index = (h[2] >> 4) & 0xF;
+    int rate_index = (h[2] >> 2) & 3;
+    if (version == 1 || layer_bits == 0 || bitrate_index == 0 || bitrate_index == 15 ||
+        rate_index == 3) {
+        return false;
+    }
+
+    bool mpeg1 = version == 3;
+    uint8_t layer = static_cast<uint8_t>(4 - layer_bits);
+    uint32_t bitrate = BITRATES_KBPS[mpeg1 ? 1 : 0][layer - 1][bitrate_index] * 1000u;
+    uint32_t sample_rate = SAMPLE_RATES[rate_index] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+    uint32_t padding = (h[2] >> 1) & 1;
+
+    uint32_t samples = 1152;
+    if (layer == 1) {
+        samples = 384;
+    } else if (layer == 3 && !mpeg1) {
+        samples = 576;
+    }
+
+    header.frame_bytes = layer == 1
+        ? (12 * bitrate / sample_rate + padding) * 4
+        : samples / 8 * bitrate / sample_rate + padding;
+    header.samples = samples;
+    header.sample_rate = sample_rate;
+    header.bitrate = bitrate;
+    header.channels = ((h[3] >> 6) & 3) == 3 ? 1 : 2;
+    header.layer = layer;
+    header.mpeg1 = mpeg1;
+    return true;
+}
+
+bool parse_mp3_vbr_header(const uint8_t* data, size_t size, const MP3FrameHeader& frame,
+                          MP3VbrHeader& vbr) {
+    vbr = MP3VbrHeader();
+    size = std::min<size_t>(size, frame.frame_bytes);
+
+    bool mono = frame.channels == 1;
+    size_t xing = 4 + (frame.mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17));
+    size_t vbri = 4 + 32;
+
+    if (xing + 8 <= size &&
+        (std::memcmp(data + xing, "Xing", 4) == 0 || std::memcmp(data + xing, "Info", 4) == 0)) {
+        vbr.found = true;
+        vbr.is_info = data[xing] == 'I';
+
+        uint32_t flags = read_be32(data + xing + 4);
+        size_t p = xing + 8;
+        if ((flags & 0x1) && p + 4 <= size) {
+            vbr.frames = read_be32(data + p);
+            p += 4;
+        }
+        if ((flags & 0x2) && p + 4 <= size) {
+            vbr.bytes = read_be32(data + p);
+            p += 4;
+        }
+        if ((flags & 0x4) && p + 100 <= size) {
+            vbr.toc.assign(data + p, data + p + 100);
+        }
+        return true;
+    }
+
+    if (vbri + 26 <= size && std::memcmp(data + vbri, "VBRI", 4) == 0) {
+        vbr.found = true;
+        vbr.is_vbri = true;
+        vbr.bytes = read_be32(data + vbri + 10);
+        vbr.frames = read_be32(data + vbri + 14);
+
+        uint32_t entries = read_be16(data + vbri + 18);
+        uint32_t scale = read_be16(data + vbri + 20);
+        uint32_t entry_size = read_be16(data + vbri + 22);
+        vbr.frames_per_toc_entry = read_be16(data + vbri + 24);
+
+        const uint8_t* table = data + vbri + 26;
+        if (entry_size >= 1 && entry_size <= 4 && vbri + 26 + entries * entry_size <= size) {
+            for (uint32_t i = 0; i < entries; ++i) {
+                uint32_t value = 0;
+                for (uint32_t b = 0; b < entry_size; ++b) {
+                    value = (value << 8) | table[i * entry_size + b];
+                }
+                vbr.toc.push_back(value * scale);
+            }
+        }
+        return true;
+    }
+
+    return false;
+}
+
+bool MP3SeekTable::build_from_toc(const MP3VbrHeader& vbr, const MP3FrameHeader& frame,
+                                  uint64_t audio_start, uint64_t audio_end) {
+    points_.clear();
+    exact_ = false;
+    total_samples_ = static_cast<uint64_t>(vbr.frames) * frame.samples;
+
+    uint64_t first_audio = audio_start + frame.frame_bytes;
+    if (!vbr.found || vbr.frames == 0 || vbr.toc.empty() || audio_end <= first_audio) {
+        return false;
+    }
+
+    points_.push_back({0, first_audio});
+
+    if (vbr.is_vbri) {
+        // Each entry covers frames_per_toc_entry frames after the tag frame
+        uint64_t offset = first_audio;
+        uint64_t frame_index = 0;
+        for (size_t i = 0; i + 1 < vbr.toc.size(); ++i) {
+            offset += vbr.toc[i];
+            frame_index += vbr.frames_per_toc_entry;
+            if (offset >= audio_end || frame_index >= vbr.frames) {
+                break;
+            }
+            points_.push_back({frame_index * frame.samples, offset});
+        }
+    } else {
+        // Entry i gives the stream position at i% of the duration
+        uint64_t stream_bytes = vbr.bytes ? vbr.bytes : audio_end - audio_start;
+        for (size_t i = 1; i < vbr.toc.size(); ++i) {
+            uint64_t offset = audio_start + stream_bytes * vbr.toc[i] / 256;
+            uint64_t sample = total_samples_ * i / 100;
+            if (offset <= points_.back().offset || offset >= audio_end) {
+                continue;
+            }
+            points_.push_back({sample, offset});
+        }
+    }
+
+    return true;
+}
+
+bool MP3SeekTable::build_from_scan(FILE* file, uint64_t audio_start, uint64_t audio_end,
+                                   const std::atomic<bool>& cancel) {
+    points_.clear();
+    exact_ = false;
+    total_samples_ = 0;
+
+    std::vector<uint8_t> buffer;
+    uint64_t buffer_offset = audio_start;
+
+    // Make [offset, offset + need) resident, reading forward in chunks
+    auto ensure = [&](uint64_t offset, size_t need) -> const uint8_t* {
+        if (offset + need > audio_end) {
+            return nullptr;
+        }
+        if (offset < buffer_offset || offset + need > buffer_offset + buffer.size()) {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(
+                std::max(need, SCAN_CHUNK_BYTES), audio_end - offset));
+            buffer.resize(want);
+            if (fseek(file, static_cast<long>(offset), SEEK_SET) != 0) {
+                return nullptr;
+            }
+            buffer.resize(fread(buffer.data(), 1, want, file));
+            buffer_offset = offset;
+            if (buffer.size() < need) {
+                return nullptr;
+            }
+        }
+        return buffer.data() + (offset - buffer_offset);
+    };
+
+    uint64_t offset = audio_start;
+    uint64_t sample = 0;
+    uint64_t synced_offset = UINT64_MAX;
+    bool first = true;
+
+    while (const uint8_t* h = ensure(offset, 4)) {
+        if ((points_.size() & 1023) == 0 && cancel.load(std::memory_order_relaxed)) {
+            points_.clear();
+            return false;
+        }
+
+        MP3FrameHeader frame;
+        if (!parse_mp3_frame_header(h, frame)) {
+            ++offset;  // Resync on garbage between frames
+            continue;
+        }
+
+        uint64_t next = offset + frame.frame_bytes;
+        if (next > audio_end) {
+            break;  // Truncated final frame
+        }
+
+        // After a resync, require the next header to line up too so a stray
+        // sync word in frame data is not taken for a frame
+        if (offset != synced_offset) {
+            const uint8_t* n = ensure(next, 4);
+            MP3FrameHeader next_frame;
+            if (n && !parse_mp3_frame_header(n, next_frame)) {
+                ++offset;
+                continue;
+            }
+        }
+        synced_offset = next;
+
+        if (first) {
+            first = false;
+            const uint8_t* body = ensure(offset, frame.frame_bytes);
+            MP3VbrHeader vbr;
+            if (body && parse_mp3_vbr_header(body, frame.frame_bytes, frame, vbr)) {
+                offset = next;
+                continue;
+            }
+        }
+
+        points_.push_back({sample, offset});
+        sample += frame.samples;
+        offset = next;
+    }
+
+    total_samples_ = sample;
+    exact_ = !points_.empty();
+    return exact_;
+}
+
+bool MP3SeekTable::lookup(uint64_t sample, MP3SeekPoint& point) const {
+    if (points_.empty()) {
+        return false;
+    }
+
+    auto it = std::upper_bound(points_.begin(), points_.end(), sample,
+        [](uint64_t s, const MP3SeekPoint& p) { return s < p.sample; });
+    point = it == points_.begin() ? points_.front() : *(it - 1);
+    return true;
+}
+
+bool MP3SeekTable::lookup_with_preroll(uint64_t sample, MP3SeekPoint& point,
+                                       uint32_t reservoir_bytes) const {
+    if (points_.empty()) {
+        return false;
+    }
+
+    auto it = std::upper_bound(points_.begin(), points_.end(), sample,
+        [](uint64_t s, const MP3SeekPoint& p) { return s < p.sample; });
+    size_t index = it == points_.begin() ? 0 : static_cast<size_t>(it - points_.begin()) - 1;
+    if (exact_ && index > 0) {
+        --index;
+        // Step back until the frames ahead of the pre-roll frame hold the
+        // main data it may reach back for
+        uint64_t main_data = 0;
+        while (index > 0 && main_data < reservoir_bytes) {
+            uint64_t frame_bytes = points_[index].offset - points_[index - 1].offset;
+            main_data += frame_bytes > FRAME_OVERHEAD_BYTES ? frame_bytes - FRAME_OVERHEAD_BYTES : 0;
+            --index;
+        }
+    }
+    point = points_[index];
+    return true;
+}
+
+bool MP3SeekTable::save(const std::string& cache_path, const std::string& media_path) const {
+    uint64_t file_size = 0;
+    int64_t mtime = 0;
+    if (!exact_ || points_.empty() || !file_stamp(media_path, file_size, mtime)) {
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(cache_path).parent_path(), ec);
+
+    // Write to a temporary name and rename, so readers never see a torn file
+    std::string temp_path = cache_path + ".tmp";
+    FILE* out = fopen(temp_path.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+
+    uint32_t path_length = static_cast<uint32_t>(media_path.size());
+    uint64_t count = points_.size();
+    bool ok = fwrite(CACHE_MAGIC, 1, 4, out) == 4 &&
+              fwrite(&CACHE_VERSION, sizeof(CACHE_VERSION), 1, out) == 1 &&
+              fwrite(&file_size, sizeof(file_size), 1, out) == 1 &&
+              fwrite(&mtime, sizeof(mtime), 1, out) == 1 &&
+              fwrite(&path_length, sizeof(path_length), 1, out) == 1 &&
+              fwrite(media_path.data(), 1, path_length, out) == path_length &&
+              fwrite(&total_samples_, sizeof(total_samples_), 1, out) == 1 &&
+              fwrite(&count, sizeof(count), 1, out) == 1 &&
+              fwrite(points_.data(), sizeof(MP3SeekPoint), points_.size(), out) == points_.size();
+    ok = (fclose(out) == 0) && ok;
+
+    if (ok) {
+        std::filesystem::rename(temp_path, cache_path, ec);
+        ok = !ec;
+    }
+    if (!ok) {
+        std::filesystem::remove(temp_path, ec);
+    }
+    return ok;
+}
+
+bool MP3SeekTable::load(const std::string& cache_path, const std::string& media_path) {
+    uint64_t file_size = 0;
+    int64_t mtime = 0;
+    if (!file_stamp(media_path, file_size, mtime)) {
+        return false;
+    }
+
+    FILE* in = fopen(cache_path.c_str(), "rb");
+    if (!in) {
+        return false;
+    }
+
+    char magic[4] = {};
+    uint32_t version = 0;
+    uint64_t cached_size = 0;
+    int64_t cached_mtime = 0;
+    uint32_t path_length = 0;
+    bool ok = fread(magic, 1, 4, in) == 4 && std::memcmp(magic, CACHE_MAGIC, 4) == 0 &&
+              fread(&version, sizeof(version), 1, in) == 1 && version == CACHE_VERSION &&
+              fread(&cached_size, sizeof(cached_size), 1, in) == 1 && cached_size == file_size &&
+              fread(&cached_mtime, sizeof(cached_mtime), 1, in) == 1 && cached_mtime == mtime &&
+              fread(&path_length, sizeof(path_length), 1, in) == 1 &&
+              path_length == media_path.size();
+
+    std::string cached_path(path_length, '\0');
+    uint64_t total = 0;
+    uint64_t count = 0;
+    ok = ok && fread(&cached_path[0], 1, path_length, in) == path_length &&
+         cached_path == media_path &&
+         fread(&total, sizeof(total), 1, in) == 1 &&
+         fread(&count, sizeof(count), 1, in) == 1 &&
+         count > 0 && count <= file_size;
+
+    std::vector<MP3SeekPoint> points;
+    if (ok) {
+        points.resize(static_cast<size_t>(count));
+        ok = fread(points.data(), sizeof(MP3SeekPoint), points.size(), in) == points.size();
+    }
+    fclose(in);
+
+    if (!ok) {
+        return false;
+    }
+
+    points_.swap(points);
+    total_samples_ = total;
+    exact_ = true;
+    return true;
+}
+
+std::string MP3SeekTable::cache_path_for(const std::string& media_path) {
+    std::filesystem::path dir;
+    if (const char* custom = std::getenv("XPUMUSIC_CACHE_DIR")) {
+        dir = custom;
+#ifdef _WIN32
+    } else if (const char* local = std::getenv("LOCALAPPDATA")) {
+        dir = std::filesystem::path(local) / "XpuMusic";
+#else
+    } else if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        dir = std::filesystem::path(xdg) / "xpumusic";
+    } else if (const char* home = std::getenv("HOME")) {
+        dir = std::filesystem::path(home) / ".cache" / "xpumusic";
+#endif
+    } else {
+        dir = std::filesystem::temp_directory_path() / "xpumusic";
+    }
+
+    // FNV-1a of the path names the entry; the path itself is checked on load
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : media_path) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.seek", static_cast<unsigned long long>(hash));
+
+    return (dir / "seek_index" / name).string();
+}
+
+} // namespace xpumusic::plugins
@@ -0,0 +1,119 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace xpumusic::plugins {
+
+/**
+ * @brief Fields of one MPEG audio frame header
+ */
+struct MP3FrameHeader {
+    uint32_t frame_bytes = 0;       // Whole frame incl. header and padding
+    uint32_t samples = 0;           // Samples per channel in this frame
+    uint32_t sample_rate = 0;
+    uint32_t bitrate = 0;           // Bits per second
+    uint16_t channels = 0;
+    uint8_t layer = 0;              // 1, 2 or 3
+    bool mpeg1 = false;
+};
+
+/**
+ * @brief Parse a 4 byte frame header. Rejects free-format and reserved values.
+ */
+bool parse_mp3_frame_header(const uint8_t* data, MP3FrameHeader& header);
+
+/**
+ * @brief Xing/Info or VBRI header carried in the first frame
+ */
+struct MP3VbrHeader {
+    bool found = false;
+    bool is_vbri = false;
+    bool is_info = false;           // CBR "Info" tag
+    uint32_t frames = 0;            // Audio frames, excl. the tag frame
+    uint32_t bytes = 0;             // Stream bytes incl. the tag frame, 0 if absent
+    std::vector<uint32_t> toc;      // Xing: 100 entries in 1/256ths of the stream
+                                    // VBRI: bytes covered by each entry
+    uint32_t frames_per_toc_entry = 0;  // VBRI only
+};
+
+/**
+ * @brief Look for a Xing/Info or VBRI header in the frame at data
+ */
+bool parse_mp3_vbr_header(const uint8_t* data, size_t size, const MP3FrameHeader& frame,
+                          MP3VbrHeader& vbr);
+
+/**
+ * @brief Byte offset of a frame start and the decoder sample it begins at
+ */
+struct MP3SeekPoint {
+    uint64_t sample = 0;
+    uint64_t offset = 0;
+};
+
+/**
+ * @brief Sample-to-byte index for an MP3 stream
+ *
+ * Either approximate, from the Xing/VBRI TOC, or exact, with one point per
+ * frame from a header scan. Samples are on the decoder's output timeline,
+ * which starts at the first audio frame; a Xing/Info/VBRI tag frame is
+ * metadata and is not counted.
+ */
+class MP3SeekTable {
+public:
+    /**
+     * @brief Build an approximate table from a VBR header TOC
+     * @param audio_start Offset of the frame carrying the tag
+     */
+    bool build_from_toc(const MP3VbrHeader& vbr, const MP3FrameHeader& frame,
+                        uint64_t audio_start, uint64_t audio_end);
+
+    /**
+     * @brief Build an exact table by walking frame headers
+     * @return false if the scan was cancelled or found no frames
+     */
+    bool build_from_scan(FILE* file, uint64_t audio_start, uint64_t audio_end,
+                         const std::atomic<bool>& cancel);
+
+    /**
+     * @brief Point at or before sample, O(log n)
+     */
+    bool lookup(uint64_t sample, MP3SeekPoint& point) const;
+
+    /**
+     * @brief For exact tables, the point one frame before the one holding
+     *        sample, so the decoder can pre-roll its overlap and bit reservoir
+     * @param reservoir_bytes Main data the frames ahead of that pre-roll frame
+     *        must also carry, so the pre-roll frame itself decodes; each frame
+     *        is counted without its header, CRC and side information
+     */
+    bool lookup_with_preroll(uint64_t sample, MP3SeekPoint& point,
+                             uint32_t reservoir_bytes = 0) const;
+
+    bool is_exact() const { return exact_; }
+    bool empty() const { return points_.empty(); }
+    size_t size() const { return points_.size(); }
+    uint64_t total_samples() const { return total_samples_; }
+
+    /**
+     * @brief Persist an exact table, keyed on path, size and modification time
+     */
+    bool save(const std::string& cache_path, const std::string& media_path) const;
+    bool load(const std::string& cache_path, const std::string& media_path);
+
+    /**
+     * @brief Cache file for media_path: $XPUMUSIC_CACHE_DIR, else the
+     *        platform cache directory, under seek_index/
+     */
+    static std::string cache_path_for(const std::string& media_path);
+
+private:
+    std::vector<MP3SeekPoint> points_;
+    uint64_t total_samples_ = 0;
+    bool exact_ = false;
+};
+
+} // namespace xpumusic::plugins
@@ -1,4 +1,5 @@
 ﻿#include "mp_dsp.h"
+#include "../../core/biquad_cascade.h"
 #include <cmath>
 #include <cstring>
 #include <vector>
@@ -7,68 +8,19 @@
 namespace mp {
 namespace dsp {
 
-// Biquad filter implementation for peaking EQ
-struct BiquadFilter {
-    // Filter coefficients
-    float b0, b1, b2;  // Numerator coefficients
-    float a1, a2;      // Denominator coefficients (a0 is normalized to 1)
+// Peaking EQ section (RBJ cookbook); 0 dB gives an exact identity
+static core::BiquadCoefficients design_peaking(float sample_rate, float freq, float gain_db, float q) {
+    const float pi = 3.14159265358979323846f;
+    float A = std::pow(10.0f, gain_db / 40.0f);
+    float omega = 2.0f * pi * freq / sample_rate;
+    float sin_omega = std::sin(omega);
+    float cos_omega = std::cos(omega);
+    float alpha = sin_omega / (2.0f * q);
     
-    // State variables (for stereo)
-    float x1[2], x2[2];  // Input history
-    float y1[2], y2[2];  // Output history
-    
-    BiquadFilter() {
-        reset();
-    }
-    
-    void reset() {
-        b0 = 1.0f; b1 = 0.0f; b2 = 0.0f;
-        a1 = 0.0f; a2 = 0.0f;
-        std::memset(x1, 0, sizeof(x1));
-        std::memset(x2, 0, sizeof(x2));
-        std::memset(y1, 0, sizeof(y1));
-        std::memset(y2, 0, sizeof(y2));
-    }
-    
-    // Design peaking EQ filter
-    void design_peaking(float sample_rate, float freq, float gain_db, float q) {
-        const float pi = 3.14159265358979323846f;
-        float A = std::pow(10.0f, gain_db / 40.0f);
-        float omega = 2.0f * pi * freq / sample_rate;
-        float sin_omega = std::sin(omega);
-        float cos_omega = std::cos(omega);
-        float alpha = sin_omega / (2.0f * q);
-        
-        // Peaking EQ filter coefficients
-        b0 = 1.0f + alpha * A;
-        b1 = -2.0f * cos_omega;
-        b2 = 1.0f - alpha * A;
-        float a0 = 1.0f + alpha / A;
-        a1 = -2.0f * cos_omega;
-        a2 = 1.0f - alpha / A;
-        
-        // Normalize by a0
-        b0 /= a0;
-        b1 /= a0;
-        b2 /= a0;
-        a1 /= a0;
-        a2 /= a0;
-    }
-    
-    // Process a single sample for one channel
-    inline float process(float input, int channel) {
-        float output = b0 * input + b1 * x1[channel] + b2 * x2[channel]
-                                   - a1 * y1[channel] - a2 * y2[channel];
-        
-        // Update state
-        x2[channel] = x1[channel];
-        x1[channel] = input;
-        y2[channel] = y1[channel];
-        y1[channel] = output;
-        
-        return output;
-    }
-};
+    return core::BiquadCoefficients::normalized(
+        1.0f + alpha * A, -2.0f * cos_omega, 1.0f - alpha * A,
+        1.0f + alpha / A, -2.0f * cos_omega, 1.0f - alpha / A);
+}
 
 // 10-band graphic equalizer DSP plugin
 class EqualizerDSP : public IDSPProcessor, public IPlugin {
@@ -104,12 +56,12 @@ public:
         sample_rate_ = config->sample_rate;
         channels_ = config->channels;
         
-        if (channels_ > 2) {
-            // Currently only support mono and stereo
+        if (channels_ == 0 || channels_ > core::BiquadCascade::MAX_CHANNELS) {
             return Result::NotSupported;
         }
         
         // Design all filters
+        cascade_.configure(NUM_BANDS, channels_);
         update_filters();
         
         return Result::Success;
@@ -133,20 +85,8 @@ public:
         // Process audio
         float* buffer = static_cast<float*>(input->data);
         
-        // Process each frame
-        for (size_t frame = 0; frame < input->frames; ++frame) {
-            for (int ch = 0; ch < channels_; ++ch) {
-                size_t sample_idx = frame * channels_ + ch;
-                float sample = buffer[sample_idx];
-                
-                // Apply all band filters in series
-                for (int band = 0; band < NUM_BANDS; ++band) {
-                    sample = filters_[band].process(sample, ch);
-                }
-                
-                buffer[sample_idx] = sample;
-            }
-        }
+        // All bands and channels in one pass; flat bands are skipped
+        cascade_.process(buffer, input->frames);
         
         // If output buffer provided, copy result
         if (output && output != input) {
@@ -164,9 +104,7 @@ public:
     
     void reset() override {
         // Reset all filter states
-        for (int i = 0; i < NUM_BANDS; ++i) {
-            filters_[i].reset();
-        }
+        cascade_.reset();
     }
     
     void set_bypass(bool bypass) override {
@@ -180,7 +118,8 @@ public:
     uint32_t get_dsp_capabilities() const {
         return static_cast<uint32_t>(DSPCapability::InPlace) |
                static_cast<uint32_t>(DSPCapability::Bypass) |
-               static_cast<uint32_t>(DSPCapability::Stereo);
+               static_cast<uint32_t>(DSPCapability::Stereo) |
+               static_cast<uint32_t>(DSPCapability::Multichannel);
     }
     
     PluginCapability get_capabilities() const override {
@@ -296,19 +235,19 @@ private:
             return;
         }
         
-        filters_[band].design_peaking(
+        cascade_.set_section(band, design_peaking(
             static_cast<float>(sample_rate_),
             BAND_FREQUENCIES[band],
             band_gains_db_[band],
             Q_FACTOR
-        );
+        ));
     }
     
     uint32_t sample_rate_;
     uint16_t channels_;
     bool bypassed_;
     float band_gains_db_[NUM_BANDS];
-    BiquadFilter filters_[NUM_BANDS];
+    core::BiquadCascade cascade_;
 };
 
 }} // namespace mp::dsp
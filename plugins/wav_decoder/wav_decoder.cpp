@@ -5,10 +5,9 @@
  */
 
 #include "../../sdk/xpumusic_plugin_sdk.h"
-#include <fstream>
+#include "../../core/pcm_file_reader.h"
 #include <cstring>
 #include <algorithm>
-#include <endian.h>
 
 // Import plugin SDK types for convenience
 using xpumusic::IPlugin;
@@ -20,36 +19,14 @@ using xpumusic::AudioBuffer;
 using xpumusic::MetadataItem;
 using xpumusic::PluginType;
 
-// WAV鏂囦欢澶寸粨鏋?
-#pragma pack(push, 1)
-struct WAVHeader {
-    char riff[4];
-    uint32_t size;
-    char wave[4];
-    char fmt[4];
-    uint32_t fmt_size;
-    uint16_t format;
-    uint16_t channels;
-    uint32_t sample_rate;
-    uint32_t byte_rate;
-    uint16_t block_align;
-    uint16_t bits;
-};
-#pragma pack(pop)
-
 class WAVDecoderPlugin : public IAudioDecoder {
 private:
-    std::ifstream file_;
-    WAVHeader header_;
+    mp::core::PcmFileReader reader_;
     AudioFormat format_;
-    int64_t data_start_;
-    int64_t data_size_;
-    int64_t current_position_;
     bool is_open_;
 
 public:
-    WAVDecoderPlugin() : data_start_(0), data_size_(0), current_position_(0), is_open_(false) {
-        memset(&header_, 0, sizeof(header_));
+    WAVDecoderPlugin() : format_(), is_open_(false) {
     }
 
     bool initialize() override {
@@ -70,7 +47,7 @@ public:
         info.description = "WAV audio format decoder plugin";
         info.type = PluginType::AudioDecoder;
         info.api_version = XPUMUSIC_PLUGIN_API_VERSION;
-        info.supported_formats = {"wav", "wave"};
+        info.supported_formats = {"wav", "wave", "rf64", "bw64", "aif", "aiff", "aifc"};
         return info;
     }
 
@@ -94,11 +71,14 @@ public:
         std::string ext = file_path.substr(pos + 1);
         std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
 
-        return ext == "wav" || ext == "wave";
+        for (const auto& supported : get_supported_extensions()) {
+            if (ext == supported) return true;
+        }
+        return false;
     }
 
     std::vector<std::string> get_supported_extensions() override {
-        return {"wav", "wave"};
+        return {"wav", "wave", "rf64", "bw64", "aif", "aiff", "aifc"};
     }
 
     bool open(const std::string& file_path) override {
@@ -106,65 +86,18 @@ public:
             close();
         }
 
-        file_.open(file_path, std::ios::binary);
-        if (!file_.is_open()) {
-            last_error_ = "Failed to open file: " + file_path;
-            set_state(PluginState::Error);
-            return false;
-        }
-
-        // 璇诲彇WAV澶?
-        file_.read(reinterpret_cast<char*>(&header_), sizeof(header_));
-        if (file_.gcount() != sizeof(header_)) {
-            last_error_ = "Invalid WAV file: cannot read header";
-            file_.close();
-            set_state(PluginState::Error);
-            return false;
-        }
-
-        // 楠岃瘉WAV鏍煎紡
-        if (strncmp(header_.riff, "RIFF", 4) != 0 ||
-            strncmp(header_.wave, "WAVE", 4) != 0) {
-            last_error_ = "Invalid WAV file: wrong signature";
-            file_.close();
+        // Maps the file and parses WAV, RF64/BW64 or AIFF in place
+        if (!reader_.open(file_path)) {
+            last_error_ = reader_.last_error();
             set_state(PluginState::Error);
             return false;
         }
 
-        // 妫€鏌ユ牸寮忔槸鍚︿负PCM
-        if (le16toh(header_.format) != 1) {
-            last_error_ = "Only PCM WAV format is supported";
-            file_.close();
-            set_state(PluginState::Error);
-            return false;
-        }
+        format_.sample_rate = reader_.sample_rate();
+        format_.channels = reader_.channels();
+        format_.bits_per_sample = reader_.bits_per_sample();
+        format_.is_float = reader_.is_float();
 
-        // 璁剧疆闊抽鏍煎紡
-        format_.sample_rate = le32toh(header_.sample_rate);
-        format_.channels = le16toh(header_.channels);
-        format_.bits_per_sample = le16toh(header_.bits);
-        format_.is_float = false;
-
-        if (format_.bits_per_sample != 8 &&
-            format_.bits_per_sample != 16 &&
-            format_.bits_per_sample != 24 &&
-            format_.bits_per_sample != 32) {
-            last_error_ = "Unsupported bits per sample: " +
-                         std::to_string(format_.bits_per_sample);
-            file_.close();
-            set_state(PluginState::Error);
-            return false;
-        }
-
-        // 鏌ユ壘data鍧?
-        if (!find_data_chunk()) {
-            last_error_ = "Data chunk not found";
-            file_.close();
-            set_state(PluginState::Error);
-            return false;
-        }
-
-        current_position_ = 0;
         is_open_ = true;
         set_state(PluginState::Active);
         return true;
@@ -175,32 +108,12 @@ public:
             last_error_ = "Decoder not open or invalid buffer";
             return -1;
         }
-
-        // 璁＄畻鍙鍙栫殑甯ф暟
-        int64_t remaining_frames = (data_size_ / (format_.bits_per_sample / 8) / format_.channels) - current_position_;
-        int frames_to_read = std::min(static_cast<int64_t>(max_frames), remaining_frames);
-
-        if (frames_to_read <= 0) {
-            return 0; // EOF
-        }
-
-        // 璇诲彇鍘熷鏁版嵁
-        int bytes_to_read = frames_to_read * format_.channels * (format_.bits_per_sample / 8);
-        std::vector<char> raw_data(bytes_to_read);
-        file_.read(raw_data.data(), bytes_to_read);
-        int bytes_read = file_.gcount();
-
-        if (bytes_read == 0) {
-            return 0; // EOF
+        if (max_frames <= 0) {
+            return 0;
         }
 
-        int frames_read = bytes_read / (format_.channels * (format_.bits_per_sample / 8));
-
-        // 杞崲涓烘诞鐐规暟
-        convert_to_float(raw_data.data(), frames_read, buffer.data);
-
-        current_position_ += frames_read;
-        return frames_read;
+        // Converted straight from the mapped pages, no staging copy
+        return static_cast<int>(reader_.read(buffer.data, static_cast<size_t>(max_frames)));
     }
 
     bool seek(int64_t sample_pos) override {
@@ -209,35 +122,21 @@ public:
             return false;
         }
 
-        int64_t total_frames = data_size_ / (format_.bits_per_sample / 8) / format_.channels;
-        if (sample_pos < 0 || sample_pos > total_frames) {
+        if (sample_pos < 0 || sample_pos > get_length()) {
             last_error_ = "Invalid seek position";
             return false;
         }
 
-        int64_t byte_pos = data_start_ +
-                          sample_pos * format_.channels * (format_.bits_per_sample / 8);
-
-        file_.seekg(byte_pos, std::ios::beg);
-        if (file_.fail()) {
-            last_error_ = "Failed to seek";
-            return false;
-        }
-
-        current_position_ = sample_pos;
+        reader_.seek(static_cast<uint64_t>(sample_pos));
         return true;
     }
 
     void close() override {
         if (is_open_) {
-            file_.close();
+            reader_.close();
             is_open_ = false;
         }
-        memset(&header_, 0, sizeof(header_));
         format_ = {};
-        data_start_ = 0;
-        data_size_ = 0;
-        current_position_ = 0;
         set_state(PluginState::Initialized);
     }
 
@@ -246,8 +145,7 @@ public:
     }
 
     int64_t get_length() const override {
-        if (format_.bits_per_sample == 0 || format_.channels == 0) return 0;
-        return data_size_ / (format_.bits_per_sample / 8) / format_.channels;
+        return static_cast<int64_t>(reader_.total_frames());
     }
 
     double get_duration() const override {
@@ -274,77 +172,12 @@ public:
     }
 
     int64_t get_position() const override {
-        return current_position_;
+        return static_cast<int64_t>(reader_.position());
     }
 
     bool is_eof() const override {
         if (!is_open_) return true;
-        return current_position_ >= get_length();
-    }
-
-private:
-    bool find_data_chunk() {
-        // 浠庡綋鍓嶄綅缃紑濮嬫煡鎵綿ata鍧?
-        file_.seekg(sizeof(WAVHeader), std::ios::beg);
-
-        char chunk_id[5] = {0};
-        uint32_t chunk_size;
-
-        while (file_.read(chunk_id, 4)) {
-            if (strncmp(chunk_id, "data", 4) == 0) {
-                file_.read(reinterpret_cast<char*>(&chunk_size), 4);
-                data_size_ = le32toh(chunk_size);
-                data_start_ = file_.tellg();
-                return true;
-            }
-
-            // 璺宠繃鍏朵粬鍧?
-            file_.read(reinterpret_cast<char*>(&chunk_size), 4);
-            chunk_size = le32toh(chunk_size);
-            file_.seekg(chunk_size, std::ios::cur);
-        }
-
-        return false;
-    }
-
-    void convert_to_float(const char* src, int frames, float* dst) {
-        int samples = frames * format_.channels;
-        int bytes_per_sample = format_.bits_per_sample / 8;
-
-        for (int i = 0; i < samples; i++) {
-            int32_t sample = 0;
-
-            switch (bytes_per_sample) {
-                case 1: // 8浣?
-                    sample = static_cast<int8_t>(src[i]) - 128;
-                    sample = sample << 24; // 杞崲涓?2浣?
-                    break;
-
-                case 2: // 16浣?
-                    sample = static_cast<int16_t>(
-                        (static_cast<uint8_t>(src[i*2+1]) << 8) |
-                        static_cast<uint8_t>(src[i*2])
-                    );
-                    sample = sample << 16;
-                    break;
-
-                case 3: // 24浣?
-                    sample = (static_cast<int8_t>(src[i*3+2]) << 24) |
-                            (static_cast<uint8_t>(src[i*3+1]) << 16) |
-                            (static_cast<uint8_t>(src[i*3]) << 8);
-                    break;
-
-                case 4: // 32浣?
-                    sample = (static_cast<int8_t>(src[i*4+3]) << 24) |
-                            (static_cast<uint8_t>(src[i*4+2]) << 16) |
-                            (static_cast<uint8_t>(src[i*4+1]) << 8) |
-                            static_cast<uint8_t>(src[i*4]);
-                    break;
-            }
-
-            // 杞崲涓烘诞鐐规暟 [-1.0, 1.0]
-            dst[i] = static_cast<float>(sample) / 2147483648.0f;
-        }
+        return reader_.remaining_frames() == 0;
     }
 };
 
@@ -15,6 +15,7 @@ constexpr EventID EVENT_PLAYBACK_PAUSED = hash_string("mp.event.playback_paused"
 constexpr EventID EVENT_PLAYBACK_RESUMED = hash_string("mp.event.playback_resumed");
 constexpr EventID EVENT_TRACK_CHANGED = hash_string("mp.event.track_changed");
 constexpr EventID EVENT_SEEK = hash_string("mp.event.seek");
+constexpr EventID EVENT_POSITION_CHANGED = hash_string("mp.event.position_changed");
 constexpr EventID EVENT_VOLUME_CHANGED = hash_string("mp.event.volume_changed");
 constexpr EventID EVENT_CONFIG_CHANGED = hash_string("mp.event.config_changed");
 constexpr EventID EVENT_LIBRARY_UPDATED = hash_string("mp.event.library_updated");
@@ -32,10 +32,10 @@ bool CubicSampleRateConverter::initialize(int input_rate, int output_rate, int c
     output_rate_ = output_rate;
     channels_ = channels;
     ratio_ = static_cast<double>(input_rate) / output_rate;
-    position_ = 0.0;
+    position_ = history_size_ - 1;  // One frame of (silent) history ahead of the input
 
     // Initialize history buffer (need 4 frames per channel for cubic interpolation)
-    history_buffer_.resize(channels_ * history_size_, 0.0f);
+    history_buffer_.assign(channels_ * history_size_, 0.0f);
 
     // Initialize anti-aliasing filter if downsampling
     if (output_rate < input_rate) {
@@ -65,38 +65,42 @@ int CubicSampleRateConverter::convert(const float* input, int input_frames,
 
     int output_frames = 0;
     int total_input_frames = input_frames + history_size_;
+    size_t history_samples = history_buffer_.size();
 
-    // Create extended buffer with history
-    std::vector<float> extended_input(total_input_frames * channels_);
+    // Extended buffer: history frames followed by the new input. Kept as a
+    // member so steady-state streaming does not touch the heap.
+    if (extended_input_.size() < static_cast<size_t>(total_input_frames * channels_)) {
+        extended_input_.resize(total_input_frames * channels_);
+    }
 
     // Copy history buffer first
-    std::memcpy(extended_input.data(), history_buffer_.data(),
-                history_buffer_.size() * sizeof(float));
-
-    // Copy new input
-    std::memcpy(extended_input.data() + history_buffer_.size(),
-                input, input_frames * channels_ * sizeof(float));
+    std::memcpy(extended_input_.data(), history_buffer_.data(),
+                history_samples * sizeof(float));
 
-    // Apply anti-aliasing filter if downsampling
+    // Append new input, band-limited first if downsampling. History is
+    // already filtered, so only the new frames pass through the filter.
     if (filter_ && output_rate_ < input_rate_) {
-        std::vector<float> filtered_input(total_input_frames * channels_);
-        filter_->process(extended_input.data(), filtered_input.data(),
-                        total_input_frames, channels_);
-        extended_input = std::move(filtered_input);
+        filter_->process(input, extended_input_.data() + history_samples,
+                         input_frames, channels_);
+    } else {
+        std::memcpy(extended_input_.data() + history_samples,
+                    input, input_frames * channels_ * sizeof(float));
     }
 
-    // Process each output sample
-    while (output_frames < max_output_frames && position_ < input_frames + 1) {
+    // Process each output sample; position_ indexes the extended buffer and
+    // needs one frame before and two after it
+    while (output_frames < max_output_frames &&
+           static_cast<int>(position_) + 2 < total_input_frames) {
         int pos_int = static_cast<int>(position_);
         double pos_frac = position_ - pos_int;
 
         // Cubic interpolation for each channel
         for (int ch = 0; ch < channels_; ++ch) {
             // Get 4 consecutive samples for cubic interpolation
-            float y0 = extended_input[(pos_int - 1) * channels_ + ch];
-            float y1 = extended_input[(pos_int) * channels_ + ch];
-            float y2 = extended_input[(pos_int + 1) * channels_ + ch];
-            float y3 = extended_input[(pos_int + 2) * channels_ + ch];
+            float y0 = extended_input_[(pos_int - 1) * channels_ + ch];
+            float y1 = extended_input_[(pos_int) * channels_ + ch];
+            float y2 = extended_input_[(pos_int + 1) * channels_ + ch];
+            float y3 = extended_input_[(pos_int + 2) * channels_ + ch];
 
             output[output_frames * channels_ + ch] =
                 cubic_interpolate(y0, y1, y2, y3, static_cast<float>(pos_frac));
@@ -106,32 +110,24 @@ int CubicSampleRateConverter::convert(const float* input, int input_frames,
         position_ += ratio_;
     }
 
-    // Update history buffer for next call
-    if (input_frames >= history_size_) {
-        std::memcpy(history_buffer_.data(),
-                    input + (input_frames - history_size_) * channels_,
-                    history_size_ * channels_ * sizeof(float));
-    } else {
-        // Not enough frames, shift existing history
-        int shift = std::min(input_frames, history_size_ - 1);
-        std::memmove(history_buffer_.data(),
-                     history_buffer_.data() + shift * channels_,
-                     (history_size_ - shift) * channels_ * sizeof(float));
-        std::memcpy(history_buffer_.data() + (history_size_ - shift) * channels_,
-                    input, input_frames * channels_ * sizeof(float));
-    }
+    // Keep the tail as history and rebase the position onto it
+    std::memcpy(history_buffer_.data(),
+                extended_input_.data() + (total_input_frames - history_size_) * channels_,
+                history_samples * sizeof(float));
+    position_ -= input_frames;
 
     return output_frames;
 }
 
 int CubicSampleRateConverter::get_latency() const {
-    // Cubic interpolation has 1 sample delay plus filter delay
-    int filter_delay = filter_ ? 50 : 0;  // Approximate
+    // In input frames: the interpolator starts one frame back, and the
+    // 101-tap linear-phase filter delays by half its length
+    int filter_delay = filter_ ? 50 : 0;
     return 1 + filter_delay;
 }
 
 void CubicSampleRateConverter::reset() {
-    position_ = 0.0;
+    position_ = history_size_ - 1;
     std::fill(history_buffer_.begin(), history_buffer_.end(), 0.0f);
     if (filter_) {
         filter_->reset();
@@ -140,12 +136,12 @@ void CubicSampleRateConverter::reset() {
 
 // AntiAliasingFilter implementation
 AntiAliasingFilter::AntiAliasingFilter(double cutoff, int taps)
-    : cutoff_(cutoff)
-    , taps_(taps)
-    , delay_index_(0) {
+    : delay_index_(0)
+    , channels_(0)
+    , cutoff_(cutoff)
+    , taps_(taps) {
 
     coefficients_.resize(taps_);
-    delay_line_.resize(taps_);
 
     // Generate FIR filter coefficients using Kaiser window
     double beta = 6.0;  // Kaiser window parameter
@@ -174,16 +170,28 @@ AntiAliasingFilter::AntiAliasingFilter(double cutoff, int taps)
 
 void AntiAliasingFilter::process(const float* input, float* output,
                                 int frames, int channels) {
+    // One delay line per channel, stored twice back to back so the newest
+    // taps_ samples are always contiguous and the tap loop needs no wrap
+    if (channels != channels_) {
+        channels_ = channels;
+        delay_line_.assign(static_cast<size_t>(2 * taps_ * channels_), 0.0f);
+        delay_index_ = 0;
+    }
+
     for (int frame = 0; frame < frames; ++frame) {
         for (int ch = 0; ch < channels; ++ch) {
+            float* line = delay_line_.data() + 2 * taps_ * ch;
+
             // Update delay line
-            delay_line_[delay_index_] = input[frame * channels + ch];
+            float sample = input[frame * channels + ch];
+            line[delay_index_] = sample;
+            line[delay_index_ + taps_] = sample;
 
-            // Apply FIR filter
+            // Apply FIR filter; line[delay_index_ + taps_] is the newest sample
+            const float* newest = line + delay_index_ + taps_;
             float sum = 0.0f;
             for (int i = 0; i < taps_; ++i) {
-                int idx = (delay_index_ - i + taps_) % taps_;
-                sum += delay_line_[idx] * coefficients_[i];
+                sum += newest[-i] * coefficients_[i];
             }
 
             output[frame * channels + ch] = sum;
@@ -19,8 +19,9 @@ namespace audio {
 class AntiAliasingFilter {
 private:
     std::vector<float> coefficients_;
-    std::vector<float> delay_line_;
+    std::vector<float> delay_line_;   // Per channel, mirrored (2 * taps_)
     int delay_index_;
+    int channels_;
     double cutoff_;
     int taps_;
 
@@ -64,6 +65,7 @@ private:
     int history_size_;                // Number of frames to keep in history
 
     std::vector<float> history_buffer_; // History for continuity
+    std::vector<float> extended_input_; // History + input scratch, reused across calls
     std::unique_ptr<AntiAliasingFilter> filter_; // Anti-aliasing filter
 
     /**
@@ -28,11 +28,9 @@ EnhancedSampleRateConverter::create_converter(ResampleQuality quality) {
         case ResampleQuality::Good:
             return CubicSampleRateConverterFactory::create();
         case ResampleQuality::High:
-            // Currently fall back to cubic (good) for High
-            return CubicSampleRateConverterFactory::create();
+            return HighQualitySampleRateConverterFactory::create();
         case ResampleQuality::Best:
-            // Currently fall back to cubic (good) for Best
-            return CubicSampleRateConverterFactory::create();
+            return BestQualitySampleRateConverterFactory::create();
         default:
             return SampleRateConverterFactory::create("linear");
     }
@@ -84,8 +82,8 @@ const char* EnhancedSampleRateConverter::get_name() const {
     switch (quality_) {
         case ResampleQuality::Fast: return "Linear (Fast)";
         case ResampleQuality::Good: return "Cubic (Good)";
-        case ResampleQuality::High: return "Cubic (High)";  // Currently using Cubic
-        case ResampleQuality::Best: return "Cubic (Best)";  // Currently using Cubic
+        case ResampleQuality::High: return "Sinc (High)";
+        case ResampleQuality::Best: return "Sinc (Best)";
         default: return "Unknown";
     }
 }
@@ -123,8 +121,8 @@ double EnhancedSampleRateConverter::get_cpu_usage_estimate(ResampleQuality quali
     switch (quality) {
         case ResampleQuality::Fast: return 0.1;      // <0.1% CPU
         case ResampleQuality::Good: return 0.5;      // ~0.5% CPU
-        case ResampleQuality::High: return 1.0;      // Currently same as Good
-        case ResampleQuality::Best: return 1.0;      // Currently same as Good
+        case ResampleQuality::High: return 1.0;      // 33-tap polyphase
+        case ResampleQuality::Best: return 2.0;      // 101-tap polyphase
         default: return 1.0;
     }
 }
@@ -136,9 +134,9 @@ const char* EnhancedSampleRateConverter::get_quality_description(ResampleQuality
         case ResampleQuality::Good:
             return "Cubic interpolation with anti-aliasing (THD: ~-100dB)";
         case ResampleQuality::High:
-            return "8-tap sinc interpolation for professional use (THD: ~-120dB)";
+            return "32-tap polyphase sinc interpolation for professional use (THD: ~-120dB)";
         case ResampleQuality::Best:
-            return "16-tap sinc interpolation for critical applications (THD: ~-140dB)";
+            return "101-tap polyphase sinc interpolation for critical applications (THD: ~-140dB)";
         default:
             return "Unknown quality level";
     }
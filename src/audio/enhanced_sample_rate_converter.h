@@ -20,8 +20,8 @@ namespace audio {
 enum class ResampleQuality {
     Fast,       // Linear interpolation (current)
     Good,       // Cubic interpolation
-    High,       // High quality (placeholder for future)
-    Best        // Best quality (placeholder for future)
+    High,       // 32-tap polyphase sinc
+    Best        // 101-tap polyphase sinc
 };
 
 /**
@@ -19,21 +19,16 @@
 #include <windows.h>
 #undef min
 #undef max
+#else
+#include <cpuid.h>
 #endif
 
 namespace audio {
 
-// Static member definitions
-SIMDOperations::CPUFeatures SIMDOperations::cpu_features_{};
-bool SIMDOperations::features_detected_ = false;
-
-// SIMDOperations implementation
-SIMDOperations::CPUFeatures SIMDOperations::detect_cpu_features() {
-    if (features_detected_) {
-        return cpu_features_;
-    }
+namespace {
 
-    CPUFeatures features = {};
+SIMDOperations::CPUFeatures query_cpu_features() {
+    SIMDOperations::CPUFeatures features = {};
 
 #ifdef _WIN32
     int cpu_info[4];
@@ -70,21 +65,21 @@ SIMDOperations::CPUFeatures SIMDOperations::detect_cpu_features() {
     features.has_avx2 = (ebx & (1 << 5)) != 0;
 #endif
 
-    cpu_features_ = features;
-    features_detected_ = true;
+    return features;
+}
 
-    std::cout << "CPU Features detected:" << std::endl;
-    std::cout << "  SSE2: " << (features.has_sse2 ? "Yes" : "No") << std::endl;
-    std::cout << "  SSE4.1: " << (features.has_sse4_1 ? "Yes" : "No") << std::endl;
-    std::cout << "  AVX: " << (features.has_avx ? "Yes" : "No") << std::endl;
-    std::cout << "  AVX2: " << (features.has_avx2 ? "Yes" : "No") << std::endl;
-    std::cout << "  FMA3: " << (features.has_fma3 ? "Yes" : "No") << std::endl;
+} // namespace
 
+// SIMDOperations implementation
+const SIMDOperations::CPUFeatures& SIMDOperations::detect_cpu_features() {
+    // Queried on first use; the static's initialization is thread-safe, so
+    // decoders opening on several threads at once all see the same result
+    static const CPUFeatures features = query_cpu_features();
     return features;
 }
 
 void SIMDOperations::convert_int16_to_float_sse2(const int16_t* src, float* dst, size_t samples) {
-    if (!cpu_features_.has_sse2) {
+    if (!detect_cpu_features().has_sse2) {
         // Fallback to scalar implementation
         for (size_t i = 0; i < samples; i++) {
             dst[i] = src[i] * (1.0f / 32768.0f);
@@ -135,7 +130,7 @@ void SIMDOperations::convert_int24_to_float_sse2(const uint8_t* src, float* dst,
 }
 
 void SIMDOperations::convert_float_to_int16_sse2(const float* src, int16_t* dst, size_t samples) {
-    if (!cpu_features_.has_sse2) {
+    if (!detect_cpu_features().has_sse2) {
         // Fallback
         for (size_t i = 0; i < samples; i++) {
             float sample = std::max(-1.0f, std::min(1.0f, src[i]));
@@ -179,7 +174,7 @@ void SIMDOperations::convert_float_to_int16_sse2(const float* src, int16_t* dst,
 }
 
 void SIMDOperations::volume_sse2(float* audio, size_t samples, float volume) {
-    if (!cpu_features_.has_sse2 || volume == 1.0f) {
+    if (!detect_cpu_features().has_sse2 || volume == 1.0f) {
         if (volume != 1.0f) {
             for (size_t i = 0; i < samples; i++) {
                 audio[i] *= volume;
@@ -203,7 +198,7 @@ void SIMDOperations::volume_sse2(float* audio, size_t samples, float volume) {
 }
 
 void SIMDOperations::mix_channels_sse2(const float* src1, const float* src2, float* dst, size_t samples) {
-    if (!cpu_features_.has_sse2) {
+    if (!detect_cpu_features().has_sse2) {
         for (size_t i = 0; i < samples; i++) {
             dst[i] = src1[i] + src2[i];
         }
@@ -227,7 +222,7 @@ void SIMDOperations::mix_channels_sse2(const float* src1, const float* src2, flo
 
 void SIMDOperations::interpolate_linear_sse2(const float* a, const float* b, float* out,
                                             size_t samples, float ratio) {
-    if (!cpu_features_.has_sse2) {
+    if (!detect_cpu_features().has_sse2) {
         for (size_t i = 0; i < samples; i++) {
             float t = ratio * static_cast<float>(i) / static_cast<float>(samples);
             out[i] = a[i] * (1.0f - t) + b[i] * t;
@@ -257,9 +252,64 @@ void SIMDOperations::interpolate_linear_sse2(const float* a, const float* b, flo
     }
 }
 
+float SIMDOperations::dot_product_sse2(const float* a, const float* b, size_t samples) {
+    // Two accumulators hide the add latency
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 8 <= samples; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    for (; i + 4 <= samples; i += 4) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+    float sum = _mm_cvtss_f32(acc0);
+
+    for (; i < samples; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+void SIMDOperations::interleave_int32_to_float_sse2(const int32_t* const* planes, size_t channels,
+                                                   size_t frames, float scale, float* dst) {
+    const __m128 scale_vec = _mm_set1_ps(scale);
+    size_t i = 0;
+
+    if (channels == 1) {
+        for (; i + 4 <= frames; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[0] + i));
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale_vec));
+        }
+    } else if (channels == 2) {
+        for (; i + 4 <= frames; i += 4) {
+            __m128 left = _mm_mul_ps(_mm_cvtepi32_ps(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[0] + i))), scale_vec);
+            __m128 right = _mm_mul_ps(_mm_cvtepi32_ps(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[1] + i))), scale_vec);
+            _mm_storeu_ps(dst + i * 2, _mm_unpacklo_ps(left, right));
+            _mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(left, right));
+        }
+    }
+
+    for (; i < frames; i++) {
+        for (size_t c = 0; c < channels; c++) {
+            dst[i * channels + c] = static_cast<float>(planes[c][i]) * scale;
+        }
+    }
+}
+
 // AVX optimized versions
+SIMD_TARGET_AVX2
 void SIMDOperations::convert_int16_to_float_avx(const int16_t* src, float* dst, size_t samples) {
-    if (!cpu_features_.has_avx) {
+    // The int16 -> int32 widening is an AVX2 instruction
+    if (!detect_cpu_features().has_avx2) {
         convert_int16_to_float_sse2(src, dst, samples);
         return;
     }
@@ -295,8 +345,38 @@ void SIMDOperations::convert_int16_to_float_avx(const int16_t* src, float* dst,
     convert_int16_to_float_sse2(src + simd_samples, dst + simd_samples, samples - simd_samples);
 }
 
+SIMD_TARGET_AVX2
+void SIMDOperations::convert_int24_to_float_avx(const uint8_t* src, float* dst, size_t samples) {
+    if (!detect_cpu_features().has_avx2) {
+        convert_int24_to_float_sse2(src, dst, samples);
+        return;
+    }
+
+    // Each 128-bit lane moves four packed 3-byte samples into the top three
+    // bytes of four int32s, so the sign lands in bit 31
+    const __m256i spread = _mm256_setr_epi8(
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const __m256 scale_vec = _mm256_set1_ps(1.0f / 2147483648.0f);
+
+    // 8 samples (24 bytes) per step, loaded as two 16-byte halves; stop
+    // while the second load still ends inside the source
+    size_t i = 0;
+    for (; i + 10 <= samples; i += 8) {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 12));
+        __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+        __m256i int32_val = _mm256_shuffle_epi8(bytes, spread);
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(int32_val), scale_vec));
+    }
+
+    convert_int24_to_float_sse2(src + i * 3, dst + i, samples - i);
+}
+
+SIMD_TARGET_AVX2
 void SIMDOperations::convert_float_to_int16_avx(const float* src, int16_t* dst, size_t samples) {
-    if (!cpu_features_.has_avx) {
+    // The 256-bit lane extract is an AVX2 instruction
+    if (!detect_cpu_features().has_avx2) {
         convert_float_to_int16_sse2(src, dst, samples);
         return;
     }
@@ -334,8 +414,9 @@ void SIMDOperations::convert_float_to_int16_avx(const float* src, int16_t* dst,
     convert_float_to_int16_sse2(src + simd_samples, dst + simd_samples, samples - simd_samples);
 }
 
+SIMD_TARGET_AVX
 void SIMDOperations::volume_avx(float* audio, size_t samples, float volume) {
-    if (!cpu_features_.has_avx || volume == 1.0f) {
+    if (!detect_cpu_features().has_avx || volume == 1.0f) {
         volume_sse2(audio, samples, volume);
         return;
     }
@@ -354,8 +435,9 @@ void SIMDOperations::volume_avx(float* audio, size_t samples, float volume) {
     }
 }
 
+SIMD_TARGET_AVX
 void SIMDOperations::mix_channels_avx(const float* src1, const float* src2, float* dst, size_t samples) {
-    if (!cpu_features_.has_avx) {
+    if (!detect_cpu_features().has_avx) {
         mix_channels_sse2(src1, src2, dst, samples);
         return;
     }
@@ -375,6 +457,70 @@ void SIMDOperations::mix_channels_avx(const float* src1, const float* src2, floa
     }
 }
 
+SIMD_TARGET_AVX
+void SIMDOperations::interleave_int32_to_float_avx(const int32_t* const* planes, size_t channels,
+                                                  size_t frames, float scale, float* dst) {
+    if (!detect_cpu_features().has_avx || channels > 2) {
+        interleave_int32_to_float_sse2(planes, channels, frames, scale, dst);
+        return;
+    }
+
+    const __m256 scale_vec = _mm256_set1_ps(scale);
+    size_t i = 0;
+
+    if (channels == 1) {
+        for (; i + 8 <= frames; i += 8) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(planes[0] + i));
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale_vec));
+        }
+    } else {
+        for (; i + 8 <= frames; i += 8) {
+            __m256 left = _mm256_mul_ps(_mm256_cvtepi32_ps(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(planes[0] + i))), scale_vec);
+            __m256 right = _mm256_mul_ps(_mm256_cvtepi32_ps(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(planes[1] + i))), scale_vec);
+
+            // unpack works per 128-bit lane: lo = L0 R0 L1 R1 | L4 R4 L5 R5,
+            // hi = L2 R2 L3 R3 | L6 R6 L7 R7; the lane permutes restore order
+            __m256 lo = _mm256_unpacklo_ps(left, right);
+            __m256 hi = _mm256_unpackhi_ps(left, right);
+            _mm256_storeu_ps(dst + i * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+            _mm256_storeu_ps(dst + i * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+        }
+    }
+
+    if (i < frames) {
+        const int32_t* tail[2] = {planes[0] + i, channels == 2 ? planes[1] + i : nullptr};
+        interleave_int32_to_float_sse2(tail, channels, frames - i, scale, dst + i * channels);
+    }
+}
+
+SIMD_TARGET_AVX2
+float SIMDOperations::dot_product_avx2(const float* a, const float* b, size_t samples) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 16 <= samples; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= samples; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+
+    acc0 = _mm256_add_ps(acc0, acc1);
+    __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+    sum4 = _mm_add_ss(sum4, _mm_shuffle_ps(sum4, sum4, 1));
+    float sum = _mm_cvtss_f32(sum4);
+
+    for (; i < samples; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
 // AudioBufferPool implementation
 AudioBufferPool::AudioBufferPool(size_t pool_size, size_t buffer_size)
     : buffer_size_(buffer_size) {
@@ -28,6 +28,18 @@
 // Memory alignment for SIMD operations
 constexpr size_t SIMD_ALIGNMENT = 32;
 
+// Per-function instruction set selection so AVX paths can live in a baseline
+// (SSE2) build and be picked at runtime via detect_cpu_features(). A
+// function's target must match the feature it checks: code built for
+// AVX2 may use AVX2 or FMA instructions anywhere, not only in intrinsics.
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET_AVX __attribute__((target("avx")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define SIMD_TARGET_AVX
+#define SIMD_TARGET_AVX2
+#endif
+
 namespace audio {
 
 // Aligned allocator for SIMD operations
@@ -102,7 +114,8 @@ public:
         bool has_fma3;
     };
 
-    static CPUFeatures detect_cpu_features();
+    // Detected once per process; cheap to call and safe from any thread
+    static const CPUFeatures& detect_cpu_features();
 
     // Optimized functions
     static void convert_int16_to_float_sse2(const int16_t* src, float* dst, size_t samples);
@@ -111,16 +124,24 @@ public:
     static void volume_sse2(float* audio, size_t samples, float volume);
     static void mix_channels_sse2(const float* src1, const float* src2, float* dst, size_t samples);
     static void interpolate_linear_sse2(const float* a, const float* b, float* out, size_t samples, float ratio);
+    static float dot_product_sse2(const float* a, const float* b, size_t samples);
+    static void interleave_int32_to_float_sse2(const int32_t* const* planes, size_t channels,
+                                               size_t frames, float scale, float* dst);
 
     // AVX optimized versions
     static void convert_int16_to_float_avx(const int16_t* src, float* dst, size_t samples);
+    static void convert_int24_to_float_avx(const uint8_t* src, float* dst, size_t samples);
     static void convert_float_to_int16_avx(const float* src, int16_t* dst, size_t samples);
     static void volume_avx(float* audio, size_t samples, float volume);
     static void mix_channels_avx(const float* src1, const float* src2, float* dst, size_t samples);
 
-private:
-    static CPUFeatures cpu_features_;
-    static bool features_detected_;
+    // Planar int32 (as lossless decoders hand it out) to interleaved float,
+    // dst[i * channels + c] = planes[c][i] * scale
+    static void interleave_int32_to_float_avx(const int32_t* const* planes, size_t channels,
+                                              size_t frames, float scale, float* dst);
+
+    // AVX2/FMA; callers must check has_avx2 && has_fma3 first
+    static float dot_product_avx2(const float* a, const float* b, size_t samples);
 };
 
 /**
@@ -7,6 +7,7 @@
 #include "optimized_audio_processor.h"
 #include "sample_rate_converter.h"
 #include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <iostream>
 #include <thread>
@@ -123,7 +124,7 @@ void OptimizedFormatConverter::reset() {
 void OptimizedFormatConverter::convert_to_float(const void* input, float* output, size_t frames) {
     PROFILE_AUDIO("convert_to_float", frames * input_format_.channels);
 
-    auto& cpu = SIMDOperations::detect_cpu_features();
+    auto cpu = SIMDOperations::detect_cpu_features();
 
     if (input_format_.bits_per_sample == 16) {
         const int16_t* src = static_cast<const int16_t*>(input);
@@ -167,7 +168,7 @@ void OptimizedFormatConverter::convert_to_float(const void* input, float* output
 void OptimizedFormatConverter::convert_from_float(const float* input, void* output, size_t frames) {
     PROFILE_AUDIO("convert_from_float", frames * output_format_.channels);
 
-    auto& cpu = SIMDOperations::detect_cpu_features();
+    auto cpu = SIMDOperations::detect_cpu_features();
 
     if (output_format_.bits_per_sample == 16) {
         int16_t* dst = static_cast<int16_t*>(output);
@@ -199,25 +200,18 @@ void OptimizedFormatConverter::convert_channels(const float* input, float* outpu
         }
     } else if (input_format_.channels == 2 && output_format_.channels == 1) {
         // Stereo to mono
-        auto& cpu = SIMDOperations::detect_cpu_features();
         size_t samples = frames;
         size_t simd_samples = (samples / 4) * 4;
 
-        if (cpu.has_avx) {
-            for (size_t i = 0; i < simd_samples; i += 4) {
-                __m256 left = _mm256_loadu_ps(input + i * 2);
-                __m256 right = _mm256_loadu_ps(input + i * 2 + 4);
-                __m256 mixed = _mm256_mul_ps(_mm256_add_ps(left, right), _mm256_set1_ps(0.5f));
-                _mm256_storeu_ps(output + i, mixed);
-            }
-        } else {
-            const __m128 half = _mm_set1_ps(0.5f);
-            for (size_t i = 0; i < simd_samples; i += 4) {
-                __m128 left = _mm_loadu_ps(input + i * 2);
-                __m128 right = _mm_loadu_ps(input + i * 2 + 4);
-                __m128 mixed = _mm_mul_ps(_mm_add_ps(left, right), half);
-                _mm_storeu_ps(output + i, mixed);
-            }
+        const __m128 half = _mm_set1_ps(0.5f);
+        for (size_t i = 0; i < simd_samples; i += 4) {
+            // De-interleave L0 R0 L1 R1 | L2 R2 L3 R3 into L and R lanes
+            __m128 a = _mm_loadu_ps(input + i * 2);
+            __m128 b = _mm_loadu_ps(input + i * 2 + 4);
+            __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            __m128 mixed = _mm_mul_ps(_mm_add_ps(left, right), half);
+            _mm_storeu_ps(output + i, mixed);
         }
 
         for (size_t i = simd_samples; i < samples; i++) {
@@ -395,7 +389,7 @@ void StreamingAudioProcessor::process_chunk(aligned_vector<float>& chunk) {
     PROFILE_AUDIO("process_chunk", chunk.size());
 
     // Apply volume (SIMD optimized)
-    auto& cpu = SIMDOperations::detect_cpu_features();
+    auto cpu = SIMDOperations::detect_cpu_features();
     float volume = 0.8f;
 
     if (cpu.has_avx) {
@@ -6,6 +6,7 @@
 
 #include "sample_rate_converter.h"
 #include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <stdexcept>
 #include <fstream>
@@ -45,23 +46,23 @@ int LinearSampleRateConverter::convert(const float* input, int input_frames,
 
     int output_frames = 0;
 
-    // Process each output sample
+    // position_ is relative to input[0]; -1 refers to the last frame of the
+    // previous call, kept in last_frame_ so blocks join seamlessly
     while (output_frames < max_output_frames) {
-        // Find current integer position in input
-        int pos_int = static_cast<int>(position_);
+        int pos_int = static_cast<int>(std::floor(position_));
         double pos_frac = position_ - pos_int;
 
         // Check if we have enough input data
-        if (pos_int >= input_frames) {
+        if (pos_int + 1 >= input_frames) {
             break;
         }
 
         // Linear interpolation for each channel
         for (int ch = 0; ch < channels_; ++ch) {
-            float sample1 = input[pos_int * channels_ + ch];
-            float sample2 = (pos_int < input_frames - 1) ?
-                          input[(pos_int + 1) * channels_ + ch] :
+            float sample1 = (pos_int >= 0) ?
+                          input[pos_int * channels_ + ch] :
                           last_frame_[ch];
+            float sample2 = input[(pos_int + 1) * channels_ + ch];
 
             // Linear interpolation
             output[output_frames * channels_ + ch] =
@@ -72,12 +73,11 @@ int LinearSampleRateConverter::convert(const float* input, int input_frames,
         position_ += ratio_;
     }
 
-    // Store last frame for next conversion
-    if (input_frames > 0) {
-        ::memcpy(last_frame_.data(),
-                  &input[(input_frames - 1) * channels_],
-                  channels_ * sizeof(float));
-    }
+    // Store last frame for next conversion and rebase onto it
+    ::memcpy(last_frame_.data(),
+              &input[(input_frames - 1) * channels_],
+              channels_ * sizeof(float));
+    position_ -= input_frames;
 
     return output_frames;
 }
@@ -5,6 +5,8 @@
  */
 
 #include "sinc_resampler.h"
+#include "optimized_audio_processor.h"
+#include <algorithm>
 #include <cstring>
 #include <cmath>
 
@@ -14,15 +16,64 @@
 
 namespace audio {
 
+namespace {
+
+// Rational ratios with at most this many phases get an exact filter bank
+// (44.1k <-> 48k needs 160); anything else interpolates between a fixed set
+const int MAX_EXACT_PHASES = 1024;
+const int INTERPOLATED_PHASES = 256;
+
+// Kaiser window shape; ~90 dB stop-band attenuation
+const double KAISER_BETA = 8.6;
+
+// Zeroth-order modified Bessel function of the first kind
+double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    double half_x = x / 2.0;
+    for (int k = 1; k < 50; ++k) {
+        term *= (half_x / k) * (half_x / k);
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+int gcd(int a, int b) {
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+} // namespace
+
 SincSampleRateConverter::SincSampleRateConverter(int taps)
     : taps_(taps)
     , cutoff_(0.45)
-    , position_(0.0)
+    , ratio_(1.0)
     , channels_(0)
     , input_rate_(0)
-    , output_rate_(0) {
+    , output_rate_(0)
+    , kernel_length_(0)
+    , num_phases_(0)
+    , exact_phases_(true)
+    , step_int_(1)
+    , step_phase_(0)
+    , step_frac_(0.0)
+    , index_(0)
+    , phase_(0)
+    , frac_(0.0)
+    , dot_product_(&SIMDOperations::dot_product_sse2) {
 
     // Validate taps (must be odd for symmetric filter)
+    if (taps_ < 3) {
+        taps_ = 3;
+    }
     if (taps_ % 2 == 0) {
         taps_++;
     }
@@ -36,7 +87,6 @@ bool SincSampleRateConverter::initialize(int input_rate, int output_rate, int ch
     input_rate_ = input_rate;
     output_rate_ = output_rate;
     channels_ = channels;
-    position_ = 0.0;
 
     // Calculate conversion ratio
     ratio_ = static_cast<double>(input_rate) / output_rate;
@@ -50,142 +100,157 @@ bool SincSampleRateConverter::initialize(int input_rate, int output_rate, int ch
         cutoff_ = 0.45;  // 90% of Nyquist
     }
 
+    // Output frame n sits at input position n * in / out. With the ratio
+    // reduced to M / L that position only ever takes L fractional values.
+    int divisor = gcd(input_rate, output_rate);
+    int phases = output_rate / divisor;
+    int step = input_rate / divisor;
+
+    exact_phases_ = phases <= MAX_EXACT_PHASES;
+    if (exact_phases_) {
+        num_phases_ = phases;
+        step_int_ = step / phases;
+        step_phase_ = step % phases;
+    } else {
+        num_phases_ = INTERPOLATED_PHASES + 1;  // Last row is fraction 1.0
+        step_int_ = static_cast<int>(ratio_);
+        step_frac_ = ratio_ - step_int_;
+    }
+
+    // Pad each phase to a whole number of AVX registers
+    kernel_length_ = (taps_ + 7) & ~7;
+
     // Generate sinc filter coefficients
     generate_sinc_coefficients();
 
+    const SIMDOperations::CPUFeatures& cpu = SIMDOperations::detect_cpu_features();
+    dot_product_ = (cpu.has_avx2 && cpu.has_fma3) ? &SIMDOperations::dot_product_avx2
+                                                  : &SIMDOperations::dot_product_sse2;
+
     // Allocate buffers
-    delay_buffer_.resize(taps_ * channels_, 0.0f);
+    delay_buffer_.assign(static_cast<size_t>(kernel_length_) * channels_, 0.0f);
+    reset();
 
     return true;
 }
 
 void SincSampleRateConverter::generate_sinc_coefficients() {
-    coefficients_.resize(taps_);
+    const int half_taps = taps_ / 2;
+    const int resolution = exact_phases_ ? num_phases_ : INTERPOLATED_PHASES;
+    const double window_half = half_taps + 1.0;
+    const double window_norm = bessel_i0(KAISER_BETA);
+
+    coefficients_.assign(static_cast<size_t>(num_phases_) * kernel_length_, 0.0f);
+
+    for (int phase = 0; phase < num_phases_; ++phase) {
+        float* row = coefficients_.data() + static_cast<size_t>(phase) * kernel_length_;
+        double frac = static_cast<double>(phase) / resolution;
+        double sum = 0.0;
+
+        // Tap k weighs input frame (index - half_taps + k) for an output at
+        // index + frac, i.e. it sits at distance k - half_taps - frac
+        for (int k = 0; k < taps_; ++k) {
+            double t = k - half_taps - frac;
+
+            double sinc;
+            if (std::abs(t) < 1e-9) {
+                sinc = 2.0 * cutoff_;
+            } else {
+                double x = M_PI * t;
+                sinc = std::sin(2.0 * cutoff_ * x) / x;
+            }
 
-    // Generate Kaiser-windowed sinc coefficients
-    double beta = 6.0;  // Kaiser window parameter for good stop-band attenuation
-    double m = (taps_ - 1) / 2.0;
+            // Apply Kaiser window
+            double arg = 1.0 - (t / window_half) * (t / window_half);
+            double window = arg > 0.0 ? bessel_i0(KAISER_BETA * std::sqrt(arg)) / window_norm : 0.0;
 
-    for (int i = 0; i < taps_; ++i) {
-        double sinc;
-        if (i == m) {
-            sinc = 2.0 * cutoff_;
-        } else {
-            double x = M_PI * (i - m);
-            sinc = sin(2.0 * cutoff_ * x) / x;
+            row[k] = static_cast<float>(sinc * window);
+            sum += row[k];
         }
 
-        // Apply Kaiser window
-        double alpha = m;
-        double arg = 1.0 - ((i - alpha) / alpha) * ((i - alpha) / alpha);
-        double window = arg > 0 ?
-            std::cosh(beta * std::sqrt(arg)) / std::cosh(beta) : 0.0;
-
-        coefficients_[i] = static_cast<float>(sinc * window);
-    }
-
-    // Normalize coefficients
-    float sum = 0.0f;
-    for (float coeff : coefficients_) {
-        sum += coeff;
-    }
-    for (float& coeff : coefficients_) {
-        coeff /= sum;
-    }
-}
-
-float SincSampleRateConverter::sinc_interpolate(const float* input, double position) {
-    int pos_int = static_cast<int>(position);
-    double pos_frac = position - pos_int;
-
-    float sum = 0.0f;
-    double scale = 0.0;
-
-    int half_taps = taps_ / 2;
-
-    for (int i = 0; i < taps_; ++i) {
-        int sample_idx = pos_int + i - half_taps;
-
-        // Skip if outside buffer bounds
-        if (sample_idx < 0) continue;
-
-        // Calculate fractional position for this tap
-        double tap_pos = (i - half_taps) + pos_frac;
-
-        // Calculate sinc value (simplified for performance)
-        double sinc_val;
-        if (std::abs(tap_pos) < 1e-6) {
-            sinc_val = 1.0;
-        } else {
-            double x = M_PI * tap_pos;
-            sinc_val = sin(2.0 * cutoff_ * x) / x;
-            // Apply Kaiser window
-            double arg = 1.0 - (tap_pos / half_taps) * (tap_pos / half_taps);
-            double window = arg > 0 ? std::cosh(6.0 * std::sqrt(arg)) / std::cosh(6.0) : 0.0;
-            sinc_val *= window;
+        // Normalize each phase to unity DC gain
+        if (sum != 0.0) {
+            for (int k = 0; k < taps_; ++k) {
+                row[k] = static_cast<float>(row[k] / sum);
+            }
         }
-
-        sum += input[sample_idx] * static_cast<float>(sinc_val);
-        scale += sinc_val;
     }
-
-    return scale != 0.0f ? sum / static_cast<float>(scale) : 0.0f;
 }
 
 int SincSampleRateConverter::convert(const float* input, int input_frames,
                                      float* output, int max_output_frames) {
-    if (!input || !output || input_frames <= 0 || max_output_frames <= 0) {
+    if (!input || !output || input_frames <= 0 || max_output_frames <= 0 || channels_ <= 0) {
         return 0;
     }
 
     int output_frames = 0;
-    int half_taps = taps_ / 2;
-
-    // Create extended input buffer with overlap
-    std::vector<float> extended_input((input_frames + taps_) * channels_);
-
-    // Copy previous data from delay buffer
-    std::memcpy(extended_input.data(), delay_buffer_.data(),
-                delay_buffer_.size() * sizeof(float));
-
-    // Copy new input data
-    std::memcpy(extended_input.data() + delay_buffer_.size(),
-                input, input_frames * channels_ * sizeof(float));
-
-    // Process each output frame
-    while (output_frames < max_output_frames && position_ < input_frames) {
-        int pos_int = static_cast<int>(position_);
+    const int half_taps = taps_ / 2;
+    const size_t history = static_cast<size_t>(kernel_length_);
+
+    // Planar line per channel: history, new input, then kernel_length_ of
+    // zeros so the padded taps never read past the end
+    const size_t stride = history + input_frames + kernel_length_;
+    if (planar_.size() < stride * channels_) {
+        planar_.resize(stride * channels_);
+    }
 
-        // Sinc interpolation for each channel
-        for (int ch = 0; ch < channels_; ++ch) {
-            // Get pointer to channel data
-            const float* channel_data = extended_input.data() + ch;
+    for (int ch = 0; ch < channels_; ++ch) {
+        float* line = planar_.data() + stride * ch;
+        std::memcpy(line, delay_buffer_.data() + history * ch, history * sizeof(float));
+        for (int i = 0; i < input_frames; ++i) {
+            line[history + i] = input[i * channels_ + ch];
+        }
+        std::memset(line + history + input_frames, 0, kernel_length_ * sizeof(float));
+    }
 
-            // Perform sinc interpolation
-            output[output_frames * channels_ + ch] =
-                sinc_interpolate(channel_data, position_ + half_taps);
+    // Process each output frame; index_ + half_taps is the newest input used
+    while (output_frames < max_output_frames && index_ + half_taps < input_frames) {
+        const size_t start = history + index_ - half_taps;
+        float* frame_out = output + static_cast<size_t>(output_frames) * channels_;
+
+        if (exact_phases_) {
+            const float* kernel = coefficients_.data() + static_cast<size_t>(phase_) * kernel_length_;
+            for (int ch = 0; ch < channels_; ++ch) {
+                frame_out[ch] = dot_product_(planar_.data() + stride * ch + start, kernel, kernel_length_);
+            }
+
+            index_ += step_int_;
+            phase_ += step_phase_;
+            if (phase_ >= num_phases_) {
+                phase_ -= num_phases_;
+                index_++;
+            }
+        } else {
+            // Blend the two neighbouring phases
+            double position = frac_ * INTERPOLATED_PHASES;
+            int row = static_cast<int>(position);
+            float weight = static_cast<float>(position - row);
+            const float* kernel0 = coefficients_.data() + static_cast<size_t>(row) * kernel_length_;
+            const float* kernel1 = kernel0 + kernel_length_;
+            for (int ch = 0; ch < channels_; ++ch) {
+                const float* samples = planar_.data() + stride * ch + start;
+                float a = dot_product_(samples, kernel0, kernel_length_);
+                float b = dot_product_(samples, kernel1, kernel_length_);
+                frame_out[ch] = a + (b - a) * weight;
+            }
+
+            index_ += step_int_;
+            frac_ += step_frac_;
+            if (frac_ >= 1.0) {
+                frac_ -= 1.0;
+                index_++;
+            }
         }
 
         output_frames++;
-        position_ += ratio_;
     }
 
-    // Update delay buffer for next call
-    if (input_frames >= taps_) {
-        std::memcpy(delay_buffer_.data(),
-                    input + (input_frames - taps_) * channels_,
-                    taps_ * channels_ * sizeof(float));
-    } else {
-        // Not enough frames, shift and copy what we have
-        int shift = std::max(0, taps_ - input_frames);
-        if (shift > 0) {
-            std::memmove(delay_buffer_.data(),
-                         delay_buffer_.data() + (taps_ - shift) * channels_,
-                         shift * channels_ * sizeof(float));
-        }
-        std::memcpy(delay_buffer_.data() + shift * channels_,
-                    input, input_frames * channels_ * sizeof(float));
+    // Keep the newest kernel_length_ frames as history and rebase onto them
+    for (int ch = 0; ch < channels_; ++ch) {
+        std::memcpy(delay_buffer_.data() + history * ch,
+                    planar_.data() + stride * ch + input_frames, history * sizeof(float));
     }
+    index_ -= input_frames;
 
     return output_frames;
 }
@@ -196,17 +261,20 @@ int SincSampleRateConverter::get_latency() const {
 }
 
 void SincSampleRateConverter::reset() {
-    position_ = 0.0;
+    // Start half a filter back so the first output only sees history
+    index_ = -(taps_ / 2);
+    phase_ = 0;
+    frac_ = 0.0;
     std::fill(delay_buffer_.begin(), delay_buffer_.end(), 0.0f);
 }
 
 // Factory implementations
 std::unique_ptr<ISampleRateConverter> HighQualitySampleRateConverterFactory::create() {
-    return std::make_unique<SincSampleRateConverter>(8);  // 8 taps for high quality
+    return std::make_unique<SincSampleRateConverter>(32);  // 32 taps for high quality
 }
 
 std::unique_ptr<ISampleRateConverter> BestQualitySampleRateConverterFactory::create() {
-    return std::make_unique<SincSampleRateConverter>(16); // 16 taps for best quality
+    return std::make_unique<SincSampleRateConverter>(101); // 101 taps for best quality
 }
 
 } // namespace audio
\ No newline at end of file
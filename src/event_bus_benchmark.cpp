@@ -0,0 +1,190 @@
+/**
+ * @file event_bus_benchmark.cpp
+ * @brief Microbenchmark for the event bus (core/event_bus.h)
+ *
+ * Measures delivered events per second from four publishing threads, the
+ * p99 and worst publish() latency seen by a thread that publishes while
+ * the others flood the bus, and how many position ticks reach
+ * subscribers. The reference is the bus this one replaced: a mutex-guarded
+ * std::queue with a condition variable, copying the subscriber callbacks
+ * for every event it dispatches.
+ */
+
+#include "core/event_bus.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::chrono;
+using namespace mp;
+using namespace mp::core;
+
+namespace {
+
+const size_t PRODUCERS = 4;
+const size_t EVENTS_PER_PRODUCER = 250000;
+const size_t LATENCY_SAMPLES = 100000;
+
+// The previous EventBus, reduced to what the benchmark calls
+class LockedBus {
+public:
+    ~LockedBus() { stop(); }
+
+    void subscribe(EventID id, EventCallback callback) {
+        std::lock_guard<std::mutex> lock(subscription_mutex_);
+        subscribers_[id].push_back(std::move(callback));
+    }
+
+    Result publish(const Event& event) {
+        Event evt = event;
+        evt.timestamp = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            queue_.push(evt);
+        }
+        queue_cv_.notify_one();
+        return Result::Success;
+    }
+
+    void start() {
+        running_ = true;
+        worker_ = std::thread([this] {
+            while (running_) {
+                Event event;
+                {
+                    std::unique_lock<std::mutex> lock(queue_mutex_);
+                    queue_cv_.wait(lock, [this] { return !queue_.empty() || !running_; });
+                    if (!running_) break;
+                    event = queue_.front();
+                    queue_.pop();
+                }
+                std::vector<EventCallback> callbacks;
+                {
+                    std::lock_guard<std::mutex> lock(subscription_mutex_);
+                    auto it = subscribers_.find(event.id);
+                    if (it != subscribers_.end()) callbacks = it->second;
+                }
+                for (const auto& callback : callbacks) callback(event);
+            }
+        });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            running_ = false;
+        }
+        queue_cv_.notify_all();
+        if (worker_.joinable()) worker_.join();
+    }
+
+private:
+    std::unordered_map<EventID, std::vector<EventCallback>> subscribers_;
+    std::mutex subscription_mutex_;
+    std::queue<Event> queue_;
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::thread worker_;
+    bool running_ = false;
+};
+
+struct BusResult {
+    double events_per_second;
+    double p99_ns;
+    double max_ns;
+    uint64_t ticks_delivered;
+};
+
+template <typename Bus>
+BusResult run(Bus& bus) {
+    BusResult result;
+    std::atomic<uint64_t> delivered{0}, ticks{0};
+    bus.subscribe(EVENT_SEEK, [&](const Event&) { delivered.fetch_add(1, std::memory_order_relaxed); });
+    bus.subscribe(EVENT_POSITION_CHANGED, [&](const Event&) { ticks.fetch_add(1, std::memory_order_relaxed); });
+    bus.start();
+
+    // Throughput: every event delivered, publishers retry when refused
+    auto start = steady_clock::now();
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&bus] {
+            for (size_t i = 0; i < EVENTS_PER_PRODUCER; ++i) {
+                while (bus.publish(Event(EVENT_SEEK)) != Result::Success) std::this_thread::yield();
+            }
+        });
+    }
+    for (auto& t : producers) t.join();
+    while (delivered.load() < PRODUCERS * EVENTS_PER_PRODUCER) std::this_thread::yield();
+    result.events_per_second = PRODUCERS * EVENTS_PER_PRODUCER /
+                               duration<double>(steady_clock::now() - start).count();
+
+    // Latency: one publisher timed while the others flood
+    std::atomic<bool> flooding{true};
+    producers.clear();
+    for (size_t p = 1; p < PRODUCERS; ++p) {
+        producers.emplace_back([&] {
+            while (flooding.load(std::memory_order_relaxed)) {
+                bus.publish(Event(EVENT_SEEK));
+                std::this_thread::yield();
+            }
+        });
+    }
+    std::vector<double> latencies(LATENCY_SAMPLES);
+    uint64_t position = 0;
+    for (size_t i = 0; i < LATENCY_SAMPLES; ++i) {
+        auto t0 = steady_clock::now();
+        bus.publish(Event(EVENT_POSITION_CHANGED, &position, sizeof(position)));
+        latencies[i] = duration<double, std::nano>(steady_clock::now() - t0).count();
+    }
+    flooding = false;
+    for (auto& t : producers) t.join();
+    std::sort(latencies.begin(), latencies.end());
+    result.p99_ns = latencies[LATENCY_SAMPLES * 99 / 100];
+    result.max_ns = latencies.back();
+
+    std::this_thread::sleep_for(milliseconds(100));
+    bus.stop();
+    result.ticks_delivered = ticks.load();
+    return result;
+}
+
+void report(const char* name, double reference, double bus, const char* unit) {
+    std::cout << std::setw(26) << std::left << name << std::right
+              << std::setw(16) << std::fixed << std::setprecision(0) << reference
+              << std::setw(16) << bus << "  " << unit << std::endl;
+}
+
+} // namespace
+
+int main() {
+    std::cout << "Event Bus Benchmark (" << PRODUCERS << " publishers, "
+              << PRODUCERS * EVENTS_PER_PRODUCER << " events)" << std::endl;
+    std::cout << "================================================================" << std::endl;
+
+    LockedBus locked;
+    BusResult reference = run(locked);
+    EventBus bus;
+    BusResult lock_free = run(bus);
+
+    std::cout << std::setw(26) << std::left << "" << std::right
+              << std::setw(16) << "Mutex+queue" << std::setw(16) << "MPSC ring" << std::endl;
+    report("delivered events/s", reference.events_per_second, lock_free.events_per_second, "");
+    report("publish p99", reference.p99_ns, lock_free.p99_ns, "ns");
+    report("publish max", reference.max_ns, lock_free.max_ns, "ns");
+    report("position ticks delivered", static_cast<double>(reference.ticks_delivered),
+           static_cast<double>(lock_free.ticks_delivered), "");
+
+    EventBusStats stats = bus.get_stats();
+    std::cout << std::endl << "MPSC ring: " << stats.coalesced << " coalesced, " << stats.dropped
+              << " refused, " << stats.batches << " batches" << std::endl;
+    return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file fft_benchmark.cpp
+ * @brief Microbenchmark for the shared real-input FFT (core/fft.h)
+ *
+ * Compares mp::core::RealFFT against the per-call complex radix-2 FFT the
+ * analyzers used before, for transform sizes 256 to 65536.
+ */
+
+#include "core/fft.h"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <complex>
+#include <random>
+#include <iomanip>
+#include <cmath>
+
+using namespace std::chrono;
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// Previous approach: complex FFT on real data, buffers allocated per call,
+// twiddles advanced by repeated multiplication. Instantiated with double
+// as the accuracy reference.
+template <typename T>
+std::vector<std::complex<T>> reference_fft(const std::vector<float>& input) {
+    size_t n = input.size();
+    std::vector<std::complex<T>> output(input.begin(), input.end());
+
+    size_t j = 0;
+    for (size_t i = 1; i < n; ++i) {
+        size_t bit = n >> 1;
+        while (j >= bit) {
+            j -= bit;
+            bit >>= 1;
+        }
+        j += bit;
+        if (i < j) {
+            std::swap(output[i], output[j]);
+        }
+    }
+
+    for (size_t len = 2; len <= n; len <<= 1) {
+        double angle = -2.0 * PI / len;
+        std::complex<T> wlen(static_cast<T>(std::cos(angle)),
+                             static_cast<T>(std::sin(angle)));
+        for (size_t i = 0; i < n; i += len) {
+            std::complex<T> w(1, 0);
+            for (size_t k = 0; k < len / 2; ++k) {
+                std::complex<T> u = output[i + k];
+                std::complex<T> v = output[i + k + len / 2] * w;
+                output[i + k] = u + v;
+                output[i + k + len / 2] = u - v;
+                w *= wlen;
+            }
+        }
+    }
+
+    return output;
+}
+
+template <typename Fn>
+double time_per_call_us(Fn&& fn, int iterations) {
+    fn();  // Warm up caches and plans
+    auto start = high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    auto end = high_resolution_clock::now();
+    return duration<double, std::micro>(end - start).count() / iterations;
+}
+
+} // namespace
+
+int main() {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    std::cout << "Real FFT Benchmark" << std::endl;
+    std::cout << "==================" << std::endl;
+    std::cout << std::setw(8) << "Size"
+              << std::setw(16) << "Reference (us)"
+              << std::setw(14) << "RealFFT (us)"
+              << std::setw(10) << "Speedup"
+              << std::setw(14) << "Rel. error" << std::endl;
+
+    volatile float sink = 0.0f;
+
+    for (size_t size = 256; size <= 65536; size <<= 1) {
+        std::vector<float> input(size);
+        for (float& v : input) {
+            v = dist(gen);
+        }
+
+        mp::core::RealFFT fft(size);
+        std::vector<std::complex<float>> output(fft.bins());
+
+        // Keep total work per size roughly constant
+        int iterations = static_cast<int>(std::max<size_t>(20, (1u << 24) / size));
+
+        double reference_us = time_per_call_us([&] {
+            sink = sink + reference_fft<float>(input)[1].real();
+        }, iterations);
+
+        double real_us = time_per_call_us([&] {
+            fft.forward(input.data(), output.data());
+            sink = sink + output[1].real();
+        }, iterations);
+
+        // Error relative to the largest bin of a double precision transform
+        std::vector<std::complex<double>> expected = reference_fft<double>(input);
+        double max_error = 0.0;
+        double max_magnitude = 0.0;
+        for (size_t k = 0; k < fft.bins(); ++k) {
+            std::complex<double> actual(output[k].real(), output[k].imag());
+            max_error = std::max(max_error, std::abs(expected[k] - actual));
+            max_magnitude = std::max(max_magnitude, std::abs(expected[k]));
+        }
+        max_error /= max_magnitude;
+
+        std::cout << std::setw(8) << size
+                  << std::setw(16) << std::fixed << std::setprecision(2) << reference_us
+                  << std::setw(14) << real_us
+                  << std::setw(9) << std::setprecision(1) << reference_us / real_us << "x"
+                  << std::setw(14) << std::scientific << std::setprecision(2) << max_error
+                  << std::defaultfloat << std::endl;
+    }
+
+    return 0;
+}
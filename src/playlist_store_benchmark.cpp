@@ -0,0 +1,134 @@
+/**
+ * @file playlist_store_benchmark.cpp
+ * @brief Microbenchmark for the binary playlist store (core/playlist_store.h)
+ *
+ * Writes 1000 playlists with 2M entries in total, drawn from a 200k-track
+ * library, then times loading them, saving a one-track edit and a full
+ * compaction. The reference is the JSON-per-playlist layout the manager
+ * used to save: every playlist exported to its own file and imported
+ * back, which is what startup and shutdown cost before.
+ */
+
+#include "core/playlist_manager.h"
+#include "core/playlist_store.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+using namespace mp::core;
+namespace fs = std::filesystem;
+
+namespace {
+
+const size_t PLAYLISTS = 1000;
+const size_t ENTRIES_PER_PLAYLIST = 2000;
+const size_t LIBRARY = 200000;
+
+double since_ms(high_resolution_clock::time_point start) {
+    return duration<double, std::milli>(high_resolution_clock::now() - start).count();
+}
+
+void report(const char* name, double ms) {
+    std::cout << std::setw(36) << std::left << name << std::right
+              << std::setw(12) << std::fixed << std::setprecision(2) << ms << " ms" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    std::cout << "Playlist Store Benchmark (" << PLAYLISTS << " playlists, "
+              << PLAYLISTS * ENTRIES_PER_PLAYLIST << " entries)" << std::endl;
+    std::cout << "================================================================" << std::endl;
+
+    fs::path root = fs::temp_directory_path() / "xpumusic_playlist_benchmark";
+    fs::remove_all(root);
+    fs::create_directories(root / "json");
+    std::string dir = root.string();
+    std::string db = (root / "playlists" / "playlists.db").string();
+
+    std::vector<std::string> library(LIBRARY);
+    for (size_t i = 0; i < LIBRARY; ++i) {
+        library[i] = "/home/user/Music/Artist " + std::to_string(i / 120) + "/Album " +
+                     std::to_string(i / 12) + "/" + std::to_string(i % 12 + 1) + " - Track.flac";
+    }
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<size_t> pick(0, LIBRARY - 1);
+    std::vector<uint64_t> ids;
+    {
+        PlaylistManager manager;
+        manager.initialize(dir.c_str());
+        std::vector<const char*> tracks(ENTRIES_PER_PLAYLIST);
+        for (size_t p = 0; p < PLAYLISTS; ++p) {
+            uint64_t id;
+            manager.create_playlist(("Playlist " + std::to_string(p)).c_str(), &id);
+            for (auto& track : tracks) track = library[pick(gen)].c_str();
+            manager.add_tracks(id, tracks.data(), tracks.size());
+            ids.push_back(id);
+        }
+
+        auto start = high_resolution_clock::now();
+        for (uint64_t id : ids) {
+            manager.export_json(id, (root / "json" / (std::to_string(id) + ".json")).string().c_str());
+        }
+        report("JSON: save all playlists", since_ms(start));
+        manager.shutdown();
+    }
+
+    {
+        PlaylistManager manager;
+        manager.initialize((root / "json_import").string().c_str());
+        auto start = high_resolution_clock::now();
+        for (const auto& entry : fs::directory_iterator(root / "json")) {
+            manager.import_json(entry.path().string().c_str());
+        }
+        report("JSON: load all playlists", since_ms(start));
+        manager.shutdown();
+    }
+
+    std::vector<Playlist> playlists;
+    {
+        PlaylistStore store;
+        store.open(db, playlists);
+        auto start = high_resolution_clock::now();
+        store.compact(playlists);
+        report("Store: compact (full snapshot)", since_ms(start));
+    }
+    std::cout << "Store size: " << fs::file_size(db) / 1024 << " KiB" << std::endl;
+
+    {
+        PlaylistStore store;
+        auto start = high_resolution_clock::now();
+        store.open(db, playlists);
+        report("Store: load all playlists", since_ms(start));
+    }
+
+    size_t entries = 0;
+    {
+        PlaylistManager manager;
+        auto start = high_resolution_clock::now();
+        manager.initialize(dir.c_str());
+        report("Manager: initialize", since_ms(start));
+        for (const auto& playlist : manager.get_all_playlists()) entries += playlist.tracks.size();
+
+        // First edit builds the path table; later ones are a lookup and an append
+        manager.add_track(ids[0], library[0].c_str());
+        const int EDITS = 1000;
+        start = high_resolution_clock::now();
+        for (int i = 0; i < EDITS; ++i) {
+            manager.add_track(ids[i % PLAYLISTS], library[pick(gen)].c_str());
+        }
+        report("Store: one-track edit, saved", since_ms(start) / EDITS);
+        manager.shutdown();
+    }
+
+    std::cout << std::endl << "Entries loaded: " << entries << std::endl;
+    fs::remove_all(root);
+    return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * @file track_index_benchmark.cpp
+ * @brief Microbenchmark for the columnar track index (core/track_index.h)
+ *
+ * Builds a synthetic 500k-track library and times the operations a
+ * library view runs on every keystroke or header click: substring search,
+ * a three-key sort (album artist, date, track) and a group-by album. The
+ * reference keeps each track's tags in its own string map, the way
+ * file_info_impl does, and runs the same operations with std::function
+ * filters and string comparisons.
+ */
+
+#include "core/track_index.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::chrono;
+using namespace mp::core;
+
+namespace {
+
+const size_t TRACKS = 500000;
+const size_t ARTISTS = 20000;
+const size_t TRACKS_PER_ALBUM = 10;
+
+std::string random_word(std::mt19937& gen) {
+    static const char* syllables[] = {"ka", "lo", "mi", "ra", "ten", "vo", "shi", "dra", "ne", "qu",
+                                      "zel", "po", "fa", "ur", "bis", "gho"};
+    std::uniform_int_distribution<int> count(2, 4), pick(0, 15);
+    std::string word;
+    for (int i = count(gen); i > 0; --i) word += syllables[pick(gen)];
+    word[0] = static_cast<char>(word[0] - 'a' + 'A');
+    return word;
+}
+
+std::vector<TrackMetadata> make_library() {
+    std::mt19937 gen(42);
+    std::vector<std::string> artists(ARTISTS);
+    for (auto& artist : artists) artist = random_word(gen) + " " + random_word(gen);
+    std::uniform_int_distribution<size_t> artist_pick(0, ARTISTS - 1);
+    std::uniform_int_distribution<int> year(1960, 2024), genre(0, 299), length(120000, 480000);
+
+    std::vector<TrackMetadata> tracks(TRACKS);
+    std::string album, artist, date, genre_name;
+    for (size_t i = 0; i < TRACKS; ++i) {
+        if (i % TRACKS_PER_ALBUM == 0) {
+            artist = artists[artist_pick(gen)];
+            album = random_word(gen) + " " + random_word(gen);
+            date = std::to_string(year(gen));
+            genre_name = "Genre " + std::to_string(genre(gen));
+        }
+        TrackMetadata& t = tracks[i];
+        t.path = "/music/" + std::to_string(i) + ".flac";
+        t.sample_rate = 44100;
+        t.channels = 2;
+        t.duration_ms = static_cast<uint64_t>(length(gen));
+        t.add("title", random_word(gen) + " " + random_word(gen) + " " + random_word(gen));
+        t.add("artist", artist);
+        t.add("album_artist", artist);
+        t.add("album", album);
+        t.add("genre", genre_name);
+        t.add("date", date);
+        t.add("track_number", std::to_string(i % TRACKS_PER_ALBUM + 1));
+    }
+    std::shuffle(tracks.begin(), tracks.end(), gen);
+    return tracks;
+}
+
+// Per-track tag maps, as file_info_impl keeps them
+using TagMap = std::unordered_map<std::string, std::string>;
+
+std::string lower(const std::string& s) {
+    std::string out(s);
+    for (char& c : out) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return out;
+}
+
+template <typename Fn>
+double time_ms(Fn&& fn, int runs = 5) {
+    double best = 1e30;
+    for (int i = 0; i < runs; ++i) {
+        auto start = high_resolution_clock::now();
+        fn();
+        best = std::min(best, duration<double, std::milli>(high_resolution_clock::now() - start).count());
+    }
+    return best;
+}
+
+void report(const char* name, double reference, double columnar) {
+    std::cout << std::setw(28) << std::left << name << std::right
+              << std::setw(14) << std::fixed << std::setprecision(2) << reference
+              << std::setw(14) << columnar
+              << std::setw(10) << std::setprecision(1) << reference / columnar << "x" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    std::cout << "Track Index Benchmark (" << TRACKS << " tracks, best of 5, ms)" << std::endl;
+    std::cout << "================================================================" << std::endl;
+    std::vector<TrackMetadata> library = make_library();
+
+    std::vector<TagMap> maps;
+    double map_build = time_ms([&] {
+        maps.clear();
+        maps.reserve(library.size());
+        for (const auto& t : library) maps.emplace_back(t.tags.begin(), t.tags.end());
+    }, 1);
+    TrackIndex index;
+    double index_build = time_ms([&] {
+        index.clear();
+        for (const auto& t : library) index.add(t);
+    }, 1);
+
+    std::cout << std::setw(28) << std::left << "Operation" << std::right
+              << std::setw(14) << "Tag maps" << std::setw(14) << "Columnar"
+              << std::setw(11) << "Speedup" << std::endl;
+    report("build", map_build, index_build);
+
+    // Substring search over title/artist/album
+    const std::string needle = "drazel";
+    std::function<bool(const TagMap&)> matches = [&](const TagMap& tags) {
+        for (const char* key : {"title", "artist", "album_artist", "album"}) {
+            auto it = tags.find(key);
+            if (it != tags.end() && lower(it->second).find(needle) != std::string::npos) return true;
+        }
+        return false;
+    };
+    size_t reference_hits = 0, index_hits = 0;
+    double search_ref = time_ms([&] {
+        std::vector<size_t> hits;
+        for (size_t i = 0; i < maps.size(); ++i) if (matches(maps[i])) hits.push_back(i);
+        reference_hits = hits.size();
+    });
+    double search_idx = time_ms([&] { index_hits = index.select(TrackQuery().contains(needle)).size(); });
+    report("search \"drazel\"", search_ref, search_idx);
+
+    // A title word that only a few tracks carry
+    const std::string rare = lower(library[TRACKS / 2].find("title")->substr(0, 12));
+    size_t rare_hits = 0;
+    double rare_ref = time_ms([&] {
+        size_t hits = 0;
+        for (const TagMap& tags : maps) hits += lower(tags.at("title")).find(rare) != std::string::npos;
+        rare_hits = hits;
+    });
+    double rare_idx = time_ms([&] { index.select(TrackQuery().contains(TrackField::Title, rare)); });
+    report("search rare title", rare_ref, rare_idx);
+
+    // Album artist, date, track number
+    double sort_ref = time_ms([&] {
+        std::vector<size_t> order(maps.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            const TagMap& x = maps[a];
+            const TagMap& y = maps[b];
+            int c = lower(x.at("album_artist")).compare(lower(y.at("album_artist")));
+            if (c != 0) return c < 0;
+            c = x.at("date").compare(y.at("date"));
+            if (c != 0) return c < 0;
+            return std::stoi(x.at("track_number")) < std::stoi(y.at("track_number"));
+        });
+    }, 1);
+    double sort_idx = time_ms([&] {
+        index.select(TrackQuery()
+                         .sort_by(TrackField::AlbumArtist)
+                         .sort_by(TrackField::Date)
+                         .sort_by(TrackField::TrackNumber));
+    });
+    report("sort artist/date/track", sort_ref, sort_idx);
+
+    size_t reference_groups = 0, index_groups = 0;
+    double group_ref = time_ms([&] {
+        std::map<std::string, std::vector<size_t>> groups;
+        for (size_t i = 0; i < maps.size(); ++i) groups[maps[i].at("album")].push_back(i);
+        reference_groups = groups.size();
+    });
+    double group_idx = time_ms([&] { index_groups = index.group_by(TrackField::Album).size(); });
+    report("group by album", group_ref, group_idx);
+
+    std::cout << std::endl << "Search hits: " << reference_hits << " / " << index_hits
+              << ", rare title: " << rare_hits << ", albums: " << reference_groups << " / " << index_groups << std::endl;
+    return 0;
+}
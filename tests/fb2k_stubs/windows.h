@@ -0,0 +1,62 @@
+﻿#pragma once
+
+// Just enough of the Win32 and COM declarations for the fb2k_compat headers
+// to compile where the Windows SDK is not available. Nothing here loads
+// components: GetProcAddress finds no entry points.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+typedef unsigned long ULONG;
+typedef long HRESULT;
+typedef void* HMODULE;
+typedef void (*FARPROC)();
+
+struct GUID {
+    uint32_t Data1;
+    uint16_t Data2;
+    uint16_t Data3;
+    uint8_t Data4[8];
+};
+
+typedef GUID IID;
+typedef GUID CLSID;
+typedef const GUID& REFIID;
+typedef const GUID& REFGUID;
+typedef const GUID& REFCLSID;
+
+inline bool IsEqualGUID(REFGUID a, REFGUID b) {
+    return std::memcmp(&a, &b, sizeof(GUID)) == 0;
+}
+
+inline bool operator==(REFGUID a, REFGUID b) { return IsEqualGUID(a, b); }
+inline bool operator!=(REFGUID a, REFGUID b) { return !IsEqualGUID(a, b); }
+
+#define DEFINE_GUID(name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) \
+    const GUID name = { l, w1, w2, { b1, b2, b3, b4, b5, b6, b7, b8 } }
+
+// Without __declspec(uuid) each interface gets a distinct id per process
+inline uint32_t fb2k_stub_next_uuid() {
+    static std::atomic<uint32_t> next{0};
+    return ++next;
+}
+
+template<typename T>
+const GUID& fb2k_stub_uuidof() {
+    static const GUID id = { fb2k_stub_next_uuid(), 0, 0, { 0, 0, 0, 0, 0, 0, 0, 0 } };
+    return id;
+}
+
+#define __uuidof(type) fb2k_stub_uuidof<type>()
+
+#define STDMETHODCALLTYPE
+
+#define S_OK ((HRESULT)0L)
+#define E_NOINTERFACE ((HRESULT)0x80004002L)
+#define E_POINTER ((HRESULT)0x80004003L)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+inline FARPROC GetProcAddress(HMODULE, const char*) { return nullptr; }
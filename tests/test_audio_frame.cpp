@@ -0,0 +1,184 @@
+﻿#include "../core/audio_frame.h"
+#include "../sdk/xpumusic_plugin_sdk.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace mp;
+using namespace mp::core;
+
+TEST(AudioFrameTest, PoolHandsOutAlignedBlocksUntilExhausted) {
+    AudioFramePool pool(3, 100, 2);
+    EXPECT_EQ(pool.available(), 3u);
+    EXPECT_EQ(pool.block_samples(), 104u * 2);
+
+    AudioFrame a = pool.acquire();
+    AudioFrame b = pool.acquire();
+    AudioFrame c = pool.acquire();
+    ASSERT_TRUE(a && b && c);
+    EXPECT_FALSE(pool.acquire());
+    EXPECT_EQ(pool.available(), 0u);
+
+    for (AudioFrame* frame : {&a, &b, &c}) {
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(frame->data()) % AudioFrame::ALIGNMENT, 0u);
+    }
+
+    b.reset();
+    EXPECT_EQ(pool.available(), 1u);
+    EXPECT_TRUE(pool.acquire(100, 2, 48000, FrameLayout::Planar));
+    EXPECT_FALSE(pool.acquire(105, 2, 48000, FrameLayout::Planar));
+}
+
+TEST(AudioFrameTest, CopiesShareTheBlock) {
+    AudioFramePool pool(1, 64, 2);
+    AudioFrame frame = pool.acquire(64, 2, 44100, FrameLayout::Interleaved);
+    ASSERT_TRUE(frame);
+    EXPECT_TRUE(frame.unique());
+    frame.interleaved()[5] = 0.25f;
+
+    {
+        AudioFrame shared = frame;
+        EXPECT_FALSE(frame.unique());
+        EXPECT_EQ(shared.data(), frame.data());
+        EXPECT_FLOAT_EQ(shared.interleaved()[5], 0.25f);
+
+        // Shared blocks are read-only
+        EXPECT_FALSE(shared.convert_layout(FrameLayout::Planar));
+    }
+    EXPECT_TRUE(frame.unique());
+
+    AudioFrame moved = std::move(frame);
+    EXPECT_FALSE(frame);
+    moved.reset();
+    EXPECT_EQ(pool.available(), 1u);
+}
+
+TEST(AudioFrameTest, PlanarChannelsAreAligned) {
+    AudioFramePool pool(1, 37, 3);
+    AudioFrame frame = pool.acquire(37, 3, 48000, FrameLayout::Planar);
+    ASSERT_TRUE(frame);
+    EXPECT_EQ(frame.channel_stride(), 40u);
+    EXPECT_EQ(frame.interleaved(), nullptr);
+    for (uint16_t c = 0; c < 3; ++c) {
+        ASSERT_NE(frame.channel(c), nullptr);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(frame.channel(c)) % AudioFrame::ALIGNMENT, 0u);
+    }
+    EXPECT_EQ(frame.channel(3), nullptr);
+}
+
+TEST(AudioFrameTest, ImportConvertsAndMapsInOnePass) {
+    AudioFramePool pool(2, 4, 2);
+    const int16_t pcm[] = {16384, -16384, 8192, -8192, 0, 32767, -32768, 0};
+
+    AudioFrame frame = pool.acquire();
+    ASSERT_TRUE(frame.import(pcm, SampleFormat::Int16, 4, 2, 2, 44100, FrameLayout::Planar));
+    EXPECT_EQ(frame.conversions(), 1u);
+    EXPECT_FLOAT_EQ(frame.channel(0)[0], 0.5f);
+    EXPECT_FLOAT_EQ(frame.channel(1)[0], -0.5f);
+    EXPECT_FLOAT_EQ(frame.channel(0)[1], 0.25f);
+    EXPECT_FLOAT_EQ(frame.channel(0)[3], -1.0f);
+
+    // Mono is duplicated, and extra source channels are dropped
+    const float mono[] = {0.1f, 0.2f, 0.3f};
+    AudioFrame up = pool.acquire();
+    ASSERT_TRUE(up.import(mono, SampleFormat::Float32, 3, 1, 2, 44100, FrameLayout::Interleaved));
+    EXPECT_FLOAT_EQ(up.interleaved()[4], 0.3f);
+    EXPECT_FLOAT_EQ(up.interleaved()[5], 0.3f);
+
+    const float quad[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    frame.reset();
+    AudioFrame down = pool.acquire();
+    ASSERT_TRUE(down.import(quad, SampleFormat::Float32, 2, 4, 2, 44100, FrameLayout::Interleaved));
+    EXPECT_FLOAT_EQ(down.interleaved()[2], 5.0f);
+    EXPECT_FLOAT_EQ(down.interleaved()[3], 6.0f);
+}
+
+TEST(AudioFrameTest, LayoutRoundTripKeepsSamples) {
+    AudioFramePool pool(2, 50, 2);
+    AudioFrame frame = pool.acquire(50, 2, 48000, FrameLayout::Interleaved);
+    ASSERT_TRUE(frame);
+    frame.set_position(1234);
+    for (size_t i = 0; i < 100; ++i) {
+        frame.interleaved()[i] = static_cast<float>(i);
+    }
+
+    ASSERT_TRUE(frame.convert_layout(FrameLayout::Planar));
+    EXPECT_EQ(frame.layout(), FrameLayout::Planar);
+    EXPECT_FLOAT_EQ(frame.channel(0)[10], 20.0f);
+    EXPECT_FLOAT_EQ(frame.channel(1)[10], 21.0f);
+    EXPECT_EQ(frame.position(), 1234u);
+    EXPECT_EQ(pool.available(), 1u);
+
+    ASSERT_TRUE(frame.convert_layout(FrameLayout::Interleaved));
+    for (size_t i = 0; i < 100; ++i) {
+        ASSERT_FLOAT_EQ(frame.interleaved()[i], static_cast<float>(i));
+    }
+    EXPECT_EQ(frame.conversions(), 2u);
+}
+
+TEST(AudioFrameTest, LegacyBuffersViewTheSameSamples) {
+    AudioFramePool pool(2, 16, 2);
+    AudioFrame frame = pool.acquire(16, 2, 96000, FrameLayout::Interleaved);
+    ASSERT_TRUE(frame);
+    frame.set_position(96000);
+
+    AudioBuffer mp_buffer = as_mp_buffer(frame);
+    EXPECT_EQ(mp_buffer.data, frame.data());
+    EXPECT_EQ(mp_buffer.frames, 16u);
+    EXPECT_EQ(mp_buffer.format, SampleFormat::Float32);
+    EXPECT_EQ(mp_buffer.timestamp_us, 1000000u);
+
+    xpumusic::AudioBuffer sdk_buffer = as_xpumusic_buffer(frame);
+    EXPECT_EQ(sdk_buffer.data, frame.data());
+    EXPECT_EQ(sdk_buffer.frames, 16);
+    EXPECT_EQ(sdk_buffer.channels, 2);
+
+    frame.interleaved()[31] = 0.75f;
+    AudioFrame imported = import_buffer(pool, mp_buffer, FrameLayout::Planar);
+    ASSERT_TRUE(imported);
+    EXPECT_FLOAT_EQ(imported.channel(1)[15], 0.75f);
+    EXPECT_EQ(imported.position(), 96000u);
+
+    imported.reset();
+    ASSERT_TRUE(frame.convert_layout(FrameLayout::Planar));
+    EXPECT_EQ(as_mp_buffer(frame).data, nullptr);
+}
+
+TEST(AudioFrameTest, BlocksReturnFromOtherThreads) {
+    AudioFramePool pool(8, 32, 2);
+    std::atomic<int> acquired{0};
+
+    auto worker = [&] {
+        for (int i = 0; i < 20000; ++i) {
+            AudioFrame frame = pool.acquire(32, 2, 48000, FrameLayout::Interleaved);
+            if (frame) {
+                frame.interleaved()[0] = static_cast<float>(i);
+                AudioFrame handed_on = std::move(frame);
+                acquired.fetch_add(1);
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_GT(acquired.load(), 0);
+    EXPECT_EQ(pool.available(), 8u);
+}
+
+TEST(AudioFrameTest, FramesOutliveThePool) {
+    AudioFrame frame;
+    {
+        AudioFramePool pool(1, 8, 1);
+        frame = pool.acquire(8, 1, 44100, FrameLayout::Interleaved);
+    }
+    ASSERT_TRUE(frame);
+    frame.silence();
+    EXPECT_FLOAT_EQ(frame.interleaved()[7], 0.0f);
+}
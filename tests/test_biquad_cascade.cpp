@@ -0,0 +1,179 @@
+﻿#include "../core/biquad_cascade.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace mp::core;
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+BiquadCoefficients peaking(double sample_rate, double frequency, double gain_db, double q) {
+    double A = std::pow(10.0, gain_db / 40.0);
+    double omega = 2.0 * PI * frequency / sample_rate;
+    double alpha = std::sin(omega) / (2.0 * q);
+    double cos_omega = std::cos(omega);
+    return BiquadCoefficients::normalized(
+        static_cast<float>(1.0 + alpha * A), static_cast<float>(-2.0 * cos_omega),
+        static_cast<float>(1.0 - alpha * A), static_cast<float>(1.0 + alpha / A),
+        static_cast<float>(-2.0 * cos_omega), static_cast<float>(1.0 - alpha / A));
+}
+
+// One independent transposed direct form II chain per channel, in T
+template <typename T>
+std::vector<float> reference(const std::vector<BiquadCoefficients>& sections, uint16_t channels,
+                             const std::vector<float>& input) {
+    std::vector<float> output(input);
+    size_t frames = input.size() / channels;
+    for (const BiquadCoefficients& c : sections) {
+        for (uint16_t ch = 0; ch < channels; ++ch) {
+            T z1 = 0, z2 = 0;
+            for (size_t i = 0; i < frames; ++i) {
+                T x = output[i * channels + ch];
+                T y = c.b0 * x + z1;
+                z1 = c.b1 * x - c.a1 * y + z2;
+                z2 = c.b2 * x - c.a2 * y;
+                output[i * channels + ch] = static_cast<float>(y);
+            }
+        }
+    }
+    return output;
+}
+
+std::vector<float> noise(size_t count, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+    std::vector<float> samples(count);
+    for (float& s : samples) {
+        s = dist(gen);
+    }
+    return samples;
+}
+
+std::vector<BiquadCoefficients> graphic_eq(size_t bands, double sample_rate) {
+    std::vector<BiquadCoefficients> sections;
+    for (size_t i = 0; i < bands; ++i) {
+        double frequency = 20.0 * std::pow(2.0, i / 3.0);
+        double gain = (i % 5 == 0) ? 0.0 : 6.0 * std::sin(static_cast<double>(i));
+        sections.push_back(peaking(sample_rate, frequency, gain, 4.3));
+    }
+    return sections;
+}
+
+} // namespace
+
+class BiquadCascadeChannels : public ::testing::TestWithParam<int> {};
+
+TEST_P(BiquadCascadeChannels, MatchesReferencePerChannel) {
+    const uint16_t channels = static_cast<uint16_t>(GetParam());
+    const size_t frames = 3000;
+    std::vector<BiquadCoefficients> sections = graphic_eq(31, 48000.0);
+
+    BiquadCascade cascade;
+    cascade.configure(sections.size(), channels);
+    for (size_t i = 0; i < sections.size(); ++i) {
+        cascade.set_section(i, sections[i]);
+    }
+
+    // Distinct signals per channel, so shared state would show up
+    std::vector<float> input = noise(frames * channels, 7);
+    std::vector<float> expected = reference<float>(sections, channels, input);
+
+    // Uneven call sizes cross internal block boundaries
+    std::vector<float> output(input);
+    size_t sizes[] = {1, 2, 3, 300, 257, 1000};
+    size_t offset = 0;
+    for (size_t k = 0; offset < frames; ++k) {
+        size_t count = std::min(sizes[k % 6], frames - offset);
+        cascade.process(output.data() + offset * channels, count);
+        offset += count;
+    }
+
+    for (size_t i = 0; i < output.size(); ++i) {
+        ASSERT_NEAR(output[i], expected[i], 1e-5f) << "sample " << i;
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Layouts, BiquadCascadeChannels, ::testing::Values(1, 2, 3, 4, 6, 8));
+
+TEST(BiquadCascadeTest, FloatRoundOffStaysSmall) {
+    // ISO 31-band layout, lowest section at 20 Hz
+    std::vector<BiquadCoefficients> sections = graphic_eq(31, 48000.0);
+    BiquadCascade cascade;
+    cascade.configure(sections.size(), 2);
+    for (size_t i = 0; i < sections.size(); ++i) {
+        cascade.set_section(i, sections[i]);
+    }
+
+    std::vector<float> input = noise(2 * 20000, 9);
+    std::vector<float> expected = reference<double>(sections, 2, input);
+    std::vector<float> output(input);
+    cascade.process(output.data(), 20000);
+
+    double error = 0.0;
+    double power = 0.0;
+    for (size_t i = 0; i < output.size(); ++i) {
+        error += (output[i] - expected[i]) * (output[i] - expected[i]);
+        power += expected[i] * expected[i];
+    }
+    EXPECT_LT(10.0 * std::log10(error / power), -50.0);
+}
+
+TEST(BiquadCascadeTest, IdentitySectionsPassThrough) {
+    BiquadCascade cascade;
+    cascade.configure(31, 2);
+    for (size_t i = 0; i < 31; ++i) {
+        cascade.set_section(i, peaking(48000.0, 100.0 * (i + 1), 0.0, 1.0));
+    }
+    EXPECT_TRUE(cascade.section(0).is_identity());
+
+    std::vector<float> input = noise(512, 3);
+    std::vector<float> output(input);
+    cascade.process(output.data(), 256);
+    EXPECT_EQ(output, input);
+}
+
+TEST(BiquadCascadeTest, ReenabledSectionStartsFromRest) {
+    BiquadCoefficients boost = peaking(48000.0, 1000.0, 9.0, 2.0);
+
+    BiquadCascade cascade;
+    cascade.configure(2, 1);
+    cascade.set_section(1, boost);
+
+    std::vector<float> block = noise(256, 11);
+    cascade.process(block.data(), block.size());
+
+    // Toggle section 1 off, run, then on again
+    cascade.set_section(1, BiquadCoefficients());
+    std::vector<float> silence(256, 0.0f);
+    cascade.process(silence.data(), silence.size());
+    cascade.set_section(1, boost);
+
+    std::vector<float> impulse(64, 0.0f);
+    impulse[0] = 1.0f;
+    std::vector<float> expected = reference<double>({boost}, 1, impulse);
+    cascade.process(impulse.data(), impulse.size());
+    for (size_t i = 0; i < impulse.size(); ++i) {
+        EXPECT_NEAR(impulse[i], expected[i], 1e-5f);
+    }
+}
+
+TEST(BiquadCascadeTest, ResetClearsState) {
+    BiquadCascade cascade;
+    cascade.configure(4, 2);
+    for (size_t i = 0; i < 4; ++i) {
+        cascade.set_section(i, peaking(44100.0, 200.0 * (i + 1), 6.0, 0.7));
+    }
+
+    std::vector<float> block = noise(2 * 500, 5);
+    cascade.process(block.data(), 500);
+    cascade.reset();
+
+    std::vector<float> silence(2 * 100, 0.0f);
+    cascade.process(silence.data(), 100);
+    for (float s : silence) {
+        EXPECT_EQ(s, 0.0f);
+    }
+}
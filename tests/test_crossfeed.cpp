@@ -0,0 +1,72 @@
+﻿#include "../core/crossfeed.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+using namespace mp::core;
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// Steady-state amplitude of each output channel for a sine fed to the
+// given input channels
+void sine_response(Crossfeed& crossfeed, float rate, float frequency, float left_in,
+                   float right_in, float& left_out, float& right_out) {
+    const size_t FRAMES = static_cast<size_t>(rate);
+    std::vector<float> samples(FRAMES * 2);
+    for (size_t f = 0; f < FRAMES; ++f) {
+        float s = static_cast<float>(std::sin(2.0 * PI * frequency * f / rate));
+        samples[2 * f] = left_in * s;
+        samples[2 * f + 1] = right_in * s;
+    }
+    crossfeed.reset();
+    crossfeed.process(samples.data(), FRAMES);
+
+    left_out = right_out = 0.0f;
+    for (size_t f = FRAMES / 2; f < FRAMES; ++f) {
+        left_out = std::max(left_out, std::fabs(samples[2 * f]));
+        right_out = std::max(right_out, std::fabs(samples[2 * f + 1]));
+    }
+}
+
+} // namespace
+
+TEST(CrossfeedTest, CentredBassKeepsItsLevel) {
+    const float RATE = 48000.0f;
+    Crossfeed crossfeed;
+    ASSERT_TRUE(crossfeed.configure(RATE));
+
+    float left, right;
+    sine_response(crossfeed, RATE, 40.0f, 0.5f, 0.5f, left, right);
+    EXPECT_NEAR(left, 0.5f, 0.01f);
+    EXPECT_NEAR(right, 0.5f, 0.01f);
+}
+
+TEST(CrossfeedTest, FeedLevelAtLowFrequencies) {
+    const float RATE = 44100.0f;
+    Crossfeed crossfeed;
+    ASSERT_TRUE(crossfeed.configure(RATE));
+
+    for (float feed : {4.5f, 6.0f, 9.5f}) {
+        crossfeed.set(Crossfeed::DEFAULT_CUTOFF, feed);
+        float left, right;
+        sine_response(crossfeed, RATE, 30.0f, 1.0f, 0.0f, left, right);
+        EXPECT_NEAR(20.0f * std::log10(right / left), -feed, 0.2f) << feed;
+    }
+}
+
+TEST(CrossfeedTest, HighsStayOnTheirSide) {
+    const float RATE = 48000.0f;
+    Crossfeed crossfeed;
+    ASSERT_TRUE(crossfeed.configure(RATE));
+
+    float low_left, low_right, high_left, high_right;
+    sine_response(crossfeed, RATE, 100.0f, 1.0f, 0.0f, low_left, low_right);
+    sine_response(crossfeed, RATE, 8000.0f, 1.0f, 0.0f, high_left, high_right);
+
+    // The cross path is a low-pass: far less leaks at 8 kHz than at 100 Hz
+    EXPECT_LT(high_right / high_left, 0.2f * (low_right / low_left));
+    // and the shelf lifts the direct path to make up for it
+    EXPECT_GT(high_left, low_left);
+}
@@ -0,0 +1,225 @@
+﻿#include "../fb2k_compat/stage1_2/dsp_interfaces.h"
+#include "../core/realtime_guard.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+using namespace fb2k;
+
+namespace {
+
+std::atomic<int> violations{0};
+
+void count_violation(mp::core::rt::Violation, const char*) {
+    ++violations;
+}
+
+class no_abort : public abort_callback {
+public:
+    bool is_aborting() const override { return false; }
+};
+
+// Scales by gain, reading the dry signal from a copy taken from the arena
+class arena_gain : public dsp {
+public:
+    explicit arena_gain(float gain) : gain_(gain) {}
+
+    int instantiations = 0;
+    uint32_t instantiated_rate = 0;
+    uint32_t instantiated_channels = 0;
+    size_t arena_used_at_run = SIZE_MAX;
+    const float* last_scratch = nullptr;
+
+    bool instantiate(audio_chunk&, uint32_t sample_rate, uint32_t channels) override {
+        ++instantiations;
+        instantiated_rate = sample_rate;
+        instantiated_channels = channels;
+        return true;
+    }
+    void reset() override {}
+
+    void run(audio_chunk& chunk, abort_callback&) override {
+        arena_used_at_run = arena_ ? arena_->get_used() : SIZE_MAX;
+        const float* dry = arena_ ? arena_->acquire_copy(chunk) : nullptr;
+        last_scratch = dry;
+        if(!dry) {
+            return;
+        }
+        float* out = chunk.get_data();
+        size_t samples = chunk.get_sample_count() * chunk.get_channels();
+        for(size_t i = 0; i < samples; ++i) {
+            out[i] = dry[i] * gain_;
+        }
+    }
+
+    void get_preset(dsp_preset&) const override {}
+    void set_preset(const dsp_preset&) override {}
+    std::vector<dsp_config_param> get_config_params() const override { return {}; }
+    bool need_track_change_mark() const override { return false; }
+    double get_latency() const override { return 0.0; }
+    const char* get_name() const override { return "arena_gain"; }
+    const char* get_description() const override { return "Gain through an arena dry copy"; }
+    bool can_work_with(const audio_chunk&) const override { return true; }
+    bool supports_format(uint32_t, uint32_t) const override { return true; }
+    void set_buffer_arena(dsp_buffer_arena* arena) override { arena_ = arena; }
+
+private:
+    float gain_;
+    dsp_buffer_arena* arena_ = nullptr;
+};
+
+void fill(audio_chunk_impl& chunk, size_t frames, uint32_t channels, uint32_t sample_rate) {
+    std::vector<float> samples(frames * channels);
+    for(size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = static_cast<float>(i % 97) / 97.0f - 0.5f;
+    }
+    chunk.set_data(samples.data(), frames, channels, sample_rate);
+}
+
+} // namespace
+
+TEST(DspBufferArenaTest, AcquiresAlignedBuffersUntilFull) {
+    dsp_buffer_arena arena;
+    arena.configure(256, 2, 2);
+    ASSERT_EQ(arena.get_capacity(), 1024u);
+
+    float* first = arena.acquire(100);
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(first) % 64, 0u);
+    float* second = arena.acquire(512);
+    ASSERT_NE(second, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(second) % 64, 0u);
+    EXPECT_GE(second, first + 100);
+
+    // Exhausted: the caller falls back rather than the arena growing
+    EXPECT_EQ(arena.acquire(512), nullptr);
+    EXPECT_EQ(arena.get_capacity(), 1024u);
+
+    arena.release_all();
+    EXPECT_EQ(arena.get_used(), 0u);
+    EXPECT_EQ(arena.acquire(1024), first);
+}
+
+TEST(DspBufferArenaTest, CopyHoldsTheDrySignal) {
+    dsp_buffer_arena arena;
+    arena.configure(512, 2);
+    audio_chunk_impl chunk;
+    fill(chunk, 512, 2, 48000);
+    EXPECT_TRUE(arena.fits(chunk));
+
+    const float* dry = arena.acquire_copy(chunk);
+    ASSERT_NE(dry, nullptr);
+    std::vector<float> expected(chunk.get_data(), chunk.get_data() + 1024);
+    chunk.apply_gain(0.0f);
+    for(size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(dry[i], expected[i]) << "sample " << i;
+    }
+
+    fill(chunk, 513, 2, 48000);
+    EXPECT_FALSE(arena.fits(chunk));
+}
+
+TEST(AudioChunkTest, ReservedChunkKeepsItsStorage) {
+    audio_chunk_impl chunk;
+    chunk.reserve(4096, 8);
+    fill(chunk, 64, 2, 44100);
+    const float* storage = chunk.get_data();
+    size_t capacity = chunk.get_capacity_samples();
+    ASSERT_GE(capacity, 4096u * 8);
+
+    audio_chunk_impl source;
+    fill(source, 4096, 8, 96000);
+    chunk.copy(source);
+    fill(chunk, 4096, 6, 48000);
+    chunk.set_data_size(1000);
+    EXPECT_EQ(chunk.get_data(), storage);
+    EXPECT_EQ(chunk.get_capacity_samples(), capacity);
+}
+
+TEST(DspChainTest, InstantiatesOnlyOnFormatChange) {
+    arena_gain first(1.0f), second(1.0f);
+    dsp_chain chain;
+    no_abort abort;
+    chain.add_effect(&first);
+
+    audio_chunk_impl chunk;
+    for(int i = 0; i < 10; ++i) {
+        fill(chunk, 512, 2, 44100);
+        chain.run_chain(chunk, abort);
+    }
+    EXPECT_EQ(first.instantiations, 1);
+
+    fill(chunk, 512, 2, 48000);
+    chain.run_chain(chunk, abort);
+    chain.run_chain(chunk, abort);
+    EXPECT_EQ(first.instantiations, 2);
+    EXPECT_EQ(first.instantiated_rate, 48000u);
+
+    fill(chunk, 512, 1, 48000);
+    chain.run_chain(chunk, abort);
+    EXPECT_EQ(first.instantiations, 3);
+    EXPECT_EQ(first.instantiated_channels, 1u);
+
+    // An effect added while running is prepared for the running format;
+    // the effects already running are left alone
+    chain.add_effect(&second);
+    EXPECT_EQ(second.instantiations, 1);
+    chain.run_chain(chunk, abort);
+    chain.run_chain(chunk, abort);
+    EXPECT_EQ(first.instantiations, 3);
+    EXPECT_EQ(second.instantiations, 1);
+}
+
+TEST(DspChainTest, EffectsReuseTheChainArena) {
+    arena_gain half(0.5f), triple(3.0f);
+    dsp_chain chain;
+    chain.configure(1024, 2);
+    no_abort abort;
+    chain.add_effect(&half);
+    chain.add_effect(&triple);
+
+    audio_chunk_impl chunk;
+    fill(chunk, 1024, 2, 48000);
+    std::vector<float> input(chunk.get_data(), chunk.get_data() + 2048);
+    chain.run_chain(chunk, abort);
+
+    // Each effect starts with the whole arena: the first one's dry copy was
+    // reclaimed before the second ran
+    EXPECT_EQ(half.arena_used_at_run, 0u);
+    EXPECT_EQ(triple.arena_used_at_run, 0u);
+    ASSERT_NE(half.last_scratch, nullptr);
+    EXPECT_EQ(triple.last_scratch, half.last_scratch);
+    EXPECT_EQ(chain.get_buffer_arena().get_used(), 0u);
+    for(size_t i = 0; i < input.size(); ++i) {
+        ASSERT_FLOAT_EQ(chunk.get_data()[i], input[i] * 1.5f) << "sample " << i;
+    }
+}
+
+TEST(DspChainTest, ChunkRunsWithoutHeapAllocation) {
+#if !MP_REALTIME_CHECKS
+    GTEST_SKIP() << "real-time checks are compiled out of this build";
+#endif
+    arena_gain first(0.5f), second(2.0f);
+    dsp_chain chain;
+    no_abort abort;
+    chain.add_effect(&first);
+    chain.add_effect(&second);
+
+    audio_chunk_impl chunk;
+    chunk.reserve(dsp_chain::DEFAULT_MAX_BLOCK_FRAMES, dsp_chain::DEFAULT_MAX_CHANNELS);
+    fill(chunk, 4096, 2, 44100);
+    chain.run_chain(chunk, abort);   // Instantiates; allowed to allocate
+
+    violations = 0;
+    mp::core::rt::set_violation_handler(&count_violation);
+    {
+        mp::core::rt::RealtimeScope realtime;
+        for(int i = 0; i < 8; ++i) {
+            chain.run_chain(chunk, abort);
+        }
+    }
+    mp::core::rt::set_violation_handler(nullptr);
+    EXPECT_EQ(violations, 0);
+    EXPECT_NE(first.last_scratch, nullptr);
+}
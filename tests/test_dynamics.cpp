@@ -0,0 +1,234 @@
+﻿#include "../core/dynamics.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace mp::core;
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+float to_db(float x) {
+    return 20.0f * std::log10(std::max(x, 1e-12f));
+}
+
+float from_db(float db) {
+    return std::pow(10.0f, db / 20.0f);
+}
+
+// Largest |x| of each channel's 16x sinc-interpolated signal: a reference
+// true peak far finer than the limiter's own detector
+float reference_true_peak(const std::vector<float>& x, uint16_t channels) {
+    const int RADIUS = 32;
+    const int OVERSAMPLE = 16;
+    size_t frames = x.size() / channels;
+    float peak = 0.0f;
+    for (uint16_t c = 0; c < channels; ++c) {
+        for (size_t n = RADIUS; n + RADIUS < frames; ++n) {
+            for (int s = 0; s < OVERSAMPLE; ++s) {
+                double t = static_cast<double>(s) / OVERSAMPLE;
+                double y = 0.0;
+                for (int k = -RADIUS; k <= RADIUS; ++k) {
+                    double d = t - k;
+                    double sinc = d == 0.0 ? 1.0 : std::sin(PI * d) / (PI * d);
+                    double window = 0.5 + 0.5 * std::cos(PI * d / (RADIUS + 1));
+                    y += x[(n + k) * channels + c] * sinc * window;
+                }
+                peak = std::max(peak, static_cast<float>(std::fabs(y)));
+            }
+        }
+    }
+    return peak;
+}
+
+} // namespace
+
+TEST(EnvelopeFollowerTest, AttackAndReleaseTimeConstants) {
+    const float RATE = 48000.0f;
+    EnvelopeFollower follower;
+    ASSERT_TRUE(follower.configure(2));
+    follower.set_times(10.0f, 100.0f, RATE);
+
+    // Channel 0 steps up to 1, channel 1 stays at 0
+    std::vector<float> values(480 * 2);
+    for (size_t f = 0; f < 480; ++f) {
+        values[2 * f] = 1.0f;
+    }
+    follower.process(values.data(), 480);
+    EXPECT_NEAR(values[2 * 479], 1.0f - std::exp(-1.0f), 0.01f);
+    EXPECT_EQ(values[2 * 479 + 1], 0.0f);
+
+    // Release is ten times slower
+    follower.reset(1.0f);
+    std::vector<float> zeros(4800 * 2, 0.0f);
+    follower.process(zeros.data(), 4800);
+    EXPECT_NEAR(zeros[2 * 4799], std::exp(-1.0f), 0.01f);
+    EXPECT_NEAR(zeros[2 * 4799 + 1], std::exp(-1.0f), 0.01f);
+}
+
+TEST(EnvelopeFollowerTest, ChannelsBeyondFourAreIndependent) {
+    EnvelopeFollower follower;
+    ASSERT_TRUE(follower.configure(6));
+    EXPECT_FALSE(follower.configure(9));
+    ASSERT_TRUE(follower.configure(6));
+    follower.set_times(0.0f, 0.0f, 48000.0f);
+
+    std::vector<float> values = {1, 2, 3, 4, 5, 6};
+    follower.process(values.data(), 1);
+    for (uint16_t c = 0; c < 6; ++c) {
+        EXPECT_EQ(values[c], c + 1.0f);
+        EXPECT_EQ(follower.state(c), c + 1.0f);
+    }
+}
+
+TEST(CompressorTest, StaticCurve) {
+    Compressor compressor;
+    compressor.set_threshold(-20.0f);
+    compressor.set_ratio(4.0f);
+    compressor.set_knee(0.0f);
+    EXPECT_NEAR(compressor.gain_reduction_for(-30.0f), 0.0f, 1e-3f);
+    EXPECT_NEAR(compressor.gain_reduction_for(-10.0f), 7.5f, 1e-3f);
+
+    // Inside a soft knee the curve is continuous and below the hard one
+    compressor.set_knee(10.0f);
+    EXPECT_NEAR(compressor.gain_reduction_for(-25.0f), 0.0f, 1e-3f);
+    EXPECT_NEAR(compressor.gain_reduction_for(-15.0f), 3.75f, 1e-3f);
+    float middle = compressor.gain_reduction_for(-20.0f);
+    EXPECT_GT(middle, 0.0f);
+    EXPECT_LT(middle, 1.0f);
+}
+
+TEST(CompressorTest, SettlesOnTheCurveAndLinksChannels) {
+    const float RATE = 48000.0f;
+    Compressor compressor;
+    ASSERT_TRUE(compressor.configure(RATE, 2));
+    compressor.set_threshold(-20.0f);
+    compressor.set_ratio(4.0f);
+    compressor.set_makeup(2.0f);
+    compressor.set_times(1.0f, 50.0f);
+
+    // Left at -10 dB DC, right quiet: both get left's 7.5 dB reduction
+    const size_t FRAMES = 24000;
+    std::vector<float> samples(FRAMES * 2);
+    for (size_t f = 0; f < FRAMES; ++f) {
+        samples[2 * f] = from_db(-10.0f);
+        samples[2 * f + 1] = from_db(-40.0f);
+    }
+    compressor.process(samples.data(), FRAMES);
+
+    EXPECT_NEAR(to_db(samples[2 * (FRAMES - 1)]), -10.0f - 7.5f + 2.0f, 0.05f);
+    EXPECT_NEAR(to_db(samples[2 * (FRAMES - 1) + 1]), -40.0f - 7.5f + 2.0f, 0.05f);
+    EXPECT_NEAR(compressor.gain_reduction(), 7.5f, 0.05f);
+
+    // Below threshold only makeup applies, once the release has run out
+    for (size_t f = 0; f < FRAMES; ++f) {
+        samples[2 * f] = from_db(-30.0f);
+        samples[2 * f + 1] = from_db(-30.0f);
+    }
+    compressor.process(samples.data(), FRAMES);
+    EXPECT_NEAR(to_db(samples[2 * (FRAMES - 1)]), -28.0f, 0.05f);
+}
+
+TEST(CompressorTest, OddChannelCountsAndBlockSizes) {
+    Compressor compressor;
+    ASSERT_TRUE(compressor.configure(44100.0f, 3));
+    compressor.set_threshold(-6.0f);
+    compressor.set_ratio(2.0f);
+    compressor.set_times(0.0f, 0.0f);
+
+    // Instant follower: a single frame is compressed exactly on the curve
+    std::vector<float> samples(1001 * 3, from_db(0.0f));
+    compressor.process(samples.data(), 1001);
+    for (float x : samples) {
+        ASSERT_NEAR(to_db(x), -3.0f, 0.01f);
+    }
+}
+
+TEST(LookaheadLimiterTest, LatencyIsExact) {
+    const float RATE = 48000.0f;
+    LookaheadLimiter limiter;
+    ASSERT_TRUE(limiter.configure(RATE, 2, 5.0f));
+    EXPECT_EQ(limiter.latency(), 240u);
+    limiter.set_ceiling(-1.0f);
+
+    // A quiet impulse comes out unchanged, exactly latency() frames later
+    std::vector<float> samples(1024 * 2, 0.0f);
+    samples[100 * 2] = 0.5f;
+    samples[100 * 2 + 1] = -0.25f;
+    limiter.process(samples.data(), 1024);
+    for (size_t f = 0; f < 1024; ++f) {
+        float left = f == 100 + limiter.latency() ? 0.5f : 0.0f;
+        float right = f == 100 + limiter.latency() ? -0.25f : 0.0f;
+        ASSERT_FLOAT_EQ(samples[2 * f], left) << f;
+        ASSERT_FLOAT_EQ(samples[2 * f + 1], right) << f;
+    }
+    EXPECT_EQ(limiter.gain_reduction(), 0.0f);
+
+    // Never shorter than the detector needs
+    ASSERT_TRUE(limiter.configure(RATE, 1, 0.0f));
+    EXPECT_EQ(limiter.latency(), 2 * LookaheadLimiter::DETECTOR_DELAY);
+}
+
+TEST(LookaheadLimiterTest, HoldsTruePeakUnderTheCeiling) {
+    const float RATE = 44100.0f;
+    const float CEILING_DB = -1.0f;
+    LookaheadLimiter limiter;
+    ASSERT_TRUE(limiter.configure(RATE, 2, 2.0f));
+    limiter.set_ceiling(CEILING_DB);
+    limiter.set_release(20.0f);
+
+    // Loud noise, then a tone at a quarter of the rate whose samples miss
+    // its peaks by 3 dB. The noise is averaged over two samples, taking the
+    // top octave down as in program material: right at Nyquist, peaks can
+    // fall between the detector's points.
+    const size_t FRAMES = 22050;
+    std::mt19937 rng(7);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::vector<float> samples(FRAMES * 2);
+    float previous[2] = {0.0f, 0.0f};
+    for (size_t f = 0; f < FRAMES; ++f) {
+        float tone = 2.0f * static_cast<float>(std::sin(2.0 * PI * 11025.0 * f / RATE + PI / 4));
+        for (int c = 0; c < 2; ++c) {
+            float n = noise(rng);
+            samples[2 * f + c] = f < FRAMES / 2 ? (c == 0 ? 4.0f : 1.0f) * (n + previous[c]) : tone;
+            previous[c] = n;
+        }
+    }
+    limiter.process(samples.data(), FRAMES);
+
+    float sample_peak = 0.0f;
+    for (float x : samples) {
+        sample_peak = std::max(sample_peak, std::fabs(x));
+    }
+    EXPECT_LE(to_db(sample_peak), CEILING_DB + 0.01f);
+    // Peaks between the detector's 4x points go unseen, as with any
+    // BS.1770 meter; a few tenths of a dB on bright material
+    EXPECT_LE(to_db(reference_true_peak(samples, 2)), CEILING_DB + 0.3f);
+    EXPECT_GT(limiter.gain_reduction(), 6.0f);
+
+    // A steady tone ends up right at the ceiling, not far below it
+    std::vector<float> tail(samples.end() - 2000, samples.end());
+    EXPECT_GT(to_db(reference_true_peak(tail, 2)), CEILING_DB - 0.5f);
+}
+
+TEST(LookaheadLimiterTest, RecoversAfterTheRelease) {
+    const float RATE = 48000.0f;
+    LookaheadLimiter limiter;
+    ASSERT_TRUE(limiter.configure(RATE, 1, 1.0f));
+    limiter.set_ceiling(-6.0f);
+    limiter.set_release(10.0f);
+
+    std::vector<float> samples(48000, 0.1f);
+    samples[1000] = 1.0f;
+    limiter.process(samples.data(), samples.size());
+
+    size_t out = 1000 + limiter.latency();
+    EXPECT_NEAR(to_db(samples[out]), -6.0f, 0.1f);
+    // The ramp pulled the samples just before the peak down too
+    EXPECT_LT(samples[out - 1], 0.1f);
+    // Five release time constants later it is back to unity
+    EXPECT_NEAR(samples[out + 2400], 0.1f, 0.001f);
+}
@@ -1,8 +1,11 @@
 ﻿#include "../core/event_bus.h"
+#include "../core/realtime_guard.h"
 #include <gtest/gtest.h>
 #include <thread>
 #include <chrono>
 #include <atomic>
+#include <string>
+#include <vector>
 
 using namespace mp::core;
 
@@ -12,23 +15,23 @@ protected:
 
     void SetUp() override {
         event_bus_ = new EventBus();
-        ASSERT_EQ(event_bus_->initialize(), mp::Result::Success);
+        event_bus_->start();
     }
 
     void TearDown() override {
-        event_bus_->shutdown();
+        event_bus_->stop();
         delete event_bus_;
     }
 };
 
 TEST_F(EventBusTest, SubscribeAndPublish) {
-    bool callback_invoked = false;
-    mp::EventType received_type = 0;
+    std::atomic<bool> callback_invoked{false};
+    std::atomic<mp::EventID> received_type{0};
     
     auto handle = event_bus_->subscribe(mp::EVENT_PLAYBACK_STARTED,
         [&](const mp::Event& evt) {
             callback_invoked = true;
-            received_type = evt.type;
+            received_type = evt.id;
         }
     );
     
@@ -174,7 +177,7 @@ TEST_F(EventBusTest, EventDataPassing) {
     
     const std::string test_data = "test_payload";
     mp::Event event(mp::EVENT_PLAYBACK_STARTED);
-    event.data = test_data.c_str();
+    event.data = const_cast<char*>(test_data.c_str());
     event.data_size = test_data.length();
     
     event_bus_->publish_sync(event);
@@ -183,3 +186,116 @@ TEST_F(EventBusTest, EventDataPassing) {
     
     event_bus_->unsubscribe(handle);
 }
+
+namespace {
+
+// Waits up to a second for the worker to dispatch count events
+bool wait_dispatched(const EventBus& bus, uint64_t count) {
+    for (int i = 0; i < 1000 && bus.get_stats().dispatched < count; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return bus.get_stats().dispatched >= count;
+}
+
+int violations = 0;
+
+void count_violation(rt::Violation, const char*) {
+    ++violations;
+}
+
+} // namespace
+
+TEST(EventBusQueueTest, CoalescesPendingPositionTicks) {
+    EventBus bus;
+    std::vector<int> positions(1000);
+    std::vector<int> received;
+    bus.subscribe(mp::EVENT_POSITION_CHANGED, [&](const mp::Event& evt) {
+        received.push_back(*static_cast<const int*>(evt.data));
+    });
+    int stopped = 0;
+    bus.subscribe(mp::EVENT_PLAYBACK_STOPPED, [&](const mp::Event&) { ++stopped; });
+
+    // Queued before the worker runs: one slot for all the ticks
+    for (int i = 0; i < 1000; ++i) {
+        positions[i] = i;
+        ASSERT_EQ(bus.publish(mp::Event(mp::EVENT_POSITION_CHANGED, &positions[i], sizeof(int))),
+                  mp::Result::Success);
+    }
+    bus.publish(mp::Event(mp::EVENT_PLAYBACK_STOPPED));
+    bus.publish(mp::Event(mp::EVENT_PLAYBACK_STOPPED));
+
+    auto stats = bus.get_stats();
+    EXPECT_EQ(stats.published, 1002u);
+    EXPECT_EQ(stats.coalesced, 999u);
+
+    bus.start();
+    ASSERT_TRUE(wait_dispatched(bus, 3));
+    bus.stop();
+    ASSERT_EQ(received.size(), 1u);
+    EXPECT_EQ(received[0], 999);
+    EXPECT_EQ(stopped, 2);
+
+    // Once dispatched, the next tick queues again
+    bus.publish(mp::Event(mp::EVENT_POSITION_CHANGED, &positions[5], sizeof(int)));
+    bus.start();
+    ASSERT_TRUE(wait_dispatched(bus, 4));
+    bus.stop();
+    ASSERT_EQ(received.size(), 2u);
+    EXPECT_EQ(received[1], 5);
+}
+
+TEST(EventBusQueueTest, PublishFailsWhenQueueIsFull) {
+    EventBus bus(8);
+    int count = 0;
+    bus.subscribe(mp::EVENT_SEEK, [&](const mp::Event&) { ++count; });
+    for (int i = 0; i < 8; ++i) {
+        EXPECT_EQ(bus.publish(mp::Event(mp::EVENT_SEEK)), mp::Result::Success);
+    }
+    EXPECT_EQ(bus.publish(mp::Event(mp::EVENT_SEEK)), mp::Result::Error);
+    EXPECT_EQ(bus.get_stats().dropped, 1u);
+
+    bus.start();
+    ASSERT_TRUE(wait_dispatched(bus, 8));
+    bus.stop();
+    EXPECT_EQ(count, 8);
+}
+
+TEST(EventBusQueueTest, CallbacksMaySubscribe) {
+    EventBus bus;
+    bus.start();
+    std::atomic<int> first{0}, second{0};
+    bus.subscribe(mp::EVENT_TRACK_CHANGED, [&](const mp::Event&) {
+        // Applies from the next batch on; the table in use is not changed
+        if (first++ == 0) {
+            bus.subscribe(mp::EVENT_TRACK_CHANGED, [&](const mp::Event&) { ++second; });
+        }
+    });
+
+    bus.publish(mp::Event(mp::EVENT_TRACK_CHANGED));
+    ASSERT_TRUE(wait_dispatched(bus, 1));
+    bus.publish(mp::Event(mp::EVENT_TRACK_CHANGED));
+    ASSERT_TRUE(wait_dispatched(bus, 2));
+    bus.stop();
+    EXPECT_EQ(first, 2);
+    EXPECT_EQ(second, 1);
+}
+
+TEST(EventBusQueueTest, PublishIsRealtimeSafe) {
+    EventBus bus;
+    int position = 0;
+    bus.subscribe(mp::EVENT_POSITION_CHANGED, [](const mp::Event&) {});
+    bus.start();
+
+    violations = 0;
+    rt::set_violation_handler(count_violation);
+    {
+        rt::RealtimeScope realtime;
+        for (int i = 0; i < 100; ++i) {
+            bus.publish(mp::Event(mp::EVENT_POSITION_CHANGED, &position, sizeof(position)));
+            bus.publish(mp::Event(mp::EVENT_VOLUME_CHANGED));
+        }
+    }
+    rt::set_violation_handler(nullptr);
+    bus.stop();
+    EXPECT_EQ(violations, 0);
+}
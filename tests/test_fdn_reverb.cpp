@@ -0,0 +1,165 @@
+﻿#include "../core/fdn_reverb.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace mp::core;
+
+namespace {
+
+const double SAMPLE_RATE = 48000.0;
+
+// Impulse response of one channel, all channels driven
+std::vector<float> impulse_response(FdnReverb& reverb, size_t frames) {
+    uint16_t channels = reverb.channels();
+    std::vector<float> buffer(frames * channels, 0.0f);
+    for (uint16_t c = 0; c < channels; ++c) {
+        buffer[c] = 1.0f;
+    }
+    reverb.process(buffer.data(), frames);
+    return buffer;
+}
+
+// Mean power of channel 0 over [start, start + length) seconds
+double window_power_db(const std::vector<float>& buffer, uint16_t channels,
+                       double start, double length) {
+    size_t first = static_cast<size_t>(start * SAMPLE_RATE);
+    size_t count = static_cast<size_t>(length * SAMPLE_RATE);
+    double power = 0.0;
+    for (size_t i = first; i < first + count; ++i) {
+        double s = buffer[i * channels];
+        power += s * s;
+    }
+    return 10.0 * std::log10(power / count + 1e-300);
+}
+
+} // namespace
+
+class FdnReverbLines : public ::testing::TestWithParam<int> {};
+
+TEST_P(FdnReverbLines, DecaysAtTheRequestedRate) {
+    FdnReverb reverb;
+    reverb.configure(SAMPLE_RATE, 2, GetParam(), 0.5f);
+    reverb.set_decay(1.0f, 0.0f);
+
+    std::vector<float> response = impulse_response(reverb, static_cast<size_t>(1.5 * SAMPLE_RATE));
+
+    // 60 dB per second, so 30 dB between windows half a second apart
+    double early = window_power_db(response, 2, 0.3, 0.1);
+    double late = window_power_db(response, 2, 0.8, 0.1);
+    EXPECT_NEAR(early - late, 30.0, 4.0);
+}
+
+TEST_P(FdnReverbLines, BlockSizeDoesNotChangeOutput) {
+    FdnReverb whole;
+    FdnReverb pieces;
+    whole.configure(SAMPLE_RATE, 2, GetParam(), 0.3f);
+    pieces.configure(SAMPLE_RATE, 2, GetParam(), 0.3f);
+
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+    std::vector<float> input(2 * 20000);
+    for (float& s : input) {
+        s = dist(gen);
+    }
+
+    std::vector<float> expected(input);
+    whole.process(expected.data(), 20000);
+
+    std::vector<float> output(input);
+    size_t sizes[] = {1, 7, 64, 65, 1000, 3};
+    size_t offset = 0;
+    for (size_t k = 0; offset < 20000; ++k) {
+        size_t count = std::min(sizes[k % 6], size_t(20000) - offset);
+        pieces.process(output.data() + offset * 2, count);
+        offset += count;
+    }
+
+    EXPECT_EQ(output, expected);
+}
+
+INSTANTIATE_TEST_SUITE_P(Sizes, FdnReverbLines, ::testing::Values(8, 16));
+
+TEST(FdnReverbTest, LinesAreMutuallyPrimeAndAtLeastABlock) {
+    FdnReverb reverb;
+    reverb.configure(8000.0, 1, 16, 0.0f);
+    for (size_t i = 0; i < reverb.lines(); ++i) {
+        EXPECT_GE(reverb.delay_length(i), 64u);
+        for (size_t j = 0; j < i; ++j) {
+            size_t a = reverb.delay_length(i);
+            size_t b = reverb.delay_length(j);
+            while (b) {
+                size_t r = a % b;
+                a = b;
+                b = r;
+            }
+            EXPECT_EQ(a, 1u) << i << " " << j;
+        }
+    }
+}
+
+TEST(FdnReverbTest, StereoOutputIsDecorrelated) {
+    FdnReverb reverb;
+    reverb.configure(SAMPLE_RATE, 2, 8, 0.5f);
+    reverb.set_decay(2.0f, 0.3f);
+
+    std::vector<float> response = impulse_response(reverb, static_cast<size_t>(SAMPLE_RATE));
+
+    double ll = 0.0, rr = 0.0, lr = 0.0;
+    for (size_t i = 0; i < response.size() / 2; ++i) {
+        ll += response[2 * i] * response[2 * i];
+        rr += response[2 * i + 1] * response[2 * i + 1];
+        lr += response[2 * i] * response[2 * i + 1];
+    }
+    EXPECT_GT(ll, 0.0);
+    EXPECT_LT(std::fabs(lr) / std::sqrt(ll * rr), 0.3);
+}
+
+TEST(FdnReverbTest, DampingShortensHighFrequencies) {
+    FdnReverb bright;
+    FdnReverb dark;
+    bright.configure(SAMPLE_RATE, 1, 8, 0.5f);
+    dark.configure(SAMPLE_RATE, 1, 8, 0.5f);
+    bright.set_decay(2.0f, 0.0f);
+    dark.set_decay(2.0f, 0.8f);
+
+    // Energy of the first difference tracks the high band
+    auto high_energy = [](const std::vector<float>& r) {
+        double e = 0.0;
+        for (size_t i = static_cast<size_t>(0.2 * SAMPLE_RATE) + 1; i < r.size(); ++i) {
+            double d = r[i] - r[i - 1];
+            e += d * d;
+        }
+        return e;
+    };
+    size_t frames = static_cast<size_t>(SAMPLE_RATE);
+    EXPECT_LT(high_energy(impulse_response(dark, frames)),
+              0.1 * high_energy(impulse_response(bright, frames)));
+}
+
+TEST(FdnReverbTest, TailDecaysToExactSilence) {
+    FdnReverb reverb;
+    reverb.configure(SAMPLE_RATE, 2, 8, 0.5f);
+    reverb.set_decay(0.5f, 0.5f);
+
+    // Far past -600 dB, so only denormal flushing can leave zeros
+    std::vector<float> response = impulse_response(reverb, static_cast<size_t>(12 * SAMPLE_RATE));
+    for (size_t i = response.size() - 4096; i < response.size(); ++i) {
+        ASSERT_EQ(response[i], 0.0f) << "sample " << i;
+    }
+}
+
+TEST(FdnReverbTest, ResetClearsTail) {
+    FdnReverb reverb;
+    reverb.configure(SAMPLE_RATE, 2, 16, 1.0f);
+    reverb.set_decay(5.0f, 0.2f);
+    impulse_response(reverb, 4000);
+
+    reverb.reset();
+    std::vector<float> silence(2 * 10000, 0.0f);
+    reverb.process(silence.data(), 10000);
+    for (float s : silence) {
+        ASSERT_EQ(s, 0.0f);
+    }
+}
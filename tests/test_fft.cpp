@@ -0,0 +1,86 @@
+﻿#include "../core/fft.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace mp::core;
+
+namespace {
+
+std::vector<float> random_signal(size_t size, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> signal(size);
+    for (float& v : signal) {
+        v = dist(gen);
+    }
+    return signal;
+}
+
+} // namespace
+
+TEST(RealFFTTest, MatchesDirectDFT) {
+    for (size_t size : {4u, 8u, 32u, 128u, 512u, 2048u}) {
+        std::vector<float> input = random_signal(size, static_cast<unsigned>(size));
+        RealFFT fft(size);
+        ASSERT_EQ(fft.bins(), size / 2 + 1);
+
+        std::vector<std::complex<float>> output(fft.bins());
+        fft.forward(input.data(), output.data());
+
+        double max_error = 0.0;
+        for (size_t k = 0; k < fft.bins(); ++k) {
+            std::complex<double> sum(0.0, 0.0);
+            for (size_t n = 0; n < size; ++n) {
+                double angle = -2.0 * 3.14159265358979323846 * double(k * n % size) / double(size);
+                sum += double(input[n]) * std::complex<double>(std::cos(angle), std::sin(angle));
+            }
+            max_error = std::max(max_error, std::abs(sum - std::complex<double>(output[k])));
+        }
+        EXPECT_LT(max_error, 1e-4 * std::sqrt(double(size))) << "size " << size;
+    }
+}
+
+TEST(RealFFTTest, InverseRestoresInput) {
+    for (size_t size : {4u, 64u, 1024u, 65536u}) {
+        std::vector<float> input = random_signal(size, 7);
+        RealFFT fft(size);
+
+        std::vector<std::complex<float>> spectrum(fft.bins());
+        std::vector<float> restored(size);
+        fft.forward(input.data(), spectrum.data());
+        fft.inverse(spectrum.data(), restored.data());
+
+        float max_error = 0.0f;
+        for (size_t n = 0; n < size; ++n) {
+            max_error = std::max(max_error, std::abs(restored[n] - input[n]));
+        }
+        EXPECT_LT(max_error, 1e-5f) << "size " << size;
+    }
+}
+
+TEST(RealFFTTest, SineLandsInItsBin) {
+    const size_t size = 1024;
+    std::vector<float> input(size);
+    for (size_t n = 0; n < size; ++n) {
+        input[n] = std::sin(2.0f * 3.14159265f * 37.0f * n / size);
+    }
+
+    RealFFT fft(size);
+    std::vector<float> magnitudes(fft.bins());
+    fft.forward_magnitudes(input.data(), magnitudes.data());
+
+    EXPECT_NEAR(magnitudes[37], size / 2.0f, 0.01f * size);
+    EXPECT_LT(magnitudes[36], 1e-2f);
+    EXPECT_LT(magnitudes[38], 1e-2f);
+}
+
+TEST(FFTPlanTest, PlansAreSharedAndSizesRoundUp) {
+    auto a = FFTPlan::get(4096);
+    auto b = FFTPlan::get(4096);
+    EXPECT_EQ(a.get(), b.get());
+
+    EXPECT_EQ(FFTPlan::get(3000)->size(), 4096u);
+    EXPECT_EQ(RealFFT(1).size(), 4u);
+}
@@ -0,0 +1,96 @@
+﻿#include "../core/gapless_info.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using namespace mp::core;
+
+namespace {
+
+std::string write_temp(const char* name, const std::vector<uint8_t>& data) {
+    std::string path = testing::TempDir() + name;
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(data.data()),
+                                                static_cast<std::streamsize>(data.size()));
+    return path;
+}
+
+// MPEG1 Layer III stereo frame carrying a Xing "Info" tag and a LAME extension
+std::vector<uint8_t> make_lame_mp3(uint32_t frames, uint32_t delay, uint32_t padding) {
+    std::vector<uint8_t> data(417, 0);
+    const uint8_t header[4] = {0xFF, 0xFB, 0x90, 0x64};
+    std::memcpy(data.data(), header, 4);
+
+    size_t xing = 4 + 32;
+    std::memcpy(&data[xing], "Info", 4);
+    data[xing + 7] = 0x0F;
+    data[xing + 8] = static_cast<uint8_t>(frames >> 24);
+    data[xing + 9] = static_cast<uint8_t>(frames >> 16);
+    data[xing + 10] = static_cast<uint8_t>(frames >> 8);
+    data[xing + 11] = static_cast<uint8_t>(frames);
+
+    size_t lame = xing + 8 + 4 + 4 + 100 + 4;
+    std::memcpy(&data[lame], "LAME3.100", 9);
+    uint32_t packed = (delay << 12) | padding;
+    data[lame + 21] = static_cast<uint8_t>(packed >> 16);
+    data[lame + 22] = static_cast<uint8_t>(packed >> 8);
+    data[lame + 23] = static_cast<uint8_t>(packed);
+    return data;
+}
+
+} // namespace
+
+TEST(GaplessInfoTest, ParsesITunSMPB) {
+    GaplessInfo info;
+    ASSERT_TRUE(parse_itunsmpb(" 00000000 00000840 000001C8 00000000000A0000 00000000", info));
+    EXPECT_EQ(info.encoder_delay, 0x840u);
+    EXPECT_EQ(info.encoder_padding, 0x1C8u);
+    EXPECT_EQ(info.total_samples, 0x840u + 0xA0000u + 0x1C8u);
+    EXPECT_TRUE(info.found);
+
+    GaplessInfo bad;
+    EXPECT_FALSE(parse_itunsmpb("00000000 00000840", bad));
+    EXPECT_FALSE(bad.found);
+}
+
+TEST(GaplessInfoTest, ReadsLameTag) {
+    std::string path = write_temp("gapless_lame.mp3", make_lame_mp3(100, 576, 1000));
+
+    GaplessInfo info;
+    ASSERT_TRUE(read_gapless_info(path, info));
+    EXPECT_TRUE(info.found);
+    EXPECT_EQ(info.encoder_delay, 576u + 529u);   // Decoder delay included
+    EXPECT_EQ(info.encoder_padding, 1000u - 529u);
+    EXPECT_EQ(info.total_samples, 100u * 1152u);
+
+    std::remove(path.c_str());
+}
+
+TEST(GaplessInfoTest, ReadsFlacStreamInfo) {
+    std::vector<uint8_t> data(42, 0);
+    std::memcpy(data.data(), "fLaC", 4);
+    data[4] = 0x80;  // Last block, STREAMINFO
+    data[7] = 34;
+    data[8 + 13] = 0x01;  // Upper 4 bits of the 36-bit sample count
+    data[8 + 17] = 0x10;
+    std::string path = write_temp("gapless.flac", data);
+
+    GaplessInfo info;
+    ASSERT_TRUE(read_gapless_info(path, info));
+    EXPECT_EQ(info.total_samples, (1ull << 32) + 0x10);
+    EXPECT_EQ(info.encoder_delay, 0u);
+    EXPECT_EQ(info.encoder_padding, 0u);
+
+    std::remove(path.c_str());
+}
+
+TEST(GaplessInfoTest, RejectsUnknownFormat) {
+    std::string path = write_temp("gapless.bin", std::vector<uint8_t>(64, 0x11));
+
+    GaplessInfo info;
+    EXPECT_FALSE(read_gapless_info(path, info));
+    EXPECT_FALSE(read_gapless_info(path + ".missing", info));
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,105 @@
+﻿#include "../core/level_meter.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+using namespace mp::core;
+
+namespace {
+
+const float PI = 3.14159265358979323846f;
+
+std::vector<float> interleaved_sine(uint16_t channels, size_t frames, float cycles_per_sample,
+                                    float amplitude, float phase = 0.0f) {
+    std::vector<float> samples(frames * channels);
+    for (size_t i = 0; i < frames; ++i) {
+        float s = amplitude * std::sin(2.0f * PI * cycles_per_sample * i + phase);
+        for (uint16_t ch = 0; ch < channels; ++ch) {
+            samples[i * channels + ch] = s * (ch + 1) / channels;
+        }
+    }
+    return samples;
+}
+
+} // namespace
+
+TEST(LevelMeterTest, RmsWindowFollowsSampleRate) {
+    LevelMeter meter;
+    meter.configure(2, 192000, 300.0f);
+
+    // 1 kHz sine at 192 kHz, longer than the window
+    std::vector<float> samples = interleaved_sine(2, 192000, 1000.0f / 192000.0f, 1.0f);
+    meter.process(samples.data(), 192000);
+
+    EXPECT_NEAR(meter.level(0).rms, 0.5f / std::sqrt(2.0f), 1e-3f);
+    EXPECT_NEAR(meter.level(1).rms, 1.0f / std::sqrt(2.0f), 1e-3f);
+}
+
+TEST(LevelMeterTest, RunningSumDoesNotDrift) {
+    LevelMeter meter;
+    meter.configure(1, 48000, 10.0f);
+
+    // Many windows of loud noise-like input, then silence
+    std::vector<float> loud = interleaved_sine(1, 480000, 0.1234f, 1.0f);
+    meter.process(loud.data(), loud.size());
+
+    std::vector<float> silence(480, 0.0f);
+    meter.process(silence.data(), silence.size());
+
+    EXPECT_LT(meter.level(0).rms, 1e-6f);
+}
+
+TEST(LevelMeterTest, TruePeakSeesInterSamplePeaks) {
+    LevelMeter meter;
+    meter.configure(1, 48000, 100.0f);
+
+    // fs/4 sine sampled at 45 degrees: every sample is +-0.707
+    std::vector<float> samples = interleaved_sine(1, 4800, 0.25f, 1.0f, PI / 4.0f);
+    meter.process(samples.data(), samples.size());
+    meter.update_peaks(0.01f);
+
+    ChannelLevel level = meter.level(0);
+    EXPECT_NEAR(level.peak, 0.7071f, 1e-3f);
+    EXPECT_GT(level.true_peak, 0.95f);
+    EXPECT_LT(level.true_peak, 1.05f);
+}
+
+TEST(LevelMeterTest, PeakHoldsThenDecays) {
+    LevelMeter meter;
+    meter.configure(1, 48000, 10.0f);
+    meter.set_peak_ballistics(500.0f, 20.0f);
+
+    float impulse = 1.0f;
+    meter.process(&impulse, 1);
+    meter.update_peaks(0.1f);
+    EXPECT_FLOAT_EQ(meter.level(0).peak, 1.0f);
+
+    // Held for 500 ms
+    for (int i = 0; i < 5; ++i) {
+        meter.update_peaks(0.1f);
+    }
+    EXPECT_FLOAT_EQ(meter.level(0).peak, 1.0f);
+
+    // Then falls at 20 dB/s: 0.5 s later it is 10 dB down
+    for (int i = 0; i < 5; ++i) {
+        meter.update_peaks(0.1f);
+    }
+    EXPECT_NEAR(20.0f * std::log10(meter.level(0).peak), -10.0f, 2.5f);
+}
+
+TEST(LevelMeterTest, MetersEveryChannel) {
+    LevelMeter meter;
+    meter.configure(6, 48000, 100.0f);
+    EXPECT_EQ(meter.channels(), 6u);
+
+    std::vector<float> samples = interleaved_sine(6, 9600, 0.01f, 1.0f);
+    meter.process(samples.data(), 9600);
+    meter.update_peaks(0.02f);
+
+    for (uint16_t ch = 0; ch < 6; ++ch) {
+        float expected = (ch + 1) / 6.0f;
+        EXPECT_NEAR(meter.level(ch).peak, expected, 0.01f) << "channel " << ch;
+        EXPECT_NEAR(meter.level(ch).rms, expected / std::sqrt(2.0f), 0.01f) << "channel " << ch;
+    }
+    EXPECT_EQ(meter.level(6).peak, 0.0f);
+}
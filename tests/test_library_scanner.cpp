@@ -0,0 +1,364 @@
+﻿#include "../core/library_scanner.h"
+#include "../core/event_bus.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace mp;
+using namespace mp::core;
+namespace fs = std::filesystem;
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+void put_le(Bytes& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void put_be(Bytes& out, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void put_str(Bytes& out, const std::string& s) {
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+// STREAMINFO, a PADDING block and VORBIS_COMMENT; no audio frames
+Bytes make_flac(uint32_t rate, uint16_t channels, uint16_t bits, uint64_t total,
+                const std::vector<std::string>& comments) {
+    Bytes out;
+    put_str(out, "fLaC");
+    out.push_back(0);
+    put_be(out, 34, 3);
+    put_be(out, 4096, 2);
+    put_be(out, 4096, 2);
+    put_be(out, 0, 3);
+    put_be(out, 0, 3);
+    out.push_back(static_cast<uint8_t>(rate >> 12));
+    out.push_back(static_cast<uint8_t>(rate >> 4));
+    out.push_back(static_cast<uint8_t>(((rate & 0xF) << 4) | ((channels - 1) << 1) | ((bits - 1) >> 4)));
+    out.push_back(static_cast<uint8_t>((((bits - 1) & 0xF) << 4) | ((total >> 32) & 0xF)));
+    put_be(out, total & 0xFFFFFFFF, 4);
+    out.insert(out.end(), 16, 0);               // MD5
+
+    out.push_back(1);
+    put_be(out, 10, 3);
+    out.insert(out.end(), 10, 0);
+
+    Bytes block;
+    put_le(block, 6, 4);
+    put_str(block, "vendor");
+    put_le(block, comments.size(), 4);
+    for (const std::string& c : comments) {
+        put_le(block, c.size(), 4);
+        put_str(block, c);
+    }
+    out.push_back(0x80 | 4);
+    put_be(out, block.size(), 3);
+    out.insert(out.end(), block.begin(), block.end());
+    return out;
+}
+
+Bytes make_wav(uint32_t rate, uint16_t channels, uint32_t frames) {
+    Bytes out;
+    put_str(out, "RIFF");
+    put_le(out, 36 + frames * channels * 2, 4);
+    put_str(out, "WAVE");
+    put_str(out, "fmt ");
+    put_le(out, 16, 4);
+    put_le(out, 1, 2);
+    put_le(out, channels, 2);
+    put_le(out, rate, 4);
+    put_le(out, rate * channels * 2, 4);
+    put_le(out, channels * 2, 2);
+    put_le(out, 16, 2);
+    put_str(out, "data");
+    put_le(out, frames * channels * 2, 4);
+    out.insert(out.end(), frames * channels * 2, 0);
+    return out;
+}
+
+void put_id3_frame(Bytes& tag, const char* id, const Bytes& body) {
+    put_str(tag, id);
+    put_be(tag, body.size(), 4);
+    put_be(tag, 0, 2);
+    tag.insert(tag.end(), body.begin(), body.end());
+}
+
+// ID3v2.3 with a UTF-16 title and a Latin-1 artist, then CBR 128 kbps
+// MPEG-1 Layer III frames at 44.1 kHz
+Bytes make_mp3(size_t frames) {
+    Bytes tag;
+    Bytes title = {1, 0xFF, 0xFE};
+    for (char16_t c : std::u16string(u"Café ♫")) put_le(title, c, 2);
+    put_le(title, 0, 2);
+    put_id3_frame(tag, "TIT2", title);
+    Bytes artist = {0};
+    put_str(artist, "M\xfcller");
+    put_id3_frame(tag, "TPE1", artist);
+
+    Bytes out;
+    put_str(out, "ID3");
+    out.push_back(3);
+    out.push_back(0);
+    out.push_back(0);
+    const uint32_t size = static_cast<uint32_t>(tag.size());
+    for (int shift = 21; shift >= 0; shift -= 7) out.push_back((size >> shift) & 0x7F);
+    out.insert(out.end(), tag.begin(), tag.end());
+
+    for (size_t i = 0; i < frames; ++i) {
+        Bytes frame = {0xFF, 0xFB, 0x90, 0x00};     // 128 kbps, 44100, stereo
+        frame.resize(417, 0);
+        out.insert(out.end(), frame.begin(), frame.end());
+    }
+    return out;
+}
+
+void write_file(const fs::path& path, const Bytes& contents) {
+    fs::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+}
+
+class LibraryScannerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        static int counter = 0;
+        root_ = fs::path(::testing::TempDir()) / ("library_scanner_" + std::to_string(counter++));
+        fs::remove_all(root_);
+        fs::create_directories(root_);
+        db_path_ = (root_.string() + ".db");
+        std::remove(db_path_.c_str());
+        ASSERT_TRUE(store_.open(db_path_));
+    }
+    void TearDown() override {
+        store_.close();
+        fs::remove_all(root_);
+        std::remove(db_path_.c_str());
+    }
+
+    fs::path root_;
+    std::string db_path_;
+    MetadataStore store_;
+};
+
+} // namespace
+
+TEST(TrackMetadataTest, ReadsFlacStreamInfoAndComments) {
+    fs::path path = fs::path(::testing::TempDir()) / "track_metadata.flac";
+    write_file(path, make_flac(96000, 2, 24, 960000,
+                               {"TITLE=Song", "ARTIST=One", "ARTIST=Two", "TRACKNUMBER=3", "AlbumArtist=Band"}));
+
+    TrackMetadata track;
+    ASSERT_TRUE(read_track_metadata(path.string(), track));
+    EXPECT_EQ(track.sample_rate, 96000u);
+    EXPECT_EQ(track.channels, 2u);
+    EXPECT_EQ(track.bits_per_sample, 24u);
+    EXPECT_EQ(track.total_samples, 960000u);
+    EXPECT_EQ(track.duration_ms, 10000u);
+    ASSERT_NE(track.find("title"), nullptr);
+    EXPECT_EQ(*track.find("title"), "Song");
+    EXPECT_EQ(*track.find("track_number"), "3");
+    EXPECT_EQ(*track.find("album_artist"), "Band");
+    int artists = 0;
+    for (const auto& tag : track.tags) artists += tag.first == "artist";
+    EXPECT_EQ(artists, 2);
+    EXPECT_EQ(track.stats.size, fs::file_size(path));
+    fs::remove(path);
+}
+
+TEST(TrackMetadataTest, ReadsId3TextAndEstimatesCbrLength) {
+    fs::path path = fs::path(::testing::TempDir()) / "track_metadata.mp3";
+    write_file(path, make_mp3(200));
+
+    TrackMetadata track;
+    ASSERT_TRUE(read_track_metadata(path.string(), track));
+    EXPECT_EQ(track.sample_rate, 44100u);
+    EXPECT_EQ(track.channels, 2u);
+    ASSERT_NE(track.find("title"), nullptr);
+    EXPECT_EQ(*track.find("title"), "Caf\xc3\xa9 \xe2\x99\xab");
+    EXPECT_EQ(*track.find("artist"), "M\xc3\xbcller");
+    // 200 unpadded frames at 128 kbps: within a frame of 200 * 1152 samples
+    EXPECT_NEAR(static_cast<double>(track.total_samples), 200.0 * 1152, 1152.0);
+    fs::remove(path);
+}
+
+TEST(TrackMetadataTest, RejectsUnknownFiles) {
+    fs::path path = fs::path(::testing::TempDir()) / "track_metadata.txt";
+    write_file(path, Bytes{'h', 'e', 'l', 'l', 'o'});
+    TrackMetadata track;
+    EXPECT_FALSE(read_track_metadata(path.string(), track));
+    EXPECT_FALSE(read_track_metadata((fs::path(::testing::TempDir()) / "missing.flac").string(), track));
+    fs::remove(path);
+}
+
+TEST_F(LibraryScannerTest, RescanOnlyReadsChangedFiles) {
+    for (int album = 0; album < 4; ++album) {
+        for (int t = 0; t < 5; ++t) {
+            fs::path dir = root_ / ("artist" + std::to_string(album % 2)) / ("album" + std::to_string(album));
+            write_file(dir / ("t" + std::to_string(t) + ".flac"),
+                       make_flac(44100, 2, 16, 44100 * (t + 1), {"TITLE=t" + std::to_string(t)}));
+        }
+    }
+    write_file(root_ / "loose.wav", make_wav(48000, 1, 4800));
+    write_file(root_ / "cover.jpg", Bytes(16, 0));
+    write_file(root_ / "broken.flac", Bytes{'j', 'u', 'n', 'k'});
+
+    ScanOptions options;
+    options.walker_threads = 3;
+    options.reader_threads = 4;
+    options.queue_capacity = 2;
+
+    std::atomic<int> reads(0);
+    LibraryScanner scanner(store_);
+    scanner.set_options(options);
+    scanner.set_tag_reader([&](const std::string& path, TrackMetadata& out) {
+        ++reads;
+        return read_track_metadata(path, out);
+    });
+
+    ScanStats first = scanner.scan({root_.string()});
+    EXPECT_EQ(first.seen, 22u);
+    EXPECT_EQ(first.read, 21u);
+    EXPECT_EQ(first.failed, 1u);
+    EXPECT_EQ(first.unchanged, 0u);
+    EXPECT_EQ(store_.size(), 21u);
+
+    TrackMetadata wav;
+    ASSERT_TRUE(store_.get((root_ / "loose.wav").string(), wav));
+    EXPECT_EQ(wav.sample_rate, 48000u);
+    EXPECT_EQ(wav.total_samples, 4800u);
+
+    // Nothing changed: no tag reads
+    reads = 0;
+    ScanStats second = scanner.scan({root_.string()});
+    EXPECT_EQ(second.unchanged, 21u);
+    EXPECT_EQ(second.read, 0u);
+    EXPECT_EQ(reads.load(), 1);                 // Only the unreadable file again
+
+    // One file rewritten, one deleted
+    fs::path changed = root_ / "artist0" / "album0" / "t0.flac";
+    write_file(changed, make_flac(44100, 2, 16, 88200, {"TITLE=new"}));
+    fs::last_write_time(changed, fs::last_write_time(changed) + std::chrono::seconds(5));
+    fs::remove(root_ / "artist1" / "album1" / "t4.flac");
+
+    reads = 0;
+    ScanStats third = scanner.scan({root_.string()});
+    EXPECT_EQ(third.read, 1u);
+    EXPECT_EQ(third.removed, 1u);
+    EXPECT_EQ(third.unchanged, 19u);
+    EXPECT_EQ(store_.size(), 20u);
+
+    TrackMetadata track;
+    ASSERT_TRUE(store_.get(changed.string(), track));
+    EXPECT_EQ(*track.find("title"), "new");
+}
+
+TEST_F(LibraryScannerTest, StorePersistsAcrossScanners) {
+    write_file(root_ / "a" / "x.flac", make_flac(44100, 2, 16, 44100, {"TITLE=x"}));
+    write_file(root_ / "b" / "y.flac", make_flac(44100, 2, 16, 44100, {"TITLE=y"}));
+    {
+        LibraryScanner scanner(store_);
+        EXPECT_EQ(scanner.scan({root_.string()}).read, 2u);
+    }
+    store_.close();
+    ASSERT_TRUE(store_.open(db_path_));
+
+    LibraryScanner scanner(store_);
+    ScanStats stats = scanner.scan({(root_ / "a").string(), (root_ / "b").string()});
+    EXPECT_EQ(stats.unchanged, 2u);
+    EXPECT_EQ(stats.read, 0u);
+}
+
+TEST_F(LibraryScannerTest, RemovesOnlyUnderScannedRoots) {
+    write_file(root_ / "a" / "x.flac", make_flac(44100, 2, 16, 44100, {}));
+    write_file(root_ / "b" / "y.flac", make_flac(44100, 2, 16, 44100, {}));
+    LibraryScanner scanner(store_);
+    scanner.scan({root_.string()});
+    ASSERT_EQ(store_.size(), 2u);
+
+    // b/ is not scanned, so its entry stays
+    fs::remove(root_ / "a" / "x.flac");
+    ScanStats stats = scanner.scan({(root_ / "a").string()});
+    EXPECT_EQ(stats.removed, 1u);
+    EXPECT_EQ(store_.size(), 1u);
+}
+
+TEST_F(LibraryScannerTest, KeepsEntriesOfUnreadableDirectories) {
+    write_file(root_ / "a" / "x.flac", make_flac(44100, 2, 16, 44100, {}));
+    write_file(root_ / "b" / "y.flac", make_flac(44100, 2, 16, 44100, {}));
+    write_file(root_ / "b" / "c" / "z.flac", make_flac(44100, 2, 16, 44100, {}));
+    LibraryScanner scanner(store_);
+    scanner.scan({root_.string()});
+    ASSERT_EQ(store_.size(), 3u);
+
+    fs::permissions(root_ / "b", fs::perms::none);
+    std::error_code ec;
+    fs::directory_iterator probe(root_ / "b", ec);
+    if (!ec) {
+        fs::permissions(root_ / "b", fs::perms::owner_all);
+        GTEST_SKIP() << "permissions are not enforced for this user";
+    }
+    fs::remove(root_ / "a" / "x.flac");
+    ScanStats stats = scanner.scan({root_.string()});
+    fs::permissions(root_ / "b", fs::perms::owner_all);
+
+    // b/ and everything under it stay; a/x.flac is really gone
+    EXPECT_EQ(stats.unlisted, 1u);
+    EXPECT_EQ(stats.removed, 1u);
+    EXPECT_EQ(store_.size(), 2u);
+
+    stats = scanner.scan({root_.string()});
+    EXPECT_EQ(stats.unlisted, 0u);
+    EXPECT_EQ(stats.unchanged, 2u);
+}
+
+TEST_F(LibraryScannerTest, PublishesLibraryUpdated) {
+    write_file(root_ / "x.flac", make_flac(44100, 2, 16, 44100, {}));
+
+    EventBus bus;
+    ScanStats published;
+    int events = 0;
+    bus.subscribe(EVENT_LIBRARY_UPDATED, [&](const Event& event) {
+        ASSERT_EQ(event.data_size, sizeof(ScanStats));
+        published = *static_cast<const ScanStats*>(event.data);
+        ++events;
+    });
+
+    LibraryScanner scanner(store_, &bus);
+    scanner.scan({root_.string()});
+    EXPECT_EQ(events, 1);
+    EXPECT_EQ(published.read, 1u);
+    EXPECT_FALSE(published.cancelled);
+}
+
+TEST_F(LibraryScannerTest, CancelStopsWithoutRemoving) {
+    for (int i = 0; i < 50; ++i) {
+        write_file(root_ / ("t" + std::to_string(i) + ".flac"), make_flac(44100, 2, 16, 44100, {}));
+    }
+    LibraryScanner scanner(store_);
+    scanner.scan({root_.string()});
+    ASSERT_EQ(store_.size(), 50u);
+
+    fs::remove(root_ / "t0.flac");
+    ScanOptions options;
+    options.walker_threads = 1;
+    options.reader_threads = 1;
+    options.queue_capacity = 1;
+    scanner.set_options(options);
+    scanner.set_tag_reader([&](const std::string&, TrackMetadata&) {
+        scanner.cancel();
+        return false;
+    });
+    fs::last_write_time(root_ / "t1.flac", fs::last_write_time(root_ / "t1.flac") + std::chrono::seconds(5));
+
+    ScanStats stats = scanner.scan({root_.string()});
+    EXPECT_TRUE(stats.cancelled);
+    EXPECT_EQ(stats.removed, 0u);
+    EXPECT_EQ(store_.size(), 50u);
+}
@@ -0,0 +1,160 @@
+﻿#include "../core/metadata_store.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+using namespace mp;
+using namespace mp::core;
+
+namespace {
+
+class MetadataStoreTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        static int counter = 0;
+        path_ = ::testing::TempDir() + "metadata_store_" + std::to_string(counter++) + ".db";
+        std::remove(path_.c_str());
+    }
+    void TearDown() override { std::remove(path_.c_str()); }
+
+    std::string path_;
+};
+
+TrackMetadata make_track(const std::string& path, uint64_t size, const std::string& title) {
+    TrackMetadata track;
+    track.path = path;
+    track.stats.size = size;
+    track.stats.mtime_ns = 1700000000123456789;
+    track.sample_rate = 44100;
+    track.channels = 2;
+    track.bits_per_sample = 16;
+    track.total_samples = 441000;
+    track.duration_ms = 10000;
+    track.add("title", title);
+    track.add("artist", "A");
+    track.add("artist", "B");
+    return track;
+}
+
+} // namespace
+
+TEST_F(MetadataStoreTest, EntriesSurviveReopen) {
+    {
+        MetadataStore store;
+        ASSERT_TRUE(store.open(path_));
+        ASSERT_TRUE(store.put(make_track("/music/a.flac", 100, "One")));
+        ASSERT_TRUE(store.put(make_track("/music/b.flac", 200, "Two")));
+        ASSERT_TRUE(store.commit());
+    }
+
+    MetadataStore store;
+    ASSERT_TRUE(store.open(path_));
+    EXPECT_EQ(store.size(), 2u);
+
+    TrackMetadata track;
+    ASSERT_TRUE(store.get("/music/b.flac", track));
+    EXPECT_EQ(track.stats.size, 200u);
+    EXPECT_EQ(track.stats.mtime_ns, 1700000000123456789);
+    EXPECT_EQ(track.sample_rate, 44100u);
+    EXPECT_EQ(track.total_samples, 441000u);
+    ASSERT_EQ(track.tags.size(), 3u);
+    EXPECT_EQ(*track.find("title"), "Two");
+    EXPECT_EQ(track.tags[2].second, "B");
+}
+
+TEST_F(MetadataStoreTest, LookupRequiresMatchingStats) {
+    MetadataStore store;
+    ASSERT_TRUE(store.open(path_));
+    TrackMetadata stored = make_track("/music/a.flac", 100, "One");
+    ASSERT_TRUE(store.put(stored));
+
+    TrackMetadata track;
+    EXPECT_TRUE(store.lookup("/music/a.flac", stored.stats, track));
+    EXPECT_TRUE(store.is_current("/music/a.flac", stored.stats));
+
+    FileStats changed = stored.stats;
+    changed.mtime_ns += 1;
+    EXPECT_FALSE(store.lookup("/music/a.flac", changed, track));
+    changed = stored.stats;
+    changed.size += 1;
+    EXPECT_FALSE(store.is_current("/music/a.flac", changed));
+    EXPECT_FALSE(store.is_current("/music/missing.flac", stored.stats));
+}
+
+TEST_F(MetadataStoreTest, TornTailIsDiscarded) {
+    {
+        MetadataStore store;
+        ASSERT_TRUE(store.open(path_));
+        ASSERT_TRUE(store.put(make_track("/music/a.flac", 100, "One")));
+        ASSERT_TRUE(store.put(make_track("/music/b.flac", 200, "Two")));
+        ASSERT_TRUE(store.commit());
+    }
+    // A crash mid-append leaves part of the last record
+    const uintmax_t full = std::filesystem::file_size(path_);
+    std::filesystem::resize_file(path_, full - 5);
+
+    {
+        MetadataStore store;
+        ASSERT_TRUE(store.open(path_));
+        EXPECT_EQ(store.size(), 1u);
+        TrackMetadata track;
+        EXPECT_TRUE(store.get("/music/a.flac", track));
+        EXPECT_FALSE(store.get("/music/b.flac", track));
+
+        // Appends continue after the last good record
+        ASSERT_TRUE(store.put(make_track("/music/c.flac", 300, "Three")));
+        ASSERT_TRUE(store.commit());
+    }
+
+    MetadataStore store;
+    ASSERT_TRUE(store.open(path_));
+    EXPECT_EQ(store.size(), 2u);
+    TrackMetadata track;
+    EXPECT_TRUE(store.get("/music/c.flac", track));
+}
+
+TEST_F(MetadataStoreTest, EraseAndCompact) {
+    MetadataStore store;
+    ASSERT_TRUE(store.open(path_));
+    for (int i = 0; i < 50; ++i) {
+        ASSERT_TRUE(store.put(make_track("/music/a.flac", 100 + i, "One")));
+    }
+    ASSERT_TRUE(store.put(make_track("/music/b.flac", 200, "Two")));
+    ASSERT_TRUE(store.erase("/music/b.flac"));
+    EXPECT_EQ(store.size(), 1u);
+    EXPECT_EQ(store.dead_records(), 51u);
+
+    const uintmax_t before = std::filesystem::file_size(path_);
+    ASSERT_TRUE(store.compact());
+    EXPECT_EQ(store.dead_records(), 0u);
+    EXPECT_LT(std::filesystem::file_size(path_), before / 10);
+
+    ASSERT_TRUE(store.put(make_track("/music/c.flac", 300, "Three")));
+    ASSERT_TRUE(store.commit());
+    store.close();
+
+    ASSERT_TRUE(store.open(path_));
+    EXPECT_EQ(store.size(), 2u);
+    TrackMetadata track;
+    ASSERT_TRUE(store.get("/music/a.flac", track));
+    EXPECT_EQ(track.stats.size, 149u);
+    EXPECT_FALSE(store.get("/music/b.flac", track));
+}
+
+TEST_F(MetadataStoreTest, ForeignFileIsReplaced) {
+    FILE* file = std::fopen(path_.c_str(), "wb");
+    std::fputs("not a library", file);
+    std::fclose(file);
+
+    MetadataStore store;
+    ASSERT_TRUE(store.open(path_));
+    EXPECT_EQ(store.size(), 0u);
+    // The old file is kept beside the new store
+    EXPECT_EQ(std::filesystem::file_size(path_ + ".bad"), 13u);
+    ASSERT_TRUE(store.put(make_track("/music/a.flac", 100, "One")));
+    ASSERT_TRUE(store.commit());
+    store.close();
+    ASSERT_TRUE(store.open(path_));
+    EXPECT_EQ(store.size(), 1u);
+}
@@ -0,0 +1,238 @@
+﻿#include "../plugins/decoders/mp3_decoder_impl.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace xpumusic::plugins;
+
+namespace {
+
+// MPEG-1 layer III, 128 kbps, 44.1 kHz, stereo: 417 bytes, 1152 samples
+const uint8_t FRAME_HEADER[4] = {0xFF, 0xFB, 0x90, 0x00};
+const uint32_t FRAME_BYTES = 417;
+const uint32_t FRAME_SAMPLES = 1152;
+const uint32_t RATE = 44100;
+
+// MSB-first writer for side information
+struct BitWriter {
+    uint8_t* data;
+    size_t bit = 0;
+
+    void put(uint32_t value, int bits) {
+        for (int i = bits - 1; i >= 0; --i, ++bit) {
+            uint8_t mask = static_cast<uint8_t>(0x80 >> (bit & 7));
+            if ((value >> i) & 1) {
+                data[bit >> 3] |= mask;
+            } else {
+                data[bit >> 3] &= static_cast<uint8_t>(~mask);
+            }
+        }
+    }
+};
+
+// Frames of noise: valid long-block side information and random Huffman
+// data, so every frame decodes to distinct samples. Frames listed in
+// mono_frames are single channel. With reservoir, each frame's main data
+// starts as far back in the earlier frames' unused bytes as it can, the
+// 511 byte maximum once enough has built up, as encoders do.
+std::vector<uint8_t> make_stream(size_t frames, uint32_t seed = 1,
+                                 const std::vector<size_t>& mono_frames = {},
+                                 bool reservoir = false) {
+    const uint32_t PART2_3_BITS = 700;
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(frames * FRAME_BYTES);
+    uint32_t unused = 0;  // Main data bytes left over by the frames so far
+    for (size_t f = 0; f < frames; ++f) {
+        bool mono = std::find(mono_frames.begin(), mono_frames.end(), f) != mono_frames.end();
+        uint8_t* frame = &data[f * FRAME_BYTES];
+        std::memcpy(frame, FRAME_HEADER, 4);
+        if (mono) {
+            frame[3] |= 0xC0;  // Channel mode: single channel
+        }
+        for (uint32_t i = 4; i < FRAME_BYTES; ++i) {
+            frame[i] = static_cast<uint8_t>(rng());
+        }
+        const uint32_t channels = mono ? 1 : 2;
+        const uint32_t side_bytes = mono ? 17 : 32;
+        uint32_t main_data_begin = reservoir ? std::min(unused, 511u) : 0;
+        unused = main_data_begin + (FRAME_BYTES - 4 - side_bytes) - 2 * channels * PART2_3_BITS / 8;
+
+        BitWriter side{frame + 4};
+        side.put(main_data_begin, 9);
+        side.put(0, mono ? 5 : 3);      // private bits
+        side.put(0, mono ? 4 : 8);      // scfsi
+        for (int granule = 0; granule < 2; ++granule) {
+            for (uint32_t channel = 0; channel < channels; ++channel) {
+                side.put(PART2_3_BITS, 12);     // part2_3_length
+                side.put(150, 9);               // big_values
+                side.put(170 + rng() % 20, 8);  // global_gain
+                side.put(rng() % 16, 4);        // scalefac_compress
+                side.put(0, 1);                 // Long blocks
+                for (int region = 0; region < 3; ++region) {
+                    side.put(1 + rng() % 13, 5);
+                }
+                side.put(rng() % 16, 4);
+                side.put(rng() % 8, 3);
+                side.put(0, 3);                 // preflag, scalefac_scale, count1 table
+            }
+        }
+    }
+    return data;
+}
+
+class MP3DecoderTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir_ = std::filesystem::temp_directory_path() /
+               ("xpumusic_mp3_test_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()));
+        std::filesystem::create_directories(dir_);
+        // Keep seek index caches out of the user's cache directory
+#ifdef _WIN32
+        _putenv_s("XPUMUSIC_CACHE_DIR", dir_.string().c_str());
+#else
+        setenv("XPUMUSIC_CACHE_DIR", dir_.string().c_str(), 1);
+#endif
+        media_path_ = (dir_ / "track.mp3").string();
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        std::filesystem::remove_all(dir_, ec);
+    }
+
+    void write_media(const std::vector<uint8_t>& data) {
+        FILE* f = fopen(media_path_.c_str(), "wb");
+        ASSERT_NE(f, nullptr);
+        fwrite(data.data(), 1, data.size(), f);
+        fclose(f);
+    }
+
+    // Without a Xing header the exact length and index come from a
+    // background scan of the frame headers
+    static bool wait_for_length(MP3Decoder& decoder, int64_t length) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (decoder.get_length() != length) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    // Interleaved samples of up to count frames, or until the end
+    static std::vector<float> decode_some(MP3Decoder& decoder, size_t count = SIZE_MAX) {
+        std::vector<float> out;
+        xpumusic::AudioBuffer buffer;
+        size_t decoded = 0;
+        int frames;
+        while (decoded < count &&
+               (frames = decoder.decode(buffer, static_cast<int>(std::min<size_t>(count - decoded, 1000)))) > 0) {
+            const float* data = static_cast<const float*>(buffer.data);
+            out.insert(out.end(), data, data + frames * buffer.channels);
+            decoded += frames;
+        }
+        return out;
+    }
+
+    // Seeks across the written stream land on the sample asked for
+    void expect_seeks_decode_target(size_t frames) {
+        MP3Decoder decoder;
+        ASSERT_TRUE(decoder.initialize());
+        ASSERT_TRUE(decoder.open(media_path_));
+        ASSERT_TRUE(wait_for_length(decoder, frames * FRAME_SAMPLES));
+        std::vector<float> reference = decode_some(decoder);
+        ASSERT_EQ(reference.size(), frames * FRAME_SAMPLES * 2);
+
+        for (int64_t target : {int64_t(0), int64_t(1), int64_t(1151), int64_t(1152), int64_t(5000),
+                               int64_t(20 * FRAME_SAMPLES), int64_t(20 * FRAME_SAMPLES + 77),
+                               int64_t(35 * FRAME_SAMPLES + 1000)}) {
+            ASSERT_TRUE(decoder.seek(target));
+            EXPECT_EQ(decoder.get_position(), target);
+            std::vector<float> decoded = decode_some(decoder, 64);
+            ASSERT_EQ(decoded.size(), 64u * 2) << "seek to " << target;
+            for (size_t i = 0; i < decoded.size(); ++i) {
+                ASSERT_EQ(decoded[i], reference[target * 2 + i]) << "seek to " << target << ", value " << i;
+            }
+        }
+    }
+
+    std::filesystem::path dir_;
+    std::string media_path_;
+};
+
+} // namespace
+
+TEST_F(MP3DecoderTest, SeekToSampleDecodesThatSample) {
+    write_media(make_stream(40));
+    expect_seeks_decode_target(40);
+}
+
+TEST_F(MP3DecoderTest, SeekWithBitReservoirDecodesThatSample) {
+    // Frames from the 17th on reach 511 bytes back: one pre-roll frame
+    // decodes to nothing and cannot refill the reservoir by itself
+    write_media(make_stream(40, 2, {}, true));
+    expect_seeks_decode_target(40);
+}
+
+TEST_F(MP3DecoderTest, SeekInSecondsRoundsToTheNearestSample) {
+    write_media(make_stream(40));
+
+    MP3Decoder decoder;
+    ASSERT_TRUE(decoder.initialize());
+    ASSERT_TRUE(decoder.open(media_path_));
+    ASSERT_TRUE(wait_for_length(decoder, 40 * FRAME_SAMPLES));
+    // Some of these products come out just below the whole sample
+    for (int64_t target = 1; target < 3000; ++target) {
+        ASSERT_TRUE(decoder.seek(static_cast<double>(target) / RATE));
+        ASSERT_EQ(decoder.get_position(), target);
+    }
+}
+
+TEST_F(MP3DecoderTest, LengthWithoutHeaderIsEstimatedUntilScanned) {
+    const int64_t exact = 200 * FRAME_SAMPLES;
+    write_media(make_stream(200));
+
+    // These frames are never padded, so the bitrate estimate runs short
+    MP3Decoder decoder;
+    ASSERT_TRUE(decoder.initialize());
+    ASSERT_TRUE(decoder.open(media_path_));
+    EXPECT_NEAR(static_cast<double>(decoder.get_length()), static_cast<double>(exact), exact * 0.01);
+    ASSERT_TRUE(wait_for_length(decoder, exact));
+    EXPECT_DOUBLE_EQ(decoder.get_duration(), static_cast<double>(exact) / RATE);
+    decoder.close();
+
+    // The scan was cached: the next open knows the exact length at once
+    ASSERT_TRUE(decoder.open(media_path_));
+    EXPECT_EQ(decoder.get_length(), exact);
+}
+
+TEST_F(MP3DecoderTest, MonoFramesInAStereoStreamAreKept) {
+    const size_t frames = 20;
+    write_media(make_stream(frames, 3, {8, 9}));
+
+    MP3Decoder decoder;
+    ASSERT_TRUE(decoder.initialize());
+    ASSERT_TRUE(decoder.open(media_path_));
+    ASSERT_EQ(decoder.get_format().channels, 2);
+    std::vector<float> decoded = decode_some(decoder);
+    ASSERT_EQ(decoded.size(), frames * FRAME_SAMPLES * 2);
+
+    // The mono frames play on both channels
+    bool audible = false;
+    for (size_t i = 8 * FRAME_SAMPLES; i < 10 * FRAME_SAMPLES; ++i) {
+        ASSERT_EQ(decoded[i * 2], decoded[i * 2 + 1]) << "sample " << i;
+        audible |= decoded[i * 2] != 0.0f;
+    }
+    EXPECT_TRUE(audible);
+    EXPECT_NE(decoded[2 * FRAME_SAMPLES * 2], decoded[2 * FRAME_SAMPLES * 2 + 1]);
+}
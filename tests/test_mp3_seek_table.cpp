@@ -0,0 +1,234 @@
+﻿#include "../plugins/decoders/mp3_seek_table.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace xpumusic::plugins;
+
+namespace {
+
+// MPEG-1 layer III, 128 kbps, 44.1 kHz, stereo: 417 bytes, 1152 samples
+const uint8_t FRAME_HEADER[4] = {0xFF, 0xFB, 0x90, 0x00};
+const uint32_t FRAME_BYTES = 417;
+const uint32_t FRAME_SAMPLES = 1152;
+
+void append_frame(std::vector<uint8_t>& data) {
+    size_t start = data.size();
+    data.resize(start + FRAME_BYTES, 0);
+    std::memcpy(&data[start], FRAME_HEADER, 4);
+}
+
+// Xing tag frame with frame count, byte count and a linear TOC
+void append_xing_frame(std::vector<uint8_t>& data, uint32_t frames, uint32_t bytes) {
+    size_t start = data.size();
+    append_frame(data);
+    uint8_t* xing = &data[start + 4 + 32];
+    std::memcpy(xing, "Xing", 4);
+    xing[7] = 0x07;
+    for (int i = 0; i < 4; ++i) {
+        xing[8 + i] = static_cast<uint8_t>(frames >> (24 - 8 * i));
+        xing[12 + i] = static_cast<uint8_t>(bytes >> (24 - 8 * i));
+    }
+    for (int i = 0; i < 100; ++i) {
+        xing[16 + i] = static_cast<uint8_t>(i * 256 / 100);
+    }
+}
+
+class MP3SeekTableTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir_ = std::filesystem::temp_directory_path() /
+               ("xpumusic_seek_test_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()));
+        std::filesystem::create_directories(dir_);
+        media_path_ = (dir_ / "track.mp3").string();
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        std::filesystem::remove_all(dir_, ec);
+    }
+
+    void write_media(const std::vector<uint8_t>& data) {
+        FILE* f = fopen(media_path_.c_str(), "wb");
+        ASSERT_NE(f, nullptr);
+        fwrite(data.data(), 1, data.size(), f);
+        fclose(f);
+    }
+
+    bool scan(MP3SeekTable& table, uint64_t start, uint64_t end) {
+        FILE* f = fopen(media_path_.c_str(), "rb");
+        std::atomic<bool> cancel{false};
+        bool ok = table.build_from_scan(f, start, end, cancel);
+        fclose(f);
+        return ok;
+    }
+
+    std::filesystem::path dir_;
+    std::string media_path_;
+};
+
+} // namespace
+
+TEST(MP3FrameHeaderTest, ParsesLayer3Header) {
+    MP3FrameHeader header;
+    ASSERT_TRUE(parse_mp3_frame_header(FRAME_HEADER, header));
+    EXPECT_EQ(header.frame_bytes, FRAME_BYTES);
+    EXPECT_EQ(header.samples, FRAME_SAMPLES);
+    EXPECT_EQ(header.sample_rate, 44100u);
+    EXPECT_EQ(header.channels, 2);
+    EXPECT_EQ(header.layer, 3);
+
+    const uint8_t reserved_rate[4] = {0xFF, 0xFB, 0x9C, 0x00};
+    EXPECT_FALSE(parse_mp3_frame_header(reserved_rate, header));
+}
+
+TEST_F(MP3SeekTableTest, ScanSkipsTagFrameAndGarbage) {
+    std::vector<uint8_t> data;
+    append_xing_frame(data, 10, 11 * FRAME_BYTES);
+    for (int i = 0; i < 5; ++i) {
+        append_frame(data);
+    }
+    data.insert(data.end(), {0x12, 0x34, 0xFF});  // Junk between frames
+    for (int i = 0; i < 5; ++i) {
+        append_frame(data);
+    }
+    write_media(data);
+
+    MP3SeekTable table;
+    ASSERT_TRUE(scan(table, 0, data.size()));
+    EXPECT_TRUE(table.is_exact());
+    EXPECT_EQ(table.size(), 10u);
+    EXPECT_EQ(table.total_samples(), 10u * FRAME_SAMPLES);
+
+    MP3SeekPoint point;
+    ASSERT_TRUE(table.lookup(0, point));
+    EXPECT_EQ(point.offset, FRAME_BYTES);
+
+    // Sixth audio frame starts after the junk
+    ASSERT_TRUE(table.lookup(5 * FRAME_SAMPLES + 10, point));
+    EXPECT_EQ(point.sample, 5u * FRAME_SAMPLES);
+    EXPECT_EQ(point.offset, 6u * FRAME_BYTES + 3);
+}
+
+TEST_F(MP3SeekTableTest, PrerollStepsBackOneFrame) {
+    std::vector<uint8_t> data;
+    for (int i = 0; i < 8; ++i) {
+        append_frame(data);
+    }
+    write_media(data);
+
+    MP3SeekTable table;
+    ASSERT_TRUE(scan(table, 0, data.size()));
+
+    MP3SeekPoint point;
+    ASSERT_TRUE(table.lookup_with_preroll(3 * FRAME_SAMPLES + 100, point));
+    EXPECT_EQ(point.sample, 2u * FRAME_SAMPLES);
+    EXPECT_EQ(point.offset, 2u * FRAME_BYTES);
+
+    ASSERT_TRUE(table.lookup_with_preroll(50, point));
+    EXPECT_EQ(point.sample, 0u);
+}
+
+TEST_F(MP3SeekTableTest, PrerollReachesBackForTheReservoir) {
+    std::vector<uint8_t> data;
+    for (int i = 0; i < 8; ++i) {
+        append_frame(data);
+    }
+    write_media(data);
+
+    MP3SeekTable table;
+    ASSERT_TRUE(scan(table, 0, data.size()));
+
+    // 379 bytes of main data per frame: two more frames cover 511 bytes
+    MP3SeekPoint point;
+    ASSERT_TRUE(table.lookup_with_preroll(6 * FRAME_SAMPLES + 100, point, 511));
+    EXPECT_EQ(point.sample, 3u * FRAME_SAMPLES);
+    EXPECT_EQ(point.offset, 3u * FRAME_BYTES);
+
+    ASSERT_TRUE(table.lookup_with_preroll(2 * FRAME_SAMPLES, point, 511));
+    EXPECT_EQ(point.sample, 0u);
+}
+
+TEST_F(MP3SeekTableTest, CancelledScanLeavesTableEmpty) {
+    std::vector<uint8_t> data;
+    for (int i = 0; i < 4; ++i) {
+        append_frame(data);
+    }
+    write_media(data);
+
+    FILE* f = fopen(media_path_.c_str(), "rb");
+    std::atomic<bool> cancel{true};
+    MP3SeekTable table;
+    EXPECT_FALSE(table.build_from_scan(f, 0, data.size(), cancel));
+    fclose(f);
+    EXPECT_TRUE(table.empty());
+}
+
+TEST_F(MP3SeekTableTest, TocGivesApproximatePoints) {
+    std::vector<uint8_t> data;
+    append_xing_frame(data, 100, 101 * FRAME_BYTES);
+    for (int i = 0; i < 100; ++i) {
+        append_frame(data);
+    }
+
+    MP3FrameHeader frame;
+    ASSERT_TRUE(parse_mp3_frame_header(data.data(), frame));
+    MP3VbrHeader vbr;
+    ASSERT_TRUE(parse_mp3_vbr_header(data.data(), data.size(), frame, vbr));
+    EXPECT_EQ(vbr.frames, 100u);
+    EXPECT_EQ(vbr.toc.size(), 100u);
+
+    MP3SeekTable table;
+    ASSERT_TRUE(table.build_from_toc(vbr, frame, 0, data.size()));
+    EXPECT_FALSE(table.is_exact());
+    EXPECT_EQ(table.total_samples(), 100u * FRAME_SAMPLES);
+
+    // Halfway through the duration is roughly halfway through the bytes
+    MP3SeekPoint point;
+    ASSERT_TRUE(table.lookup_with_preroll(50 * FRAME_SAMPLES, point));
+    EXPECT_EQ(point.sample, 50u * FRAME_SAMPLES);
+    EXPECT_NEAR(static_cast<double>(point.offset), data.size() / 2.0, 2.0 * FRAME_BYTES);
+}
+
+TEST_F(MP3SeekTableTest, CacheRoundTripAndInvalidation) {
+    std::vector<uint8_t> data;
+    for (int i = 0; i < 6; ++i) {
+        append_frame(data);
+    }
+    write_media(data);
+
+    MP3SeekTable table;
+    ASSERT_TRUE(scan(table, 0, data.size()));
+
+    std::string cache_path = (dir_ / "cache" / "track.seek").string();
+    ASSERT_TRUE(table.save(cache_path, media_path_));
+
+    MP3SeekTable loaded;
+    ASSERT_TRUE(loaded.load(cache_path, media_path_));
+    EXPECT_TRUE(loaded.is_exact());
+    EXPECT_EQ(loaded.size(), table.size());
+    EXPECT_EQ(loaded.total_samples(), table.total_samples());
+
+    // A changed file no longer matches the cache
+    append_frame(data);
+    write_media(data);
+    MP3SeekTable stale;
+    EXPECT_FALSE(stale.load(cache_path, media_path_));
+}
+
+TEST_F(MP3SeekTableTest, CachePathHonoursOverride) {
+#ifdef _WIN32
+    _putenv_s("XPUMUSIC_CACHE_DIR", dir_.string().c_str());
+#else
+    setenv("XPUMUSIC_CACHE_DIR", dir_.string().c_str(), 1);
+#endif
+    std::string a = MP3SeekTable::cache_path_for(media_path_);
+    std::string b = MP3SeekTable::cache_path_for(media_path_ + "2");
+
+    EXPECT_EQ(a.rfind(dir_.string(), 0), 0u);
+    EXPECT_NE(a, b);
+}
@@ -0,0 +1,81 @@
+﻿#include "../core/mpsc_ring_buffer.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace mp::core;
+
+TEST(MpscRingBufferTest, CapacityRoundsUpToPowerOfTwo) {
+    MpscRingBuffer<int> ring(1000);
+    EXPECT_EQ(ring.capacity(), 1024u);
+    EXPECT_EQ(ring.size_approx(), 0u);
+}
+
+TEST(MpscRingBufferTest, PushFailsWhenFull) {
+    MpscRingBuffer<int> ring(4);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(ring.push(i));
+    }
+    EXPECT_FALSE(ring.push(4));
+    EXPECT_EQ(ring.size_approx(), 4u);
+
+    int value;
+    ASSERT_TRUE(ring.pop(value));
+    EXPECT_EQ(value, 0);
+    EXPECT_TRUE(ring.push(4));
+}
+
+TEST(MpscRingBufferTest, PopsInOrderAcrossWraps) {
+    MpscRingBuffer<int> ring(8);
+    int out[8];
+    int next = 0;
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 5; ++i) {
+            ASSERT_TRUE(ring.push(round * 5 + i));
+        }
+        ASSERT_EQ(ring.pop(out, 8), 5u);
+        for (int i = 0; i < 5; ++i) {
+            EXPECT_EQ(out[i], next++);
+        }
+    }
+    EXPECT_EQ(ring.pop(out, 8), 0u);
+}
+
+TEST(MpscRingBufferTest, ConcurrentProducersLoseNothing) {
+    struct Item {
+        uint32_t producer;
+        uint32_t sequence;
+    };
+    MpscRingBuffer<Item> ring(64);
+    const uint32_t producers = 4, per_producer = 20000;
+
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&ring, p, per_producer] {
+            for (uint32_t i = 0; i < per_producer; ++i) {
+                // Full or contended: try again
+                while (!ring.push(Item{p, i})) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // Each producer's items arrive in its own order
+    std::vector<uint32_t> expected(producers, 0);
+    uint32_t received = 0;
+    while (received < producers * per_producer) {
+        Item item;
+        if (!ring.pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_LT(item.producer, producers);
+        ASSERT_EQ(item.sequence, expected[item.producer]);
+        ++expected[item.producer];
+        ++received;
+    }
+    for (auto& t : threads) t.join();
+    Item extra;
+    EXPECT_FALSE(ring.pop(extra));
+}
@@ -0,0 +1,90 @@
+﻿#include "../core/parameter_automation.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace mp::core;
+
+TEST(SmoothedParameterTest, ImmediateAndZeroRampJump) {
+    SmoothedParameter gain(1.0f);
+    EXPECT_FLOAT_EQ(gain.next(), 1.0f);
+
+    gain.set_target(0.25f, 0);
+    EXPECT_FALSE(gain.is_smoothing());
+    EXPECT_FLOAT_EQ(gain.next(), 0.25f);
+
+    gain.set_immediate(2.0f);
+    EXPECT_FLOAT_EQ(gain.value(), 2.0f);
+    EXPECT_FLOAT_EQ(gain.target(), 2.0f);
+}
+
+TEST(SmoothedParameterTest, PerSampleRampIsLinearAndExact) {
+    SmoothedParameter gain(0.0f);
+    gain.set_target(1.0f, 4);
+    EXPECT_TRUE(gain.is_smoothing());
+
+    EXPECT_FLOAT_EQ(gain.next(), 0.25f);
+    EXPECT_FLOAT_EQ(gain.next(), 0.5f);
+    EXPECT_FLOAT_EQ(gain.next(), 0.75f);
+    EXPECT_EQ(gain.next(), 1.0f);
+    EXPECT_FALSE(gain.is_smoothing());
+    EXPECT_EQ(gain.next(), 1.0f);
+}
+
+TEST(SmoothedParameterTest, PerBlockMatchesPerSample) {
+    SmoothedParameter per_sample(0.3f);
+    SmoothedParameter per_block(0.3f);
+    per_sample.set_target(-0.7f, 1000);
+    per_block.set_target(-0.7f, 1000);
+
+    for (int i = 0; i < 256; ++i) {
+        per_sample.next();
+    }
+    EXPECT_NEAR(per_block.advance(256), per_sample.value(), 1e-5f);
+
+    // Overshooting the ramp ends on the target
+    EXPECT_EQ(per_block.advance(10000), -0.7f);
+    EXPECT_FALSE(per_block.is_smoothing());
+}
+
+TEST(SmoothedParameterTest, RetargetStartsFromCurrentValue) {
+    SmoothedParameter mix(0.0f);
+    mix.set_target(1.0f, 100);
+    mix.advance(50);
+    mix.set_target(0.0f, 10);
+    EXPECT_NEAR(mix.next(), 0.45f, 1e-6f);
+}
+
+TEST(ParameterQueueTest, DeliversInOrderAcrossThreads) {
+    ParameterQueue queue(64);
+    constexpr uint32_t COUNT = 100000;
+
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < COUNT; ++i) {
+            ParameterChange change{i % 7, i, static_cast<float>(i), 0.0f};
+            while (!queue.push(change)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t expected = 0;
+    ParameterChange changes[16];
+    while (expected < COUNT) {
+        size_t count = queue.pop(changes, 16);
+        for (size_t i = 0; i < count; ++i, ++expected) {
+            ASSERT_EQ(changes[i].parameter, expected);
+            ASSERT_EQ(changes[i].target, expected % 7);
+        }
+    }
+    producer.join();
+    EXPECT_EQ(queue.pending(), 0u);
+}
+
+TEST(ParameterQueueTest, FullQueueRejects) {
+    ParameterQueue queue(4);
+    ParameterChange change{0, 0, 1.0f, 0.0f};
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.push(change));
+    }
+    EXPECT_FALSE(queue.push(change));
+}
@@ -0,0 +1,244 @@
+﻿#include "../core/partitioned_convolver.h"
+#include "../core/impulse_response.h"
+#include "../src/audio/enhanced_sample_rate_converter.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <vector>
+
+using namespace mp::core;
+
+namespace {
+
+std::vector<float> random_signal(size_t samples, unsigned seed, float amplitude = 0.5f) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-amplitude, amplitude);
+    std::vector<float> signal(samples);
+    for (float& s : signal) {
+        s = dist(gen);
+    }
+    return signal;
+}
+
+// Decaying noise, like a room response
+std::vector<float> decaying_ir(size_t frames, uint16_t channels, unsigned seed) {
+    std::vector<float> ir = random_signal(frames * channels, seed);
+    for (size_t i = 0; i < frames; ++i) {
+        float envelope = std::exp(-4.0f * i / frames);
+        for (uint16_t c = 0; c < channels; ++c) {
+            ir[i * channels + c] *= envelope;
+        }
+    }
+    return ir;
+}
+
+// Direct convolution, delayed by latency frames
+std::vector<float> reference(const std::vector<float>& input, uint16_t channels,
+                             const std::vector<float>& ir, uint16_t ir_channels,
+                             size_t latency) {
+    size_t frames = input.size() / channels;
+    size_t ir_frames = ir.size() / ir_channels;
+    std::vector<float> output(input.size(), 0.0f);
+    for (uint16_t c = 0; c < channels; ++c) {
+        uint16_t ic = c % ir_channels;
+        for (size_t n = latency; n < frames; ++n) {
+            size_t t = n - latency;
+            double sum = 0.0;
+            for (size_t k = 0; k < ir_frames && k <= t; ++k) {
+                sum += static_cast<double>(ir[k * ir_channels + ic]) * input[(t - k) * channels + c];
+            }
+            output[n * channels + c] = static_cast<float>(sum);
+        }
+    }
+    return output;
+}
+
+double max_error(const std::vector<float>& a, const std::vector<float>& b) {
+    double error = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        error = std::max(error, static_cast<double>(std::fabs(a[i] - b[i])));
+    }
+    return error;
+}
+
+void write_u16(std::ofstream& out, uint16_t v) {
+    out.put(static_cast<char>(v & 0xFF));
+    out.put(static_cast<char>(v >> 8));
+}
+
+void write_u32(std::ofstream& out, uint32_t v) {
+    write_u16(out, static_cast<uint16_t>(v & 0xFFFF));
+    write_u16(out, static_cast<uint16_t>(v >> 16));
+}
+
+} // namespace
+
+TEST(PartitionedConvolverTest, UniformMatchesDirectConvolution) {
+    std::vector<float> ir = decaying_ir(3000, 2, 1);
+    std::vector<float> input = random_signal(2 * 8000, 2);
+
+    PartitionedConvolver convolver;
+    ASSERT_TRUE(convolver.configure(ir.data(), 3000, 2, 2, 64));
+    EXPECT_EQ(convolver.segment_count(), 1u);
+    EXPECT_EQ(convolver.partition_size(0), 64u);
+    EXPECT_EQ(convolver.latency(), 64u);
+
+    std::vector<float> output(input);
+    convolver.process(output.data(), 8000);
+
+    EXPECT_LT(max_error(output, reference(input, 2, ir, 2, 64)), 1e-4);
+}
+
+TEST(PartitionedConvolverTest, NonUniformMatchesDirectConvolution) {
+    std::vector<float> ir = decaying_ir(20000, 1, 3);
+    std::vector<float> input = random_signal(2 * 30000, 4);
+
+    PartitionedConvolver convolver;
+    ASSERT_TRUE(convolver.configure(ir.data(), 20000, 1, 2, 32, 2048));
+    ASSERT_GT(convolver.segment_count(), 2u);
+    EXPECT_EQ(convolver.partition_size(0), 32u);
+    for (size_t s = 1; s < convolver.segment_count(); ++s) {
+        EXPECT_GT(convolver.partition_size(s), convolver.partition_size(s - 1));
+    }
+    EXPECT_EQ(convolver.partition_size(convolver.segment_count() - 1), 2048u);
+    EXPECT_EQ(convolver.latency(), 32u);
+
+    std::vector<float> output(input);
+    convolver.process(output.data(), 30000);
+
+    EXPECT_LT(max_error(output, reference(input, 2, ir, 1, 32)), 1e-4);
+}
+
+TEST(PartitionedConvolverTest, CallSizeDoesNotChangeOutput) {
+    std::vector<float> ir = decaying_ir(5000, 2, 5);
+    std::vector<float> input = random_signal(2 * 12000, 6);
+
+    PartitionedConvolver whole;
+    PartitionedConvolver pieces;
+    ASSERT_TRUE(whole.configure(ir.data(), 5000, 2, 2, 64, 1024));
+    ASSERT_TRUE(pieces.configure(ir.data(), 5000, 2, 2, 64, 1024));
+
+    std::vector<float> expected(input);
+    whole.process(expected.data(), 12000);
+
+    std::vector<float> output(input);
+    size_t sizes[] = {1, 13, 64, 100, 511, 7};
+    size_t offset = 0;
+    for (size_t k = 0; offset < 12000; ++k) {
+        size_t count = std::min(sizes[k % 6], size_t(12000) - offset);
+        pieces.process(output.data() + offset * 2, count);
+        offset += count;
+    }
+
+    EXPECT_EQ(output, expected);
+}
+
+TEST(PartitionedConvolverTest, ResetClearsHistory) {
+    std::vector<float> ir = decaying_ir(4000, 1, 7);
+    PartitionedConvolver convolver;
+    ASSERT_TRUE(convolver.configure(ir.data(), 4000, 1, 1, 128, 512));
+
+    std::vector<float> noise = random_signal(3000, 8);
+    convolver.process(noise.data(), 3000);
+    convolver.reset();
+
+    std::vector<float> silence(6000, 0.0f);
+    convolver.process(silence.data(), 6000);
+    for (float s : silence) {
+        ASSERT_EQ(s, 0.0f);
+    }
+}
+
+TEST(PartitionedConvolverTest, RejectsInvalidLayouts) {
+    std::vector<float> ir(100, 0.5f);
+    PartitionedConvolver convolver;
+    EXPECT_FALSE(convolver.configure(ir.data(), 100, 1, 2, 48));
+    EXPECT_FALSE(convolver.configure(ir.data(), 100, 1, 2, 8));
+    EXPECT_FALSE(convolver.configure(ir.data(), 100, 1, 2, 256, 128));
+    EXPECT_FALSE(convolver.configure(nullptr, 100, 1, 2, 64));
+    EXPECT_FALSE(convolver.is_configured());
+}
+
+TEST(ImpulseResponseTest, ReadsExtensible24BitWav) {
+    std::string path = ::testing::TempDir() + "ir_24bit.wav";
+    const int32_t values[] = {8388607, -8388608, 4194304, 0, -1, 1};
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write("RIFF", 4);
+        write_u32(out, 4 + 8 + 40 + 8 + 4 + 8 + 18);
+        out.write("WAVE", 4);
+        out.write("fmt ", 4);
+        write_u32(out, 40);
+        write_u16(out, 0xFFFE);
+        write_u16(out, 2);
+        write_u32(out, 96000);
+        write_u32(out, 96000 * 6);
+        write_u16(out, 6);
+        write_u16(out, 24);
+        write_u16(out, 22);
+        write_u16(out, 24);
+        write_u32(out, 3);
+        write_u16(out, 1);                  // KSDATAFORMAT_SUBTYPE_PCM
+        for (int i = 0; i < 14; ++i) {
+            out.put(0);
+        }
+        out.write("LIST", 4);               // Skipped
+        write_u32(out, 4);
+        out.write("INFO", 4);
+        out.write("data", 4);
+        write_u32(out, 18);
+        for (int32_t v : values) {
+            out.put(static_cast<char>(v & 0xFF));
+            out.put(static_cast<char>((v >> 8) & 0xFF));
+            out.put(static_cast<char>((v >> 16) & 0xFF));
+        }
+    }
+
+    ImpulseResponse ir;
+    ASSERT_TRUE(read_wav_impulse_response(path, ir));
+    std::remove(path.c_str());
+
+    EXPECT_EQ(ir.sample_rate, 96000u);
+    EXPECT_EQ(ir.channels, 2);
+    ASSERT_EQ(ir.frames(), 3u);
+    EXPECT_NEAR(ir.samples[0], 1.0f, 1e-6f);
+    EXPECT_FLOAT_EQ(ir.samples[1], -1.0f);
+    EXPECT_FLOAT_EQ(ir.samples[2], 0.5f);
+    EXPECT_FLOAT_EQ(ir.samples[3], 0.0f);
+    EXPECT_LT(ir.samples[4], 0.0f);
+    EXPECT_GT(ir.samples[5], 0.0f);
+}
+
+TEST(ImpulseResponseTest, ResampleKeepsOnsetAndGain) {
+    // Smooth band-limited pulse, so its sum is the DC gain at either rate
+    ImpulseResponse ir;
+    ir.sample_rate = 44100;
+    ir.channels = 1;
+    ir.samples.assign(2000, 0.0f);
+    for (size_t i = 0; i < 200; ++i) {
+        double x = (static_cast<double>(i) - 100.0) / 25.0;
+        ir.samples[i] = static_cast<float>(std::exp(-x * x));
+    }
+    double sum_before = 0.0;
+    for (float s : ir.samples) {
+        sum_before += s;
+    }
+
+    audio::EnhancedSampleRateConverter converter(audio::ResampleQuality::Best);
+    ASSERT_TRUE(resample_impulse_response(ir, 96000, converter));
+    EXPECT_EQ(ir.sample_rate, 96000u);
+    EXPECT_NEAR(static_cast<double>(ir.frames()), 2000.0 * 96000 / 44100, 2.0);
+
+    double sum_after = 0.0;
+    size_t peak = 0;
+    for (size_t i = 0; i < ir.samples.size(); ++i) {
+        sum_after += ir.samples[i];
+        if (ir.samples[i] > ir.samples[peak]) {
+            peak = i;
+        }
+    }
+    EXPECT_NEAR(sum_after, sum_before, 0.01 * sum_before);
+    EXPECT_NEAR(static_cast<double>(peak), 100.0 * 96000 / 44100, 2.0);
+}
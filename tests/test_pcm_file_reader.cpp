@@ -0,0 +1,257 @@
+﻿#include "../core/pcm_file_reader.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace mp;
+using namespace mp::core;
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+void put_le(Bytes& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void put_be(Bytes& out, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void put_id(Bytes& out, const char* id) {
+    out.insert(out.end(), id, id + 4);
+}
+
+// RIFF/RF64 WAVE around the given sample bytes. An rf64 file carries its
+// real sizes only in the ds64 chunk.
+Bytes make_wav(const Bytes& samples, uint16_t tag, uint16_t channels, uint32_t rate,
+               uint16_t bits, bool rf64 = false, bool extensible = false) {
+    Bytes out;
+    put_id(out, rf64 ? "RF64" : "RIFF");
+    put_le(out, rf64 ? 0xFFFFFFFF : 0, 4);      // Sizes are not checked by the reader
+    put_id(out, "WAVE");
+    if (rf64) {
+        put_id(out, "ds64");
+        put_le(out, 28, 4);
+        put_le(out, 0, 8);
+        put_le(out, samples.size(), 8);
+        put_le(out, 0, 8);
+        put_le(out, 0, 4);
+    }
+    // An odd-sized chunk the parser must skip with its pad byte
+    put_id(out, "LIST");
+    put_le(out, 3, 4);
+    out.insert(out.end(), {'a', 'b', 'c', 0});
+
+    const uint16_t block_align = static_cast<uint16_t>(channels * bits / 8);
+    put_id(out, "fmt ");
+    put_le(out, extensible ? 40 : 16, 4);
+    put_le(out, extensible ? 0xFFFE : tag, 2);
+    put_le(out, channels, 2);
+    put_le(out, rate, 4);
+    put_le(out, rate * block_align, 4);
+    put_le(out, block_align, 2);
+    put_le(out, bits, 2);
+    if (extensible) {
+        put_le(out, 22, 2);
+        put_le(out, bits, 2);
+        put_le(out, 3, 4);
+        put_le(out, tag, 2);                    // SubFormat GUID starts with the tag
+        out.insert(out.end(), 14, 0);
+    }
+    put_id(out, "data");
+    put_le(out, rf64 ? 0xFFFFFFFF : samples.size(), 4);
+    out.insert(out.end(), samples.begin(), samples.end());
+    return out;
+}
+
+Bytes make_aiff(const Bytes& samples, uint16_t channels, uint32_t frames, uint16_t bits) {
+    Bytes out;
+    put_id(out, "FORM");
+    put_be(out, 0, 4);
+    put_id(out, "AIFF");
+    put_id(out, "COMM");
+    put_be(out, 18, 4);
+    put_be(out, channels, 2);
+    put_be(out, frames, 4);
+    put_be(out, bits, 2);
+    // 44100 as an 80-bit extended: 2^15 * 1.3458...
+    put_be(out, 0x400E, 2);
+    put_be(out, 0xAC44000000000000ull, 8);
+    put_id(out, "SSND");
+    put_be(out, 8 + samples.size(), 4);
+    put_be(out, 0, 4);
+    put_be(out, 0, 4);
+    out.insert(out.end(), samples.begin(), samples.end());
+    return out;
+}
+
+class TempFile {
+public:
+    explicit TempFile(const Bytes& contents) {
+        static int counter = 0;
+        path_ = ::testing::TempDir() + "pcm_reader_" + std::to_string(counter++) + ".bin";
+        FILE* file = std::fopen(path_.c_str(), "wb");
+        std::fwrite(contents.data(), 1, contents.size(), file);
+        std::fclose(file);
+    }
+    ~TempFile() { std::remove(path_.c_str()); }
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+Bytes int16_samples(const std::vector<int16_t>& values) {
+    Bytes out;
+    for (int16_t v : values) put_le(out, static_cast<uint16_t>(v), 2);
+    return out;
+}
+
+} // namespace
+
+TEST(PcmFileReaderTest, ReadsInt16Wav) {
+    std::vector<int16_t> values;
+    for (int i = 0; i < 200; ++i) values.push_back(static_cast<int16_t>((i - 100) * 300));
+    TempFile file(make_wav(int16_samples(values), 1, 2, 48000, 16));
+
+    PcmFileReader reader;
+    ASSERT_TRUE(reader.open(file.path())) << reader.last_error();
+    EXPECT_EQ(reader.container(), PcmContainer::Wav);
+    EXPECT_EQ(reader.sample_rate(), 48000u);
+    EXPECT_EQ(reader.channels(), 2);
+    EXPECT_EQ(reader.sample_format(), SampleFormat::Int16);
+    EXPECT_EQ(reader.total_frames(), 100u);
+
+    std::vector<float> out(200);
+    ASSERT_EQ(reader.read(out.data(), 1000), 100u);
+    for (size_t i = 0; i < values.size(); ++i) {
+        ASSERT_FLOAT_EQ(out[i], values[i] / 32768.0f) << i;
+    }
+    EXPECT_EQ(reader.read(out.data(), 10), 0u);
+}
+
+TEST(PcmFileReaderTest, ConvertsInt24ThroughTheVectorPathAndTail) {
+    // Enough samples for the AVX2 loop plus a scalar tail
+    Bytes samples;
+    std::vector<int32_t> values;
+    for (int i = 0; i < 37; ++i) {
+        int32_t v = (i * 226843) % 8388608 - 4194304;
+        values.push_back(v);
+        put_le(samples, static_cast<uint32_t>(v), 3);
+    }
+    TempFile file(make_wav(samples, 1, 1, 96000, 24));
+
+    PcmFileReader reader;
+    ASSERT_TRUE(reader.open(file.path()));
+    std::vector<float> out(values.size());
+    ASSERT_EQ(reader.read(out.data(), out.size()), values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        ASSERT_FLOAT_EQ(out[i], values[i] / 8388608.0f) << i;
+    }
+}
+
+TEST(PcmFileReaderTest, ReadsExtensibleFloatAndRf64) {
+    Bytes samples;
+    const float values[] = {0.5f, -0.25f, 1.0f, -1.0f};
+    for (float v : values) {
+        uint32_t bits;
+        std::memcpy(&bits, &v, 4);
+        put_le(samples, bits, 4);
+    }
+
+    TempFile extensible(make_wav(samples, 3, 2, 44100, 32, false, true));
+    PcmFileReader reader;
+    ASSERT_TRUE(reader.open(extensible.path())) << reader.last_error();
+    EXPECT_EQ(reader.sample_format(), SampleFormat::Float32);
+    EXPECT_EQ(reader.total_frames(), 2u);
+
+    TempFile rf64(make_wav(samples, 3, 2, 44100, 32, true));
+    ASSERT_TRUE(reader.open(rf64.path())) << reader.last_error();
+    EXPECT_EQ(reader.container(), PcmContainer::Rf64);
+    EXPECT_EQ(reader.total_frames(), 2u);
+    float out[4];
+    ASSERT_EQ(reader.read(out, 2), 2u);
+    EXPECT_FLOAT_EQ(out[1], -0.25f);
+    EXPECT_FLOAT_EQ(out[3], -1.0f);
+}
+
+TEST(PcmFileReaderTest, SeekIsClampedAndViewDoesNotAdvance) {
+    std::vector<int16_t> values;
+    for (int i = 0; i < 64; ++i) values.push_back(static_cast<int16_t>(i));
+    TempFile file(make_wav(int16_samples(values), 1, 1, 8000, 16));
+
+    PcmFileReader reader;
+    ASSERT_TRUE(reader.open(file.path()));
+    reader.seek(60);
+    EXPECT_EQ(reader.position(), 60u);
+
+    size_t frames = 0;
+    const uint8_t* mapped = reader.view(10, frames);
+    ASSERT_NE(mapped, nullptr);
+    EXPECT_EQ(frames, 4u);
+    EXPECT_EQ(mapped[0], 60);
+    EXPECT_EQ(reader.position(), 60u);
+
+    reader.skip(frames);
+    EXPECT_EQ(reader.remaining_frames(), 0u);
+
+    reader.seek(1000);
+    EXPECT_EQ(reader.position(), 64u);
+    reader.seek(2);
+    int16_t raw[2];
+    ASSERT_EQ(reader.read_raw(raw, 2), 2u);
+    EXPECT_EQ(raw[0], 2);
+    EXPECT_EQ(raw[1], 3);
+}
+
+TEST(PcmFileReaderTest, SwapsBigEndianAiff) {
+    Bytes samples;
+    put_be(samples, 0x4000, 2);
+    put_be(samples, 0xC000, 2);
+    put_be(samples, 0x1234, 2);
+    put_be(samples, 0x0000, 2);
+    TempFile file(make_aiff(samples, 2, 2, 16));
+
+    PcmFileReader reader;
+    ASSERT_TRUE(reader.open(file.path())) << reader.last_error();
+    EXPECT_EQ(reader.container(), PcmContainer::Aiff);
+    EXPECT_EQ(reader.sample_rate(), 44100u);
+    EXPECT_TRUE(reader.big_endian());
+    EXPECT_EQ(reader.total_frames(), 2u);
+
+    float out[4];
+    ASSERT_EQ(reader.read(out, 1), 1u);
+    EXPECT_FLOAT_EQ(out[0], 0.5f);
+    EXPECT_FLOAT_EQ(out[1], -0.5f);
+
+    int16_t raw[2];
+    ASSERT_EQ(reader.read_raw(raw, 1), 1u);
+    EXPECT_EQ(raw[0], 0x1234);
+}
+
+TEST(PcmFileReaderTest, RawAndRejectedFiles) {
+    Bytes samples = {0x80, 0xFF, 0x00};
+    TempFile file(samples);
+
+    PcmFileReader reader;
+    EXPECT_FALSE(reader.open(file.path()));
+    EXPECT_FALSE(reader.is_open());
+    EXPECT_FALSE(reader.last_error().empty());
+
+    // Headerless 8-bit is unsigned, as in WAV
+    ASSERT_TRUE(reader.open_raw(file.path(), 8000, 1, 8, false, false, 1));
+    EXPECT_EQ(reader.total_frames(), 2u);
+    EXPECT_EQ(reader.sample_format(), SampleFormat::Unknown);
+    float out[2];
+    ASSERT_EQ(reader.read(out, 2), 2u);
+    EXPECT_FLOAT_EQ(out[0], 127.0f / 128.0f);
+    EXPECT_FLOAT_EQ(out[1], -1.0f);
+
+    EXPECT_FALSE(reader.open(::testing::TempDir() + "missing.wav"));
+    TempFile adpcm(make_wav(int16_samples({1, 2}), 2, 1, 8000, 16));
+    EXPECT_FALSE(reader.open(adpcm.path()));
+}
@@ -0,0 +1,110 @@
+﻿#include "../core/planar_pcm_sink.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <vector>
+
+using namespace mp::core;
+
+namespace {
+
+// Planar test block: channel c, frame i holds (base + i) * (c ? -1 : 1)
+struct Block {
+    std::vector<std::vector<int32_t>> channels;
+    std::vector<const int32_t*> planes;
+
+    Block(size_t count, size_t frames, int32_t base) : channels(count) {
+        for (size_t c = 0; c < count; ++c) {
+            for (size_t i = 0; i < frames; ++i) {
+                int32_t v = base + static_cast<int32_t>(i);
+                channels[c].push_back(c % 2 ? -v : v);
+            }
+            planes.push_back(channels[c].data());
+        }
+    }
+};
+
+} // namespace
+
+TEST(PlanarPcmSinkTest, InterleavesAndNormalisesStereo) {
+    PlanarPcmSink sink;
+    ASSERT_TRUE(sink.configure(2, 16, 64, PlanarPcmSink::Output::Float32));
+
+    // Long enough for the vector loop and a tail
+    Block block(2, 21, 1000);
+    std::vector<float> out(42);
+    sink.begin(out.data(), 21);
+    EXPECT_EQ(sink.write(block.planes.data(), 21), 21u);
+    EXPECT_TRUE(sink.full());
+    EXPECT_EQ(sink.pending(), 0u);
+
+    for (size_t i = 0; i < 21; ++i) {
+        ASSERT_FLOAT_EQ(out[i * 2], (1000 + i) / 32768.0f) << i;
+        ASSERT_FLOAT_EQ(out[i * 2 + 1], -(1000.0f + i) / 32768.0f) << i;
+    }
+}
+
+TEST(PlanarPcmSinkTest, TailsWaitInTheRingInOrder) {
+    PlanarPcmSink sink;
+    ASSERT_TRUE(sink.configure(3, 24, 16, PlanarPcmSink::Output::Float32));
+
+    Block first(3, 16, 0);
+    Block second(3, 16, 16);
+    std::vector<float> out(10 * 3);
+
+    // 16 frames into a 10-frame buffer: 6 wait
+    sink.begin(out.data(), 10);
+    sink.write(first.planes.data(), 16);
+    EXPECT_EQ(sink.written(), 10u);
+    EXPECT_EQ(sink.pending(), 6u);
+
+    // The next call drains them first, then takes 4 of the next block
+    sink.begin(out.data(), 10);
+    EXPECT_EQ(sink.written(), 6u);
+    sink.write(second.planes.data(), 16);
+    EXPECT_EQ(sink.pending(), 12u);
+    for (size_t i = 0; i < 10; ++i) {
+        ASSERT_FLOAT_EQ(out[i * 3], (10 + i) / 8388608.0f) << i;
+        ASSERT_FLOAT_EQ(out[i * 3 + 1], -(10.0f + i) / 8388608.0f) << i;
+    }
+
+    // Ring wraps: everything still comes out in order
+    sink.begin(out.data(), 10);
+    EXPECT_FLOAT_EQ(out[0], 20 / 8388608.0f);
+    sink.begin(out.data(), 10);
+    EXPECT_EQ(sink.written(), 2u);
+    EXPECT_FLOAT_EQ(out[3], 31 / 8388608.0f);
+    EXPECT_EQ(sink.pending(), 0u);
+}
+
+TEST(PlanarPcmSinkTest, WithoutABufferEverythingIsPending) {
+    PlanarPcmSink sink;
+    ASSERT_TRUE(sink.configure(1, 16, 8, PlanarPcmSink::Output::Float32));
+
+    Block block(1, 12, 1);
+    sink.begin(nullptr, 0);
+    EXPECT_EQ(sink.write(block.planes.data(), 12), 8u);   // Ring holds one maximum block
+    EXPECT_EQ(sink.pending(), 8u);
+
+    sink.clear();
+    EXPECT_EQ(sink.pending(), 0u);
+}
+
+TEST(PlanarPcmSinkTest, Int32IsLeftJustified) {
+    PlanarPcmSink sink;
+    ASSERT_TRUE(sink.configure(2, 16, 8, PlanarPcmSink::Output::Int32));
+
+    Block block(2, 2, -32767);
+    int32_t out[4];
+    sink.begin(out, 2);
+    sink.write(block.planes.data(), 2);
+    EXPECT_EQ(out[0], -32767 * 65536);
+    EXPECT_EQ(out[1], 32767 * 65536);
+    EXPECT_EQ(out[2], -32766 * 65536);
+}
+
+TEST(PlanarPcmSinkTest, RejectsBadConfiguration) {
+    PlanarPcmSink sink;
+    EXPECT_FALSE(sink.configure(0, 16, 8, PlanarPcmSink::Output::Float32));
+    EXPECT_FALSE(sink.configure(2, 33, 8, PlanarPcmSink::Output::Float32));
+    EXPECT_FALSE(sink.configure(2, 16, 0, PlanarPcmSink::Output::Float32));
+}
@@ -0,0 +1,510 @@
+﻿#include "../core/playlist_formats.h"
+#include "../core/path_resolver.h"
+#include "../core/playlist_manager.h"
+#include "../core/playback_engine.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mp;
+using namespace mp::core;
+namespace fs = std::filesystem;
+
+namespace {
+
+void write_file(const fs::path& path, const std::string& text) {
+    fs::create_directories(path.parent_path());
+    std::ofstream(path, std::ios::binary) << text;
+}
+
+std::string read_file(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// 16-bit silence
+std::string make_wav(uint32_t rate, uint32_t frames) {
+    std::string out;
+    auto put = [&out](uint32_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) out += static_cast<char>(value >> (8 * i));
+    };
+    out += "RIFF";
+    put(36 + frames * 4, 4);
+    out += "WAVEfmt ";
+    put(16, 4);
+    put(1, 2);
+    put(2, 2);
+    put(rate, 4);
+    put(rate * 4, 4);
+    put(4, 2);
+    put(16, 2);
+    out += "data";
+    put(frames * 4, 4);
+    out.append(frames * 4, '\0');
+    return out;
+}
+
+std::vector<PlaylistEntry> parse(PlaylistFormat format, const std::string& text) {
+    std::vector<PlaylistEntry> entries;
+    EXPECT_TRUE(parse_playlist(format, text, entries));
+    return entries;
+}
+
+class PlaylistFilesTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir_ = fs::path(::testing::TempDir()) / "playlist_formats_test";
+        fs::remove_all(dir_);
+        fs::create_directories(dir_);
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        fs::remove_all(dir_, ec);
+    }
+
+    std::string path(const std::string& relative) const {
+        return (dir_ / relative).lexically_normal().string();
+    }
+
+    fs::path dir_;
+};
+
+} // namespace
+
+TEST(PlaylistFormatTest, ChoosesFormatByExtension) {
+    EXPECT_EQ(playlist_format_for("/a/b.M3U8"), PlaylistFormat::M3U);
+    EXPECT_EQ(playlist_format_for("list.m3u"), PlaylistFormat::M3U);
+    EXPECT_EQ(playlist_format_for("x.Pls"), PlaylistFormat::PLS);
+    EXPECT_EQ(playlist_format_for("x.xspf"), PlaylistFormat::XSPF);
+    EXPECT_EQ(playlist_format_for("album.cue"), PlaylistFormat::CUE);
+    EXPECT_EQ(playlist_format_for("/dir.cue/list"), PlaylistFormat::Unknown);
+    EXPECT_EQ(playlist_format_for("x.json"), PlaylistFormat::Unknown);
+}
+
+TEST(PlaylistFormatTest, ParsesExtendedM3u) {
+    auto entries = parse(PlaylistFormat::M3U,
+                         "\xEF\xBB\xBF#EXTM3U\r\n"
+                         "#EXTINF:123,Artist - Song\r\n"
+                         "music/a.flac\r\n"
+                         "\r\n"
+                         "# a comment\r\n"
+                         "#EXTINF:-1 tvg-id=\"x\",Radio\r\n"
+                         "http://stream.example/live\r\n"
+                         "/abs/b.mp3\r\n");
+    ASSERT_EQ(entries.size(), 3u);
+    EXPECT_EQ(entries[0].location, "music/a.flac");
+    EXPECT_EQ(entries[0].artist, "Artist");
+    EXPECT_EQ(entries[0].title, "Song");
+    EXPECT_EQ(entries[0].duration_ms, 123000);
+    EXPECT_EQ(entries[1].location, "http://stream.example/live");
+    EXPECT_EQ(entries[1].title, "Radio");
+    EXPECT_EQ(entries[1].duration_ms, -1);
+    EXPECT_EQ(entries[2].location, "/abs/b.mp3");
+    EXPECT_TRUE(entries[2].title.empty());
+
+    // Latin-1 from an old .m3u; UTF-8 is left alone
+    entries = parse(PlaylistFormat::M3U, "Caf\xE9.mp3\n");
+    ASSERT_EQ(entries.size(), 1u);
+    EXPECT_EQ(entries[0].location, "Caf\xC3\xA9.mp3");
+    entries = parse(PlaylistFormat::M3U, "Caf\xC3\xA9.mp3\n");
+    ASSERT_EQ(entries.size(), 1u);
+    EXPECT_EQ(entries[0].location, "Caf\xC3\xA9.mp3");
+}
+
+TEST(PlaylistFormatTest, ParsesPlsInEntryOrder) {
+    auto entries = parse(PlaylistFormat::PLS,
+                         "[playlist]\n"
+                         "File2=b.ogg\n"
+                         "file1=a.ogg\n"
+                         "Title1=First\n"
+                         "Length1=61\n"
+                         "Length2=-1\n"
+                         "NumberOfEntries=2\n"
+                         "Version=2\n");
+    ASSERT_EQ(entries.size(), 2u);
+    EXPECT_EQ(entries[0].location, "a.ogg");
+    EXPECT_EQ(entries[0].title, "First");
+    EXPECT_EQ(entries[0].duration_ms, 61000);
+    EXPECT_EQ(entries[1].location, "b.ogg");
+    EXPECT_EQ(entries[1].duration_ms, -1);
+
+    std::vector<PlaylistEntry> none;
+    EXPECT_FALSE(parse_playlist(PlaylistFormat::PLS, "File1=a.ogg\n", none));
+}
+
+TEST(PlaylistFormatTest, ParsesXspf) {
+    auto entries = parse(PlaylistFormat::XSPF,
+                         "<?xml version=\"1.0\"?>\n"
+                         "<playlist version=\"1\" xmlns=\"http://xspf.org/ns/0/\"><trackList>\n"
+                         "<track><location>file:///music/A%20%26%20B/t%C3%A9.flac</location>"
+                         "<title>Rock &amp; Roll &#x263A;</title><creator><![CDATA[<Band>]]></creator>"
+                         "<duration>215000</duration></track>\n"
+                         "<track><location>https://example.com/a%20b.mp3</location></track>\n"
+                         "<track><title>No location</title></track>\n"
+                         "<track><location>rel/c.mp3</location></track>\n"
+                         "</trackList></playlist>\n");
+    ASSERT_EQ(entries.size(), 3u);
+    EXPECT_EQ(entries[0].location, "/music/A & B/t\xC3\xA9.flac");
+    EXPECT_EQ(entries[0].title, "Rock & Roll \xE2\x98\xBA");
+    EXPECT_EQ(entries[0].artist, "<Band>");
+    EXPECT_EQ(entries[0].duration_ms, 215000);
+    EXPECT_EQ(entries[1].location, "https://example.com/a%20b.mp3");
+    EXPECT_EQ(entries[2].location, "rel/c.mp3");
+}
+
+TEST(PlaylistFormatTest, CueTracksEndWhereTheNextStarts) {
+    auto entries = parse(PlaylistFormat::CUE,
+                         "REM GENRE Rock\n"
+                         "PERFORMER \"The Band\"\n"
+                         "TITLE \"Album\"\n"
+                         "FILE \"disc one.flac\" WAVE\n"
+                         "  TRACK 01 AUDIO\n"
+                         "    TITLE \"One\"\n"
+                         "    INDEX 01 00:00:00\n"
+                         "  TRACK 02 AUDIO\n"
+                         "    TITLE \"Two\"\n"
+                         "    PERFORMER \"Guest\"\n"
+                         "    INDEX 00 03:00:00\n"
+                         "    INDEX 01 03:02:10\n"
+                         "  TRACK 03 MODE1/2352\n"
+                         "    INDEX 01 05:00:00\n"
+                         "FILE bonus.wav WAVE\n"
+                         "  TRACK 04 AUDIO\n"
+                         "    TITLE \"Bonus\"\n"
+                         "    INDEX 01 00:00:00\n");
+    ASSERT_EQ(entries.size(), 3u);
+    EXPECT_EQ(entries[0].location, "disc one.flac");
+    EXPECT_EQ(entries[0].title, "One");
+    EXPECT_EQ(entries[0].artist, "The Band");
+    EXPECT_TRUE(entries[0].cd_frames);
+    EXPECT_EQ(entries[0].start, 0u);
+    EXPECT_EQ(entries[0].end, (3u * 60 + 2) * 75 + 10);
+    EXPECT_EQ(entries[0].duration_ms, 182133);
+    EXPECT_EQ(entries[1].artist, "Guest");
+    EXPECT_EQ(entries[1].start, (3u * 60 + 2) * 75 + 10);
+    // The data track still bounds the one before it
+    EXPECT_EQ(entries[1].end, 5u * 60 * 75);
+    EXPECT_EQ(entries[2].location, "bonus.wav");
+    EXPECT_EQ(entries[2].start, 0u);
+    EXPECT_EQ(entries[2].end, 0u);
+}
+
+TEST(PlaylistFormatTest, WrittenPlaylistsParseBack) {
+    std::vector<PlaylistEntry> entries(3);
+    entries[0].location = "/music/a \"b\" & c.flac";
+    entries[0].title = "Title";
+    entries[0].artist = "Artist";
+    entries[0].duration_ms = 90000;
+    entries[1].location = "rel/d.mp3";
+    entries[2].location = "http://radio.example/stream";
+
+    for (PlaylistFormat format : {PlaylistFormat::M3U, PlaylistFormat::PLS, PlaylistFormat::XSPF}) {
+        auto back = parse(format, write_playlist(format, entries));
+        ASSERT_EQ(back.size(), 3u);
+        for (size_t i = 0; i < 3; ++i) {
+            EXPECT_EQ(back[i].location, entries[i].location);
+            EXPECT_EQ(back[i].title, entries[i].title);
+            EXPECT_EQ(back[i].artist, entries[i].artist);
+            EXPECT_EQ(back[i].duration_ms, entries[i].duration_ms);
+        }
+    }
+
+    std::vector<PlaylistEntry> tracks(3);
+    tracks[0].location = tracks[1].location = "album.flac";
+    tracks[0].cd_frames = tracks[1].cd_frames = true;
+    tracks[0].end = tracks[1].start = 13660;
+    tracks[1].title = "Say \"hi\"";
+    tracks[2].location = "other.flac";
+    auto back = parse(PlaylistFormat::CUE, write_playlist(PlaylistFormat::CUE, tracks));
+    ASSERT_EQ(back.size(), 3u);
+    EXPECT_EQ(back[0].location, "album.flac");
+    EXPECT_EQ(back[0].end, 13660u);
+    EXPECT_EQ(back[1].start, 13660u);
+    EXPECT_EQ(back[1].end, 0u);
+    EXPECT_EQ(back[1].title, "Say 'hi'");
+    EXPECT_EQ(back[2].location, "other.flac");
+}
+
+TEST(PlaylistFormatTest, FileUris) {
+    EXPECT_EQ(file_uri_to_path("file:///music/a%20b.flac"), "/music/a b.flac");
+    EXPECT_EQ(file_uri_to_path("file://localhost/x"), "/x");
+    EXPECT_EQ(file_uri_to_path("file:///C:/Music/x.mp3"), "C:/Music/x.mp3");
+    EXPECT_EQ(file_uri_to_path("file://server/share/x.mp3"), "//server/share/x.mp3");
+    EXPECT_EQ(path_to_uri("/music/a b#.flac"), "file:///music/a%20b%23.flac");
+    EXPECT_EQ(path_to_uri("C:\\Music\\x.mp3"), "file:///C:/Music/x.mp3");
+    EXPECT_EQ(path_to_uri("rel/a b.mp3"), "rel/a%20b.mp3");
+    EXPECT_TRUE(is_url("https://x/y"));
+    EXPECT_FALSE(is_url("C://x"));
+    EXPECT_FALSE(is_url("/a://b"));
+}
+
+TEST_F(PlaylistFilesTest, ResolverFixesCaseAndRelativePaths) {
+    write_file(dir_ / "Music" / "Album" / "Track.FLAC", "x");
+    for (int i = 0; i < 6; ++i) {
+        write_file(dir_ / "Music" / "Many" / (std::to_string(i) + ".mp3"), "x");
+    }
+
+    std::vector<std::string> locations = {
+        "Album/Track.FLAC",
+        "album/track.flac",                 // Directory case is not fixed
+        "./Album/track.flac",
+        "..\\Music\\Album\\Track.FLAC",
+        "file://" + path("Music/Album/Track.FLAC"),
+        "Album/missing.flac",
+        "http://example.com/x.mp3",
+    };
+    for (int i = 0; i < 6; ++i) {
+        locations.push_back("Many/" + std::to_string(i) + ".mp3");
+    }
+
+    PathResolver resolver(3);
+    auto resolved = resolver.resolve(locations, path("Music"));
+    ASSERT_EQ(resolved.size(), locations.size());
+    const std::string track = path("Music/Album/Track.FLAC");
+    EXPECT_EQ(resolved[0].path, track);
+    EXPECT_TRUE(resolved[0].exists);
+    EXPECT_FALSE(resolved[1].exists);
+    EXPECT_EQ(resolved[2].path, track);
+    EXPECT_TRUE(resolved[2].exists);
+    EXPECT_EQ(resolved[3].path, track);
+    EXPECT_EQ(resolved[4].path, track);
+    EXPECT_EQ(resolved[5].path, path("Music/Album/missing.flac"));
+    EXPECT_FALSE(resolved[5].exists);
+    EXPECT_TRUE(resolved[6].is_url);
+    EXPECT_TRUE(resolved[6].exists);
+    for (size_t i = 7; i < resolved.size(); ++i) {
+        EXPECT_TRUE(resolved[i].exists) << locations[i];
+    }
+    // "Many" is listed rather than stat'ed file by file
+    uint64_t listed = resolver.directories_listed();
+    EXPECT_GE(listed, 2u);
+    EXPECT_LT(resolver.files_checked(), 6u + 5u);
+
+    // Listings are reused
+    resolver.resolve({"Many/0.mp3", "Many/1.mp3", "Many/2.mp3", "Many/3.mp3"}, path("Music"));
+    EXPECT_EQ(resolver.directories_listed(), listed);
+}
+
+TEST_F(PlaylistFilesTest, ImportsCueTracksAsRanges) {
+    write_file(dir_ / "music" / "album.wav", make_wav(48000, 48000));
+    write_file(dir_ / "music" / "album.cue",
+               "FILE \"ALBUM.wav\" WAVE\n"
+               "  TRACK 01 AUDIO\n    INDEX 01 00:00:00\n"
+               "  TRACK 02 AUDIO\n    TITLE \"Two\"\n    INDEX 01 00:00:30\n"
+               "FILE \"gone.wav\" WAVE\n"
+               "  TRACK 03 AUDIO\n    INDEX 01 00:01:00\n");
+    const std::string config = path("config");
+    const std::string wav = path("music/album.wav");
+
+    uint64_t id;
+    {
+        PlaylistManager manager;
+        ASSERT_EQ(manager.initialize(config.c_str()), Result::Success);
+        PlaylistImportStats stats;
+        ASSERT_EQ(manager.import_playlist(path("music/album.cue").c_str(), nullptr, &id, &stats),
+                  Result::Success);
+        EXPECT_EQ(stats.entries, 3u);
+        EXPECT_EQ(stats.missing, 1u);
+        EXPECT_EQ(stats.sub_tracks, 3u);
+
+        const Playlist* playlist = manager.get_playlist(id);
+        ASSERT_NE(playlist, nullptr);
+        EXPECT_EQ(playlist->name, "album");
+        ASSERT_EQ(playlist->tracks.size(), 3u);
+        // Kept in CD frames, whether or not the file can be read
+        EXPECT_EQ(playlist->tracks[0].file_path, wav);
+        EXPECT_EQ(playlist->tracks[0].range_start, 0u);
+        EXPECT_EQ(playlist->tracks[0].range_end, 30u);
+        EXPECT_EQ(playlist->tracks[0].range_rate, 75u);
+        EXPECT_EQ(playlist->tracks[1].range_start, 30u);
+        EXPECT_EQ(playlist->tracks[1].range_end, 0u);
+        EXPECT_EQ(playlist->tracks[2].file_path, path("music/gone.wav"));
+        EXPECT_EQ(playlist->tracks[2].range_start, 75u);
+        EXPECT_EQ(playlist->tracks[2].range_rate, 75u);
+
+        ASSERT_EQ(manager.export_playlist(id, path("music/out.cue").c_str()), Result::Success);
+        ASSERT_EQ(manager.export_playlist(id, path("out.m3u8").c_str()), Result::Success);
+        ASSERT_EQ(manager.export_json(id, path("out.json").c_str()), Result::Success);
+        EXPECT_EQ(manager.export_playlist(id, path("out.txt").c_str()), Result::NotSupported);
+    }
+
+    // Ranges survive a restart, and a JSON round trip
+    PlaylistManager manager;
+    ASSERT_EQ(manager.initialize(config.c_str()), Result::Success);
+    const Playlist* reloaded = manager.get_playlist(id);
+    ASSERT_NE(reloaded, nullptr);
+    ASSERT_EQ(reloaded->tracks.size(), 3u);
+    EXPECT_EQ(reloaded->tracks[0].range_end, 30u);
+    EXPECT_EQ(reloaded->tracks[1].range_start, 30u);
+    EXPECT_EQ(reloaded->tracks[2].range_rate, 75u);
+
+    ASSERT_EQ(manager.import_json(path("out.json").c_str()), Result::Success);
+    const Playlist& copy = manager.get_all_playlists().back();
+    ASSERT_EQ(copy.tracks.size(), 3u);
+    EXPECT_EQ(copy.tracks[1].range_start, 30u);
+    EXPECT_EQ(copy.tracks[1].range_rate, 75u);
+
+    // Written relative to the sheet, back in CD frames
+    auto cue = parse(PlaylistFormat::CUE, read_file(dir_ / "music" / "out.cue"));
+    ASSERT_EQ(cue.size(), 3u);
+    EXPECT_EQ(cue[0].location, "album.wav");
+    EXPECT_EQ(cue[0].end, 30u);
+    EXPECT_EQ(cue[1].start, 30u);
+    EXPECT_EQ(cue[2].location, "gone.wav");
+    EXPECT_EQ(cue[2].start, 75u);
+
+    auto m3u = parse(PlaylistFormat::M3U, read_file(dir_ / "out.m3u8"));
+    ASSERT_EQ(m3u.size(), 3u);
+    EXPECT_EQ(m3u[0].location, "music/album.wav");
+}
+
+namespace {
+
+// Stereo float at 48 kHz where sample n of either channel holds n
+class RampDecoder : public IDecoder {
+public:
+    RampDecoder(uint64_t total, bool exact_seek) : total_(total), exact_seek_(exact_seek) {}
+
+    int probe_file(const void*, size_t) override { return 0; }
+    const char** get_extensions() const override { return nullptr; }
+
+    Result open_stream(const char*, DecoderHandle* handle) override {
+        position_ = 0;
+        handle->internal = this;
+        return Result::Success;
+    }
+
+    Result get_stream_info(DecoderHandle, AudioStreamInfo* info) override {
+        info->sample_rate = 48000;
+        info->channels = 2;
+        info->format = SampleFormat::Float32;
+        info->total_samples = total_;
+        info->duration_ms = total_ / 48;
+        info->bitrate = 0;
+        return Result::Success;
+    }
+
+    Result decode_block(DecoderHandle, void* buffer, size_t buffer_size, size_t* samples_decoded) override {
+        size_t frames = std::min<uint64_t>(buffer_size / (2 * sizeof(float)), total_ - position_);
+        float* out = static_cast<float*>(buffer);
+        for (size_t i = 0; i < frames; ++i) {
+            out[2 * i] = out[2 * i + 1] = static_cast<float>(position_ + i);
+        }
+        position_ += frames;
+        decoded_ += frames;
+        *samples_decoded = frames;
+        return Result::Success;
+    }
+
+    Result seek(DecoderHandle, uint64_t position_ms, uint64_t* actual_position) override {
+        // An inexact decoder lands on the second before
+        uint64_t ms = exact_seek_ ? position_ms : position_ms / 1000 * 1000;
+        position_ = ms * 48;
+        *actual_position = ms;
+        seeks_.push_back(position_ms);
+        return Result::Success;
+    }
+
+    Result get_metadata(DecoderHandle, const MetadataTag**, size_t* count) override {
+        *count = 0;
+        return Result::Success;
+    }
+
+    void close_stream(DecoderHandle) override {}
+
+    uint64_t decoded() const { return decoded_; }
+    const std::vector<uint64_t>& seeks() const { return seeks_; }
+
+private:
+    uint64_t total_;
+    bool exact_seek_;
+    uint64_t position_ = 0;
+    uint64_t decoded_ = 0;
+    std::vector<uint64_t> seeks_;
+};
+
+// Rendered by hand through the callback play() registers
+class NullOutput : public IAudioOutput {
+public:
+    Result enumerate_devices(const AudioDeviceInfo**, size_t* count) override {
+        *count = 0;
+        return Result::Success;
+    }
+    Result open(const AudioOutputConfig& config) override {
+        callback = config.callback;
+        user_data = config.user_data;
+        return Result::Success;
+    }
+    Result start() override { return Result::Success; }
+    Result stop() override { return Result::Success; }
+    void close() override {}
+    uint32_t get_latency() const override { return 0; }
+    Result set_volume(float) override { return Result::Success; }
+    float get_volume() const override { return 1.0f; }
+
+    // What the device would call for each buffer
+    AudioCallback callback = nullptr;
+    void* user_data = nullptr;
+};
+
+// Every non-silent left-channel sample the engine renders until it stops
+std::vector<float> play_range(RampDecoder& decoder, const TrackRange& range) {
+    NullOutput output;
+    PlaybackEngine engine;
+    EXPECT_EQ(engine.initialize(&output), Result::Success);
+    EXPECT_EQ(engine.load_track("range.raw", &decoder, range), Result::Success);
+    EXPECT_EQ(engine.play(), Result::Success);
+
+    std::vector<float> played;
+    std::vector<float> buffer(512 * 2);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (engine.get_state() == PlaybackState::Playing && std::chrono::steady_clock::now() < deadline) {
+        output.callback(buffer.data(), 512, output.user_data);
+        bool silent = true;
+        for (size_t i = 0; i < 512; ++i) {
+            if (buffer[2 * i] != 0.0f) {
+                played.push_back(buffer[2 * i]);
+                silent = false;
+            }
+        }
+        if (silent) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    engine.shutdown();
+    return played;
+}
+
+} // namespace
+
+TEST(PlaybackRangeTest, PlaysExactlyTheRange) {
+    const uint64_t start = 100000, end = 114400;
+    for (bool exact_seek : {true, false}) {
+        RampDecoder decoder(200000, exact_seek);
+        std::vector<float> played = play_range(decoder, TrackRange(start, end));
+        ASSERT_EQ(played.size(), end - start) << "exact seek " << exact_seek;
+        for (size_t i = 0; i < played.size(); ++i) {
+            ASSERT_EQ(played[i], static_cast<float>(start + i)) << "at " << i;
+        }
+        // Seeks to a millisecond on the sample grid: 2083 ms = sample 99984
+        ASSERT_FALSE(decoder.seeks().empty());
+        EXPECT_EQ(decoder.seeks()[0], 2083u);
+        if (exact_seek) {
+            EXPECT_LT(decoder.decoded(), 200000u - start);
+        }
+    }
+}
+
+TEST(PlaybackRangeTest, ConvertsCdFramesAtTheStreamRate) {
+    // Frames 150 to 180 of a 48 kHz stream: 640 samples each
+    RampDecoder decoder(200000, true);
+    std::vector<float> played = play_range(decoder, TrackRange(150, 180, 75));
+    ASSERT_EQ(played.size(), 30u * 640);
+    EXPECT_EQ(played.front(), 150.0f * 640);
+    EXPECT_EQ(played.back(), 180.0f * 640 - 1);
+}
@@ -0,0 +1,284 @@
+﻿#include "../core/playlist_manager.h"
+#include "../core/playlist_store.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace mp;
+using namespace mp::core;
+
+namespace {
+
+namespace fs = std::filesystem;
+
+class PlaylistStoreTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir_ = ::testing::TempDir() + "playlist_store_test";
+        fs::remove_all(dir_);
+        fs::create_directories(dir_ + "/playlists");
+        db_ = dir_ + "/playlists/playlists.db";
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        fs::remove_all(dir_, ec);
+    }
+
+    std::vector<std::string> paths(const Playlist& playlist) const {
+        std::vector<std::string> out;
+        for (const auto& track : playlist.tracks) out.push_back(track.file_path);
+        return out;
+    }
+
+    std::string dir_;
+    std::string db_;
+};
+
+} // namespace
+
+TEST_F(PlaylistStoreTest, EditsSurviveRestart) {
+    uint64_t rock, jazz;
+    {
+        PlaylistManager manager;
+        ASSERT_EQ(manager.initialize(dir_.c_str()), Result::Success);
+        ASSERT_EQ(manager.create_playlist("Rock", &rock), Result::Success);
+        ASSERT_EQ(manager.create_playlist("Jazz", &jazz), Result::Success);
+        const char* tracks[] = {"/m/a.flac", "/m/b.flac", "/m/c.flac", "/m/d.flac"};
+        ASSERT_EQ(manager.add_tracks(rock, tracks, 4), Result::Success);
+        ASSERT_EQ(manager.add_track(rock, "/m/b.flac"), Result::Success);
+        ASSERT_EQ(manager.move_track(rock, 0, 3), Result::Success);
+        ASSERT_EQ(manager.remove_track(rock, 0), Result::Success);
+        ASSERT_EQ(manager.remove_tracks_by_path(rock, "/m/d.flac"), Result::Success);
+        ASSERT_EQ(manager.add_track(jazz, "/m/a.flac"), Result::Success);
+        ASSERT_EQ(manager.rename_playlist(jazz, "Jazz \"Standards\""), Result::Success);
+        ASSERT_EQ(manager.clear_playlist(jazz), Result::Success);
+        ASSERT_EQ(manager.add_track(jazz, "/m/e.flac"), Result::Success);
+        // No shutdown: every edit is already on disk
+        PlaylistManager reader;
+        ASSERT_EQ(reader.initialize(dir_.c_str()), Result::Success);
+        ASSERT_EQ(reader.get_all_playlists().size(), 2u);
+        EXPECT_EQ(paths(*reader.get_playlist(rock)), paths(*manager.get_playlist(rock)));
+        EXPECT_EQ(paths(*reader.get_playlist(rock)), (std::vector<std::string>{"/m/c.flac", "/m/a.flac", "/m/b.flac"}));
+        EXPECT_EQ(reader.get_playlist(jazz)->name, "Jazz \"Standards\"");
+        EXPECT_EQ(paths(*reader.get_playlist(jazz)), std::vector<std::string>{"/m/e.flac"});
+        EXPECT_EQ(reader.get_playlist(rock)->modification_time, manager.get_playlist(rock)->modification_time);
+    }
+
+    PlaylistManager manager;
+    ASSERT_EQ(manager.initialize(dir_.c_str()), Result::Success);
+    ASSERT_EQ(manager.delete_playlist(rock), Result::Success);
+    uint64_t pop;
+    ASSERT_EQ(manager.create_playlist("Pop", &pop), Result::Success);
+    EXPECT_GT(pop, jazz);
+    manager.shutdown();
+
+    ASSERT_EQ(manager.initialize(dir_.c_str()), Result::Success);
+    ASSERT_EQ(manager.get_all_playlists().size(), 2u);
+    EXPECT_EQ(manager.get_all_playlists()[0].id, jazz);
+    EXPECT_EQ(manager.get_all_playlists()[1].id, pop);
+    EXPECT_EQ(manager.get_playlist(rock), nullptr);
+}
+
+TEST_F(PlaylistStoreTest, OneTrackEditAppendsASmallRecord) {
+    PlaylistManager manager;
+    ASSERT_EQ(manager.initialize(dir_.c_str()), Result::Success);
+    uint64_t id;
+    ASSERT_EQ(manager.create_playlist("Big", &id), Result::Success);
+    std::vector<std::string> names;
+    for (int i = 0; i < 5000; ++i) names.push_back("/music/library/track" + std::to_string(i) + ".flac");
+    std::vector<const char*> tracks;
+    for (const auto& name : names) tracks.push_back(name.c_str());
+    ASSERT_EQ(manager.add_tracks(id, tracks.data(), tracks.size()), Result::Success);
+
+    auto before = fs::file_size(db_);
+    ASSERT_EQ(manager.add_track(id, names[10].c_str()), Result::Success);   // Path already interned
+    EXPECT_LT(fs::file_size(db_) - before, 64u);
+    before = fs::file_size(db_);
+    ASSERT_EQ(manager.move_track(id, 4000, 2), Result::Success);
+    EXPECT_LT(fs::file_size(db_) - before, 64u);
+}
+
+TEST_F(PlaylistStoreTest, TornTailIsDropped) {
+    std::vector<Playlist> playlists;
+    {
+        PlaylistStore store;
+        ASSERT_TRUE(store.open(db_, playlists));
+        Playlist playlist;
+        playlist.id = 7;
+        playlist.name = "Seven";
+        ASSERT_TRUE(store.put_playlist(playlist));
+        TrackReference track("/m/a.flac");
+        ASSERT_TRUE(store.insert_tracks(7, 1, 0, &track, 1));
+        ASSERT_TRUE(store.commit(playlists));
+    }
+    auto good_size = fs::file_size(db_);
+    {
+        PlaylistStore store;
+        ASSERT_TRUE(store.open(db_, playlists));
+        TrackReference track("/m/b.flac");
+        ASSERT_TRUE(store.insert_tracks(7, 2, 1, &track, 1));
+        ASSERT_TRUE(store.commit(playlists));
+    }
+    // A crash halfway through the second append
+    fs::resize_file(db_, fs::file_size(db_) - 5);
+
+    PlaylistStore store;
+    ASSERT_TRUE(store.open(db_, playlists));
+    ASSERT_EQ(playlists.size(), 1u);
+    EXPECT_EQ(paths(playlists[0]), std::vector<std::string>{"/m/a.flac"});
+    // The string record for /m/b.flac survived; the insert did not
+    EXPECT_GT(fs::file_size(db_), good_size);
+
+    TrackReference track("/m/c.flac");
+    ASSERT_TRUE(store.insert_tracks(7, 3, 1, &track, 1));
+    store.close();
+    ASSERT_TRUE(store.open(db_, playlists));
+    EXPECT_EQ(paths(playlists[0]), (std::vector<std::string>{"/m/a.flac", "/m/c.flac"}));
+    EXPECT_EQ(playlists[0].modification_time, 3u);
+}
+
+TEST_F(PlaylistStoreTest, UnreadableStoreIsSetAside) {
+    std::vector<Playlist> playlists;
+    {
+        PlaylistStore store;
+        ASSERT_TRUE(store.open(db_, playlists));
+        Playlist playlist;
+        playlist.id = 7;
+        playlist.name = "Seven";
+        ASSERT_TRUE(store.put_playlist(playlist));
+    }
+    // A header this build does not understand
+    {
+        std::fstream file(db_, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(4);
+        file.put('\x7f');
+    }
+    auto old_size = fs::file_size(db_);
+
+    PlaylistStore store;
+    ASSERT_TRUE(store.open(db_, playlists));
+    EXPECT_TRUE(playlists.empty());
+    EXPECT_EQ(fs::file_size(db_ + ".bad"), old_size);
+    EXPECT_LT(fs::file_size(db_), old_size);
+}
+
+TEST_F(PlaylistStoreTest, VersionOneStoreIsUpgraded) {
+    std::vector<Playlist> playlists;
+    {
+        PlaylistStore store;
+        ASSERT_TRUE(store.open(db_, playlists));
+        Playlist playlist;
+        playlist.id = 7;
+        playlist.name = "Seven";
+        ASSERT_TRUE(store.put_playlist(playlist));
+        TrackReference track("/m/a.flac");
+        ASSERT_TRUE(store.insert_tracks(7, 1, 0, &track, 1));
+    }
+    auto read_version = [&] {
+        std::ifstream file(db_, std::ios::binary);
+        uint32_t version = 0;
+        file.seekg(4);
+        file.read(reinterpret_cast<char*>(&version), sizeof(version));
+        return version;
+    };
+    uint32_t current = read_version();
+    // Without sub-track ranges the records are those of version 1
+    {
+        std::fstream file(db_, std::ios::binary | std::ios::in | std::ios::out);
+        uint32_t version = 1;
+        file.seekp(4);
+        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    }
+
+    PlaylistStore store;
+    ASSERT_TRUE(store.open(db_, playlists));
+    ASSERT_EQ(playlists.size(), 1u);
+    EXPECT_EQ(paths(playlists[0]), std::vector<std::string>{"/m/a.flac"});
+    EXPECT_GT(current, 1u);
+    EXPECT_EQ(read_version(), current);
+    EXPECT_FALSE(fs::exists(db_ + ".bad"));
+}
+
+TEST_F(PlaylistStoreTest, CompactionKeepsOnlyLiveData) {
+    PlaylistManager manager;
+    ASSERT_EQ(manager.initialize(dir_.c_str()), Result::Success);
+    uint64_t id;
+    ASSERT_EQ(manager.create_playlist("Churn", &id), Result::Success);
+    for (int round = 0; round < 40; ++round) {
+        std::vector<std::string> names;
+        for (int i = 0; i < 500; ++i) {
+            names.push_back("/music/round" + std::to_string(round) + "/" + std::to_string(i) + ".flac");
+        }
+        std::vector<const char*> tracks;
+        for (const auto& name : names) tracks.push_back(name.c_str());
+        ASSERT_EQ(manager.clear_playlist(id), Result::Success);
+        ASSERT_EQ(manager.add_tracks(id, tracks.data(), tracks.size()), Result::Success);
+    }
+    // Compacted along the way: far less than 40 rounds of paths
+    EXPECT_LT(fs::file_size(db_), 200u * 1024);
+    std::vector<std::string> expected = paths(*manager.get_playlist(id));
+    manager.shutdown();
+
+    PlaylistStore store;
+    std::vector<Playlist> playlists;
+    ASSERT_TRUE(store.open(db_, playlists));
+    ASSERT_TRUE(store.compact(playlists));
+    EXPECT_EQ(store.journal_bytes(), 0u);
+    store.close();
+    ASSERT_TRUE(store.open(db_, playlists));
+    ASSERT_EQ(playlists.size(), 1u);
+    EXPECT_EQ(paths(playlists[0]), expected);
+    EXPECT_EQ(expected.front(), "/music/round39/0.flac");
+}
+
+TEST_F(PlaylistStoreTest, JsonAndM3uRoundTrip) {
+    PlaylistManager manager;
+    ASSERT_EQ(manager.initialize(dir_.c_str()), Result::Success);
+    uint64_t id;
+    ASSERT_EQ(manager.create_playlist("Say \"hi\" \\ bye", &id), Result::Success);
+    ASSERT_EQ(manager.add_track(id, "C:\\Music\\\"quoted\".flac"), Result::Success);
+    ASSERT_EQ(manager.add_track(id, "/m/tab\there/\xC3\xA9t\xC3\xA9.flac"), Result::Success);
+    std::string json = dir_ + "/out.json";
+    ASSERT_EQ(manager.export_json(id, json.c_str()), Result::Success);
+    ASSERT_EQ(manager.import_json(json.c_str()), Result::Success);
+
+    const auto& all = manager.get_all_playlists();
+    ASSERT_EQ(all.size(), 2u);
+    EXPECT_NE(all[1].id, id);      // ID was taken
+    EXPECT_EQ(all[1].name, all[0].name);
+    EXPECT_EQ(paths(all[1]), paths(all[0]));
+
+    std::string m3u = dir_ + "/list.m3u";
+    {
+        std::ofstream out(m3u, std::ios::binary);
+        out << "#EXTM3U\r\n#EXTINF:1,x\r\n/m/one.mp3\r\n\r\n/m/two.mp3\r\n";
+    }
+    ASSERT_EQ(manager.import_m3u(m3u.c_str(), "Imported"), Result::Success);
+    EXPECT_EQ(paths(manager.get_all_playlists()[2]), (std::vector<std::string>{"/m/one.mp3", "/m/two.mp3"}));
+}
+
+TEST_F(PlaylistStoreTest, MigratesLegacyJsonFiles) {
+    {
+        std::ofstream out(dir_ + "/playlists/Old.json");
+        out << "{\n  \"id\": 12,\n  \"name\": \"Old \\u00e9\",\n  \"creation_time\": 5,\n"
+               "  \"modification_time\": 6,\n  \"tracks\": [\n"
+               "    { \"file_path\": \"/m/x.flac\", \"metadata_hash\": 0, \"added_time\": 5 }\n  ]\n}\n";
+    }
+    {
+        PlaylistManager manager;
+        ASSERT_EQ(manager.initialize(dir_.c_str()), Result::Success);
+        ASSERT_NE(manager.get_playlist(12), nullptr);
+        EXPECT_EQ(manager.get_playlist(12)->name, "Old \xC3\xA9");
+        uint64_t id;
+        ASSERT_EQ(manager.create_playlist("New", &id), Result::Success);
+        EXPECT_EQ(id, 13u);
+    }
+    // Imported once; the store is authoritative from then on
+    PlaylistManager manager;
+    ASSERT_EQ(manager.initialize(dir_.c_str()), Result::Success);
+    EXPECT_EQ(manager.get_all_playlists().size(), 2u);
+    EXPECT_EQ(paths(*manager.get_playlist(12)), std::vector<std::string>{"/m/x.flac"});
+}
@@ -0,0 +1,252 @@
+﻿#include "../core/realtime_guard.h"
+#include "../core/playback_engine.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace mp;
+using namespace mp::core;
+
+namespace {
+
+// Counted by a handler that must not allocate itself
+std::atomic<int> allocations{0};
+std::atomic<int> deallocations{0};
+std::atomic<int> locks{0};
+
+void count_violation(rt::Violation violation, const char*) {
+    switch (violation) {
+    case rt::Violation::HeapAllocation: ++allocations; break;
+    case rt::Violation::HeapDeallocation: ++deallocations; break;
+    case rt::Violation::LockAcquired: ++locks; break;
+    }
+}
+
+class RealtimeGuardTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+#if !MP_REALTIME_CHECKS
+        GTEST_SKIP() << "real-time checks are compiled out of this build";
+#endif
+        allocations = deallocations = locks = 0;
+        rt::set_violation_handler(&count_violation);
+    }
+
+    void TearDown() override {
+        rt::set_violation_handler(nullptr);
+    }
+
+    static int violations() { return allocations + deallocations + locks; }
+};
+
+struct alignas(64) CacheLine {
+    float values[16];
+};
+
+// Stereo float at 48 kHz where sample n of either channel holds n + 1
+class RampDecoder : public IDecoder {
+public:
+    explicit RampDecoder(uint64_t total) : total_(total) {}
+
+    int probe_file(const void*, size_t) override { return 0; }
+    const char** get_extensions() const override { return nullptr; }
+
+    Result open_stream(const char*, DecoderHandle* handle) override {
+        position_ = 0;
+        handle->internal = this;
+        return Result::Success;
+    }
+
+    Result get_stream_info(DecoderHandle, AudioStreamInfo* info) override {
+        info->sample_rate = 48000;
+        info->channels = 2;
+        info->format = SampleFormat::Float32;
+        info->total_samples = total_;
+        info->duration_ms = total_ / 48;
+        info->bitrate = 0;
+        return Result::Success;
+    }
+
+    Result decode_block(DecoderHandle, void* buffer, size_t buffer_size, size_t* samples_decoded) override {
+        size_t frames = std::min<uint64_t>(buffer_size / (2 * sizeof(float)), total_ - position_);
+        float* out = static_cast<float*>(buffer);
+        for (size_t i = 0; i < frames; ++i) {
+            out[2 * i] = out[2 * i + 1] = static_cast<float>(position_ + i + 1);
+        }
+        position_ += frames;
+        *samples_decoded = frames;
+        return Result::Success;
+    }
+
+    Result seek(DecoderHandle, uint64_t position_ms, uint64_t* actual_position) override {
+        position_ = std::min(position_ms * 48, total_);
+        *actual_position = position_ / 48;
+        return Result::Success;
+    }
+
+    Result get_metadata(DecoderHandle, const MetadataTag**, size_t* count) override {
+        *count = 0;
+        return Result::Success;
+    }
+
+    void close_stream(DecoderHandle) override {}
+
+private:
+    uint64_t total_;
+    uint64_t position_ = 0;
+};
+
+// Rendered by hand through the callback play() registers
+class NullOutput : public IAudioOutput {
+public:
+    Result enumerate_devices(const AudioDeviceInfo**, size_t* count) override {
+        *count = 0;
+        return Result::Success;
+    }
+    Result open(const AudioOutputConfig& config) override {
+        callback = config.callback;
+        user_data = config.user_data;
+        return Result::Success;
+    }
+    Result start() override { return Result::Success; }
+    Result stop() override { return Result::Success; }
+    void close() override {}
+    uint32_t get_latency() const override { return 0; }
+    Result set_volume(float) override { return Result::Success; }
+    float get_volume() const override { return 1.0f; }
+
+    // One device buffer; true if any of it was not silent
+    bool render(std::vector<float>& buffer) {
+        return render(callback, user_data, buffer);
+    }
+
+    static bool render(AudioCallback callback, void* user_data, std::vector<float>& buffer) {
+        callback(buffer.data(), buffer.size() / 2, user_data);
+        for (float sample : buffer) {
+            if (sample != 0.0f) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    AudioCallback callback = nullptr;
+    void* user_data = nullptr;
+};
+
+} // namespace
+
+TEST_F(RealtimeGuardTest, HeapUseInsideScopeIsReported) {
+    void* outside = ::operator new(32);
+    ::operator delete(outside);
+    EXPECT_EQ(violations(), 0);
+
+    {
+        rt::RealtimeScope realtime;
+        void* block = ::operator new(32);
+        ::operator delete(block);
+        EXPECT_EQ(allocations, 1);
+        EXPECT_EQ(deallocations, 1);
+
+        // The align_val_t overloads are hooked too
+        CacheLine* line = new CacheLine();
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(line) % alignof(CacheLine), 0u);
+        delete line;
+        void* raw = ::operator new[](100, std::align_val_t(128), std::nothrow);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(raw) % 128, 0u);
+        ::operator delete[](raw, std::align_val_t(128));
+        EXPECT_EQ(allocations, 3);
+        EXPECT_EQ(deallocations, 3);
+
+        {
+            rt::NonRealtimeScope allowed;
+            std::vector<int> scratch(64);
+        }
+        EXPECT_EQ(allocations, 3);
+    }
+}
+
+TEST_F(RealtimeGuardTest, CheckedMutexInsideScopeIsReported) {
+    rt::CheckedMutex mutex;
+    { std::lock_guard<rt::CheckedMutex> lock(mutex); }
+    EXPECT_EQ(locks, 0);
+
+    rt::RealtimeScope realtime;
+    { std::lock_guard<rt::CheckedMutex> lock(mutex); }
+    EXPECT_EQ(locks, 1);
+    ASSERT_TRUE(mutex.try_lock());
+    mutex.unlock();
+    EXPECT_EQ(locks, 2);
+}
+
+TEST_F(RealtimeGuardTest, RenderAcrossGaplessSpliceIsClean) {
+    RampDecoder first(20000), second(20000);
+    NullOutput output;
+    PlaybackEngine engine;
+    ASSERT_EQ(engine.initialize(&output), Result::Success);
+    ASSERT_EQ(engine.load_track("first.raw", &first), Result::Success);
+    ASSERT_EQ(engine.prepare_next_track("second.raw", &second), Result::Success);
+    ASSERT_EQ(engine.play(), Result::Success);
+
+    // The audio thread swaps the render target to the prepared track
+    std::vector<float> buffer(512 * 2);
+    size_t audible = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (engine.get_state() == PlaybackState::Playing && std::chrono::steady_clock::now() < deadline) {
+        if (output.render(buffer)) {
+            ++audible;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    engine.shutdown();
+
+    EXPECT_GE(audible, 40000u / 512);
+    EXPECT_EQ(violations(), 0);
+}
+
+TEST_F(RealtimeGuardTest, RenderWhileControlThreadSwapsTracksIsClean) {
+    RampDecoder first(480000), second(480000);
+    NullOutput output;
+    PlaybackEngine engine;
+    ASSERT_EQ(engine.initialize(&output), Result::Success);
+    ASSERT_EQ(engine.load_track("first.raw", &first), Result::Success);
+    ASSERT_EQ(engine.play(), Result::Success);
+
+    // play() reopens the output after each stop; the callback stays the same
+    AudioCallback callback = output.callback;
+    void* user_data = output.user_data;
+    std::atomic<bool> running{true};
+    std::atomic<size_t> audible{0};
+    std::thread audio([&] {
+        std::vector<float> buffer(256 * 2);
+        while (running) {
+            if (NullOutput::render(callback, user_data, buffer)) {
+                ++audible;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    });
+
+    // Each of these retires the render target and publishes a new one
+    for (int i = 0; i < 10; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        ASSERT_EQ(engine.stop(), Result::Success);
+        ASSERT_EQ(engine.load_track(i % 2 ? "first.raw" : "second.raw", i % 2 ? &first : &second),
+                  Result::Success);
+        ASSERT_EQ(engine.play(), Result::Success);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        ASSERT_EQ(engine.seek(1000), Result::Success);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    running = false;
+    audio.join();
+    engine.shutdown();
+
+    EXPECT_GT(audible.load(), 0u);
+    EXPECT_EQ(violations(), 0);
+}
@@ -0,0 +1,262 @@
+﻿#include "../src/audio/cubic_resampler.h"
+#include "../src/audio/sample_rate_converter.h"
+#include "../core/playback_engine.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace audio;
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+const uint32_t DEVICE_RATE = 48000;  // PlaybackEngine renders at this rate
+
+// Stereo sine: left at freq, right at half of it and inverted
+std::vector<float> stereo_tone(int rate, int frames, double freq) {
+    std::vector<float> tone(frames * 2);
+    for (int i = 0; i < frames; ++i) {
+        tone[i * 2] = static_cast<float>(0.5 * std::sin(2.0 * PI * freq * i / rate));
+        tone[i * 2 + 1] = static_cast<float>(-0.25 * std::sin(PI * freq * i / rate));
+    }
+    return tone;
+}
+
+// Convert stereo input fed in blocks of chunk frames
+std::vector<float> convert_in_chunks(ISampleRateConverter& converter, const std::vector<float>& input,
+                                     int chunk) {
+    const int frames = static_cast<int>(input.size() / 2);
+    std::vector<float> output(input.size() * 4 + 64);
+    int produced = 0;
+    for (int pos = 0; pos < frames; pos += chunk) {
+        int count = std::min(chunk, frames - pos);
+        produced += converter.convert(input.data() + pos * 2, count, output.data() + produced * 2,
+                                      static_cast<int>(output.size() / 2) - produced);
+    }
+    output.resize(produced * 2);
+    return output;
+}
+
+// Delay of a resampled sine in input frames, from its phase against the
+// undelayed sine over whole periods of the steady-state part of the output
+double measured_delay(const std::vector<float>& output, size_t channel, int input_rate, int output_rate,
+                      double freq, size_t skip) {
+    const double omega = 2.0 * PI * freq / input_rate;
+    const size_t period = static_cast<size_t>(std::llround(output_rate / freq));
+    const size_t end = skip + (output.size() / 2 - 2 * skip) / period * period;
+    double in_phase = 0.0;
+    double quadrature = 0.0;
+    for (size_t k = skip; k < end; ++k) {
+        double t = static_cast<double>(k) * input_rate / output_rate;
+        in_phase += output[k * 2 + channel] * std::sin(omega * t);
+        quadrature += output[k * 2 + channel] * std::cos(omega * t);
+    }
+    return std::atan2(-quadrature, in_phase) / omega;
+}
+
+void expect_chunking_is_transparent(ISampleRateConverter& converter, int input_rate, int output_rate) {
+    std::vector<float> input = stereo_tone(input_rate, input_rate / 4, 997.0);
+
+    ASSERT_TRUE(converter.initialize(input_rate, output_rate, 2));
+    std::vector<float> whole = convert_in_chunks(converter, input, static_cast<int>(input.size()));
+
+    for (int chunk : {1, 7, 333}) {
+        converter.reset();
+        std::vector<float> pieces = convert_in_chunks(converter, input, chunk);
+        ASSERT_EQ(pieces.size(), whole.size()) << "chunk " << chunk;
+        for (size_t i = 0; i < whole.size(); ++i) {
+            ASSERT_NEAR(pieces[i], whole[i], 1e-5f) << "chunk " << chunk << ", value " << i;
+        }
+    }
+}
+
+void expect_latency_is_group_delay(ISampleRateConverter& converter, int input_rate, int output_rate) {
+    // 100 Hz: one period is far longer than any converter's delay, and a
+    // whole number of output frames at the rates used here
+    const double freq = 100.0;
+    std::vector<float> input = stereo_tone(input_rate, input_rate, freq);
+
+    ASSERT_TRUE(converter.initialize(input_rate, output_rate, 2));
+    std::vector<float> output = convert_in_chunks(converter, input, 512);
+    ASSERT_GT(output.size(), static_cast<size_t>(output_rate));
+
+    double delay = measured_delay(output, 0, input_rate, output_rate, freq, 2000);
+    EXPECT_NEAR(delay, converter.get_latency(), 0.05) << input_rate << " -> " << output_rate;
+}
+
+// Stereo float sine at 44.1 kHz, handed out at most block frames per call
+class ToneDecoder : public mp::IDecoder {
+public:
+    ToneDecoder(uint64_t total, size_t block) : total_(total), block_(block) {}
+
+    int probe_file(const void*, size_t) override { return 0; }
+    const char** get_extensions() const override { return nullptr; }
+
+    mp::Result open_stream(const char*, mp::DecoderHandle* handle) override {
+        position_ = 0;
+        handle->internal = this;
+        return mp::Result::Success;
+    }
+
+    mp::Result get_stream_info(mp::DecoderHandle, mp::AudioStreamInfo* info) override {
+        info->sample_rate = RATE;
+        info->channels = 2;
+        info->format = mp::SampleFormat::Float32;
+        info->total_samples = total_;
+        info->duration_ms = total_ * 1000 / RATE;
+        info->bitrate = 0;
+        return mp::Result::Success;
+    }
+
+    mp::Result decode_block(mp::DecoderHandle, void* buffer, size_t buffer_size,
+                            size_t* samples_decoded) override {
+        size_t frames = std::min<uint64_t>(std::min(buffer_size / (2 * sizeof(float)), block_),
+                                           total_ - position_);
+        float* out = static_cast<float*>(buffer);
+        for (size_t i = 0; i < frames; ++i) {
+            out[2 * i] = out[2 * i + 1] = static_cast<float>(0.5 * std::sin(2.0 * PI * FREQ * (position_ + i) / RATE));
+        }
+        position_ += frames;
+        *samples_decoded = frames;
+        return mp::Result::Success;
+    }
+
+    mp::Result seek(mp::DecoderHandle, uint64_t position_ms, uint64_t* actual_position) override {
+        position_ = std::min(position_ms * RATE / 1000, total_);
+        *actual_position = position_ * 1000 / RATE;
+        return mp::Result::Success;
+    }
+
+    mp::Result get_metadata(mp::DecoderHandle, const mp::MetadataTag**, size_t* count) override {
+        *count = 0;
+        return mp::Result::Success;
+    }
+
+    void close_stream(mp::DecoderHandle) override {}
+
+    static constexpr uint32_t RATE = 44100;
+    static constexpr double FREQ = 100.0;
+
+private:
+    uint64_t total_;
+    size_t block_;
+    uint64_t position_ = 0;
+};
+
+class NullOutput : public mp::IAudioOutput {
+public:
+    mp::Result enumerate_devices(const mp::AudioDeviceInfo**, size_t* count) override {
+        *count = 0;
+        return mp::Result::Success;
+    }
+    mp::Result open(const mp::AudioOutputConfig& config) override {
+        callback = config.callback;
+        user_data = config.user_data;
+        return mp::Result::Success;
+    }
+    mp::Result start() override { return mp::Result::Success; }
+    mp::Result stop() override { return mp::Result::Success; }
+    void close() override {}
+    uint32_t get_latency() const override { return 0; }
+    mp::Result set_volume(float) override { return mp::Result::Success; }
+    float get_volume() const override { return 1.0f; }
+
+    mp::AudioCallback callback = nullptr;
+    void* user_data = nullptr;
+};
+
+// Everything the engine plays of a ToneDecoder track, once fully buffered
+std::vector<float> play_through_engine(const std::string& quality, size_t block, uint64_t frames) {
+    ToneDecoder decoder(frames, block);
+    NullOutput output;
+    mp::core::PlaybackEngine engine;
+    std::vector<float> played;
+    EXPECT_EQ(engine.initialize(&output), mp::Result::Success);
+
+    mp::core::ResamplerSettings settings;
+    settings.quality = quality;
+    engine.set_resampler_settings(settings);
+    engine.set_read_ahead(mp::core::ReadAheadConfig(16384, 4));
+    EXPECT_EQ(engine.load_track("tone.raw", &decoder), mp::Result::Success);
+
+    // Let the whole track reach the ring so no callback can underrun
+    const size_t expected = static_cast<size_t>(frames * DEVICE_RATE / ToneDecoder::RATE);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (engine.get_read_ahead_stats().fill_frames < expected &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(engine.play(), mp::Result::Success);
+
+    std::vector<float> buffer(480 * 2);
+    while (engine.get_state() == mp::core::PlaybackState::Playing && played.size() < expected * 4) {
+        output.callback(buffer.data(), 480, output.user_data);
+        played.insert(played.end(), buffer.begin(), buffer.end());
+    }
+    EXPECT_EQ(engine.get_read_ahead_stats().underruns, 0u);
+    engine.shutdown();
+
+    // The last callback is padded with silence after the end of the track
+    played.resize(std::min(played.size(), expected * 2));
+    return played;
+}
+
+} // namespace
+
+TEST(CubicResamplerTest, SmallBlocksMatchOneBlock) {
+    CubicSampleRateConverter upsampler;
+    expect_chunking_is_transparent(upsampler, 44100, 48000);
+    CubicSampleRateConverter downsampler;
+    expect_chunking_is_transparent(downsampler, 96000, 48000);
+}
+
+TEST(CubicResamplerTest, LatencyIsTheGroupDelay) {
+    CubicSampleRateConverter upsampler;
+    expect_latency_is_group_delay(upsampler, 44100, 48000);
+    // Downsampling adds the anti-aliasing filter's delay
+    CubicSampleRateConverter downsampler;
+    expect_latency_is_group_delay(downsampler, 96000, 48000);
+}
+
+TEST(LinearResamplerTest, SmallBlocksMatchOneBlock) {
+    LinearSampleRateConverter upsampler;
+    expect_chunking_is_transparent(upsampler, 44100, 48000);
+    LinearSampleRateConverter downsampler;
+    expect_chunking_is_transparent(downsampler, 96000, 48000);
+}
+
+TEST(LinearResamplerTest, LatencyIsTheGroupDelay) {
+    LinearSampleRateConverter upsampler;
+    expect_latency_is_group_delay(upsampler, 44100, 48000);
+    LinearSampleRateConverter downsampler;
+    expect_latency_is_group_delay(downsampler, 96000, 48000);
+}
+
+TEST(EngineResamplingTest, DecoderBlockSizeDoesNotChangeTheOutput) {
+    for (const char* quality : {"fast", "good", "high"}) {
+        std::vector<float> whole = play_through_engine(quality, 2048, 22050);
+        std::vector<float> pieces = play_through_engine(quality, 37, 22050);
+        ASSERT_EQ(whole.size(), 24000u * 2) << quality;
+        ASSERT_EQ(pieces.size(), whole.size()) << quality;
+        for (size_t i = 0; i < whole.size(); ++i) {
+            ASSERT_NEAR(pieces[i], whole[i], 1e-5f) << quality << ", value " << i;
+        }
+    }
+}
+
+TEST(EngineResamplingTest, ConverterDelayIsCompensated) {
+    // Only whole output frames can be dropped, so up to one remains
+    const double output_frame = static_cast<double>(ToneDecoder::RATE) / DEVICE_RATE;
+    for (const char* quality : {"fast", "good", "high"}) {
+        std::vector<float> played = play_through_engine(quality, 2048, 44100);
+        ASSERT_EQ(played.size(), 48000u * 2) << quality;
+        double delay = measured_delay(played, 0, ToneDecoder::RATE, DEVICE_RATE,
+                                      ToneDecoder::FREQ, 2000);
+        EXPECT_GE(delay, -0.05) << quality;
+        EXPECT_LT(delay, output_frame) << quality;
+    }
+}
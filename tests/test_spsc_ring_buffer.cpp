@@ -0,0 +1,82 @@
+﻿#include "../core/spsc_ring_buffer.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace mp::core;
+
+TEST(SpscRingBufferTest, CapacityRoundsUpToPowerOfTwo) {
+    SpscRingBuffer<float> ring(1000);
+    EXPECT_EQ(ring.capacity(), 1024u);
+    EXPECT_EQ(ring.read_available(), 0u);
+    EXPECT_EQ(ring.write_available(), 1024u);
+}
+
+TEST(SpscRingBufferTest, WriteStopsWhenFull) {
+    SpscRingBuffer<int> ring(8);
+    std::vector<int> data(12, 7);
+
+    EXPECT_EQ(ring.write(data.data(), data.size()), 8u);
+    EXPECT_EQ(ring.write(data.data(), 1), 0u);
+    EXPECT_EQ(ring.read_available(), 8u);
+}
+
+TEST(SpscRingBufferTest, ReadWrapsAround) {
+    SpscRingBuffer<int> ring(8);
+    int in[6] = {1, 2, 3, 4, 5, 6};
+    int out[6] = {};
+
+    ring.write(in, 6);
+    EXPECT_EQ(ring.read(out, 4), 4u);
+
+    // Next write crosses the end of the storage
+    ring.write(in, 6);
+    EXPECT_EQ(ring.read(out, 6), 6u);
+    EXPECT_EQ(out[0], 5);
+    EXPECT_EQ(out[1], 6);
+    EXPECT_EQ(out[2], 1);
+    EXPECT_EQ(out[5], 4);
+}
+
+TEST(SpscRingBufferTest, DiscardAndReset) {
+    SpscRingBuffer<int> ring(16);
+    int in[10] = {};
+
+    ring.write(in, 10);
+    EXPECT_EQ(ring.discard(4), 4u);
+    EXPECT_EQ(ring.read_available(), 6u);
+
+    ring.reset();
+    EXPECT_EQ(ring.read_available(), 0u);
+}
+
+TEST(SpscRingBufferTest, ConcurrentProducerConsumerPreservesOrder) {
+    SpscRingBuffer<uint32_t> ring(256);
+    const uint32_t total = 50000;
+
+    std::thread producer([&] {
+        uint32_t next = 0;
+        while (next < total) {
+            uint32_t block[32];
+            uint32_t n = std::min<uint32_t>(32, total - next);
+            for (uint32_t i = 0; i < n; ++i) {
+                block[i] = next + i;
+            }
+            next += static_cast<uint32_t>(ring.write(block, n));
+        }
+    });
+
+    uint32_t expected = 0;
+    bool in_order = true;
+    while (expected < total) {
+        uint32_t block[64];
+        size_t n = ring.read(block, 64);
+        for (size_t i = 0; i < n; ++i) {
+            in_order = in_order && block[i] == expected++;
+        }
+    }
+
+    producer.join();
+    EXPECT_TRUE(in_order);
+    EXPECT_EQ(ring.read_available(), 0u);
+}
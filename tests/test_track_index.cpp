@@ -0,0 +1,204 @@
+﻿#include "../core/track_index.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mp;
+using namespace mp::core;
+
+namespace {
+
+TrackMetadata make_track(const std::string& path, const std::string& title, const std::string& artist,
+                         const std::string& album, const std::string& date, const std::string& track_number,
+                         uint64_t duration_ms, const std::string& album_artist = std::string()) {
+    TrackMetadata track;
+    track.path = path;
+    track.sample_rate = 44100;
+    track.channels = 2;
+    track.duration_ms = duration_ms;
+    track.add("title", title);
+    track.add("artist", artist);
+    track.add("album", album);
+    track.add("date", date);
+    track.add("track_number", track_number);
+    track.add("genre", "Rock");
+    if (!album_artist.empty()) {
+        track.add("album_artist", album_artist);
+    }
+    return track;
+}
+
+class TrackIndexTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        index_.add(make_track("/m/3.flac", "Karma Police", "Radiohead", "OK Computer", "1997-05-21", "6", 264000));
+        index_.add(make_track("/m/1.flac", "Airbag", "Radiohead", "OK Computer", "1997", "1", 284000));
+        index_.add(make_track("/m/2.flac", "Paranoid Android", "Radiohead", "OK Computer", "1997", "2/12", 383000));
+        index_.add(make_track("/m/4.flac", "Everything In Its Right Place", "Radiohead", "Kid A", "2000", "1", 251000));
+        index_.add(make_track("/m/5.flac", "Teardrop", "Massive Attack", "Mezzanine", "1998", "3", 330000));
+        index_.add(make_track("/m/6.flac", "Angel", "massive attack", "Mezzanine", "1998", "1", 379000,
+                              "Massive Attack"));
+        index_.add(make_track("/m/7.flac", "Unfinished Sympathy", "Massive Attack feat. Shara Nelson",
+                              "Blue Lines", "1991", "5", 308000, "Massive Attack"));
+    }
+
+    std::vector<std::string> paths(const std::vector<TrackId>& ids) const {
+        std::vector<std::string> out;
+        for (TrackId id : ids) out.push_back(index_.path(id));
+        return out;
+    }
+
+    TrackIndex index_;
+};
+
+} // namespace
+
+TEST_F(TrackIndexTest, SubstringSearchIsCaseInsensitive) {
+    EXPECT_EQ(paths(index_.select(TrackQuery().contains("ANDROID"))), std::vector<std::string>{"/m/2.flac"});
+    // Matches album "Kid A", artist "Massive Attack" and titles with "a"
+    EXPECT_EQ(index_.select(TrackQuery().contains("a")).size(), 7u);
+    EXPECT_EQ(index_.select(TrackQuery().contains("mezz")).size(), 2u);
+    EXPECT_EQ(index_.select(TrackQuery().contains(TrackField::Title, "mezz")).size(), 0u);
+    EXPECT_EQ(index_.select(TrackQuery().contains("zzzz")).size(), 0u);
+    EXPECT_EQ(index_.select(TrackQuery().contains("shara")).size(), 1u);
+}
+
+TEST_F(TrackIndexTest, FiltersCombine) {
+    auto ids = index_.select(TrackQuery()
+                                 .equals(TrackField::Artist, "Radiohead")
+                                 .range(TrackField::Date, 19970000, 19979999)
+                                 .range(TrackField::DurationMs, 270000, UINT32_MAX));
+    EXPECT_EQ(paths(ids), (std::vector<std::string>{"/m/1.flac", "/m/2.flac"}));
+    EXPECT_TRUE(index_.select(TrackQuery().equals(TrackField::Artist, "Nobody")).empty());
+    EXPECT_EQ(index_.number(ids[1], TrackField::TrackNumber), 2u);
+}
+
+TEST_F(TrackIndexTest, SortsByAlbumArtistDateTrack) {
+    auto ids = index_.select(TrackQuery()
+                                 .sort_by(TrackField::AlbumArtist)
+                                 .sort_by(TrackField::Date)
+                                 .sort_by(TrackField::TrackNumber));
+    // album_artist falls back to artist; "Massive Attack" sorts before
+    // "Radiohead" whatever the case; 1997 < 1997-05-21
+    EXPECT_EQ(paths(ids), (std::vector<std::string>{"/m/7.flac", "/m/6.flac", "/m/5.flac", "/m/1.flac",
+                                                    "/m/2.flac", "/m/3.flac", "/m/4.flac"}));
+
+    ids = index_.select(TrackQuery().sort_by(TrackField::DurationMs, true).limit(2));
+    EXPECT_EQ(paths(ids), (std::vector<std::string>{"/m/2.flac", "/m/6.flac"}));
+}
+
+TEST_F(TrackIndexTest, GroupsInCollationOrder) {
+    auto groups = index_.group_by(TrackField::Album, TrackQuery().sort_by(TrackField::TrackNumber));
+    ASSERT_EQ(groups.size(), 4u);
+    EXPECT_EQ(groups[0].key, "Blue Lines");
+    EXPECT_EQ(groups[1].key, "Kid A");
+    EXPECT_EQ(groups[2].key, "Mezzanine");
+    EXPECT_EQ(groups[3].key, "OK Computer");
+    EXPECT_EQ(groups[3].duration_ms, 264000u + 284000u + 383000u);
+    EXPECT_EQ(paths(groups[3].tracks), (std::vector<std::string>{"/m/1.flac", "/m/2.flac", "/m/3.flac"}));
+
+    auto years = index_.group_by(TrackField::Date, TrackQuery().contains("radiohead"));
+    ASSERT_EQ(years.size(), 3u);
+    EXPECT_EQ(years[0].value, 19970000u);
+    EXPECT_EQ(years[1].value, 19970521u);
+    EXPECT_EQ(years[2].key, "20000000");
+}
+
+TEST_F(TrackIndexTest, ReplaceAndRemoveByPath) {
+    TrackId id;
+    ASSERT_TRUE(index_.find("/m/5.flac", id));
+    EXPECT_EQ(index_.add(make_track("/m/5.flac", "Teardrop (Live)", "Massive Attack", "Mezzanine", "1998", "3",
+                                    330000)), id);
+    EXPECT_EQ(index_.text(id, TrackField::Title), "Teardrop (Live)");
+    EXPECT_EQ(index_.select(TrackQuery().contains("live")).size(), 1u);
+
+    EXPECT_TRUE(index_.remove("/m/5.flac"));
+    EXPECT_FALSE(index_.remove("/m/5.flac"));
+    EXPECT_EQ(index_.size(), 6u);
+    EXPECT_TRUE(index_.select(TrackQuery().contains("teardrop")).empty());
+    EXPECT_EQ(index_.group_by(TrackField::Album)[2].tracks.size(), 1u);
+}
+
+TEST_F(TrackIndexTest, RemovedPathRevivesItsRow) {
+    TrackId id;
+    ASSERT_TRUE(index_.find("/m/5.flac", id));
+    ASSERT_TRUE(index_.remove("/m/5.flac"));
+    TrackId gone;
+    EXPECT_FALSE(index_.find("/m/5.flac", gone));
+    EXPECT_EQ(index_.dead_rows(), 1u);
+
+    EXPECT_EQ(index_.add(make_track("/m/5.flac", "Teardrop", "Massive Attack", "Mezzanine", "1998", "3",
+                                    330000)), id);
+    EXPECT_EQ(index_.size(), 7u);
+    EXPECT_EQ(index_.dead_rows(), 0u);
+    EXPECT_EQ(paths(index_.select(TrackQuery().contains("teardrop"))), std::vector<std::string>{"/m/5.flac"});
+}
+
+TEST(TrackIndexCompactionTest, CompactsOnceDeadRowsOutnumberLiveOnes) {
+    TrackIndex index;
+    for (int i = 0; i < 3000; ++i) {
+        std::string n = std::to_string(i);
+        index.add(make_track("/m/" + n + ".flac", "Song " + n, "Artist " + n, "Album", "2001", "1", 1000));
+    }
+    for (int i = 0; i < 2000; ++i) {
+        ASSERT_TRUE(index.remove("/m/" + std::to_string(i) + ".flac"));
+    }
+
+    // Compacted when the 1501st row died; the 499 removed since remain
+    EXPECT_EQ(index.size(), 1000u);
+    EXPECT_EQ(index.dead_rows(), 499u);
+
+    TrackId id;
+    EXPECT_FALSE(index.find("/m/0.flac", id));
+    ASSERT_TRUE(index.find("/m/2999.flac", id));
+    EXPECT_EQ(index.path(id), "/m/2999.flac");
+    EXPECT_EQ(index.text(id, TrackField::Artist), "Artist 2999");
+    EXPECT_EQ(index.number(id, TrackField::Date), 20010000u);
+
+    EXPECT_EQ(index.select(TrackQuery().contains(TrackField::Title, "song 2")).size(), 1000u);
+    EXPECT_TRUE(index.select(TrackQuery().equals(TrackField::Title, "Song 10")).empty());
+    ASSERT_EQ(index.select(TrackQuery().equals(TrackField::Title, "Song 2500")).size(), 1u);
+    EXPECT_EQ(index.group_by(TrackField::Artist).size(), 1000u);
+}
+
+TEST_F(TrackIndexTest, ConcurrentQueriesShareLazyRanks) {
+    index_.add(make_track("/m/8.flac", "Roads", "Portishead", "Dummy", "1994", "10", 305000));
+    std::vector<std::thread> readers;
+    std::vector<std::vector<TrackId>> results(4);
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([this, &results, i] {
+            results[i] = index_.select(TrackQuery().sort_by(TrackField::Artist).sort_by(TrackField::Title));
+        });
+    }
+    for (auto& t : readers) t.join();
+    for (const auto& r : results) {
+        EXPECT_EQ(r, results[0]);
+    }
+    // Case-insensitive ties fall back to byte order: "Massive Attack" first
+    EXPECT_EQ(index_.path(results[0][0]), "/m/5.flac");
+    EXPECT_EQ(index_.path(results[0][1]), "/m/6.flac");
+}
+
+TEST(TrackIndexStoreTest, BuildsFromMetadataStore) {
+    std::string db = ::testing::TempDir() + "track_index_store.db";
+    std::remove(db.c_str());
+    {
+        MetadataStore store;
+        ASSERT_TRUE(store.open(db));
+        store.put(make_track("/m/a.flac", "A", "X", "One", "2001", "1", 1000));
+        store.put(make_track("/m/b.flac", "B", "Y", "Two", "2002", "1", 2000));
+
+        TrackIndex index;
+        index.add(make_track("/m/stale.flac", "S", "Z", "Three", "2003", "1", 3000));
+        index.build(store);
+        EXPECT_EQ(index.size(), 2u);
+        TrackId id;
+        EXPECT_FALSE(index.find("/m/stale.flac", id));
+        ASSERT_TRUE(index.find("/m/b.flac", id));
+        EXPECT_EQ(index.number(id, TrackField::Date), 20020000u);
+        EXPECT_EQ(index.number(id, TrackField::SampleRate), 44100u);
+    }
+    std::remove(db.c_str());
+}
@@ -0,0 +1,184 @@
+﻿#include "../core/visualization_engine.h"
+#include "../core/seqlock.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace mp;
+
+namespace {
+
+VisualizationConfig make_config() {
+    VisualizationConfig config{};
+    config.waveform_width = 200;
+    config.waveform_time_span = 1.0f;
+    config.fft_size = 2048;
+    config.spectrum_bars = 30;
+    config.spectrum_min_freq = 20.0f;
+    config.spectrum_max_freq = 20000.0f;
+    config.spectrum_smoothing = 0.0f;
+    config.vu_peak_decay_rate = 10.0f;
+    config.vu_peak_hold_ms = 1000.0f;
+    config.vu_rms_window_ms = 100.0f;
+    config.update_rate_hz = 100;
+    return config;
+}
+
+// Feed a stereo sine in audio-callback sized blocks
+void feed_sine(VisualizationEngine& engine, float frequency, float amplitude,
+               uint32_t sample_rate, size_t total_frames) {
+    const size_t block = 512;
+    std::vector<float> buffer(block * 2);
+    const double step = 2.0 * 3.14159265358979323846 * frequency / sample_rate;
+
+    for (size_t start = 0; start < total_frames; start += block) {
+        for (size_t i = 0; i < block; ++i) {
+            float s = amplitude * static_cast<float>(std::sin(step * (start + i)));
+            buffer[i * 2] = s;
+            buffer[i * 2 + 1] = s;
+        }
+        engine.process_audio(buffer.data(), block, 2, sample_rate);
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+}
+
+} // namespace
+
+TEST(SeqlockBufferTest, ReadersSeeWholeSnapshots) {
+    mp::core::SeqlockBuffer buffer(64);
+    std::atomic<bool> done(false);
+
+    std::thread writer([&] {
+        float values[64];
+        for (int round = 1; round <= 20000; ++round) {
+            for (float& v : values) {
+                v = static_cast<float>(round);
+            }
+            buffer.write(values, 64);
+        }
+        done = true;
+    });
+
+    bool consistent = true;
+    float out[64];
+    while (!done) {
+        size_t n = buffer.read(out);
+        for (size_t i = 1; i < n; ++i) {
+            consistent = consistent && out[i] == out[0];
+        }
+    }
+
+    writer.join();
+    EXPECT_TRUE(consistent);
+}
+
+TEST(VisualizationEngineTest, WorkerPublishesMetersAndSpectrum) {
+    VisualizationEngine engine;
+    ASSERT_EQ(engine.initialize(make_config()), Result::Success);
+
+    feed_sine(engine, 1000.0f, 0.5f, 48000, 48000 / 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    VUMeterData vu = engine.get_vu_meter_data();
+    EXPECT_NEAR(vu.peak_left, 0.5f, 0.05f);
+    EXPECT_NEAR(vu.rms_left, 0.5f / std::sqrt(2.0f), 0.02f);
+
+    SpectrumData spectrum = engine.get_spectrum_data();
+    ASSERT_EQ(spectrum.magnitudes.size(), 30u);
+    ASSERT_EQ(spectrum.frequencies.size(), 30u);
+    size_t loudest = 0;
+    for (size_t i = 1; i < spectrum.magnitudes.size(); ++i) {
+        if (spectrum.magnitudes[i] > spectrum.magnitudes[loudest]) {
+            loudest = i;
+        }
+    }
+    EXPECT_GT(spectrum.frequencies[loudest], 700.0f);
+    EXPECT_LT(spectrum.frequencies[loudest], 1400.0f);
+
+    WaveformData waveform = engine.get_waveform_data();
+    ASSERT_EQ(waveform.min_values.size(), 200u);
+    ASSERT_EQ(waveform.max_values.size(), 200u);
+    EXPECT_NEAR(waveform.max_values[199], 0.5f, 0.05f);
+    EXPECT_NEAR(waveform.min_values[199], -0.5f, 0.05f);
+
+    engine.shutdown();
+}
+
+TEST(VisualizationEngineTest, SettingsApplyOnNextUpdate) {
+    VisualizationEngine engine;
+    ASSERT_EQ(engine.initialize(make_config()), Result::Success);
+
+    engine.set_spectrum_bars(64);
+    engine.set_waveform_width(100);
+    engine.set_fft_size(3000);
+    feed_sine(engine, 440.0f, 0.25f, 44100, 8192);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    SpectrumData spectrum = engine.get_spectrum_data();
+    EXPECT_EQ(spectrum.magnitudes.size(), 64u);
+    EXPECT_EQ(spectrum.fft_size, 4096u);
+    EXPECT_EQ(spectrum.sample_rate, 44100u);
+    EXPECT_EQ(engine.get_waveform_data().min_values.size(), 100u);
+}
+
+TEST(VisualizationEngineTest, MetersEachInputChannel) {
+    VisualizationEngine engine;
+    ASSERT_EQ(engine.initialize(make_config()), Result::Success);
+
+    // 6 channels at 96 kHz, channel n at amplitude (n + 1) / 8
+    const uint16_t channels = 6;
+    const size_t block = 480;
+    std::vector<float> buffer(block * channels);
+    for (size_t start = 0; start < 96000 / 4; start += block) {
+        for (size_t i = 0; i < block; ++i) {
+            float s = std::sin(2.0f * 3.14159265f * 500.0f * (start + i) / 96000.0f);
+            for (uint16_t ch = 0; ch < channels; ++ch) {
+                buffer[i * channels + ch] = s * (ch + 1) / 8.0f;
+            }
+        }
+        engine.process_audio(buffer.data(), block, channels, 96000);
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    std::vector<ChannelMeterData> meters = engine.get_channel_meter_data();
+    ASSERT_EQ(meters.size(), 6u);
+    for (uint16_t ch = 0; ch < channels; ++ch) {
+        float amplitude = (ch + 1) / 8.0f;
+        EXPECT_NEAR(meters[ch].peak, amplitude, 0.01f) << "channel " << ch;
+        EXPECT_NEAR(meters[ch].rms, amplitude / std::sqrt(2.0f), 0.01f) << "channel " << ch;
+        EXPECT_GE(meters[ch].true_peak, meters[ch].peak);
+    }
+
+    VUMeterData vu = engine.get_vu_meter_data();
+    EXPECT_NEAR(vu.peak_left, 1.0f / 8.0f, 0.01f);
+    EXPECT_NEAR(vu.peak_right, 2.0f / 8.0f, 0.01f);
+}
+
+TEST(VisualizationEngineTest, ReadsPlanarFramesInPlace) {
+    VisualizationEngine engine;
+    ASSERT_EQ(engine.initialize(make_config()), Result::Success);
+
+    // Planar stereo, left at 0.5 and right at 0.25
+    const size_t block = 480;
+    core::AudioFramePool pool(1, block, 2);
+    for (size_t start = 0; start < 48000 / 4; start += block) {
+        core::AudioFrame frame = pool.acquire(block, 2, 48000, core::FrameLayout::Planar);
+        ASSERT_TRUE(frame);
+        for (size_t i = 0; i < block; ++i) {
+            float s = std::sin(2.0f * 3.14159265f * 1000.0f * (start + i) / 48000.0f);
+            frame.channel(0)[i] = 0.5f * s;
+            frame.channel(1)[i] = 0.25f * s;
+        }
+        engine.process_audio(frame);
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    VUMeterData vu = engine.get_vu_meter_data();
+    EXPECT_NEAR(vu.peak_left, 0.5f, 0.01f);
+    EXPECT_NEAR(vu.peak_right, 0.25f, 0.01f);
+}
@@ -0,0 +1,182 @@
+﻿#include "../core/work_stealing_scheduler.h"
+#include "../core/realtime_guard.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace mp::core;
+
+TEST(WorkStealingDequeTest, OwnerIsLifoThiefIsFifo) {
+    WorkStealingDeque deque(8);
+    EXPECT_EQ(deque.capacity(), 8u);
+    for (uint32_t i = 1; i <= 4; ++i) {
+        deque.push(i);
+    }
+
+    uint32_t task = 0;
+    ASSERT_TRUE(deque.pop(task));
+    EXPECT_EQ(task, 4u);
+    ASSERT_TRUE(deque.steal(task));
+    EXPECT_EQ(task, 1u);
+    ASSERT_TRUE(deque.pop(task));
+    EXPECT_EQ(task, 3u);
+    ASSERT_TRUE(deque.pop(task));
+    EXPECT_EQ(task, 2u);
+    EXPECT_FALSE(deque.pop(task));
+    EXPECT_FALSE(deque.steal(task));
+}
+
+TEST(WorkStealingDequeTest, EveryTaskTakenOnceUnderContention) {
+    constexpr uint32_t COUNT = 1 << 16;
+    WorkStealingDeque deque(COUNT);
+    std::vector<std::atomic<int>> taken(COUNT);
+    std::atomic<bool> done{false};
+
+    auto thief = [&] {
+        uint32_t task;
+        while (!done.load()) {
+            if (deque.steal(task)) {
+                taken[task].fetch_add(1);
+            }
+        }
+        while (deque.steal(task)) {
+            taken[task].fetch_add(1);
+        }
+    };
+    std::thread a(thief);
+    std::thread b(thief);
+
+    uint32_t task;
+    for (uint32_t i = 0; i < COUNT; ++i) {
+        deque.push(i);
+        if (i % 3 == 0 && deque.pop(task)) {
+            taken[task].fetch_add(1);
+        }
+    }
+    while (deque.pop(task)) {
+        taken[task].fetch_add(1);
+    }
+    done = true;
+    a.join();
+    b.join();
+
+    for (uint32_t i = 0; i < COUNT; ++i) {
+        ASSERT_EQ(taken[i].load(), 1) << "task " << i;
+    }
+}
+
+TEST(TaskGraphTest, OnlyForwardDependencies) {
+    TaskGraph graph;
+    uint32_t a = graph.add_task([] {});
+    uint32_t b = graph.add_task([] {});
+    EXPECT_TRUE(graph.add_dependency(a, b));
+    EXPECT_FALSE(graph.add_dependency(b, a));
+    EXPECT_FALSE(graph.add_dependency(a, a));
+    EXPECT_FALSE(graph.add_dependency(a, 7));
+}
+
+// Per-channel lanes of two effects, joined by a mix-down task: lane c of
+// the second effect needs lane c of the first
+TEST(WorkStealingSchedulerTest, RunsEveryTaskAfterItsDependencies) {
+    constexpr uint32_t CHANNELS = 8;
+    std::vector<std::atomic<int>> first(CHANNELS);
+    std::vector<std::atomic<int>> second(CHANNELS);
+    std::atomic<int> mixdown{0};
+    std::atomic<bool> out_of_order{false};
+
+    TaskGraph graph;
+    std::vector<uint32_t> first_ids;
+    for (uint32_t c = 0; c < CHANNELS; ++c) {
+        first_ids.push_back(graph.add_task([&, c] { first[c].fetch_add(1); }));
+    }
+    std::vector<uint32_t> second_ids;
+    for (uint32_t c = 0; c < CHANNELS; ++c) {
+        second_ids.push_back(graph.add_task([&, c] {
+            if (first[c].load() != second[c].load() + 1) {
+                out_of_order = true;
+            }
+            second[c].fetch_add(1);
+        }));
+        graph.add_dependency(first_ids[c], second_ids[c]);
+    }
+    uint32_t last = graph.add_task([&] {
+        for (uint32_t c = 0; c < CHANNELS; ++c) {
+            if (second[c].load() != mixdown.load() + 1) {
+                out_of_order = true;
+            }
+        }
+        mixdown.fetch_add(1);
+    });
+    for (uint32_t id : second_ids) {
+        graph.add_dependency(id, last);
+    }
+
+    WorkStealingScheduler scheduler(3, 64);
+    EXPECT_EQ(scheduler.worker_count(), 4u);
+    constexpr int BLOCKS = 2000;
+    for (int block = 0; block < BLOCKS; ++block) {
+        ASSERT_TRUE(scheduler.run(graph));
+        // run() is the barrier: everything from this block is done
+        ASSERT_EQ(mixdown.load(), block + 1);
+    }
+
+    EXPECT_FALSE(out_of_order.load());
+    for (uint32_t c = 0; c < CHANNELS; ++c) {
+        EXPECT_EQ(first[c].load(), BLOCKS);
+        EXPECT_EQ(second[c].load(), BLOCKS);
+    }
+}
+
+TEST(WorkStealingSchedulerTest, IdleWorkersStealIndependentTasks) {
+    TaskGraph graph;
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    for (int i = 0; i < 8; ++i) {
+        graph.add_task([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            // Pool threads count as real-time; this bookkeeping allocates
+            rt::NonRealtimeScope bookkeeping;
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.insert(std::this_thread::get_id());
+        });
+    }
+
+    WorkStealingScheduler scheduler(3, 16);
+    for (int block = 0; block < 5; ++block) {
+        ASSERT_TRUE(scheduler.run(graph));
+    }
+    EXPECT_GT(scheduler.steal_count(), 0u);
+    EXPECT_GT(threads.size(), 1u);
+}
+
+TEST(WorkStealingSchedulerTest, WithoutThreadsCallerRunsEverything) {
+    TaskGraph graph;
+    int count = 0;
+    uint32_t previous = graph.add_task([&] { ++count; });
+    for (int i = 0; i < 10; ++i) {
+        uint32_t next = graph.add_task([&] { ++count; });
+        graph.add_dependency(previous, next);
+        previous = next;
+    }
+
+    WorkStealingScheduler scheduler(0, 16);
+    ASSERT_TRUE(scheduler.run(graph));
+    EXPECT_EQ(count, 11);
+    EXPECT_EQ(scheduler.steal_count(), 0u);
+
+    TaskGraph empty;
+    EXPECT_TRUE(scheduler.run(empty));
+}
+
+TEST(WorkStealingSchedulerTest, RejectsOversizedGraph) {
+    TaskGraph graph;
+    for (int i = 0; i < 5; ++i) {
+        graph.add_task([] {});
+    }
+    WorkStealingScheduler scheduler(1, 4);
+    EXPECT_FALSE(scheduler.run(graph));
+}